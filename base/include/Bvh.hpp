@@ -0,0 +1,149 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <glm/vec3.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "bounds.hpp"
+
+namespace donkey {
+
+// Dynamic bounding volume hierarchy of boxes identified by a uint32_t, one
+// box per leaf. Boxes are inserted where they grow the tree the least and
+// moved by refitting their ancestors, which degrades the tree over time:
+// once enough changes piled up since the last build, maintain rebuilds it
+// from scratch with the surface area heuristic on a worker thread. Changes
+// made meanwhile are applied to both trees, so queries always see every
+// change.
+class Bvh {
+ public:
+  enum : uint32_t { kNoNode = 0xffffffff };
+  enum {
+    kBinCount = 16,  // candidate splits per axis when building
+    kMinRebuildLeafCount = 64  // smaller trees are rebuilt right away
+  };
+
+ private:
+  struct Node {
+    Aabb box;
+    uint32_t parent;
+    uint32_t children[2];  // kNoNode for leaves
+    uint32_t id;  // leaves only
+  };
+
+  struct Tree {
+    std::vector<Node> nodes;
+    std::vector<uint32_t> free_nodes;
+    std::unordered_map<uint32_t, uint32_t> leaves;  // node of each id
+    uint32_t root;
+
+    Tree();
+    bool is_leaf(uint32_t node) const;
+    uint32_t allocate_node();
+    void free_node(uint32_t node);
+    void refit(uint32_t node);
+    void insert(uint32_t id, const Aabb& box);
+    bool update(uint32_t id, const Aabb& box);  // false if it didn't move
+    void remove(uint32_t id);
+  };
+
+  typedef std::pair<uint32_t, Aabb> Item;
+
+  struct Change {
+    enum class Type { kInsert, kUpdate, kRemove } type;
+    uint32_t id;
+    Aabb box;
+  };
+
+ private:
+  Tree tree_;
+  std::size_t change_count_;  // since the last build
+  float rebuild_ratio_;
+  std::size_t rebuild_count_;
+  std::future<Tree> rebuild_;
+  std::vector<Change> rebuild_changes_;  // since the rebuild started
+
+ private:
+  static Tree build_(std::vector<Item> items);
+  static uint32_t build_node_(Tree& tree,
+                              std::vector<Item>& items,
+                              std::size_t begin,
+                              std::size_t end);
+  void record_change_(Change::Type type, uint32_t id, const Aabb& box);
+
+ public:
+  Bvh();
+  ~Bvh();
+  Bvh(const Bvh&) = delete;
+  Bvh& operator=(const Bvh&) = delete;
+
+  void insert(uint32_t id, const Aabb& box);
+  // Boxes which didn't change don't count towards a rebuild.
+  void update(uint32_t id, const Aabb& box);
+  void remove(uint32_t id);
+  void clear();
+  bool contains(uint32_t id) const;
+  std::size_t size() const;
+
+  // Builds the tree from scratch on the calling thread.
+  void build();
+  // To be called once a frame or so: swaps in the tree rebuilt in the
+  // background once it's ready, or starts rebuilding it if more than
+  // `rebuild_ratio` changes per box were made since the last build.
+  void maintain();
+  void start_rebuild();
+  // Returns whether a rebuilt tree was swapped in, `wait` blocks until the
+  // rebuild in progress is done.
+  bool finish_rebuild(bool wait);
+  bool is_rebuilding() const;
+  void set_rebuild_ratio(float rebuild_ratio);
+  std::size_t get_rebuild_count() const;
+
+  // Expected cost of a query relative to testing the root's box only: the
+  // sum of the nodes' surface areas divided by the root's.
+  float get_cost() const;
+  std::size_t get_height() const;
+
+  // Queries call `callback(id)` for every box which intersects the volume,
+  // in no particular order. Frustum tests are conservative, see Frustum.
+  template <typename Callback>
+  void query(const Aabb& box, Callback callback) const;
+  template <typename Callback>
+  void query(const glm::vec3& center, float radius, Callback callback) const;
+  template <typename Callback>
+  void query(const Frustum& frustum, Callback callback) const;
+  // Calls `callback(id, distance)` for every box the ray enters within
+  // `max_distance`, nearest subtree first. `distance` is where it enters
+  // the box, and the callback returns how far to keep looking: the distance
+  // to the nearest hit found so far, or its argument to find every box.
+  template <typename Callback>
+  void raycast(const glm::vec3& origin,
+               const glm::vec3& direction,
+               float max_distance,
+               Callback callback) const;
+};
+
+}  // namespace donkey
+
+#include "Bvh.inl"
@@ -0,0 +1,147 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace donkey {
+
+template <typename Callback>
+void Bvh::query(const Aabb& box, Callback callback) const {
+  if (tree_.root == kNoNode)
+    return;
+  std::vector<uint32_t> stack(1, tree_.root);
+  while (!stack.empty()) {
+    const Node& node = tree_.nodes[stack.back()];
+    stack.pop_back();
+    if (!node.box.intersects(box))
+      continue;
+    if (node.children[0] == kNoNode) {
+      callback(node.id);
+    } else {
+      stack.push_back(node.children[0]);
+      stack.push_back(node.children[1]);
+    }
+  }
+}
+
+template <typename Callback>
+void Bvh::query(const glm::vec3& center,
+                float radius,
+                Callback callback) const {
+  if (tree_.root == kNoNode)
+    return;
+  std::vector<uint32_t> stack(1, tree_.root);
+  while (!stack.empty()) {
+    const Node& node = tree_.nodes[stack.back()];
+    stack.pop_back();
+    if (!node.box.intersects(center, radius))
+      continue;
+    if (node.children[0] == kNoNode) {
+      callback(node.id);
+    } else {
+      stack.push_back(node.children[0]);
+      stack.push_back(node.children[1]);
+    }
+  }
+}
+
+template <typename Callback>
+void Bvh::query(const Frustum& frustum, Callback callback) const {
+  if (tree_.root == kNoNode)
+    return;
+  // Subtrees inside the frustum are reported without testing anything
+  // else, their nodes are pushed with the high bit set.
+  const uint32_t inside_bit = 0x80000000;
+  std::vector<uint32_t> stack(1, tree_.root);
+  while (!stack.empty()) {
+    uint32_t index = stack.back();
+    stack.pop_back();
+    bool inside = (index & inside_bit) != 0;
+    const Node& node = tree_.nodes[index & ~inside_bit];
+    if (!inside) {
+      Frustum::Test test = frustum.test(node.box);
+      if (test == Frustum::Test::kOutside)
+        continue;
+      inside = (test == Frustum::Test::kInside);
+    }
+    if (node.children[0] == kNoNode) {
+      callback(node.id);
+    } else {
+      uint32_t bit = inside ? inside_bit : 0;
+      stack.push_back(node.children[0] | bit);
+      stack.push_back(node.children[1] | bit);
+    }
+  }
+}
+
+template <typename Callback>
+void Bvh::raycast(const glm::vec3& origin,
+                  const glm::vec3& direction,
+                  float max_distance,
+                  Callback callback) const {
+  if (tree_.root == kNoNode)
+    return;
+  const float infinity = std::numeric_limits<float>::infinity();
+  glm::vec3 inverse_direction;
+  for (int axis = 0; axis < 3; ++axis) {
+    inverse_direction[axis] =
+        (direction[axis] != 0.0f) ? 1.0f / direction[axis] : infinity;
+  }
+  float root_distance =
+      tree_.nodes[tree_.root].box.intersect(origin, inverse_direction,
+                                            max_distance);
+  if (root_distance < 0.0f)
+    return;
+  // Nodes with the distance at which the ray enters them, which may have
+  // become farther than the nearest hit by the time they're popped.
+  std::vector<std::pair<uint32_t, float>> stack(
+      1, std::make_pair(tree_.root, root_distance));
+  while (!stack.empty()) {
+    std::pair<uint32_t, float> entry = stack.back();
+    stack.pop_back();
+    if (entry.second > max_distance)
+      continue;
+    const Node& node = tree_.nodes[entry.first];
+    if (node.children[0] == kNoNode) {
+      max_distance = std::min(max_distance, callback(node.id, entry.second));
+      continue;
+    }
+    float distances[2];
+    for (int i = 0; i < 2; ++i) {
+      distances[i] = tree_.nodes[node.children[i]].box.intersect(
+          origin, inverse_direction, max_distance);
+    }
+    // The nearest child goes on top of the stack.
+    int near_child = (distances[1] >= 0.0f &&
+                      (distances[0] < 0.0f || distances[1] < distances[0]))
+                         ? 1
+                         : 0;
+    int far_child = 1 - near_child;
+    if (distances[far_child] >= 0.0f) {
+      stack.push_back(std::make_pair(node.children[far_child],
+                                     distances[far_child]));
+    }
+    if (distances[near_child] >= 0.0f) {
+      stack.push_back(std::make_pair(node.children[near_child],
+                                     distances[near_child]));
+    }
+  }
+}
+
+}  // namespace donkey
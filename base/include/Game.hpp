@@ -17,6 +17,8 @@
 
 #pragma once
 
+#include <vector>
+
 #include "IResourceLoaderDelegate.hpp"
 #include "ISimulationModule.hpp"
 #include "Scene.hpp"
@@ -30,6 +32,9 @@ namespace donkey {
 class Game : public ISimulationModule {
  private:
   Scene scene_;
+  // The mesh nodes update turns, those in layer 0, picked once since the
+  // scene's lists keep their nodes in place.
+  std::vector<MeshNode*> rotating_nodes_;
 
  public:
   Game(IResourceLoaderDelegate& resourceLoader);
@@ -18,25 +18,50 @@
 #pragma once
 
 #include <atomic>
+#include <string>
 
 #include "Game.hpp"
 #include "IResourceLoaderDelegate.hpp"
 #include "ISimulationModule.hpp"
+#include "render/CaptureDriver.hpp"
 #include "render/DeferredRenderer.hpp"
+#include "render/GpuDriver.hpp"
 #include "render/ResourceManager.hpp"
+#include "render/StaticMeshSet.hpp"
 #include "render/Window.hpp"
+#include "render/gl/FrameReader.hpp"
+#include "render/gl/ProgramCache.hpp"
 
 namespace donkey {
 
+namespace render {
+class FrameWriter;
+class OffscreenContext;
+}  // namespace render
+
 class GameManager {
+ public:
+  enum class Backend {
+    kGl,        // renders to a window
+    kHeadless,  // records frames without a GPU, see render::headless::Driver
+    kOffscreen  // renders without a window, see render::OffscreenContext
+  };
+
  private:
-  render::Window* window_;
-  render::gl::Driver* driver_;
+  render::Window* window_;  // kGl only
+  // kOffscreen only
+  render::OffscreenContext* offscreen_context_;
+  render::gl::FrameReader* frame_reader_;
+  render::FrameWriter* frame_writer_;  // save_frames only
+  render::GpuDriver* backend_driver_;
+  render::CaptureDriver* driver_;  // wraps the backend's
   render::DeferredRenderer* renderer_;
+  render::StaticMeshSet static_mesh_set_;  // render thread only
   IResourceLoaderDelegate& resource_loader_;
   std::atomic_bool run_;
   std::atomic_size_t simulated_frame_count_;
   std::atomic_size_t rendered_frame_count_;
+  std::size_t frame_limit_;
   render::ResourceManager* resource_manager_;
   std::list<ISimulationModule*> simulation_modules_;
 
@@ -56,8 +81,29 @@ class GameManager {
   using StackAllocator = render::StackAllocator<T>;
   using FramePacket = render::StackFramePacket;
 
-  GameManager(IResourceLoaderDelegate& resource_loader);
+  // GPU programs are cached in `program_cache_directory`, empty to not
+  // cache them, see render::gl::ProgramCache. The headless backend ignores
+  // it.
+  GameManager(IResourceLoaderDelegate& resource_loader,
+              Backend backend = Backend::kGl,
+              const std::string& program_cache_directory =
+                  render::gl::ProgramCache::get_default_directory());
   ~GameManager();
+  // Stops running after rendering `frame_count` frames, 0 for no limit.
+  void set_frame_limit(std::size_t frame_count);
+  // Saves the next rendered frame to `path`, see render::CaptureDriver.
+  // F12 captures to frame.capture.
+  void capture_frame(const std::string& path);
+  // Offscreen backend only: hands each rendered frame to `callback`, on the
+  // render thread and a few frames late, see render::gl::FrameReader.
+  void set_frame_callback(const render::gl::FrameReader::Callback& callback);
+  // Offscreen backend only: saves each rendered frame as
+  // `path_prefix`<frame index>.png, on a thread of its own, see
+  // render::FrameWriter.
+  void save_frames(const std::string& path_prefix);
+  // The backend's driver, e.g. to read a headless::Driver's statistics.
+  render::GpuDriver& get_driver();
+  render::DeferredRenderer& get_renderer();
   void run();
   void render_loop();
   void simulation_loop();
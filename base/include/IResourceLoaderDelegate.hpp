@@ -27,6 +27,7 @@ namespace donkey {
 class IResourceLoaderDelegate {
  public:
   virtual void load_game_objects(Scene& scene) = 0;
+  // `window` is null when the GameManager runs headless or offscreen.
   virtual void load_render_resources(
       render::Window* window,
       render::ResourceManager* resource_manager,
@@ -32,10 +32,26 @@ namespace donkey {
 
 class MeshLoader {
  public:
+  enum {
+    kMaxLodCount = 4,
+    kMinLodTriangleCount = 64  // not worth simplifying further
+  };
+
+  // Loads the first shape of an OBJ file along with a chain of simplified
+  // versions of it, each with about half the triangles of the previous one.
   uint32_t load(render::ResourceManager* resource_manager,
                 const std::string& path) const;
 
  private:
+  void create_lods_(render::ResourceManager* resource_manager,
+                    uint32_t mesh_id,
+                    const std::vector<uint32_t>& indices,
+                    const std::vector<float>& positions,
+                    const std::vector<float>& normals,
+                    const std::vector<float>& uvs,
+                    const std::vector<float>& tangents,
+                    const std::vector<float>& bitangents) const;
+
   void consolidate_indices_(
       const tinyobj::attrib_t& attributes,
       const std::vector<tinyobj::index_t>& tinyobj_indices,
@@ -0,0 +1,82 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <glm/vec3.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace donkey {
+
+// Simplifies triangle meshes by collapsing edges in order of increasing
+// quadric error: M. Garland, P. Heckbert, "Surface Simplification Using
+// Quadric Error Metrics", SIGGRAPH 1997.
+// Vertices are only ever moved onto one of their neighbours, so that the
+// simplified triangles index the same vertices and keep their attributes.
+// Vertices on the border of the mesh or on an attribute seam, i.e. sharing
+// their position with another vertex, never move.
+class MeshSimplifier {
+ private:
+  // Symmetric 4x4 matrix, sum of the squared distances to a set of planes.
+  struct Quadric {
+    double a00, a01, a02, a11, a12, a22;
+    double b0, b1, b2;
+    double c;
+    double plane_count;
+
+    void add(const Quadric& quadric);
+    void add_plane(const glm::vec3& normal, float distance);
+    // Mean squared distance to the planes.
+    double evaluate(const glm::vec3& position) const;
+  };
+
+  struct Collapse {
+    uint32_t from;
+    uint32_t to;
+    double error;
+  };
+
+ public:
+  // Returns the indices of the triangles left once `indices` has at most
+  // `target_index_count` of them, or once no edge can be collapsed without
+  // moving a vertex farther than `max_error` from the original surface.
+  // `error` is set to the farthest a vertex moved, in model space.
+  std::vector<uint32_t> simplify(const std::vector<float>& positions,
+                                 const std::vector<uint32_t>& indices,
+                                 std::size_t target_index_count,
+                                 float max_error,
+                                 float& error) const;
+
+ private:
+  std::vector<uint32_t> weld_positions_(
+      const std::vector<glm::vec3>& positions) const;
+  std::vector<bool> find_locked_vertices_(
+      const std::vector<uint32_t>& welded,
+      const std::vector<uint32_t>& indices) const;
+  // Whether one of the triangles around collapse.from would turn over.
+  bool flips_(const std::vector<glm::vec3>& positions,
+              const std::vector<uint32_t>& indices,
+              const uint32_t* triangles,
+              std::size_t triangle_count,
+              const Collapse& collapse) const;
+};
+
+}  // namespace donkey
@@ -18,25 +18,71 @@
 #pragma once
 
 #include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
 #include <glm/mat4x4.hpp>
 #include <glm/vec3.hpp>
+#include <atomic>
+#include <cassert>
 #include <list>
+#include <unordered_map>
+#include <vector>
 
+#include "Bvh.hpp"
+#include "TransformHierarchy.hpp"
+#include "bounds.hpp"
 #include "common.hpp"
 
 namespace donkey {
 
 struct SceneNode {
+  enum : uint32_t { kAllLayers = 0xffffffff };
+
   uint32_t pass_num;
+  // One bit per layer the node is in, it's drawn by the passes whose layer
+  // mask shares a bit with it. Starts out in layer pass_num.
+  uint32_t layers;
   glm::vec3 position;
   glm::vec3 angles;
   glm::vec3 scale;
+  // Transform of the scene's hierarchy the node follows, in which case it's
+  // placed by the transform's world matrix and position, angles and scale
+  // are left alone. See Scene::get_model_matrix.
+  uint32_t transform_id;
 
   SceneNode(uint32_t pass_num,
             const glm::vec3& position,
             const glm::vec3& angles,
             const glm::vec3& scale = glm::vec3(1.0f, 1.0f, 1.0f))
-      : pass_num(pass_num), position(position), angles(angles), scale(scale) {}
+      : pass_num(pass_num),
+        layers(get_layer(pass_num)),
+        position(position),
+        angles(angles),
+        scale(scale),
+        transform_id(TransformHierarchy::kNoTransform) {}
+
+  static uint32_t get_layer(uint32_t layer_num) {
+    assert(layer_num < 32);
+    return 1u << layer_num;
+  }
+
+  glm::mat4 get_model_matrix() const {
+    return make_model_matrix(position, angles, scale);
+  }
+
+  // Model to world space, as the renderer draws the node.
+  static glm::mat4 make_model_matrix(const glm::vec3& position,
+                                     const glm::vec3& angles,
+                                     const glm::vec3& scale) {
+    glm::mat4 rotate_x = glm::rotate(glm::mat4(1.0f), glm::radians(angles.x),
+                                     glm::vec3(1.0f, 0.0f, 0.0f));
+    glm::mat4 rotate_y = glm::rotate(rotate_x, glm::radians(angles.y),
+                                     glm::vec3(0.0f, 1.0f, 0.0f));
+    glm::mat4 rotate_z = glm::rotate(rotate_y, glm::radians(angles.z),
+                                     glm::vec3(0.0f, 0.0f, 1.0f));
+    glm::mat4 translate = glm::translate(glm::mat4(1.0f), position);
+    glm::mat4 scale_matrix = glm::scale(glm::mat4(1.0f), scale);
+    return translate * rotate_z * rotate_y * rotate_x * scale_matrix;
+  }
 };
 
 struct DirectionalLightNode : public SceneNode {
@@ -56,9 +102,55 @@ struct DirectionalLightNode : public SceneNode {
       : SceneNode(node), diffuse(node.diffuse), specular(node.specular) {}
 };
 
+// Light shining in every direction from its position, fading out to nothing
+// at `radius`.
+struct PointLightNode : public SceneNode {
+  glm::vec4 diffuse;
+  glm::vec4 specular;
+  float radius;
+
+  PointLightNode(uint32_t pass_num,
+                 const glm::vec3& position,
+                 float radius,
+                 const glm::vec4& diffuse,
+                 const glm::vec4& specular)
+      : SceneNode(pass_num, position, glm::vec3(0.0f)),
+        diffuse(diffuse),
+        specular(specular),
+        radius(radius) {}
+};
+
+// Shines along -z once rotated by `angles`, like directional lights. The
+// cone angles are half angles in degrees, the light fades out between them.
+struct SpotLightNode : public SceneNode {
+  glm::vec4 diffuse;
+  glm::vec4 specular;
+  float radius;
+  float inner_angle;
+  float outer_angle;
+
+  SpotLightNode(uint32_t pass_num,
+                const glm::vec3& position,
+                const glm::vec3& angles,
+                float radius,
+                float inner_angle,
+                float outer_angle,
+                const glm::vec4& diffuse,
+                const glm::vec4& specular)
+      : SceneNode(pass_num, position, angles),
+        diffuse(diffuse),
+        specular(specular),
+        radius(radius),
+        inner_angle(inner_angle),
+        outer_angle(outer_angle) {}
+};
+
 struct MeshNode : public SceneNode {
   uint32_t mesh_id;
   uint32_t material_id;
+  // Unique, follows the node into the frame packets so that the renderer
+  // can remember things about it from one frame to the next.
+  uint32_t id;
 
   MeshNode(uint32_t pass_num,
            const glm::vec3& position,
@@ -68,9 +160,18 @@ struct MeshNode : public SceneNode {
            uint32_t material_id)
       : SceneNode(pass_num, position, angles, scale),
         mesh_id(mesh_id),
-        material_id(material_id) {}
+        material_id(material_id),
+        id(get_next_id_()) {}
+
+ private:
+  static uint32_t get_next_id_() {
+    static std::atomic<uint32_t> next_id(0);
+    return next_id.fetch_add(1, std::memory_order_relaxed);
+  }
 };
 
+// Each camera of the scene is a view of the frame, drawn into its viewport.
+// A camera's layers are those it sees, all of them unless told otherwise.
 struct CameraNode : public SceneNode {
   glm::tvec2<int> viewport_position;
   glm::tvec2<GLsizei> viewport_size;
@@ -95,14 +196,34 @@ struct CameraNode : public SceneNode {
         fov(fov),
         near_plane(near_plane),
         far_plane(far_plane),
-        type(type) {}
+        type(type) {
+    layers = kAllLayers;
+  }
 };
 
 class Scene {
  private:
   std::list<MeshNode> mesh_nodes_;
+  // Never move, the renderer keeps its own copy of them and only hears
+  // about their creation and destruction, see render::StaticMeshSet.
+  std::list<MeshNode> static_mesh_nodes_;
+  std::unordered_map<uint32_t, std::list<MeshNode>::iterator>
+      static_mesh_node_iterators_;
+  // Changes since the last call to clear_static_mesh_node_changes.
+  std::vector<const MeshNode*> created_static_mesh_nodes_;
+  std::vector<uint32_t> destroyed_static_mesh_node_ids_;
+  // World space boxes of the mesh nodes, by node id, for the meshes whose
+  // model space bounds are known, see set_mesh_bounds.
+  Bvh bvh_;
+  std::unordered_map<uint32_t, Aabb> mesh_bounds_;  // by mesh id
+  TransformHierarchy transforms_;
+
+ private:
+  void update_bvh_(const MeshNode& mesh_node);
   std::list<CameraNode> camera_nodes_;
   std::list<DirectionalLightNode> directional_light_nodes_;
+  std::list<PointLightNode> point_light_nodes_;
+  std::list<SpotLightNode> spot_light_nodes_;
 
  public:
   MeshNode& create_mesh_node(uint32_t pass_num,
@@ -111,6 +232,28 @@ class Scene {
                              const glm::vec3& scale,
                              uint32_t mesh_id,
                              uint32_t material_id);
+  MeshNode& create_static_mesh_node(uint32_t pass_num,
+                                    const glm::vec3& position,
+                                    const glm::vec3& angles,
+                                    const glm::vec3& scale,
+                                    uint32_t mesh_id,
+                                    uint32_t material_id);
+  void destroy_static_mesh_node(uint32_t id);
+  // Lets the nodes of `mesh_id` into the BVH, nodes of meshes without
+  // bounds are left out of it.
+  void set_mesh_bounds(uint32_t mesh_id, const Aabb& bounds);
+  // Refits the dynamic nodes' boxes and keeps the BVH in shape, once a frame
+  // after moving them.
+  void update_bvh();
+  const Bvh& get_bvh() const;
+  // Nodes are attached to a transform by setting their transform_id to one
+  // created here. Brought up to date by update_transforms, once a frame
+  // after moving them and before update_bvh.
+  TransformHierarchy& get_transforms();
+  const TransformHierarchy& get_transforms() const;
+  void update_transforms();
+  // Where `node` is drawn, whether it follows a transform or not.
+  glm::mat4 get_model_matrix(const SceneNode& node) const;
   CameraNode& create_perspective_camera_node(
       uint32_t pass_num,
       float fov,
@@ -131,13 +274,35 @@ class Scene {
       const glm::vec3& angles,
       const glm::vec4& diffuse,
       const glm::vec4& specular);
+  PointLightNode& create_point_light_node(uint32_t pass_num,
+                                          const glm::vec3& position,
+                                          float radius,
+                                          const glm::vec4& diffuse,
+                                          const glm::vec4& specular);
+  SpotLightNode& create_spot_light_node(uint32_t pass_num,
+                                        const glm::vec3& position,
+                                        const glm::vec3& angles,
+                                        float radius,
+                                        float inner_angle,
+                                        float outer_angle,
+                                        const glm::vec4& diffuse,
+                                        const glm::vec4& specular);
 
   const std::list<MeshNode>& get_mesh_nodes() const;
+  const std::list<MeshNode>& get_static_mesh_nodes() const;
+  const std::vector<const MeshNode*>& get_created_static_mesh_nodes() const;
+  const std::vector<uint32_t>& get_destroyed_static_mesh_node_ids() const;
+  // Called once the changes made it into a frame packet.
+  void clear_static_mesh_node_changes();
   const std::list<CameraNode>& get_camera_nodes() const;
   const std::list<DirectionalLightNode>& get_directional_light_nodes() const;
+  const std::list<PointLightNode>& get_point_light_nodes() const;
+  const std::list<SpotLightNode>& get_spot_light_nodes() const;
   std::list<MeshNode>& get_mesh_nodes();
   std::list<CameraNode>& get_camera_nodes();
   std::list<DirectionalLightNode>& get_directional_light_nodes();
+  std::list<PointLightNode>& get_point_light_nodes();
+  std::list<SpotLightNode>& get_spot_light_nodes();
 };
 
 }  // namespace donkey
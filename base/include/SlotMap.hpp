@@ -0,0 +1,101 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace donkey {
+
+// Values addressed by generational handles. Creating, destroying and looking
+// up a value are O(1), and the values are kept packed so that iterating over
+// them is as fast as over a vector.
+//
+// A handle is the index of a slot in its low kIndexBits bits and the
+// generation of that slot in the others. Destroying a value bumps the
+// generation of its slot, which tells the handles to it apart from the ones
+// to whatever lands in the slot later. Handles are plain uint32_t so that
+// they travel in commands and frame packets like indices always did, and
+// the first ones handed out are 0, 1, 2...
+//
+// Freed slots are reused oldest first: a slot has to be recycled 4096 times
+// before a stale handle to it can be mistaken for a live one.
+template <typename T>
+class SlotMap {
+ public:
+  enum : uint32_t {
+    kIndexBits = 20,
+    kIndexMask = (1u << kIndexBits) - 1,
+    kGenerationMask = (1u << (32 - kIndexBits)) - 1,
+    kInvalidHandle = 0xffffffff
+  };
+  typedef typename std::vector<T>::iterator iterator;
+  typedef typename std::vector<T>::const_iterator const_iterator;
+
+ private:
+  struct Slot {
+    uint32_t index;  // of the value, or of the next free slot
+    uint32_t generation;
+  };
+
+  std::vector<T> values_;
+  std::vector<uint32_t> value_slots_;
+  std::vector<Slot> slots_;
+  uint32_t free_head_;
+  uint32_t free_tail_;
+
+ private:
+  const Slot* find_slot_(uint32_t handle) const;
+  uint32_t allocate_slot_();
+
+ public:
+  SlotMap();
+
+  template <typename... Args>
+  uint32_t emplace(Args&&... args);
+  uint32_t insert(const T& value);
+  uint32_t insert(T&& value);
+  // Returns false if the handle is stale. The last value takes the place of
+  // the erased one, iterators and references to it are invalidated.
+  bool erase(uint32_t handle);
+  // Forgets every value, handles handed out before may be handed out again.
+  void clear();
+
+  bool contains(uint32_t handle) const;
+  // nullptr if the handle is stale.
+  T* find(uint32_t handle);
+  const T* find(uint32_t handle) const;
+  // The handle must be alive.
+  T& operator[](uint32_t handle);
+  const T& operator[](uint32_t handle) const;
+  // Handle of the value at `position` in iteration order.
+  uint32_t get_handle(std::size_t position) const;
+
+  std::size_t size() const { return values_.size(); }
+  bool empty() const { return values_.empty(); }
+
+  iterator begin() { return values_.begin(); }
+  iterator end() { return values_.end(); }
+  const_iterator begin() const { return values_.begin(); }
+  const_iterator end() const { return values_.end(); }
+};
+
+}  // namespace donkey
+
+#include "SlotMap.inl"
@@ -0,0 +1,163 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <cassert>
+#include <iostream>
+#include <utility>
+
+namespace donkey {
+
+template <typename T>
+SlotMap<T>::SlotMap()
+    : free_head_(kInvalidHandle), free_tail_(kInvalidHandle) {}
+
+// A slot is alive if the value it points to points back at it. The index of
+// a free slot may well be the one of a value, but that value then belongs to
+// another slot.
+template <typename T>
+const typename SlotMap<T>::Slot* SlotMap<T>::find_slot_(
+    uint32_t handle) const {
+  uint32_t index = handle & kIndexMask;
+  if (index >= slots_.size())
+    return nullptr;
+  const Slot& slot = slots_[index];
+  if (slot.generation != handle >> kIndexBits ||
+      slot.index >= value_slots_.size() || value_slots_[slot.index] != index)
+    return nullptr;
+  return &slot;
+}
+
+// Called once the new value is at the back of values_.
+template <typename T>
+uint32_t SlotMap<T>::allocate_slot_() {
+  uint32_t index;
+  if (free_head_ != kInvalidHandle) {
+    index = free_head_;
+    free_head_ = slots_[index].index;
+    if (free_head_ == kInvalidHandle)
+      free_tail_ = kInvalidHandle;
+  } else {
+    // The last index is left out so that no handle is kInvalidHandle.
+    if (slots_.size() >= kIndexMask) {
+      std::cerr << "Slot map full.\n";
+      assert(false);
+    }
+    index = static_cast<uint32_t>(slots_.size());
+    slots_.push_back({0, 0});
+  }
+  slots_[index].index = static_cast<uint32_t>(values_.size()) - 1;
+  value_slots_.push_back(index);
+  return (slots_[index].generation << kIndexBits) | index;
+}
+
+template <typename T>
+template <typename... Args>
+uint32_t SlotMap<T>::emplace(Args&&... args) {
+  values_.emplace_back(std::forward<Args>(args)...);
+  return allocate_slot_();
+}
+
+template <typename T>
+uint32_t SlotMap<T>::insert(const T& value) {
+  values_.push_back(value);
+  return allocate_slot_();
+}
+
+template <typename T>
+uint32_t SlotMap<T>::insert(T&& value) {
+  values_.push_back(std::move(value));
+  return allocate_slot_();
+}
+
+template <typename T>
+bool SlotMap<T>::erase(uint32_t handle) {
+  if (!find_slot_(handle))
+    return false;
+  uint32_t index = handle & kIndexMask;
+  Slot& slot = slots_[index];
+  uint32_t last = static_cast<uint32_t>(values_.size()) - 1;
+  if (slot.index != last) {
+    values_[slot.index] = std::move(values_.back());
+    value_slots_[slot.index] = value_slots_.back();
+    slots_[value_slots_[slot.index]].index = slot.index;
+  }
+  values_.pop_back();
+  value_slots_.pop_back();
+
+  slot.generation = (slot.generation + 1) & kGenerationMask;
+  slot.index = kInvalidHandle;
+  if (free_tail_ == kInvalidHandle)
+    free_head_ = index;
+  else
+    slots_[free_tail_].index = index;
+  free_tail_ = index;
+  return true;
+}
+
+template <typename T>
+void SlotMap<T>::clear() {
+  values_.clear();
+  value_slots_.clear();
+  slots_.clear();
+  free_head_ = kInvalidHandle;
+  free_tail_ = kInvalidHandle;
+}
+
+template <typename T>
+bool SlotMap<T>::contains(uint32_t handle) const {
+  return find_slot_(handle) != nullptr;
+}
+
+template <typename T>
+T* SlotMap<T>::find(uint32_t handle) {
+  const Slot* slot = find_slot_(handle);
+  return slot ? &values_[slot->index] : nullptr;
+}
+
+template <typename T>
+const T* SlotMap<T>::find(uint32_t handle) const {
+  const Slot* slot = find_slot_(handle);
+  return slot ? &values_[slot->index] : nullptr;
+}
+
+template <typename T>
+T& SlotMap<T>::operator[](uint32_t handle) {
+  T* value = find(handle);
+  if (!value) {
+    std::cerr << "Stale handle " << handle << ".\n";
+    assert(false);
+  }
+  return *value;
+}
+
+template <typename T>
+const T& SlotMap<T>::operator[](uint32_t handle) const {
+  const T* value = find(handle);
+  if (!value) {
+    std::cerr << "Stale handle " << handle << ".\n";
+    assert(false);
+  }
+  return *value;
+}
+
+template <typename T>
+uint32_t SlotMap<T>::get_handle(std::size_t position) const {
+  uint32_t index = value_slots_[position];
+  return (slots_[index].generation << kIndexBits) | index;
+}
+
+}  // namespace donkey
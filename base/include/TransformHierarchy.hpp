@@ -0,0 +1,113 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace donkey {
+
+// Parent/child transforms kept in flat arrays sorted by depth, every parent
+// before its children. The world matrices of whatever moved, and of
+// everything below it, are brought up to date by a single linear pass over
+// the arrays. Each depth level only reads the one above it, levels large
+// enough are split between threads.
+//
+// Transforms are referred to by ids which stay valid until destroyed, their
+// place in the arrays changes whenever the hierarchy is reordered.
+class TransformHierarchy {
+ public:
+  enum : uint32_t { kNoTransform = 0xffffffff };
+  enum { kParallelNodeCount = 8192 };  // smallest level worth splitting
+
+ private:
+  enum : uint8_t {
+    kLocalDirty = 1,   // local transform set since the last update
+    kWorldChanged = 2  // world matrix recomputed by the last update
+  };
+
+  // By index, sorted by depth once reordered.
+  std::vector<uint32_t> ids_;  // kNoTransform once destroyed
+  std::vector<uint32_t> parents_;  // indices, kNoTransform for roots
+  std::vector<uint32_t> depths_;
+  std::vector<glm::vec3> positions_;
+  std::vector<glm::quat> rotations_;
+  std::vector<glm::vec3> scales_;
+  std::vector<glm::mat4> world_matrices_;
+  std::vector<uint8_t> flags_;
+  // First index of each depth level, then the end of the last one.
+  std::vector<std::size_t> level_offsets_;
+  std::vector<uint32_t> indices_;  // by id, kNoTransform once destroyed
+  std::vector<uint32_t> free_ids_;
+  std::size_t size_;
+  // Destroying and reparenting break the order, update restores it.
+  bool ordered_;
+  bool dirty_;  // something to recompute
+  bool changed_;  // kWorldChanged flags to clear
+
+ private:
+  uint32_t get_index_(uint32_t id) const;
+  void set_dirty_(uint32_t index);
+  void reorder_();
+  void update_range_(std::size_t begin, std::size_t end);
+
+ public:
+  TransformHierarchy();
+
+  uint32_t create(uint32_t parent = kNoTransform);
+  uint32_t create(uint32_t parent,
+                  const glm::vec3& position,
+                  const glm::quat& rotation,
+                  const glm::vec3& scale = glm::vec3(1.0f, 1.0f, 1.0f));
+  // Its children become roots, their local transform left as is.
+  void destroy(uint32_t id);
+  void set_parent(uint32_t id, uint32_t parent);
+  uint32_t get_parent(uint32_t id) const;
+  bool contains(uint32_t id) const;
+  std::size_t size() const;
+  std::size_t get_level_count() const;
+
+  // Local transform, relative to the parent.
+  void set_position(uint32_t id, const glm::vec3& position);
+  void set_rotation(uint32_t id, const glm::quat& rotation);
+  void set_scale(uint32_t id, const glm::vec3& scale);
+  const glm::vec3& get_position(uint32_t id) const;
+  const glm::quat& get_rotation(uint32_t id) const;
+  const glm::vec3& get_scale(uint32_t id) const;
+
+  // As of the last update.
+  const glm::mat4& get_world_matrix(uint32_t id) const;
+  // Whether the last update recomputed its world matrix.
+  bool has_changed(uint32_t id) const;
+
+  // Reorders the arrays if the hierarchy changed, then recomputes the world
+  // matrices of the dirty transforms and their descendants. Once a frame,
+  // after moving things.
+  void update();
+
+  // Same rotation as SceneNode::make_model_matrix makes out of `angles`,
+  // in degrees.
+  static glm::quat make_rotation(const glm::vec3& angles);
+};
+
+}  // namespace donkey
@@ -0,0 +1,117 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <limits>
+
+namespace donkey {
+
+// Axis aligned bounding box. The default one is empty, min > max, so that
+// extending it with anything gives that thing back. The small functions are
+// inlined, BVHs call them millions of times.
+struct Aabb {
+  glm::vec3 min;
+  glm::vec3 max;
+
+  Aabb()
+      : min(std::numeric_limits<float>::max()),
+        max(std::numeric_limits<float>::lowest()) {}
+
+  Aabb(const glm::vec3& min, const glm::vec3& max) : min(min), max(max) {}
+
+  bool is_empty() const {
+    return min.x > max.x || min.y > max.y || min.z > max.z;
+  }
+
+  glm::vec3 get_center() const { return (min + max) * 0.5f; }
+
+  glm::vec3 get_half_size() const { return (max - min) * 0.5f; }
+
+  float get_surface_area() const {
+    if (is_empty())
+      return 0.0f;
+    glm::vec3 size = max - min;
+    return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+  }
+
+  void extend(const Aabb& box) {
+    min = glm::min(min, box.min);
+    max = glm::max(max, box.max);
+  }
+
+  void extend(const glm::vec3& point) {
+    min = glm::min(min, point);
+    max = glm::max(max, point);
+  }
+
+  bool contains(const Aabb& box) const {
+    return min.x <= box.min.x && min.y <= box.min.y && min.z <= box.min.z &&
+           max.x >= box.max.x && max.y >= box.max.y && max.z >= box.max.z;
+  }
+
+  bool intersects(const Aabb& box) const {
+    return min.x <= box.max.x && min.y <= box.max.y && min.z <= box.max.z &&
+           max.x >= box.min.x && max.y >= box.min.y && max.z >= box.min.z;
+  }
+
+  bool intersects(const glm::vec3& center, float radius) const {
+    glm::vec3 offset = center - glm::clamp(center, min, max);
+    return glm::dot(offset, offset) <= radius * radius;
+  }
+
+  // Distance along the ray at which it enters the box, which is no farther
+  // than `max_distance`, or a negative value if it misses.
+  // `inverse_direction` is 1 / direction, infinite along flat axes.
+  float intersect(const glm::vec3& origin,
+                  const glm::vec3& inverse_direction,
+                  float max_distance) const;
+  // Smallest box containing this one transformed by `matrix`, which must
+  // be affine.
+  Aabb transform(const glm::mat4& matrix) const;
+
+  bool operator==(const Aabb& box) const {
+    return min == box.min && max == box.max;
+  }
+
+  bool operator!=(const Aabb& box) const { return !(*this == box); }
+};
+
+// Convex volume seen by a camera, made of the 6 planes bounding its clip
+// space. Points p inside are those for which dot(plane, vec4(p, 1)) >= 0
+// holds for every plane.
+struct Frustum {
+  enum class Test { kOutside, kIntersecting, kInside };
+
+  glm::vec4 planes[6];
+
+  // OpenGL clip space, z in [-w, w]:
+  // G. Gribb, K. Hartmann, "Fast Extraction of Viewing Frustum Planes from
+  // the World-View-Projection Matrix", 2001.
+  explicit Frustum(const glm::mat4& view_projection);
+
+  // Conservative: boxes near the frustum's edges may intersect it while
+  // being outside.
+  Test test(const Aabb& box) const;
+  bool intersects(const Aabb& box) const;
+};
+
+}  // namespace donkey
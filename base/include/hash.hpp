@@ -24,9 +24,11 @@
 
 #pragma once
 
+#include <cstdint>
 #include <functional>
 #include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
+#include <string_view>
 
 namespace donkey {
 
@@ -85,4 +87,17 @@ void hash_combine(std::size_t& seed, const T& x) {
   seed ^= hash + 0x9e3779b9 + (seed << 6) + (seed >> 2);
 }
 
+const uint64_t kFnv1aOffsetBasis = 0xcbf29ce484222325ull;
+
+// FNV-1a. Unlike std::hash, its values are stable across runs and standard
+// library implementations, and it can be evaluated at compile time.
+constexpr uint64_t hash_fnv1a(std::string_view data,
+                              uint64_t hash = kFnv1aOffsetBasis) {
+  for (char c : data) {
+    hash ^= static_cast<uint8_t>(c);
+    hash *= 0x100000001b3ull;
+  }
+  return hash;
+}
+
 }  // namespace donkey
@@ -17,15 +17,16 @@
 
 #pragma once
 
-#include <GL/gl3w.h>
-
+#include <glm/mat2x2.hpp>
+#include <glm/mat3x3.hpp>
+#include <glm/mat4x4.hpp>
 #include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
 #include <glm/vec4.hpp>
+#include <cstdint>
 #include <string>
 #include <vector>
 
-#include "ScalarMaterialSlot.hpp"
 #include "TextureMaterialSlot.hpp"
 
 namespace donkey {
@@ -34,14 +35,10 @@ namespace render {
 class AMaterial {
  protected:
   std::vector<TextureMaterialSlot> texture_slots_;
-  std::vector<ScalarMaterialSlot<float>> float_slots_;
-  std::vector<ScalarMaterialSlot<glm::vec2>> vec2_slots_;
-  std::vector<ScalarMaterialSlot<glm::vec3>> vec3_slots_;
-  std::vector<ScalarMaterialSlot<glm::vec4>> vec4_slots_;
-  std::vector<ScalarMaterialSlot<glm::mat2>> mat2_slots_;
-  std::vector<ScalarMaterialSlot<glm::mat3>> mat3_slots_;
-  std::vector<ScalarMaterialSlot<glm::mat4>> mat4_slots_;
-  std::vector<ScalarMaterialSlot<int>> int_slots_;
+  // CPU copy of the program's MaterialBlock for this material, laid out the
+  // way the program expects it. Uploaded by the driver when dirty.
+  std::vector<uint8_t> parameters_;
+  bool parameters_dirty_;
 
  public:
   uint32_t program_id;
@@ -50,27 +47,21 @@ class AMaterial {
   unsigned int uv_location;
   unsigned int tangent_location;
   unsigned int bitangent_location;
-  unsigned int model_location;
-  unsigned int view_location;
-  unsigned int projection_location;
-  unsigned int gbuffer_projection_inverse_location;
-  unsigned int gbuffer_view_location;
-  unsigned int gbuffer_projection_params_location;
-  unsigned int ambient_location;
-  unsigned int light_dir_location;
-  unsigned int light_diffuse_location;
-  unsigned int light_specular_location;
-  unsigned int camera_position_location;
+  // -1 if the program can't read its model matrix from the draw buffer, see
+  // CommandBucket::multi_draw_elements.
+  unsigned int draw_id_location;
 
  public:
   AMaterial(uint32_t program_id);
   virtual ~AMaterial() {}
 
-  void bind_slots(CommandBucket& render_commands) const;
+  // Binds the program, the parameter block and the textures of the material.
+  // `material_id` is the id the material was given by the GpuResourceManager.
+  void bind(uint32_t material_id, CommandBucket& render_commands) const;
 
-  template <class Storage>
-  void bind_scalar(int location, const Storage& storage,
-                   CommandBucket& render_commands) const;
+  const std::vector<uint8_t>& get_parameters() const { return parameters_; }
+  bool are_parameters_dirty() const { return parameters_dirty_; }
+  void set_parameters_dirty(bool dirty) { parameters_dirty_ = dirty; }
 
   virtual void register_float_slot(const std::string& name,
                                    const float& storage) = 0;
@@ -102,5 +93,3 @@ class AMaterial {
 
 }  // namespace render
 }  // namespace donkey
-
-#include "AMaterial.inl"
@@ -0,0 +1,71 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+#include "render/CaptureResourceManager.hpp"
+#include "render/CommandStream.hpp"
+#include "render/GpuDriver.hpp"
+
+namespace donkey {
+namespace render {
+
+// Forwards to another driver and saves a frame to a file on request: the
+// resources created until then, see CaptureResourceManager, followed by
+// the frame's commands, see CommandStream. load_capture reads it back to
+// replay it, see the command-replay tool.
+class CaptureDriver : public GpuDriver {
+ private:
+  enum : uint32_t { kMagic = 0x50434453, kVersion = 2 };  // "SDCP"
+
+  GpuDriver& driver_;
+  CaptureResourceManager resource_manager_;
+  // Set from any thread, consumed by the thread executing commands.
+  std::mutex capture_mutex_;
+  std::string capture_path_;
+
+ private:
+  void write_capture_(const std::string& path, const CommandBucket& commands);
+
+ public:
+  CaptureDriver(GpuDriver& driver);
+  virtual ~CaptureDriver();
+  virtual UniformStorage begin_frame();
+  virtual void execute_commands(const CommandBucket& commands);
+  virtual GpuResourceManager& get_resource_manager();
+  virtual uint64_t get_samples_passed() const;
+  virtual std::size_t get_draw_call_count() const;
+  virtual float get_gpu_frame_time() const;
+
+  // Saves the next executed frame to `path`.
+  void capture_next_frame(const std::string& path);
+
+  // Creates the resources of the capture at `path` with `resource_manager`,
+  // which must not have created any yet, and reads its frame into
+  // `commands`.
+  static bool load_capture(const std::string& path,
+                           GpuResourceManager& resource_manager,
+                           CommandStream& commands);
+};
+
+}  // namespace render
+}  // namespace donkey
@@ -0,0 +1,116 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "render/GpuResourceManager.hpp"
+
+namespace donkey {
+namespace render {
+
+// Forwards to another GpuResourceManager and keeps a journal of what it
+// was asked to create and destroy, so that the same resources can be
+// created again, with the same ids, somewhere else. See CaptureDriver.
+//
+// Only the shape of the resources is kept: vertex and index counts, texture
+// sizes and formats, program paths or sources, framebuffer attachments,
+// states. Their contents aren't, replays draw zeroed meshes with grey
+// textures and default material parameters.
+class CaptureResourceManager : public GpuResourceManager {
+ private:
+  enum class Entry : uint8_t {
+    kTextureFromMemory,
+    kGpuProgram,
+    kMesh,
+    kMaterial,
+    kTexture,
+    kTextureBuffer,
+    kFramebuffer,
+    kRenderTargetFramebuffer,
+    kState,
+    kGpuProgramFromSources,
+    kDestroyTexture,
+    kDestroyGpuProgram,
+    kDestroyMesh,
+    kDestroyMaterial,
+    kDestroyState
+  };
+
+  GpuResourceManager& resource_manager_;
+  std::ostringstream journal_;
+  uint32_t entry_count_;
+
+ private:
+  void begin_entry_(Entry entry);
+  void write_destroy_entry_(Entry entry, uint32_t id);
+
+ public:
+  CaptureResourceManager(GpuResourceManager& resource_manager);
+  virtual ~CaptureResourceManager();
+
+  void write_journal(std::ostream& out) const;
+  // Creates the resources of a journal with `resource_manager`. Returns
+  // false if the journal is truncated or malformed.
+  static bool replay_journal(std::istream& in,
+                             GpuResourceManager& resource_manager);
+
+  virtual void cleanup();
+  virtual uint32_t load_texture_from_memory(uint8_t* pixels,
+                                            int width,
+                                            int height);
+  virtual uint32_t load_gpu_program_from_file(const std::string& vs_path,
+                                              const std::string& fs_path);
+  virtual uint32_t load_gpu_program_from_sources(
+      const std::string& vs_sources,
+      const std::string& fs_sources);
+  virtual uint32_t create_mesh(const std::vector<float>& positions,
+                               const std::vector<float>& normals,
+                               const std::vector<float>& uvs,
+                               const std::vector<float>& tangents,
+                               const std::vector<float>& bitangents,
+                               const std::vector<uint32_t>& indices);
+  virtual DrawElementsIndirect get_mesh_draw(uint32_t id) const;
+  virtual uint32_t create_material(uint32_t gpu_program);
+  virtual uint32_t create_texture(std::size_t width,
+                                  std::size_t height,
+                                  pixel::Format format,
+                                  pixel::InternalFormat internal_format,
+                                  pixel::ComponentType component_type);
+  virtual uint32_t create_texture_buffer(pixel::BufferFormat format);
+  virtual uint32_t create_framebuffer(
+      uint32_t depth_rt_id,
+      const std::vector<uint32_t>& color_rt_ids);
+  virtual uint32_t create_framebuffer(
+      const std::list<const donkey::render::Texture*>& rt_ids);
+  virtual uint32_t create_state(const render::State& state);
+  virtual AMaterial& get_material(std::uint32_t id);
+  virtual void destroy_texture(uint32_t id);
+  virtual void destroy_gpu_program(uint32_t id);
+  virtual void destroy_mesh(uint32_t id);
+  virtual void destroy_material(uint32_t id);
+  virtual void destroy_state(uint32_t id);
+};
+
+}  // namespace render
+}  // namespace donkey
@@ -0,0 +1,182 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec2.hpp>
+#include <glm/vec4.hpp>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "render/CommandBucket.hpp"
+#include "render/FramePacket.hpp"
+#include "render/UniformBlock.hpp"
+
+namespace donkey {
+namespace render {
+
+// Bins the lights of a frame into clusters, i.e. screen tiles split into
+// depth slices, so that the lighting pass only loops over the lights that
+// can reach each pixel. Binning happens on the CPU while recording the frame
+// and the results are streamed to three texture buffers:
+// - lights: 4 RGBA32F texels per light, directional lights first,
+// - clusters: one RG32UI texel per cluster, offset and count of its lights,
+// - light indices: R16UI indices into the lights, grouped by cluster.
+class ClusteredLighting {
+ public:
+  enum {
+    kTileSize = 64,  // in pixels
+    kSliceCount = 16,
+    kMaxLights = 0xffff,
+    kParallelLightCount = 64  // fewer lights are binned on the calling thread
+  };
+
+  // One light as laid out in the lights texture buffer, in view space.
+  struct Light {
+    glm::vec4 position;  // radius in w, direction and 0 for directional lights
+    glm::vec4 diffuse;
+    glm::vec4 specular;
+    // The cone factor is clamp(dot(direction to fragment, xyz) + w, 0, 1),
+    // i.e. 0, 0, 0, 1 for lights that aren't spot lights.
+    glm::vec4 spot;
+  };
+
+  // Model transform of the bounding volume of a local light in view, unit
+  // sphere for point lights, unit cone along -z for spot lights.
+  struct LightVolume {
+    uint32_t light_index;
+    bool spot;
+    glm::mat4 model;
+  };
+
+ private:
+  struct LightBounds {
+    glm::vec4 sphere;  // view space center and radius
+    uint32_t light_index;
+    int first_slice;
+    int last_slice;
+    int first_tile_x;
+    int last_tile_x;
+    int first_tile_y;
+    int last_tile_y;
+  };
+
+  struct Hit {
+    uint32_t cluster;
+    uint32_t light_index;
+  };
+
+  // Results of the binning of a range of slices.
+  struct Bin {
+    int first_slice;
+    int last_slice;  // exclusive
+    std::vector<Hit> hits;
+    std::vector<uint16_t> light_indices;
+  };
+
+ private:
+  uint32_t light_buffer_id_;
+  uint32_t cluster_buffer_id_;
+  uint32_t light_index_buffer_id_;
+
+  glm::mat4 projection_;
+  glm::tvec2<GLsizei> viewport_size_;
+  float near_plane_;
+  float far_plane_;
+  int tile_count_x_;
+  int tile_count_y_;
+  float slice_scale_;
+  float slice_bias_;
+  // View space bounding boxes of the clusters, as a structure of arrays so
+  // that 4 neighbouring clusters can be tested at once.
+  std::vector<float> min_x_;
+  std::vector<float> min_y_;
+  std::vector<float> min_z_;
+  std::vector<float> max_x_;
+  std::vector<float> max_y_;
+  std::vector<float> max_z_;
+
+  bool local_light_binning_;
+  std::vector<Light> lights_;
+  std::vector<LightVolume> light_volumes_;
+  std::vector<LightBounds> light_bounds_;
+  std::vector<uint32_t> clusters_;  // offset and count pairs
+  std::vector<uint16_t> light_indices_;
+  LightBlock light_block_;
+
+  // bins_[0] is filled by the recording thread, bins_[i] by workers_[i - 1].
+  std::vector<Bin> bins_;
+  std::vector<std::thread> workers_;
+  std::mutex mutex_;
+  std::condition_variable work_condition_;
+  std::condition_variable done_condition_;
+  uint64_t generation_;
+  std::size_t pending_workers_;
+  bool quit_;
+
+ private:
+  void update_clusters_(const CameraNode& camera_node);
+  int get_slice_(float depth) const;
+  void add_directional_light_(const glm::mat4& view,
+                              const DirectionalLightNode& light_node);
+  void add_point_light_(const glm::mat4& view,
+                        const PointLightNode& light_node);
+  void add_spot_light_(const glm::mat4& view, const SpotLightNode& light_node);
+  // Returns false if the light's bounding sphere is out of view.
+  bool add_local_light_(const glm::vec4& sphere, const Light& light);
+  unsigned int intersect_4_(std::size_t cluster, const glm::vec4& sphere) const;
+  void bin_(Bin& bin);
+  void bin_all_(std::size_t bin_count);
+  void work_(std::size_t worker);
+
+ public:
+  ClusteredLighting();
+  ~ClusteredLighting();
+  ClusteredLighting(const ClusteredLighting&) = delete;
+  ClusteredLighting& operator=(const ClusteredLighting&) = delete;
+
+  // Texture buffers created with GpuResourceManager::create_texture_buffer.
+  void set_texture_buffers(uint32_t light_buffer_id,
+                           uint32_t cluster_buffer_id,
+                           uint32_t light_index_buffer_id);
+  // Point and spot lights are only culled and uploaded when disabled, for
+  // pipelines that draw their volumes instead.
+  void set_local_light_binning(bool enable);
+
+  // Bins the lights in the clusters of `camera_node`, streams the light
+  // lists to the texture buffers and binds the LightBlock.
+  void render(const CameraNode& camera_node,
+              const StackVector<DirectionalLightNode>& directional_light_nodes,
+              const StackVector<PointLightNode>& point_light_nodes,
+              const StackVector<SpotLightNode>& spot_light_nodes,
+              CommandBucket& render_commands);
+
+  // Local lights in view after the last call to render.
+  const std::vector<LightVolume>& get_light_volumes() const;
+  // Binds the LightBlock with the light a volume is being drawn for.
+  void bind_light_volume_block(const LightVolume& light_volume,
+                               CommandBucket& render_commands) const;
+};
+
+}  // namespace render
+}  // namespace donkey
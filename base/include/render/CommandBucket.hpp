@@ -24,9 +24,11 @@
 #include <glm/vec3.hpp>
 #include <glm/vec4.hpp>
 #include <list>
+#include <vector>
 
 #include "render/Mesh.hpp"
 #include "render/Texture.hpp"
+#include "render/UniformBlock.hpp"
 
 namespace donkey {
 namespace render {
@@ -53,7 +55,12 @@ class Command {
     kClearFramebuffer,
     kBindGpuProgram,
     kSetBlending,
-    kSetState
+    kSetState,
+    kBindUniformBlock,
+    kBindMaterialParameters,
+    kUpdateTextureBuffer,
+    kCountSamples,
+    kMultiDrawElements
   };
 
   Type type;
@@ -158,8 +165,9 @@ struct SetBlendingCommand : Command {
 };
 
 struct ClearFramebufferCommand : Command {
-  ClearFramebufferCommand(const glm::vec3& color);
+  ClearFramebufferCommand(const glm::vec3& color, int buffers);
   glm::vec3 color;
+  int buffers;
 };
 
 struct BindGpuProgramCommand : Command {
@@ -172,6 +180,55 @@ struct SetStateCommand : Command {
   uint32_t state_id;
 };
 
+struct BindUniformBlockCommand : Command {
+  BindUniformBlockCommand(unsigned int binding,
+                          std::size_t offset,
+                          std::size_t size);
+  unsigned int binding;
+  std::size_t offset;  // relative to the start of the frame's uniform storage
+  std::size_t size;
+};
+
+struct BindMaterialParametersCommand : Command {
+  BindMaterialParametersCommand(uint32_t material_id);
+  uint32_t material_id;
+};
+
+struct UpdateTextureBufferCommand : Command {
+  UpdateTextureBufferCommand(uint32_t texture_id,
+                             std::size_t offset,
+                             std::size_t size,
+                             std::size_t buffer_offset);
+  uint32_t texture_id;
+  std::size_t offset;  // relative to the start of the frame's uniform storage
+  std::size_t size;
+  std::size_t buffer_offset;  // where it goes in the texture buffer
+};
+
+struct CountSamplesCommand : Command {
+  CountSamplesCommand(bool begin);
+  bool begin;
+};
+
+// One draw of a multi-draw, laid out the way glMultiDrawElementsIndirect
+// reads it.
+struct DrawElementsIndirect {
+  uint32_t count;
+  uint32_t instance_count;
+  uint32_t first_index;
+  int32_t base_vertex;
+  uint32_t base_instance;  // index of the draw's data in the draw buffer
+};
+
+struct MultiDrawElementsCommand : Command {
+  MultiDrawElementsCommand(uint32_t draw_buffer_id,
+                           std::size_t offset,
+                           std::vector<DrawElementsIndirect>&& draws);
+  uint32_t draw_buffer_id;
+  std::size_t offset;  // relative to the start of the frame's uniform storage
+  std::vector<DrawElementsIndirect> draws;
+};
+
 struct SortedCommand {
   uint64_t sort_key;
   Command& command;
@@ -198,11 +255,25 @@ class CommandBucket {
   std::list<ClearFramebufferCommand> clear_framebuffer_commands_;
   std::list<BindGpuProgramCommand> bind_gpu_program_commands_;
   std::list<SetStateCommand> set_state_commands_;
+  std::list<BindUniformBlockCommand> bind_uniform_block_commands_;
+  std::list<BindMaterialParametersCommand> bind_material_parameters_commands_;
+  std::list<UpdateTextureBufferCommand> update_texture_buffer_commands_;
+  std::list<CountSamplesCommand> count_samples_commands_;
+  std::list<MultiDrawElementsCommand> multi_draw_elements_commands_;
+  UniformStorage uniform_storage_;
+  std::size_t uniform_storage_size_;
+  // What didn't fit in the uniform storage, as if it went on past its
+  // capacity. The driver grows the storage of the next frames to fit it.
+  std::vector<uint8_t> uniform_overflow_;
 
  private:
   uint64_t make_sort_key_(Command::Type type);
+  // Copies data into the frame's uniform storage, or its overflow once the
+  // storage is full, and returns its offset.
+  std::size_t store_(const void* data, std::size_t size);
 
  public:
+  CommandBucket(const UniformStorage& uniform_storage);
   void bind_uniform(int location, int uniform);
   void bind_uniform(int location, float uniform);
   void bind_uniform(int location, const glm::vec2& uniform);
@@ -224,9 +295,38 @@ class CommandBucket {
   void set_blending(bool enable);
   void set_viewport(const glm::tvec2<int>& position,
                     const glm::tvec2<std::size_t>& size);
-  void clear_framebuffer(const glm::vec3& color);
+  // `buffers` is a mask of GL_*_BUFFER_BIT, nothing is cleared if it's 0.
+  void clear_framebuffer(const glm::vec3& color, int buffers);
   void set_state(uint32_t state_id);
+  // Copies the block into the frame's uniform storage and binds it.
+  void bind_uniform_block(UniformBlockBinding binding,
+                          const void* block,
+                          std::size_t size);
+  // Binds the parameter block of a material, uploading it first if needed.
+  void bind_material_parameters(uint32_t material_id);
+  // Streams data into a texture buffer through the frame's uniform storage,
+  // at `buffer_offset` bytes into it. What was before stays valid for the
+  // commands recorded before this one.
+  void update_texture_buffer(uint32_t texture_id,
+                             const void* data,
+                             std::size_t size,
+                             std::size_t buffer_offset = 0);
+  // Counts the samples passing the depth test between the two calls, see
+  // GpuDriver::get_samples_passed. Can't be nested.
+  void begin_sample_count();
+  void end_sample_count();
+  // Draws every mesh of `draws` with the bound program and mesh buffer in
+  // a single call. Each draw reads its model matrix from the texture buffer
+  // `draw_buffer_id` at its base instance, see ObjectBlock::draw_params.
+  void multi_draw_elements(uint32_t draw_buffer_id,
+                           std::vector<DrawElementsIndirect>&& draws);
   const std::list<SortedCommand>& get_commands() const;
+  const UniformStorage& get_uniform_storage() const;
+  // Bytes of the uniform storage written so far, overflow included.
+  std::size_t get_uniform_storage_size() const;
+  // Bytes written from the capacity of the uniform storage on, empty unless
+  // the frame needed more than the driver gave it.
+  const std::vector<uint8_t>& get_uniform_overflow() const;
 };
 
 }  // namespace render
@@ -0,0 +1,56 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <istream>
+#include <ostream>
+#include <vector>
+
+#include "render/CommandBucket.hpp"
+
+namespace donkey {
+namespace render {
+
+// A frame's commands, in the order they were recorded, saved so that they
+// can be recorded again into another bucket, see CaptureDriver.
+//
+// Blocks, texture buffer contents and multi-draws are saved along with the
+// commands that read them from the uniform storage. Resources are referred
+// to by id only.
+class CommandStream {
+ private:
+  // Called with the saved uniforms.
+  typedef std::function<void(CommandBucket&, const uint8_t*)> RecordFunction;
+  std::vector<RecordFunction> commands_;
+  std::vector<uint8_t> uniforms_;
+
+ public:
+  static void write(std::ostream& out, const CommandBucket& commands);
+  // Replaces the stream with the one `in` holds. Returns false if it's
+  // truncated or malformed.
+  bool read(std::istream& in);
+  // Records the commands into `commands` again.
+  void record(CommandBucket& commands) const;
+  std::size_t get_command_count() const;
+};
+
+}  // namespace render
+}  // namespace donkey
@@ -19,6 +19,7 @@
 
 #include <array>
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <thread>
 
@@ -41,21 +42,44 @@
 #include "IResourceLoaderDelegate.hpp"
 #include "StackVector.hpp"
 #include "render/FramePacket.hpp"
+#include "render/GpuDriver.hpp"
 #include "render/GpuResourceManager.hpp"
 #include "render/Pipeline.hpp"
 #include "render/PipelineGenerator.hpp"
 #include "render/RenderPass.hpp"
+#include "render/ResolutionScaler.hpp"
 #include "render/ResourceManager.hpp"
 #include "render/Window.hpp"
-#include "render/gl/Driver.hpp"
 
 namespace donkey {
 namespace render {
 
 class DeferredRenderer {
+ public:
+  // How point and spot lights are shaded. Directional lights always go
+  // through a full-screen pass.
+  enum class LightingMode {
+    kClustered,    // binned into clusters, shaded in the full-screen pass
+    kLightVolumes  // one stencil-tested volume per light
+  };
+
+  // Formats of the gbuffer's normals target and of the light accumulation
+  // target. The albedo is always RGBA8 with the material's glossiness in
+  // alpha, depth is always D24S8. Bytes per pixel include them.
+  enum class GBufferLayout {
+    kWide,     // xyz normals and specular in RGBA16F, RGBA8 light (20 B).
+               // Sums of lights saturate at 1.
+    kCompact,  // octahedral normals in RG16, R11G11B10F light (16 B). Has
+               // no room for specular: the materials' specular_attenuation
+               // is dropped and every surface gets full specular.
+    kPacked    // octahedral normals in RGB10A2 with specular in blue,
+               // R11G11B10F light (16 B)
+  };
+
  private:
-  Window* window_;
-  gl::Driver* driver_;
+  int width_;
+  int height_;
+  GpuDriver* driver_;
   GpuResourceManager& gpu_resource_manager_;
   ResourceManager* resource_manager_;
 
@@ -65,22 +89,73 @@ class DeferredRenderer {
   Pipeline pipeline_;
   PipelineGenerator pipeline_generator_;
 
- private:
-  void bind_light_uniforms_(CommandBucket& render_commands,
-                            const Material& material, const glm::mat4& view,
-                            const DirectionalLightNode* light_node) const;
-  void bind_camera_uniforms_(CommandBucket& render_commands,
-                             const Material& material,
-                             const CameraNode& camera_node) const;
-  void bind_mesh_uniforms_(CommandBucket& render_commands,
-                           const Material& material,
-                           const MeshNode& mesh_node) const;
+  // See set_dynamic_resolution.
+  float max_resolution_scale_;
+  ResolutionScaler resolution_scaler_;
+  bool dynamic_resolution_enabled_;
+  std::chrono::steady_clock::time_point last_frame_start_;
 
  public:
-  DeferredRenderer(Window* window, gl::Driver* driver,
-                   ResourceManager* resource_manager);
+  DeferredRenderer(Window* window,
+                   GpuDriver* driver,
+                   ResourceManager* resource_manager,
+                   LightingMode lighting_mode = LightingMode::kClustered,
+                   GBufferLayout gbuffer_layout = GBufferLayout::kPacked,
+                   bool depth_prepass = false,
+                   ShadowCascades::Quality shadow_quality =
+                       ShadowCascades::Quality::kOff,
+                   float max_resolution_scale = 1.0f);
+  // Renders to a `width` x `height` back buffer without a window, e.g. with
+  // a headless::Driver. Render targets are `max_resolution_scale` times as
+  // large, the largest scale the scene can be drawn at.
+  DeferredRenderer(int width,
+                   int height,
+                   GpuDriver* driver,
+                   ResourceManager* resource_manager,
+                   LightingMode lighting_mode = LightingMode::kClustered,
+                   GBufferLayout gbuffer_layout = GBufferLayout::kPacked,
+                   bool depth_prepass = false,
+                   ShadowCascades::Quality shadow_quality =
+                       ShadowCascades::Quality::kOff,
+                   float max_resolution_scale = 1.0f);
   ~DeferredRenderer();
   void render(StackFramePacket* frame_packet, CommandBucket& render_commands);
+  // Overdraw counter mode: counts the fragments the gbuffer pass shades.
+  void set_overdraw_counter(bool enabled);
+  // Fragments shaded by the gbuffer pass per pixel, a few frames ago.
+  float get_overdraw() const;
+  // Culls the meshes hidden behind occluders before the gbuffer pass, see
+  // Pipeline::set_occlusion_culling.
+  void set_occlusion_culling(bool enabled);
+  const OcclusionCulling::Statistics& get_occlusion_statistics() const;
+  // See Pipeline::set_lod_pixel_error.
+  void set_lod_pixel_error(float pixel_error);
+  const LodSelector::Statistics& get_lod_statistics() const;
+  // Draws the gbuffer pass' meshes with a multi-draw per material, see
+  // Pipeline::set_multi_draw.
+  void set_multi_draw(bool enabled);
+  // Shadows of the first directional light, within the budget of the
+  // quality the renderer was created with: the cascade count and resolution
+  // can't change, see Pipeline::set_shadow_settings.
+  void set_shadow_settings(const ShadowCascades::Settings& settings);
+  const ShadowCascades::Settings& get_shadow_settings() const;
+  const ShadowCascades::Statistics& get_shadow_statistics() const;
+  // See Pipeline::set_static_mesh_set.
+  void set_static_mesh_set(const StaticMeshSet* static_mesh_set);
+  // Draws the scene at a fraction of the window's resolution, upscaled by
+  // the last pass: a fixed one, or one picked every frame from the driver's
+  // GPU frame times, or the time between frames without them, to hold a
+  // frame time budget, see ResolutionScaler. Scales are clamped to the
+  // largest one the renderer was created with.
+  void set_resolution_scale(float scale);
+  float get_resolution_scale() const;
+  void set_dynamic_resolution(bool enabled);
+  void set_resolution_scaler_settings(
+      const ResolutionScaler::Settings& settings);
+  const ResolutionScaler& get_resolution_scaler() const;
+  // Draw calls of the last executed frame, see
+  // GpuDriver::get_draw_call_count.
+  std::size_t get_draw_call_count() const;
 };
 
 }  // namespace render
@@ -31,23 +31,60 @@ namespace donkey {
 
 namespace render {
 
+// The model matrix is made once when the node is copied into the frame
+// packet, or taken from the scene's transform hierarchy, rather than out of
+// the Euler angles every time it's needed. Position and scale are read back
+// from it for nodes placed by a transform, whose angles are left at 0.
 struct SceneNode {
   uint32_t pass_num;
+  uint32_t layers;  // see ::donkey::SceneNode::layers
   glm::vec3 position;
   glm::vec3 angles;
   glm::vec3 scale;
+  glm::mat4 model;
 
   SceneNode(uint32_t pass_num,
             const glm::vec3& position,
             const glm::vec3& angles,
             const glm::vec3& scale)
-      : pass_num(pass_num), position(position), angles(angles), scale(scale) {}
+      : pass_num(pass_num),
+        layers(::donkey::SceneNode::get_layer(pass_num)),
+        position(position),
+        angles(angles),
+        scale(scale),
+        model(::donkey::SceneNode::make_model_matrix(position, angles,
+                                                     scale)) {}
+
+  SceneNode(uint32_t pass_num, const glm::mat4& model)
+      : pass_num(pass_num),
+        layers(::donkey::SceneNode::get_layer(pass_num)),
+        angles(0.0f) {
+    set_model_matrix(model);
+  }
 
+  // The transform's world matrix is filled in by the frame packet.
   SceneNode(const ::donkey::SceneNode& node)
       : pass_num(node.pass_num),
+        layers(node.layers),
         position(node.position),
-        angles(node.angles),
-        scale(node.scale) {}
+        angles(node.transform_id == TransformHierarchy::kNoTransform
+                   ? node.angles
+                   : glm::vec3(0.0f)),
+        scale(node.scale),
+        model(node.transform_id == TransformHierarchy::kNoTransform
+                  ? node.get_model_matrix()
+                  : glm::mat4(1.0f)) {}
+
+  // Transform the ObjectBlock is bound with.
+  const glm::mat4& get_model_matrix() const { return model; }
+
+  void set_model_matrix(const glm::mat4& matrix) {
+    model = matrix;
+    position = glm::vec3(matrix[3]);
+    scale = glm::vec3(glm::length(glm::vec3(matrix[0])),
+                      glm::length(glm::vec3(matrix[1])),
+                      glm::length(glm::vec3(matrix[2])));
+  }
 };
 
 struct DirectionalLightNode : public SceneNode {
@@ -67,9 +104,44 @@ struct DirectionalLightNode : public SceneNode {
       : SceneNode(node), diffuse(node.diffuse), specular(node.specular) {}
 };
 
+struct PointLightNode : public SceneNode {
+  glm::vec4 diffuse;
+  glm::vec4 specular;
+  float radius;
+
+  PointLightNode(const ::donkey::PointLightNode& node)
+      : SceneNode(node),
+        diffuse(node.diffuse),
+        specular(node.specular),
+        radius(node.radius) {}
+};
+
+struct SpotLightNode : public SceneNode {
+  glm::vec4 diffuse;
+  glm::vec4 specular;
+  float radius;
+  float inner_angle;
+  float outer_angle;
+
+  SpotLightNode(const ::donkey::SpotLightNode& node)
+      : SceneNode(node),
+        diffuse(node.diffuse),
+        specular(node.specular),
+        radius(node.radius),
+        inner_angle(node.inner_angle),
+        outer_angle(node.outer_angle) {}
+};
+
 struct MeshNode : public SceneNode {
+  enum : uint32_t { kNoId = 0xffffffff };
+
   uint32_t mesh_id;
   uint32_t material_id;
+  // Material in the high bits, view depth in the low ones, see
+  // FramePacket::sort_mesh_nodes.
+  uint64_t sort_key;
+  uint32_t id;  // of the scene's node, kNoId for the renderer's own nodes
+  uint32_t lod;  // level in the mesh's LOD chain, see LodSelector
 
   MeshNode(uint32_t pass_num,
            const glm::vec3& position,
@@ -79,10 +151,29 @@ struct MeshNode : public SceneNode {
            uint32_t material_id)
       : SceneNode(pass_num, position, angles, scale),
         mesh_id(mesh_id),
-        material_id(material_id) {}
+        material_id(material_id),
+        sort_key(0),
+        id(kNoId),
+        lod(0) {}
+
+  MeshNode(uint32_t pass_num,
+           const glm::mat4& model,
+           uint32_t mesh_id,
+           uint32_t material_id)
+      : SceneNode(pass_num, model),
+        mesh_id(mesh_id),
+        material_id(material_id),
+        sort_key(0),
+        id(kNoId),
+        lod(0) {}
 
   MeshNode(const ::donkey::MeshNode& node)
-      : SceneNode(node), mesh_id(node.mesh_id), material_id(node.material_id) {}
+      : SceneNode(node),
+        mesh_id(node.mesh_id),
+        material_id(node.material_id),
+        sort_key(0),
+        id(node.id),
+        lod(0) {}
 };
 
 struct CameraNode : public SceneNode {
@@ -130,6 +221,33 @@ struct CameraNode : public SceneNode {
     view = translate * rotate_z * rotate_y * rotate_x * view;
   }
 
+  // Looks through `matrix` rather than from position and angles.
+  void set_model_matrix(const glm::mat4& matrix) {
+    SceneNode::set_model_matrix(matrix);
+    glm::vec3 x = glm::vec3(matrix[0]) / scale.x;
+    glm::vec3 y = glm::vec3(matrix[1]) / scale.y;
+    glm::vec3 z = glm::vec3(matrix[2]) / scale.z;
+    view = glm::inverse(glm::mat4(glm::vec4(x, 0.0f), glm::vec4(y, 0.0f),
+                                  glm::vec4(z, 0.0f), matrix[3]));
+  }
+
+  // One of the renderer's own cameras, like a shadow cascade's. It sees
+  // every layer.
+  CameraNode(const glm::mat4& view,
+             const glm::mat4& projection,
+             const glm::tvec2<int>& viewport_position,
+             const glm::tvec2<GLsizei>& viewport_size)
+      : SceneNode(0, glm::inverse(view)),
+        projection(projection),
+        view(view),
+        viewport_position(viewport_position),
+        viewport_size(viewport_size),
+        fov(0.0f),
+        near_plane(0.0f),
+        far_plane(0.0f) {
+    layers = ::donkey::SceneNode::kAllLayers;
+  }
+
   CameraNode(const ::donkey::CameraNode& node)
       : SceneNode(node),
         viewport_position(node.viewport_position),
@@ -152,24 +270,47 @@ class FramePacket {
 
  private:
   typedef Allocator<MeshNode> MeshNodeAllocator;
+  typedef Allocator<CameraNode> CameraNodeAllocator;
   typedef Allocator<DirectionalLightNode> DirectionalLightNodeAllocator;
+  typedef Allocator<PointLightNode> PointLightNodeAllocator;
+  typedef Allocator<SpotLightNode> SpotLightNodeAllocator;
+  typedef Allocator<uint32_t> IdAllocator;
 
  private:
   MeshNodeAllocator mesh_node_allocator_;
+  CameraNodeAllocator camera_node_allocator_;
   DirectionalLightNodeAllocator directional_light_node_allocator_;
+  PointLightNodeAllocator point_light_node_allocator_;
+  SpotLightNodeAllocator spot_light_node_allocator_;
+  IdAllocator id_allocator_;
   Vector<MeshNode> mesh_nodes_;
-  CameraNode camera_node_;
+  // One per view of the frame, the first one is the main view.
+  Vector<CameraNode> camera_nodes_;
   Vector<DirectionalLightNode> directional_light_nodes_;
+  Vector<PointLightNode> point_light_nodes_;
+  Vector<SpotLightNode> spot_light_nodes_;
+  // Changes to the scene's static nodes since the previous frame packet.
+  Vector<MeshNode> created_static_mesh_nodes_;
+  Vector<uint32_t> destroyed_static_mesh_node_ids_;
 
  public:
   FramePacket(const MeshNodeAllocator& allocator,
               donkey::CameraNode camera_node);
 
-  FramePacket(std::list<::donkey::MeshNode> mesh_nodes,
-              std::list<::donkey::CameraNode> camerea_nodes,
-              std::list<::donkey::DirectionalLightNode> directional_light_nodes,
-              const MeshNodeAllocator& allocator);
+  FramePacket(
+      const std::list<::donkey::MeshNode>& mesh_nodes,
+      const std::list<::donkey::CameraNode>& camera_nodes,
+      const std::list<::donkey::DirectionalLightNode>& directional_light_nodes,
+      const std::list<::donkey::PointLightNode>& point_light_nodes,
+      const std::list<::donkey::SpotLightNode>& spot_light_nodes,
+      const MeshNodeAllocator& allocator);
 
+  // Copies the scene's dynamic nodes and the changes to its static ones.
+  // The mesh nodes are given room for the static nodes too, see
+  // add_static_mesh_nodes.
+  FramePacket(const ::donkey::Scene& scene, const MeshNodeAllocator& allocator);
+
+  // Replaces the main view's camera.
   void set_camera_node(CameraNode&& node);
 
   MeshNode& create_mesh_node(uint32_t pass_num,
@@ -180,11 +321,29 @@ class FramePacket {
                              uint32_t material_id);
 
   const Vector<MeshNode>& get_mesh_nodes() const;
+  // The main view's camera, the one sorting and level of detail go by.
   const CameraNode& get_camera_node() const;
+  // Every view's camera, in the scene's order. The pipeline draws each view
+  // into its camera's viewport, see Pipeline::render.
+  const Vector<CameraNode>& get_camera_nodes() const;
   const Vector<DirectionalLightNode>& get_directional_light_nodes() const;
+  const Vector<PointLightNode>& get_point_light_nodes() const;
+  const Vector<SpotLightNode>& get_spot_light_nodes() const;
   Vector<MeshNode>& get_mesh_nodes();
   Vector<DirectionalLightNode>& get_directional_light_nodes();
-
+  Vector<PointLightNode>& get_point_light_nodes();
+  Vector<SpotLightNode>& get_spot_light_nodes();
+  const Vector<MeshNode>& get_created_static_mesh_nodes() const;
+  const Vector<uint32_t>& get_destroyed_static_mesh_node_ids() const;
+
+  // Appends one of the renderer's static nodes to the mesh nodes, on the
+  // render thread. It must fit in the room reserved by the simulation:
+  // nothing can be allocated from the frame packet's buffers past its
+  // construction.
+  void add_static_mesh_node(const MeshNode& mesh_node);
+
+  // Groups the meshes by material, front to back within a material so that
+  // early depth testing rejects as many hidden fragments as possible.
   void sort_mesh_nodes();
 
  public:
@@ -199,6 +358,21 @@ class FramePacket {
       destination_nodes.push_back(node);
     }
   }
+
+  // Places the nodes following a transform where the hierarchy says.
+  template <typename T, typename U>
+  void copy_nodes_(const std::list<T>& source_nodes,
+                   Vector<U>& destination_nodes,
+                   const TransformHierarchy& transforms) {
+    destination_nodes.reserve(source_nodes.size());
+    for (const T& node : source_nodes) {
+      destination_nodes.push_back(node);
+      if (node.transform_id != TransformHierarchy::kNoTransform) {
+        destination_nodes.back().set_model_matrix(
+            transforms.get_world_matrix(node.transform_id));
+      }
+    }
+  }
 };
 
 template <typename T>
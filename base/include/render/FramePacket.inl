@@ -16,6 +16,7 @@
  */
 
 #include <algorithm>
+#include <cstring>
 #include <glm/gtc/matrix_transform.hpp>
 
 namespace donkey {
@@ -30,25 +31,93 @@ template <template <typename> class Allocator>
 FramePacket<Allocator>::FramePacket(const MeshNodeAllocator& allocator,
                                     donkey::CameraNode camera_node)
     : mesh_node_allocator_(allocator),
+      camera_node_allocator_(allocator),
       directional_light_node_allocator_(allocator),
+      point_light_node_allocator_(allocator),
+      spot_light_node_allocator_(allocator),
+      id_allocator_(allocator),
       mesh_nodes_(mesh_node_allocator_),
-      camera_node_(camera_node),
-      directional_light_nodes_(directional_light_node_allocator_) {}
+      camera_nodes_(1, camera_node, camera_node_allocator_),
+      directional_light_nodes_(directional_light_node_allocator_),
+      point_light_nodes_(point_light_node_allocator_),
+      spot_light_nodes_(spot_light_node_allocator_),
+      created_static_mesh_nodes_(mesh_node_allocator_),
+      destroyed_static_mesh_node_ids_(id_allocator_) {}
 
 template <template <typename> class Allocator>
 FramePacket<Allocator>::FramePacket(
-    std::list<::donkey::MeshNode> mesh_nodes,
-    std::list<::donkey::CameraNode> camera_nodes,
-    std::list<::donkey::DirectionalLightNode> directional_light_nodes,
+    const std::list<::donkey::MeshNode>& mesh_nodes,
+    const std::list<::donkey::CameraNode>& camera_nodes,
+    const std::list<::donkey::DirectionalLightNode>& directional_light_nodes,
+    const std::list<::donkey::PointLightNode>& point_light_nodes,
+    const std::list<::donkey::SpotLightNode>& spot_light_nodes,
     const MeshNodeAllocator& allocator)
     : mesh_node_allocator_(allocator),
+      camera_node_allocator_(allocator),
       directional_light_node_allocator_(allocator),
+      point_light_node_allocator_(allocator),
+      spot_light_node_allocator_(allocator),
+      id_allocator_(allocator),
       mesh_nodes_(mesh_node_allocator_),
-      camera_node_(camera_nodes.front()),
-      directional_light_nodes_(directional_light_node_allocator_) {
+      camera_nodes_(camera_node_allocator_),
+      directional_light_nodes_(directional_light_node_allocator_),
+      point_light_nodes_(point_light_node_allocator_),
+      spot_light_nodes_(spot_light_node_allocator_),
+      created_static_mesh_nodes_(mesh_node_allocator_),
+      destroyed_static_mesh_node_ids_(id_allocator_) {
   assert(camera_nodes.size() > 0);
+  copy_nodes_(camera_nodes, camera_nodes_);
   copy_nodes_(mesh_nodes, mesh_nodes_);
   copy_nodes_(directional_light_nodes, directional_light_nodes_);
+  copy_nodes_(point_light_nodes, point_light_nodes_);
+  copy_nodes_(spot_light_nodes, spot_light_nodes_);
+}
+
+template <template <typename> class Allocator>
+FramePacket<Allocator>::FramePacket(const ::donkey::Scene& scene,
+                                    const MeshNodeAllocator& allocator)
+    : mesh_node_allocator_(allocator),
+      camera_node_allocator_(allocator),
+      directional_light_node_allocator_(allocator),
+      point_light_node_allocator_(allocator),
+      spot_light_node_allocator_(allocator),
+      id_allocator_(allocator),
+      mesh_nodes_(mesh_node_allocator_),
+      camera_nodes_(camera_node_allocator_),
+      directional_light_nodes_(directional_light_node_allocator_),
+      point_light_nodes_(point_light_node_allocator_),
+      spot_light_nodes_(spot_light_node_allocator_),
+      created_static_mesh_nodes_(mesh_node_allocator_),
+      destroyed_static_mesh_node_ids_(id_allocator_) {
+  assert(scene.get_camera_nodes().size() > 0);
+  const TransformHierarchy& transforms = scene.get_transforms();
+  copy_nodes_(scene.get_camera_nodes(), camera_nodes_, transforms);
+  // Reserving doesn't touch the memory, the static nodes only cost their
+  // copy on the render thread.
+  mesh_nodes_.reserve(scene.get_mesh_nodes().size() +
+                      scene.get_static_mesh_nodes().size());
+  copy_nodes_(scene.get_mesh_nodes(), mesh_nodes_, transforms);
+  copy_nodes_(scene.get_directional_light_nodes(), directional_light_nodes_,
+              transforms);
+  copy_nodes_(scene.get_point_light_nodes(), point_light_nodes_, transforms);
+  copy_nodes_(scene.get_spot_light_nodes(), spot_light_nodes_, transforms);
+
+  // Static nodes following a transform stay where it was when they made it
+  // into a frame packet.
+  const std::vector<const ::donkey::MeshNode*>& created_nodes =
+      scene.get_created_static_mesh_nodes();
+  created_static_mesh_nodes_.reserve(created_nodes.size());
+  for (const ::donkey::MeshNode* mesh_node : created_nodes) {
+    created_static_mesh_nodes_.push_back(*mesh_node);
+    if (mesh_node->transform_id != TransformHierarchy::kNoTransform) {
+      created_static_mesh_nodes_.back().set_model_matrix(
+          transforms.get_world_matrix(mesh_node->transform_id));
+    }
+  }
+  const std::vector<uint32_t>& destroyed_ids =
+      scene.get_destroyed_static_mesh_node_ids();
+  destroyed_static_mesh_node_ids_.assign(destroyed_ids.begin(),
+                                         destroyed_ids.end());
 }
 
 template <template <typename> class Allocator>
@@ -71,7 +140,13 @@ FramePacket<Allocator>::get_mesh_nodes() const {
 
 template <template <typename> class Allocator>
 const CameraNode& FramePacket<Allocator>::get_camera_node() const {
-  return camera_node_;
+  return camera_nodes_.front();
+}
+
+template <template <typename> class Allocator>
+const typename FramePacket<Allocator>::template Vector<CameraNode>&
+FramePacket<Allocator>::get_camera_nodes() const {
+  return camera_nodes_;
 }
 
 template <template <typename> class Allocator>
@@ -80,6 +155,18 @@ FramePacket<Allocator>::get_directional_light_nodes() const {
   return directional_light_nodes_;
 }
 
+template <template <typename> class Allocator>
+const typename FramePacket<Allocator>::template Vector<PointLightNode>&
+FramePacket<Allocator>::get_point_light_nodes() const {
+  return point_light_nodes_;
+}
+
+template <template <typename> class Allocator>
+const typename FramePacket<Allocator>::template Vector<SpotLightNode>&
+FramePacket<Allocator>::get_spot_light_nodes() const {
+  return spot_light_nodes_;
+}
+
 template <template <typename> class Allocator>
 typename FramePacket<Allocator>::template Vector<MeshNode>&
 FramePacket<Allocator>::get_mesh_nodes() {
@@ -92,17 +179,58 @@ FramePacket<Allocator>::get_directional_light_nodes() {
   return directional_light_nodes_;
 }
 
+template <template <typename> class Allocator>
+typename FramePacket<Allocator>::template Vector<PointLightNode>&
+FramePacket<Allocator>::get_point_light_nodes() {
+  return point_light_nodes_;
+}
+
+template <template <typename> class Allocator>
+typename FramePacket<Allocator>::template Vector<SpotLightNode>&
+FramePacket<Allocator>::get_spot_light_nodes() {
+  return spot_light_nodes_;
+}
+
+template <template <typename> class Allocator>
+const typename FramePacket<Allocator>::template Vector<MeshNode>&
+FramePacket<Allocator>::get_created_static_mesh_nodes() const {
+  return created_static_mesh_nodes_;
+}
+
+template <template <typename> class Allocator>
+const typename FramePacket<Allocator>::template Vector<uint32_t>&
+FramePacket<Allocator>::get_destroyed_static_mesh_node_ids() const {
+  return destroyed_static_mesh_node_ids_;
+}
+
+template <template <typename> class Allocator>
+void FramePacket<Allocator>::add_static_mesh_node(
+    const MeshNode& mesh_node) {
+  assert(mesh_nodes_.size() < mesh_nodes_.capacity());
+  mesh_nodes_.push_back(mesh_node);
+}
+
 template <template <typename> class Allocator>
 void FramePacket<Allocator>::sort_mesh_nodes() {
+  // The bits of a positive float sort like the float itself.
+  for (MeshNode& mesh_node : mesh_nodes_) {
+    glm::vec4 position =
+        camera_nodes_.front().view * glm::vec4(mesh_node.position, 1.0f);
+    float depth = std::max(-position.z, 0.0f);
+    uint32_t depth_bits;
+    std::memcpy(&depth_bits, &depth, sizeof(depth_bits));
+    mesh_node.sort_key =
+        (static_cast<uint64_t>(mesh_node.material_id) << 32) | depth_bits;
+  }
   std::sort(mesh_nodes_.begin(), mesh_nodes_.end(),
             [](const MeshNode& lhs, const MeshNode& rhs) {
-              return (lhs.material_id < rhs.material_id);
+              return (lhs.sort_key < rhs.sort_key);
             });
 }
 
 template <template <typename> class Allocator>
 void FramePacket<Allocator>::set_camera_node(CameraNode&& node) {
-  camera_node_ = node;
+  camera_nodes_.front() = node;
 }
 
 }  // namespace render
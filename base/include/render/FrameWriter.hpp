@@ -0,0 +1,79 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace donkey {
+namespace render {
+
+// Saves frames as `path_prefix`<frame index>.png on its own thread, so that
+// encoding them stays off the render thread, e.g. out of a
+// gl::FrameReader::Callback. write only copies the pixels, it only blocks
+// when kMaxPendingFrames frames are already waiting to be saved.
+class FrameWriter {
+ public:
+  enum { kMaxPendingFrames = 8 };
+
+ private:
+  struct Frame {
+    std::string path;
+    std::vector<uint8_t> pixels;
+    int width;
+    int height;
+  };
+
+  std::string path_prefix_;
+  std::deque<Frame> frames_;
+  bool writing_;  // a frame popped from frames_ isn't saved yet
+  bool quit_;
+  std::mutex mutex_;
+  std::condition_variable work_condition_;
+  std::condition_variable done_condition_;
+  std::thread worker_;
+
+ public:
+  explicit FrameWriter(const std::string& path_prefix);
+  // Saves the frames still pending.
+  ~FrameWriter();
+  FrameWriter(const FrameWriter&) = delete;
+  FrameWriter& operator=(const FrameWriter&) = delete;
+
+  // `pixels` are RGBA with the top row first, as handed to a
+  // gl::FrameReader::Callback.
+  void write(std::size_t frame_index,
+             const uint8_t* pixels,
+             int width,
+             int height);
+  // Waits until all the frames written so far are saved.
+  void flush();
+
+ private:
+  void work_();
+  static void save_(const Frame& frame);
+};
+
+}  // namespace render
+}  // namespace donkey
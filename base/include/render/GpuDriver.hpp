@@ -0,0 +1,52 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "render/CommandBucket.hpp"
+#include "render/GpuResourceManager.hpp"
+#include "render/UniformBlock.hpp"
+
+namespace donkey {
+namespace render {
+
+// What the renderer needs from a backend: somewhere to record a frame's
+// uniforms, something to execute the recorded commands and the resources
+// they refer to. See gl::Driver and headless::Driver.
+class GpuDriver {
+ public:
+  virtual ~GpuDriver() {}
+  // Returns the storage the next command bucket writes its uniform blocks
+  // to. Must be called once before recording each frame.
+  virtual UniformStorage begin_frame() = 0;
+  virtual void execute_commands(const CommandBucket& commands) = 0;
+  virtual GpuResourceManager& get_resource_manager() = 0;
+  // Latest known count of samples between CommandBucket::begin_sample_count
+  // and end_sample_count.
+  virtual uint64_t get_samples_passed() const = 0;
+  // Draw calls the last executed command bucket made.
+  virtual std::size_t get_draw_call_count() const = 0;
+  // Milliseconds the GPU spent executing a recent command bucket, a few
+  // frames old, 0 until known.
+  virtual float get_gpu_frame_time() const = 0;
+};
+
+}  // namespace render
+}  // namespace donkey
@@ -21,6 +21,7 @@
 #include <vector>
 
 #include "render/AMaterial.hpp"
+#include "render/CommandBucket.hpp"
 #include "render/GpuProgram.hpp"
 #include "render/Mesh.hpp"
 #include "render/State.hpp"
@@ -39,6 +40,10 @@ class GpuResourceManager {
 
   virtual uint32_t load_gpu_program_from_file(const std::string& vs_path,
                                               const std::string& fs_path) = 0;
+  // For generated shaders, see PipelineGenerator.
+  virtual uint32_t load_gpu_program_from_sources(
+      const std::string& vs_sources,
+      const std::string& fs_sources) = 0;
 
   virtual uint32_t create_mesh(const std::vector<float>& positions,
                                const std::vector<float>& normals,
@@ -47,6 +52,9 @@ class GpuResourceManager {
                                const std::vector<float>& bitangents,
                                const std::vector<uint32_t>& indices) = 0;
 
+  // Draw of a whole mesh, for CommandBucket::multi_draw_elements.
+  virtual DrawElementsIndirect get_mesh_draw(uint32_t id) const = 0;
+
   virtual uint32_t create_material(uint32_t gpu_program) = 0;
 
   virtual uint32_t create_texture(std::size_t width,
@@ -55,6 +63,10 @@ class GpuResourceManager {
                                   pixel::InternalFormat internal_format,
                                   pixel::ComponentType component_type) = 0;
 
+  // Creates an empty texture buffer. Its contents are streamed every frame
+  // with CommandBucket::update_texture_buffer.
+  virtual uint32_t create_texture_buffer(pixel::BufferFormat format) = 0;
+
   virtual uint32_t create_framebuffer(
       uint32_t depth_rt_id,
       const std::vector<uint32_t>& color_rt_ids) = 0;
@@ -65,6 +77,16 @@ class GpuResourceManager {
   virtual uint32_t create_state(const render::State& state) = 0;
 
   virtual AMaterial& get_material(std::uint32_t id) = 0;
+
+  // Ids are SlotMap handles: a destroyed resource's id is stale right away
+  // and its slot may be reused by the next resource created. What the GPU
+  // holds for it is only released once the GPU is done with the frames
+  // executed so far.
+  virtual void destroy_texture(uint32_t id) = 0;
+  virtual void destroy_gpu_program(uint32_t id) = 0;
+  virtual void destroy_mesh(uint32_t id) = 0;
+  virtual void destroy_material(uint32_t id) = 0;
+  virtual void destroy_state(uint32_t id) = 0;
 };
 
 }  // namespace render
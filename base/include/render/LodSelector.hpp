@@ -0,0 +1,79 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "render/FramePacket.hpp"
+#include "render/Mesh.hpp"
+
+namespace donkey {
+namespace render {
+
+// Picks the level of its mesh's LOD chain each mesh node is drawn with: the
+// coarsest one whose simplification error, projected on screen at the
+// node's distance, stays under a number of pixels. Nodes remember their
+// level from one frame to the next, and only switch once the projected
+// error crosses the threshold by a margin, so that nodes hovering around a
+// threshold don't keep popping between two levels.
+class LodSelector {
+ public:
+  enum : uint8_t { kNoLod = 0xff };
+
+  // Counters of the last call to select.
+  struct Statistics {
+    std::size_t node_count;
+    std::size_t index_count;       // drawn
+    std::size_t full_index_count;  // that would have been without LODs
+  };
+
+ private:
+  float pixel_error_;
+  float hysteresis_;  // margin, relative to pixel_error_
+  std::vector<uint8_t> node_lods_;  // by MeshNode::id, kNoLod if unknown
+  Statistics statistics_;
+
+ public:
+  LodSelector();
+
+  // Largest error allowed on screen, 1 pixel by default.
+  void set_pixel_error(float pixel_error);
+
+  // Sets the lod of each of `mesh_nodes` as seen from `camera_node`.
+  // `get_mesh` returns the Mesh of a mesh id.
+  template <typename GetMesh>
+  void select(const CameraNode& camera_node,
+              StackVector<MeshNode>& mesh_nodes,
+              GetMesh get_mesh);
+
+  // Level of `mesh` when a model space unit covers `pixels_per_unit`
+  // pixels, `previous_lod` is the level it had last frame or kNoLod.
+  uint32_t select(const Mesh& mesh,
+                  float pixels_per_unit,
+                  uint32_t previous_lod) const;
+
+  const Statistics& get_statistics() const;
+};
+
+}  // namespace render
+}  // namespace donkey
+
+#include "LodSelector.inl"
@@ -0,0 +1,71 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <algorithm>
+#include <glm/glm.hpp>
+
+namespace donkey {
+namespace render {
+
+template <typename GetMesh>
+void LodSelector::select(const CameraNode& camera_node,
+                         StackVector<MeshNode>& mesh_nodes,
+                         GetMesh get_mesh) {
+  statistics_ = Statistics();
+  // Orthographic projections keep the same scale at any distance.
+  bool perspective = (camera_node.projection[2][3] != 0.0f);
+  float pixels_per_unit =
+      camera_node.viewport_size.y * 0.5f * camera_node.projection[1][1];
+  for (MeshNode& mesh_node : mesh_nodes) {
+    const Mesh& mesh = get_mesh(mesh_node.mesh_id);
+    uint32_t previous_lod = kNoLod;
+    if (mesh_node.id < node_lods_.size())
+      previous_lod = node_lods_[mesh_node.id];
+
+    mesh_node.lod = 0;
+    if (!mesh.lods.empty()) {
+      glm::vec3 scale = glm::abs(mesh_node.scale);
+      float max_scale = std::max(std::max(scale.x, scale.y), scale.z);
+      float distance = 1.0f;
+      if (perspective) {
+        // Distance to the closest point of the bounding sphere.
+        glm::vec4 center(0.5f * (mesh.min + mesh.max), 1.0f);
+        center = camera_node.view * mesh_node.get_model_matrix() * center;
+        float radius = 0.5f * glm::length(mesh.max - mesh.min) * max_scale;
+        distance = std::max(glm::length(glm::vec3(center)) - radius,
+                            camera_node.near_plane);
+      }
+      mesh_node.lod =
+          select(mesh, pixels_per_unit * max_scale / distance, previous_lod);
+    }
+
+    if (mesh_node.id != MeshNode::kNoId) {
+      if (mesh_node.id >= node_lods_.size())
+        node_lods_.resize(mesh_node.id + 1, kNoLod);
+      node_lods_[mesh_node.id] = static_cast<uint8_t>(mesh_node.lod);
+    }
+    ++statistics_.node_count;
+    statistics_.full_index_count += mesh.index_count;
+    statistics_.index_count += (mesh_node.lod == 0)
+                                   ? mesh.index_count
+                                   : mesh.lods[mesh_node.lod - 1].index_count;
+  }
+}
+
+}  // namespace render
+}  // namespace donkey
@@ -29,17 +29,6 @@ struct Material : Resource {
   unsigned int uv_location;
   unsigned int tangent_location;
   unsigned int bitangent_location;
-  unsigned int model_location;
-  unsigned int view_location;
-  unsigned int projection_location;
-  unsigned int gbuffer_projection_inverse_location;
-  unsigned int gbuffer_view_location;
-  unsigned int gbuffer_projection_params_location;
-  unsigned int ambient_location;
-  unsigned int light_dir_location;
-  unsigned int light_diffuse_location;
-  unsigned int light_specular_location;
-  unsigned int camera_position_location;
 
   Material(std::uint32_t id,
            std::size_t program_id,
@@ -47,37 +36,14 @@ struct Material : Resource {
            int normal_location,
            int uv_location,
            int tangent_location,
-           int bitangent_location,
-           int model_location,
-           int view_location,
-           int projection_location,
-           int gbuffer_projection_inverse_location,
-           int gbuffer_projection_params_location,
-           int gbuffer_view_location,
-           int ambient_location,
-           int light_dir_location,
-           int light_diffuse_location,
-           int light_specular_location,
-           int camera_position_location)
+           int bitangent_location)
       : Resource(id),
         program_id(program_id),
         position_location(position_location),
         normal_location(normal_location),
         uv_location(uv_location),
         tangent_location(tangent_location),
-        bitangent_location(bitangent_location),
-        model_location(model_location),
-        view_location(view_location),
-        projection_location(projection_location),
-        gbuffer_projection_inverse_location(
-            gbuffer_projection_inverse_location),
-        gbuffer_view_location(gbuffer_view_location),
-        gbuffer_projection_params_location(gbuffer_projection_params_location),
-        ambient_location(ambient_location),
-        light_dir_location(light_dir_location),
-        light_diffuse_location(light_diffuse_location),
-        light_specular_location(light_specular_location),
-        camera_position_location(camera_position_location) {}
+        bitangent_location(bitangent_location) {}
 };
 
 }  // namespace render
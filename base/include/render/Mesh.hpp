@@ -18,6 +18,8 @@
 #pragma once
 
 #include <cstddef>
+#include <glm/vec3.hpp>
+#include <vector>
 
 #include "render/Resource.hpp"
 
@@ -25,9 +27,29 @@ namespace donkey {
 namespace render {
 
 struct Mesh : Resource {
+  // Simplified version of a mesh, drawn instead of it from far enough away.
+  struct Lod {
+    std::uint32_t gpu_resource_id;
+    std::size_t index_count;
+    float error;  // farthest from the full mesh a vertex moved, model space
+  };
+
   std::size_t index_count;
+  // Model space bounding box.
+  glm::vec3 min;
+  glm::vec3 max;
+  // Triangles rasterized by OcclusionCulling when the mesh hides what's
+  // behind it, empty otherwise. See ResourceManager::set_occluder.
+  std::vector<glm::vec3> occluder_positions;
+  std::vector<uint32_t> occluder_indices;
+  // Coarser and coarser, see ResourceManager::add_lod. Level 0 is the mesh
+  // itself and level i is lods[i - 1].
+  std::vector<Lod> lods;
 
-  Mesh(std::uint32_t id, std::size_t);
+  Mesh(std::uint32_t id,
+       std::size_t index_count,
+       const glm::vec3& min,
+       const glm::vec3& max);
 };
 
 }  // namespace render
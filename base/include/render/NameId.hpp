@@ -0,0 +1,56 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+#include "hash.hpp"
+
+namespace donkey {
+namespace render {
+
+// Hashed name of a shader variable (attribute, uniform or uniform block).
+// Built-in names are hashed at compile time, names given by materials are
+// hashed once when their slots are registered.
+typedef uint64_t NameId;
+
+constexpr NameId make_name_id(std::string_view name) {
+  return hash_fnv1a(name);
+}
+
+namespace name_id {
+
+constexpr NameId kPosition = make_name_id("position");
+constexpr NameId kNormal = make_name_id("normal");
+constexpr NameId kUv = make_name_id("uv");
+constexpr NameId kTangent = make_name_id("tangent");
+constexpr NameId kBitangent = make_name_id("bitangent");
+constexpr NameId kDrawId = make_name_id("draw_id");
+constexpr NameId kDrawBuffer = make_name_id("draw_buffer");
+constexpr NameId kCameraBlock = make_name_id("CameraBlock");
+constexpr NameId kLightBlock = make_name_id("LightBlock");
+constexpr NameId kObjectBlock = make_name_id("ObjectBlock");
+constexpr NameId kMaterialBlock = make_name_id("MaterialBlock");
+constexpr NameId kShadowBlock = make_name_id("ShadowBlock");
+
+}  // namespace name_id
+
+}  // namespace render
+}  // namespace donkey
@@ -0,0 +1,166 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "render/FramePacket.hpp"
+#include "render/Mesh.hpp"
+
+namespace donkey {
+namespace render {
+
+// Culls the meshes hidden behind occluders on the CPU, before any command is
+// recorded for them. The occluders' triangles are rasterized into a coarse
+// depth buffer split in 8x4 pixel tiles, and the bounding box of every mesh
+// is then tested against it. Each tile only keeps a conservative far depth
+// and a partially covered layer in front of it, a 32-bit coverage mask and
+// its own far depth, which are merged once the mask is full:
+// J. Hasselgren, M. Andersson, T. Akenine-Moller, "Masked Software Occlusion
+// Culling", HPG 2016.
+// Depths are view space distances, so only perspective cameras cull
+// anything. Meshes outside of the frustum are culled on the way.
+class OcclusionCulling {
+ public:
+  enum {
+    kWidth = 320,  // in pixels, whatever the viewport's aspect ratio
+    kHeight = 192,
+    kTileWidth = 8,
+    kTileHeight = 4,
+    kTileCountX = kWidth / kTileWidth,
+    kTileCountY = kHeight / kTileHeight,
+    kParallelTriangleCount = 256  // fewer are rasterized on calling thread
+  };
+
+  // Counters of the last call to cull, or since the last call to begin.
+  struct Statistics {
+    std::size_t occluder_count;
+    std::size_t triangle_count;  // front facing triangles rasterized
+    std::size_t tested_count;
+    std::size_t frustum_culled_count;
+    std::size_t occlusion_culled_count;
+  };
+
+ private:
+  // Screen space triangle, counter-clockwise, set up for rasterization.
+  struct Triangle {
+    // Edge i goes from vertex i to the next one. A pixel p is inside if
+    // a * (p.x - edge_x) + b * (p.y - edge_y) >= 0 for every edge.
+    float a[3];
+    float b[3];
+    // One of the edge's ends, the same whichever triangle the edge is part
+    // of: the edge functions of two triangles sharing it are then exactly
+    // opposite, and every pixel along it is inside one of them.
+    float edge_x[3];
+    float edge_y[3];
+    float x[3];
+    float y[3];
+    // 1 / w is linear in screen space, 1 / w at p is
+    // inverse_w + inverse_w_dx * (p.x - x[0]) + inverse_w_dy * (p.y - y[0]).
+    float inverse_w;
+    float inverse_w_dx;
+    float inverse_w_dy;
+    float min_inverse_w;  // of the three vertices
+    int first_tile_x;
+    int last_tile_x;
+    int first_tile_y;
+    int last_tile_y;
+  };
+
+  // Range of tile rows rasterized by one thread.
+  struct Band {
+    int first_tile_y;
+    int last_tile_y;  // exclusive
+  };
+
+ private:
+  glm::mat4 view_projection_;
+  float near_plane_;
+  bool perspective_;
+  std::vector<glm::vec4> clip_positions_;
+  std::vector<Triangle> triangles_;
+  // Tiles, as a structure of arrays padded so that 4 tiles can be loaded at
+  // once from any of them.
+  std::vector<float> far_depths_;
+  std::vector<float> layer_depths_;
+  std::vector<uint32_t> layer_masks_;
+  Statistics statistics_;
+
+  // bands_[0] is rasterized by the calling thread, bands_[i] by
+  // workers_[i - 1].
+  std::vector<Band> bands_;
+  std::vector<std::thread> workers_;
+  std::mutex mutex_;
+  std::condition_variable work_condition_;
+  std::condition_variable done_condition_;
+  uint64_t generation_;
+  std::size_t pending_workers_;
+  bool quit_;
+
+ private:
+  void add_triangle_(const glm::vec4& a, const glm::vec4& b,
+                     const glm::vec4& c);
+  void setup_triangle_(const glm::vec4 (&positions)[3]);
+  uint32_t get_coverage_(const Triangle& triangle, int x, int y) const;
+  void update_tile_(std::size_t tile, uint32_t coverage, float depth);
+  unsigned int farther_4_(std::size_t tile, float depth) const;
+  void rasterize_band_(const Band& band);
+  void rasterize_all_(std::size_t band_count);
+  void work_(std::size_t worker);
+
+ public:
+  OcclusionCulling();
+  ~OcclusionCulling();
+  OcclusionCulling(const OcclusionCulling&) = delete;
+  OcclusionCulling& operator=(const OcclusionCulling&) = delete;
+
+  // Rasterizes the occluders among `mesh_nodes` and removes the nodes which
+  // are hidden or out of view, keeping the others in order. `get_mesh`
+  // returns the Mesh of a mesh id. Returns the number of culled nodes.
+  template <typename GetMesh>
+  std::size_t cull(const CameraNode& camera_node,
+                   StackVector<MeshNode>& mesh_nodes,
+                   GetMesh get_mesh);
+
+  // The steps of cull: clear the depth buffer, queue the triangles of the
+  // occluders, rasterize them and test bounding boxes against the result.
+  // begin returns false when the camera can't cull, and every box is then
+  // visible.
+  bool begin(const CameraNode& camera_node);
+  void add_occluder(const glm::mat4& model, const Mesh& mesh);
+  void rasterize();
+  bool is_visible(const glm::mat4& model, const Mesh& mesh);
+
+  // Conservative depth of a pixel: nothing behind it is visible.
+  float get_depth(int x, int y) const;
+  const Statistics& get_statistics() const;
+};
+
+}  // namespace render
+}  // namespace donkey
+
+#include "OcclusionCulling.inl"
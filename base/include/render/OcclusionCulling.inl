@@ -0,0 +1,53 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+namespace donkey {
+namespace render {
+
+template <typename GetMesh>
+std::size_t OcclusionCulling::cull(const CameraNode& camera_node,
+                                   StackVector<MeshNode>& mesh_nodes,
+                                   GetMesh get_mesh) {
+  if (!begin(camera_node))
+    return 0;
+  for (const MeshNode& mesh_node : mesh_nodes) {
+    const Mesh& mesh = get_mesh(mesh_node.mesh_id);
+    if (!mesh.occluder_indices.empty())
+      add_occluder(mesh_node.get_model_matrix(), mesh);
+  }
+  rasterize();
+
+  // Compact the visible nodes in place, they may already be sorted.
+  std::size_t visible_count = 0;
+  for (std::size_t i = 0; i < mesh_nodes.size(); ++i) {
+    const MeshNode& mesh_node = mesh_nodes[i];
+    if (!is_visible(mesh_node.get_model_matrix(),
+                    get_mesh(mesh_node.mesh_id))) {
+      continue;
+    }
+    if (visible_count != i)
+      mesh_nodes[visible_count] = mesh_node;
+    ++visible_count;
+  }
+  std::size_t culled_count = mesh_nodes.size() - visible_count;
+  mesh_nodes.erase(mesh_nodes.begin() + visible_count, mesh_nodes.end());
+  return culled_count;
+}
+
+}  // namespace render
+}  // namespace donkey
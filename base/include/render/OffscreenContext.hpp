@@ -0,0 +1,67 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <EGL/egl.h>
+
+namespace donkey {
+
+namespace render {
+
+// GL contexts without a window nor a display server, for rendering on
+// servers, GPU-less ones included with Mesa's llvmpipe. Mirrors Window's
+// contexts; there is no back buffer, frames are drawn to a gl::FrameReader.
+//
+// Uses EGL's surfaceless platform when the implementation has it, the
+// default display otherwise, and binds contexts without a surface when
+// allowed, to a 1x1 pbuffer otherwise.
+class OffscreenContext {
+ private:
+  EGLDisplay display_;
+  EGLSurface surface_;  // EGL_NO_SURFACE when surfaceless
+  EGLContext render_context_;
+  EGLContext ancillary_context_;
+  int width_;
+  int height_;
+
+ public:
+  typedef EGLContext Context;
+
+  // `width` and `height` are the size of the frames, for the renderer.
+  OffscreenContext(int width, int height);
+  ~OffscreenContext();
+  OffscreenContext(const OffscreenContext&) = delete;
+  OffscreenContext& operator=(const OffscreenContext&) = delete;
+  // Whether EGL has a display and a config to render with, so that callers
+  // can do without rather than hit the constructor's asserts. Only call it
+  // while no OffscreenContext exists, it terminates the display.
+  static bool is_available();
+  Context get_render_context();
+  Context get_ancillary_context();
+  void make_current(Context context) const;
+  void free_context() const;
+  int get_width() const;
+  int get_height() const;
+
+ private:
+  static EGLDisplay get_display_();
+  bool has_extension_(const char* extension) const;
+};
+
+}  // namespace render
+}  // namespace donkey
@@ -17,59 +17,154 @@
 
 #pragma once
 
+#include "render/ClusteredLighting.hpp"
+#include "render/GpuDriver.hpp"
+#include "render/LodSelector.hpp"
+#include "render/OcclusionCulling.hpp"
 #include "render/RenderPass.hpp"
-#include "render/Window.hpp"
-#include "render/gl/Driver.hpp"
+#include "render/ShadowCascades.hpp"
+#include "render/ViewCulling.hpp"
 
 namespace donkey {
 namespace render {
 
 class Pipeline {
  private:
+  enum : uint32_t { kNoMaterial = 0xffffffff };
+  enum : std::size_t { kNoBucket = static_cast<std::size_t>(-1) };
+  enum : uint32_t { kWindowFramebuffer = 0xffffffff };
+
+  // Indices of the gbuffer frame packet's mesh nodes drawn by the passes of
+  // a layer mask, in the packet's order, see bucket_mesh_nodes_.
+  struct LayerBucket {
+    uint32_t layer_mask;
+    std::vector<std::vector<uint32_t>> node_indices;  // by view
+  };
+
   std::vector<RenderPass> render_passes_;
-  Window* window_;
-  Window::Context render_context_;
-  gl::Driver* driver_;
+  // One per distinct layer mask, shared by the passes drawing the gbuffer
+  // frame packet's meshes with it.
+  std::vector<LayerBucket> layer_buckets_;
+  std::vector<std::size_t> pass_buckets_;  // by pass, kNoBucket if none
+  // 0 to n - 1 for the passes with their own frame packet, light volume
+  // passes don't look at the mesh nodes.
+  std::vector<uint32_t> all_node_indices_;
+  GpuDriver* driver_;
   GpuResourceManager& gpu_resource_manager_;
   ResourceManager* resource_manager_;
+  ClusteredLighting clustered_lighting_;
+  OcclusionCulling occlusion_culling_;
+  bool occlusion_culling_enabled_;
+  ViewCulling view_culling_;
+  LodSelector lod_selector_;
+
+  // Light volumes, see add_light_volume_pass.
+  uint32_t sphere_mesh_id_;
+  uint32_t cone_mesh_id_;
+  uint32_t stencil_material_id_;
+  uint32_t light_volume_material_id_;
+  uint32_t stencil_state_id_;
+  uint32_t light_volume_state_id_;
+  uint32_t depth_copy_material_id_;
+  uint32_t depth_copy_mesh_id_;
+  uint32_t depth_copy_state_id_;
+
+  // Depth pre-pass, see add_depth_prepass.
+  uint32_t depth_prepass_material_id_;
+  uint32_t depth_prepass_state_id_;
+  uint32_t depth_equal_state_id_;
+
+  // Cascaded shadow maps, see add_shadow_pass.
+  ShadowCascades shadow_cascades_;
+  uint32_t shadow_framebuffer_id_;
+  uint32_t static_shadow_framebuffer_id_;
+  uint32_t shadow_material_id_;
+  uint32_t shadow_copy_material_id_;
+  uint32_t shadow_quad_mesh_id_;
+  uint32_t shadow_copy_state_id_;
+
+  // Set back after the passes above change the state.
+  uint32_t default_state_id_;
+
+  bool overdraw_counter_enabled_;
+
+  // Fraction of their viewports the views are drawn at, see
+  // set_resolution_scale.
+  float resolution_scale_;
+
+  int gbuffer_layout_;
+
+  // Multi-draw submission, see set_multi_draw. The model matrices of the
+  // nodes a view draws are uploaded once for all its passes, after the ones
+  // of the views before in the draw buffer. Each draw finds its own at its
+  // base instance, draw_instances_ by node index.
+  bool multi_draw_enabled_;
+  uint32_t draw_buffer_id_;
+  std::vector<std::vector<uint32_t>> view_node_indices_;  // by view
+  std::vector<glm::mat4> draw_models_;
+  std::vector<uint32_t> draw_instances_;
+  std::size_t draw_model_count_;  // uploaded so far this frame
 
   typedef std::list<StackFramePacket> FramePacketList;
   std::list<StackFramePacket> frame_packets_;
 
  private:
-  void bind_light_uniforms_(CommandBucket& render_commands,
-                            const Material& material,
-                            const glm::mat4& view,
-                            const DirectionalLightNode* light_node) const;
-  void bind_camera_uniforms_(CommandBucket& render_commands,
-                             const Material& material,
-                             const CameraNode& camera_node) const;
-  void bind_mesh_uniforms_(CommandBucket& render_commands,
-                           const Material& material,
-                           const MeshNode& mesh_node) const;
-  void render_geometry_(size_t pass_num,
-                        const RenderPass& render_pass,
+  // Sorts the mesh nodes into the layer buckets of each view in a single
+  // pass, once a frame, so that each pass only goes through the nodes it
+  // draws. A view draws the nodes it may see sharing a layer with its camera.
+  void bucket_mesh_nodes_(const StackVector<MeshNode>& mesh_nodes,
+                          const StackVector<CameraNode>& camera_nodes);
+  // Uploads the model matrices of the nodes the view draws, for the
+  // multi-draws of all its passes.
+  void upload_draw_models_(const StackVector<MeshNode>& mesh_nodes,
+                           std::size_t view,
+                           CommandBucket& render_commands);
+  void render_geometry_(const RenderPass& render_pass,
                         const StackVector<MeshNode>& mesh_nodes,
+                        const std::vector<uint32_t>& node_indices,
                         const CameraNode& camera_node,
                         const CameraNode* last_camera_node,
-                        const StackVector<DirectionalLightNode>& light_nodes,
                         CommandBucket& render_commands,
                         ResourceManager* resource_manager,
                         GpuResourceManager* gpu_resource_manager);
+  void render_light_volumes_(const RenderPass& render_pass,
+                             CommandBucket& render_commands);
+  // Draws the casters of the cascades ShadowCascades::update picked into the
+  // shadow atlas, before any culling removes them from the frame packet.
+  void render_shadows_(const StackFramePacket& frame_packet,
+                       CommandBucket& render_commands);
+  void render_shadow_casters_(const RenderPass& render_pass,
+                              const MeshNode* mesh_nodes,
+                              const std::vector<uint32_t>& node_indices,
+                              CommandBucket& render_commands);
+  void render_depth_prepass_(const RenderPass& render_pass,
+                             const StackVector<MeshNode>& mesh_nodes,
+                             const std::vector<uint32_t>& node_indices,
+                             CommandBucket& render_commands);
+  // `material_id` overrides the nodes' materials unless it's kNoMaterial.
+  void render_multi_draws_(const RenderPass& render_pass,
+                           const StackVector<MeshNode>& mesh_nodes,
+                           const std::vector<uint32_t>& node_indices,
+                           uint32_t material_id,
+                           CommandBucket& render_commands);
   void execute_pass_(size_t pass_num,
                      const RenderPass& render_pass,
                      const StackFramePacket& frame_packet,
+                     std::size_t view,
+                     const CameraNode& view_camera_node,
+                     const CameraNode& window_camera_node,
                      const CameraNode* last_camera_node,
-                     const StackVector<DirectionalLightNode>& light_nodes,
                      CommandBucket& render_commands,
                      ResourceManager* resource_manager,
                      GpuResourceManager* gpu_resource_manager);
 
  public:
-  Pipeline(Window* window,
-           gl::Driver* driver,
-           ResourceManager* resource_manager);
+  Pipeline(GpuDriver* driver, ResourceManager* resource_manager);
   ~Pipeline();
+  // Records every pass once per view of the frame packet, each camera's
+  // view drawn into its own viewport of the same framebuffers, scaled by the
+  // resolution scale. Culling and levels of detail are worked out once for
+  // all the views, lights are binned for each.
   void render(StackFramePacket* frame_packet, CommandBucket& render_commands);
   void add_render_pass(const RenderPass& render_pass);
   void add_render_pass(RenderPass&& render_pass);
@@ -81,11 +176,98 @@ class Pipeline {
                        bool depth_test,
                        bool lighting,
                        bool blending);
+  // Draws the frame packet's meshes in `layer_mask`. `depth_equal` passes
+  // come after a depth pre-pass into the same depth buffer, they must not
+  // clear depth and don't write it.
   void add_render_pass(uint32_t framebuffer_id,
                        GLint clear_bits,
                        bool depth_test,
                        bool lighting,
-                       bool blending);
+                       bool blending,
+                       bool depth_equal,
+                       uint32_t layer_mask =
+                           ::donkey::SceneNode::kAllLayers);
+  // Lays down the depth of the frame packet's meshes with `material_id`, a
+  // program reading positions only and writing no color, so that the pass
+  // drawing them afterwards only shades the visible fragments. That pass
+  // should draw the same layers.
+  void add_depth_prepass(uint32_t framebuffer_id,
+                         GLint clear_bits,
+                         uint32_t material_id,
+                         uint32_t layer_mask =
+                             ::donkey::SceneNode::kAllLayers);
+  // Shades the point and spot lights in view by drawing their bounding
+  // volume, a unit sphere and a unit cone along -z, twice: once with
+  // `stencil_material_id` to mark the pixels whose depth lies inside the
+  // volume, then with `light_material_id` to shade only those. Local lights
+  // aren't binned into clusters anymore once this pass exists.
+  // The light material samples the gbuffer's depth, so the framebuffer has
+  // a depth and stencil texture of its own rather than the gbuffer's: with
+  // it attached, the sampling would be a rendering feedback loop, undefined
+  // in GL 4.1 even with depth writes off (section 4.4.3 of the core
+  // profile's specification). `depth_copy_material_id` fills it with the
+  // gbuffer's depth first, drawing `quad_mesh_id` like add_shadow_pass'
+  // copy.
+  void add_light_volume_pass(uint32_t framebuffer_id,
+                             uint32_t sphere_mesh_id,
+                             uint32_t cone_mesh_id,
+                             uint32_t stencil_material_id,
+                             uint32_t light_material_id,
+                             uint32_t depth_copy_material_id,
+                             uint32_t quad_mesh_id);
+  // Draws the shadow cascades of the first directional light, see
+  // ShadowCascades, into a depth atlas of `settings.cascade_count` squares
+  // of `settings.resolution` texels side by side. With static caster
+  // caching, the static casters are drawn into a second atlas of the same
+  // size which `copy_material_id` copies from, a program drawing
+  // `quad_mesh_id`, a quad covering clip space, and writing the depth read
+  // at its fragment. Casters are drawn with `caster_material_id`, a program
+  // reading positions only.
+  void add_shadow_pass(uint32_t framebuffer_id,
+                       uint32_t static_framebuffer_id,
+                       uint32_t caster_material_id,
+                       uint32_t copy_material_id,
+                       uint32_t quad_mesh_id,
+                       const ShadowCascades::Settings& settings);
+  // Can't change the atlas' size, see ShadowCascades::set_settings.
+  void set_shadow_settings(const ShadowCascades::Settings& settings);
+  const ShadowCascades::Settings& get_shadow_settings() const;
+  const ShadowCascades::Statistics& get_shadow_statistics() const;
+  // The static nodes shadows are cast from, see
+  // ShadowCascades::set_static_casters.
+  void set_static_mesh_set(const StaticMeshSet* static_mesh_set);
+  // Texture buffers the lighting passes read the binned lights from, see
+  // ClusteredLighting.
+  void set_light_buffers(uint32_t light_buffer_id,
+                         uint32_t cluster_buffer_id,
+                         uint32_t light_index_buffer_id);
+  // Tells the shaders how the gbuffer is encoded, see
+  // DeferredRenderer::GBufferLayout.
+  void set_gbuffer_layout(int gbuffer_layout);
+  // Draws the views into their viewport scaled by `scale`, from the origin
+  // of the render targets, which must be large enough. Passes drawing to the
+  // window still cover the whole viewport, reading the scaled one: the last
+  // of them upscales the frame.
+  void set_resolution_scale(float scale);
+  float get_resolution_scale() const;
+  // Counts the samples passing the depth test in the passes drawing the
+  // frame packet's meshes, see GpuDriver::get_samples_passed.
+  void set_overdraw_counter(bool enabled);
+  // Removes the meshes hidden behind occluders, see
+  // ResourceManager::set_occluder, or out of the gbuffer camera's view from
+  // the frame packet before recording any pass. Frames with several views
+  // are only frustum culled, see ViewCulling.
+  void set_occlusion_culling(bool enabled);
+  const OcclusionCulling::Statistics& get_occlusion_statistics() const;
+  const ViewCulling::Statistics& get_view_culling_statistics() const;
+  // Largest simplification error, in pixels, the level of detail picked for
+  // each mesh node may show from the main view's camera, see LodSelector.
+  void set_lod_pixel_error(float pixel_error);
+  const LodSelector::Statistics& get_lod_statistics() const;
+  // Draws the meshes of the frame packet with one multi-draw per run of
+  // nodes sharing a material instead of one draw per node. Nodes whose
+  // program has no draw_id attribute are still drawn one by one.
+  void set_multi_draw(bool enabled);
   uint32_t get_albedo_rt_id() const;
   uint32_t get_normal_rt_id() const;
   uint32_t get_depth_rt_id() const;
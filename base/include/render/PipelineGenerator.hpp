@@ -20,6 +20,7 @@
 #include <list>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include "render/GpuResourceManager.hpp"
 #include "render/Pipeline.hpp"
@@ -28,6 +29,15 @@
 
 namespace donkey {
 namespace render {
+// Builds the pipeline as a render graph. The register_* methods only declare
+// textures and the passes reading and writing them, build() then:
+// - culls the passes whose render targets nobody reads,
+// - fuses full-screen passes into the next one when it is the only reader of
+//   their output, see shader_fusion::fuse,
+// - works out the range of passes each texture is used by,
+// - creates the textures, making the ones of the same size and format whose
+//   ranges don't overlap share a single texture,
+// - adds the remaining passes to the pipeline.
 class PipelineGenerator {
  public:
   PipelineGenerator(ResourceManager& resource_manager,
@@ -35,12 +45,24 @@ class PipelineGenerator {
                     Pipeline& pipeline,
                     int window_width,
                     int window_height);
+  // Persistent textures keep their content from a frame to the next, they
+  // never share their texture.
   void register_texture(const std::string& name,
                         int width,
                         int height,
                         pixel::Format format,
                         pixel::InternalFormat internal_format,
-                        pixel::ComponentType component_type);
+                        pixel::ComponentType component_type,
+                        bool persistent = false);
+  // Texture buffers are filled by the pipeline every frame and can be used
+  // as pass inputs like any other texture.
+  void register_texture_buffer(const std::string& name,
+                               pixel::BufferFormat format);
+  uint32_t get_texture_buffer_id(const std::string& name) const;
+  // ResourceManager id of a texture once built, aliased textures share it.
+  // Textures only culled passes use aren't created, their id is
+  // std::numeric_limits<uint32_t>::max().
+  uint32_t get_texture_id(const std::string& name) const;
   void register_pass(const std::list<std::string>& input_textures,
                      const std::list<std::string>& render_targets,
                      const std::string& vertex_shader_path,
@@ -49,26 +71,129 @@ class PipelineGenerator {
                      bool depth_test,
                      bool lighting,
                      bool blending);
+  // Draws the frame packet's meshes in `layer_mask`, see SceneNode::layers.
   void register_pass(const std::list<std::string>& render_targets,
                      GLint clear_bits,
                      bool depth_test,
                      bool lighting,
-                     bool blending);
+                     bool blending,
+                     uint32_t layer_mask = ::donkey::SceneNode::kAllLayers);
+  // See Pipeline::add_depth_prepass. Geometry passes registered after it
+  // only shade the fragments it kept.
+  void register_depth_prepass(const std::list<std::string>& render_targets,
+                              GLint clear_bits,
+                              const std::string& vertex_shader_path,
+                              const std::string& fragment_shader_path,
+                              uint32_t layer_mask =
+                                  ::donkey::SceneNode::kAllLayers);
+  // See Pipeline::add_light_volume_pass. The inputs must include the
+  // gbuffer's depth as depth_texture, which the copy program reads, and the
+  // render targets a depth and stencil texture of the same size.
+  void register_light_volume_pass(
+      const std::list<std::string>& input_textures,
+      const std::list<std::string>& render_targets,
+      const std::string& vertex_shader_path,
+      const std::string& stencil_fragment_shader_path,
+      const std::string& fragment_shader_path,
+      const std::string& copy_vertex_shader_path,
+      const std::string& copy_fragment_shader_path);
+  // See Pipeline::add_shadow_pass. Both atlases must be persistent depth
+  // textures of `settings.cascade_count` * `settings.resolution` by
+  // `settings.resolution` texels, the static atlas is only used when caching
+  // static casters. Register it before the passes reading the shadow atlas.
+  void register_shadow_pass(const std::string& shadow_texture,
+                            const std::string& static_shadow_texture,
+                            const std::string& caster_vertex_shader_path,
+                            const std::string& caster_fragment_shader_path,
+                            const std::string& copy_vertex_shader_path,
+                            const std::string& copy_fragment_shader_path,
+                            const ShadowCascades::Settings& settings);
+  // Must be called once, after the last register_* call. Prints the passes
+  // culled and the render target memory saved by aliasing.
+  void build();
 
  private:
+  enum class PassType {
+    kScreen,        // full-screen quad
+    kGeometry,      // the frame packet's meshes
+    kDepthPrepass,  // the frame packet's meshes, depth only
+    kLightVolumes,  // see Pipeline::add_light_volume_pass
+    kShadows        // see Pipeline::add_shadow_pass
+  };
+
+  struct TextureDeclaration {
+    int width;
+    int height;
+    pixel::Format format;
+    pixel::InternalFormat internal_format;
+    pixel::ComponentType component_type;
+    bool persistent;
+  };
+
+  struct PassDeclaration {
+    PassType type;
+    std::list<std::string> input_textures;
+    std::list<std::string> render_targets;
+    std::string vertex_shader_path;
+    std::string fragment_shader_path;
+    std::string stencil_fragment_shader_path;
+    // shadow cache copy, or gbuffer depth copy of the light volumes
+    std::string copy_vertex_shader_path;
+    std::string copy_fragment_shader_path;
+    GLint clear_bits;
+    bool depth_test;
+    bool lighting;
+    bool blending;
+    uint32_t layer_mask;
+    // Generated by fuse_passes_, replaces the fragment shader file.
+    std::string fragment_shader_sources;
+  };
+
+  // First and last pass using a texture, -1 if culled.
+  struct Lifetime {
+    int first_pass;
+    int last_pass;
+  };
+
+  bool overwrites_(const PassDeclaration& pass,
+                   const std::string& render_target) const;
+  std::vector<bool> cull_passes_() const;
+  bool can_fuse_(std::size_t producer,
+                 std::size_t consumer,
+                 const std::vector<bool>& live_passes) const;
+  void fuse_passes_(std::vector<bool>& live_passes);
+  std::unordered_map<std::string, Lifetime> get_lifetimes_(
+      const std::vector<bool>& live_passes) const;
+  void allocate_textures_(
+      const std::unordered_map<std::string, Lifetime>& lifetimes);
+  void add_pass_(const PassDeclaration& pass);
   void create_screen_mesh_(int window_width, int window_height);
-  uint32_t register_material_(const std::list<std::string>& input_textures,
-                              const std::string& vertex_shader_path,
-                              const std::string& fragment_shader_path);
+  uint32_t create_sphere_mesh_();
+  uint32_t create_cone_mesh_();
+  uint32_t create_quad_mesh_();
+  uint32_t register_material_(
+      const std::list<std::string>& input_textures,
+      const std::string& vertex_shader_path,
+      const std::string& fragment_shader_path,
+      const std::string& fragment_shader_sources = "");
   uint32_t register_framebuffer_(const std::list<std::string>& render_targets);
 
  private:
+  // Declaration order matters, it breaks ties when aliasing.
+  std::vector<std::string> texture_names_;
+  std::unordered_map<std::string, TextureDeclaration> texture_declarations_;
+  std::vector<PassDeclaration> pass_declarations_;
+  // Texture ids, filled by build(). Aliased textures share an id.
   std::unordered_map<std::string, uint32_t> id_map_;
+  // Texture buffers only exist on the GPU side, these are GPU resource ids.
+  std::unordered_map<std::string, uint32_t> texture_buffer_id_map_;
   ResourceManager& resource_manager_;
   GpuResourceManager& gpu_resource_manager_;
   Pipeline& pipeline_;
   donkey::CameraNode camera_node_;
   uint32_t screen_mesh_id_;
+  bool depth_prepass_added_;
+  ShadowCascades::Settings shadow_settings_;
 };
 }  // namespace render
 }  // namespace donkey
\ No newline at end of file
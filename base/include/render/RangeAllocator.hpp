@@ -0,0 +1,57 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace donkey {
+namespace render {
+
+// Hands out ranges of a buffer, in elements or bytes. Ranges given back are
+// reused first-fit by the next allocations, and merged with their free
+// neighbours so that a destroyed resource leaves room for a resource of the
+// same size. New ranges only go at the end when none of the free ones fits.
+//
+// Only the bookkeeping: the buffer is grown by its owner, up to get_size().
+class RangeAllocator {
+ private:
+  struct Range {
+    std::size_t offset;
+    std::size_t size;
+  };
+
+  std::vector<Range> free_ranges_;  // sorted by offset, never adjacent
+  std::size_t size_;  // end of the last range in use
+
+ public:
+  RangeAllocator();
+
+  // Returns the offset of `size` elements starting at a multiple of
+  // `alignment`.
+  std::size_t allocate(std::size_t size, std::size_t alignment = 1);
+  // Gives a range back. Freeing the last range shrinks the size.
+  void free(std::size_t offset, std::size_t size);
+  void clear();
+
+  std::size_t get_size() const;
+  std::size_t get_free_range_count() const;
+};
+
+}  // namespace render
+}  // namespace donkey
@@ -31,15 +31,31 @@ struct RenderPass {
   GLint clear_bits;
   glm::vec3 clear_color;
   bool depth_test;
-  bool lighting;  // loop through lights if true
+  bool lighting;  // reads the lights binned for the gbuffer camera
   bool blending;
+  bool light_volumes;  // draws the volumes of the local lights in view
+  bool depth_prepass;  // draws the meshes' depth only
+  bool depth_equal;    // only shades the fragments the depth pre-pass kept
+  // Draws the nodes sharing a layer with it, see SceneNode::layers.
+  uint32_t layer_mask;
 };
 
+// Bound once per pass and view. last_camera_node is the camera of the
+// previous pass, whose gbuffer full-screen passes read from, and
+// view_camera_node the camera of the view drawn, whose viewport they read it
+// in.
+void bind_camera_block(CommandBucket& render_commands,
+                       const CameraNode& camera_node,
+                       const CameraNode* last_camera_node,
+                       const CameraNode& view_camera_node,
+                       int gbuffer_layout);
+
+// Makes the next render_mesh_node bind its material even if it's the one it
+// bound last, for code binding materials on its own in between.
+void forget_bound_material();
+
 void render_mesh_node(const RenderPass& render_pass,
                       const MeshNode& mesh_node,
-                      const CameraNode& camera_node,
-                      const CameraNode* last_camera_node,
-                      const DirectionalLightNode* light_node,
                       CommandBucket& render_commands,
                       ResourceManager* resource_manager,
                       GpuResourceManager* gpu_resource_manager);
@@ -0,0 +1,75 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+
+namespace donkey {
+namespace render {
+
+// Picks the fraction of the window's width and height the scene is drawn at
+// from frame times, so that frames stay within a budget under load rather
+// than being dropped. The GPU time is what the scale acts on, the interval
+// between frames stands in for it on drivers which can't measure it.
+//
+// Times are smoothed, and the scale moves by whole steps: down as soon as
+// frames run over the budget, up only once they have enough headroom for
+// the larger scale to still fit. GPU times come back a few frames late, the
+// scale is then left alone for a few frames after each change so that it
+// isn't changed again based on frames drawn at the previous scale.
+class ResolutionScaler {
+ public:
+  struct Settings {
+    float target_frame_time;  // in milliseconds
+    float min_scale;
+    float max_scale;  // at most the scale render targets were created at
+    float step;       // scales are whole multiples of it
+    // Frames of smoothing and frames left alone after a change.
+    std::size_t smoothing_frame_count;
+    std::size_t settle_frame_count;
+  };
+
+ private:
+  Settings settings_;
+  float scale_;
+  float frame_time_;  // smoothed, 0 until the first frame
+  std::size_t settle_frame_count_;  // left
+
+ private:
+  float snap_(float scale) const;
+
+ public:
+  explicit ResolutionScaler(const Settings& settings);
+
+  // 60 frames per second, between half and full resolution.
+  static Settings make_default_settings();
+  void set_settings(const Settings& settings);
+  const Settings& get_settings() const;
+
+  // Takes the latest frame times, in milliseconds, and returns the scale to
+  // draw the next frame at. A GPU time of 0 means unknown.
+  float update(float gpu_frame_time, float cpu_frame_time);
+  float get_scale() const;
+  // Smoothed frame time the scale was last picked from.
+  float get_frame_time() const;
+  // Goes back to `scale` and forgets past frame times.
+  void reset(float scale);
+};
+
+}  // namespace render
+}  // namespace donkey
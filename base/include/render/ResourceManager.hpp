@@ -17,7 +17,13 @@
 
 #pragma once
 
-#include <unordered_map>
+#include <GL/gl3w.h>
+
+#include <map>
+#include <string>
+#include <tuple>
+
+#include "SlotMap.hpp"
 #include "render/GpuResourceManager.hpp"
 #include "render/Material.hpp"
 #include "render/State.hpp"
@@ -27,19 +33,32 @@ struct SDL_Surface;
 namespace donkey {
 namespace render {
 
+// Ids are SlotMap handles, like the ones of the GpuResourceManager: they are
+// O(1) to look up and destroying a resource makes them stale right away.
 class ResourceManager {
 public:
   typedef size_t Id;
-  template <typename T>
-  using Container = std::unordered_map<Id, T>;
 
  private:
+  // Whether the program comes from sources rather than files, then its
+  // vertex and fragment shader paths or sources.
+  typedef std::tuple<bool, std::string, std::string> ProgramKey;
+
+  struct Program {
+    GpuProgram program;
+    std::map<ProgramKey, Id>::iterator key;
+  };
+
   GpuResourceManager& gpu_resource_manager_;
-  Container<GpuProgram> gpu_programs_;
-  std::vector<Mesh> meshes_;
-  std::vector<Texture> textures_;
-  std::vector<Material> materials_;
-  std::vector<State> states_;
+  std::map<ProgramKey, Id> program_ids_;
+  SlotMap<Program> gpu_programs_;
+  SlotMap<Mesh> meshes_;
+  SlotMap<Texture> textures_;
+  SlotMap<Material> materials_;
+  SlotMap<State> states_;
+
+ private:
+  Id load_gpu_program_(const ProgramKey& key);
 
  public:
   ResourceManager(GpuResourceManager& gpu_resource_manager);
@@ -56,6 +75,8 @@ public:
 
   Id load_gpu_program_from_file(const std::string& vs_path,
                                 const std::string& fs_path);
+  Id load_gpu_program_from_sources(const std::string& vs_sources,
+                                   const std::string& fs_sources);
 
   uint32_t create_material(Id gpu_program_id);
 
@@ -65,15 +86,41 @@ public:
                        const std::vector<float>& tangents,
                        const std::vector<float>& bitangents,
                        const std::vector<uint32_t>& indices);
+  // Appends a simplified version of the mesh to its LOD chain, `error` is
+  // how far from the full mesh it strays, see MeshSimplifier.
+  void add_lod(uint32_t mesh_id,
+               const std::vector<float>& positions,
+               const std::vector<float>& normals,
+               const std::vector<float>& uvs,
+               const std::vector<float>& tangents,
+               const std::vector<float>& bitangents,
+               const std::vector<uint32_t>& indices,
+               float error);
+  // Makes the mesh an occluder: instances of it are rasterized into the
+  // occlusion culling depth buffer, see Pipeline::set_occlusion_culling.
+  // `positions` and `indices` are usually a simplified version of the mesh
+  // that stays inside of it.
+  void set_occluder(uint32_t mesh_id,
+                    const std::vector<float>& positions,
+                    const std::vector<uint32_t>& indices);
 
   uint32_t create_texture(std::size_t width, std::size_t height,
                           pixel::Format format,
                           pixel::InternalFormat internal_format,
                           pixel::ComponentType component_type);
   GLuint load_texture_(uint8_t* pixels, int width, int height);
-  SDL_Surface* create_mirror_surface_(SDL_Surface* surface);
 
   uint32_t create_state(const State& state);
+
+  // What the GPU holds for a destroyed resource stays alive until the GPU is
+  // done with the frames executed so far, see GpuResourceManager. A mesh is
+  // destroyed with its LODs. Loading the shaders of a destroyed program
+  // again builds a new one.
+  void destroy_gpu_program(Id id);
+  void destroy_material(uint32_t id);
+  void destroy_mesh(uint32_t id);
+  void destroy_texture(uint32_t id);
+  void destroy_state(uint32_t id);
 };
 
 }  // namespace render
@@ -0,0 +1,155 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "bounds.hpp"
+#include "render/FramePacket.hpp"
+#include "render/Mesh.hpp"
+#include "render/StaticMeshSet.hpp"
+#include "render/UniformBlock.hpp"
+
+namespace donkey {
+namespace render {
+
+// Cascaded shadow maps of the first directional light of the frame packets.
+// The main view's frustum, up to a shadow distance, is split in slices each
+// covered by a cascade, a square of the shadow atlas laid out left to right.
+// Cascades are fit around a slice's bounding sphere and moved by whole
+// texels in light space, so that shadow edges don't crawl as the camera
+// moves or turns.
+//
+// The static casters' depth can be cached in an atlas of its own: a
+// cascade's cache is redrawn when the light, the cascade or the static
+// nodes change, and copied into the shadow atlas before the dynamic casters
+// are drawn on top. Cascades with no dynamic casters then aren't touched at
+// all. Cascades move by steps of kSnapTexelCount texels when caching, which
+// only makes them slightly larger, so that a moving camera doesn't redraw
+// their cache every few frames.
+class ShadowCascades {
+ public:
+  enum { kMaxCascadeCount = 4, kSnapTexelCount = 32 };
+
+  enum class Quality { kOff, kLow, kMedium, kHigh };
+
+  struct Settings {
+    int cascade_count;  // 0 to kMaxCascadeCount, 0 disables shadows
+    int resolution;     // of a cascade, in texels
+    float distance;     // from the main view, where shadows end
+    // Splits the cascades between uniformly, 0, and logarithmically, 1.
+    float split_lambda;
+    // Behind each cascade, towards the light, casters still cast shadows.
+    float caster_distance;
+    float depth_bias;  // in shadow map depth, [0, 1]
+    bool filtered;     // 4 taps instead of 1
+    bool cache_static_casters;
+    uint32_t caster_layers;  // see SceneNode::layers
+  };
+
+  struct Cascade {
+    glm::mat4 projection;
+    float split;  // view depth of the main view at which it ends
+    // What update decided the cascade needs drawn this frame: nothing, the
+    // dynamic casters on top of the cached static depth, or everything.
+    bool dirty;
+    bool static_dirty;
+    std::vector<uint32_t> static_casters;   // in get_static_casters()
+    std::vector<uint32_t> dynamic_casters;  // in the packet's mesh nodes
+  };
+
+  // Counters of the last call to update.
+  struct Statistics {
+    std::size_t drawn_cascade_count;
+    std::size_t static_drawn_cascade_count;
+    std::size_t static_caster_count;   // drawn
+    std::size_t dynamic_caster_count;  // drawn
+  };
+
+ private:
+  Settings settings_;
+  // The render thread's static nodes, which only puts the ones in view into
+  // the packets, see set_static_casters.
+  const StaticMeshSet* static_casters_;
+  uint64_t static_change_count_;  // of static_casters_, when last drawn
+  glm::mat4 light_view_;
+  std::array<Cascade, kMaxCascadeCount> cascades_;
+  // Projections the atlases were last drawn with, valid unless
+  // cache_valid_ is false.
+  std::array<glm::mat4, kMaxCascadeCount> cached_projections_;
+  std::array<bool, kMaxCascadeCount> had_dynamic_casters_;
+  bool cache_valid_;
+  bool enabled_;  // there was a directional light to cast shadows from
+  std::vector<Aabb> boxes_;  // of the packet's dynamic casters
+  Statistics statistics_;
+
+ private:
+  int get_snap_texel_count_() const;
+  // Fits the cascade around the main view's slice between two view depths.
+  void fit_cascade_(const CameraNode& camera_node,
+                    float near_split,
+                    float far_split,
+                    Cascade& cascade) const;
+
+ public:
+  explicit ShadowCascades(const Settings& settings);
+
+  static Settings make_settings(Quality quality);
+  // Draws every cascade again, the atlas must fit the new resolution and
+  // cascade count.
+  void set_settings(const Settings& settings);
+  const Settings& get_settings() const;
+
+  // Static casters are looked up in `static_casters`, the set that appends
+  // the static nodes in view to the frame packets, kept up to date by its
+  // owner. Without one, only the packets' mesh nodes cast shadows.
+  void set_static_casters(const StaticMeshSet* static_casters);
+  // Fits the cascades to the packet's main view and picks the casters of
+  // the cascades which need drawing, which the caller must then draw.
+  // Returns false when there are no shadows this frame. `get_mesh` returns
+  // the Mesh of a mesh id.
+  template <typename GetMesh>
+  bool update(const StackFramePacket& frame_packet, GetMesh get_mesh);
+  // Forgets what the atlases hold, every cascade is drawn again.
+  void invalidate();
+
+  int get_cascade_count() const;
+  const Cascade& get_cascade(int cascade) const;
+  const glm::mat4& get_light_view() const;
+  // Null unless set_static_casters was given one.
+  const StaticMeshSet* get_static_casters() const;
+  // Viewport of a cascade in the atlas.
+  glm::tvec2<int> get_viewport_position(int cascade) const;
+  glm::tvec2<GLsizei> get_viewport_size() const;
+  // For a view of the frame, with no cascade when update returned false.
+  ShadowBlock make_shadow_block(const CameraNode& camera_node) const;
+  const Statistics& get_statistics() const;
+
+  // Light space view looking along `direction`, from the origin.
+  static glm::mat4 make_light_view(const glm::vec3& direction);
+};
+
+}  // namespace render
+}  // namespace donkey
+
+#include "render/ShadowCascades.inl"
@@ -0,0 +1,125 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+namespace donkey {
+namespace render {
+
+template <typename GetMesh>
+bool ShadowCascades::update(const StackFramePacket& frame_packet,
+                            GetMesh get_mesh) {
+  statistics_ = Statistics();
+  const StackVector<DirectionalLightNode>& light_nodes =
+      frame_packet.get_directional_light_nodes();
+  enabled_ = (settings_.cascade_count > 0 && !light_nodes.empty());
+  if (!enabled_) {
+    cache_valid_ = false;
+    return false;
+  }
+
+  bool static_changed = false;
+  if (static_casters_) {
+    uint64_t change_count = static_casters_->get_change_count();
+    static_changed = (change_count != static_change_count_);
+    static_change_count_ = change_count;
+  }
+
+  glm::vec4 direction = light_nodes.front().get_model_matrix() *
+                        glm::vec4(0.0f, 0.0f, -1.0f, 0.0f);
+  glm::mat4 light_view = make_light_view(glm::normalize(glm::vec3(direction)));
+  bool light_changed = (light_view != light_view_);
+  light_view_ = light_view;
+
+  // Practical split scheme, between uniform and logarithmic splits:
+  // F. Zhang, H. Sun, L. Xu, L. K. Lun, "Parallel-Split Shadow Maps for
+  // Large-scale Virtual Environments", VRCIA 2006.
+  const CameraNode& camera_node = frame_packet.get_camera_node();
+  float near_split = std::max(camera_node.near_plane, 1e-3f);
+  float far_split = std::max(std::min(settings_.distance,
+                                      camera_node.far_plane),
+                             near_split * 2.0f);
+  float previous_split = near_split;
+  for (int i = 0; i < settings_.cascade_count; ++i) {
+    float t = static_cast<float>(i + 1) / settings_.cascade_count;
+    float log_split = near_split * std::pow(far_split / near_split, t);
+    float uniform_split = near_split + (far_split - near_split) * t;
+    float split = settings_.split_lambda * log_split +
+                  (1.0f - settings_.split_lambda) * uniform_split;
+    fit_cascade_(camera_node, previous_split, split, cascades_[i]);
+    cascades_[i].split = split;
+    previous_split = split;
+  }
+
+  // World boxes of the dynamic casters, once for every cascade. Static
+  // nodes appended to the packet are in the static casters' BVH already.
+  const StackVector<MeshNode>& mesh_nodes = frame_packet.get_mesh_nodes();
+  boxes_.resize(mesh_nodes.size());
+  for (std::size_t i = 0; i < mesh_nodes.size(); ++i) {
+    const MeshNode& mesh_node = mesh_nodes[i];
+    if (!(mesh_node.layers & settings_.caster_layers) ||
+        (static_casters_ && static_casters_->contains(mesh_node.id))) {
+      boxes_[i] = Aabb();
+      continue;
+    }
+    const Mesh& mesh = get_mesh(mesh_node.mesh_id);
+    boxes_[i] =
+        Aabb(mesh.min, mesh.max).transform(mesh_node.get_model_matrix());
+  }
+
+  for (int i = 0; i < settings_.cascade_count; ++i) {
+    Cascade& cascade = cascades_[i];
+    cascade.static_casters.clear();
+    cascade.dynamic_casters.clear();
+    Frustum frustum(cascade.projection * light_view_);
+    for (std::size_t j = 0; j < boxes_.size(); ++j) {
+      if (!boxes_[j].is_empty() && frustum.intersects(boxes_[j]))
+        cascade.dynamic_casters.push_back(static_cast<uint32_t>(j));
+    }
+    // Without a cache, the shadow atlas still holds the static casters as
+    // long as no dynamic caster was drawn over them.
+    bool stale = !cache_valid_ || light_changed || static_changed ||
+                 cascade.projection != cached_projections_[i];
+    bool has_dynamic_casters = !cascade.dynamic_casters.empty();
+    cascade.dirty = stale || has_dynamic_casters || had_dynamic_casters_[i];
+    cascade.static_dirty =
+        settings_.cache_static_casters ? stale : cascade.dirty;
+    if (cascade.static_dirty && static_casters_) {
+      const std::vector<MeshNode>& static_nodes =
+          static_casters_->get_mesh_nodes();
+      static_casters_->get_bvh().query(
+          frustum, [this, &cascade, &static_nodes](uint32_t index) {
+            if (static_nodes[index].layers & settings_.caster_layers)
+              cascade.static_casters.push_back(index);
+          });
+    }
+    had_dynamic_casters_[i] = has_dynamic_casters;
+    cached_projections_[i] = cascade.projection;
+
+    if (cascade.dirty) {
+      ++statistics_.drawn_cascade_count;
+      statistics_.dynamic_caster_count += cascade.dynamic_casters.size();
+    }
+    if (cascade.static_dirty) {
+      ++statistics_.static_drawn_cascade_count;
+      statistics_.static_caster_count += cascade.static_casters.size();
+    }
+  }
+  cache_valid_ = true;
+  return true;
+}
+
+}  // namespace render
+}  // namespace donkey
@@ -26,6 +26,28 @@ namespace render {
 
 enum class CullMode { kFront, kBack };
 
+enum class ComparisonFunction {
+  kNever,
+  kLess,
+  kLessEqual,
+  kGreater,
+  kGreaterEqual,
+  kEqual,
+  kNotEqual,
+  kAlways
+};
+
+enum class StencilOperation {
+  kKeep,
+  kZero,
+  kReplace,
+  kIncrement,
+  kIncrementWrap,
+  kDecrement,
+  kDecrementWrap,
+  kInvert
+};
+
 enum class BlendingFunction { kAdd, kSubtract, kReverseSubtract, kMin, kMax };
 
 enum class BlendingFactor {
@@ -50,6 +72,24 @@ enum class BlendingFactor {
   kOneMinusSource1Alpha
 };
 
+struct StencilFaceState {
+  ComparisonFunction function;
+  int reference;
+  unsigned int mask;
+  StencilOperation stencil_fail;
+  StencilOperation depth_fail;
+  StencilOperation depth_pass;
+
+  StencilFaceState()
+      : function(ComparisonFunction::kAlways),
+        reference(0),
+        mask(0xff),
+        stencil_fail(StencilOperation::kKeep),
+        depth_fail(StencilOperation::kKeep),
+        depth_pass(StencilOperation::kKeep) {}
+};
+
+// A zero sized viewport leaves the current one untouched.
 struct State : public Resource {
   BlendingFunction blend_equation_rgb;
   BlendingFunction blend_equation_alpha;
@@ -58,9 +98,14 @@ struct State : public Resource {
   BlendingFactor blend_destination_alpha;
   BlendingFactor blend_destination_rgb;
   CullMode cull_mode;
+  ComparisonFunction depth_function;
+  StencilFaceState stencil_front;
+  StencilFaceState stencil_back;
   int viewport[4];
   int scissor_box[4];
   bool depth_test_enabled;
+  bool depth_write_enabled;
+  bool color_write_enabled;
   bool stencil_test_enabled;
   bool scissor_test_enabled;
   bool blending_enabled;
@@ -75,9 +120,12 @@ struct State : public Resource {
         blend_destination_alpha(BlendingFactor::kOne),
         blend_destination_rgb(BlendingFactor::kOne),
         cull_mode(CullMode::kBack),
+        depth_function(ComparisonFunction::kLess),
         viewport{0, 0, 0, 0},
         scissor_box{0, 0, 0, 0},
         depth_test_enabled(true),
+        depth_write_enabled(true),
+        color_write_enabled(true),
         stencil_test_enabled(false),
         scissor_test_enabled(false),
         blending_enabled(false),
@@ -92,15 +140,20 @@ struct State : public Resource {
         blend_destination_alpha(state.blend_destination_alpha),
         blend_destination_rgb(state.blend_destination_rgb),
         cull_mode(state.cull_mode),
+        depth_function(state.depth_function),
+        stencil_front(state.stencil_front),
+        stencil_back(state.stencil_back),
         viewport{0, 0, 0, 0},
         scissor_box{0, 0, 0, 0},
         depth_test_enabled(state.depth_test_enabled),
+        depth_write_enabled(state.depth_write_enabled),
+        color_write_enabled(state.color_write_enabled),
         stencil_test_enabled(state.stencil_test_enabled),
         scissor_test_enabled(state.scissor_test_enabled),
         blending_enabled(state.blending_enabled),
         face_culling_enabled(state.face_culling_enabled) {
-    std::copy(&(state.viewport[0]), &(state.viewport[3]), &(viewport[0]));
-    std::copy(&(state.scissor_box[0]), &(state.scissor_box[3]),
+    std::copy(&(state.viewport[0]), &(state.viewport[0]) + 4, &(viewport[0]));
+    std::copy(&(state.scissor_box[0]), &(state.scissor_box[0]) + 4,
               &(scissor_box[0]));
   }
 };
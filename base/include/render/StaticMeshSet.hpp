@@ -0,0 +1,81 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "Bvh.hpp"
+#include "bounds.hpp"
+#include "render/FramePacket.hpp"
+#include "render/Mesh.hpp"
+
+namespace donkey {
+namespace render {
+
+// The render thread's copy of the scene's static mesh nodes. It's built from
+// the changes each frame packet carries, see Scene::create_static_mesh_node,
+// so that the simulation doesn't copy nodes which never move every frame.
+// Nodes are kept in a BVH so that only those in view make it into the
+// packets.
+class StaticMeshSet {
+ private:
+  std::vector<MeshNode> mesh_nodes_;
+  std::vector<Aabb> boxes_;  // world space
+  std::unordered_map<uint32_t, std::size_t> indices_;  // by node id
+  // By index in mesh_nodes_ rather than node id, saving a lookup per node in
+  // view.
+  Bvh bvh_;
+  std::vector<bool> in_view_;  // of any camera, during update
+  std::size_t culled_count_;
+  uint64_t change_count_;
+
+ public:
+  StaticMeshSet();
+
+  void add(const MeshNode& mesh_node, const Aabb& box);
+  // Swaps the last node in place of the removed one, order doesn't matter
+  // since frame packets sort their nodes anyway.
+  void remove(uint32_t id);
+  // Applies the packet's changes and appends the nodes in view of any of its
+  // cameras to its mesh nodes. Packets must come in the order they were
+  // prepared, none skipped. `get_mesh` returns the Mesh of a mesh id.
+  template <typename GetMesh>
+  void update(StackFramePacket& frame_packet, GetMesh get_mesh);
+  // Only applies the packet's changes. Returns whether there were any.
+  template <typename GetMesh>
+  bool apply_changes(const StackFramePacket& frame_packet, GetMesh get_mesh);
+  void clear();
+
+  const std::vector<MeshNode>& get_mesh_nodes() const;
+  bool contains(uint32_t id) const;
+  const Bvh& get_bvh() const;
+  std::size_t size() const;
+  // Nodes out of view during the last update.
+  std::size_t get_culled_count() const;
+  // Goes up whenever nodes are added or removed, for users of the set to
+  // tell whether it changed since they last looked.
+  uint64_t get_change_count() const;
+};
+
+}  // namespace render
+}  // namespace donkey
+
+#include "render/StaticMeshSet.inl"
@@ -0,0 +1,59 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+namespace donkey {
+namespace render {
+
+template <typename GetMesh>
+bool StaticMeshSet::apply_changes(const StackFramePacket& frame_packet,
+                                  GetMesh get_mesh) {
+  for (uint32_t id : frame_packet.get_destroyed_static_mesh_node_ids())
+    remove(id);
+  for (const MeshNode& mesh_node :
+       frame_packet.get_created_static_mesh_nodes()) {
+    const Mesh& mesh = get_mesh(mesh_node.mesh_id);
+    add(mesh_node,
+        Aabb(mesh.min, mesh.max).transform(mesh_node.get_model_matrix()));
+  }
+  bvh_.maintain();
+  return !frame_packet.get_destroyed_static_mesh_node_ids().empty() ||
+         !frame_packet.get_created_static_mesh_nodes().empty();
+}
+
+template <typename GetMesh>
+void StaticMeshSet::update(StackFramePacket& frame_packet, GetMesh get_mesh) {
+  apply_changes(frame_packet, get_mesh);
+
+  // Nodes in view of several cameras are only added once.
+  std::size_t visible_count = 0;
+  in_view_.assign(mesh_nodes_.size(), false);
+  for (const CameraNode& camera_node : frame_packet.get_camera_nodes()) {
+    Frustum frustum(camera_node.projection * camera_node.view);
+    bvh_.query(frustum,
+               [this, &frame_packet, &visible_count](uint32_t index) {
+                 if (in_view_[index])
+                   return;
+                 in_view_[index] = true;
+                 frame_packet.add_static_mesh_node(mesh_nodes_[index]);
+                 ++visible_count;
+               });
+  }
+  culled_count_ = mesh_nodes_.size() - visible_count;
+}
+
+}  // namespace render
+}  // namespace donkey
@@ -33,7 +33,7 @@ class TextureMaterialSlot {
 
  public:
   TextureMaterialSlot(int location, uint32_t texture_id, int texture_unit);
-  void bind(CommandBucket& render_commands);
+  void bind(CommandBucket& render_commands) const;
 };
 
 }  // namespace render
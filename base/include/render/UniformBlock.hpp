@@ -0,0 +1,107 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <glm/mat4x4.hpp>
+#include <glm/vec4.hpp>
+
+namespace donkey {
+namespace render {
+
+// Binding points of the built-in uniform blocks. Blocks are bound to these
+// when a GPU program is linked.
+enum class UniformBlockBinding : unsigned int {
+  kCamera = 0,
+  kLight,
+  kObject,
+  kMaterial,
+  kShadow
+};
+
+// The following structs mirror the std140 blocks declared in the shaders.
+// They only use 4-component vectors and mat4 members so that their C++
+// layout can't differ from the std140 one.
+
+// Bound once per pass.
+struct CameraBlock {
+  glm::mat4 view;
+  glm::mat4 projection;
+  // Camera of the previous pass. Full-screen passes use it to rebuild
+  // view-space positions from the gbuffer.
+  glm::mat4 gbuffer_view;
+  glm::mat4 gbuffer_projection_inverse;
+  glm::vec4 gbuffer_projection_params;  // x: near plane, y: far plane,
+                                        // z: gbuffer layout
+  glm::vec4 camera_position;            // in view space
+  glm::vec4 ambient;
+  // Origin and size in pixels of the view drawn, where full-screen passes
+  // find it in the gbuffer the views share.
+  glm::vec4 viewport;
+};
+
+// Bound once per frame, and once per light volume when lights are drawn as
+// volumes. Describes the light clusters the lighting pass reads its light
+// lists from, see ClusteredLighting.
+struct LightBlock {
+  glm::ivec4 cluster_grid;   // x, y: tiles, z: depth slices, w: tile size
+  glm::vec4 cluster_depth;   // slice = log(view depth) * x + y
+  glm::ivec4 light_counts;   // x: directional lights, y: all lights,
+                             // z: light of the volume being drawn
+};
+
+// Bound once per draw, or once per pass for multi-draws.
+struct ObjectBlock {
+  glm::mat4 model;
+  glm::ivec4 draw_params;  // x: 1 if the model matrices are read from the
+                           // draw buffer instead, see
+                           // CommandBucket::multi_draw_elements
+};
+
+// Bound once per view. Cascades of the shadow map of the first directional
+// light, see ShadowCascades.
+struct ShadowBlock {
+  // From the gbuffer camera's view space to the shadow atlas' uv and depth.
+  glm::mat4 cascade_matrices[4];
+  glm::vec4 cascade_splits;  // view depth at which each cascade ends
+  glm::vec4 shadow_params;   // x: cascades, 0 without shadows, y: depth bias,
+                             // z: texel width in uv, w: 1 to filter
+};
+
+// There is no MaterialBlock struct: its layout is up to each program and is
+// discovered by reflection when the program is linked.
+
+static_assert(sizeof(CameraBlock) == 320, "CameraBlock must match std140");
+static_assert(sizeof(LightBlock) == 48, "LightBlock must match std140");
+static_assert(sizeof(ObjectBlock) == 80, "ObjectBlock must match std140");
+static_assert(sizeof(ShadowBlock) == 288, "ShadowBlock must match std140");
+
+// Memory uniform blocks are written to while recording a frame. The driver
+// owns it and decides where it lives. What doesn't fit spills on the CPU and
+// the driver grows the storage of the next frames, see
+// CommandBucket::get_uniform_overflow.
+struct UniformStorage {
+  uint8_t* data;
+  std::size_t capacity;
+  std::size_t alignment;  // alignment of the offset of a bound block
+};
+
+}  // namespace render
+}  // namespace donkey
@@ -0,0 +1,79 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "bounds.hpp"
+#include "render/FramePacket.hpp"
+#include "render/Mesh.hpp"
+
+namespace donkey {
+namespace render {
+
+// Finds which views of a frame packet each mesh node may be seen from,
+// sharing the work the views have in common. Every node's world box is
+// computed once and tested against the box bounding all the views' frustums,
+// so that nodes far from every view cost a single test, and only then
+// against the frustum of each view. Views close to each other, like the two
+// eyes of a stereo pair, reject most nodes with the first test.
+class ViewCulling {
+ public:
+  enum { kMaxViewCount = 32 };  // bits of a view mask
+
+  // Counters of the last call to cull.
+  struct Statistics {
+    std::size_t view_count;
+    std::size_t tested_count;
+    std::size_t union_culled_count;  // out of every view at once
+    std::size_t view_tested_count;   // frustum tests of the single views
+    std::size_t view_culled_count;   // by those tests, node and view pairs
+  };
+
+ private:
+  std::vector<Frustum> frustums_;
+  Aabb union_box_;
+  // Bit v of a node's mask is set when it may be seen from view v.
+  std::vector<uint32_t> view_masks_;
+  Statistics statistics_;
+
+ public:
+  ViewCulling();
+
+  // Fills a view mask per mesh node, in the order of `mesh_nodes`, for the
+  // views of `camera_nodes`. `get_mesh` returns the Mesh of a mesh id.
+  template <typename GetMesh>
+  void cull(const StackVector<CameraNode>& camera_nodes,
+            const StackVector<MeshNode>& mesh_nodes,
+            GetMesh get_mesh);
+
+  // The steps of cull: set up the views, then get the view mask of
+  // world space boxes.
+  void begin(const StackVector<CameraNode>& camera_nodes);
+  uint32_t test(const Aabb& box);
+
+  uint32_t get_view_mask(std::size_t node_index) const;
+  const Statistics& get_statistics() const;
+};
+
+}  // namespace render
+}  // namespace donkey
+
+#include "render/ViewCulling.inl"
@@ -15,25 +15,21 @@
  * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
  */
 
-#include <glm/mat2x2.hpp>
-#include <glm/mat3x3.hpp>
-#include <glm/mat4x4.hpp>
-#include <glm/vec2.hpp>
-#include <glm/vec3.hpp>
-#include <glm/vec4.hpp>
-
 namespace donkey {
-
 namespace render {
 
-template <class Storage>
-ScalarMaterialSlot<Storage>::ScalarMaterialSlot(int location,
-                                                const Storage& storage)
-    : location(location), storage(storage) {}
-
-template <class Storage>
-void ScalarMaterialSlot<Storage>::bind(CommandBucket& render_commands) {
-  render_commands.bind_uniform(location, storage);
+template <typename GetMesh>
+void ViewCulling::cull(const StackVector<CameraNode>& camera_nodes,
+                       const StackVector<MeshNode>& mesh_nodes,
+                       GetMesh get_mesh) {
+  begin(camera_nodes);
+  view_masks_.resize(mesh_nodes.size());
+  for (std::size_t i = 0; i < mesh_nodes.size(); ++i) {
+    const MeshNode& mesh_node = mesh_nodes[i];
+    const Mesh& mesh = get_mesh(mesh_node.mesh_id);
+    view_masks_[i] =
+        test(Aabb(mesh.min, mesh.max).transform(mesh_node.get_model_matrix()));
+  }
 }
 
 }  // namespace render
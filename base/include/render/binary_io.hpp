@@ -0,0 +1,55 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+
+namespace donkey {
+namespace render {
+namespace binary_io {
+
+// Raw, native-endian reads and writes of trivially copyable values, for
+// files that are read back on the machine that wrote them. Reads return
+// false past the end of the stream.
+template <typename T>
+void write(std::ostream& out, const T& value);
+
+template <typename T>
+bool read(std::istream& in, T& value);
+
+void write_bytes(std::ostream& out, const void* data, std::size_t size);
+bool read_bytes(std::istream& in, void* data, std::size_t size);
+// Whether at least `size` bytes are left to read, to check a count read from
+// the stream before allocating for it. Streams that can't seek are trusted
+// with up to kMaxUncheckedSize bytes.
+bool has_bytes(std::istream& in, uint64_t size);
+const uint64_t kMaxUncheckedSize = 64 << 20;
+
+// Length-prefixed.
+void write_string(std::ostream& out, const std::string& string);
+bool read_string(std::istream& in, std::string& string);
+
+}  // namespace binary_io
+}  // namespace render
+}  // namespace donkey
+
+#include "binary_io.inl"
@@ -0,0 +1,40 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <type_traits>
+
+namespace donkey {
+namespace render {
+namespace binary_io {
+
+template <typename T>
+void write(std::ostream& out, const T& value) {
+  static_assert(std::is_trivially_copyable<T>::value,
+                "Only trivially copyable values can be written raw.");
+  write_bytes(out, &value, sizeof(T));
+}
+
+template <typename T>
+bool read(std::istream& in, T& value) {
+  static_assert(std::is_trivially_copyable<T>::value,
+                "Only trivially copyable values can be read raw.");
+  return read_bytes(in, &value, sizeof(T));
+}
+
+}  // namespace binary_io
+}  // namespace render
+}  // namespace donkey
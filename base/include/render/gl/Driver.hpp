@@ -17,32 +17,85 @@
 
 #pragma once
 
+#include <array>
+#include <cstdint>
 #include <functional>
+#include <string>
 #include <vector>
 
 #include "render/CommandBucket.hpp"
+#include "render/GpuDriver.hpp"
 #include "render/gl/ResourceManager.hpp"
+#include "render/gl/UniformRing.hpp"
 
 namespace donkey {
 namespace render {
 namespace gl {
 
-class Driver {
+class Driver : public GpuDriver {
  private:
-  enum { kCommandTypeMask = 0xff };
+  enum {
+    kCommandTypeMask = 0xff,
+    kUniformFrameSize = 4 * 1024 * 1024,  // to begin with, see UniformRing
+    kSampleQueryCount = 4,
+    kTimerQueryCount = 4
+  };
 
   typedef std::function<void(const Command&)> RenderFunction;
   const std::vector<RenderFunction> render_functions_;
 
   ResourceManager resource_manager_;
+  UniformRing* uniform_ring_;
+
+  // Sample counts are read back a few frames late, from a ring of queries,
+  // so that the CPU never waits for the GPU.
+  std::array<GLuint, kSampleQueryCount> sample_queries_;
+  std::array<bool, kSampleQueryCount> sample_queries_pending_;
+  std::size_t sample_query_index_;
+  uint64_t samples_passed_;
+  // Same for the time each command bucket took.
+  std::array<GLuint, kTimerQueryCount> timer_queries_;
+  std::array<bool, kTimerQueryCount> timer_queries_pending_;
+  std::size_t timer_query_index_;
+  float gpu_frame_time_;
+
+  // glMultiDrawElementsIndirect is GL 4.3, multi-draws are issued one draw
+  // at a time on older versions.
+  bool multi_draw_supported_;
+  // What window passes draw to, 0 for the window's back buffer.
+  GLuint window_framebuffer_;
+  // Clears only touch the viewport, the views of a frame share framebuffers.
+  // The scissor state is put back afterwards.
+  std::array<GLint, 4> viewport_;
+  std::array<GLint, 4> scissor_box_;
+  bool scissor_test_enabled_;
+  const GpuProgram* program_;
+  const Mesh* mesh_;
+  std::size_t draw_call_count_;
+  std::size_t last_draw_call_count_;
 
  public:
-  Driver();
-  void execute_commands(const CommandBucket& commands);
-  GpuResourceManager& get_resource_manager();
+  // An empty `program_cache_directory` disables the program cache.
+  explicit Driver(const std::string& program_cache_directory =
+                      ProgramCache::get_default_directory());
+  virtual ~Driver();
+  virtual UniformStorage begin_frame();
+  virtual void execute_commands(const CommandBucket& commands);
+  virtual GpuResourceManager& get_resource_manager();
+  // Sample counts are a few frames old.
+  virtual uint64_t get_samples_passed() const;
+  // A multi-draw counts as one when the GL supports it.
+  virtual std::size_t get_draw_call_count() const;
+  // Frame times are a few frames old.
+  virtual float get_gpu_frame_time() const;
+  // Draws the window passes to `framebuffer` instead of the window, e.g. a
+  // FrameReader's when rendering offscreen. Its color goes in attachment 0.
+  void set_window_framebuffer(GLuint framebuffer);
 
  private:
   void output_debug_info_() const;
+  void begin_timer_query_();
+  void end_timer_query_();
   void bind_mesh_(const Command& command);
   void bind_uniform_float_(const Command& command);
   void bind_uniform_int_(const Command& command);
@@ -61,6 +114,11 @@ class Driver {
   void set_blending_(const Command& command);
   void clear_framebuffer_(const Command& command);
   void set_state_(const Command& command);
+  void bind_uniform_block_(const Command& command);
+  void bind_material_parameters_(const Command& command);
+  void update_texture_buffer_(const Command& command);
+  void count_samples_(const Command& command);
+  void multi_draw_elements_(const Command& command);
 };
 
 }  // namespace gl
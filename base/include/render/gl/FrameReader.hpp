@@ -0,0 +1,100 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <GL/gl3w.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace donkey {
+namespace render {
+namespace gl {
+
+// Offscreen stand-in for a window's back buffer: a framebuffer the window
+// passes draw to (see Driver::set_window_framebuffer) and whose frames are
+// read back without stalling the pipeline.
+//
+// Each frame is copied by the GPU into one of kDefaultBufferCount
+// pixel-pack buffers, followed by a fence. A frame is only mapped once its
+// fence is signaled, so the CPU only waits on the GPU when it's more than
+// the number of buffers ahead, rather than dropping frames. GL calls only,
+// on the thread whose context created it.
+class FrameReader {
+ public:
+  enum { kDefaultBufferCount = 3 };
+
+  // Frames in drawing order, RGBA with the top row first. `pixels` is only
+  // valid during the call. It's called from read_frame and poll, i.e. on
+  // the render thread, which is held up for as long as it runs: copy the
+  // pixels and hand them to another thread, see render::FrameWriter, rather
+  // than encode or save them here.
+  typedef std::function<void(std::size_t frame_index,
+                             const uint8_t* pixels,
+                             int width,
+                             int height)>
+      Callback;
+
+ private:
+  struct Slot {
+    GLuint buffer;
+    GLsync fence;  // null when not in flight
+    std::size_t frame_index;
+  };
+
+  int width_;
+  int height_;
+  GLuint framebuffer_;
+  GLuint color_renderbuffer_;
+  GLuint depth_renderbuffer_;
+  std::vector<Slot> slots_;
+  std::size_t oldest_slot_;
+  std::size_t pending_count_;
+  std::size_t frame_count_;
+  std::vector<uint8_t> pixels_;
+  Callback callback_;
+
+ public:
+  FrameReader(int width,
+              int height,
+              std::size_t buffer_count = kDefaultBufferCount);
+  ~FrameReader();
+  FrameReader(const FrameReader&) = delete;
+  FrameReader& operator=(const FrameReader&) = delete;
+
+  GLuint get_framebuffer() const;
+  int get_width() const;
+  int get_height() const;
+  void set_callback(const Callback& callback);
+  // Starts copying the framebuffer's content, call it once a frame's
+  // commands are executed. Hands the frames already copied to the callback.
+  void read_frame();
+  // Hands the frames already copied to the callback, waiting for all of
+  // them if `wait`.
+  void poll(bool wait = false);
+
+ private:
+  bool is_ready_(const Slot& slot, bool wait) const;
+  void deliver_(Slot& slot);
+};
+
+}  // namespace gl
+}  // namespace render
+}  // namespace donkey
@@ -15,18 +15,59 @@
  * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
  */
 
+
 #pragma once
 
 #include <GL/gl3w.h>
 
+#include <vector>
+
+#include "render/NameId.hpp"
+
 namespace donkey {
 namespace render {
 namespace gl {
 
+// Active variable of a linked program, as reported by the driver.
+struct ShaderVariable {
+  NameId name_id;
+  GLint location;  // attribute/uniform location or uniform block index
+  GLenum type;     // GL_NONE for uniform blocks
+  GLint size;      // array length, or data size for uniform blocks
+};
+
+// Uniform declared in a uniform block, addressed by its offset in the block.
+struct BlockMember {
+  NameId name_id;
+  GLuint block_index;
+  GLint offset;
+  GLint matrix_stride;  // 0 for non-matrix members
+  GLenum type;
+};
+
+// Flat tables sorted by name ID, filled once per program by reflect() and
+// shared by every material using the program.
 struct GpuProgram {
   GLuint handle;
-  int position_location;
-  int uv_location;
+  std::vector<ShaderVariable> attributes;
+  std::vector<ShaderVariable> uniforms;
+  std::vector<ShaderVariable> uniform_blocks;
+  std::vector<BlockMember> block_members;
+
+  GpuProgram(GLuint handle);
+
+  // Enumerates the active attributes, uniforms, uniform blocks and block
+  // members of the program. Uniforms living in blocks only show up as block
+  // members since they have no location.
+  void reflect();
+
+  // Return -1 (GL_INVALID_INDEX for blocks) if the program has no such
+  // active variable, like glGet*Location.
+  GLint get_attribute_location(NameId name_id) const;
+  GLint get_uniform_location(NameId name_id) const;
+  GLuint get_uniform_block_index(NameId name_id) const;
+  const ShaderVariable* find_uniform_block(NameId name_id) const;
+  const BlockMember* find_block_member(NameId name_id) const;
 };
 
 }  // namespace gl
@@ -17,6 +17,11 @@
 
 #pragma once
 
+#include <GL/gl3w.h>
+
+#include <cstddef>
+#include <cstdint>
+
 #include "render/AMaterial.hpp"
 #include "render/gl/ResourceManager.hpp"
 
@@ -26,7 +31,21 @@ namespace gl {
 
 class Material : public AMaterial {
  private:
-  const ResourceManager& resource_manager_;
+  // Not a reference so that materials stay assignable, SlotMap moves them
+  // around.
+  const ResourceManager* resource_manager_;
+  GLuint material_block_index_;
+
+ private:
+  void write_parameter_(const std::string& name,
+                        GLenum type,
+                        const uint8_t* data,
+                        std::size_t columns,
+                        std::size_t column_size);
+
+ public:
+  // Offset of the parameters in the ResourceManager's material buffer.
+  std::size_t parameters_offset;
 
  public:
   Material(const ResourceManager& resource_manager, uint32_t program_id);
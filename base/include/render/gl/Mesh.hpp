@@ -15,6 +15,7 @@
  * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
  */
 
+
 #pragma once
 
 #include <GL/gl3w.h>
@@ -23,22 +24,17 @@ namespace donkey {
 namespace render {
 namespace gl {
 
+// Where a mesh lives in the MeshBuffer.
 struct Mesh {
-  GLuint position_buffer;
-  GLuint normal_buffer;
-  GLuint uv_buffer;
-  GLuint tangent_buffer;
-  GLuint bitangent_buffer;
-  GLuint index_buffer;
-  GLuint vertex_array;
+  GLint base_vertex;
+  GLuint vertex_count;
+  GLuint first_index;
+  GLuint index_count;
 
-  Mesh(GLuint position_buffer,
-       GLuint normal_buffer,
-       GLuint uv_buffer,
-       GLuint tangent_buffer,
-       GLuint bitangent_buffer,
-       GLenum index_type,
-       GLuint vertex_array);
+  Mesh(GLint base_vertex,
+       GLuint vertex_count,
+       GLuint first_index,
+       GLuint index_count);
 };
 
 }  // namespace gl
@@ -0,0 +1,124 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <GL/gl3w.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "render/RangeAllocator.hpp"
+
+namespace donkey {
+namespace render {
+namespace gl {
+
+// Vertex streams and indices of every mesh, packed in a single set of
+// buffers. Switching meshes doesn't switch buffers or vertex arrays, and a
+// whole bucket of meshes can be drawn with one glMultiDrawElementsIndirect.
+//
+// Ranges of removed meshes are reused by the next meshes added, new ones are
+// appended when none fits. Full buffers are reallocated twice as big and
+// their contents copied over on the GPU.
+class MeshBuffer {
+ public:
+  enum {
+    kPositionStream = 0,
+    kNormalStream,
+    kUvStream,
+    kTangentStream,
+    kStreamCount,
+    // Not a stream of the meshes: 0, 1, 2... read once per instance, so
+    // that a multi-draw's base instance turns into a draw ID.
+    kDrawIdSlot = kStreamCount,
+    kSlotCount,
+    kMinDrawIdCount = 1024
+  };
+  typedef std::array<GLint, kSlotCount> Locations;
+
+ private:
+  // Vertex arrays remember what they were last set up with so that binding
+  // the same locations again is free.
+  struct VertexArray {
+    GLuint handle;
+    Locations locations;
+    std::array<GLuint, kSlotCount> buffers;
+  };
+
+  std::array<GLuint, kStreamCount> vertex_buffers_;
+  GLuint index_buffer_;
+  GLuint draw_id_buffer_;
+  RangeAllocator vertex_ranges_;
+  std::size_t vertex_capacity_;
+  RangeAllocator index_ranges_;
+  std::size_t index_capacity_;
+  std::size_t draw_id_capacity_;
+  VertexArray vertex_array_;
+  // Only ever has the position stream enabled, for depth-only programs.
+  VertexArray position_vertex_array_;
+  VertexArray* bound_vertex_array_;
+  static const std::array<GLint, kStreamCount> stream_sizes_;
+
+ public:
+  MeshBuffer();
+  ~MeshBuffer();
+  MeshBuffer(const MeshBuffer&) = delete;
+  MeshBuffer& operator=(const MeshBuffer&) = delete;
+
+  void cleanup();
+
+  // Adds a mesh, `streams` are indexed by stream. Returns the vertex its
+  // indices are relative to and the position of its first index.
+  void add(const std::array<const std::vector<float>*, kStreamCount>& streams,
+           const std::vector<uint32_t>& indices,
+           GLint& base_vertex,
+           GLuint& first_index);
+  // Gives the ranges of a mesh back, draws still reading them must have
+  // completed.
+  void remove(GLint base_vertex,
+              std::size_t vertex_count,
+              GLuint first_index,
+              std::size_t index_count);
+
+  // Extent of the buffers in use, free ranges included.
+  std::size_t get_vertex_count() const;
+  std::size_t get_index_count() const;
+
+  // Binds a vertex array reading each slot at its location, -1 leaves a
+  // slot out.
+  void bind(const Locations& locations);
+
+  // Makes sure the draw IDs go up to at least `count` - 1.
+  void reserve_draw_ids(std::size_t count);
+
+ private:
+  void set_up_(VertexArray& vertex_array,
+               const Locations& locations,
+               const std::array<GLuint, kSlotCount>& buffers);
+  static GLuint grow_(GLenum target,
+                      GLuint buffer,
+                      std::size_t size,
+                      std::size_t capacity);
+};
+
+}  // namespace gl
+}  // namespace render
+}  // namespace donkey
@@ -0,0 +1,67 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <GL/gl3w.h>
+
+#include <cstdint>
+#include <string>
+
+namespace donkey {
+namespace render {
+namespace gl {
+
+// On-disk cache of linked GPU programs, saved with glGetProgramBinary and
+// restored with glProgramBinary. Entries are keyed by a hash of the shader
+// sources and of the driver's vendor, renderer and version strings, so a
+// driver update simply misses the cache.
+//
+// No GL call is made before the first load() since the cache is created
+// before the GL context is current. An empty directory disables the cache.
+class ProgramCache {
+ private:
+  std::string directory_;
+  std::string driver_string_;
+  bool initialized_;
+  bool supported_;
+
+ public:
+  ProgramCache(const std::string& directory);
+
+  // $XDG_CACHE_HOME/sturdy-donkey, or ~/.cache/sturdy-donkey, or empty when
+  // neither variable is set.
+  static std::string get_default_directory();
+
+  // Returns a linked program, or 0 if the cache has no usable entry.
+  GLuint load(const std::string& vs_sources, const std::string& fs_sources);
+  // The program must have been linked with the binary retrievable hint.
+  void store(GLuint program,
+             const std::string& vs_sources,
+             const std::string& fs_sources);
+
+ private:
+  bool is_supported_();
+  uint64_t make_key_(const std::string& vs_sources,
+                     const std::string& fs_sources) const;
+  std::string get_path_(uint64_t key) const;
+};
+
+}  // namespace gl
+}  // namespace render
+}  // namespace donkey
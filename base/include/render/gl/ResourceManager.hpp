@@ -21,16 +21,21 @@
 #include <SDL.h>
 
 #include <array>
+#include <deque>
 #include <fstream>
 #include <iostream>
 #include <string>
 #include <vector>
 
+#include "SlotMap.hpp"
 #include "common.hpp"
 #include "render/GpuResourceManager.hpp"
+#include "render/RangeAllocator.hpp"
 #include "render/gl/Framebuffer.hpp"
 #include "render/gl/GpuProgram.hpp"
 #include "render/gl/Mesh.hpp"
+#include "render/gl/MeshBuffer.hpp"
+#include "render/gl/ProgramCache.hpp"
 #include "render/gl/State.hpp"
 #include "render/gl/Texture.hpp"
 
@@ -44,30 +49,75 @@ namespace gl {
 class Material;
 
 class ResourceManager : public GpuResourceManager {
+ public:
+  // Programs read their draw buffer, see CommandBucket::multi_draw_elements,
+  // from this unit, out of the way of the ones materials use.
+  enum { kDrawBufferTextureUnit = 15 };
+
  private:
-  std::vector<GpuProgram> gpu_programs_;
-  std::vector<Mesh> meshes_;
-  std::vector<Texture> textures_;
-  std::vector<Framebuffer> framebuffers_;
-  std::vector<Material> materials_;
-  std::vector<State> states_;
-  static const std::array<GLenum, 4> pixel_internal_formats_;
-  static const std::array<GLenum, 3> pixel_formats_;
-  static const std::array<GLenum, 3> pixel_component_types_;
+  // GL objects to delete, or ranges of the MeshBuffer and the material
+  // buffer to give back, once the frames that may use them have completed.
+  struct RetiredObject {
+    enum class Type {
+      kTexture,
+      kBuffer,
+      kProgram,
+      kVertices,
+      kIndices,
+      kMaterialParameters
+    };
+    Type type;
+    GLuint name;  // 0 for ranges
+    // In vertices, indices or bytes, 0 for GL objects.
+    std::size_t offset;
+    std::size_t size;
+    std::size_t frame;
+  };
+
+  SlotMap<GpuProgram> gpu_programs_;
+  SlotMap<Mesh> meshes_;
+  MeshBuffer mesh_buffer_;
+  SlotMap<Texture> textures_;
+  SlotMap<Framebuffer> framebuffers_;
+  SlotMap<Material> materials_;
+  SlotMap<State> states_;
+  std::deque<RetiredObject> retired_objects_;
+  std::size_t frame_count_;
+  ProgramCache program_cache_;
+  // Parameter blocks of every material, each one at its own aligned offset.
+  GLuint material_buffer_;
+  std::size_t material_buffer_capacity_;
+  RangeAllocator material_buffer_ranges_;
+  std::size_t material_buffer_alignment_;
+  static const std::array<GLenum, 9> pixel_internal_formats_;
+  static const std::array<GLenum, 5> pixel_formats_;
+  static const std::array<GLenum, 4> pixel_component_types_;
+  static const std::array<GLenum, 3> buffer_formats_;
+  static const std::array<NameId, 5> uniform_block_ids_;
 
  private:
-  template <GLenum type>
-  GLuint load_shader_(const std::string& path);
+  std::string load_shader_sources_(const std::string& path);
   GLuint link_gpu_program_(GLuint vertex_shader, GLuint fragment_shader);
+  void bind_uniform_blocks_(const GpuProgram& program);
+  void bind_samplers_(const GpuProgram& program);
   GLuint build_shader_(GLenum type, const std::string& sources);
   GLuint build_vertex_shader_(const std::string& sources);
   GLuint build_fragment_shader_(const std::string& sources);
   GLenum sdl_to_gl_pixel_format_(SDL_PixelFormat* format);
   GLenum sdl_to_gl_pixel_type_(SDL_PixelFormat* format);
   GLuint load_texture_(uint8_t* pixels, int width, int height);
+  std::size_t allocate_material_parameters_(std::size_t size);
+  void grow_material_buffer_();
+  void retire_(RetiredObject::Type type, GLuint name);
+  void retire_range_(RetiredObject::Type type,
+                     std::size_t offset,
+                     std::size_t size);
+  void delete_(const RetiredObject& object);
 
  public:
-  ResourceManager();
+  // Linked programs are cached in `program_cache_directory`, see
+  // ProgramCache.
+  explicit ResourceManager(const std::string& program_cache_directory);
   virtual ~ResourceManager();
   virtual void cleanup();
   virtual uint32_t load_texture_from_memory(uint8_t* pixels,
@@ -75,18 +125,23 @@ class ResourceManager : public GpuResourceManager {
                                             int height);
   virtual uint32_t load_gpu_program_from_file(const std::string& vs_path,
                                               const std::string& fs_path);
+  virtual uint32_t load_gpu_program_from_sources(
+      const std::string& vs_sources,
+      const std::string& fs_sources);
   virtual uint32_t create_mesh(const std::vector<float>& positions,
                                const std::vector<float>& normals,
                                const std::vector<float>& uvs,
                                const std::vector<float>& tangents,
                                const std::vector<float>& bitangents,
                                const std::vector<uint32_t>& indices);
+  virtual DrawElementsIndirect get_mesh_draw(uint32_t id) const;
   virtual uint32_t create_material(uint32_t gpu_program);
   virtual uint32_t create_texture(std::size_t width,
                                   std::size_t height,
                                   pixel::Format format,
                                   pixel::InternalFormat internal_format,
                                   pixel::ComponentType component_type);
+  virtual uint32_t create_texture_buffer(pixel::BufferFormat format);
   virtual uint32_t create_framebuffer(
       uint32_t depth_rt_id,
       const std::vector<uint32_t>& color_rt_ids);
@@ -97,24 +152,40 @@ class ResourceManager : public GpuResourceManager {
 
   virtual AMaterial& get_material(std::uint32_t id);
 
+  // GL objects are deleted, and the ranges of meshes and material
+  // parameters reused, once release_retired() knows the frames using them
+  // have completed.
+  virtual void destroy_texture(uint32_t id);
+  virtual void destroy_gpu_program(uint32_t id);
+  virtual void destroy_mesh(uint32_t id);
+  virtual void destroy_material(uint32_t id);
+  virtual void destroy_state(uint32_t id);
+
+  // Counts the frames executed, called by the Driver after each one.
+  void end_frame();
+  // Deletes the GL objects of the resources destroyed before the last
+  // `frames_in_flight` frames executed.
+  void release_retired(std::size_t frames_in_flight);
+
   const GpuProgram& get_gpu_program(uint32_t id) const;
   const Mesh& get_mesh(uint32_t id) const;
+  MeshBuffer& get_mesh_buffer();
   const Texture& get_texture(uint32_t id) const;
   const Framebuffer& get_framebuffer(uint32_t id) const;
   const State& get_state(uint32_t id) const;
-};
 
-template <GLenum type>
-GLuint ResourceManager::load_shader_(const std::string& path) {
-  std::cout << "Loading shader: " << path << "\n";
-  std::ifstream stream(path);
-  stream.seekg(0, std::ios_base::end);
-  size_t length = stream.tellg();
-  stream.seekg(0, std::ios_base::beg);
-  std::string sources(length, '\0');
-  stream.read(&sources[0], length);
-  return build_shader_(type, sources);
-}
+  // Uploads the parameters of a material if they changed since the last
+  // time and binds them to UniformBlockBinding::kMaterial.
+  void bind_material_parameters(uint32_t id);
+
+  // Copies `size` bytes read from `source` at `source_offset` into a texture
+  // buffer at `buffer_offset`, growing the buffer if needed.
+  void update_texture_buffer(uint32_t id,
+                             GLuint source,
+                             std::size_t source_offset,
+                             std::size_t size,
+                             std::size_t buffer_offset);
+};
 
 }  // namespace gl
 }  // namespace render
@@ -25,6 +25,15 @@ namespace donkey {
 namespace render {
 namespace gl {
 
+struct StencilFaceState {
+  GLenum function;
+  GLint reference;
+  GLuint mask;
+  GLenum stencil_fail;
+  GLenum depth_fail;
+  GLenum depth_pass;
+};
+
 struct State {
   GLenum blend_equation_rgb;
   GLenum blend_equation_alpha;
@@ -33,9 +42,14 @@ struct State {
   GLenum blend_destination_alpha;
   GLenum blend_destination_rgb;
   GLenum cull_mode;
+  GLenum depth_function;
+  StencilFaceState stencil_front;
+  StencilFaceState stencil_back;
   GLint viewport[4];
   GLint scissor_box[4];
   GLboolean depth_test_enabled;
+  GLboolean depth_write_enabled;
+  GLboolean color_write_enabled;
   GLboolean stencil_test_enabled;
   GLboolean scissor_test_enabled;
   GLboolean blending_enabled;
@@ -48,6 +62,11 @@ struct State {
   static GLint cull_mode_map_[2];
   static GLint blending_factor_map_[19];
   static GLint blending_function_map_[5];
+  static GLenum comparison_function_map_[8];
+  static GLenum stencil_operation_map_[8];
+
+  static StencilFaceState make_stencil_face_state_(
+      const render::StencilFaceState& state);
 };
 
 }  // namespace gl
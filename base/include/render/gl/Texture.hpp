@@ -19,6 +19,8 @@
 
 #include <GL/gl3w.h>
 
+#include <cstddef>
+
 #include "render/Texture.hpp"
 
 namespace donkey {
@@ -27,8 +29,13 @@ namespace gl {
 
 struct Texture {
   GLuint texture;
+  GLenum target;
+  // Only used by texture buffers (target == GL_TEXTURE_BUFFER).
+  GLuint buffer;
+  std::size_t buffer_capacity;
 
   Texture(GLuint texture);
+  Texture(GLuint texture, GLuint buffer);
 };
 
 }  // namespace gl
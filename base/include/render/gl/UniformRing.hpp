@@ -0,0 +1,85 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <GL/gl3w.h>
+
+#include <array>
+#include <cstddef>
+
+#include "render/UniformBlock.hpp"
+
+namespace donkey {
+namespace render {
+namespace gl {
+
+// Uniform buffer split in kFrameCount regions written in turn, one per frame.
+// A fence is inserted after each frame's commands and waited on before its
+// region gets written again, so the CPU never waits on the GPU unless it's
+// more than kFrameCount - 1 frames ahead.
+//
+// The buffer is persistently mapped when ARB_buffer_storage is available.
+// Otherwise, each frame maps its own region unsynchronized (the fences do the
+// synchronization) and unmaps it in flush().
+//
+// A frame needing more than its region spills the rest on the CPU, see
+// CommandBucket::get_uniform_overflow, and the ring grows to fit it.
+class UniformRing {
+ public:
+  enum { kFrameCount = 3 };
+
+ private:
+  GLuint buffer_;
+  std::size_t frame_size_;
+  std::size_t alignment_;
+  std::size_t frame_;
+  bool persistent_;
+  uint8_t* mapping_;
+  std::array<GLsync, kFrameCount> fences_;
+
+ public:
+  UniformRing(std::size_t frame_size);
+  ~UniformRing();
+  UniformRing(const UniformRing&) = delete;
+  UniformRing& operator=(const UniformRing&) = delete;
+
+  // Returns the storage for the current frame's uniform blocks.
+  UniformStorage begin_frame();
+  // Makes the current frame's writes visible to the GPU. Must be called
+  // before executing any command that reads them.
+  void flush();
+  // Fences the current frame and moves to the next region.
+  void end_frame();
+  // Moves to regions of at least `frame_size` bytes, in a new buffer. The
+  // current frame keeps what it wrote so far, followed by the `size` bytes
+  // of `overflow`. Must be called after flush().
+  void grow(std::size_t frame_size, const uint8_t* overflow, std::size_t size);
+
+  GLuint get_buffer() const;
+  std::size_t get_frame_offset() const;
+
+ private:
+  void allocate_();
+  void wait_for_frame_();
+  static bool has_buffer_storage_();
+};
+
+}  // namespace gl
+}  // namespace render
+}  // namespace donkey
@@ -0,0 +1,106 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+#include "render/CommandBucket.hpp"
+#include "render/GpuDriver.hpp"
+#include "render/headless/ResourceManager.hpp"
+
+namespace donkey {
+namespace render {
+namespace headless {
+
+// Executes command buckets without a GPU: commands are checked against the
+// resources they refer to, counted and optionally written out as text, one
+// line per command. Lets the renderer be tested and benchmarked on machines
+// without a GL context.
+class Driver : public GpuDriver {
+ public:
+  enum {
+    kCommandTypeCount =
+        static_cast<int>(Command::Type::kMultiDrawElements) + 1
+  };
+
+  // Totals since the driver was created or the statistics reset.
+  struct Statistics {
+    std::size_t frame_count;
+    std::size_t command_count;
+    std::size_t draw_call_count;  // a multi-draw counts as one
+    std::size_t index_count;      // indices drawn
+    std::array<std::size_t, kCommandTypeCount> command_counts;
+  };
+
+ private:
+  enum {
+    kCommandTypeMask = 0xff,
+    kUniformFrameSize = 4 * 1024 * 1024,  // to begin with
+    kUniformAlignment = 256
+  };
+
+  ResourceManager resource_manager_;
+  std::vector<uint8_t> uniform_storage_;
+  std::ostream* log_;
+  Statistics statistics_;
+  std::size_t draw_call_count_;
+  // Bound with the last kBindGpuProgram and kBindMesh, -1 if none.
+  int64_t program_id_;
+  int64_t mesh_id_;
+  // Bound with the last kBindFramebuffer, and the textures bound since by
+  // texture unit, to catch draws sampling what they render to.
+  uint32_t framebuffer_id_;
+  std::vector<uint32_t> texture_ids_;
+  static const std::array<const char*, kCommandTypeCount> command_names_;
+
+ private:
+  void check_command_(const Command& command);
+  // Returns false if the range isn't in the uniform storage.
+  bool check_storage_range_(const Command& command,
+                            std::size_t offset,
+                            std::size_t size) const;
+  void check_feedback_loop_(const Command& command) const;
+  void report_(const Command& command, const char* error) const;
+  void write_command_(const Command& command) const;
+
+ public:
+  Driver();
+  virtual ~Driver();
+  virtual UniformStorage begin_frame();
+  virtual void execute_commands(const CommandBucket& commands);
+  virtual ResourceManager& get_resource_manager();
+  // Nothing is rasterized, always 0.
+  virtual uint64_t get_samples_passed() const;
+  virtual std::size_t get_draw_call_count() const;
+  // Nothing runs on a GPU, always 0.
+  virtual float get_gpu_frame_time() const;
+
+  // Writes every executed command to `log`, nothing if it's null.
+  void set_log(std::ostream* log);
+  const Statistics& get_statistics() const;
+  void reset_statistics();
+  static const char* get_command_name(Command::Type type);
+};
+
+}  // namespace headless
+}  // namespace render
+}  // namespace donkey
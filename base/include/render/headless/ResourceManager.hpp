@@ -0,0 +1,163 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "SlotMap.hpp"
+#include "render/GpuResourceManager.hpp"
+#include "render/RangeAllocator.hpp"
+#include "render/headless/Material.hpp"
+
+namespace donkey {
+namespace render {
+namespace headless {
+
+// Keeps track of what a GL resource manager would have created, without
+// touching a GPU. Ids are handed out the same way so that the commands
+// recorded against it are the ones the GL backend would execute. Destroyed
+// resources are released right away, there is no frame in flight to wait
+// for.
+class ResourceManager : public GpuResourceManager {
+ public:
+  struct Statistics {
+    std::size_t program_count;
+    std::size_t mesh_count;
+    // Extent of the mesh buffers, free ranges included like MeshBuffer.
+    std::size_t vertex_count;
+    std::size_t index_count;
+    std::size_t material_count;
+    std::size_t texture_count;  // texture buffers included
+    std::size_t texture_bytes;  // without mipmaps, texture buffers excluded
+    std::size_t framebuffer_count;
+    std::size_t state_count;
+  };
+
+  // Paths of programs loaded from files, sources of the others.
+  struct Program {
+    std::string vs_path;
+    std::string fs_path;
+    std::string vs_sources;
+    std::string fs_sources;
+  };
+
+  struct Texture {
+    std::size_t width;
+    std::size_t height;
+    std::size_t texel_size;
+    bool is_buffer;
+    // Of texture buffers, as the driver last updated them.
+    std::vector<uint8_t> contents;
+  };
+
+ private:
+  struct Mesh {
+    DrawElementsIndirect draw;
+    uint32_t vertex_count;
+  };
+
+  SlotMap<Program> gpu_programs_;
+  SlotMap<Mesh> meshes_;
+  SlotMap<Texture> textures_;
+  SlotMap<std::vector<uint32_t>> framebuffers_;
+  SlotMap<Material> materials_;
+  SlotMap<render::State> states_;
+  RangeAllocator vertex_ranges_;
+  RangeAllocator index_ranges_;
+  static const std::array<std::size_t, 9> texel_sizes_;
+
+ public:
+  ResourceManager();
+  virtual ~ResourceManager();
+  virtual void cleanup();
+  virtual uint32_t load_texture_from_memory(uint8_t* pixels,
+                                            int width,
+                                            int height);
+  // Only records the paths, the sources aren't read.
+  virtual uint32_t load_gpu_program_from_file(const std::string& vs_path,
+                                              const std::string& fs_path);
+  virtual uint32_t load_gpu_program_from_sources(
+      const std::string& vs_sources,
+      const std::string& fs_sources);
+  virtual uint32_t create_mesh(const std::vector<float>& positions,
+                               const std::vector<float>& normals,
+                               const std::vector<float>& uvs,
+                               const std::vector<float>& tangents,
+                               const std::vector<float>& bitangents,
+                               const std::vector<uint32_t>& indices);
+  virtual DrawElementsIndirect get_mesh_draw(uint32_t id) const;
+  virtual uint32_t create_material(uint32_t gpu_program);
+  virtual uint32_t create_texture(std::size_t width,
+                                  std::size_t height,
+                                  pixel::Format format,
+                                  pixel::InternalFormat internal_format,
+                                  pixel::ComponentType component_type);
+  virtual uint32_t create_texture_buffer(pixel::BufferFormat format);
+  virtual uint32_t create_framebuffer(
+      uint32_t depth_rt_id,
+      const std::vector<uint32_t>& color_rt_ids);
+  virtual uint32_t create_framebuffer(
+      const std::list<const donkey::render::Texture*>& rt_ids);
+
+  virtual uint32_t create_state(const render::State& state);
+
+  virtual AMaterial& get_material(std::uint32_t id);
+
+  virtual void destroy_texture(uint32_t id);
+  virtual void destroy_gpu_program(uint32_t id);
+  virtual void destroy_mesh(uint32_t id);
+  virtual void destroy_material(uint32_t id);
+  virtual void destroy_state(uint32_t id);
+
+  // Writes `size` bytes at `buffer_offset`, growing the buffer as the GL
+  // backend does.
+  void update_texture_buffer(uint32_t id,
+                             const void* data,
+                             std::size_t size,
+                             std::size_t buffer_offset);
+
+  const Program& get_gpu_program(uint32_t id) const;
+  const Texture& get_texture(uint32_t id) const;
+  const std::vector<uint32_t>& get_framebuffer(uint32_t id) const;
+  const render::State& get_state(uint32_t id) const;
+
+  // Whether the id was handed out and its resource not destroyed since.
+  bool has_gpu_program(uint32_t id) const;
+  bool has_mesh(uint32_t id) const;
+  bool has_texture(uint32_t id) const;
+  bool has_framebuffer(uint32_t id) const;
+  bool has_material(uint32_t id) const;
+  bool has_state(uint32_t id) const;
+
+  std::size_t get_gpu_program_count() const;
+  std::size_t get_mesh_count() const;
+  std::size_t get_texture_count() const;
+  std::size_t get_framebuffer_count() const;
+  std::size_t get_material_count() const;
+  std::size_t get_state_count() const;
+
+  Statistics get_statistics() const;
+};
+
+}  // namespace headless
+}  // namespace render
+}  // namespace donkey
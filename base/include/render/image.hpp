@@ -0,0 +1,67 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace donkey {
+namespace render {
+namespace image {
+
+// Byte order of the pixels of a decoded image, regardless of endianness.
+enum class Layout { kRGB, kBGR, kRGBA, kBGRA };
+
+std::size_t get_pixel_size(Layout layout);
+
+// Layout of the pixels of a surface of the given SDL_PixelFormatEnum, false
+// when there is no kernel for it and SDL has to convert the surface.
+bool get_layout(uint32_t sdl_format, Layout& layout);
+
+// Swizzle kernels. Each one converts `count` pixels to tightly packed RGBA.
+// The 4-channel kernels may be used in place (src == dst).
+void rgb_to_rgba(const uint8_t* src, uint8_t* dst, std::size_t count);
+void bgr_to_rgba(const uint8_t* src, uint8_t* dst, std::size_t count);
+void bgra_to_rgba(const uint8_t* src, uint8_t* dst, std::size_t count);
+
+// Mirrors an image on the x-axis by swapping rows in place.
+void flip_vertically(uint8_t* pixels,
+                     std::size_t row_size,
+                     std::size_t pitch,
+                     std::size_t height);
+
+// Converts a 4-channel image to RGBA and mirrors it on the x-axis, in place
+// and in a single pass over the pixels.
+void convert_to_rgba_in_place(uint8_t* pixels,
+                              std::size_t pitch,
+                              std::size_t width,
+                              std::size_t height,
+                              Layout layout);
+
+// Converts an image of any layout to a tightly packed RGBA buffer of
+// width * height * 4 bytes, mirroring it on the x-axis on the way.
+void convert_to_rgba(const uint8_t* src,
+                     std::size_t src_pitch,
+                     Layout layout,
+                     uint8_t* dst,
+                     std::size_t width,
+                     std::size_t height);
+
+}  // namespace image
+}  // namespace render
+}  // namespace donkey
@@ -21,15 +21,30 @@ namespace donkey {
 namespace render {
 namespace pixel {
 
-enum class InternalFormat { kRGB8, kRGB16F, kRGBA8, kDepthComponent24 };
+enum class InternalFormat {
+  kRGB8,
+  kRGB16F,
+  kRGBA8,
+  kDepthComponent24,
+  kDepth24Stencil8,
+  kRGBA16F,
+  kRG16,
+  kRGB10A2,
+  kR11G11B10F
+};
 
 enum class Format {
   kRGB,
   kRGBA,
   kDepthComponent,
+  kDepthStencil,
+  kRG
 };
 
-enum class ComponentType { kByte, kUnsignedByte, kFloat };
+enum class ComponentType { kByte, kUnsignedByte, kFloat, kUnsignedInt248 };
+
+// Texel formats of texture buffers, i.e. 1D arrays shaders fetch from.
+enum class BufferFormat { kRGBA32F, kRG32UI, kR16UI };
 
 }  // namespace pixel
 }  // namespace render
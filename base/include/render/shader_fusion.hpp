@@ -0,0 +1,45 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <string>
+
+namespace donkey {
+namespace render {
+namespace shader_fusion {
+
+// Inlines the fragment shader of a full-screen pass into the one of the
+// full-screen pass reading its output, so that the output is computed where
+// it is read instead of being written to a texture and read back.
+//
+// `producer`, the shader writing `texture`, must compute it in a
+// `vec4 shade(ivec2 texel)` function only reading texels of its inputs, its
+// main() coming last. `consumer` must only read `texture` with texelFetch:
+// shade() then runs once for each texel fetched. Uniform blocks and samplers
+// the consumer already declares aren't declared twice.
+//
+// Returns false, leaving `fused` alone, when either shader doesn't follow
+// these rules.
+bool fuse(const std::string& producer,
+          const std::string& consumer,
+          const std::string& texture,
+          std::string& fused);
+
+}  // namespace shader_fusion
+}  // namespace render
+}  // namespace donkey
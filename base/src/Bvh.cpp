@@ -0,0 +1,427 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "Bvh.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <limits>
+
+namespace donkey {
+
+Bvh::Tree::Tree() : root(kNoNode) {}
+
+bool Bvh::Tree::is_leaf(uint32_t node) const {
+  return nodes[node].children[0] == kNoNode;
+}
+
+uint32_t Bvh::Tree::allocate_node() {
+  if (!free_nodes.empty()) {
+    uint32_t node = free_nodes.back();
+    free_nodes.pop_back();
+    return node;
+  }
+  nodes.push_back(Node());
+  return static_cast<uint32_t>(nodes.size() - 1);
+}
+
+void Bvh::Tree::free_node(uint32_t node) {
+  free_nodes.push_back(node);
+}
+
+void Bvh::Tree::refit(uint32_t index) {
+  // Ancestors of a node whose box didn't change don't change either.
+  while (index != kNoNode) {
+    Node& node = nodes[index];
+    Aabb box = nodes[node.children[0]].box;
+    box.extend(nodes[node.children[1]].box);
+    if (box == node.box)
+      return;
+    node.box = box;
+    index = node.parent;
+  }
+}
+
+void Bvh::Tree::insert(uint32_t id, const Aabb& box) {
+  assert(leaves.find(id) == leaves.end());
+  uint32_t leaf = allocate_node();
+  nodes[leaf].box = box;
+  nodes[leaf].parent = kNoNode;
+  nodes[leaf].children[0] = kNoNode;
+  nodes[leaf].children[1] = kNoNode;
+  nodes[leaf].id = id;
+  leaves[id] = leaf;
+  if (root == kNoNode) {
+    root = leaf;
+    return;
+  }
+
+  // Walk down towards the sibling whose new parent grows the tree's surface
+  // the least: E. Catto, "Dynamic Bounding Volume Hierarchies", GDC 2019.
+  uint32_t sibling = root;
+  while (!is_leaf(sibling)) {
+    const Node& node = nodes[sibling];
+    float area = node.box.get_surface_area();
+    Aabb combined = node.box;
+    combined.extend(box);
+    float combined_area = combined.get_surface_area();
+    float cost = 2.0f * combined_area;
+    // Every ancestor of the new leaf grows by as much.
+    float inherited_cost = 2.0f * (combined_area - area);
+    float child_costs[2];
+    for (int i = 0; i < 2; ++i) {
+      const Node& child = nodes[node.children[i]];
+      Aabb child_box = child.box;
+      child_box.extend(box);
+      child_costs[i] = child_box.get_surface_area() + inherited_cost;
+      if (!is_leaf(node.children[i]))
+        child_costs[i] -= child.box.get_surface_area();
+    }
+    if (cost < child_costs[0] && cost < child_costs[1])
+      break;
+    sibling = node.children[(child_costs[1] < child_costs[0]) ? 1 : 0];
+  }
+
+  uint32_t old_parent = nodes[sibling].parent;
+  uint32_t new_parent = allocate_node();
+  nodes[new_parent].box = nodes[sibling].box;
+  nodes[new_parent].box.extend(box);
+  nodes[new_parent].parent = old_parent;
+  nodes[new_parent].children[0] = sibling;
+  nodes[new_parent].children[1] = leaf;
+  nodes[new_parent].id = kNoNode;
+  nodes[sibling].parent = new_parent;
+  nodes[leaf].parent = new_parent;
+  if (old_parent == kNoNode) {
+    root = new_parent;
+    return;
+  }
+  Node& parent = nodes[old_parent];
+  parent.children[(parent.children[0] == sibling) ? 0 : 1] = new_parent;
+  refit(old_parent);
+}
+
+bool Bvh::Tree::update(uint32_t id, const Aabb& box) {
+  auto it = leaves.find(id);
+  assert(it != leaves.end());
+  Node& leaf = nodes[it->second];
+  if (leaf.box == box)
+    return false;
+  leaf.box = box;
+  refit(leaf.parent);
+  return true;
+}
+
+void Bvh::Tree::remove(uint32_t id) {
+  auto it = leaves.find(id);
+  assert(it != leaves.end());
+  uint32_t leaf = it->second;
+  leaves.erase(it);
+  free_node(leaf);
+  if (leaf == root) {
+    root = kNoNode;
+    return;
+  }
+
+  // The sibling takes the parent's place.
+  uint32_t parent = nodes[leaf].parent;
+  uint32_t sibling = nodes[parent].children[0];
+  if (sibling == leaf)
+    sibling = nodes[parent].children[1];
+  uint32_t grandparent = nodes[parent].parent;
+  free_node(parent);
+  nodes[sibling].parent = grandparent;
+  if (grandparent == kNoNode) {
+    root = sibling;
+    return;
+  }
+  Node& node = nodes[grandparent];
+  node.children[(node.children[0] == parent) ? 0 : 1] = sibling;
+  refit(grandparent);
+}
+
+Bvh::Bvh() : change_count_(0), rebuild_ratio_(0.5f), rebuild_count_(0) {}
+
+Bvh::~Bvh() {
+  if (rebuild_.valid())
+    rebuild_.wait();
+}
+
+Bvh::Tree Bvh::build_(std::vector<Item> items) {
+  Tree tree;
+  if (items.empty())
+    return tree;
+  tree.nodes.reserve(items.size() * 2 - 1);
+  tree.leaves.reserve(items.size());
+  tree.root = build_node_(tree, items, 0, items.size());
+  return tree;
+}
+
+uint32_t Bvh::build_node_(Tree& tree,
+                          std::vector<Item>& items,
+                          std::size_t begin,
+                          std::size_t end) {
+  uint32_t index = tree.allocate_node();
+  if (end - begin == 1) {
+    Node& node = tree.nodes[index];
+    node.box = items[begin].second;
+    node.parent = kNoNode;
+    node.children[0] = kNoNode;
+    node.children[1] = kNoNode;
+    node.id = items[begin].first;
+    tree.leaves[node.id] = index;
+    return index;
+  }
+
+  Aabb box;
+  Aabb centroid_box;
+  for (std::size_t i = begin; i < end; ++i) {
+    box.extend(items[i].second);
+    centroid_box.extend(items[i].second.get_center());
+  }
+  glm::vec3 size = centroid_box.max - centroid_box.min;
+  int axis = 0;
+  if (size.y > size[axis])
+    axis = 1;
+  if (size.z > size[axis])
+    axis = 2;
+
+  // Binned surface area heuristic along the centroids' longest axis:
+  // I. Wald, "On fast Construction of SAH-based Bounding Volume
+  // Hierarchies", 2007. Falls back to halving the range when every
+  // centroid is the same.
+  std::size_t middle = begin + (end - begin) / 2;
+  if (size[axis] > 0.0f) {
+    float scale = kBinCount / size[axis];
+    float min = centroid_box.min[axis];
+    auto get_bin = [axis, scale, min](const Item& item) {
+      int bin = static_cast<int>((item.second.get_center()[axis] - min) *
+                                 scale);
+      return std::min(bin, static_cast<int>(kBinCount) - 1);
+    };
+    Aabb bin_boxes[kBinCount];
+    std::size_t bin_counts[kBinCount] = {};
+    for (std::size_t i = begin; i < end; ++i) {
+      int bin = get_bin(items[i]);
+      bin_boxes[bin].extend(items[i].second);
+      ++bin_counts[bin];
+    }
+    // Areas and counts right of each candidate split.
+    float right_areas[kBinCount];
+    std::size_t right_counts[kBinCount];
+    Aabb right_box;
+    std::size_t right_count = 0;
+    for (int i = kBinCount - 1; i > 0; --i) {
+      right_box.extend(bin_boxes[i]);
+      right_count += bin_counts[i];
+      right_areas[i] = right_box.get_surface_area();
+      right_counts[i] = right_count;
+    }
+    Aabb left_box;
+    std::size_t left_count = 0;
+    float best_cost = std::numeric_limits<float>::max();
+    int best_bin = -1;  // last one on the left
+    for (int i = 0; i < kBinCount - 1; ++i) {
+      left_box.extend(bin_boxes[i]);
+      left_count += bin_counts[i];
+      if (left_count == 0 || right_counts[i + 1] == 0)
+        continue;
+      float cost = left_box.get_surface_area() * left_count +
+                   right_areas[i + 1] * right_counts[i + 1];
+      if (cost < best_cost) {
+        best_cost = cost;
+        best_bin = i;
+      }
+    }
+    if (best_bin >= 0) {
+      auto middle_it = std::partition(
+          items.begin() + begin, items.begin() + end,
+          [&get_bin, best_bin](const Item& item) {
+            return get_bin(item) <= best_bin;
+          });
+      middle = static_cast<std::size_t>(middle_it - items.begin());
+    }
+  }
+
+  uint32_t left = build_node_(tree, items, begin, middle);
+  uint32_t right = build_node_(tree, items, middle, end);
+  Node& node = tree.nodes[index];
+  node.box = box;
+  node.parent = kNoNode;
+  node.children[0] = left;
+  node.children[1] = right;
+  node.id = kNoNode;
+  tree.nodes[left].parent = index;
+  tree.nodes[right].parent = index;
+  return index;
+}
+
+void Bvh::record_change_(Change::Type type, uint32_t id, const Aabb& box) {
+  ++change_count_;
+  if (is_rebuilding())
+    rebuild_changes_.push_back({type, id, box});
+}
+
+void Bvh::insert(uint32_t id, const Aabb& box) {
+  tree_.insert(id, box);
+  record_change_(Change::Type::kInsert, id, box);
+}
+
+void Bvh::update(uint32_t id, const Aabb& box) {
+  if (tree_.update(id, box))
+    record_change_(Change::Type::kUpdate, id, box);
+}
+
+void Bvh::remove(uint32_t id) {
+  tree_.remove(id);
+  record_change_(Change::Type::kRemove, id, Aabb());
+}
+
+void Bvh::clear() {
+  if (rebuild_.valid())
+    rebuild_.get();
+  rebuild_changes_.clear();
+  tree_ = Tree();
+  change_count_ = 0;
+}
+
+bool Bvh::contains(uint32_t id) const {
+  return tree_.leaves.find(id) != tree_.leaves.end();
+}
+
+std::size_t Bvh::size() const {
+  return tree_.leaves.size();
+}
+
+void Bvh::build() {
+  finish_rebuild(true);
+  std::vector<Item> items;
+  items.reserve(tree_.leaves.size());
+  for (const auto& leaf : tree_.leaves)
+    items.push_back(std::make_pair(leaf.first, tree_.nodes[leaf.second].box));
+  tree_ = build_(std::move(items));
+  change_count_ = 0;
+  ++rebuild_count_;
+}
+
+void Bvh::maintain() {
+  if (is_rebuilding()) {
+    finish_rebuild(false);
+    return;
+  }
+  std::size_t leaf_count = tree_.leaves.size();
+  if (change_count_ == 0 ||
+      static_cast<float>(change_count_) <= rebuild_ratio_ * leaf_count) {
+    return;
+  }
+  if (leaf_count < kMinRebuildLeafCount)
+    build();
+  else
+    start_rebuild();
+}
+
+void Bvh::start_rebuild() {
+  if (is_rebuilding())
+    return;
+  std::vector<Item> items;
+  items.reserve(tree_.leaves.size());
+  for (const auto& leaf : tree_.leaves)
+    items.push_back(std::make_pair(leaf.first, tree_.nodes[leaf.second].box));
+  change_count_ = 0;
+  rebuild_ = std::async(std::launch::async, &Bvh::build_, std::move(items));
+}
+
+bool Bvh::finish_rebuild(bool wait) {
+  if (!is_rebuilding())
+    return false;
+  if (!wait && rebuild_.wait_for(std::chrono::seconds(0)) !=
+                   std::future_status::ready) {
+    return false;
+  }
+  tree_ = rebuild_.get();
+  // Catch up with what happened to the old tree while building.
+  for (const Change& change : rebuild_changes_) {
+    switch (change.type) {
+      case Change::Type::kInsert:
+        tree_.insert(change.id, change.box);
+        break;
+      case Change::Type::kUpdate:
+        tree_.update(change.id, change.box);
+        break;
+      case Change::Type::kRemove:
+        tree_.remove(change.id);
+        break;
+    }
+  }
+  rebuild_changes_.clear();
+  ++rebuild_count_;
+  return true;
+}
+
+bool Bvh::is_rebuilding() const {
+  return rebuild_.valid();
+}
+
+void Bvh::set_rebuild_ratio(float rebuild_ratio) {
+  rebuild_ratio_ = rebuild_ratio;
+}
+
+std::size_t Bvh::get_rebuild_count() const {
+  return rebuild_count_;
+}
+
+float Bvh::get_cost() const {
+  if (tree_.root == kNoNode)
+    return 0.0f;
+  float root_area = tree_.nodes[tree_.root].box.get_surface_area();
+  if (root_area <= 0.0f)
+    return 1.0f;
+  float area = 0.0f;
+  std::vector<uint32_t> stack(1, tree_.root);
+  while (!stack.empty()) {
+    const Node& node = tree_.nodes[stack.back()];
+    stack.pop_back();
+    area += node.box.get_surface_area();
+    if (node.children[0] != kNoNode) {
+      stack.push_back(node.children[0]);
+      stack.push_back(node.children[1]);
+    }
+  }
+  return area / root_area;
+}
+
+std::size_t Bvh::get_height() const {
+  if (tree_.root == kNoNode)
+    return 0;
+  std::size_t height = 0;
+  std::vector<std::pair<uint32_t, std::size_t>> stack(
+      1, std::make_pair(tree_.root, std::size_t(1)));
+  while (!stack.empty()) {
+    std::pair<uint32_t, std::size_t> entry = stack.back();
+    stack.pop_back();
+    height = std::max(height, entry.second);
+    const Node& node = tree_.nodes[entry.first];
+    if (node.children[0] != kNoNode) {
+      stack.push_back(std::make_pair(node.children[0], entry.second + 1));
+      stack.push_back(std::make_pair(node.children[1], entry.second + 1));
+    }
+  }
+  return height;
+}
+
+}  // namespace donkey
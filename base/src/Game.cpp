@@ -33,6 +33,10 @@ namespace donkey {
 
 Game::Game(IResourceLoaderDelegate& resource_loader) {
   resource_loader.load_game_objects(scene_);
+  for (MeshNode& node : scene_.get_mesh_nodes()) {
+    if (node.layers & SceneNode::get_layer(0))
+      rotating_nodes_.push_back(&node);
+  }
 }
 
 Game::~Game() {}
@@ -40,9 +44,8 @@ Game::~Game() {}
 void Game::prepare_frame_packet(FramePacket* frame_packet,
                                 StackAllocator<FramePacket>& allocator) {
   signpost_start(0, 2, 0, 0, 0);
-  new (frame_packet)
-      FramePacket(scene_.get_mesh_nodes(), scene_.get_camera_nodes(),
-                  scene_.get_directional_light_nodes(), allocator);
+  new (frame_packet) FramePacket(scene_, allocator);
+  scene_.clear_static_mesh_node_changes();
   signpost_end(0, 2, 0, 0, 0);
 }
 
@@ -51,12 +54,11 @@ void Game::update(Duration elapsed_time) {
   signpost_end(0, 0, 0, 0, 0);
   signpost_start(0, 1, 0, 0, 0);
   const float rotation_speed = 50.0f;
-  for (SceneNode& node : scene_.get_mesh_nodes()) {
-    if (node.pass_num == 0) {
-      float angle = elapsed_time.count() * rotation_speed;
-      node.angles.y += angle;
-    }
-  }
+  float angle = elapsed_time.count() * rotation_speed;
+  for (MeshNode* node : rotating_nodes_)
+    node->angles.y += angle;
+  scene_.update_transforms();
+  scene_.update_bvh();
   signpost_end(0, 1, 0, 0, 0);
 }
 
@@ -28,33 +28,90 @@
 #endif
 
 #include <chrono>
+#include <iostream>
+#include <string>
 
 #include "GameManager.hpp"
+#include "render/FrameWriter.hpp"
+#include "render/gl/Driver.hpp"
+#include "render/headless/Driver.hpp"
+
+#if defined(STURDY_DONKEY_EGL)
+#include "render/OffscreenContext.hpp"
+#endif
 
 namespace donkey {
 
-GameManager::GameManager(IResourceLoaderDelegate& resource_loader)
-    : resource_loader_(resource_loader),
+GameManager::GameManager(IResourceLoaderDelegate& resource_loader,
+                         Backend backend,
+                         const std::string& program_cache_directory)
+    : window_(nullptr),
+      offscreen_context_(nullptr),
+      frame_reader_(nullptr),
+      frame_writer_(nullptr),
+      resource_loader_(resource_loader),
       simulated_frame_count_(0),
-      rendered_frame_count_(0) {
-  assert(SDL_Init(SDL_INIT_VIDEO | SDL_INIT_EVENTS) == 0);
+      rendered_frame_count_(0),
+      frame_limit_(0) {
+  const int width = 1600;
+  const int height = 900;
+  // Events are still polled when headless, they just never come from a
+  // window.
+  Uint32 sdl_flags = SDL_INIT_EVENTS;
+  if (backend == Backend::kGl)
+    sdl_flags |= SDL_INIT_VIDEO;
+  assert(SDL_Init(sdl_flags) == 0);
   int img_flags = IMG_INIT_PNG;
   int bit_mask = IMG_Init(img_flags);
   assert((bit_mask & img_flags) == img_flags);
-  window_ = new render::Window("Pipelined rendering demo", 1600, 900);
-  driver_ = new render::gl::Driver;
-  render::Window::Context render_context = window_->get_render_context();
-  window_->make_current(render_context);
+  if (backend == Backend::kGl) {
+    window_ = new render::Window("Pipelined rendering demo", width, height);
+    render::Window::Context render_context = window_->get_render_context();
+    window_->make_current(render_context);
+    backend_driver_ = new render::gl::Driver(program_cache_directory);
+  } else if (backend == Backend::kOffscreen) {
+#if defined(STURDY_DONKEY_EGL)
+    offscreen_context_ = new render::OffscreenContext(width, height);
+    offscreen_context_->make_current(
+        offscreen_context_->get_render_context());
+    render::gl::Driver* driver =
+        new render::gl::Driver(program_cache_directory);
+    frame_reader_ = new render::gl::FrameReader(width, height);
+    driver->set_window_framebuffer(frame_reader_->get_framebuffer());
+    backend_driver_ = driver;
+#else
+    std::cerr << "Offscreen rendering needs EGL, which this build lacks.\n";
+    assert(false);
+#endif
+  } else {
+    backend_driver_ = new render::headless::Driver;
+  }
+  driver_ = new render::CaptureDriver(*backend_driver_);
   resource_manager_ =
       new render::ResourceManager(driver_->get_resource_manager());
-  renderer_ = new render::DeferredRenderer(window_, driver_, resource_manager_);
+  renderer_ =
+      new render::DeferredRenderer(width, height, driver_, resource_manager_);
+  renderer_->set_static_mesh_set(&static_mesh_set_);
   resource_loader.load_render_resources(window_, resource_manager_,
                                         &(driver_->get_resource_manager()));
-  window_->free_context();
+  if (window_)
+    window_->free_context();
+#if defined(STURDY_DONKEY_EGL)
+  if (offscreen_context_)
+    offscreen_context_->free_context();
+#endif
   simulation_modules_.push_back(new Game(resource_loader_));
 }
 
 GameManager::~GameManager() {
+#if defined(STURDY_DONKEY_EGL)
+  // the frame reader's buffers go with the context
+  if (offscreen_context_)
+    offscreen_context_->make_current(offscreen_context_->get_render_context());
+#endif
+  delete frame_reader_;
+  // after the reader, whose last frames it saves
+  delete frame_writer_;
   for (auto simulation_module : simulation_modules_) {
     delete simulation_module;
   }
@@ -62,7 +119,11 @@ GameManager::~GameManager() {
   resource_manager_->cleanup();
   delete resource_manager_;
   delete driver_;
+  delete backend_driver_;
   delete window_;
+#if defined(STURDY_DONKEY_EGL)
+  delete offscreen_context_;
+#endif
   SDL_Quit();
 }
 
@@ -78,20 +139,42 @@ size_t GameManager::wait_for_frame_packet_() {
 }
 
 void GameManager::render_loop() {
-  render::Window::Context render_context = window_->get_render_context();
-  window_->make_current(render_context);
+  if (window_) {
+    render::Window::Context render_context = window_->get_render_context();
+    window_->make_current(render_context);
+  }
+#if defined(STURDY_DONKEY_EGL)
+  if (offscreen_context_)
+    offscreen_context_->make_current(offscreen_context_->get_render_context());
+#endif
   while (run_.load(std::memory_order_relaxed)) {
     // Wait for simulation to produce a frame packet.
     size_t rendered_frame_count = wait_for_frame_packet_();
     size_t frame_packet_id = rendered_frame_count % 2;
     FramePacket* frame_packet = FramePacket::frame_packets[frame_packet_id];
+    static_mesh_set_.update(
+        *frame_packet, [this](uint32_t mesh_id) -> const render::Mesh& {
+          return resource_manager_->get_mesh(mesh_id);
+        });
     frame_packet->sort_mesh_nodes();
-    render::CommandBucket render_commands;
+    render::CommandBucket render_commands(driver_->begin_frame());
     renderer_->render(frame_packet, render_commands);
     driver_->execute_commands(render_commands);
-    window_->swap();
+    if (window_)
+      window_->swap();
+    if (frame_reader_)
+      frame_reader_->read_frame();
     increment_rendered_frame_count_();
+    if (frame_limit_ > 0 && rendered_frame_count + 1 >= frame_limit_)
+      run_.store(false, std::memory_order_relaxed);
   }
+  if (frame_reader_)
+    frame_reader_->poll(true);
+#if defined(STURDY_DONKEY_EGL)
+  // Lets the destructor make it current on the main thread.
+  if (offscreen_context_)
+    offscreen_context_->free_context();
+#endif
 }
 
 void GameManager::simulation_loop() {
@@ -107,6 +190,9 @@ void GameManager::simulation_loop() {
     while (SDL_PollEvent(&event)) {
       if (event.type == SDL_QUIT) {
         run_.store(false, std::memory_order_relaxed);
+      } else if (event.type == SDL_KEYDOWN &&
+                 event.key.keysym.sym == SDLK_F12) {
+        capture_frame("frame.capture");
       }
     }
 
@@ -149,6 +235,37 @@ void GameManager::prepare_frame_packet_(Game& game) {
   increment_simulated_frame_count_();
 }
 
+void GameManager::set_frame_limit(std::size_t frame_count) {
+  frame_limit_ = frame_count;
+}
+
+void GameManager::capture_frame(const std::string& path) {
+  driver_->capture_next_frame(path);
+}
+
+void GameManager::set_frame_callback(
+    const render::gl::FrameReader::Callback& callback) {
+  assert(frame_reader_ != nullptr);
+  frame_reader_->set_callback(callback);
+}
+
+void GameManager::save_frames(const std::string& path_prefix) {
+  assert(!frame_writer_);
+  frame_writer_ = new render::FrameWriter(path_prefix);
+  set_frame_callback([this](std::size_t frame_index, const uint8_t* pixels,
+                            int width, int height) {
+    frame_writer_->write(frame_index, pixels, width, height);
+  });
+}
+
+render::GpuDriver& GameManager::get_driver() {
+  return *backend_driver_;
+}
+
+render::DeferredRenderer& GameManager::get_renderer() {
+  return *renderer_;
+}
+
 void GameManager::run() {
   run_.store(true, std::memory_order_relaxed);
   std::thread thread([this]() { render_loop(); });
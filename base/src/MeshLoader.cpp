@@ -19,11 +19,14 @@
 
 #include <tiny_obj_loader.h>
 
+#include <cfloat>
+#include <cstdint>
 #include <iostream>
 #include <unordered_map>
 #include <utility>
 #include <vector>
 
+#include "MeshSimplifier.hpp"
 #include "hash.hpp"
 
 namespace {
@@ -107,8 +110,66 @@ uint32_t MeshLoader::load(render::ResourceManager* resource_manager,
   std::vector<float> bitangents;
   consolidate_indices_(attributes, shapes[0].mesh.indices, indices, positions,
                        normals, uvs, tangents, bitangents);
-  return resource_manager->create_mesh(positions, normals, uvs, tangents,
-                                       bitangents, indices);
+  uint32_t mesh_id = resource_manager->create_mesh(
+      positions, normals, uvs, tangents, bitangents, indices);
+  create_lods_(resource_manager, mesh_id, indices, positions, normals, uvs,
+               tangents, bitangents);
+  return mesh_id;
+}
+
+void MeshLoader::create_lods_(render::ResourceManager* resource_manager,
+                              uint32_t mesh_id,
+                              const std::vector<uint32_t>& indices,
+                              const std::vector<float>& positions,
+                              const std::vector<float>& normals,
+                              const std::vector<float>& uvs,
+                              const std::vector<float>& tangents,
+                              const std::vector<float>& bitangents) const {
+  MeshSimplifier simplifier;
+  std::vector<uint32_t> lod_indices = indices;
+  float error = 0.0f;
+  for (int level = 1; level <= kMaxLodCount; ++level) {
+    std::size_t target_index_count = lod_indices.size() / 6 * 3;
+    if (target_index_count < kMinLodTriangleCount * 3)
+      break;
+    // Each level starts from the previous one, errors add up.
+    float level_error;
+    std::vector<uint32_t> simplified_indices = simplifier.simplify(
+        positions, lod_indices, target_index_count, FLT_MAX, level_error);
+    if (simplified_indices.size() > lod_indices.size() * 3 / 4)
+      break;
+    error += level_error;
+    lod_indices = std::move(simplified_indices);
+
+    // Only keep the vertices the level still uses.
+    std::vector<uint32_t> remap(positions.size() / 3, UINT32_MAX);
+    std::vector<uint32_t> compact_indices;
+    std::vector<float> compact_positions;
+    std::vector<float> compact_normals;
+    std::vector<float> compact_uvs;
+    std::vector<float> compact_tangents;
+    std::vector<float> compact_bitangents;
+    compact_indices.reserve(lod_indices.size());
+    for (uint32_t index : lod_indices) {
+      if (remap[index] == UINT32_MAX) {
+        remap[index] = static_cast<uint32_t>(compact_positions.size() / 3);
+        for (std::size_t k = 0; k < 3; ++k) {
+          compact_positions.push_back(positions[index * 3 + k]);
+          compact_normals.push_back(normals[index * 3 + k]);
+          compact_tangents.push_back(tangents[index * 3 + k]);
+          compact_bitangents.push_back(bitangents[index * 3 + k]);
+        }
+        compact_uvs.push_back(uvs[index * 2]);
+        compact_uvs.push_back(uvs[index * 2 + 1]);
+      }
+      compact_indices.push_back(remap[index]);
+    }
+    std::cout << "\tLOD " << level << ": " << compact_indices.size() / 3
+              << " triangles, error " << error << '\n';
+    resource_manager->add_lod(mesh_id, compact_positions, compact_normals,
+                              compact_uvs, compact_tangents,
+                              compact_bitangents, compact_indices, error);
+  }
 }
 
 void MeshLoader::consolidate_indices_(
@@ -0,0 +1,275 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "MeshSimplifier.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <unordered_map>
+
+#include "hash.hpp"
+
+namespace donkey {
+
+void MeshSimplifier::Quadric::add(const Quadric& quadric) {
+  a00 += quadric.a00;
+  a01 += quadric.a01;
+  a02 += quadric.a02;
+  a11 += quadric.a11;
+  a12 += quadric.a12;
+  a22 += quadric.a22;
+  b0 += quadric.b0;
+  b1 += quadric.b1;
+  b2 += quadric.b2;
+  c += quadric.c;
+  plane_count += quadric.plane_count;
+}
+
+void MeshSimplifier::Quadric::add_plane(const glm::vec3& normal,
+                                        float distance) {
+  double x = normal.x;
+  double y = normal.y;
+  double z = normal.z;
+  double d = distance;
+  a00 += x * x;
+  a01 += x * y;
+  a02 += x * z;
+  a11 += y * y;
+  a12 += y * z;
+  a22 += z * z;
+  b0 += x * d;
+  b1 += y * d;
+  b2 += z * d;
+  c += d * d;
+  plane_count += 1.0;
+}
+
+double MeshSimplifier::Quadric::evaluate(const glm::vec3& position) const {
+  double x = position.x;
+  double y = position.y;
+  double z = position.z;
+  double error = a00 * x * x + a11 * y * y + a22 * z * z +
+                 2.0 * (a01 * x * y + a02 * x * z + a12 * y * z) +
+                 2.0 * (b0 * x + b1 * y + b2 * z) + c;
+  // rounding may take it slightly below zero
+  return (plane_count > 0.0) ? std::max(error, 0.0) / plane_count : 0.0;
+}
+
+std::vector<uint32_t> MeshSimplifier::simplify(
+    const std::vector<float>& packed_positions,
+    const std::vector<uint32_t>& original_indices,
+    std::size_t target_index_count,
+    float max_error,
+    float& error) const {
+  error = 0.0f;
+  std::vector<uint32_t> indices = original_indices;
+  if (indices.size() <= target_index_count)
+    return indices;
+
+  std::size_t vertex_count = packed_positions.size() / 3;
+  std::vector<glm::vec3> positions(vertex_count);
+  for (std::size_t i = 0; i < vertex_count; ++i) {
+    positions[i] = glm::vec3(packed_positions[i * 3],
+                             packed_positions[i * 3 + 1],
+                             packed_positions[i * 3 + 2]);
+  }
+  std::vector<uint32_t> welded = weld_positions_(positions);
+  std::vector<bool> locked = find_locked_vertices_(welded, indices);
+
+  // The quadric of a position sums the planes of the triangles around it.
+  std::vector<Quadric> quadrics(vertex_count, Quadric());
+  for (std::size_t i = 0; i + 2 < indices.size(); i += 3) {
+    const glm::vec3& p0 = positions[indices[i]];
+    glm::vec3 normal = glm::cross(positions[indices[i + 1]] - p0,
+                                  positions[indices[i + 2]] - p0);
+    float length = glm::length(normal);
+    if (length == 0.0f)
+      continue;
+    normal = normal / length;
+    Quadric quadric = Quadric();
+    quadric.add_plane(normal, -glm::dot(normal, p0));
+    for (std::size_t k = 0; k < 3; ++k)
+      quadrics[welded[indices[i + k]]].add(quadric);
+  }
+
+  // Each pass collapses edges whose neighbourhoods don't overlap, cheapest
+  // first, and then rebuilds the triangles.
+  double max_quadric_error = static_cast<double>(max_error) * max_error;
+  double pass_error = 0.0;
+  std::vector<uint32_t> remap(vertex_count);
+  std::vector<bool> touched(vertex_count);
+  std::vector<uint32_t> triangle_offsets(vertex_count + 1);
+  std::vector<uint32_t> vertex_triangles;
+  std::vector<Collapse> collapses;
+  while (indices.size() > target_index_count) {
+    // Triangles around each vertex.
+    std::fill(triangle_offsets.begin(), triangle_offsets.end(), 0);
+    for (uint32_t index : indices)
+      ++triangle_offsets[index + 1];
+    std::partial_sum(triangle_offsets.begin(), triangle_offsets.end(),
+                     triangle_offsets.begin());
+    vertex_triangles.resize(indices.size());
+    std::vector<uint32_t> next = triangle_offsets;
+    for (std::size_t i = 0; i < indices.size(); ++i)
+      vertex_triangles[next[indices[i]]++] = static_cast<uint32_t>(i / 3);
+
+    collapses.clear();
+    for (std::size_t i = 0; i < indices.size(); ++i) {
+      uint32_t a = indices[i];
+      uint32_t b = indices[i - i % 3 + (i + 1) % 3];
+      for (const auto& [from, to] : {std::make_pair(a, b),
+                                     std::make_pair(b, a)}) {
+        if (locked[from] || welded[from] == welded[to])
+          continue;
+        Quadric quadric = quadrics[welded[from]];
+        quadric.add(quadrics[welded[to]]);
+        collapses.push_back({from, to, quadric.evaluate(positions[to])});
+      }
+    }
+    std::sort(collapses.begin(), collapses.end(),
+              [](const Collapse& lhs, const Collapse& rhs) {
+                return (lhs.error < rhs.error);
+              });
+
+    std::iota(remap.begin(), remap.end(), 0);
+    std::fill(touched.begin(), touched.end(), false);
+    std::size_t index_count = indices.size();
+    bool collapsed = false;
+    for (const Collapse& collapse : collapses) {
+      if (collapse.error > max_quadric_error ||
+          index_count <= target_index_count) {
+        break;
+      }
+      if (touched[collapse.from] || touched[collapse.to])
+        continue;
+      const uint32_t* triangles =
+          vertex_triangles.data() + triangle_offsets[collapse.from];
+      std::size_t triangle_count = triangle_offsets[collapse.from + 1] -
+                                   triangle_offsets[collapse.from];
+      if (flips_(positions, indices, triangles, triangle_count, collapse))
+        continue;
+      // The flip tests of this pass assume that the triangles they look at
+      // haven't changed yet.
+      for (std::size_t i = 0; i < triangle_count; ++i) {
+        for (std::size_t k = 0; k < 3; ++k) {
+          uint32_t vertex = indices[triangles[i] * 3 + k];
+          touched[vertex] = true;
+          if (vertex == collapse.to)
+            index_count -= 3;
+        }
+      }
+      remap[collapse.from] = collapse.to;
+      quadrics[welded[collapse.to]].add(quadrics[welded[collapse.from]]);
+      pass_error = std::max(pass_error, collapse.error);
+      collapsed = true;
+    }
+    if (!collapsed)
+      break;
+
+    std::size_t write = 0;
+    for (std::size_t i = 0; i + 2 < indices.size(); i += 3) {
+      uint32_t a = remap[indices[i]];
+      uint32_t b = remap[indices[i + 1]];
+      uint32_t c = remap[indices[i + 2]];
+      if (a == b || b == c || c == a)
+        continue;
+      indices[write++] = a;
+      indices[write++] = b;
+      indices[write++] = c;
+    }
+    indices.resize(write);
+  }
+  error = static_cast<float>(std::sqrt(pass_error));
+  return indices;
+}
+
+// Returns, for each vertex, the first vertex with the same position.
+std::vector<uint32_t> MeshSimplifier::weld_positions_(
+    const std::vector<glm::vec3>& positions) const {
+  std::unordered_map<glm::vec3, uint32_t> first_vertices;
+  std::vector<uint32_t> welded(positions.size());
+  for (std::size_t i = 0; i < positions.size(); ++i) {
+    auto result =
+        first_vertices.insert({positions[i], static_cast<uint32_t>(i)});
+    welded[i] = result.first->second;
+  }
+  return welded;
+}
+
+std::vector<bool> MeshSimplifier::find_locked_vertices_(
+    const std::vector<uint32_t>& welded,
+    const std::vector<uint32_t>& indices) const {
+  std::size_t vertex_count = welded.size();
+  std::vector<uint32_t> group_sizes(vertex_count, 0);
+  for (uint32_t group : welded)
+    ++group_sizes[group];
+
+  // Edges of a closed surface belong to exactly two triangles.
+  std::unordered_map<uint64_t, uint32_t> edge_counts;
+  for (std::size_t i = 0; i < indices.size(); ++i) {
+    uint64_t a = welded[indices[i]];
+    uint64_t b = welded[indices[i - i % 3 + (i + 1) % 3]];
+    ++edge_counts[(std::min(a, b) << 32) | std::max(a, b)];
+  }
+  std::vector<bool> locked_groups(vertex_count, false);
+  for (const auto& [edge, count] : edge_counts) {
+    if (count != 2) {
+      locked_groups[edge >> 32] = true;
+      locked_groups[edge & 0xffffffff] = true;
+    }
+  }
+
+  std::vector<bool> locked(vertex_count);
+  for (std::size_t i = 0; i < vertex_count; ++i)
+    locked[i] = (group_sizes[welded[i]] > 1 || locked_groups[welded[i]]);
+  return locked;
+}
+
+bool MeshSimplifier::flips_(const std::vector<glm::vec3>& positions,
+                            const std::vector<uint32_t>& indices,
+                            const uint32_t* triangles,
+                            std::size_t triangle_count,
+                            const Collapse& collapse) const {
+  for (std::size_t i = 0; i < triangle_count; ++i) {
+    const uint32_t* vertices = indices.data() + triangles[i] * 3;
+    // the triangles along the edge disappear
+    if (vertices[0] == collapse.to || vertices[1] == collapse.to ||
+        vertices[2] == collapse.to) {
+      continue;
+    }
+    glm::vec3 before[3];
+    glm::vec3 after[3];
+    for (std::size_t k = 0; k < 3; ++k) {
+      before[k] = positions[vertices[k]];
+      after[k] = (vertices[k] == collapse.from) ? positions[collapse.to]
+                                                : before[k];
+    }
+    glm::vec3 normal_before =
+        glm::cross(before[1] - before[0], before[2] - before[0]);
+    glm::vec3 normal_after =
+        glm::cross(after[1] - after[0], after[2] - after[0]);
+    if (glm::dot(normal_before, normal_after) <= 0.0f)
+      return true;
+  }
+  return false;
+}
+
+}  // namespace donkey
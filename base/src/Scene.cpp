@@ -17,6 +17,8 @@
 
 #include "Scene.hpp"
 
+#include <algorithm>
+#include <cassert>
 #include <glm/gtc/matrix_transform.hpp>
 
 namespace donkey {
@@ -29,9 +31,94 @@ MeshNode& Scene::create_mesh_node(uint32_t pass_num,
                                   uint32_t material_id) {
   mesh_nodes_.push_front(
       {pass_num, position, angles, scale, mesh_id, material_id});
+  update_bvh_(mesh_nodes_.front());
   return mesh_nodes_.front();
 }
 
+MeshNode& Scene::create_static_mesh_node(uint32_t pass_num,
+                                         const glm::vec3& position,
+                                         const glm::vec3& angles,
+                                         const glm::vec3& scale,
+                                         uint32_t mesh_id,
+                                         uint32_t material_id) {
+  static_mesh_nodes_.push_front(
+      {pass_num, position, angles, scale, mesh_id, material_id});
+  MeshNode& mesh_node = static_mesh_nodes_.front();
+  static_mesh_node_iterators_[mesh_node.id] = static_mesh_nodes_.begin();
+  created_static_mesh_nodes_.push_back(&mesh_node);
+  update_bvh_(mesh_node);
+  return mesh_node;
+}
+
+void Scene::destroy_static_mesh_node(uint32_t id) {
+  auto it = static_mesh_node_iterators_.find(id);
+  assert(it != static_mesh_node_iterators_.end());
+  // The renderer never has to hear about a node created since the last
+  // frame packet.
+  const MeshNode* mesh_node = &(*it->second);
+  auto created = std::find(created_static_mesh_nodes_.begin(),
+                           created_static_mesh_nodes_.end(), mesh_node);
+  if (created != created_static_mesh_nodes_.end())
+    created_static_mesh_nodes_.erase(created);
+  else
+    destroyed_static_mesh_node_ids_.push_back(id);
+  if (bvh_.contains(id))
+    bvh_.remove(id);
+  static_mesh_nodes_.erase(it->second);
+  static_mesh_node_iterators_.erase(it);
+}
+
+void Scene::update_bvh_(const MeshNode& mesh_node) {
+  auto bounds = mesh_bounds_.find(mesh_node.mesh_id);
+  if (bounds == mesh_bounds_.end())
+    return;
+  Aabb box = bounds->second.transform(get_model_matrix(mesh_node));
+  if (bvh_.contains(mesh_node.id))
+    bvh_.update(mesh_node.id, box);
+  else
+    bvh_.insert(mesh_node.id, box);
+}
+
+void Scene::set_mesh_bounds(uint32_t mesh_id, const Aabb& bounds) {
+  mesh_bounds_[mesh_id] = bounds;
+  for (const MeshNode& mesh_node : mesh_nodes_) {
+    if (mesh_node.mesh_id == mesh_id)
+      update_bvh_(mesh_node);
+  }
+  for (const MeshNode& mesh_node : static_mesh_nodes_) {
+    if (mesh_node.mesh_id == mesh_id)
+      update_bvh_(mesh_node);
+  }
+}
+
+void Scene::update_bvh() {
+  for (const MeshNode& mesh_node : mesh_nodes_)
+    update_bvh_(mesh_node);
+  bvh_.maintain();
+}
+
+const Bvh& Scene::get_bvh() const {
+  return bvh_;
+}
+
+TransformHierarchy& Scene::get_transforms() {
+  return transforms_;
+}
+
+const TransformHierarchy& Scene::get_transforms() const {
+  return transforms_;
+}
+
+void Scene::update_transforms() {
+  transforms_.update();
+}
+
+glm::mat4 Scene::get_model_matrix(const SceneNode& node) const {
+  if (node.transform_id == TransformHierarchy::kNoTransform)
+    return node.get_model_matrix();
+  return transforms_.get_world_matrix(node.transform_id);
+}
+
 DirectionalLightNode& Scene::create_directional_light_node(
     uint32_t pass_num,
     const glm::vec3& position,
@@ -43,6 +130,29 @@ DirectionalLightNode& Scene::create_directional_light_node(
   return directional_light_nodes_.front();
 }
 
+PointLightNode& Scene::create_point_light_node(uint32_t pass_num,
+                                               const glm::vec3& position,
+                                               float radius,
+                                               const glm::vec4& diffuse,
+                                               const glm::vec4& specular) {
+  point_light_nodes_.push_front(
+      {pass_num, position, radius, diffuse, specular});
+  return point_light_nodes_.front();
+}
+
+SpotLightNode& Scene::create_spot_light_node(uint32_t pass_num,
+                                             const glm::vec3& position,
+                                             const glm::vec3& angles,
+                                             float radius,
+                                             float inner_angle,
+                                             float outer_angle,
+                                             const glm::vec4& diffuse,
+                                             const glm::vec4& specular) {
+  spot_light_nodes_.push_front({pass_num, position, angles, radius,
+                                inner_angle, outer_angle, diffuse, specular});
+  return spot_light_nodes_.front();
+}
+
 CameraNode& Scene::create_perspective_camera_node(
     uint32_t pass_num,
     float fov,
@@ -74,6 +184,25 @@ const std::list<MeshNode>& Scene::get_mesh_nodes() const {
   return mesh_nodes_;
 }
 
+const std::list<MeshNode>& Scene::get_static_mesh_nodes() const {
+  return static_mesh_nodes_;
+}
+
+const std::vector<const MeshNode*>& Scene::get_created_static_mesh_nodes()
+    const {
+  return created_static_mesh_nodes_;
+}
+
+const std::vector<uint32_t>& Scene::get_destroyed_static_mesh_node_ids()
+    const {
+  return destroyed_static_mesh_node_ids_;
+}
+
+void Scene::clear_static_mesh_node_changes() {
+  created_static_mesh_nodes_.clear();
+  destroyed_static_mesh_node_ids_.clear();
+}
+
 const std::list<CameraNode>& Scene::get_camera_nodes() const {
   return camera_nodes_;
 }
@@ -83,6 +212,14 @@ const std::list<DirectionalLightNode>& Scene::get_directional_light_nodes()
   return directional_light_nodes_;
 }
 
+const std::list<PointLightNode>& Scene::get_point_light_nodes() const {
+  return point_light_nodes_;
+}
+
+const std::list<SpotLightNode>& Scene::get_spot_light_nodes() const {
+  return spot_light_nodes_;
+}
+
 std::list<MeshNode>& Scene::get_mesh_nodes() {
   return mesh_nodes_;
 }
@@ -95,4 +232,12 @@ std::list<DirectionalLightNode>& Scene::get_directional_light_nodes() {
   return directional_light_nodes_;
 }
 
+std::list<PointLightNode>& Scene::get_point_light_nodes() {
+  return point_light_nodes_;
+}
+
+std::list<SpotLightNode>& Scene::get_spot_light_nodes() {
+  return spot_light_nodes_;
+}
+
 }  // namespace donkey
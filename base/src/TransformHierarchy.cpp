@@ -0,0 +1,325 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "TransformHierarchy.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <future>
+#include <thread>
+
+namespace donkey {
+
+namespace {
+
+// Moves values[i] to new_indices[i], dropping the values of destroyed
+// transforms.
+template <typename T>
+void gather(std::vector<T>& values,
+            const std::vector<uint32_t>& new_indices,
+            std::size_t size) {
+  std::vector<T> ordered_values(size);
+  for (std::size_t i = 0; i < values.size(); ++i) {
+    if (new_indices[i] != TransformHierarchy::kNoTransform)
+      ordered_values[new_indices[i]] = values[i];
+  }
+  values.swap(ordered_values);
+}
+
+}  // namespace
+
+TransformHierarchy::TransformHierarchy()
+    : level_offsets_(1, 0),
+      size_(0),
+      ordered_(true),
+      dirty_(false),
+      changed_(false) {}
+
+uint32_t TransformHierarchy::get_index_(uint32_t id) const {
+  assert(contains(id));
+  return indices_[id];
+}
+
+void TransformHierarchy::set_dirty_(uint32_t index) {
+  flags_[index] |= kLocalDirty;
+  dirty_ = true;
+}
+
+uint32_t TransformHierarchy::create(uint32_t parent) {
+  return create(parent, glm::vec3(0.0f), glm::quat(1.0f, 0.0f, 0.0f, 0.0f));
+}
+
+uint32_t TransformHierarchy::create(uint32_t parent,
+                                    const glm::vec3& position,
+                                    const glm::quat& rotation,
+                                    const glm::vec3& scale) {
+  uint32_t id;
+  if (free_ids_.empty()) {
+    id = static_cast<uint32_t>(indices_.size());
+    indices_.push_back(kNoTransform);
+  } else {
+    id = free_ids_.back();
+    free_ids_.pop_back();
+  }
+  uint32_t parent_index =
+      (parent == kNoTransform) ? kNoTransform : get_index_(parent);
+  uint32_t depth =
+      (parent_index == kNoTransform) ? 0 : depths_[parent_index] + 1;
+  indices_[id] = static_cast<uint32_t>(ids_.size());
+  ids_.push_back(id);
+  parents_.push_back(parent_index);
+  depths_.push_back(depth);
+  positions_.push_back(position);
+  rotations_.push_back(rotation);
+  scales_.push_back(scale);
+  world_matrices_.push_back(glm::mat4(1.0f));
+  flags_.push_back(kLocalDirty);
+  ++size_;
+  dirty_ = true;
+
+  // Appending keeps the arrays sorted unless it goes back up a level.
+  if (ordered_) {
+    std::size_t level_count = get_level_count();
+    if (depth + 1 == level_count)
+      ++level_offsets_.back();
+    else if (depth == level_count)
+      level_offsets_.push_back(level_offsets_.back() + 1);
+    else
+      ordered_ = false;
+  }
+  return id;
+}
+
+void TransformHierarchy::destroy(uint32_t id) {
+  uint32_t index = get_index_(id);
+  // Left in the arrays until the next update reorders them.
+  ids_[index] = kNoTransform;
+  indices_[id] = kNoTransform;
+  free_ids_.push_back(id);
+  --size_;
+  ordered_ = false;
+  dirty_ = true;
+}
+
+void TransformHierarchy::set_parent(uint32_t id, uint32_t parent) {
+  uint32_t index = get_index_(id);
+  uint32_t parent_index =
+      (parent == kNoTransform) ? kNoTransform : get_index_(parent);
+  for (uint32_t ancestor = parent_index; ancestor != kNoTransform;
+       ancestor = parents_[ancestor]) {
+    assert(ancestor != index);  // can't be attached below itself
+  }
+  parents_[index] = parent_index;
+  set_dirty_(index);
+  ordered_ = false;
+}
+
+uint32_t TransformHierarchy::get_parent(uint32_t id) const {
+  uint32_t parent_index = parents_[get_index_(id)];
+  return (parent_index == kNoTransform) ? kNoTransform : ids_[parent_index];
+}
+
+bool TransformHierarchy::contains(uint32_t id) const {
+  return id < indices_.size() && indices_[id] != kNoTransform;
+}
+
+std::size_t TransformHierarchy::size() const {
+  return size_;
+}
+
+std::size_t TransformHierarchy::get_level_count() const {
+  return level_offsets_.size() - 1;
+}
+
+void TransformHierarchy::set_position(uint32_t id, const glm::vec3& position) {
+  uint32_t index = get_index_(id);
+  positions_[index] = position;
+  set_dirty_(index);
+}
+
+void TransformHierarchy::set_rotation(uint32_t id, const glm::quat& rotation) {
+  uint32_t index = get_index_(id);
+  rotations_[index] = rotation;
+  set_dirty_(index);
+}
+
+void TransformHierarchy::set_scale(uint32_t id, const glm::vec3& scale) {
+  uint32_t index = get_index_(id);
+  scales_[index] = scale;
+  set_dirty_(index);
+}
+
+const glm::vec3& TransformHierarchy::get_position(uint32_t id) const {
+  return positions_[get_index_(id)];
+}
+
+const glm::quat& TransformHierarchy::get_rotation(uint32_t id) const {
+  return rotations_[get_index_(id)];
+}
+
+const glm::vec3& TransformHierarchy::get_scale(uint32_t id) const {
+  return scales_[get_index_(id)];
+}
+
+const glm::mat4& TransformHierarchy::get_world_matrix(uint32_t id) const {
+  return world_matrices_[get_index_(id)];
+}
+
+bool TransformHierarchy::has_changed(uint32_t id) const {
+  return (flags_[get_index_(id)] & kWorldChanged) != 0;
+}
+
+void TransformHierarchy::reorder_() {
+  std::size_t count = ids_.size();
+  // Children of destroyed transforms become roots.
+  for (std::size_t i = 0; i < count; ++i) {
+    uint32_t parent = parents_[i];
+    if (ids_[i] != kNoTransform && parent != kNoTransform &&
+        ids_[parent] == kNoTransform) {
+      parents_[i] = kNoTransform;
+      flags_[i] |= kLocalDirty;
+    }
+  }
+
+  // Parents may come after their children by now: walk up to the closest
+  // ancestor of known depth and number the way back down.
+  std::vector<uint32_t> depths(count, kNoTransform);
+  std::vector<uint32_t> path;
+  std::size_t level_count = 0;
+  for (std::size_t i = 0; i < count; ++i) {
+    if (ids_[i] == kNoTransform || depths[i] != kNoTransform)
+      continue;
+    uint32_t index = static_cast<uint32_t>(i);
+    while (index != kNoTransform && depths[index] == kNoTransform) {
+      path.push_back(index);
+      index = parents_[index];
+    }
+    uint32_t depth = (index == kNoTransform) ? 0 : depths[index] + 1;
+    for (; !path.empty(); path.pop_back())
+      depths[path.back()] = depth++;
+    level_count = std::max<std::size_t>(level_count, depth);
+  }
+
+  // Counting sort by depth, stable so that siblings created together stay
+  // together.
+  level_offsets_.assign(level_count + 1, 0);
+  for (std::size_t i = 0; i < count; ++i) {
+    if (ids_[i] != kNoTransform)
+      ++level_offsets_[depths[i] + 1];
+  }
+  for (std::size_t level = 1; level <= level_count; ++level)
+    level_offsets_[level] += level_offsets_[level - 1];
+  std::vector<std::size_t> next_indices(level_offsets_.begin(),
+                                        level_offsets_.end() - 1);
+  std::vector<uint32_t> new_indices(count, kNoTransform);
+  for (std::size_t i = 0; i < count; ++i) {
+    if (ids_[i] != kNoTransform)
+      new_indices[i] = static_cast<uint32_t>(next_indices[depths[i]]++);
+  }
+
+  gather(ids_, new_indices, size_);
+  gather(parents_, new_indices, size_);
+  gather(depths, new_indices, size_);
+  gather(positions_, new_indices, size_);
+  gather(rotations_, new_indices, size_);
+  gather(scales_, new_indices, size_);
+  gather(world_matrices_, new_indices, size_);
+  gather(flags_, new_indices, size_);
+  depths_.swap(depths);
+  for (std::size_t i = 0; i < size_; ++i) {
+    if (parents_[i] != kNoTransform)
+      parents_[i] = new_indices[parents_[i]];
+    indices_[ids_[i]] = static_cast<uint32_t>(i);
+  }
+  ordered_ = true;
+}
+
+void TransformHierarchy::update_range_(std::size_t begin, std::size_t end) {
+  for (std::size_t i = begin; i < end; ++i) {
+    uint32_t parent = parents_[i];
+    bool moved = (flags_[i] & kLocalDirty) ||
+                 (parent != kNoTransform && (flags_[parent] & kWorldChanged));
+    if (!moved) {
+      flags_[i] = 0;
+      continue;
+    }
+    glm::mat3 rotation = glm::mat3_cast(rotations_[i]);
+    const glm::vec3& scale = scales_[i];
+    glm::mat4 local(glm::vec4(rotation[0] * scale.x, 0.0f),
+                    glm::vec4(rotation[1] * scale.y, 0.0f),
+                    glm::vec4(rotation[2] * scale.z, 0.0f),
+                    glm::vec4(positions_[i], 1.0f));
+    world_matrices_[i] =
+        (parent == kNoTransform) ? local : world_matrices_[parent] * local;
+    flags_[i] = kWorldChanged;
+  }
+}
+
+void TransformHierarchy::update() {
+  if (!dirty_) {
+    if (changed_) {
+      std::fill(flags_.begin(), flags_.end(), 0);
+      changed_ = false;
+    }
+    return;
+  }
+  if (!ordered_)
+    reorder_();
+
+  // A level only reads the one above it, which is done by then.
+  std::size_t thread_count =
+      std::max<std::size_t>(std::thread::hardware_concurrency(), 1);
+  for (std::size_t level = 0; level < get_level_count(); ++level) {
+    std::size_t begin = level_offsets_[level];
+    std::size_t end = level_offsets_[level + 1];
+    std::size_t chunk_count =
+        std::min(thread_count, (end - begin) / kParallelNodeCount);
+    if (chunk_count < 2) {
+      update_range_(begin, end);
+      continue;
+    }
+    std::size_t chunk_size = (end - begin + chunk_count - 1) / chunk_count;
+    std::vector<std::future<void>> chunks;
+    for (std::size_t chunk_begin = begin + chunk_size; chunk_begin < end;
+         chunk_begin += chunk_size) {
+      chunks.push_back(std::async(std::launch::async,
+                                  &TransformHierarchy::update_range_, this,
+                                  chunk_begin,
+                                  std::min(chunk_begin + chunk_size, end)));
+    }
+    update_range_(begin, begin + chunk_size);
+    for (std::future<void>& chunk : chunks)
+      chunk.wait();
+  }
+  dirty_ = false;
+  changed_ = true;
+}
+
+glm::quat TransformHierarchy::make_rotation(const glm::vec3& angles) {
+  // make_model_matrix chains its rotate calls and then multiplies their
+  // results together, compounding them into x y z x y x.
+  glm::quat x =
+      glm::angleAxis(glm::radians(angles.x), glm::vec3(1.0f, 0.0f, 0.0f));
+  glm::quat y =
+      glm::angleAxis(glm::radians(angles.y), glm::vec3(0.0f, 1.0f, 0.0f));
+  glm::quat z =
+      glm::angleAxis(glm::radians(angles.z), glm::vec3(0.0f, 0.0f, 1.0f));
+  glm::quat xy = x * y;
+  return xy * z * xy * x;
+}
+
+}  // namespace donkey
@@ -0,0 +1,86 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "bounds.hpp"
+
+#include <algorithm>
+
+namespace donkey {
+
+float Aabb::intersect(const glm::vec3& origin,
+                      const glm::vec3& inverse_direction,
+                      float max_distance) const {
+  // Slabs. An origin lying on a flat axis' slab gives 0 * inf = NaN, which
+  // std::max and std::min below drop since they keep their first argument.
+  float enter_distance = 0.0f;
+  float exit_distance = max_distance;
+  for (int axis = 0; axis < 3; ++axis) {
+    float t0 = (min[axis] - origin[axis]) * inverse_direction[axis];
+    float t1 = (max[axis] - origin[axis]) * inverse_direction[axis];
+    if (t0 > t1)
+      std::swap(t0, t1);
+    enter_distance = std::max(enter_distance, t0);
+    exit_distance = std::min(exit_distance, t1);
+    if (enter_distance > exit_distance)
+      return -1.0f;
+  }
+  return enter_distance;
+}
+
+Aabb Aabb::transform(const glm::mat4& matrix) const {
+  // J. Arvo, "Transforming Axis-Aligned Bounding Boxes", Graphics Gems 1990.
+  glm::vec3 center = glm::vec3(matrix * glm::vec4(get_center(), 1.0f));
+  glm::vec3 half_size = get_half_size();
+  glm::vec3 extent(0.0f);
+  for (int column = 0; column < 3; ++column)
+    extent += glm::abs(glm::vec3(matrix[column])) * half_size[column];
+  return Aabb(center - extent, center + extent);
+}
+
+Frustum::Frustum(const glm::mat4& view_projection) {
+  glm::mat4 m = glm::transpose(view_projection);  // rows as columns
+  planes[0] = m[3] + m[0];  // left
+  planes[1] = m[3] - m[0];  // right
+  planes[2] = m[3] + m[1];  // bottom
+  planes[3] = m[3] - m[1];  // top
+  planes[4] = m[3] + m[2];  // near
+  planes[5] = m[3] - m[2];  // far
+  for (glm::vec4& plane : planes)
+    plane /= glm::length(glm::vec3(plane));
+}
+
+Frustum::Test Frustum::test(const Aabb& box) const {
+  glm::vec3 center = box.get_center();
+  glm::vec3 half_size = box.get_half_size();
+  Test result = Test::kInside;
+  for (const glm::vec4& plane : planes) {
+    glm::vec3 normal(plane);
+    float distance = glm::dot(normal, center) + plane.w;
+    float radius = glm::dot(glm::abs(normal), half_size);
+    if (distance < -radius)
+      return Test::kOutside;
+    if (distance < radius)
+      result = Test::kIntersecting;
+  }
+  return result;
+}
+
+bool Frustum::intersects(const Aabb& box) const {
+  return test(box) != Test::kOutside;
+}
+
+}  // namespace donkey
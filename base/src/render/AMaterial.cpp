@@ -17,32 +17,23 @@
 
 #include "render/AMaterial.hpp"
 
-#include "render/gl/ResourceManager.hpp"
+#include "render/CommandBucket.hpp"
 
 namespace donkey {
 
 namespace render {
 
-AMaterial::AMaterial(uint32_t program_id) : program_id(program_id) {}
+AMaterial::AMaterial(uint32_t program_id)
+    : parameters_dirty_(false), program_id(program_id) {}
 
-#define BIND_SLOTS(x)            \
-  for (auto slot : x##_slots_) { \
-    slot.bind(render_commands);  \
-  }
-
-void AMaterial::bind_slots(CommandBucket& render_commands) const {
-  BIND_SLOTS(texture);
-  BIND_SLOTS(float)
-  BIND_SLOTS(vec2)
-  BIND_SLOTS(vec3)
-  BIND_SLOTS(vec4)
-  BIND_SLOTS(mat2)
-  BIND_SLOTS(mat2)
-  BIND_SLOTS(mat4)
-  BIND_SLOTS(int)
+void AMaterial::bind(uint32_t material_id,
+                     CommandBucket& render_commands) const {
+  render_commands.bind_gpu_program(program_id);
+  if (!parameters_.empty())
+    render_commands.bind_material_parameters(material_id);
+  for (const TextureMaterialSlot& slot : texture_slots_)
+    slot.bind(render_commands);
 }
 
-#undef BIND_SLOTS
-
 }  // namespace render
 }  // namespace donkey
@@ -0,0 +1,104 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "render/CaptureDriver.hpp"
+
+#include <fstream>
+#include <iostream>
+
+#include "render/binary_io.hpp"
+
+namespace donkey {
+namespace render {
+
+CaptureDriver::CaptureDriver(GpuDriver& driver)
+    : driver_(driver), resource_manager_(driver.get_resource_manager()) {}
+
+CaptureDriver::~CaptureDriver() {}
+
+UniformStorage CaptureDriver::begin_frame() {
+  return driver_.begin_frame();
+}
+
+void CaptureDriver::execute_commands(const CommandBucket& commands) {
+  std::string path;
+  {
+    std::lock_guard<std::mutex> lock(capture_mutex_);
+    path.swap(capture_path_);
+  }
+  if (!path.empty())
+    write_capture_(path, commands);
+  driver_.execute_commands(commands);
+}
+
+GpuResourceManager& CaptureDriver::get_resource_manager() {
+  return resource_manager_;
+}
+
+uint64_t CaptureDriver::get_samples_passed() const {
+  return driver_.get_samples_passed();
+}
+
+std::size_t CaptureDriver::get_draw_call_count() const {
+  return driver_.get_draw_call_count();
+}
+
+float CaptureDriver::get_gpu_frame_time() const {
+  return driver_.get_gpu_frame_time();
+}
+
+void CaptureDriver::capture_next_frame(const std::string& path) {
+  std::lock_guard<std::mutex> lock(capture_mutex_);
+  capture_path_ = path;
+}
+
+void CaptureDriver::write_capture_(const std::string& path,
+                                   const CommandBucket& commands) {
+  std::ofstream out(path, std::ios::binary);
+  if (!out) {
+    std::cerr << "Couldn't open " << path << " to capture a frame.\n";
+    return;
+  }
+  binary_io::write(out, static_cast<uint32_t>(kMagic));
+  binary_io::write(out, static_cast<uint32_t>(kVersion));
+  resource_manager_.write_journal(out);
+  CommandStream::write(out, commands);
+  std::cout << "Captured " << commands.get_commands().size()
+            << " commands to " << path << ".\n";
+}
+
+bool CaptureDriver::load_capture(const std::string& path,
+                                 GpuResourceManager& resource_manager,
+                                 CommandStream& commands) {
+  std::ifstream in(path, std::ios::binary);
+  uint32_t magic;
+  uint32_t version;
+  if (!binary_io::read(in, magic) || !binary_io::read(in, version) ||
+      magic != kMagic || version != kVersion) {
+    std::cerr << path << " isn't a frame capture of this version.\n";
+    return false;
+  }
+  if (!CaptureResourceManager::replay_journal(in, resource_manager) ||
+      !commands.read(in)) {
+    std::cerr << path << " is truncated or corrupted.\n";
+    return false;
+  }
+  return true;
+}
+
+}  // namespace render
+}  // namespace donkey
@@ -0,0 +1,379 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "render/CaptureResourceManager.hpp"
+
+#include <iostream>
+#include <list>
+
+#include "render/Texture.hpp"
+#include "render/binary_io.hpp"
+
+namespace donkey {
+namespace render {
+
+namespace {
+
+// Enums are journaled as bytes.
+template <typename T>
+void write_enum(std::ostream& out, T value) {
+  binary_io::write(out, static_cast<uint8_t>(value));
+}
+
+template <typename T>
+bool read_enum(std::istream& in, T& value) {
+  uint8_t byte;
+  if (!binary_io::read(in, byte))
+    return false;
+  value = static_cast<T>(byte);
+  return true;
+}
+
+// Stands in for a mesh whose data wasn't kept: as many zeroed vertices and
+// indices as the original, so that it lands at the same place in the mesh
+// buffer and costs about as much to draw.
+bool replay_mesh(std::istream& in, GpuResourceManager& resource_manager) {
+  uint32_t sizes[6];
+  if (!binary_io::read(in, sizes))
+    return false;
+  std::vector<float> positions(sizes[0]), normals(sizes[1]), uvs(sizes[2]),
+      tangents(sizes[3]), bitangents(sizes[4]);
+  std::vector<uint32_t> indices(sizes[5]);
+  uint32_t vertex_count = sizes[0] / 3;
+  for (std::size_t i = 0; vertex_count > 0 && i < indices.size(); ++i)
+    indices[i] = static_cast<uint32_t>(i % vertex_count);
+  resource_manager.create_mesh(positions, normals, uvs, tangents, bitangents,
+                               indices);
+  return true;
+}
+
+}  // namespace
+
+CaptureResourceManager::CaptureResourceManager(
+    GpuResourceManager& resource_manager)
+    : resource_manager_(resource_manager),
+      journal_(std::ios::out | std::ios::binary),
+      entry_count_(0) {}
+
+CaptureResourceManager::~CaptureResourceManager() {}
+
+void CaptureResourceManager::begin_entry_(Entry entry) {
+  write_enum(journal_, entry);
+  ++entry_count_;
+}
+
+void CaptureResourceManager::write_destroy_entry_(Entry entry, uint32_t id) {
+  begin_entry_(entry);
+  binary_io::write(journal_, id);
+}
+
+void CaptureResourceManager::write_journal(std::ostream& out) const {
+  binary_io::write(out, entry_count_);
+  std::string journal = journal_.str();
+  binary_io::write_bytes(out, journal.data(), journal.size());
+}
+
+bool CaptureResourceManager::replay_journal(
+    std::istream& in,
+    GpuResourceManager& resource_manager) {
+  uint32_t entry_count;
+  if (!binary_io::read(in, entry_count))
+    return false;
+  for (uint32_t i = 0; i < entry_count; ++i) {
+    Entry entry;
+    if (!read_enum(in, entry))
+      return false;
+    switch (entry) {
+      case Entry::kTextureFromMemory: {
+        int32_t size[2];
+        if (!binary_io::read(in, size) || size[0] < 0 || size[1] < 0)
+          return false;
+        std::vector<uint8_t> pixels(
+            static_cast<std::size_t>(size[0]) * size[1] * 4, 0x80);
+        resource_manager.load_texture_from_memory(pixels.data(), size[0],
+                                                  size[1]);
+        break;
+      }
+      case Entry::kGpuProgram: {
+        std::string vs_path;
+        std::string fs_path;
+        if (!binary_io::read_string(in, vs_path) ||
+            !binary_io::read_string(in, fs_path))
+          return false;
+        resource_manager.load_gpu_program_from_file(vs_path, fs_path);
+        break;
+      }
+      case Entry::kGpuProgramFromSources: {
+        std::string vs_sources;
+        std::string fs_sources;
+        if (!binary_io::read_string(in, vs_sources) ||
+            !binary_io::read_string(in, fs_sources))
+          return false;
+        resource_manager.load_gpu_program_from_sources(vs_sources,
+                                                       fs_sources);
+        break;
+      }
+      case Entry::kMesh:
+        if (!replay_mesh(in, resource_manager))
+          return false;
+        break;
+      case Entry::kMaterial: {
+        uint32_t gpu_program;
+        if (!binary_io::read(in, gpu_program))
+          return false;
+        resource_manager.create_material(gpu_program);
+        break;
+      }
+      case Entry::kTexture: {
+        uint64_t size[2];
+        pixel::Format format;
+        pixel::InternalFormat internal_format;
+        pixel::ComponentType component_type;
+        if (!binary_io::read(in, size) || !read_enum(in, format) ||
+            !read_enum(in, internal_format) || !read_enum(in, component_type))
+          return false;
+        resource_manager.create_texture(
+            static_cast<std::size_t>(size[0]),
+            static_cast<std::size_t>(size[1]), format, internal_format,
+            component_type);
+        break;
+      }
+      case Entry::kTextureBuffer: {
+        pixel::BufferFormat format;
+        if (!read_enum(in, format))
+          return false;
+        resource_manager.create_texture_buffer(format);
+        break;
+      }
+      case Entry::kFramebuffer: {
+        uint32_t depth_rt_id;
+        uint32_t color_rt_count;
+        if (!binary_io::read(in, depth_rt_id) ||
+            !binary_io::read(in, color_rt_count) ||
+            !binary_io::has_bytes(in, static_cast<uint64_t>(color_rt_count) *
+                                          sizeof(uint32_t)))
+          return false;
+        std::vector<uint32_t> color_rt_ids(color_rt_count);
+        if (!binary_io::read_bytes(in, color_rt_ids.data(),
+                                   color_rt_count * sizeof(uint32_t)))
+          return false;
+        resource_manager.create_framebuffer(depth_rt_id, color_rt_ids);
+        break;
+      }
+      case Entry::kRenderTargetFramebuffer: {
+        uint32_t render_target_count;
+        if (!binary_io::read(in, render_target_count))
+          return false;
+        std::list<Texture> textures;
+        std::list<const Texture*> render_targets;
+        for (uint32_t j = 0; j < render_target_count; ++j) {
+          uint32_t id;
+          pixel::Format format;
+          pixel::InternalFormat internal_format;
+          pixel::ComponentType component_type;
+          if (!binary_io::read(in, id) || !read_enum(in, format) ||
+              !read_enum(in, internal_format) ||
+              !read_enum(in, component_type))
+            return false;
+          textures.push_back(
+              Texture(id, format, internal_format, component_type));
+          render_targets.push_back(&textures.back());
+        }
+        resource_manager.create_framebuffer(render_targets);
+        break;
+      }
+      case Entry::kState: {
+        State state(0);
+        if (!binary_io::read(in, state))
+          return false;
+        resource_manager.create_state(state);
+        break;
+      }
+      case Entry::kDestroyTexture:
+      case Entry::kDestroyGpuProgram:
+      case Entry::kDestroyMesh:
+      case Entry::kDestroyMaterial:
+      case Entry::kDestroyState: {
+        uint32_t id;
+        if (!binary_io::read(in, id))
+          return false;
+        if (entry == Entry::kDestroyTexture)
+          resource_manager.destroy_texture(id);
+        else if (entry == Entry::kDestroyGpuProgram)
+          resource_manager.destroy_gpu_program(id);
+        else if (entry == Entry::kDestroyMesh)
+          resource_manager.destroy_mesh(id);
+        else if (entry == Entry::kDestroyMaterial)
+          resource_manager.destroy_material(id);
+        else
+          resource_manager.destroy_state(id);
+        break;
+      }
+      default:
+        std::cerr << "Unknown resource journal entry "
+                  << static_cast<int>(entry) << ".\n";
+        return false;
+    }
+  }
+  return static_cast<bool>(in);
+}
+
+void CaptureResourceManager::cleanup() {
+  resource_manager_.cleanup();
+}
+
+uint32_t CaptureResourceManager::load_texture_from_memory(uint8_t* pixels,
+                                                          int width,
+                                                          int height) {
+  begin_entry_(Entry::kTextureFromMemory);
+  int32_t size[2] = {width, height};
+  binary_io::write(journal_, size);
+  return resource_manager_.load_texture_from_memory(pixels, width, height);
+}
+
+uint32_t CaptureResourceManager::load_gpu_program_from_file(
+    const std::string& vs_path,
+    const std::string& fs_path) {
+  begin_entry_(Entry::kGpuProgram);
+  binary_io::write_string(journal_, vs_path);
+  binary_io::write_string(journal_, fs_path);
+  return resource_manager_.load_gpu_program_from_file(vs_path, fs_path);
+}
+
+uint32_t CaptureResourceManager::load_gpu_program_from_sources(
+    const std::string& vs_sources,
+    const std::string& fs_sources) {
+  begin_entry_(Entry::kGpuProgramFromSources);
+  binary_io::write_string(journal_, vs_sources);
+  binary_io::write_string(journal_, fs_sources);
+  return resource_manager_.load_gpu_program_from_sources(vs_sources,
+                                                         fs_sources);
+}
+
+uint32_t CaptureResourceManager::create_mesh(
+    const std::vector<float>& positions,
+    const std::vector<float>& normals,
+    const std::vector<float>& uvs,
+    const std::vector<float>& tangents,
+    const std::vector<float>& bitangents,
+    const std::vector<uint32_t>& indices) {
+  begin_entry_(Entry::kMesh);
+  uint32_t sizes[6] = {static_cast<uint32_t>(positions.size()),
+                       static_cast<uint32_t>(normals.size()),
+                       static_cast<uint32_t>(uvs.size()),
+                       static_cast<uint32_t>(tangents.size()),
+                       static_cast<uint32_t>(bitangents.size()),
+                       static_cast<uint32_t>(indices.size())};
+  binary_io::write(journal_, sizes);
+  return resource_manager_.create_mesh(positions, normals, uvs, tangents,
+                                       bitangents, indices);
+}
+
+DrawElementsIndirect CaptureResourceManager::get_mesh_draw(uint32_t id) const {
+  return resource_manager_.get_mesh_draw(id);
+}
+
+uint32_t CaptureResourceManager::create_material(uint32_t gpu_program) {
+  begin_entry_(Entry::kMaterial);
+  binary_io::write(journal_, gpu_program);
+  return resource_manager_.create_material(gpu_program);
+}
+
+uint32_t CaptureResourceManager::create_texture(
+    std::size_t width,
+    std::size_t height,
+    pixel::Format format,
+    pixel::InternalFormat internal_format,
+    pixel::ComponentType component_type) {
+  begin_entry_(Entry::kTexture);
+  uint64_t size[2] = {width, height};
+  binary_io::write(journal_, size);
+  write_enum(journal_, format);
+  write_enum(journal_, internal_format);
+  write_enum(journal_, component_type);
+  return resource_manager_.create_texture(width, height, format,
+                                          internal_format, component_type);
+}
+
+uint32_t CaptureResourceManager::create_texture_buffer(
+    pixel::BufferFormat format) {
+  begin_entry_(Entry::kTextureBuffer);
+  write_enum(journal_, format);
+  return resource_manager_.create_texture_buffer(format);
+}
+
+uint32_t CaptureResourceManager::create_framebuffer(
+    uint32_t depth_rt_id,
+    const std::vector<uint32_t>& color_rt_ids) {
+  begin_entry_(Entry::kFramebuffer);
+  binary_io::write(journal_, depth_rt_id);
+  binary_io::write(journal_, static_cast<uint32_t>(color_rt_ids.size()));
+  binary_io::write_bytes(journal_, color_rt_ids.data(),
+                         color_rt_ids.size() * sizeof(uint32_t));
+  return resource_manager_.create_framebuffer(depth_rt_id, color_rt_ids);
+}
+
+uint32_t CaptureResourceManager::create_framebuffer(
+    const std::list<const donkey::render::Texture*>& render_targets) {
+  begin_entry_(Entry::kRenderTargetFramebuffer);
+  binary_io::write(journal_, static_cast<uint32_t>(render_targets.size()));
+  for (const Texture* texture : render_targets) {
+    binary_io::write(journal_, texture->gpu_resource_id);
+    write_enum(journal_, texture->format);
+    write_enum(journal_, texture->internal_format);
+    write_enum(journal_, texture->component_type);
+  }
+  return resource_manager_.create_framebuffer(render_targets);
+}
+
+uint32_t CaptureResourceManager::create_state(const render::State& state) {
+  begin_entry_(Entry::kState);
+  binary_io::write(journal_, state);
+  return resource_manager_.create_state(state);
+}
+
+AMaterial& CaptureResourceManager::get_material(std::uint32_t id) {
+  return resource_manager_.get_material(id);
+}
+
+void CaptureResourceManager::destroy_texture(uint32_t id) {
+  write_destroy_entry_(Entry::kDestroyTexture, id);
+  resource_manager_.destroy_texture(id);
+}
+
+void CaptureResourceManager::destroy_gpu_program(uint32_t id) {
+  write_destroy_entry_(Entry::kDestroyGpuProgram, id);
+  resource_manager_.destroy_gpu_program(id);
+}
+
+void CaptureResourceManager::destroy_mesh(uint32_t id) {
+  write_destroy_entry_(Entry::kDestroyMesh, id);
+  resource_manager_.destroy_mesh(id);
+}
+
+void CaptureResourceManager::destroy_material(uint32_t id) {
+  write_destroy_entry_(Entry::kDestroyMaterial, id);
+  resource_manager_.destroy_material(id);
+}
+
+void CaptureResourceManager::destroy_state(uint32_t id) {
+  write_destroy_entry_(Entry::kDestroyState, id);
+  resource_manager_.destroy_state(id);
+}
+
+}  // namespace render
+}  // namespace donkey
@@ -0,0 +1,528 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "render/ClusteredLighting.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+#include <glm/gtc/matrix_transform.hpp>
+#include <iostream>
+
+#include "render/UniformBlock.hpp"
+
+// Same kernel selection as image.cpp, the sphere tests only need SSE2.
+#if defined(__SSE2__) || defined(_M_X64)
+#define STURDY_DONKEY_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define STURDY_DONKEY_NEON
+#include <arm_neon.h>
+#endif
+
+namespace donkey {
+namespace render {
+
+ClusteredLighting::ClusteredLighting()
+    : light_buffer_id_(0),
+      cluster_buffer_id_(0),
+      light_index_buffer_id_(0),
+      projection_(0.0f),
+      viewport_size_(0, 0),
+      near_plane_(0.0f),
+      far_plane_(0.0f),
+      tile_count_x_(0),
+      tile_count_y_(0),
+      slice_scale_(0.0f),
+      slice_bias_(0.0f),
+      local_light_binning_(true),
+      generation_(0),
+      pending_workers_(0),
+      quit_(false) {
+  // The simulation and render threads are already busy, the render thread
+  // takes its share of the slices while the workers run.
+  std::size_t thread_count = std::thread::hardware_concurrency();
+  thread_count = (thread_count > 2) ? thread_count - 2 : 1;
+  thread_count = std::min<std::size_t>(thread_count, kSliceCount);
+  bins_.resize(thread_count);
+  for (std::size_t i = 1; i < thread_count; ++i)
+    workers_.emplace_back(&ClusteredLighting::work_, this, i);
+}
+
+ClusteredLighting::~ClusteredLighting() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    quit_ = true;
+  }
+  work_condition_.notify_all();
+  for (std::thread& worker : workers_)
+    worker.join();
+}
+
+void ClusteredLighting::set_texture_buffers(uint32_t light_buffer_id,
+                                            uint32_t cluster_buffer_id,
+                                            uint32_t light_index_buffer_id) {
+  light_buffer_id_ = light_buffer_id;
+  cluster_buffer_id_ = cluster_buffer_id;
+  light_index_buffer_id_ = light_index_buffer_id;
+}
+
+void ClusteredLighting::set_local_light_binning(bool enable) {
+  local_light_binning_ = enable;
+}
+
+void ClusteredLighting::update_clusters_(const CameraNode& camera_node) {
+  if (!min_x_.empty() && camera_node.projection == projection_ &&
+      camera_node.viewport_size == viewport_size_) {
+    return;
+  }
+  projection_ = camera_node.projection;
+  viewport_size_ = camera_node.viewport_size;
+  near_plane_ = camera_node.near_plane;
+  far_plane_ = camera_node.far_plane;
+  assert(near_plane_ > 0.0f && far_plane_ > near_plane_);
+  tile_count_x_ = (viewport_size_.x + kTileSize - 1) / kTileSize;
+  tile_count_y_ = (viewport_size_.y + kTileSize - 1) / kTileSize;
+  // Slices are exponentially distributed so that clusters stay roughly
+  // cubic: slice k spans [near * (far / near)^(k / S), near * ...^(k + 1)).
+  slice_scale_ = kSliceCount / std::log(far_plane_ / near_plane_);
+  slice_bias_ = -std::log(near_plane_) * slice_scale_;
+
+  // View space directions through the tile corners, scaled to z = -1.
+  glm::mat4 projection_inverse = glm::inverse(projection_);
+  std::vector<glm::vec3> corners((tile_count_x_ + 1) * (tile_count_y_ + 1));
+  for (int y = 0; y <= tile_count_y_; ++y) {
+    for (int x = 0; x <= tile_count_x_; ++x) {
+      float ndc_x = std::min(x * kTileSize, viewport_size_.x) * 2.0f /
+                        viewport_size_.x -
+                    1.0f;
+      float ndc_y = std::min(y * kTileSize, viewport_size_.y) * 2.0f /
+                        viewport_size_.y -
+                    1.0f;
+      glm::vec4 point =
+          projection_inverse * glm::vec4(ndc_x, ndc_y, -1.0f, 1.0f);
+      glm::vec3 direction(point.x, point.y, point.z);
+      corners[y * (tile_count_x_ + 1) + x] = direction / -direction.z;
+    }
+  }
+
+  // Pad to a multiple of 4 with boxes that can't be hit.
+  std::size_t cluster_count = static_cast<std::size_t>(tile_count_x_) *
+                              tile_count_y_ * kSliceCount;
+  for (std::vector<float>* bounds : {&min_x_, &min_y_, &min_z_})
+    bounds->assign(cluster_count + 3, FLT_MAX);
+  for (std::vector<float>* bounds : {&max_x_, &max_y_, &max_z_})
+    bounds->assign(cluster_count + 3, -FLT_MAX);
+  clusters_.resize(cluster_count * 2);
+
+  float ratio = far_plane_ / near_plane_;
+  std::size_t cluster = 0;
+  for (int slice = 0; slice < kSliceCount; ++slice) {
+    float slice_near =
+        near_plane_ * std::pow(ratio, slice / float(kSliceCount));
+    float slice_far =
+        near_plane_ * std::pow(ratio, (slice + 1) / float(kSliceCount));
+    for (int y = 0; y < tile_count_y_; ++y) {
+      for (int x = 0; x < tile_count_x_; ++x) {
+        glm::vec3 min(FLT_MAX);
+        glm::vec3 max(-FLT_MAX);
+        for (int corner = 0; corner < 4; ++corner) {
+          const glm::vec3& direction =
+              corners[(y + corner / 2) * (tile_count_x_ + 1) + x + corner % 2];
+          for (float depth : {slice_near, slice_far}) {
+            min = glm::min(min, direction * depth);
+            max = glm::max(max, direction * depth);
+          }
+        }
+        min_x_[cluster] = min.x;
+        min_y_[cluster] = min.y;
+        min_z_[cluster] = min.z;
+        max_x_[cluster] = max.x;
+        max_y_[cluster] = max.y;
+        max_z_[cluster] = max.z;
+        ++cluster;
+      }
+    }
+  }
+}
+
+int ClusteredLighting::get_slice_(float depth) const {
+  int slice = static_cast<int>(std::log(depth) * slice_scale_ + slice_bias_);
+  return std::min(std::max(slice, 0), kSliceCount - 1);
+}
+
+void ClusteredLighting::add_directional_light_(
+    const glm::mat4& view,
+    const DirectionalLightNode& light_node) {
+  glm::vec4 direction = view * light_node.get_model_matrix() *
+                        glm::vec4(0.0f, 0.0f, -1.0f, 0.0f);
+  Light light;
+  light.position = glm::vec4(
+      glm::normalize(glm::vec3(direction.x, direction.y, direction.z)), 0.0f);
+  light.diffuse = light_node.diffuse;
+  light.specular = light_node.specular;
+  light.spot = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+  lights_.push_back(light);
+}
+
+void ClusteredLighting::add_point_light_(const glm::mat4& view,
+                                         const PointLightNode& light_node) {
+  glm::vec4 center = view * glm::vec4(light_node.position, 1.0f);
+  float radius = light_node.radius;
+  Light light = {glm::vec4(center.x, center.y, center.z, radius),
+                 light_node.diffuse, light_node.specular,
+                 glm::vec4(0.0f, 0.0f, 0.0f, 1.0f)};
+  if (!add_local_light_(light.position, light))
+    return;
+  glm::mat4 volume_model =
+      glm::scale(glm::translate(glm::mat4(1.0f), light_node.position),
+                 glm::vec3(radius));
+  light_volumes_.push_back(
+      {static_cast<uint32_t>(lights_.size() - 1), false, volume_model});
+}
+
+void ClusteredLighting::add_spot_light_(const glm::mat4& view,
+                                        const SpotLightNode& light_node) {
+  const glm::mat4& model = light_node.get_model_matrix();
+  glm::vec4 direction = view * model * glm::vec4(0.0f, 0.0f, -1.0f, 0.0f);
+  glm::vec3 axis = glm::normalize(glm::vec3(direction.x, direction.y,
+                                            direction.z));
+  glm::vec4 center = view * glm::vec4(light_node.position, 1.0f);
+  glm::vec3 position(center.x, center.y, center.z);
+
+  // Cones wider than 89 degrees can't be drawn as a volume.
+  float outer_angle =
+      glm::radians(std::min(std::max(light_node.outer_angle, 1.0f), 89.0f));
+  float inner_angle =
+      std::min(glm::radians(light_node.inner_angle), outer_angle);
+  float cos_outer = std::cos(outer_angle);
+  float cone_scale = 1.0f / std::max(std::cos(inner_angle) - cos_outer, 1e-4f);
+  float radius = light_node.radius;
+  Light light = {glm::vec4(position, radius), light_node.diffuse,
+                 light_node.specular,
+                 glm::vec4(axis * cone_scale, -cos_outer * cone_scale)};
+
+  // Smallest sphere around the cone capped by the light's range.
+  glm::vec4 sphere;
+  if (outer_angle > glm::radians(45.0f)) {
+    sphere = glm::vec4(position + axis * radius * cos_outer,
+                       radius * std::sin(outer_angle));
+  } else {
+    float sphere_radius = radius / (2.0f * cos_outer);
+    sphere = glm::vec4(position + axis * sphere_radius, sphere_radius);
+  }
+  if (!add_local_light_(sphere, light))
+    return;
+  // The light's rotation, without whatever scale it was placed with.
+  float base_radius = radius * std::tan(outer_angle);
+  glm::mat4 volume_model(
+      glm::vec4(glm::normalize(glm::vec3(model[0])) * base_radius, 0.0f),
+      glm::vec4(glm::normalize(glm::vec3(model[1])) * base_radius, 0.0f),
+      glm::vec4(glm::normalize(glm::vec3(model[2])) * radius, 0.0f),
+      glm::vec4(light_node.position, 1.0f));
+  light_volumes_.push_back(
+      {static_cast<uint32_t>(lights_.size() - 1), true, volume_model});
+}
+
+bool ClusteredLighting::add_local_light_(const glm::vec4& sphere,
+                                         const Light& light) {
+  float radius = sphere.w;
+  float nearest = -sphere.z - radius;
+  float farthest = -sphere.z + radius;
+  if (radius <= 0.0f || farthest < near_plane_ || nearest > far_plane_)
+    return false;
+
+  LightBounds bounds;
+  bounds.sphere = sphere;
+  bounds.first_slice = get_slice_(std::max(nearest, near_plane_));
+  bounds.last_slice = get_slice_(std::min(farthest, far_plane_));
+  bounds.first_tile_x = 0;
+  bounds.last_tile_x = tile_count_x_ - 1;
+  bounds.first_tile_y = 0;
+  bounds.last_tile_y = tile_count_y_ - 1;
+  // Spheres crossing the near plane may cover any tile.
+  if (nearest > near_plane_) {
+    glm::vec2 min(FLT_MAX);
+    glm::vec2 max(-FLT_MAX);
+    for (int corner = 0; corner < 8; ++corner) {
+      glm::vec4 point(sphere.x + ((corner & 1) ? radius : -radius),
+                      sphere.y + ((corner & 2) ? radius : -radius),
+                      sphere.z + ((corner & 4) ? radius : -radius), 1.0f);
+      glm::vec4 clip = projection_ * point;
+      glm::vec2 ndc(clip.x / clip.w, clip.y / clip.w);
+      min = glm::min(min, ndc);
+      max = glm::max(max, ndc);
+    }
+    if (min.x > 1.0f || min.y > 1.0f || max.x < -1.0f || max.y < -1.0f)
+      return false;
+    auto to_tile = [](float ndc, GLsizei size, int tile_count) {
+      int tile = static_cast<int>((ndc * 0.5f + 0.5f) * size / kTileSize);
+      return std::min(std::max(tile, 0), tile_count - 1);
+    };
+    bounds.first_tile_x = to_tile(min.x, viewport_size_.x, tile_count_x_);
+    bounds.last_tile_x = to_tile(max.x, viewport_size_.x, tile_count_x_);
+    bounds.first_tile_y = to_tile(min.y, viewport_size_.y, tile_count_y_);
+    bounds.last_tile_y = to_tile(max.y, viewport_size_.y, tile_count_y_);
+  }
+
+  if (lights_.size() > kMaxLights) {
+    static bool warned = false;
+    if (!warned) {
+      std::cerr << "More than " << kMaxLights
+                << " lights in view, ignoring the others" << std::endl;
+      warned = true;
+    }
+    return false;
+  }
+  bounds.light_index = static_cast<uint32_t>(lights_.size());
+  if (local_light_binning_)
+    light_bounds_.push_back(bounds);
+  lights_.push_back(light);
+  return true;
+}
+
+// Returns a 4-bit mask of the clusters in [cluster, cluster + 4) touched by
+// the sphere, using the squared distance from its center to each box.
+unsigned int ClusteredLighting::intersect_4_(std::size_t cluster,
+                                             const glm::vec4& sphere) const {
+#if defined(STURDY_DONKEY_SSE2)
+  const __m128 zero = _mm_setzero_ps();
+  __m128 distance = zero;
+  const std::vector<float>* mins[] = {&min_x_, &min_y_, &min_z_};
+  const std::vector<float>* maxs[] = {&max_x_, &max_y_, &max_z_};
+  for (int axis = 0; axis < 3; ++axis) {
+    __m128 center = _mm_set1_ps(sphere[axis]);
+    __m128 min = _mm_loadu_ps(mins[axis]->data() + cluster);
+    __m128 max = _mm_loadu_ps(maxs[axis]->data() + cluster);
+    __m128 delta = _mm_max_ps(
+        _mm_max_ps(_mm_sub_ps(min, center), _mm_sub_ps(center, max)), zero);
+    distance = _mm_add_ps(distance, _mm_mul_ps(delta, delta));
+  }
+  __m128 radius = _mm_set1_ps(sphere.w * sphere.w);
+  return static_cast<unsigned int>(
+      _mm_movemask_ps(_mm_cmple_ps(distance, radius)));
+#elif defined(STURDY_DONKEY_NEON)
+  const float32x4_t zero = vdupq_n_f32(0.0f);
+  float32x4_t distance = zero;
+  const std::vector<float>* mins[] = {&min_x_, &min_y_, &min_z_};
+  const std::vector<float>* maxs[] = {&max_x_, &max_y_, &max_z_};
+  for (int axis = 0; axis < 3; ++axis) {
+    float32x4_t center = vdupq_n_f32(sphere[axis]);
+    float32x4_t min = vld1q_f32(mins[axis]->data() + cluster);
+    float32x4_t max = vld1q_f32(maxs[axis]->data() + cluster);
+    float32x4_t delta = vmaxq_f32(
+        vmaxq_f32(vsubq_f32(min, center), vsubq_f32(center, max)), zero);
+    distance = vmlaq_f32(distance, delta, delta);
+  }
+  uint32x4_t hits =
+      vcleq_f32(distance, vdupq_n_f32(sphere.w * sphere.w));
+  return (vgetq_lane_u32(hits, 0) & 1) | (vgetq_lane_u32(hits, 1) & 2) |
+         (vgetq_lane_u32(hits, 2) & 4) | (vgetq_lane_u32(hits, 3) & 8);
+#else
+  unsigned int mask = 0;
+  for (std::size_t i = 0; i < 4; ++i) {
+    float distance = 0.0f;
+    float centers[] = {sphere.x, sphere.y, sphere.z};
+    float mins[] = {min_x_[cluster + i], min_y_[cluster + i],
+                    min_z_[cluster + i]};
+    float maxs[] = {max_x_[cluster + i], max_y_[cluster + i],
+                    max_z_[cluster + i]};
+    for (int axis = 0; axis < 3; ++axis) {
+      float delta = std::max(
+          std::max(mins[axis] - centers[axis], centers[axis] - maxs[axis]),
+          0.0f);
+      distance += delta * delta;
+    }
+    if (distance <= sphere.w * sphere.w)
+      mask |= 1u << i;
+  }
+  return mask;
+#endif
+}
+
+void ClusteredLighting::bin_(Bin& bin) {
+  std::size_t slice_size =
+      static_cast<std::size_t>(tile_count_x_) * tile_count_y_;
+  bin.hits.clear();
+  for (const LightBounds& bounds : light_bounds_) {
+    int first_slice = std::max(bounds.first_slice, bin.first_slice);
+    int last_slice = std::min(bounds.last_slice, bin.last_slice - 1);
+    for (int slice = first_slice; slice <= last_slice; ++slice) {
+      for (int y = bounds.first_tile_y; y <= bounds.last_tile_y; ++y) {
+        std::size_t row = slice * slice_size + y * tile_count_x_;
+        for (int x = bounds.first_tile_x; x <= bounds.last_tile_x; x += 4) {
+          unsigned int mask = intersect_4_(row + x, bounds.sphere);
+          // Ignore the lanes past the end of the light's tiles.
+          int lane_count = std::min(4, bounds.last_tile_x - x + 1);
+          mask &= (1u << lane_count) - 1;
+          for (int lane = 0; mask; ++lane, mask >>= 1) {
+            if (mask & 1) {
+              bin.hits.push_back({static_cast<uint32_t>(row + x + lane),
+                                  bounds.light_index});
+            }
+          }
+        }
+      }
+    }
+  }
+
+  // Counting sort of the hits by cluster. Lights stay in index order inside
+  // each cluster as they were tested in that order.
+  std::size_t first_cluster = bin.first_slice * slice_size;
+  std::size_t last_cluster = bin.last_slice * slice_size;
+  for (std::size_t cluster = first_cluster; cluster < last_cluster;
+       ++cluster) {
+    clusters_[cluster * 2] = 0;
+    clusters_[cluster * 2 + 1] = 0;
+  }
+  for (const Hit& hit : bin.hits)
+    ++clusters_[hit.cluster * 2 + 1];
+  uint32_t offset = 0;
+  for (std::size_t cluster = first_cluster; cluster < last_cluster;
+       ++cluster) {
+    clusters_[cluster * 2] = offset;
+    offset += clusters_[cluster * 2 + 1];
+  }
+  bin.light_indices.resize(bin.hits.size());
+  for (const Hit& hit : bin.hits) {
+    bin.light_indices[clusters_[hit.cluster * 2]++] =
+        static_cast<uint16_t>(hit.light_index);
+  }
+  // Offsets were moved to the end of each cluster's list, move them back.
+  for (std::size_t cluster = first_cluster; cluster < last_cluster;
+       ++cluster) {
+    clusters_[cluster * 2] -= clusters_[cluster * 2 + 1];
+  }
+}
+
+void ClusteredLighting::bin_all_(std::size_t bin_count) {
+  for (std::size_t i = 0; i < bin_count; ++i) {
+    bins_[i].first_slice = static_cast<int>(i * kSliceCount / bin_count);
+    bins_[i].last_slice = static_cast<int>((i + 1) * kSliceCount / bin_count);
+  }
+  if (bin_count == 1) {
+    bin_(bins_[0]);
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_workers_ = bin_count - 1;
+    ++generation_;
+  }
+  work_condition_.notify_all();
+  bin_(bins_[0]);
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_condition_.wait(lock, [this] { return pending_workers_ == 0; });
+}
+
+void ClusteredLighting::work_(std::size_t worker) {
+  uint64_t generation = 0;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      work_condition_.wait(
+          lock, [&] { return quit_ || generation_ != generation; });
+      if (quit_)
+        return;
+      generation = generation_;
+    }
+    bin_(bins_[worker]);
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      --pending_workers_;
+    }
+    done_condition_.notify_one();
+  }
+}
+
+void ClusteredLighting::render(
+    const CameraNode& camera_node,
+    const StackVector<DirectionalLightNode>& directional_light_nodes,
+    const StackVector<PointLightNode>& point_light_nodes,
+    const StackVector<SpotLightNode>& spot_light_nodes,
+    CommandBucket& render_commands) {
+  update_clusters_(camera_node);
+  lights_.clear();
+  light_volumes_.clear();
+  light_bounds_.clear();
+  for (const DirectionalLightNode& light_node : directional_light_nodes)
+    add_directional_light_(camera_node.view, light_node);
+  int directional_light_count = static_cast<int>(lights_.size());
+  for (const PointLightNode& light_node : point_light_nodes)
+    add_point_light_(camera_node.view, light_node);
+  for (const SpotLightNode& light_node : spot_light_nodes)
+    add_spot_light_(camera_node.view, light_node);
+
+  std::size_t bin_count = 1;
+  if (light_bounds_.size() >= kParallelLightCount)
+    bin_count = bins_.size();
+  bin_all_(bin_count);
+
+  // Concatenate the bins, each one's offsets are relative to its own list.
+  std::size_t slice_size =
+      static_cast<std::size_t>(tile_count_x_) * tile_count_y_;
+  light_indices_.clear();
+  for (std::size_t i = 0; i < bin_count; ++i) {
+    const Bin& bin = bins_[i];
+    uint32_t base = static_cast<uint32_t>(light_indices_.size());
+    if (base > 0) {
+      for (std::size_t cluster = bin.first_slice * slice_size;
+           cluster < bin.last_slice * slice_size; ++cluster) {
+        clusters_[cluster * 2] += base;
+      }
+    }
+    light_indices_.insert(light_indices_.end(), bin.light_indices.begin(),
+                          bin.light_indices.end());
+  }
+
+  render_commands.update_texture_buffer(
+      light_buffer_id_, lights_.data(), lights_.size() * sizeof(Light));
+  render_commands.update_texture_buffer(
+      cluster_buffer_id_, clusters_.data(),
+      clusters_.size() * sizeof(uint32_t));
+  render_commands.update_texture_buffer(
+      light_index_buffer_id_, light_indices_.data(),
+      light_indices_.size() * sizeof(uint16_t));
+
+  light_block_.cluster_grid =
+      glm::ivec4(tile_count_x_, tile_count_y_, kSliceCount, kTileSize);
+  light_block_.cluster_depth =
+      glm::vec4(slice_scale_, slice_bias_, 0.0f, 0.0f);
+  light_block_.light_counts = glm::ivec4(
+      directional_light_count, static_cast<int>(lights_.size()), -1, 0);
+  render_commands.bind_uniform_block(UniformBlockBinding::kLight,
+                                     &light_block_, sizeof(light_block_));
+}
+
+const std::vector<ClusteredLighting::LightVolume>&
+ClusteredLighting::get_light_volumes() const {
+  return light_volumes_;
+}
+
+void ClusteredLighting::bind_light_volume_block(
+    const LightVolume& light_volume,
+    CommandBucket& render_commands) const {
+  LightBlock block = light_block_;
+  block.light_counts.z = static_cast<int>(light_volume.light_index);
+  render_commands.bind_uniform_block(UniformBlockBinding::kLight, &block,
+                                     sizeof(block));
+}
+
+}  // namespace render
+}  // namespace donkey
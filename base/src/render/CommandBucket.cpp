@@ -17,6 +17,10 @@
 
 #include "render/CommandBucket.hpp"
 
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
 namespace donkey {
 
 namespace render {
@@ -91,8 +95,9 @@ SetDepthTestCommand::SetDepthTestCommand(bool enable)
 SetBlendingCommand::SetBlendingCommand(bool enable)
     : Command(Type::kSetBlending), enable(enable) {}
 
-ClearFramebufferCommand::ClearFramebufferCommand(const glm::vec3& color)
-    : Command(Type::kClearFramebuffer), color(color) {}
+ClearFramebufferCommand::ClearFramebufferCommand(const glm::vec3& color,
+                                                 int buffers)
+    : Command(Type::kClearFramebuffer), color(color), buffers(buffers) {}
 
 BindGpuProgramCommand::BindGpuProgramCommand(uint32_t program_id)
     : Command(Type::kBindGpuProgram), program_id(program_id) {}
@@ -100,6 +105,44 @@ BindGpuProgramCommand::BindGpuProgramCommand(uint32_t program_id)
 SetStateCommand::SetStateCommand(uint32_t state_id)
     : Command(Type::kSetState), state_id(state_id) {}
 
+BindUniformBlockCommand::BindUniformBlockCommand(unsigned int binding,
+                                                 std::size_t offset,
+                                                 std::size_t size)
+    : Command(Type::kBindUniformBlock),
+      binding(binding),
+      offset(offset),
+      size(size) {}
+
+BindMaterialParametersCommand::BindMaterialParametersCommand(
+    uint32_t material_id)
+    : Command(Type::kBindMaterialParameters), material_id(material_id) {}
+
+UpdateTextureBufferCommand::UpdateTextureBufferCommand(
+    uint32_t texture_id,
+    std::size_t offset,
+    std::size_t size,
+    std::size_t buffer_offset)
+    : Command(Type::kUpdateTextureBuffer),
+      texture_id(texture_id),
+      offset(offset),
+      size(size),
+      buffer_offset(buffer_offset) {}
+
+CountSamplesCommand::CountSamplesCommand(bool begin)
+    : Command(Type::kCountSamples), begin(begin) {}
+
+MultiDrawElementsCommand::MultiDrawElementsCommand(
+    uint32_t draw_buffer_id,
+    std::size_t offset,
+    std::vector<DrawElementsIndirect>&& draws)
+    : Command(Type::kMultiDrawElements),
+      draw_buffer_id(draw_buffer_id),
+      offset(offset),
+      draws(std::move(draws)) {}
+
+CommandBucket::CommandBucket(const UniformStorage& uniform_storage)
+    : uniform_storage_(uniform_storage), uniform_storage_size_(0) {}
+
 void CommandBucket::bind_mesh(uint32_t mesh_id,
                               unsigned int position_location,
                               unsigned int normal_location,
@@ -121,6 +164,18 @@ const std::list<SortedCommand>& CommandBucket::get_commands() const {
   return sorted_commands_;
 }
 
+const UniformStorage& CommandBucket::get_uniform_storage() const {
+  return uniform_storage_;
+}
+
+std::size_t CommandBucket::get_uniform_storage_size() const {
+  return uniform_storage_size_;
+}
+
+const std::vector<uint8_t>& CommandBucket::get_uniform_overflow() const {
+  return uniform_overflow_;
+}
+
 void CommandBucket::bind_uniform(int location, float uniform) {
   bind_float_commands_.push_back(BindUniformFloatCommand(location, uniform));
   sorted_commands_.push_back({make_sort_key_(Command::Type::kBindUniformFloat),
@@ -154,13 +209,13 @@ void CommandBucket::bind_uniform(int location, const glm::vec4& uniform) {
 void CommandBucket::bind_uniform(int location, const glm::mat2& uniform) {
   bind_mat2_commands_.push_back(BindUniformMat2Command(location, uniform));
   sorted_commands_.push_back({make_sort_key_(Command::Type::kBindUniformMat2),
-                              bind_mat4_commands_.back()});
+                              bind_mat2_commands_.back()});
 }
 
 void CommandBucket::bind_uniform(int location, const glm::mat3& uniform) {
   bind_mat3_commands_.push_back(BindUniformMat3Command(location, uniform));
   sorted_commands_.push_back({make_sort_key_(Command::Type::kBindUniformMat3),
-                              bind_mat4_commands_.back()});
+                              bind_mat3_commands_.back()});
 }
 
 void CommandBucket::bind_uniform(int location, const glm::mat4& uniform) {
@@ -207,8 +262,11 @@ void CommandBucket::set_viewport(const glm::tvec2<int>& position,
                               set_viewport_commands_.back()});
 }
 
-void CommandBucket::clear_framebuffer(const glm::vec3& color) {
-  clear_framebuffer_commands_.push_back(ClearFramebufferCommand(color));
+void CommandBucket::clear_framebuffer(const glm::vec3& color, int buffers) {
+  if (buffers == 0)
+    return;
+  clear_framebuffer_commands_.push_back(
+      ClearFramebufferCommand(color, buffers));
   sorted_commands_.push_back({make_sort_key_(Command::Type::kClearFramebuffer),
                               clear_framebuffer_commands_.back()});
 }
@@ -225,5 +283,83 @@ void CommandBucket::set_state(uint32_t state_id) {
       {make_sort_key_(Command::Type::kSetState), set_state_commands_.back()});
 }
 
+std::size_t CommandBucket::store_(const void* data, std::size_t size) {
+  std::size_t alignment = uniform_storage_.alignment;
+  std::size_t offset =
+      (uniform_storage_size_ + alignment - 1) / alignment * alignment;
+  if (offset + size <= uniform_storage_.capacity) {
+    std::memcpy(uniform_storage_.data + offset, data, size);
+  } else {
+    // Blocks don't straddle the end of the storage, the overflow starts
+    // right at its capacity, which drivers keep aligned.
+    offset = std::max(offset, uniform_storage_.capacity);
+    std::size_t overflow_offset = offset - uniform_storage_.capacity;
+    uniform_overflow_.resize(overflow_offset + size);
+    std::memcpy(uniform_overflow_.data() + overflow_offset, data, size);
+  }
+  uniform_storage_size_ = offset + size;
+  return offset;
+}
+
+void CommandBucket::bind_uniform_block(UniformBlockBinding binding,
+                                       const void* block,
+                                       std::size_t size) {
+  std::size_t offset = store_(block, size);
+  bind_uniform_block_commands_.push_back(BindUniformBlockCommand(
+      static_cast<unsigned int>(binding), offset, size));
+  sorted_commands_.push_back({make_sort_key_(Command::Type::kBindUniformBlock),
+                              bind_uniform_block_commands_.back()});
+}
+
+void CommandBucket::bind_material_parameters(uint32_t material_id) {
+  bind_material_parameters_commands_.push_back(
+      BindMaterialParametersCommand(material_id));
+  sorted_commands_.push_back(
+      {make_sort_key_(Command::Type::kBindMaterialParameters),
+       bind_material_parameters_commands_.back()});
+}
+
+void CommandBucket::update_texture_buffer(uint32_t texture_id,
+                                          const void* data,
+                                          std::size_t size,
+                                          std::size_t buffer_offset) {
+  if (size == 0)
+    return;
+  std::size_t offset = store_(data, size);
+  update_texture_buffer_commands_.push_back(
+      UpdateTextureBufferCommand(texture_id, offset, size, buffer_offset));
+  sorted_commands_.push_back(
+      {make_sort_key_(Command::Type::kUpdateTextureBuffer),
+       update_texture_buffer_commands_.back()});
+}
+
+void CommandBucket::begin_sample_count() {
+  count_samples_commands_.push_back(CountSamplesCommand(true));
+  sorted_commands_.push_back({make_sort_key_(Command::Type::kCountSamples),
+                              count_samples_commands_.back()});
+}
+
+void CommandBucket::end_sample_count() {
+  count_samples_commands_.push_back(CountSamplesCommand(false));
+  sorted_commands_.push_back({make_sort_key_(Command::Type::kCountSamples),
+                              count_samples_commands_.back()});
+}
+
+void CommandBucket::multi_draw_elements(
+    uint32_t draw_buffer_id,
+    std::vector<DrawElementsIndirect>&& draws) {
+  if (draws.empty())
+    return;
+  // The GPU reads the draws from the frame's uniform storage, the driver
+  // keeps a copy for when it has to issue them one by one.
+  std::size_t offset =
+      store_(draws.data(), draws.size() * sizeof(DrawElementsIndirect));
+  multi_draw_elements_commands_.push_back(
+      MultiDrawElementsCommand(draw_buffer_id, offset, std::move(draws)));
+  sorted_commands_.push_back(
+      {make_sort_key_(Command::Type::kMultiDrawElements),
+       multi_draw_elements_commands_.back()});
+}
+
 }  // namespace render
 }  // namespace donkey
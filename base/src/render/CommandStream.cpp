@@ -0,0 +1,425 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "render/CommandStream.hpp"
+
+#include <iostream>
+#include <utility>
+#include <vector>
+
+#include "render/binary_io.hpp"
+
+namespace donkey {
+namespace render {
+
+namespace {
+
+// Reads a block of the saved uniforms, checking that it's in range.
+bool read_range(std::istream& in,
+                std::size_t uniform_size,
+                uint64_t& offset,
+                uint64_t& size) {
+  return binary_io::read(in, offset) && binary_io::read(in, size) &&
+         offset <= uniform_size && size <= uniform_size - offset;
+}
+
+template <typename T>
+void write_uniform(std::ostream& out, const Command& command) {
+  const auto& bind = static_cast<const T&>(command);
+  binary_io::write(out, static_cast<int32_t>(bind.location));
+  binary_io::write(out, bind.uniform);
+}
+
+template <typename T, typename Function>
+bool read_uniform(std::istream& in, Function& f) {
+  int32_t location;
+  T uniform;
+  if (!binary_io::read(in, location) || !binary_io::read(in, uniform))
+    return false;
+  f = [location, uniform](CommandBucket& commands, const uint8_t*) {
+    commands.bind_uniform(location, uniform);
+  };
+  return true;
+}
+
+}  // namespace
+
+void CommandStream::write(std::ostream& out, const CommandBucket& commands) {
+  // Written as one block, overflow included, the replay stores it again.
+  uint64_t uniform_size = commands.get_uniform_storage_size();
+  const std::vector<uint8_t>& overflow = commands.get_uniform_overflow();
+  binary_io::write(out, uniform_size);
+  binary_io::write_bytes(out, commands.get_uniform_storage().data,
+                         uniform_size - overflow.size());
+  binary_io::write_bytes(out, overflow.data(), overflow.size());
+  binary_io::write(out,
+                   static_cast<uint32_t>(commands.get_commands().size()));
+  for (const SortedCommand& sorted_command : commands.get_commands()) {
+    const Command& command = sorted_command.command;
+    binary_io::write(out, static_cast<uint8_t>(command.type));
+    switch (command.type) {
+      case Command::Type::kBindMesh: {
+        const auto& bind = static_cast<const BindMeshCommand&>(command);
+        binary_io::write(out, bind.mesh_id);
+        binary_io::write(out, static_cast<uint32_t>(bind.position_location));
+        binary_io::write(out, static_cast<uint32_t>(bind.normal_location));
+        binary_io::write(out, static_cast<uint32_t>(bind.uv_location));
+        binary_io::write(out, static_cast<uint32_t>(bind.tangent_location));
+        binary_io::write(out,
+                         static_cast<uint32_t>(bind.bitangent_location));
+        break;
+      }
+      case Command::Type::kDrawElements:
+        binary_io::write(out, static_cast<uint64_t>(
+            static_cast<const DrawElementsCommand&>(command).count));
+        break;
+      case Command::Type::kBindUniformFloat:
+        write_uniform<BindUniformFloatCommand>(out, command);
+        break;
+      case Command::Type::kBindUniformInt:
+        write_uniform<BindUniformIntCommand>(out, command);
+        break;
+      case Command::Type::kBindUniformVec2:
+        write_uniform<BindUniformVec2Command>(out, command);
+        break;
+      case Command::Type::kBindUniformVec3:
+        write_uniform<BindUniformVec3Command>(out, command);
+        break;
+      case Command::Type::kBindUniformVec4:
+        write_uniform<BindUniformVec4Command>(out, command);
+        break;
+      case Command::Type::kBindUniformMat2:
+        write_uniform<BindUniformMat2Command>(out, command);
+        break;
+      case Command::Type::kBindUniformMat3:
+        write_uniform<BindUniformMat3Command>(out, command);
+        break;
+      case Command::Type::kBindUniformMat4:
+        write_uniform<BindUniformMat4Command>(out, command);
+        break;
+      case Command::Type::kBindTexture: {
+        const auto& bind = static_cast<const BindTextureCommand&>(command);
+        binary_io::write(out, static_cast<int32_t>(bind.location));
+        binary_io::write(out, static_cast<uint32_t>(bind.texture_unit));
+        binary_io::write(out, bind.texture_id);
+        break;
+      }
+      case Command::Type::kBindFramebuffer:
+        binary_io::write(
+            out,
+            static_cast<const BindFramebufferCommand&>(command).framebuffer_id);
+        break;
+      case Command::Type::kSetViewport: {
+        const auto& set = static_cast<const SetViewportCommand&>(command);
+        binary_io::write(out, static_cast<int32_t>(set.position.x));
+        binary_io::write(out, static_cast<int32_t>(set.position.y));
+        binary_io::write(out, static_cast<uint64_t>(set.size.x));
+        binary_io::write(out, static_cast<uint64_t>(set.size.y));
+        break;
+      }
+      case Command::Type::kSetDepthTest:
+        binary_io::write(out, static_cast<uint8_t>(
+            static_cast<const SetDepthTestCommand&>(command).enable));
+        break;
+      case Command::Type::kClearFramebuffer: {
+        const auto& clear =
+            static_cast<const ClearFramebufferCommand&>(command);
+        binary_io::write(out, clear.color);
+        binary_io::write(out, static_cast<int32_t>(clear.buffers));
+        break;
+      }
+      case Command::Type::kBindGpuProgram:
+        binary_io::write(
+            out, static_cast<const BindGpuProgramCommand&>(command).program_id);
+        break;
+      case Command::Type::kSetBlending:
+        binary_io::write(out, static_cast<uint8_t>(
+            static_cast<const SetBlendingCommand&>(command).enable));
+        break;
+      case Command::Type::kSetState:
+        binary_io::write(
+            out, static_cast<const SetStateCommand&>(command).state_id);
+        break;
+      case Command::Type::kBindUniformBlock: {
+        const auto& bind =
+            static_cast<const BindUniformBlockCommand&>(command);
+        binary_io::write(out, static_cast<uint32_t>(bind.binding));
+        binary_io::write(out, static_cast<uint64_t>(bind.offset));
+        binary_io::write(out, static_cast<uint64_t>(bind.size));
+        break;
+      }
+      case Command::Type::kBindMaterialParameters:
+        binary_io::write(
+            out, static_cast<const BindMaterialParametersCommand&>(command)
+                     .material_id);
+        break;
+      case Command::Type::kUpdateTextureBuffer: {
+        const auto& update =
+            static_cast<const UpdateTextureBufferCommand&>(command);
+        binary_io::write(out, update.texture_id);
+        binary_io::write(out, static_cast<uint64_t>(update.offset));
+        binary_io::write(out, static_cast<uint64_t>(update.size));
+        binary_io::write(out, static_cast<uint64_t>(update.buffer_offset));
+        break;
+      }
+      case Command::Type::kCountSamples:
+        binary_io::write(out, static_cast<uint8_t>(
+            static_cast<const CountSamplesCommand&>(command).begin));
+        break;
+      case Command::Type::kMultiDrawElements: {
+        const auto& draw =
+            static_cast<const MultiDrawElementsCommand&>(command);
+        binary_io::write(out, draw.draw_buffer_id);
+        binary_io::write(out, static_cast<uint32_t>(draw.draws.size()));
+        binary_io::write_bytes(
+            out, draw.draws.data(),
+            draw.draws.size() * sizeof(DrawElementsIndirect));
+        break;
+      }
+    }
+  }
+}
+
+bool CommandStream::read(std::istream& in) {
+  commands_.clear();
+  uniforms_.clear();
+  uint64_t uniform_size;
+  if (!binary_io::read(in, uniform_size) ||
+      !binary_io::has_bytes(in, uniform_size))
+    return false;
+  uniforms_.resize(static_cast<std::size_t>(uniform_size));
+  uint32_t command_count;
+  if (!binary_io::read_bytes(in, uniforms_.data(), uniforms_.size()) ||
+      !binary_io::read(in, command_count))
+    return false;
+
+  commands_.reserve(command_count);
+  for (uint32_t i = 0; i < command_count; ++i) {
+    uint8_t type;
+    if (!binary_io::read(in, type))
+      return false;
+    RecordFunction f;
+    bool ok = false;
+    switch (static_cast<Command::Type>(type)) {
+      case Command::Type::kBindMesh: {
+        uint32_t mesh_id;
+        uint32_t locations[5];
+        ok = binary_io::read(in, mesh_id) && binary_io::read(in, locations);
+        f = [mesh_id, locations](CommandBucket& commands, const uint8_t*) {
+          commands.bind_mesh(mesh_id, locations[0], locations[1],
+                             locations[2], locations[3], locations[4]);
+        };
+        break;
+      }
+      case Command::Type::kDrawElements: {
+        uint64_t count;
+        ok = binary_io::read(in, count);
+        f = [count](CommandBucket& commands, const uint8_t*) {
+          commands.draw_elements(static_cast<std::size_t>(count));
+        };
+        break;
+      }
+      case Command::Type::kBindUniformFloat:
+        ok = read_uniform<float>(in, f);
+        break;
+      case Command::Type::kBindUniformInt:
+        ok = read_uniform<int32_t>(in, f);
+        break;
+      case Command::Type::kBindUniformVec2:
+        ok = read_uniform<glm::vec2>(in, f);
+        break;
+      case Command::Type::kBindUniformVec3:
+        ok = read_uniform<glm::vec3>(in, f);
+        break;
+      case Command::Type::kBindUniformVec4:
+        ok = read_uniform<glm::vec4>(in, f);
+        break;
+      case Command::Type::kBindUniformMat2:
+        ok = read_uniform<glm::mat2>(in, f);
+        break;
+      case Command::Type::kBindUniformMat3:
+        ok = read_uniform<glm::mat3>(in, f);
+        break;
+      case Command::Type::kBindUniformMat4:
+        ok = read_uniform<glm::mat4>(in, f);
+        break;
+      case Command::Type::kBindTexture: {
+        int32_t location;
+        uint32_t texture_unit;
+        uint32_t texture_id;
+        ok = binary_io::read(in, location) &&
+             binary_io::read(in, texture_unit) &&
+             binary_io::read(in, texture_id);
+        f = [location, texture_unit, texture_id](CommandBucket& commands,
+                                                 const uint8_t*) {
+          commands.bind_texture(location, texture_unit, texture_id);
+        };
+        break;
+      }
+      case Command::Type::kBindFramebuffer: {
+        uint32_t framebuffer_id;
+        ok = binary_io::read(in, framebuffer_id);
+        f = [framebuffer_id](CommandBucket& commands, const uint8_t*) {
+          commands.bind_framebuffer(framebuffer_id);
+        };
+        break;
+      }
+      case Command::Type::kSetViewport: {
+        int32_t position[2];
+        uint64_t size[2];
+        ok = binary_io::read(in, position) && binary_io::read(in, size);
+        f = [position, size](CommandBucket& commands, const uint8_t*) {
+          commands.set_viewport(
+              glm::tvec2<int>(position[0], position[1]),
+              glm::tvec2<std::size_t>(static_cast<std::size_t>(size[0]),
+                                      static_cast<std::size_t>(size[1])));
+        };
+        break;
+      }
+      case Command::Type::kSetDepthTest: {
+        uint8_t enable;
+        ok = binary_io::read(in, enable);
+        f = [enable](CommandBucket& commands, const uint8_t*) {
+          commands.set_depth_test(enable != 0);
+        };
+        break;
+      }
+      case Command::Type::kClearFramebuffer: {
+        glm::vec3 color;
+        int32_t buffers;
+        ok = binary_io::read(in, color) && binary_io::read(in, buffers);
+        f = [color, buffers](CommandBucket& commands, const uint8_t*) {
+          commands.clear_framebuffer(color, buffers);
+        };
+        break;
+      }
+      case Command::Type::kBindGpuProgram: {
+        uint32_t program_id;
+        ok = binary_io::read(in, program_id);
+        f = [program_id](CommandBucket& commands, const uint8_t*) {
+          commands.bind_gpu_program(program_id);
+        };
+        break;
+      }
+      case Command::Type::kSetBlending: {
+        uint8_t enable;
+        ok = binary_io::read(in, enable);
+        f = [enable](CommandBucket& commands, const uint8_t*) {
+          commands.set_blending(enable != 0);
+        };
+        break;
+      }
+      case Command::Type::kSetState: {
+        uint32_t state_id;
+        ok = binary_io::read(in, state_id);
+        f = [state_id](CommandBucket& commands, const uint8_t*) {
+          commands.set_state(state_id);
+        };
+        break;
+      }
+      case Command::Type::kBindUniformBlock: {
+        uint32_t binding;
+        uint64_t offset;
+        uint64_t size;
+        ok = binary_io::read(in, binding) &&
+             read_range(in, uniforms_.size(), offset, size);
+        f = [binding, offset, size](CommandBucket& commands,
+                                    const uint8_t* uniforms) {
+          commands.bind_uniform_block(
+              static_cast<UniformBlockBinding>(binding), uniforms + offset,
+              static_cast<std::size_t>(size));
+        };
+        break;
+      }
+      case Command::Type::kBindMaterialParameters: {
+        uint32_t material_id;
+        ok = binary_io::read(in, material_id);
+        f = [material_id](CommandBucket& commands, const uint8_t*) {
+          commands.bind_material_parameters(material_id);
+        };
+        break;
+      }
+      case Command::Type::kUpdateTextureBuffer: {
+        uint32_t texture_id;
+        uint64_t offset;
+        uint64_t size;
+        uint64_t buffer_offset;
+        ok = binary_io::read(in, texture_id) &&
+             read_range(in, uniforms_.size(), offset, size) &&
+             binary_io::read(in, buffer_offset);
+        f = [texture_id, offset, size, buffer_offset](
+                CommandBucket& commands, const uint8_t* uniforms) {
+          commands.update_texture_buffer(
+              texture_id, uniforms + offset, static_cast<std::size_t>(size),
+              static_cast<std::size_t>(buffer_offset));
+        };
+        break;
+      }
+      case Command::Type::kCountSamples: {
+        uint8_t begin;
+        ok = binary_io::read(in, begin);
+        f = [begin](CommandBucket& commands, const uint8_t*) {
+          if (begin)
+            commands.begin_sample_count();
+          else
+            commands.end_sample_count();
+        };
+        break;
+      }
+      case Command::Type::kMultiDrawElements: {
+        uint32_t draw_buffer_id;
+        uint32_t draw_count;
+        ok = binary_io::read(in, draw_buffer_id) &&
+             binary_io::read(in, draw_count) &&
+             binary_io::has_bytes(
+                 in, static_cast<uint64_t>(draw_count) *
+                         sizeof(DrawElementsIndirect));
+        if (!ok)
+          break;
+        std::vector<DrawElementsIndirect> draws(draw_count);
+        ok = binary_io::read_bytes(
+            in, draws.data(), draws.size() * sizeof(DrawElementsIndirect));
+        f = [draw_buffer_id, draws](CommandBucket& commands,
+                                    const uint8_t*) {
+          std::vector<DrawElementsIndirect> copy(draws);
+          commands.multi_draw_elements(draw_buffer_id, std::move(copy));
+        };
+        break;
+      }
+      default:
+        std::cerr << "Unknown command type " << static_cast<int>(type)
+                  << " in command stream.\n";
+        break;
+    }
+    if (!ok)
+      return false;
+    commands_.push_back(std::move(f));
+  }
+  return true;
+}
+
+void CommandStream::record(CommandBucket& commands) const {
+  for (const RecordFunction& f : commands_)
+    f(commands, uniforms_.data());
+}
+
+std::size_t CommandStream::get_command_count() const {
+  return commands_.size();
+}
+
+}  // namespace render
+}  // namespace donkey
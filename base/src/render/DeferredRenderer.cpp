@@ -17,7 +17,9 @@
 
 #include "render/DeferredRenderer.hpp"
 
+#include <algorithm>
 #include <array>
+#include <cmath>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/mat4x4.hpp>
 #include <glm/vec3.hpp>
@@ -34,46 +36,159 @@ namespace donkey {
 namespace render {
 
 DeferredRenderer::DeferredRenderer(Window* window,
-                                   gl::Driver* driver,
-                                   ResourceManager* resource_manager)
-    : window_(window),
+                                   GpuDriver* driver,
+                                   ResourceManager* resource_manager,
+                                   LightingMode lighting_mode,
+                                   GBufferLayout gbuffer_layout,
+                                   bool depth_prepass,
+                                   ShadowCascades::Quality shadow_quality,
+                                   float max_resolution_scale)
+    : DeferredRenderer(window->get_width(),
+                       window->get_height(),
+                       driver,
+                       resource_manager,
+                       lighting_mode,
+                       gbuffer_layout,
+                       depth_prepass,
+                       shadow_quality,
+                       max_resolution_scale) {}
+
+DeferredRenderer::DeferredRenderer(int width,
+                                   int height,
+                                   GpuDriver* driver,
+                                   ResourceManager* resource_manager,
+                                   LightingMode lighting_mode,
+                                   GBufferLayout gbuffer_layout,
+                                   bool depth_prepass,
+                                   ShadowCascades::Quality shadow_quality,
+                                   float max_resolution_scale)
+    : width_(width),
+      height_(height),
       driver_(driver),
       gpu_resource_manager_(driver_->get_resource_manager()),
       resource_manager_(resource_manager),
-      pipeline_(window, driver, resource_manager),
+      pipeline_(driver, resource_manager),
       pipeline_generator_(*resource_manager_,
                           gpu_resource_manager_,
                           pipeline_,
-                          window->get_width(),
-                          window->get_height()) {
-  int width = window->get_width();
-  int height = window->get_height();
+                          width,
+                          height),
+      max_resolution_scale_(max_resolution_scale),
+      resolution_scaler_(ResolutionScaler::make_default_settings()),
+      dynamic_resolution_enabled_(false),
+      last_frame_start_() {
+  ResolutionScaler::Settings scaler_settings =
+      resolution_scaler_.get_settings();
+  scaler_settings.max_scale = max_resolution_scale;
+  scaler_settings.min_scale =
+      std::min(scaler_settings.min_scale, max_resolution_scale);
+  resolution_scaler_.set_settings(scaler_settings);
+  resolution_scaler_.reset(1.0f);
+  // The window's size is what full-screen passes cover, the views are drawn
+  // into a part of the render targets.
+  width = static_cast<int>(std::ceil(width * max_resolution_scale));
+  height = static_cast<int>(std::ceil(height * max_resolution_scale));
 
   pipeline_generator_.register_texture(
       "albedo_texture", width, height, pixel::Format::kRGBA,
       pixel::InternalFormat::kRGBA8, pixel::ComponentType::kUnsignedByte);
+  if (gbuffer_layout == GBufferLayout::kWide) {
+    pipeline_generator_.register_texture(
+        "normals_texture", width, height, pixel::Format::kRGBA,
+        pixel::InternalFormat::kRGBA16F, pixel::ComponentType::kFloat);
+  } else if (gbuffer_layout == GBufferLayout::kCompact) {
+    pipeline_generator_.register_texture(
+        "normals_texture", width, height, pixel::Format::kRG,
+        pixel::InternalFormat::kRG16, pixel::ComponentType::kUnsignedByte);
+  } else {
+    pipeline_generator_.register_texture(
+        "normals_texture", width, height, pixel::Format::kRGBA,
+        pixel::InternalFormat::kRGB10A2, pixel::ComponentType::kUnsignedByte);
+  }
+  pipeline_.set_gbuffer_layout(static_cast<int>(gbuffer_layout));
   pipeline_generator_.register_texture(
-      "normals_texture", width, height, pixel::Format::kRGBA,
-      pixel::InternalFormat::kRGBA8, pixel::ComponentType::kFloat);
-  pipeline_generator_.register_texture(
-      "depth_texture", width, height, pixel::Format::kDepthComponent,
-      pixel::InternalFormat::kDepthComponent24, pixel::ComponentType::kFloat);
-  pipeline_generator_.register_texture(
-      "light_texture", width, height, pixel::Format::kRGBA,
-      pixel::InternalFormat::kRGBA8, pixel::ComponentType::kUnsignedByte);
+      "depth_texture", width, height, pixel::Format::kDepthStencil,
+      pixel::InternalFormat::kDepth24Stencil8,
+      pixel::ComponentType::kUnsignedInt248);
+  // the compact layouts' R11G11B10F target keeps sums of lights going over 1
+  // until they meet the albedo, kWide's RGBA8 one clamps them
+  if (gbuffer_layout == GBufferLayout::kWide) {
+    pipeline_generator_.register_texture(
+        "light_texture", width, height, pixel::Format::kRGBA,
+        pixel::InternalFormat::kRGBA8, pixel::ComponentType::kUnsignedByte);
+  } else {
+    pipeline_generator_.register_texture(
+        "light_texture", width, height, pixel::Format::kRGB,
+        pixel::InternalFormat::kR11G11B10F, pixel::ComponentType::kFloat);
+  }
   pipeline_generator_.register_texture(
       "light_plus_albedo_texture", width, height, pixel::Format::kRGBA,
       pixel::InternalFormat::kRGBA8, pixel::ComponentType::kUnsignedByte);
+  // lights binned in screen space clusters, see ClusteredLighting
+  pipeline_generator_.register_texture_buffer("light_buffer",
+                                              pixel::BufferFormat::kRGBA32F);
+  pipeline_generator_.register_texture_buffer("cluster_buffer",
+                                              pixel::BufferFormat::kRG32UI);
+  pipeline_generator_.register_texture_buffer("light_index_buffer",
+                                              pixel::BufferFormat::kR16UI);
+  pipeline_.set_light_buffers(
+      pipeline_generator_.get_texture_buffer_id("light_buffer"),
+      pipeline_generator_.get_texture_buffer_id("cluster_buffer"),
+      pipeline_generator_.get_texture_buffer_id("light_index_buffer"));
+
+  // shadow cascades side by side, kept from a frame to the next as they're
+  // only drawn again when something moves. The light pass reads a 1x1 atlas
+  // without shadows.
+  ShadowCascades::Settings shadow_settings =
+      ShadowCascades::make_settings(shadow_quality);
+  int shadow_width =
+      std::max(shadow_settings.resolution * shadow_settings.cascade_count, 1);
+  int shadow_height = std::max(shadow_settings.resolution, 1);
+  for (const char* name : {"shadow_texture", "static_shadow_texture"}) {
+    pipeline_generator_.register_texture(
+        name, shadow_width, shadow_height, pixel::Format::kDepthComponent,
+        pixel::InternalFormat::kDepthComponent24,
+        pixel::ComponentType::kFloat, true);
+  }
+  pipeline_generator_.register_shadow_pass(
+      "shadow_texture", "static_shadow_texture",
+      "shaders/position-only.vert.glsl", "shaders/depth-only.frag.glsl",
+      "shaders/shadow-copy.vert.glsl", "shaders/shadow-copy.frag.glsl",
+      shadow_settings);
 
+  // depth pre-pass, the gbuffer pass then only shades visible fragments
+  GLint depth_clear_bits = GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT;
+  if (depth_prepass) {
+    pipeline_generator_.register_depth_prepass(
+        {"depth_texture"}, depth_clear_bits, "shaders/position-only.vert.glsl",
+        "shaders/depth-only.frag.glsl");
+    depth_clear_bits = 0;
+  }
   // gbuffer pass
   pipeline_generator_.register_pass(
       {"albedo_texture", "normals_texture", "depth_texture"},
-      GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT, true, false, false);
-  // light accumulation pass
+      depth_clear_bits | GL_COLOR_BUFFER_BIT, true, false, false);
+  // light pass, shades every light in a single full-screen pass
   pipeline_generator_.register_pass(
-      {"albedo_texture", "normals_texture", "depth_texture"}, {"light_texture"},
-      "shaders/simple.vert.glsl", "shaders/light-pass.frag.glsl",
-      GL_COLOR_BUFFER_BIT, false, true, true);
+      {"albedo_texture", "normals_texture", "depth_texture", "light_buffer",
+       "cluster_buffer", "light_index_buffer", "shadow_texture"},
+      {"light_texture"}, "shaders/simple.vert.glsl",
+      "shaders/light-pass.frag.glsl", GL_COLOR_BUFFER_BIT, false, true, false);
+  if (lighting_mode == LightingMode::kLightVolumes) {
+    // accumulated on top of the light pass, stencil tested against a copy of
+    // the gbuffer's depth since the lights sample it
+    pipeline_generator_.register_texture(
+        "light_volume_depth_texture", width, height,
+        pixel::Format::kDepthStencil, pixel::InternalFormat::kDepth24Stencil8,
+        pixel::ComponentType::kUnsignedInt248);
+    pipeline_generator_.register_light_volume_pass(
+        {"albedo_texture", "normals_texture", "depth_texture",
+         "light_buffer"},
+        {"light_texture", "light_volume_depth_texture"},
+        "shaders/position-only.vert.glsl", "shaders/depth-only.frag.glsl",
+        "shaders/light-volume.frag.glsl", "shaders/shadow-copy.vert.glsl",
+        "shaders/depth-copy.frag.glsl");
+  }
   // albedo pass
   pipeline_generator_.register_pass(
       {"albedo_texture", "light_texture"}, {"light_plus_albedo_texture"},
@@ -84,14 +199,110 @@ DeferredRenderer::DeferredRenderer(Window* window,
       {"light_plus_albedo_texture", "depth_texture"}, {},
       "shaders/simple.vert.glsl", "shaders/ambient-pass.frag.glsl",
       GL_COLOR_BUFFER_BIT, false, false, false);
+  pipeline_generator_.build();
 }
 
 DeferredRenderer::~DeferredRenderer() {}
 
 void DeferredRenderer::render(StackFramePacket* frame_packet,
                               CommandBucket& render_commands) {
+  auto frame_start = std::chrono::steady_clock::now();
+  if (dynamic_resolution_enabled_ &&
+      last_frame_start_ != std::chrono::steady_clock::time_point()) {
+    float frame_time = std::chrono::duration<float, std::milli>(
+                           frame_start - last_frame_start_)
+                           .count();
+    pipeline_.set_resolution_scale(resolution_scaler_.update(
+        driver_->get_gpu_frame_time(), frame_time));
+  }
+  last_frame_start_ = frame_start;
   pipeline_.render(frame_packet, render_commands);
 }
 
+void DeferredRenderer::set_overdraw_counter(bool enabled) {
+  pipeline_.set_overdraw_counter(enabled);
+}
+
+float DeferredRenderer::get_overdraw() const {
+  float scale = pipeline_.get_resolution_scale();
+  float pixel_count =
+      static_cast<float>(width_ * height_) * scale * scale;
+  return static_cast<float>(driver_->get_samples_passed()) / pixel_count;
+}
+
+void DeferredRenderer::set_occlusion_culling(bool enabled) {
+  pipeline_.set_occlusion_culling(enabled);
+}
+
+const OcclusionCulling::Statistics&
+DeferredRenderer::get_occlusion_statistics() const {
+  return pipeline_.get_occlusion_statistics();
+}
+
+void DeferredRenderer::set_lod_pixel_error(float pixel_error) {
+  pipeline_.set_lod_pixel_error(pixel_error);
+}
+
+const LodSelector::Statistics& DeferredRenderer::get_lod_statistics() const {
+  return pipeline_.get_lod_statistics();
+}
+
+void DeferredRenderer::set_multi_draw(bool enabled) {
+  pipeline_.set_multi_draw(enabled);
+}
+
+void DeferredRenderer::set_shadow_settings(
+    const ShadowCascades::Settings& settings) {
+  pipeline_.set_shadow_settings(settings);
+}
+
+const ShadowCascades::Settings& DeferredRenderer::get_shadow_settings() const {
+  return pipeline_.get_shadow_settings();
+}
+
+const ShadowCascades::Statistics& DeferredRenderer::get_shadow_statistics()
+    const {
+  return pipeline_.get_shadow_statistics();
+}
+
+void DeferredRenderer::set_static_mesh_set(
+    const StaticMeshSet* static_mesh_set) {
+  pipeline_.set_static_mesh_set(static_mesh_set);
+}
+
+void DeferredRenderer::set_resolution_scale(float scale) {
+  scale = std::min(std::max(scale, 0.01f), max_resolution_scale_);
+  pipeline_.set_resolution_scale(scale);
+  resolution_scaler_.reset(scale);
+}
+
+float DeferredRenderer::get_resolution_scale() const {
+  return pipeline_.get_resolution_scale();
+}
+
+void DeferredRenderer::set_dynamic_resolution(bool enabled) {
+  dynamic_resolution_enabled_ = enabled;
+  last_frame_start_ = std::chrono::steady_clock::time_point();
+  resolution_scaler_.reset(pipeline_.get_resolution_scale());
+}
+
+void DeferredRenderer::set_resolution_scaler_settings(
+    const ResolutionScaler::Settings& settings) {
+  ResolutionScaler::Settings clamped_settings = settings;
+  clamped_settings.max_scale =
+      std::min(settings.max_scale, max_resolution_scale_);
+  clamped_settings.min_scale =
+      std::min(settings.min_scale, clamped_settings.max_scale);
+  resolution_scaler_.set_settings(clamped_settings);
+}
+
+const ResolutionScaler& DeferredRenderer::get_resolution_scaler() const {
+  return resolution_scaler_;
+}
+
+std::size_t DeferredRenderer::get_draw_call_count() const {
+  return driver_->get_draw_call_count();
+}
+
 }  // namespace render
 }  // namespace donkey
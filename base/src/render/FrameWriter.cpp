@@ -0,0 +1,110 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#if defined(MSVC)
+# pragma warning(push)
+# pragma warning(disable : 26812 26819)
+#endif
+
+#include <SDL.h>
+#include <SDL_image.h>
+
+#if defined(MSVC)
+# pragma warning(pop)
+#endif
+
+#include <iostream>
+#include <utility>
+
+#include "render/FrameWriter.hpp"
+
+namespace donkey {
+namespace render {
+
+FrameWriter::FrameWriter(const std::string& path_prefix)
+    : path_prefix_(path_prefix), writing_(false), quit_(false) {
+  worker_ = std::thread(&FrameWriter::work_, this);
+}
+
+FrameWriter::~FrameWriter() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    quit_ = true;
+  }
+  work_condition_.notify_one();
+  worker_.join();
+}
+
+void FrameWriter::write(std::size_t frame_index,
+                        const uint8_t* pixels,
+                        int width,
+                        int height) {
+  Frame frame;
+  frame.path = path_prefix_ + std::to_string(frame_index) + ".png";
+  frame.pixels.assign(pixels, pixels + width * height * 4);
+  frame.width = width;
+  frame.height = height;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_condition_.wait(
+        lock, [this] { return frames_.size() < kMaxPendingFrames; });
+    frames_.push_back(std::move(frame));
+  }
+  work_condition_.notify_one();
+}
+
+void FrameWriter::flush() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_condition_.wait(lock, [this] { return frames_.empty() && !writing_; });
+}
+
+void FrameWriter::work_() {
+  while (true) {
+    Frame frame;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      work_condition_.wait(lock, [this] { return quit_ || !frames_.empty(); });
+      // Pending frames are still saved when quitting.
+      if (frames_.empty())
+        return;
+      frame = std::move(frames_.front());
+      frames_.pop_front();
+      writing_ = true;
+    }
+    done_condition_.notify_all();
+    save_(frame);
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      writing_ = false;
+    }
+    done_condition_.notify_all();
+  }
+}
+
+void FrameWriter::save_(const Frame& frame) {
+  SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormatFrom(
+      const_cast<uint8_t*>(frame.pixels.data()), frame.width, frame.height,
+      32, frame.width * 4, SDL_PIXELFORMAT_RGBA32);
+  if (!surface || IMG_SavePNG(surface, frame.path.c_str()) != 0) {
+    std::cerr << "Can't save " << frame.path << ": " << SDL_GetError()
+              << '\n';
+  }
+  SDL_FreeSurface(surface);
+}
+
+}  // namespace render
+}  // namespace donkey
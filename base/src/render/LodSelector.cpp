@@ -0,0 +1,74 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "render/LodSelector.hpp"
+
+namespace donkey {
+namespace render {
+
+namespace {
+
+// Coarsest level of `mesh` whose projected error is at most `max_error`.
+uint32_t get_coarsest_lod(const Mesh& mesh,
+                          float pixels_per_unit,
+                          float max_error) {
+  uint32_t lod = 0;
+  // Errors only grow along the chain.
+  while (lod < mesh.lods.size() &&
+         mesh.lods[lod].error * pixels_per_unit <= max_error) {
+    ++lod;
+  }
+  return lod;
+}
+
+}  // namespace
+
+LodSelector::LodSelector()
+    : pixel_error_(1.0f), hysteresis_(0.25f), statistics_() {}
+
+void LodSelector::set_pixel_error(float pixel_error) {
+  pixel_error_ = pixel_error;
+}
+
+uint32_t LodSelector::select(const Mesh& mesh,
+                             float pixels_per_unit,
+                             uint32_t previous_lod) const {
+  uint32_t lod = get_coarsest_lod(mesh, pixels_per_unit, pixel_error_);
+  if (previous_lod == kNoLod || previous_lod > mesh.lods.size())
+    return lod;
+  // Go coarser once the coarser level is clearly good enough, and back to a
+  // finer one once the current level is clearly too coarse.
+  if (lod > previous_lod) {
+    return std::max(previous_lod,
+                    get_coarsest_lod(mesh, pixels_per_unit,
+                                     pixel_error_ * (1.0f - hysteresis_)));
+  }
+  if (lod < previous_lod) {
+    return std::min(previous_lod,
+                    get_coarsest_lod(mesh, pixels_per_unit,
+                                     pixel_error_ * (1.0f + hysteresis_)));
+  }
+  return lod;
+}
+
+const LodSelector::Statistics& LodSelector::get_statistics() const {
+  return statistics_;
+}
+
+}  // namespace render
+}  // namespace donkey
@@ -21,8 +21,11 @@ namespace donkey {
 
 namespace render {
 
-Mesh::Mesh(std::uint32_t id, size_t index_count)
-    : Resource(id), index_count(index_count) {}
+Mesh::Mesh(std::uint32_t id,
+           size_t index_count,
+           const glm::vec3& min,
+           const glm::vec3& max)
+    : Resource(id), index_count(index_count), min(min), max(max) {}
 
 }  // namespace render
 }  // namespace donkey
@@ -0,0 +1,505 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "render/OcclusionCulling.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+#include <utility>
+
+// Same kernel selection as ClusteredLighting.cpp.
+#if defined(__SSE2__) || defined(_M_X64)
+#define STURDY_DONKEY_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define STURDY_DONKEY_NEON
+#include <arm_neon.h>
+#endif
+
+namespace donkey {
+namespace render {
+
+namespace {
+
+const std::size_t kTileCount =
+    OcclusionCulling::kTileCountX * OcclusionCulling::kTileCountY;
+const uint32_t kFullCoverage = 0xffffffff;
+
+// Clamps before converting, vertices close to the near plane project far
+// away.
+int get_tile(float coordinate, int size, int tile_size) {
+  coordinate = std::min(std::max(coordinate, 0.0f), size - 1.0f);
+  return static_cast<int>(coordinate) / tile_size;
+}
+
+#if defined(STURDY_DONKEY_NEON)
+unsigned int get_lane_mask(uint32x4_t lanes) {
+  return (vgetq_lane_u32(lanes, 0) & 1) | (vgetq_lane_u32(lanes, 1) & 2) |
+         (vgetq_lane_u32(lanes, 2) & 4) | (vgetq_lane_u32(lanes, 3) & 8);
+}
+#endif
+
+}  // namespace
+
+OcclusionCulling::OcclusionCulling()
+    : view_projection_(1.0f),
+      near_plane_(0.0f),
+      perspective_(false),
+      far_depths_(kTileCount + 3, FLT_MAX),
+      layer_depths_(kTileCount, 0.0f),
+      layer_masks_(kTileCount, 0),
+      statistics_(),
+      generation_(0),
+      pending_workers_(0),
+      quit_(false) {
+  // Like ClusteredLighting, leave the simulation and render threads alone.
+  std::size_t thread_count = std::thread::hardware_concurrency();
+  thread_count = (thread_count > 2) ? thread_count - 2 : 1;
+  thread_count = std::min<std::size_t>(thread_count, kTileCountY);
+  bands_.resize(thread_count);
+  for (std::size_t i = 1; i < thread_count; ++i)
+    workers_.emplace_back(&OcclusionCulling::work_, this, i);
+}
+
+OcclusionCulling::~OcclusionCulling() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    quit_ = true;
+  }
+  work_condition_.notify_all();
+  for (std::thread& worker : workers_)
+    worker.join();
+}
+
+bool OcclusionCulling::begin(const CameraNode& camera_node) {
+  statistics_ = Statistics();
+  triangles_.clear();
+  // Orthographic projections leave w at 1, it isn't a depth.
+  perspective_ = (camera_node.projection[2][3] != 0.0f);
+  if (!perspective_)
+    return false;
+  view_projection_ = camera_node.projection * camera_node.view;
+  near_plane_ = camera_node.near_plane;
+  std::fill(far_depths_.begin(), far_depths_.begin() + kTileCount, FLT_MAX);
+  std::fill(layer_depths_.begin(), layer_depths_.end(), 0.0f);
+  std::fill(layer_masks_.begin(), layer_masks_.end(), 0);
+  return true;
+}
+
+void OcclusionCulling::add_occluder(const glm::mat4& model, const Mesh& mesh) {
+  if (!perspective_)
+    return;
+  ++statistics_.occluder_count;
+  glm::mat4 model_view_projection = view_projection_ * model;
+  clip_positions_.clear();
+  for (const glm::vec3& position : mesh.occluder_positions) {
+    clip_positions_.push_back(model_view_projection *
+                              glm::vec4(position, 1.0f));
+  }
+  const std::vector<uint32_t>& indices = mesh.occluder_indices;
+  for (std::size_t i = 0; i + 2 < indices.size(); i += 3) {
+    add_triangle_(clip_positions_[indices[i]],
+                  clip_positions_[indices[i + 1]],
+                  clip_positions_[indices[i + 2]]);
+  }
+}
+
+void OcclusionCulling::add_triangle_(const glm::vec4& a,
+                                     const glm::vec4& b,
+                                     const glm::vec4& c) {
+  // Trivially rejected when the three vertices are on the outer side of the
+  // same frustum plane.
+  for (int axis = 0; axis < 2; ++axis) {
+    if ((a[axis] > a.w && b[axis] > b.w && c[axis] > c.w) ||
+        (a[axis] < -a.w && b[axis] < -b.w && c[axis] < -c.w)) {
+      return;
+    }
+  }
+  int behind_count = (a.w < near_plane_) + (b.w < near_plane_) +
+                     (c.w < near_plane_);
+  if (behind_count == 3)
+    return;
+  if (behind_count == 0) {
+    setup_triangle_({a, b, c});
+    return;
+  }
+
+  // Clip against the near plane, which leaves a triangle or a quad.
+  const glm::vec4* vertices[] = {&a, &b, &c};
+  glm::vec4 polygon[4];
+  int vertex_count = 0;
+  for (int i = 0; i < 3; ++i) {
+    const glm::vec4& p = *vertices[i];
+    const glm::vec4& q = *vertices[(i + 1) % 3];
+    float p_distance = p.w - near_plane_;
+    float q_distance = q.w - near_plane_;
+    if (p_distance >= 0.0f)
+      polygon[vertex_count++] = p;
+    if ((p_distance >= 0.0f) != (q_distance >= 0.0f)) {
+      polygon[vertex_count++] =
+          p + (q - p) * (p_distance / (p_distance - q_distance));
+    }
+  }
+  assert(vertex_count == 3 || vertex_count == 4);
+  setup_triangle_({polygon[0], polygon[1], polygon[2]});
+  if (vertex_count == 4)
+    setup_triangle_({polygon[0], polygon[2], polygon[3]});
+}
+
+void OcclusionCulling::setup_triangle_(const glm::vec4 (&positions)[3]) {
+  Triangle triangle;
+  float inverse_w[3];
+  for (int i = 0; i < 3; ++i) {
+    inverse_w[i] = 1.0f / positions[i].w;
+    triangle.x[i] = (positions[i].x * inverse_w[i] * 0.5f + 0.5f) * kWidth;
+    triangle.y[i] = (positions[i].y * inverse_w[i] * 0.5f + 0.5f) * kHeight;
+  }
+  const float* x = triangle.x;
+  const float* y = triangle.y;
+  float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+  // The front faces of a closed occluder hide whatever its back faces do.
+  if (!(area > 0.0f))
+    return;
+
+  float min_x = std::min({triangle.x[0], triangle.x[1], triangle.x[2]});
+  float max_x = std::max({triangle.x[0], triangle.x[1], triangle.x[2]});
+  float min_y = std::min({triangle.y[0], triangle.y[1], triangle.y[2]});
+  float max_y = std::max({triangle.y[0], triangle.y[1], triangle.y[2]});
+  if (max_x < 0.0f || min_x >= kWidth || max_y < 0.0f || min_y >= kHeight)
+    return;
+  triangle.first_tile_x = get_tile(min_x, kWidth, kTileWidth);
+  triangle.last_tile_x = get_tile(max_x, kWidth, kTileWidth);
+  triangle.first_tile_y = get_tile(min_y, kHeight, kTileHeight);
+  triangle.last_tile_y = get_tile(max_y, kHeight, kTileHeight);
+
+  for (int i = 0; i < 3; ++i) {
+    int j = (i + 1) % 3;
+    triangle.a[i] = triangle.y[i] - triangle.y[j];
+    triangle.b[i] = triangle.x[j] - triangle.x[i];
+    int origin = (std::make_pair(x[i], y[i]) < std::make_pair(x[j], y[j]))
+                     ? i
+                     : j;
+    triangle.edge_x[i] = x[origin];
+    triangle.edge_y[i] = y[origin];
+  }
+  // The barycentric weight of a vertex is the edge function of the opposite
+  // edge over the area.
+  triangle.inverse_w = inverse_w[0];
+  triangle.inverse_w_dx = (triangle.a[1] * inverse_w[0] +
+                           triangle.a[2] * inverse_w[1] +
+                           triangle.a[0] * inverse_w[2]) /
+                          area;
+  triangle.inverse_w_dy = (triangle.b[1] * inverse_w[0] +
+                           triangle.b[2] * inverse_w[1] +
+                           triangle.b[0] * inverse_w[2]) /
+                          area;
+  triangle.min_inverse_w = std::min({inverse_w[0], inverse_w[1], inverse_w[2]});
+  triangles_.push_back(triangle);
+  ++statistics_.triangle_count;
+}
+
+// Returns the pixels of the tile at x, y whose center is inside the
+// triangle, bit row * kTileWidth + column for each of them.
+uint32_t OcclusionCulling::get_coverage_(const Triangle& triangle,
+                                         int x,
+                                         int y) const {
+#if defined(STURDY_DONKEY_SSE2)
+  // Edge functions of the left and right halves of a row, for each edge.
+  const __m128 columns = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+  const __m128 zero = _mm_setzero_ps();
+  __m128 left[3];
+  __m128 right[3];
+  __m128 steps[3];
+  for (int edge = 0; edge < 3; ++edge) {
+    __m128 a = _mm_set1_ps(triangle.a[edge]);
+    __m128 dx = _mm_add_ps(_mm_set1_ps(x - triangle.edge_x[edge]), columns);
+    float dy = y + 0.5f - triangle.edge_y[edge];
+    left[edge] = _mm_add_ps(_mm_mul_ps(a, dx),
+                            _mm_set1_ps(triangle.b[edge] * dy));
+    right[edge] =
+        _mm_add_ps(left[edge], _mm_set1_ps(triangle.a[edge] * 4.0f));
+    steps[edge] = _mm_set1_ps(triangle.b[edge]);
+  }
+  uint32_t coverage = 0;
+  for (int row = 0; row < kTileHeight; ++row) {
+    __m128 left_min = _mm_min_ps(_mm_min_ps(left[0], left[1]), left[2]);
+    __m128 right_min = _mm_min_ps(_mm_min_ps(right[0], right[1]), right[2]);
+    uint32_t bits =
+        static_cast<uint32_t>(_mm_movemask_ps(_mm_cmpge_ps(left_min, zero))) |
+        static_cast<uint32_t>(_mm_movemask_ps(_mm_cmpge_ps(right_min, zero)))
+            << 4;
+    coverage |= bits << (row * kTileWidth);
+    for (int edge = 0; edge < 3; ++edge) {
+      left[edge] = _mm_add_ps(left[edge], steps[edge]);
+      right[edge] = _mm_add_ps(right[edge], steps[edge]);
+    }
+  }
+  return coverage;
+#elif defined(STURDY_DONKEY_NEON)
+  const float column_offsets[] = {0.5f, 1.5f, 2.5f, 3.5f};
+  const float32x4_t columns = vld1q_f32(column_offsets);
+  const float32x4_t zero = vdupq_n_f32(0.0f);
+  float32x4_t left[3];
+  float32x4_t right[3];
+  float32x4_t steps[3];
+  for (int edge = 0; edge < 3; ++edge) {
+    float32x4_t dx = vaddq_f32(vdupq_n_f32(x - triangle.edge_x[edge]), columns);
+    float dy = y + 0.5f - triangle.edge_y[edge];
+    left[edge] = vmlaq_f32(vdupq_n_f32(triangle.b[edge] * dy),
+                           vdupq_n_f32(triangle.a[edge]), dx);
+    right[edge] =
+        vaddq_f32(left[edge], vdupq_n_f32(triangle.a[edge] * 4.0f));
+    steps[edge] = vdupq_n_f32(triangle.b[edge]);
+  }
+  uint32_t coverage = 0;
+  for (int row = 0; row < kTileHeight; ++row) {
+    float32x4_t left_min = vminq_f32(vminq_f32(left[0], left[1]), left[2]);
+    float32x4_t right_min =
+        vminq_f32(vminq_f32(right[0], right[1]), right[2]);
+    uint32_t bits = get_lane_mask(vcgeq_f32(left_min, zero)) |
+                    get_lane_mask(vcgeq_f32(right_min, zero)) << 4;
+    coverage |= bits << (row * kTileWidth);
+    for (int edge = 0; edge < 3; ++edge) {
+      left[edge] = vaddq_f32(left[edge], steps[edge]);
+      right[edge] = vaddq_f32(right[edge], steps[edge]);
+    }
+  }
+  return coverage;
+#else
+  uint32_t coverage = 0;
+  for (int row = 0; row < kTileHeight; ++row) {
+    for (int column = 0; column < kTileWidth; ++column) {
+      bool inside = true;
+      for (int edge = 0; edge < 3; ++edge) {
+        float dx = x + column + 0.5f - triangle.edge_x[edge];
+        float dy = y + row + 0.5f - triangle.edge_y[edge];
+        inside = inside &&
+                 (triangle.a[edge] * dx + triangle.b[edge] * dy >= 0.0f);
+      }
+      if (inside)
+        coverage |= 1u << (row * kTileWidth + column);
+    }
+  }
+  return coverage;
+#endif
+}
+
+// Merges a triangle covering `coverage` no farther than `depth` into the
+// tile's layer. The layer becomes the tile's far depth once it covers every
+// pixel, which keeps the far depth conservative.
+void OcclusionCulling::update_tile_(std::size_t tile,
+                                    uint32_t coverage,
+                                    float depth) {
+  float& far_depth = far_depths_[tile];
+  float& layer_depth = layer_depths_[tile];
+  uint32_t& layer_mask = layer_masks_[tile];
+  if (depth >= far_depth)
+    return;
+  // A triangle closer to the far depth than to the layer most likely
+  // belongs to another surface, start the layer over from it.
+  if (layer_mask != 0 &&
+      std::abs(depth - layer_depth) > far_depth - depth) {
+    layer_depth = 0.0f;
+    layer_mask = 0;
+  }
+  layer_depth = std::max(layer_depth, depth);
+  layer_mask |= coverage;
+  if (layer_mask == kFullCoverage) {
+    far_depth = layer_depth;
+    layer_depth = 0.0f;
+    layer_mask = 0;
+  }
+}
+
+// Returns a 4-bit mask of the tiles in [tile, tile + 4) whose far depth
+// isn't in front of `depth`.
+unsigned int OcclusionCulling::farther_4_(std::size_t tile,
+                                          float depth) const {
+#if defined(STURDY_DONKEY_SSE2)
+  __m128 far_depths = _mm_loadu_ps(far_depths_.data() + tile);
+  return static_cast<unsigned int>(
+      _mm_movemask_ps(_mm_cmpge_ps(far_depths, _mm_set1_ps(depth))));
+#elif defined(STURDY_DONKEY_NEON)
+  float32x4_t far_depths = vld1q_f32(far_depths_.data() + tile);
+  return get_lane_mask(vcgeq_f32(far_depths, vdupq_n_f32(depth)));
+#else
+  unsigned int mask = 0;
+  for (std::size_t i = 0; i < 4; ++i) {
+    if (far_depths_[tile + i] >= depth)
+      mask |= 1u << i;
+  }
+  return mask;
+#endif
+}
+
+void OcclusionCulling::rasterize_band_(const Band& band) {
+  for (const Triangle& triangle : triangles_) {
+    int first_tile_y = std::max(triangle.first_tile_y, band.first_tile_y);
+    int last_tile_y = std::min(triangle.last_tile_y, band.last_tile_y - 1);
+    for (int tile_y = first_tile_y; tile_y <= last_tile_y; ++tile_y) {
+      int y = tile_y * kTileHeight;
+      for (int tile_x = triangle.first_tile_x; tile_x <= triangle.last_tile_x;
+           ++tile_x) {
+        int x = tile_x * kTileWidth;
+        // 1 / w is linear, so the triangle's farthest point in the tile is
+        // at one of its corners, but no farther than its farthest vertex.
+        float inverse_w = triangle.inverse_w +
+                          triangle.inverse_w_dx * (x - triangle.x[0]) +
+                          triangle.inverse_w_dy * (y - triangle.y[0]) +
+                          std::min(triangle.inverse_w_dx * kTileWidth, 0.0f) +
+                          std::min(triangle.inverse_w_dy * kTileHeight, 0.0f);
+        float depth = 1.0f / std::max(inverse_w, triangle.min_inverse_w);
+        std::size_t tile = tile_y * kTileCountX + tile_x;
+        if (depth >= far_depths_[tile])
+          continue;
+        uint32_t coverage = get_coverage_(triangle, x, y);
+        if (coverage)
+          update_tile_(tile, coverage, depth);
+      }
+    }
+  }
+}
+
+void OcclusionCulling::rasterize() {
+  if (!perspective_)
+    return;
+  std::size_t band_count = (triangles_.size() < kParallelTriangleCount)
+                               ? 1
+                               : bands_.size();
+  rasterize_all_(band_count);
+}
+
+void OcclusionCulling::rasterize_all_(std::size_t band_count) {
+  for (std::size_t i = 0; i < band_count; ++i) {
+    bands_[i].first_tile_y = static_cast<int>(i * kTileCountY / band_count);
+    bands_[i].last_tile_y =
+        static_cast<int>((i + 1) * kTileCountY / band_count);
+  }
+  if (band_count == 1) {
+    rasterize_band_(bands_[0]);
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_workers_ = band_count - 1;
+    ++generation_;
+  }
+  work_condition_.notify_all();
+  rasterize_band_(bands_[0]);
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_condition_.wait(lock, [this] { return pending_workers_ == 0; });
+}
+
+void OcclusionCulling::work_(std::size_t worker) {
+  uint64_t generation = 0;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      work_condition_.wait(
+          lock, [&] { return quit_ || generation_ != generation; });
+      if (quit_)
+        return;
+      generation = generation_;
+    }
+    rasterize_band_(bands_[worker]);
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      --pending_workers_;
+    }
+    done_condition_.notify_one();
+  }
+}
+
+bool OcclusionCulling::is_visible(const glm::mat4& model, const Mesh& mesh) {
+  ++statistics_.tested_count;
+  if (!perspective_)
+    return true;
+
+  glm::mat4 model_view_projection = view_projection_ * model;
+  int outside_counts[4] = {0, 0, 0, 0};  // left, right, bottom, top
+  int behind_count = 0;
+  float min_x = FLT_MAX;
+  float max_x = -FLT_MAX;
+  float min_y = FLT_MAX;
+  float max_y = -FLT_MAX;
+  float min_depth = FLT_MAX;
+  for (int corner = 0; corner < 8; ++corner) {
+    glm::vec4 position((corner & 1) ? mesh.max.x : mesh.min.x,
+                       (corner & 2) ? mesh.max.y : mesh.min.y,
+                       (corner & 4) ? mesh.max.z : mesh.min.z, 1.0f);
+    position = model_view_projection * position;
+    outside_counts[0] += (position.x < -position.w);
+    outside_counts[1] += (position.x > position.w);
+    outside_counts[2] += (position.y < -position.w);
+    outside_counts[3] += (position.y > position.w);
+    if (position.w < near_plane_) {
+      ++behind_count;
+      continue;
+    }
+    float x = (position.x / position.w * 0.5f + 0.5f) * kWidth;
+    float y = (position.y / position.w * 0.5f + 0.5f) * kHeight;
+    min_x = std::min(min_x, x);
+    max_x = std::max(max_x, x);
+    min_y = std::min(min_y, y);
+    max_y = std::max(max_y, y);
+    min_depth = std::min(min_depth, position.w);
+  }
+  if (behind_count == 8 || outside_counts[0] == 8 || outside_counts[1] == 8 ||
+      outside_counts[2] == 8 || outside_counts[3] == 8) {
+    ++statistics_.frustum_culled_count;
+    return false;
+  }
+  // Boxes reaching the camera cover most of the screen anyway.
+  if (behind_count > 0)
+    return true;
+
+  int first_tile_x = get_tile(min_x, kWidth, kTileWidth);
+  int last_tile_x = get_tile(max_x, kWidth, kTileWidth);
+  int first_tile_y = get_tile(min_y, kHeight, kTileHeight);
+  int last_tile_y = get_tile(max_y, kHeight, kTileHeight);
+  for (int tile_y = first_tile_y; tile_y <= last_tile_y; ++tile_y) {
+    std::size_t row = tile_y * kTileCountX;
+    for (int tile_x = first_tile_x; tile_x <= last_tile_x; tile_x += 4) {
+      unsigned int mask = farther_4_(row + tile_x, min_depth);
+      // Ignore the lanes past the end of the box's tiles.
+      int lane_count = std::min(4, last_tile_x - tile_x + 1);
+      if (mask & ((1u << lane_count) - 1))
+        return true;
+    }
+  }
+  ++statistics_.occlusion_culled_count;
+  return false;
+}
+
+float OcclusionCulling::get_depth(int x, int y) const {
+  assert(x >= 0 && x < kWidth && y >= 0 && y < kHeight);
+  std::size_t tile = (y / kTileHeight) * kTileCountX + x / kTileWidth;
+  uint32_t bit = 1u << ((y % kTileHeight) * kTileWidth + x % kTileWidth);
+  if (layer_masks_[tile] & bit)
+    return std::min(far_depths_[tile], layer_depths_[tile]);
+  return far_depths_[tile];
+}
+
+const OcclusionCulling::Statistics& OcclusionCulling::get_statistics() const {
+  return statistics_;
+}
+
+}  // namespace render
+}  // namespace donkey
@@ -0,0 +1,194 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "render/OffscreenContext.hpp"
+
+#include <EGL/eglext.h>
+
+#include <cassert>
+#include <cstring>
+#include <iostream>
+
+namespace donkey {
+
+namespace render {
+
+namespace {
+
+bool has_extension(const char* extensions, const char* extension) {
+  if (!extensions)
+    return false;
+  std::size_t length = std::strlen(extension);
+  for (const char* position = std::strstr(extensions, extension); position;
+       position = std::strstr(position + length, extension)) {
+    if ((position == extensions || position[-1] == ' ') &&
+        (position[length] == ' ' || position[length] == '\0'))
+      return true;
+  }
+  return false;
+}
+
+const EGLint config_attributes[] = {EGL_SURFACE_TYPE,
+                                    EGL_PBUFFER_BIT,
+                                    EGL_RENDERABLE_TYPE,
+                                    EGL_OPENGL_BIT,
+                                    EGL_RED_SIZE,
+                                    8,
+                                    EGL_GREEN_SIZE,
+                                    8,
+                                    EGL_BLUE_SIZE,
+                                    8,
+                                    EGL_ALPHA_SIZE,
+                                    8,
+                                    EGL_NONE};
+
+}  // namespace
+
+OffscreenContext::OffscreenContext(int width, int height)
+    : display_(get_display_()),
+      surface_(EGL_NO_SURFACE),
+      render_context_(EGL_NO_CONTEXT),
+      ancillary_context_(EGL_NO_CONTEXT),
+      width_(width),
+      height_(height) {
+  EGLint major;
+  EGLint minor;
+  if (display_ == EGL_NO_DISPLAY || !eglInitialize(display_, &major, &minor) ||
+      !eglBindAPI(EGL_OPENGL_API)) {
+    std::cerr << "Can't initialize EGL for offscreen rendering: 0x"
+              << std::hex << eglGetError() << std::dec << '\n';
+    assert(false);
+    return;
+  }
+
+  EGLConfig config;
+  EGLint config_count = 0;
+  eglChooseConfig(display_, config_attributes, &config, 1, &config_count);
+  if (config_count == 0) {
+    std::cerr << "No EGL config for offscreen rendering.\n";
+    assert(false);
+    return;
+  }
+
+  // Same version and profile as Window's contexts.
+  const EGLint context_attributes[] = {EGL_CONTEXT_MAJOR_VERSION,
+                                       4,
+                                       EGL_CONTEXT_MINOR_VERSION,
+                                       1,
+                                       EGL_CONTEXT_OPENGL_PROFILE_MASK,
+                                       EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+                                       EGL_CONTEXT_OPENGL_FORWARD_COMPATIBLE,
+                                       EGL_TRUE,
+                                       EGL_NONE};
+  render_context_ =
+      eglCreateContext(display_, config, EGL_NO_CONTEXT, context_attributes);
+  ancillary_context_ =
+      eglCreateContext(display_, config, render_context_, context_attributes);
+  if (render_context_ == EGL_NO_CONTEXT ||
+      ancillary_context_ == EGL_NO_CONTEXT) {
+    std::cerr << "Can't create a GL 4.1 core context with EGL: 0x"
+              << std::hex << eglGetError() << std::dec << '\n';
+    assert(false);
+    return;
+  }
+
+  if (!has_extension_("EGL_KHR_surfaceless_context")) {
+    const EGLint surface_attributes[] = {EGL_WIDTH, 1, EGL_HEIGHT, 1,
+                                         EGL_NONE};
+    surface_ = eglCreatePbufferSurface(display_, config, surface_attributes);
+    assert(surface_ != EGL_NO_SURFACE);
+  }
+}
+
+OffscreenContext::~OffscreenContext() {
+  eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+  if (ancillary_context_ != EGL_NO_CONTEXT)
+    eglDestroyContext(display_, ancillary_context_);
+  if (render_context_ != EGL_NO_CONTEXT)
+    eglDestroyContext(display_, render_context_);
+  if (surface_ != EGL_NO_SURFACE)
+    eglDestroySurface(display_, surface_);
+  eglTerminate(display_);
+}
+
+bool OffscreenContext::is_available() {
+  EGLDisplay display = get_display_();
+  EGLint major;
+  EGLint minor;
+  if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor))
+    return false;
+  EGLConfig config;
+  EGLint config_count = 0;
+  bool available = eglBindAPI(EGL_OPENGL_API) &&
+                   eglChooseConfig(display, config_attributes, &config, 1,
+                                   &config_count) &&
+                   config_count > 0;
+  eglTerminate(display);
+  return available;
+}
+
+EGLDisplay OffscreenContext::get_display_() {
+  const char* client_extensions =
+      eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+  if (has_extension(client_extensions, "EGL_MESA_platform_surfaceless")) {
+    auto get_platform_display =
+        reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+            eglGetProcAddress("eglGetPlatformDisplayEXT"));
+    if (get_platform_display) {
+      EGLDisplay display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA,
+                                                EGL_DEFAULT_DISPLAY, nullptr);
+      if (display != EGL_NO_DISPLAY)
+        return display;
+    }
+  }
+  return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+bool OffscreenContext::has_extension_(const char* extension) const {
+  return has_extension(eglQueryString(display_, EGL_EXTENSIONS), extension);
+}
+
+OffscreenContext::Context OffscreenContext::get_render_context() {
+  return render_context_;
+}
+
+OffscreenContext::Context OffscreenContext::get_ancillary_context() {
+  return ancillary_context_;
+}
+
+int OffscreenContext::get_width() const {
+  return width_;
+}
+
+int OffscreenContext::get_height() const {
+  return height_;
+}
+
+void OffscreenContext::make_current(Context context) const {
+  if (!eglMakeCurrent(display_, surface_, surface_, context)) {
+    std::cerr << "Can't use GL context: 0x" << std::hex << eglGetError()
+              << std::dec << '\n';
+    assert(false);
+  }
+}
+
+void OffscreenContext::free_context() const {
+  eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+}
+
+}  // namespace render
+}  // namespace donkey
@@ -17,67 +17,395 @@
 
 #include "render/Pipeline.hpp"
 
+#include <algorithm>
 #include <array>
+#include <cassert>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/mat4x4.hpp>
 #include <glm/vec3.hpp>
 #include <glm/vec4.hpp>
+#include <iostream>
 #include <limits>
+#include <utility>
+#include <vector>
 
 #include "Buffer.hpp"
 #include "BufferPool.hpp"
 #include "debug.hpp"
 #include "render/CommandBucket.hpp"
 #include "render/Material.hpp"
+#include "render/State.hpp"
 
 namespace donkey {
 namespace render {
 
-Pipeline::Pipeline(Window* window,
-                   gl::Driver* driver,
-                   ResourceManager* resource_manager)
-    : window_(window),
-      render_context_(window->get_render_context()),
-      driver_(driver),
+Pipeline::Pipeline(GpuDriver* driver, ResourceManager* resource_manager)
+    : driver_(driver),
       gpu_resource_manager_(driver_->get_resource_manager()),
-      resource_manager_(resource_manager) {}
+      resource_manager_(resource_manager),
+      occlusion_culling_enabled_(false),
+      sphere_mesh_id_(0),
+      cone_mesh_id_(0),
+      stencil_material_id_(0),
+      light_volume_material_id_(0),
+      stencil_state_id_(0),
+      light_volume_state_id_(0),
+      depth_copy_material_id_(0),
+      depth_copy_mesh_id_(0),
+      depth_copy_state_id_(0),
+      depth_prepass_material_id_(0),
+      depth_prepass_state_id_(0),
+      depth_equal_state_id_(0),
+      shadow_cascades_(
+          ShadowCascades::make_settings(ShadowCascades::Quality::kOff)),
+      shadow_framebuffer_id_(0),
+      static_shadow_framebuffer_id_(0),
+      shadow_material_id_(0),
+      shadow_copy_material_id_(0),
+      shadow_quad_mesh_id_(0),
+      shadow_copy_state_id_(0),
+      default_state_id_(0),
+      overdraw_counter_enabled_(false),
+      resolution_scale_(1.0f),
+      gbuffer_layout_(0),
+      multi_draw_enabled_(false),
+      draw_buffer_id_(0),
+      draw_model_count_(0) {
+  default_state_id_ = gpu_resource_manager_.create_state(State(0));
+  draw_buffer_id_ = gpu_resource_manager_.create_texture_buffer(
+      pixel::BufferFormat::kRGBA32F);
+}
 
 Pipeline::~Pipeline() {}
 
+// Edges are scaled rather than sizes, so that views side by side stay so.
+static CameraNode scale_viewport_(const CameraNode& camera_node, float scale) {
+  CameraNode scaled_camera_node = camera_node;
+  if (scale == 1.0f)
+    return scaled_camera_node;
+  glm::tvec2<int> end = camera_node.viewport_position +
+                        glm::tvec2<int>(camera_node.viewport_size);
+  for (int axis = 0; axis < 2; ++axis) {
+    int start = static_cast<int>(camera_node.viewport_position[axis] * scale);
+    int scaled_end = static_cast<int>(end[axis] * scale);
+    scaled_camera_node.viewport_position[axis] = start;
+    scaled_camera_node.viewport_size[axis] =
+        static_cast<GLsizei>(std::max(scaled_end - start, 1));
+  }
+  return scaled_camera_node;
+}
+
+void Pipeline::bucket_mesh_nodes_(
+    const StackVector<MeshNode>& mesh_nodes,
+    const StackVector<CameraNode>& camera_nodes) {
+  std::size_t view_count = camera_nodes.size();
+  for (LayerBucket& layer_bucket : layer_buckets_) {
+    layer_bucket.node_indices.resize(view_count);
+    for (std::vector<uint32_t>& node_indices : layer_bucket.node_indices)
+      node_indices.clear();
+  }
+  view_node_indices_.resize(view_count);
+  for (std::vector<uint32_t>& node_indices : view_node_indices_)
+    node_indices.clear();
+  // A single view sees every node the frame packet kept.
+  bool view_culled = (view_count > 1);
+  for (std::size_t i = 0; i < mesh_nodes.size(); ++i) {
+    uint32_t view_mask = view_culled ? view_culling_.get_view_mask(i) : 1u;
+    for (std::size_t view = 0; view < view_count; ++view) {
+      if (!(view_mask & (1u << view)))
+        continue;
+      uint32_t layers = mesh_nodes[i].layers & camera_nodes[view].layers;
+      bool drawn = false;
+      for (LayerBucket& layer_bucket : layer_buckets_) {
+        if (layers & layer_bucket.layer_mask) {
+          layer_bucket.node_indices[view].push_back(
+              static_cast<uint32_t>(i));
+          drawn = true;
+        }
+      }
+      if (drawn && multi_draw_enabled_)
+        view_node_indices_[view].push_back(static_cast<uint32_t>(i));
+    }
+  }
+}
+
+void Pipeline::upload_draw_models_(const StackVector<MeshNode>& mesh_nodes,
+                                   std::size_t view,
+                                   CommandBucket& render_commands) {
+  // Views go one after the other rather than over the same range, so that
+  // the copy doesn't wait for the draws of the view before.
+  draw_models_.clear();
+  draw_instances_.resize(mesh_nodes.size());
+  for (uint32_t node_index : view_node_indices_[view]) {
+    draw_instances_[node_index] =
+        static_cast<uint32_t>(draw_model_count_ + draw_models_.size());
+    draw_models_.push_back(mesh_nodes[node_index].get_model_matrix());
+  }
+  render_commands.update_texture_buffer(
+      draw_buffer_id_, draw_models_.data(),
+      draw_models_.size() * sizeof(glm::mat4),
+      draw_model_count_ * sizeof(glm::mat4));
+  draw_model_count_ += draw_models_.size();
+}
+
 void Pipeline::render_geometry_(
-    size_t pass_num,
     const RenderPass& render_pass,
     const StackVector<MeshNode>& mesh_nodes,
+    const std::vector<uint32_t>& node_indices,
     const CameraNode& camera_node,
     const CameraNode* last_camera_node,
-    const StackVector<DirectionalLightNode>& light_nodes,
     CommandBucket& render_commands,
     ResourceManager* resource_manager,
     GpuResourceManager* gpu_resource_manager) {
-  for (const MeshNode& mesh_node : mesh_nodes) {
-    // if (camera_node.pass_num != pass_num)
-    //  continue;
-
-    if (render_pass.lighting) {
-      for (const DirectionalLightNode& light_node : light_nodes) {
-        render_mesh_node(render_pass, mesh_node, camera_node, last_camera_node,
-                         &light_node, render_commands, resource_manager,
-                         gpu_resource_manager);
-      }
+  // Lights are binned in the gbuffer camera's clusters, lighting passes
+  // shade every light at once and have nothing to read without it.
+  if (render_pass.lighting && !last_camera_node)
+    return;
+  if (render_pass.light_volumes) {
+    render_light_volumes_(render_pass, render_commands);
+    return;
+  }
+  if (render_pass.depth_prepass) {
+    render_depth_prepass_(render_pass, mesh_nodes, node_indices,
+                          render_commands);
+    return;
+  }
+  // full-screen passes have their own frame packet
+  bool count_samples =
+      overdraw_counter_enabled_ && render_pass.frame_packet == nullptr;
+  if (render_pass.depth_equal)
+    render_commands.set_state(depth_equal_state_id_);
+  if (count_samples)
+    render_commands.begin_sample_count();
+  if (multi_draw_enabled_ && render_pass.frame_packet == nullptr) {
+    render_multi_draws_(render_pass, mesh_nodes, node_indices, kNoMaterial,
+                        render_commands);
+  } else {
+    for (uint32_t node_index : node_indices) {
+      render_mesh_node(render_pass, mesh_nodes[node_index], render_commands,
+                       resource_manager, gpu_resource_manager);
+    }
+  }
+  if (count_samples)
+    render_commands.end_sample_count();
+  if (render_pass.depth_equal)
+    render_commands.set_state(default_state_id_);
+}
+
+void Pipeline::render_shadows_(const StackFramePacket& frame_packet,
+                               CommandBucket& render_commands) {
+  auto get_mesh = [this](uint32_t mesh_id) -> const Mesh& {
+    return resource_manager_->get_mesh(mesh_id);
+  };
+  if (!shadow_cascades_.update(frame_packet, get_mesh))
+    return;
+  const StaticMeshSet* static_casters = shadow_cascades_.get_static_casters();
+  const MeshNode* static_nodes =
+      static_casters ? static_casters->get_mesh_nodes().data() : nullptr;
+  const MeshNode* dynamic_nodes = frame_packet.get_mesh_nodes().data();
+  bool cached = shadow_cascades_.get_settings().cache_static_casters;
+  RenderPass shadow_pass = {nullptr, shadow_framebuffer_id_, 0,
+                            glm::vec3(0.0f, 0.0f, 0.0f), true, false, false,
+                            false, true, false,
+                            ::donkey::SceneNode::kAllLayers};
+  render_commands.set_depth_test(true);
+  render_commands.set_blending(false);
+  for (int i = 0; i < shadow_cascades_.get_cascade_count(); ++i) {
+    const ShadowCascades::Cascade& cascade = shadow_cascades_.get_cascade(i);
+    if (!cascade.dirty)
+      continue;
+    CameraNode camera_node(shadow_cascades_.get_light_view(),
+                           cascade.projection,
+                           shadow_cascades_.get_viewport_position(i),
+                           shadow_cascades_.get_viewport_size());
+    if (cached && cascade.static_dirty) {
+      render_commands.bind_framebuffer(static_shadow_framebuffer_id_);
+      render_commands.set_viewport(camera_node.viewport_position,
+                                   camera_node.viewport_size);
+      render_commands.clear_framebuffer(glm::vec3(0.0f, 0.0f, 0.0f),
+                                        GL_DEPTH_BUFFER_BIT);
+      bind_camera_block(render_commands, camera_node, nullptr, camera_node,
+                        gbuffer_layout_);
+      render_shadow_casters_(shadow_pass, static_nodes,
+                             cascade.static_casters, render_commands);
+    }
+    render_commands.bind_framebuffer(shadow_framebuffer_id_);
+    render_commands.set_viewport(camera_node.viewport_position,
+                                 camera_node.viewport_size);
+    bind_camera_block(render_commands, camera_node, nullptr, camera_node,
+                      gbuffer_layout_);
+    if (cached) {
+      // There is no blit, the cached depth goes through a quad.
+      MeshNode quad_node(0, glm::mat4(1.0f), shadow_quad_mesh_id_,
+                         shadow_copy_material_id_);
+      render_commands.set_state(shadow_copy_state_id_);
+      render_mesh_node(shadow_pass, quad_node, render_commands,
+                       resource_manager_, &gpu_resource_manager_);
+      render_commands.set_state(default_state_id_);
     } else {
-      render_mesh_node(render_pass, mesh_node, camera_node, last_camera_node,
-                       nullptr, render_commands, resource_manager,
-                       gpu_resource_manager);
+      render_commands.clear_framebuffer(glm::vec3(0.0f, 0.0f, 0.0f),
+                                        GL_DEPTH_BUFFER_BIT);
+      render_shadow_casters_(shadow_pass, static_nodes,
+                             cascade.static_casters, render_commands);
+    }
+    render_shadow_casters_(shadow_pass, dynamic_nodes,
+                           cascade.dynamic_casters, render_commands);
+  }
+}
+
+void Pipeline::render_shadow_casters_(
+    const RenderPass& render_pass,
+    const MeshNode* mesh_nodes,
+    const std::vector<uint32_t>& node_indices,
+    CommandBucket& render_commands) {
+  for (uint32_t node_index : node_indices) {
+    MeshNode caster_node = mesh_nodes[node_index];
+    caster_node.material_id = shadow_material_id_;
+    render_mesh_node(render_pass, caster_node, render_commands,
+                     resource_manager_, &gpu_resource_manager_);
+  }
+}
+
+void Pipeline::render_depth_prepass_(const RenderPass& render_pass,
+                                     const StackVector<MeshNode>& mesh_nodes,
+                                     const std::vector<uint32_t>& node_indices,
+                                     CommandBucket& render_commands) {
+  render_commands.set_state(depth_prepass_state_id_);
+  // Positions must be computed the same way as in the pass testing against
+  // this depth, both go through multi-draws or neither does.
+  if (multi_draw_enabled_) {
+    render_multi_draws_(render_pass, mesh_nodes, node_indices,
+                        depth_prepass_material_id_, render_commands);
+  } else {
+    for (uint32_t node_index : node_indices) {
+      MeshNode depth_node = mesh_nodes[node_index];
+      depth_node.material_id = depth_prepass_material_id_;
+      render_mesh_node(render_pass, depth_node, render_commands,
+                       resource_manager_, &gpu_resource_manager_);
+    }
+  }
+  render_commands.set_state(default_state_id_);
+}
+
+void Pipeline::render_multi_draws_(const RenderPass& render_pass,
+                                   const StackVector<MeshNode>& mesh_nodes,
+                                   const std::vector<uint32_t>& node_indices,
+                                   uint32_t material_id,
+                                   CommandBucket& render_commands) {
+  if (node_indices.empty())
+    return;
+  // The model matrices were uploaded with the view's, see
+  // upload_draw_models_.
+  ObjectBlock multi_draw_block;
+  multi_draw_block.model = glm::mat4(1.0f);
+  multi_draw_block.draw_params = glm::ivec4(1, 0, 0, 0);
+  bool multi_draw_block_bound = false;
+
+  const unsigned int no_location = static_cast<unsigned int>(-1);
+  std::size_t begin = 0;
+  while (begin < node_indices.size()) {
+    uint32_t run_material_id = material_id;
+    std::size_t end = node_indices.size();
+    if (material_id == kNoMaterial) {
+      // Nodes come sorted by material, see FramePacket::sort_mesh_nodes.
+      run_material_id = mesh_nodes[node_indices[begin]].material_id;
+      end = begin + 1;
+      while (end < node_indices.size() &&
+             mesh_nodes[node_indices[end]].material_id == run_material_id) {
+        ++end;
+      }
+    }
+    const Material& material =
+        resource_manager_->get_material(run_material_id);
+    const AMaterial& gpu_material =
+        gpu_resource_manager_.get_material(material.gpu_resource_id);
+
+    if (gpu_material.draw_id_location == no_location) {
+      for (std::size_t i = begin; i < end; ++i) {
+        MeshNode mesh_node = mesh_nodes[node_indices[i]];
+        mesh_node.material_id = run_material_id;
+        render_mesh_node(render_pass, mesh_node, render_commands,
+                         resource_manager_, &gpu_resource_manager_);
+      }
+      multi_draw_block_bound = false;
+      begin = end;
+      continue;
+    }
+
+    if (!multi_draw_block_bound) {
+      render_commands.bind_uniform_block(UniformBlockBinding::kObject,
+                                         &multi_draw_block,
+                                         sizeof(multi_draw_block));
+      multi_draw_block_bound = true;
     }
+    gpu_material.bind(material.gpu_resource_id, render_commands);
+    // Every mesh lives in the same buffers, any of them binds them all.
+    const Mesh& first_mesh =
+        resource_manager_->get_mesh(mesh_nodes[node_indices[begin]].mesh_id);
+    render_commands.bind_mesh(first_mesh.gpu_resource_id,
+                              material.position_location,
+                              material.normal_location, material.uv_location,
+                              material.tangent_location,
+                              material.bitangent_location);
+    std::vector<DrawElementsIndirect> draws;
+    draws.reserve(end - begin);
+    for (std::size_t i = begin; i < end; ++i) {
+      const MeshNode& mesh_node = mesh_nodes[node_indices[i]];
+      const Mesh& mesh = resource_manager_->get_mesh(mesh_node.mesh_id);
+      uint32_t gpu_mesh_id = mesh.gpu_resource_id;
+      if (mesh_node.lod > 0 && mesh_node.lod <= mesh.lods.size())
+        gpu_mesh_id = mesh.lods[mesh_node.lod - 1].gpu_resource_id;
+      DrawElementsIndirect draw =
+          gpu_resource_manager_.get_mesh_draw(gpu_mesh_id);
+      draw.base_instance = draw_instances_[node_indices[i]];
+      draws.push_back(draw);
+    }
+    render_commands.multi_draw_elements(draw_buffer_id_, std::move(draws));
+    begin = end;
+  }
+  // Materials were bound behind render_mesh_node's back.
+  forget_bound_material();
+}
+
+void Pipeline::render_light_volumes_(const RenderPass& render_pass,
+                                     CommandBucket& render_commands) {
+  if (clustered_lighting_.get_light_volumes().empty())
+    return;
+  // The stencil test happens in a copy of the depth the light material
+  // samples, see add_light_volume_pass. The pass cleared its stencil.
+  MeshNode quad_node(0, glm::mat4(1.0f), depth_copy_mesh_id_,
+                     depth_copy_material_id_);
+  render_commands.set_state(depth_copy_state_id_);
+  render_mesh_node(render_pass, quad_node, render_commands, resource_manager_,
+                   &gpu_resource_manager_);
+  for (const ClusteredLighting::LightVolume& light_volume :
+       clustered_lighting_.get_light_volumes()) {
+    uint32_t mesh_id = light_volume.spot ? cone_mesh_id_ : sphere_mesh_id_;
+    MeshNode mesh_node(0, light_volume.model, mesh_id, stencil_material_id_);
+    clustered_lighting_.bind_light_volume_block(light_volume, render_commands);
+    // Back faces behind the scene increment the stencil, front faces behind
+    // it decrement it: pixels inside the volume end up non-zero.
+    render_commands.set_state(stencil_state_id_);
+    render_mesh_node(render_pass, mesh_node, render_commands,
+                     resource_manager_, &gpu_resource_manager_);
+    // Shade them through the back faces, so that it works from inside the
+    // volume too, and reset the stencil for the next light.
+    mesh_node.material_id = light_volume_material_id_;
+    render_commands.set_state(light_volume_state_id_);
+    render_mesh_node(render_pass, mesh_node, render_commands,
+                     resource_manager_, &gpu_resource_manager_);
   }
+  render_commands.set_state(default_state_id_);
 }
 
 void Pipeline::execute_pass_(
     size_t pass_num,
     const RenderPass& render_pass,
     const StackFramePacket& frame_packet,
+    std::size_t view,
+    const CameraNode& view_camera_node,
+    const CameraNode& window_camera_node,
     const CameraNode* last_camera_node,
-    const StackVector<DirectionalLightNode>& light_nodes,
     CommandBucket& render_commands,
     ResourceManager* resource_manager,
     GpuResourceManager* gpu_resource_manager) {
@@ -85,41 +413,196 @@ void Pipeline::execute_pass_(
   render_commands.set_depth_test(render_pass.depth_test);
   render_commands.set_blending(render_pass.blending);
 
-  const CameraNode& camera_node = frame_packet.get_camera_node();
-  render_commands.set_viewport(camera_node.viewport_position,
-                               camera_node.viewport_size);
-  render_commands.clear_framebuffer(render_pass.clear_color);
+  // Passes with their own frame packet look through their own camera, into
+  // the view's viewport all the same: full-screen passes cover the view.
+  const CameraNode& camera_node = render_pass.frame_packet
+                                      ? frame_packet.get_camera_node()
+                                      : view_camera_node;
+  const CameraNode& viewport_camera_node =
+      (render_pass.framebuffer_id == kWindowFramebuffer) ? window_camera_node
+                                                         : view_camera_node;
+  render_commands.set_viewport(viewport_camera_node.viewport_position,
+                               viewport_camera_node.viewport_size);
+  render_commands.clear_framebuffer(render_pass.clear_color,
+                                    render_pass.clear_bits);
+  bind_camera_block(render_commands, camera_node, last_camera_node,
+                    view_camera_node, gbuffer_layout_);
 
-  render_geometry_(pass_num, render_pass, frame_packet.get_mesh_nodes(),
-                   camera_node, last_camera_node, light_nodes, render_commands,
-                   resource_manager, gpu_resource_manager);
+  const StackVector<MeshNode>& mesh_nodes = frame_packet.get_mesh_nodes();
+  const std::vector<uint32_t>* node_indices = &all_node_indices_;
+  if (pass_buckets_[pass_num] != kNoBucket) {
+    node_indices =
+        &layer_buckets_[pass_buckets_[pass_num]].node_indices[view];
+  } else if (render_pass.frame_packet &&
+             all_node_indices_.size() != mesh_nodes.size()) {
+    all_node_indices_.resize(mesh_nodes.size());
+    for (std::size_t i = 0; i < mesh_nodes.size(); ++i)
+      all_node_indices_[i] = static_cast<uint32_t>(i);
+  }
+  render_geometry_(render_pass, mesh_nodes, *node_indices, camera_node,
+                   last_camera_node, render_commands, resource_manager,
+                   gpu_resource_manager);
 }
 
 void Pipeline::render(StackFramePacket* gbuffer_frame_packet,
                       CommandBucket& render_commands) {
-  const CameraNode* last_camera_node =
-      &(gbuffer_frame_packet->get_camera_node());
+  const StackVector<CameraNode>& camera_nodes =
+      gbuffer_frame_packet->get_camera_nodes();
+  StackVector<MeshNode>& mesh_nodes = gbuffer_frame_packet->get_mesh_nodes();
+  auto get_mesh = [this](uint32_t mesh_id) -> const Mesh& {
+    return resource_manager_->get_mesh(mesh_id);
+  };
   signpost_start(1, 0, 0, 0, 0);
-  for (size_t i = 0; i < render_passes_.size(); ++i) {
-    const StackFramePacket* frame_packet;
-    if (render_passes_[i].frame_packet)
-      frame_packet = render_passes_[i].frame_packet;
-    else
-      frame_packet = gbuffer_frame_packet;
-    execute_pass_(i, render_passes_[i], *frame_packet, last_camera_node,
-                  gbuffer_frame_packet->get_directional_light_nodes(),
-                  render_commands, resource_manager_, &gpu_resource_manager_);
-    last_camera_node = &(frame_packet->get_camera_node());
+  // The commands of a frame may be executed by a driver which hasn't seen
+  // the previous ones.
+  forget_bound_material();
+  // Casters out of every view still cast shadows into them.
+  render_shadows_(*gbuffer_frame_packet, render_commands);
+  // Occlusion culling removes nodes from the packet, which the other views
+  // may see.
+  if (camera_nodes.size() > 1)
+    view_culling_.cull(camera_nodes, mesh_nodes, get_mesh);
+  else if (occlusion_culling_enabled_)
+    occlusion_culling_.cull(camera_nodes.front(), mesh_nodes, get_mesh);
+  // Once per frame so that every pass and view draws a node with the same
+  // level, which may be coarser at lower resolutions.
+  lod_selector_.select(
+      scale_viewport_(camera_nodes.front(), resolution_scale_), mesh_nodes,
+      get_mesh);
+  bucket_mesh_nodes_(mesh_nodes, camera_nodes);
+  draw_model_count_ = 0;
+  for (std::size_t view = 0; view < camera_nodes.size(); ++view) {
+    if (multi_draw_enabled_)
+      upload_draw_models_(mesh_nodes, view, render_commands);
+    const CameraNode view_camera_node =
+        scale_viewport_(camera_nodes[view], resolution_scale_);
+    const CameraNode* gbuffer_camera_node = &view_camera_node;
+    const CameraNode* last_camera_node = gbuffer_camera_node;
+    clustered_lighting_.render(
+        *gbuffer_camera_node,
+        gbuffer_frame_packet->get_directional_light_nodes(),
+        gbuffer_frame_packet->get_point_light_nodes(),
+        gbuffer_frame_packet->get_spot_light_nodes(), render_commands);
+    ShadowBlock shadow_block =
+        shadow_cascades_.make_shadow_block(*gbuffer_camera_node);
+    render_commands.bind_uniform_block(UniformBlockBinding::kShadow,
+                                       &shadow_block, sizeof(shadow_block));
+    for (size_t i = 0; i < render_passes_.size(); ++i) {
+      const StackFramePacket* frame_packet;
+      if (render_passes_[i].frame_packet)
+        frame_packet = render_passes_[i].frame_packet;
+      else
+        frame_packet = gbuffer_frame_packet;
+      // Light volumes are drawn from the gbuffer camera and read its
+      // gbuffer.
+      if (render_passes_[i].light_volumes)
+        last_camera_node = gbuffer_camera_node;
+      execute_pass_(i, render_passes_[i], *frame_packet, view,
+                    *gbuffer_camera_node, camera_nodes[view],
+                    last_camera_node, render_commands, resource_manager_,
+                    &gpu_resource_manager_);
+      if (render_passes_[i].frame_packet)
+        last_camera_node = &(frame_packet->get_camera_node());
+      else
+        last_camera_node = gbuffer_camera_node;
+    }
   }
   signpost_end(1, 0, 0, 0, 0);
 }
 
+void Pipeline::set_shadow_settings(const ShadowCascades::Settings& settings) {
+  const ShadowCascades::Settings& atlas_settings =
+      shadow_cascades_.get_settings();
+  if (settings.cascade_count != atlas_settings.cascade_count ||
+      settings.resolution != atlas_settings.resolution) {
+    std::cerr << "Pipeline::set_shadow_settings: the shadow atlas holds "
+              << atlas_settings.cascade_count << " cascades of "
+              << atlas_settings.resolution << " texels\n";
+    assert(false);
+    return;
+  }
+  shadow_cascades_.set_settings(settings);
+}
+
+const ShadowCascades::Settings& Pipeline::get_shadow_settings() const {
+  return shadow_cascades_.get_settings();
+}
+
+const ShadowCascades::Statistics& Pipeline::get_shadow_statistics() const {
+  return shadow_cascades_.get_statistics();
+}
+
+void Pipeline::set_static_mesh_set(const StaticMeshSet* static_mesh_set) {
+  shadow_cascades_.set_static_casters(static_mesh_set);
+}
+
+void Pipeline::set_light_buffers(uint32_t light_buffer_id,
+                                 uint32_t cluster_buffer_id,
+                                 uint32_t light_index_buffer_id) {
+  clustered_lighting_.set_texture_buffers(light_buffer_id, cluster_buffer_id,
+                                          light_index_buffer_id);
+}
+
+void Pipeline::set_gbuffer_layout(int gbuffer_layout) {
+  gbuffer_layout_ = gbuffer_layout;
+}
+
+void Pipeline::set_resolution_scale(float scale) {
+  assert(scale > 0.0f);
+  resolution_scale_ = scale;
+}
+
+float Pipeline::get_resolution_scale() const {
+  return resolution_scale_;
+}
+
+void Pipeline::set_overdraw_counter(bool enabled) {
+  overdraw_counter_enabled_ = enabled;
+}
+
+void Pipeline::set_occlusion_culling(bool enabled) {
+  occlusion_culling_enabled_ = enabled;
+}
+
+const OcclusionCulling::Statistics& Pipeline::get_occlusion_statistics()
+    const {
+  return occlusion_culling_.get_statistics();
+}
+
+const ViewCulling::Statistics& Pipeline::get_view_culling_statistics() const {
+  return view_culling_.get_statistics();
+}
+
+void Pipeline::set_multi_draw(bool enabled) {
+  multi_draw_enabled_ = enabled;
+}
+
+void Pipeline::set_lod_pixel_error(float pixel_error) {
+  lod_selector_.set_pixel_error(pixel_error);
+}
+
+const LodSelector::Statistics& Pipeline::get_lod_statistics() const {
+  return lod_selector_.get_statistics();
+}
+
 void Pipeline::add_render_pass(const RenderPass& render_pass) {
   render_passes_.push_back(render_pass);
+  // Passes with their own frame packet and light volume passes draw
+  // everything they're given.
+  std::size_t bucket = kNoBucket;
+  if (!render_pass.frame_packet && !render_pass.light_volumes) {
+    for (bucket = 0; bucket < layer_buckets_.size(); ++bucket) {
+      if (layer_buckets_[bucket].layer_mask == render_pass.layer_mask)
+        break;
+    }
+    if (bucket == layer_buckets_.size())
+      layer_buckets_.push_back({render_pass.layer_mask, {}});
+  }
+  pass_buckets_.push_back(bucket);
 }
 
 void Pipeline::add_render_pass(RenderPass&& render_pass) {
-  render_passes_.push_back(render_pass);
+  add_render_pass(static_cast<const RenderPass&>(render_pass));
 }
 
 void Pipeline::add_render_pass(donkey::CameraNode camera_node,
@@ -139,17 +622,107 @@ void Pipeline::add_render_pass(donkey::CameraNode camera_node,
       glm::vec3(1.0f, 1.0f, 1.0f), screen_mesh_id, material_id);
   add_render_pass({&frame_packet, framebuffer_id, clear_bits,
                    glm::vec3(0.0f, 0.0f, 0.0f), depth_test, lighting,
-                   blending});
+                   blending, false, false, false,
+                   ::donkey::SceneNode::kAllLayers});
 }
 
 void Pipeline::add_render_pass(uint32_t framebuffer_id,
                                GLint clear_bits,
                                bool depth_test,
                                bool lighting,
-                               bool blending) {
+                               bool blending,
+                               bool depth_equal,
+                               uint32_t layer_mask) {
   add_render_pass({nullptr, framebuffer_id, clear_bits,
                    glm::vec3(0.0f, 0.0f, 0.0f), depth_test, lighting,
-                   blending});
+                   blending, false, false, depth_equal, layer_mask});
+}
+
+void Pipeline::add_depth_prepass(uint32_t framebuffer_id,
+                                 GLint clear_bits,
+                                 uint32_t material_id,
+                                 uint32_t layer_mask) {
+  depth_prepass_material_id_ = material_id;
+  State depth_prepass_state(0);
+  depth_prepass_state.color_write_enabled = false;
+  depth_prepass_state_id_ =
+      gpu_resource_manager_.create_state(depth_prepass_state);
+  State depth_equal_state(0);
+  depth_equal_state.depth_function = ComparisonFunction::kEqual;
+  depth_equal_state.depth_write_enabled = false;
+  depth_equal_state_id_ = gpu_resource_manager_.create_state(depth_equal_state);
+  add_render_pass({nullptr, framebuffer_id, clear_bits,
+                   glm::vec3(0.0f, 0.0f, 0.0f), true, false, false, false,
+                   true, false, layer_mask});
+}
+
+void Pipeline::add_light_volume_pass(uint32_t framebuffer_id,
+                                     uint32_t sphere_mesh_id,
+                                     uint32_t cone_mesh_id,
+                                     uint32_t stencil_material_id,
+                                     uint32_t light_material_id,
+                                     uint32_t depth_copy_material_id,
+                                     uint32_t quad_mesh_id) {
+  sphere_mesh_id_ = sphere_mesh_id;
+  cone_mesh_id_ = cone_mesh_id;
+  stencil_material_id_ = stencil_material_id;
+  light_volume_material_id_ = light_material_id;
+  depth_copy_material_id_ = depth_copy_material_id;
+  depth_copy_mesh_id_ = quad_mesh_id;
+
+  State depth_copy_state(0);
+  depth_copy_state.depth_function = ComparisonFunction::kAlways;
+  depth_copy_state.color_write_enabled = false;
+  depth_copy_state_id_ = gpu_resource_manager_.create_state(depth_copy_state);
+
+  State stencil_state(0);
+  stencil_state.depth_write_enabled = false;
+  stencil_state.color_write_enabled = false;
+  stencil_state.stencil_test_enabled = true;
+  stencil_state.stencil_front.depth_fail = StencilOperation::kDecrementWrap;
+  stencil_state.stencil_back.depth_fail = StencilOperation::kIncrementWrap;
+  stencil_state_id_ = gpu_resource_manager_.create_state(stencil_state);
+
+  State light_volume_state(0);
+  light_volume_state.depth_test_enabled = false;
+  light_volume_state.depth_write_enabled = false;
+  light_volume_state.stencil_test_enabled = true;
+  for (StencilFaceState* face : {&light_volume_state.stencil_front,
+                                 &light_volume_state.stencil_back}) {
+    face->function = ComparisonFunction::kNotEqual;
+    face->depth_fail = StencilOperation::kZero;
+    face->depth_pass = StencilOperation::kZero;
+  }
+  light_volume_state.face_culling_enabled = true;
+  light_volume_state.cull_mode = CullMode::kFront;
+  light_volume_state.blending_enabled = true;
+  light_volume_state_id_ =
+      gpu_resource_manager_.create_state(light_volume_state);
+
+  clustered_lighting_.set_local_light_binning(false);
+  add_render_pass({nullptr, framebuffer_id, GL_STENCIL_BUFFER_BIT,
+                   glm::vec3(0.0f, 0.0f, 0.0f), true, true, true, true, false,
+                   false, ::donkey::SceneNode::kAllLayers});
+}
+
+void Pipeline::add_shadow_pass(uint32_t framebuffer_id,
+                               uint32_t static_framebuffer_id,
+                               uint32_t caster_material_id,
+                               uint32_t copy_material_id,
+                               uint32_t quad_mesh_id,
+                               const ShadowCascades::Settings& settings) {
+  shadow_cascades_.set_settings(settings);
+  shadow_framebuffer_id_ = framebuffer_id;
+  static_shadow_framebuffer_id_ = static_framebuffer_id;
+  shadow_material_id_ = caster_material_id;
+  shadow_copy_material_id_ = copy_material_id;
+  shadow_quad_mesh_id_ = quad_mesh_id;
+  // The copy overwrites whatever the atlas held.
+  State shadow_copy_state(0);
+  shadow_copy_state.depth_function = ComparisonFunction::kAlways;
+  shadow_copy_state.color_write_enabled = false;
+  shadow_copy_state_id_ =
+      gpu_resource_manager_.create_state(shadow_copy_state);
 }
 
 }  // namespace render
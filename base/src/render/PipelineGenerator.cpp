@@ -17,12 +17,64 @@
 
 #include "render/PipelineGenerator.hpp"
 
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <sstream>
+
+#include "render/shader_fusion.hpp"
+
 #if defined(max)
 #undef max
 #endif
 
 namespace donkey {
 namespace render {
+namespace {
+std::size_t get_texel_size(pixel::InternalFormat internal_format) {
+  switch (internal_format) {
+    case pixel::InternalFormat::kRGB8:
+      return 3;
+    case pixel::InternalFormat::kRGB16F:
+      return 6;
+    case pixel::InternalFormat::kRGBA8:
+    case pixel::InternalFormat::kDepth24Stencil8:
+    case pixel::InternalFormat::kRG16:
+    case pixel::InternalFormat::kRGB10A2:
+    case pixel::InternalFormat::kR11G11B10F:
+      return 4;
+    case pixel::InternalFormat::kDepthComponent24:
+      return 3;
+    case pixel::InternalFormat::kRGBA16F:
+      return 8;
+  }
+  return 4;  // will never happen but makes MSVC happy
+}
+
+bool is_depth_format(pixel::Format format) {
+  return format == pixel::Format::kDepthComponent ||
+         format == pixel::Format::kDepthStencil;
+}
+
+double to_mebibytes(std::size_t size) {
+  return static_cast<double>(size) / (1024.0 * 1024.0);
+}
+
+bool read_file(const std::string& path, std::string& contents) {
+  std::ifstream stream(path);
+  if (!stream)
+    return false;
+  std::ostringstream buffer;
+  buffer << stream.rdbuf();
+  contents = buffer.str();
+  return true;
+}
+}  // namespace
+
 PipelineGenerator::PipelineGenerator(ResourceManager& resource_manager,
                                      GpuResourceManager& gpu_resource_manager,
                                      Pipeline& pipeline,
@@ -41,7 +93,10 @@ PipelineGenerator::PipelineGenerator(ResourceManager& resource_manager,
                              -1.0f,
                              1.0f,
                              donkey::CameraNode::Type::kOrthographic)),
-      screen_mesh_id_(0) {
+      screen_mesh_id_(0),
+      depth_prepass_added_(false),
+      shadow_settings_(
+          ShadowCascades::make_settings(ShadowCascades::Quality::kOff)) {
   create_screen_mesh_(window_width, window_height);
 }
 
@@ -69,15 +124,100 @@ void PipelineGenerator::create_screen_mesh_(int window_width,
       screen_mesh_normals, screen_mesh_normals, screen_mesh_indices);
 }
 
+// Two triangles covering clip space, counter-clockwise.
+uint32_t PipelineGenerator::create_quad_mesh_() {
+  std::vector<float> positions{-1.0f, -1.0f, 0.0f, 1.0f, -1.0f, 0.0f,
+                               1.0f,  1.0f,  0.0f, -1.0f, 1.0f, 0.0f};
+  std::vector<float> uvs{0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 1.0f, 0.0f, 1.0f};
+  std::vector<unsigned int> indices{0, 1, 2, 0, 2, 3};
+  return resource_manager_.create_mesh(positions, positions, uvs, positions,
+                                       positions, indices);
+}
+
+// Latitude/longitude sphere, scaled so that its faces enclose the unit sphere.
+uint32_t PipelineGenerator::create_sphere_mesh_() {
+  const int ring_count = 8;
+  const int segment_count = 16;
+  const float pi = 3.14159265f;
+  float scale = 1.0f / (std::cos(pi / (2 * ring_count)) *
+                        std::cos(pi / segment_count));
+  std::vector<float> positions;
+  for (int ring = 0; ring <= ring_count; ++ring) {
+    float theta = pi * ring / ring_count;
+    for (int segment = 0; segment <= segment_count; ++segment) {
+      float phi = 2.0f * pi * segment / segment_count;
+      positions.push_back(scale * std::sin(theta) * std::cos(phi));
+      positions.push_back(scale * std::cos(theta));
+      positions.push_back(scale * std::sin(theta) * std::sin(phi));
+    }
+  }
+  std::vector<unsigned int> indices;
+  for (int ring = 0; ring < ring_count; ++ring) {
+    for (int segment = 0; segment < segment_count; ++segment) {
+      unsigned int a = ring * (segment_count + 1) + segment;
+      unsigned int b = a + segment_count + 1;
+      // counter-clockwise seen from outside
+      indices.insert(indices.end(), {a, b + 1, b, a, a + 1, b + 1});
+    }
+  }
+  std::vector<float> uvs(positions.size() / 3 * 2, 0.0f);
+  return resource_manager_.create_mesh(positions, positions, uvs, positions,
+                                       positions, indices);
+}
+
+// Cone of height 1 along -z with its apex at the origin, scaled so that its
+// faces enclose the circular cone of radius 1.
+uint32_t PipelineGenerator::create_cone_mesh_() {
+  const int segment_count = 16;
+  const float pi = 3.14159265f;
+  float scale = 1.0f / std::cos(pi / segment_count);
+  std::vector<float> positions{0.0f, 0.0f, 0.0f, 0.0f, 0.0f, -1.0f};
+  for (int segment = 0; segment < segment_count; ++segment) {
+    float phi = 2.0f * pi * segment / segment_count;
+    positions.push_back(scale * std::cos(phi));
+    positions.push_back(scale * std::sin(phi));
+    positions.push_back(-1.0f);
+  }
+  std::vector<unsigned int> indices;
+  for (unsigned int segment = 0; segment < segment_count; ++segment) {
+    unsigned int a = 2 + segment;
+    unsigned int b = 2 + (segment + 1) % segment_count;
+    // side then base, counter-clockwise seen from outside
+    indices.insert(indices.end(), {0, a, b, 1, b, a});
+  }
+  std::vector<float> uvs(positions.size() / 3 * 2, 0.0f);
+  return resource_manager_.create_mesh(positions, positions, uvs, positions,
+                                       positions, indices);
+}
+
 void PipelineGenerator::register_texture(const std::string& name,
                                          int width,
                                          int height,
                                          pixel::Format format,
                                          pixel::InternalFormat internal_format,
-                                         pixel::ComponentType component_type) {
-  uint32_t id = resource_manager_.create_texture(
-      width, height, format, internal_format, component_type);
-  id_map_[name] = id;
+                                         pixel::ComponentType component_type,
+                                         bool persistent) {
+  texture_names_.push_back(name);
+  texture_declarations_[name] = {width, height, format, internal_format,
+                                 component_type, persistent};
+}
+
+void PipelineGenerator::register_texture_buffer(const std::string& name,
+                                                pixel::BufferFormat format) {
+  texture_buffer_id_map_[name] =
+      gpu_resource_manager_.create_texture_buffer(format);
+}
+
+uint32_t PipelineGenerator::get_texture_buffer_id(
+    const std::string& name) const {
+  return texture_buffer_id_map_.at(name);
+}
+
+uint32_t PipelineGenerator::get_texture_id(const std::string& name) const {
+  auto id = id_map_.find(name);
+  if (id == id_map_.end())
+    return std::numeric_limits<uint32_t>::max();
+  return id->second;
 }
 
 void PipelineGenerator::register_pass(
@@ -89,12 +229,11 @@ void PipelineGenerator::register_pass(
     bool depth_test,
     bool lighting,
     bool blending) {
-  uint32_t material_id = register_material_(input_textures, vertex_shader_path,
-                                            fragment_shader_path);
-  uint32_t framebuffer_id = register_framebuffer_(render_targets);
-  pipeline_.add_render_pass(camera_node_, screen_mesh_id_, material_id,
-                            framebuffer_id, clear_bits, depth_test, lighting,
-                            blending);
+  pass_declarations_.push_back({PassType::kScreen, input_textures,
+                                render_targets, vertex_shader_path,
+                                fragment_shader_path, "", "", "", clear_bits,
+                                depth_test, lighting, blending,
+                                ::donkey::SceneNode::kAllLayers, ""});
 }
 
 void PipelineGenerator::register_pass(
@@ -102,28 +241,379 @@ void PipelineGenerator::register_pass(
     GLint clear_bits,
     bool depth_test,
     bool lighting,
-    bool blending) {
-  uint32_t framebuffer_id = register_framebuffer_(render_targets);
-  pipeline_.add_render_pass(framebuffer_id, clear_bits, depth_test, lighting,
-                            blending);
+    bool blending,
+    uint32_t layer_mask) {
+  pass_declarations_.push_back({PassType::kGeometry, {}, render_targets, "",
+                                "", "", "", "", clear_bits, depth_test,
+                                lighting, blending, layer_mask, ""});
+}
+
+void PipelineGenerator::register_depth_prepass(
+    const std::list<std::string>& render_targets,
+    GLint clear_bits,
+    const std::string& vertex_shader_path,
+    const std::string& fragment_shader_path,
+    uint32_t layer_mask) {
+  pass_declarations_.push_back({PassType::kDepthPrepass, {}, render_targets,
+                                vertex_shader_path, fragment_shader_path, "",
+                                "", "", clear_bits, true, false, false,
+                                layer_mask, ""});
+}
+
+void PipelineGenerator::register_light_volume_pass(
+    const std::list<std::string>& input_textures,
+    const std::list<std::string>& render_targets,
+    const std::string& vertex_shader_path,
+    const std::string& stencil_fragment_shader_path,
+    const std::string& fragment_shader_path,
+    const std::string& copy_vertex_shader_path,
+    const std::string& copy_fragment_shader_path) {
+  pass_declarations_.push_back(
+      {PassType::kLightVolumes, input_textures, render_targets,
+       vertex_shader_path, fragment_shader_path, stencil_fragment_shader_path,
+       copy_vertex_shader_path, copy_fragment_shader_path,
+       GL_STENCIL_BUFFER_BIT, false, true, true,
+       ::donkey::SceneNode::kAllLayers, ""});
+}
+
+void PipelineGenerator::register_shadow_pass(
+    const std::string& shadow_texture,
+    const std::string& static_shadow_texture,
+    const std::string& caster_vertex_shader_path,
+    const std::string& caster_fragment_shader_path,
+    const std::string& copy_vertex_shader_path,
+    const std::string& copy_fragment_shader_path,
+    const ShadowCascades::Settings& settings) {
+  // Cascades not drawn this frame keep last frame's depth, the pass never
+  // clears the whole atlas.
+  pass_declarations_.push_back(
+      {PassType::kShadows, {static_shadow_texture}, {shadow_texture},
+       caster_vertex_shader_path, caster_fragment_shader_path, "",
+       copy_vertex_shader_path, copy_fragment_shader_path, 0, true, false,
+       false, ::donkey::SceneNode::kAllLayers, ""});
+  shadow_settings_ = settings;
+}
+
+void PipelineGenerator::build() {
+  std::vector<bool> live_passes = cull_passes_();
+  fuse_passes_(live_passes);
+  allocate_textures_(get_lifetimes_(live_passes));
+  for (std::size_t i = 0; i < pass_declarations_.size(); ++i) {
+    if (live_passes[i])
+      add_pass_(pass_declarations_[i]);
+  }
+}
+
+// Whether `pass` replaces the whole content of `render_target`, in which case
+// what was there before doesn't need to be kept.
+bool PipelineGenerator::overwrites_(const PassDeclaration& pass,
+                                    const std::string& render_target) const {
+  const TextureDeclaration& texture = texture_declarations_.at(render_target);
+  GLint bits = is_depth_format(texture.format) ? GL_DEPTH_BUFFER_BIT
+                                               : GL_COLOR_BUFFER_BIT;
+  return (pass.clear_bits & bits) != 0;
+}
+
+// Walks the passes backwards from the ones drawing to the window, keeping
+// those writing a texture a kept pass reads.
+std::vector<bool> PipelineGenerator::cull_passes_() const {
+  std::vector<bool> live_passes(pass_declarations_.size(), false);
+  std::unordered_map<std::string, bool> needed;
+  for (std::size_t i = pass_declarations_.size(); i-- > 0;) {
+    const PassDeclaration& pass = pass_declarations_[i];
+    bool live = pass.render_targets.empty();
+    for (auto& render_target : pass.render_targets)
+      live = live || needed[render_target];
+    if (!live) {
+      std::cout << "Culling render pass " << i
+                << ", nothing reads its render targets.\n";
+      continue;
+    }
+    live_passes[i] = true;
+    for (auto& render_target : pass.render_targets)
+      needed[render_target] = !overwrites_(pass, render_target);
+    for (auto& input_texture : pass.input_textures) {
+      if (texture_declarations_.count(input_texture) != 0)
+        needed[input_texture] = true;
+    }
+  }
+  return live_passes;
+}
+
+// A full-screen pass writing a single texture that the next pass, a
+// full-screen pass drawn with the same vertex shader, is the last to read.
+bool PipelineGenerator::can_fuse_(std::size_t producer,
+                                  std::size_t consumer,
+                                  const std::vector<bool>& live_passes) const {
+  const PassDeclaration& producer_pass = pass_declarations_[producer];
+  const PassDeclaration& consumer_pass = pass_declarations_[consumer];
+  if (producer_pass.type != PassType::kScreen ||
+      consumer_pass.type != PassType::kScreen ||
+      producer_pass.render_targets.size() != 1 || producer_pass.depth_test ||
+      producer_pass.lighting || producer_pass.blending ||
+      producer_pass.vertex_shader_path != consumer_pass.vertex_shader_path)
+    return false;
+  const std::string& texture = producer_pass.render_targets.front();
+  auto declaration = texture_declarations_.find(texture);
+  if (declaration == texture_declarations_.end() ||
+      declaration->second.persistent ||
+      is_depth_format(declaration->second.format) ||
+      !overwrites_(producer_pass, texture))
+    return false;
+  auto uses = [&texture](const std::list<std::string>& textures) {
+    return std::find(textures.begin(), textures.end(), texture) !=
+           textures.end();
+  };
+  if (!uses(consumer_pass.input_textures) ||
+      uses(consumer_pass.render_targets))
+    return false;
+  for (std::size_t i = consumer + 1; i < pass_declarations_.size(); ++i) {
+    if (live_passes[i] && (uses(pass_declarations_[i].input_textures) ||
+                           uses(pass_declarations_[i].render_targets)))
+      return false;
+  }
+  return true;
+}
+
+// The fused pass reads the producer's inputs, the texture it wrote is never
+// allocated. Fused passes can be fused again, so chains end up in the last
+// one.
+void PipelineGenerator::fuse_passes_(std::vector<bool>& live_passes) {
+  for (std::size_t i = 0; i < pass_declarations_.size(); ++i) {
+    if (!live_passes[i])
+      continue;
+    std::size_t next = i + 1;
+    while (next < pass_declarations_.size() && !live_passes[next])
+      ++next;
+    if (next == pass_declarations_.size() || !can_fuse_(i, next, live_passes))
+      continue;
+
+    PassDeclaration& producer = pass_declarations_[i];
+    PassDeclaration& consumer = pass_declarations_[next];
+    const std::string& texture = producer.render_targets.front();
+    std::string producer_sources = producer.fragment_shader_sources;
+    std::string consumer_sources = consumer.fragment_shader_sources;
+    std::string fused_sources;
+    if ((producer_sources.empty() &&
+         !read_file(producer.fragment_shader_path, producer_sources)) ||
+        (consumer_sources.empty() &&
+         !read_file(consumer.fragment_shader_path, consumer_sources)) ||
+        !shader_fusion::fuse(producer_sources, consumer_sources, texture,
+                             fused_sources)) {
+      std::cout << "Render pass " << i << " can't be fused into render pass "
+                << next << ", its shaders don't allow it.\n";
+      continue;
+    }
+    consumer.fragment_shader_sources = fused_sources;
+    consumer.input_textures.remove(texture);
+    for (auto& input_texture : producer.input_textures) {
+      if (std::find(consumer.input_textures.begin(),
+                    consumer.input_textures.end(),
+                    input_texture) == consumer.input_textures.end())
+        consumer.input_textures.push_back(input_texture);
+    }
+    live_passes[i] = false;
+    std::cout << "Fusing render pass " << i << " into render pass " << next
+              << ", " << texture << " isn't stored.\n";
+  }
+}
+
+std::unordered_map<std::string, PipelineGenerator::Lifetime>
+PipelineGenerator::get_lifetimes_(const std::vector<bool>& live_passes) const {
+  std::unordered_map<std::string, Lifetime> lifetimes;
+  for (auto& name : texture_names_)
+    lifetimes[name] = {-1, -1};
+
+  auto use = [&lifetimes](const std::string& name, int pass) {
+    Lifetime& lifetime = lifetimes[name];
+    if (lifetime.first_pass == -1)
+      lifetime.first_pass = pass;
+    lifetime.last_pass = pass;
+  };
+  for (std::size_t i = 0; i < pass_declarations_.size(); ++i) {
+    if (!live_passes[i])
+      continue;
+    const PassDeclaration& pass = pass_declarations_[i];
+    for (auto& input_texture : pass.input_textures) {
+      if (texture_buffer_id_map_.count(input_texture) != 0)
+        continue;
+      if (texture_declarations_.count(input_texture) == 0) {
+        std::cerr << "Render pass " << i << " reads unknown texture "
+                  << input_texture << '\n';
+        assert(false);
+        continue;
+      }
+      use(input_texture, static_cast<int>(i));
+    }
+    for (auto& render_target : pass.render_targets) {
+      if (texture_declarations_.count(render_target) == 0) {
+        std::cerr << "Render pass " << i << " writes unknown texture "
+                  << render_target << '\n';
+        assert(false);
+        continue;
+      }
+      use(render_target, static_cast<int>(i));
+    }
+  }
+  return lifetimes;
+}
+
+// Greedy interval allocation: in order of first use, each texture takes over
+// a compatible texture whose last user comes strictly before its first one.
+void PipelineGenerator::allocate_textures_(
+    const std::unordered_map<std::string, Lifetime>& lifetimes) {
+  struct Allocation {
+    TextureDeclaration declaration;
+    int last_pass;
+    uint32_t id;
+  };
+  std::vector<Allocation> allocations;
+
+  std::vector<std::string> names;
+  for (auto& name : texture_names_) {
+    if (lifetimes.at(name).first_pass != -1)
+      names.push_back(name);
+  }
+  std::stable_sort(names.begin(), names.end(),
+                   [&lifetimes](const std::string& a, const std::string& b) {
+                     return lifetimes.at(a).first_pass <
+                            lifetimes.at(b).first_pass;
+                   });
+
+  std::size_t declared_size = 0;
+  for (auto& name : texture_names_) {
+    const TextureDeclaration& texture = texture_declarations_.at(name);
+    declared_size += static_cast<std::size_t>(texture.width) *
+                     texture.height * get_texel_size(texture.internal_format);
+  }
+  std::size_t allocated_size = 0;
+  for (auto& name : names) {
+    const TextureDeclaration& texture = texture_declarations_.at(name);
+    const Lifetime& lifetime = lifetimes.at(name);
+    auto allocation = std::find_if(
+        allocations.begin(), allocations.end(),
+        [&texture, &lifetime](const Allocation& allocation) {
+          return !texture.persistent &&
+                 !allocation.declaration.persistent &&
+                 allocation.last_pass < lifetime.first_pass &&
+                 allocation.declaration.width == texture.width &&
+                 allocation.declaration.height == texture.height &&
+                 allocation.declaration.internal_format ==
+                     texture.internal_format;
+        });
+    if (allocation == allocations.end()) {
+      uint32_t id = resource_manager_.create_texture(
+          texture.width, texture.height, texture.format,
+          texture.internal_format, texture.component_type);
+      allocated_size += static_cast<std::size_t>(texture.width) *
+                        texture.height *
+                        get_texel_size(texture.internal_format);
+      allocations.push_back({texture, lifetime.last_pass, id});
+      allocation = allocations.end() - 1;
+    }
+    allocation->last_pass = lifetime.last_pass;
+    id_map_[name] = allocation->id;
+    std::cout << "Render target " << name << ": passes " << lifetime.first_pass
+              << " to " << lifetime.last_pass << ", texture "
+              << allocation - allocations.begin() << '\n';
+  }
+  std::cout << std::fixed << std::setprecision(2)
+            << "Render target memory: " << to_mebibytes(declared_size)
+            << " MiB declared, " << to_mebibytes(allocated_size)
+            << " MiB allocated in " << allocations.size() << " textures.\n"
+            << std::defaultfloat;
+}
+
+void PipelineGenerator::add_pass_(const PassDeclaration& pass) {
+  uint32_t framebuffer_id = register_framebuffer_(pass.render_targets);
+  switch (pass.type) {
+    case PassType::kScreen: {
+      uint32_t material_id = register_material_(
+          pass.input_textures, pass.vertex_shader_path,
+          pass.fragment_shader_path, pass.fragment_shader_sources);
+      pipeline_.add_render_pass(camera_node_, screen_mesh_id_, material_id,
+                                framebuffer_id, pass.clear_bits,
+                                pass.depth_test, pass.lighting,
+                                pass.blending);
+      break;
+    }
+    case PassType::kGeometry:
+      pipeline_.add_render_pass(framebuffer_id, pass.clear_bits,
+                                pass.depth_test, pass.lighting, pass.blending,
+                                depth_prepass_added_, pass.layer_mask);
+      break;
+    case PassType::kDepthPrepass:
+      pipeline_.add_depth_prepass(
+          framebuffer_id, pass.clear_bits,
+          register_material_({}, pass.vertex_shader_path,
+                             pass.fragment_shader_path),
+          pass.layer_mask);
+      depth_prepass_added_ = true;
+      break;
+    case PassType::kLightVolumes: {
+      uint32_t stencil_material_id =
+          register_material_({}, pass.vertex_shader_path,
+                             pass.stencil_fragment_shader_path);
+      uint32_t light_material_id = register_material_(
+          pass.input_textures, pass.vertex_shader_path,
+          pass.fragment_shader_path);
+      uint32_t depth_copy_material_id = register_material_(
+          {"depth_texture"}, pass.copy_vertex_shader_path,
+          pass.copy_fragment_shader_path);
+      pipeline_.add_light_volume_pass(
+          framebuffer_id, create_sphere_mesh_(), create_cone_mesh_(),
+          stencil_material_id, light_material_id, depth_copy_material_id,
+          create_quad_mesh_());
+      break;
+    }
+    case PassType::kShadows: {
+      const std::string& static_shadow_texture = pass.input_textures.front();
+      uint32_t caster_material_id = register_material_(
+          {}, pass.vertex_shader_path, pass.fragment_shader_path);
+      uint32_t copy_material_id = register_material_(
+          pass.input_textures, pass.copy_vertex_shader_path,
+          pass.copy_fragment_shader_path);
+      pipeline_.add_shadow_pass(
+          framebuffer_id, register_framebuffer_({static_shadow_texture}),
+          caster_material_id, copy_material_id, create_quad_mesh_(),
+          shadow_settings_);
+      break;
+    }
+  }
 }
 
 uint32_t PipelineGenerator::register_material_(
     const std::list<std::string>& input_textures,
     const std::string& vertex_shader_path,
-    const std::string& fragment_shader_path) {
-  ResourceManager::Id ambient_program_id_ = resource_manager_.load_gpu_program_from_file(
-      vertex_shader_path, fragment_shader_path);
-  std::uint32_t id = resource_manager_.create_material(ambient_program_id_);
+    const std::string& fragment_shader_path,
+    const std::string& fragment_shader_sources) {
+  ResourceManager::Id program_id;
+  if (fragment_shader_sources.empty()) {
+    program_id = resource_manager_.load_gpu_program_from_file(
+        vertex_shader_path, fragment_shader_path);
+  } else {
+    std::string vertex_shader_sources;
+    read_file(vertex_shader_path, vertex_shader_sources);
+    program_id = resource_manager_.load_gpu_program_from_sources(
+        vertex_shader_sources, fragment_shader_sources);
+  }
+  std::uint32_t id = resource_manager_.create_material(program_id);
   const render::Material& material = resource_manager_.get_material(id);
   render::AMaterial& gpu_material =
       gpu_resource_manager_.get_material(material.gpu_resource_id);
   int texture_unit = 0;
 
   for (auto& texture_name : input_textures) {
-    uint32_t texture_id = id_map_[texture_name];
-    const Texture& texture = resource_manager_.get_texture(texture_id);
-    gpu_material.register_texture_slot(texture_name, texture.gpu_resource_id,
+    uint32_t gpu_texture_id;
+    auto texture_buffer = texture_buffer_id_map_.find(texture_name);
+    if (texture_buffer != texture_buffer_id_map_.end()) {
+      gpu_texture_id = texture_buffer->second;
+    } else {
+      uint32_t texture_id = id_map_.at(texture_name);
+      const Texture& texture = resource_manager_.get_texture(texture_id);
+      gpu_texture_id = texture.gpu_resource_id;
+    }
+    gpu_material.register_texture_slot(texture_name, gpu_texture_id,
                                        texture_unit);
     texture_unit += 1;
   }
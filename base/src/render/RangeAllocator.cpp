@@ -0,0 +1,96 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "render/RangeAllocator.hpp"
+
+#include <algorithm>
+
+namespace donkey {
+namespace render {
+
+RangeAllocator::RangeAllocator() : size_(0) {}
+
+std::size_t RangeAllocator::allocate(std::size_t size,
+                                     std::size_t alignment) {
+  for (auto range = free_ranges_.begin(); range != free_ranges_.end();
+       ++range) {
+    std::size_t offset =
+        (range->offset + alignment - 1) / alignment * alignment;
+    std::size_t end = range->offset + range->size;
+    if (size == 0 || offset + size > end)
+      continue;
+    // What is left on either side of the allocation stays free.
+    Range before = {range->offset, offset - range->offset};
+    Range after = {offset + size, end - offset - size};
+    range = free_ranges_.erase(range);
+    if (after.size > 0)
+      range = free_ranges_.insert(range, after);
+    if (before.size > 0)
+      free_ranges_.insert(range, before);
+    return offset;
+  }
+  std::size_t offset = (size_ + alignment - 1) / alignment * alignment;
+  // Padding left by the alignment can still fit smaller ranges.
+  if (size > 0 && offset > size_)
+    free(size_, offset - size_);
+  size_ = std::max(size_, offset + size);
+  return offset;
+}
+
+void RangeAllocator::free(std::size_t offset, std::size_t size) {
+  if (size == 0)
+    return;
+  auto next = std::lower_bound(
+      free_ranges_.begin(), free_ranges_.end(), offset,
+      [](const Range& range, std::size_t offset) {
+        return range.offset < offset;
+      });
+  Range range = {offset, size};
+  if (next != free_ranges_.begin()) {
+    auto previous = next - 1;
+    if (previous->offset + previous->size == range.offset) {
+      range.offset = previous->offset;
+      range.size += previous->size;
+      next = free_ranges_.erase(previous);
+    }
+  }
+  if (next != free_ranges_.end() &&
+      range.offset + range.size == next->offset) {
+    range.size += next->size;
+    next = free_ranges_.erase(next);
+  }
+  if (range.offset + range.size == size_)
+    size_ = range.offset;
+  else
+    free_ranges_.insert(next, range);
+}
+
+void RangeAllocator::clear() {
+  free_ranges_.clear();
+  size_ = 0;
+}
+
+std::size_t RangeAllocator::get_size() const {
+  return size_;
+}
+
+std::size_t RangeAllocator::get_free_range_count() const {
+  return free_ranges_.size();
+}
+
+}  // namespace render
+}  // namespace donkey
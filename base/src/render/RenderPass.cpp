@@ -20,112 +20,91 @@
 namespace donkey {
 namespace render {
 
-static void bind_camera_uniforms_(CommandBucket& render_commands,
-                                  const Material& material,
-                                  const CameraNode& camera_node) {
-  render_commands.bind_uniform(material.view_location, camera_node.view);
-  render_commands.bind_uniform(material.projection_location,
-                               camera_node.projection);
+// Workaround annoying max macro defined somewhere in Windows headers.
+#if defined(max)
+#undef max
+#endif
+static uint32_t last_material_id_ = std::numeric_limits<uint32_t>::max();
+
+void bind_camera_block(CommandBucket& render_commands,
+                       const CameraNode& camera_node,
+                       const CameraNode* last_camera_node,
+                       const CameraNode& view_camera_node,
+                       int gbuffer_layout) {
+  CameraBlock block;
+  block.view = camera_node.view;
+  block.projection = camera_node.projection;
+  // bind some useful data related to the camera used during gbuffer pass
+  if (last_camera_node) {
+    block.gbuffer_view = last_camera_node->view;
+    block.gbuffer_projection_inverse =
+        glm::inverse(last_camera_node->projection);
+    block.gbuffer_projection_params =
+        glm::vec4(last_camera_node->near_plane, last_camera_node->far_plane,
+                  0.0f, 0.0f);
+  } else {
+    block.gbuffer_view = glm::mat4(1.0f);
+    block.gbuffer_projection_inverse = glm::mat4(1.0f);
+    block.gbuffer_projection_params = glm::vec4(0.0f);
+  }
+  // written by the gbuffer pass itself, which has no previous camera
+  block.gbuffer_projection_params.z = static_cast<float>(gbuffer_layout);
+  // camera position in view-space is always the origin
+  block.camera_position = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+  block.ambient = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+  block.viewport = glm::vec4(view_camera_node.viewport_position.x,
+                             view_camera_node.viewport_position.y,
+                             view_camera_node.viewport_size.x,
+                             view_camera_node.viewport_size.y);
+  render_commands.bind_uniform_block(UniformBlockBinding::kCamera, &block,
+                                     sizeof(block));
 }
 
-static void bind_light_uniforms_(CommandBucket& render_commands,
-                                 const Material& material,
-                                 const glm::mat4& view,
-                                 const DirectionalLightNode* light_node) {
-  // bind light infos
-  glm::mat4 rotate_x =
-      glm::rotate(glm::mat4(1.0f), glm::radians(light_node->angles.x),
-                  glm::vec3(1.0f, 0.0f, 0.0f));
-  glm::mat4 rotate_y = glm::rotate(rotate_x, glm::radians(light_node->angles.y),
-                                   glm::vec3(0.0f, 1.0f, 0.0f));
-  glm::mat4 rotate_z = glm::rotate(rotate_y, glm::radians(light_node->angles.z),
-                                   glm::vec3(0.0f, 0.0f, 1.0f));
-  glm::mat4 model = rotate_z * rotate_y * rotate_x;
-  glm::vec4 light_dir_shininess =
-      view * model * glm::vec4(0.0f, 0.0f, -1.0f, 0.0f);
-  light_dir_shininess.w = 10.0f;
-  render_commands.bind_uniform(material.light_dir_location,
-                               light_dir_shininess);
-  render_commands.bind_uniform(material.light_diffuse_location,
-                               light_node->diffuse);
-  render_commands.bind_uniform(material.light_specular_location,
-                               light_node->specular);
+static void bind_object_block_(CommandBucket& render_commands,
+                               const MeshNode& mesh_node) {
+  ObjectBlock block;
+  block.model = mesh_node.get_model_matrix();
+  block.draw_params = glm::ivec4(0);
+  render_commands.bind_uniform_block(UniformBlockBinding::kObject, &block,
+                                     sizeof(block));
 }
 
-static void bind_mesh_uniforms_(CommandBucket& render_commands,
-                                const Material& material,
-                                const MeshNode& mesh_node) {
-  // compute model matrix
-  glm::mat4 rotate_x =
-      glm::rotate(glm::mat4(1.0f), glm::radians(mesh_node.angles.x),
-                  glm::vec3(1.0f, 0.0f, 0.0f));
-  glm::mat4 rotate_y = glm::rotate(rotate_x, glm::radians(mesh_node.angles.y),
-                                   glm::vec3(0.0f, 1.0f, 0.0f));
-  glm::mat4 rotate_z = glm::rotate(rotate_y, glm::radians(mesh_node.angles.z),
-                                   glm::vec3(0.0f, 0.0f, 1.0f));
-  glm::mat4 translate = glm::translate(glm::mat4(1.0f), mesh_node.position);
-  glm::mat4 scale = glm::scale(glm::mat4(1.0f), mesh_node.scale);
-  glm::mat4 model = translate * rotate_z * rotate_y * rotate_x * scale;
-  render_commands.bind_uniform(material.model_location, model);
+void forget_bound_material() {
+  last_material_id_ = std::numeric_limits<uint32_t>::max();
 }
 
 void render_mesh_node(const RenderPass& render_pass,
                       const MeshNode& mesh_node,
-                      const CameraNode& camera_node,
-                      const CameraNode* last_camera_node,
-                      const DirectionalLightNode* light_node,
                       CommandBucket& render_commands,
                       ResourceManager* resource_manager,
                       GpuResourceManager* gpu_resource_manager) {
-  // Workaround annoying max macro defined somewhere in Windows headers.
-#if defined(max)
-#undef max
-#endif
-  static uint32_t last_material_id = std::numeric_limits<uint32_t>::max();
   const Mesh& mesh = resource_manager->get_mesh(mesh_node.mesh_id);
   const Material& material =
       resource_manager->get_material(mesh_node.material_id);
   const AMaterial& gpu_material =
       gpu_resource_manager->get_material(material.gpu_resource_id);
 
-  if (last_material_id != mesh_node.material_id) {
-    render_commands.bind_gpu_program(gpu_material.program_id);
-    gpu_material.bind_slots(render_commands);
-    last_material_id = mesh_node.material_id;
+  if (last_material_id_ != mesh_node.material_id) {
+    gpu_material.bind(material.gpu_resource_id, render_commands);
+    last_material_id_ = mesh_node.material_id;
   }
 
-  // bind built-in uniforms
-  bind_mesh_uniforms_(render_commands, material, mesh_node);
-  bind_camera_uniforms_(render_commands, material, camera_node);
-
-  // bind some useful data related to the camera used during gbuffer pass
-  if (last_camera_node) {
-    glm::mat4 projection_inverse = glm::inverse(last_camera_node->projection);
-    render_commands.bind_uniform(material.gbuffer_projection_inverse_location,
-                                 projection_inverse);
-    render_commands.bind_uniform(material.gbuffer_view_location,
-                                 last_camera_node->view);
-    render_commands.bind_uniform(
-        material.gbuffer_projection_params_location,
-        glm::vec2(last_camera_node->near_plane, last_camera_node->far_plane));
-    // camera position in view-space is always the origin
-    render_commands.bind_uniform(material.camera_position_location,
-                                 glm::vec3(0.0f));
-    render_commands.bind_uniform(material.ambient_location,
-                                 glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
-    if (light_node) {
-      bind_light_uniforms_(render_commands, material, last_camera_node->view,
-                           light_node);
-    }
-  }
+  // camera and light blocks are bound once per pass
+  bind_object_block_(render_commands, mesh_node);
 
   // bind geometry
-  render_commands.bind_mesh(mesh.gpu_resource_id, material.position_location,
+  uint32_t gpu_mesh_id = mesh.gpu_resource_id;
+  std::size_t index_count = mesh.index_count;
+  if (mesh_node.lod > 0 && mesh_node.lod <= mesh.lods.size()) {
+    gpu_mesh_id = mesh.lods[mesh_node.lod - 1].gpu_resource_id;
+    index_count = mesh.lods[mesh_node.lod - 1].index_count;
+  }
+  render_commands.bind_mesh(gpu_mesh_id, material.position_location,
                             material.normal_location, material.uv_location,
                             material.tangent_location,
                             material.bitangent_location);
 
-  render_commands.draw_elements(mesh.index_count);
+  render_commands.draw_elements(index_count);
 }
 
 }  // namespace render
@@ -0,0 +1,110 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "render/ResolutionScaler.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace donkey {
+namespace render {
+
+ResolutionScaler::ResolutionScaler(const Settings& settings)
+    : settings_(settings),
+      scale_(settings.max_scale),
+      frame_time_(0.0f),
+      settle_frame_count_(0) {
+  assert(settings.min_scale > 0.0f && settings.min_scale <= settings.max_scale);
+  assert(settings.step > 0.0f);
+}
+
+ResolutionScaler::Settings ResolutionScaler::make_default_settings() {
+  return {1000.0f / 60.0f, 0.5f, 1.0f, 0.05f, 8, 6};
+}
+
+void ResolutionScaler::set_settings(const Settings& settings) {
+  assert(settings.min_scale > 0.0f && settings.min_scale <= settings.max_scale);
+  assert(settings.step > 0.0f);
+  settings_ = settings;
+  scale_ = snap_(scale_);
+}
+
+const ResolutionScaler::Settings& ResolutionScaler::get_settings() const {
+  return settings_;
+}
+
+// Rounds down to a step, allowing for float noise.
+float ResolutionScaler::snap_(float scale) const {
+  scale = std::floor(scale / settings_.step + 1e-3f) * settings_.step;
+  return std::min(std::max(scale, settings_.min_scale), settings_.max_scale);
+}
+
+float ResolutionScaler::update(float gpu_frame_time, float cpu_frame_time) {
+  float frame_time = (gpu_frame_time > 0.0f) ? gpu_frame_time : cpu_frame_time;
+  if (frame_time <= 0.0f)
+    return scale_;
+  // Frames still drawn at the previous scale are left out.
+  if (settle_frame_count_ > 0) {
+    --settle_frame_count_;
+    return scale_;
+  }
+  if (frame_time_ == 0.0f) {
+    frame_time_ = frame_time;
+  } else {
+    std::size_t count =
+        std::max<std::size_t>(settings_.smoothing_frame_count, 1);
+    frame_time_ += (frame_time - frame_time_) / static_cast<float>(count);
+  }
+
+  // Frame time goes with the pixel count, the square of the scale.
+  float ideal_scale =
+      scale_ * std::sqrt(settings_.target_frame_time / frame_time_);
+  float scale = scale_;
+  if (frame_time_ > settings_.target_frame_time) {
+    // At least a step down, as far as needed at once.
+    scale = std::min(ideal_scale, scale_ - settings_.step);
+  } else if (ideal_scale >= scale_ + settings_.step) {
+    // A single step up, the larger scale fitting the budget.
+    scale = scale_ + settings_.step;
+  }
+  scale = snap_(scale);
+  if (scale != scale_) {
+    // What frames should take at the new scale, until they're measured.
+    frame_time_ *= (scale * scale) / (scale_ * scale_);
+    scale_ = scale;
+    settle_frame_count_ = settings_.settle_frame_count;
+  }
+  return scale_;
+}
+
+float ResolutionScaler::get_scale() const {
+  return scale_;
+}
+
+float ResolutionScaler::get_frame_time() const {
+  return frame_time_;
+}
+
+void ResolutionScaler::reset(float scale) {
+  scale_ = snap_(scale);
+  frame_time_ = 0.0f;
+  settle_frame_count_ = 0;
+}
+
+}  // namespace render
+}  // namespace donkey
@@ -15,8 +15,11 @@
  * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <cassert>
+#include <glm/glm.hpp>
 #include <iostream>
 #include <tuple>
+#include <vector>
 
 #if defined(MSVC)
 # pragma warning(push)
@@ -30,21 +33,7 @@
 #endif
 
 #include "render/ResourceManager.hpp"
-
-namespace std
-{
-  template<>
-  struct hash<std::tuple<std::string, std::string>>
-  {
-    std::size_t operator() (const std::tuple<std::string, std::string>& tuple) const noexcept
-      {
-        std::hash<std::string> hash {};
-        std::size_t h1 = hash(std::get<0>(tuple));
-        std::size_t h2 = hash(std::get<1>(tuple));
-        return h1 ^ (h2 << 1);
-      }
-  };
-}
+#include "render/image.hpp"
 
 namespace donkey {
 namespace render {
@@ -53,12 +42,11 @@ ResourceManager::ResourceManager(GpuResourceManager& gpu_resource_manager)
     : gpu_resource_manager_(gpu_resource_manager) {}
 
 const GpuProgram& ResourceManager::get_gpu_program(Id id) const {
-  return gpu_programs_.at(id);
+  return gpu_programs_[static_cast<uint32_t>(id)].program;
 }
 
 const Material& ResourceManager::get_material(uint32_t id) const {
   return materials_[id];
-  ;
 }
 
 const Mesh& ResourceManager::get_mesh(uint32_t id) const {
@@ -82,39 +70,48 @@ void ResourceManager::cleanup() {
 
 uint32_t ResourceManager::load_texture_from_file(const std::string& path) {
   std::cout << "Loading texture from file: " << path << '\n';
-  SDL_Surface* original_surface = IMG_Load(path.c_str());
-  SDL_Surface* img_surface =
-      SDL_ConvertSurfaceFormat(original_surface, SDL_PIXELFORMAT_RGBA32, 0);
-  SDL_FreeSurface(original_surface);
-  SDL_Surface* mirror_surface = create_mirror_surface_(img_surface);
-  uint32_t id = load_texture_from_memory(
-      reinterpret_cast<uint8_t*>(mirror_surface->pixels), mirror_surface->w,
-      mirror_surface->h);
-  SDL_FreeSurface(img_surface);
-  SDL_FreeSurface(mirror_surface);
-  return id;
-}
+  SDL_Surface* surface = IMG_Load(path.c_str());
+  if (!surface) {
+    std::cerr << "Can't load image: " << IMG_GetError() << '\n';
+    assert(false);
+  }
 
-SDL_Surface* ResourceManager::create_mirror_surface_(SDL_Surface* surface) {
+  uint32_t id;
+  image::Layout layout;
   int width = surface->w;
   int height = surface->h;
-  SDL_Surface* new_surface = SDL_CreateRGBSurfaceWithFormat(
-      0, width, height, 32, SDL_PIXELFORMAT_RGBA32);
-  uint32_t* src_pixels = reinterpret_cast<uint32_t*>(surface->pixels);
-  uint32_t* dst_pixels = reinterpret_cast<uint32_t*>(new_surface->pixels);
-
-  SDL_LockSurface(new_surface);
-  SDL_LockSurface(surface);
-  for (size_t y = 0; y < height; ++y) {
-    for (size_t x = 0; x < width; ++x) {
-      uint32_t* src_ptr = src_pixels + y * width + x;
-      uint32_t* dst_ptr = dst_pixels + ((height - y - 1) * width) + x;
-      *dst_ptr = *src_ptr;
+  if (image::get_layout(surface->format->format, layout)) {
+    SDL_LockSurface(surface);
+    uint8_t* pixels = static_cast<uint8_t*>(surface->pixels);
+    std::size_t pitch = static_cast<std::size_t>(surface->pitch);
+    if (image::get_pixel_size(layout) == 4 &&
+        pitch == static_cast<std::size_t>(width) * 4) {
+      // Convert and mirror in place, then upload straight from the decoded
+      // buffer.
+      image::convert_to_rgba_in_place(pixels, pitch, width, height, layout);
+      id = load_texture_from_memory(pixels, width, height);
+    } else {
+      std::vector<uint8_t> rgba_pixels(static_cast<std::size_t>(width) *
+                                       height * 4);
+      image::convert_to_rgba(pixels, pitch, layout, rgba_pixels.data(), width,
+                             height);
+      id = load_texture_from_memory(rgba_pixels.data(), width, height);
     }
+    SDL_UnlockSurface(surface);
+  } else {
+    // Palettized and other exotic formats go through SDL's generic blitter.
+    SDL_Surface* rgba_surface =
+        SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_RGBA32, 0);
+    SDL_LockSurface(rgba_surface);
+    uint8_t* pixels = static_cast<uint8_t*>(rgba_surface->pixels);
+    image::flip_vertically(pixels, static_cast<std::size_t>(width) * 4,
+                           rgba_surface->pitch, height);
+    id = load_texture_from_memory(pixels, width, height);
+    SDL_UnlockSurface(rgba_surface);
+    SDL_FreeSurface(rgba_surface);
   }
-  SDL_UnlockSurface(surface);
-  SDL_UnlockSurface(new_surface);
-  return new_surface;
+  SDL_FreeSurface(surface);
+  return id;
 }
 
 uint32_t ResourceManager::load_texture_from_memory(uint8_t* pixels,
@@ -122,44 +119,49 @@ uint32_t ResourceManager::load_texture_from_memory(uint8_t* pixels,
                                                    int height) {
   uint32_t id =
       gpu_resource_manager_.load_texture_from_memory(pixels, width, height);
-  textures_.push_back(Texture(id, pixel::Format::kRGBA,
-                              pixel::InternalFormat::kRGBA8,
-                              pixel::ComponentType::kByte));
-  return static_cast<uint32_t>(textures_.size()) - 1;
+  return textures_.insert(Texture(id, pixel::Format::kRGBA,
+                                  pixel::InternalFormat::kRGBA8,
+                                  pixel::ComponentType::kByte));
 }
 
 ResourceManager::Id ResourceManager::load_gpu_program_from_file(
     const std::string& vs_path,
     const std::string& fs_path) {
-  using Key = std::tuple<std::string, std::string>;
-  std::hash<Key> hash {};
-  size_t final_id = hash(std::make_tuple(vs_path, fs_path));
-  if (gpu_programs_.find(final_id) == gpu_programs_.end())
-  {
-    std::uint32_t id =
-      gpu_resource_manager_.load_gpu_program_from_file(vs_path, fs_path);
-    gpu_programs_.emplace(std::make_pair(final_id, GpuProgram(id)));
-  }
-  return final_id;
+  return load_gpu_program_(ProgramKey(false, vs_path, fs_path));
+}
+
+ResourceManager::Id ResourceManager::load_gpu_program_from_sources(
+    const std::string& vs_sources,
+    const std::string& fs_sources) {
+  return load_gpu_program_(ProgramKey(true, vs_sources, fs_sources));
+}
+
+// Programs are told apart by their full paths or sources, not by a hash of
+// them.
+ResourceManager::Id ResourceManager::load_gpu_program_(const ProgramKey& key) {
+  auto result = program_ids_.emplace(key, 0);
+  if (!result.second)
+    return result.first->second;
+  const std::string& vs = std::get<1>(key);
+  const std::string& fs = std::get<2>(key);
+  uint32_t gpu_resource_id =
+      std::get<0>(key)
+          ? gpu_resource_manager_.load_gpu_program_from_sources(vs, fs)
+          : gpu_resource_manager_.load_gpu_program_from_file(vs, fs);
+  result.first->second =
+      gpu_programs_.insert({GpuProgram(gpu_resource_id), result.first});
+  return result.first->second;
 }
 
 uint32_t ResourceManager::create_material(Id cpu_side_gpu_program_id) {
-  const GpuProgram& cpu_side_gpu_program = gpu_programs_.at(cpu_side_gpu_program_id);
+  const GpuProgram& cpu_side_gpu_program =
+      get_gpu_program(cpu_side_gpu_program_id);
   std::uint32_t gpu_program_id = gpu_resource_manager_.create_material(cpu_side_gpu_program.gpu_resource_id);
   const AMaterial& gpu_material = gpu_resource_manager_.get_material(gpu_program_id);
-  materials_.push_back(Material(
+  return materials_.insert(Material(
       gpu_program_id, cpu_side_gpu_program_id, gpu_material.position_location,
       gpu_material.normal_location, gpu_material.uv_location,
-      gpu_material.tangent_location, gpu_material.bitangent_location,
-      gpu_material.model_location, gpu_material.view_location,
-      gpu_material.projection_location,
-      gpu_material.gbuffer_projection_inverse_location,
-      gpu_material.gbuffer_projection_params_location,
-      gpu_material.gbuffer_view_location, gpu_material.ambient_location,
-      gpu_material.light_dir_location, gpu_material.light_diffuse_location,
-      gpu_material.light_specular_location,
-      gpu_material.camera_position_location));
-  return static_cast<uint32_t>(materials_.size()) - 1;
+      gpu_material.tangent_location, gpu_material.bitangent_location));
 }
 
 uint32_t ResourceManager::create_mesh(const std::vector<float>& positions,
@@ -170,8 +172,51 @@ uint32_t ResourceManager::create_mesh(const std::vector<float>& positions,
                                       const std::vector<uint32_t>& indices) {
   uint32_t id = gpu_resource_manager_.create_mesh(
       positions, normals, uvs, tangents, bitangents, indices);
-  meshes_.push_back(Mesh(id, indices.size()));
-  return static_cast<uint32_t>(meshes_.size()) - 1;
+  glm::vec3 min(0.0f);
+  glm::vec3 max(0.0f);
+  for (std::size_t i = 0; i + 2 < positions.size(); i += 3) {
+    glm::vec3 position(positions[i], positions[i + 1], positions[i + 2]);
+    min = (i == 0) ? position : glm::min(min, position);
+    max = (i == 0) ? position : glm::max(max, position);
+  }
+  return meshes_.insert(Mesh(id, indices.size(), min, max));
+}
+
+void ResourceManager::add_lod(uint32_t mesh_id,
+                              const std::vector<float>& positions,
+                              const std::vector<float>& normals,
+                              const std::vector<float>& uvs,
+                              const std::vector<float>& tangents,
+                              const std::vector<float>& bitangents,
+                              const std::vector<uint32_t>& indices,
+                              float error) {
+  Mesh& mesh = meshes_[mesh_id];
+  if (!mesh.lods.empty() && error < mesh.lods.back().error) {
+    std::cerr << "LODs must be added from the finest to the coarsest\n";
+    assert(false);
+  }
+  uint32_t id = gpu_resource_manager_.create_mesh(
+      positions, normals, uvs, tangents, bitangents, indices);
+  mesh.lods.push_back({id, indices.size(), error});
+}
+
+void ResourceManager::set_occluder(uint32_t mesh_id,
+                                   const std::vector<float>& positions,
+                                   const std::vector<uint32_t>& indices) {
+  assert(indices.size() % 3 == 0);
+  Mesh& mesh = meshes_[mesh_id];
+  mesh.occluder_positions.clear();
+  for (std::size_t i = 0; i + 2 < positions.size(); i += 3) {
+    mesh.occluder_positions.push_back(
+        glm::vec3(positions[i], positions[i + 1], positions[i + 2]));
+  }
+  for (uint32_t index : indices) {
+    if (index >= mesh.occluder_positions.size()) {
+      std::cerr << "Occluder index out of range: " << index << '\n';
+      assert(false);
+    }
+  }
+  mesh.occluder_indices = indices;
 }
 
 uint32_t ResourceManager::create_texture(std::size_t width,
@@ -181,14 +226,43 @@ uint32_t ResourceManager::create_texture(std::size_t width,
                                          pixel::ComponentType component_type) {
   uint32_t id = gpu_resource_manager_.create_texture(
       width, height, format, internal_format, component_type);
-  textures_.push_back(Texture(id, format, internal_format, component_type));
-  return static_cast<uint32_t>(textures_.size()) - 1;
+  return textures_.insert(
+      Texture(id, format, internal_format, component_type));
 }
 
 uint32_t ResourceManager::create_state(const State& state) {
   uint32_t id = gpu_resource_manager_.create_state(state);
-  states_.push_back(State(id, state));
-  return static_cast<uint32_t>(states_.size()) - 1;
+  return states_.insert(State(id, state));
+}
+
+void ResourceManager::destroy_gpu_program(Id id) {
+  Program& program = gpu_programs_[static_cast<uint32_t>(id)];
+  gpu_resource_manager_.destroy_gpu_program(program.program.gpu_resource_id);
+  program_ids_.erase(program.key);
+  gpu_programs_.erase(static_cast<uint32_t>(id));
+}
+
+void ResourceManager::destroy_material(uint32_t id) {
+  gpu_resource_manager_.destroy_material(materials_[id].gpu_resource_id);
+  materials_.erase(id);
+}
+
+void ResourceManager::destroy_mesh(uint32_t id) {
+  const Mesh& mesh = meshes_[id];
+  gpu_resource_manager_.destroy_mesh(mesh.gpu_resource_id);
+  for (const Mesh::Lod& lod : mesh.lods)
+    gpu_resource_manager_.destroy_mesh(lod.gpu_resource_id);
+  meshes_.erase(id);
+}
+
+void ResourceManager::destroy_texture(uint32_t id) {
+  gpu_resource_manager_.destroy_texture(textures_[id].gpu_resource_id);
+  textures_.erase(id);
+}
+
+void ResourceManager::destroy_state(uint32_t id) {
+  gpu_resource_manager_.destroy_state(states_[id].gpu_resource_id);
+  states_.erase(id);
 }
 
 }  // namespace render
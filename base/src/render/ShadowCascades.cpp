@@ -0,0 +1,229 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "render/ShadowCascades.hpp"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/vec4.hpp>
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace donkey {
+namespace render {
+
+ShadowCascades::ShadowCascades(const Settings& settings)
+    : settings_(settings),
+      static_casters_(nullptr),
+      static_change_count_(0),
+      light_view_(1.0f),
+      cache_valid_(false),
+      enabled_(false),
+      statistics_() {
+  assert(settings.cascade_count >= 0 &&
+         settings.cascade_count <= kMaxCascadeCount);
+  for (Cascade& cascade : cascades_) {
+    cascade.projection = glm::mat4(1.0f);
+    cascade.split = 0.0f;
+    cascade.dirty = false;
+    cascade.static_dirty = false;
+  }
+  cached_projections_.fill(glm::mat4(1.0f));
+  had_dynamic_casters_.fill(false);
+}
+
+ShadowCascades::Settings ShadowCascades::make_settings(Quality quality) {
+  Settings settings = {0, 0, 0.0f, 0.0f, 0.0f, 0.0f, false, true,
+                       ::donkey::SceneNode::kAllLayers};
+  switch (quality) {
+    case Quality::kOff:
+      break;
+    case Quality::kLow:
+      settings.cascade_count = 2;
+      settings.resolution = 1024;
+      settings.distance = 50.0f;
+      settings.split_lambda = 0.75f;
+      settings.caster_distance = 50.0f;
+      settings.depth_bias = 0.002f;
+      break;
+    case Quality::kMedium:
+      settings.cascade_count = 3;
+      settings.resolution = 2048;
+      settings.distance = 100.0f;
+      settings.split_lambda = 0.75f;
+      settings.caster_distance = 100.0f;
+      settings.depth_bias = 0.001f;
+      settings.filtered = true;
+      break;
+    case Quality::kHigh:
+      settings.cascade_count = 4;
+      settings.resolution = 2048;
+      settings.distance = 200.0f;
+      settings.split_lambda = 0.8f;
+      settings.caster_distance = 200.0f;
+      settings.depth_bias = 0.0005f;
+      settings.filtered = true;
+      break;
+  }
+  return settings;
+}
+
+void ShadowCascades::set_settings(const Settings& settings) {
+  assert(settings.cascade_count >= 0 &&
+         settings.cascade_count <= kMaxCascadeCount);
+  // Cascades change size with most settings, and the cache isn't kept up
+  // without caching.
+  settings_ = settings;
+  cache_valid_ = false;
+}
+
+const ShadowCascades::Settings& ShadowCascades::get_settings() const {
+  return settings_;
+}
+
+void ShadowCascades::set_static_casters(const StaticMeshSet* static_casters) {
+  static_casters_ = static_casters;
+  invalidate();
+}
+
+void ShadowCascades::invalidate() {
+  cache_valid_ = false;
+}
+
+int ShadowCascades::get_snap_texel_count_() const {
+  if (!settings_.cache_static_casters)
+    return 1;
+  return std::max(1, std::min<int>(kSnapTexelCount, settings_.resolution / 8));
+}
+
+void ShadowCascades::fit_cascade_(const CameraNode& camera_node,
+                                  float near_split,
+                                  float far_split,
+                                  Cascade& cascade) const {
+  // Corners of the view's frustum, then of the slice along its edges, where
+  // view depth changes linearly.
+  glm::mat4 inverse = glm::inverse(camera_node.projection * camera_node.view);
+  std::array<glm::vec3, 8> corners;
+  for (int corner = 0; corner < 8; ++corner) {
+    glm::vec4 position =
+        inverse * glm::vec4((corner & 1) ? 1.0f : -1.0f,
+                            (corner & 2) ? 1.0f : -1.0f,
+                            (corner & 4) ? 1.0f : -1.0f, 1.0f);
+    corners[corner] = glm::vec3(position) / position.w;
+  }
+  float near_depth =
+      -(camera_node.view * glm::vec4(corners[0], 1.0f)).z;
+  float far_depth = -(camera_node.view * glm::vec4(corners[4], 1.0f)).z;
+  float depth_range = std::max(far_depth - near_depth, 1e-6f);
+  float t0 = (near_split - near_depth) / depth_range;
+  float t1 = (far_split - near_depth) / depth_range;
+  std::array<glm::vec3, 8> slice;
+  glm::vec3 center(0.0f);
+  for (int edge = 0; edge < 4; ++edge) {
+    glm::vec3 offset = corners[edge + 4] - corners[edge];
+    slice[edge] = corners[edge] + offset * t0;
+    slice[edge + 4] = corners[edge] + offset * t1;
+    center += slice[edge] + slice[edge + 4];
+  }
+  center /= 8.0f;
+  float radius = 0.0f;
+  for (const glm::vec3& corner : slice)
+    radius = std::max(radius, glm::length(corner - center));
+  // Rounded so that float noise doesn't change the cascade's size.
+  radius = std::ceil(radius * 16.0f) / 16.0f;
+
+  // Whole texels in light space, the cascade being large enough to cover
+  // the sphere wherever it lies within a step.
+  int snap_texel_count = get_snap_texel_count_();
+  float texel_size =
+      2.0f * radius / (settings_.resolution - 2 * snap_texel_count);
+  float half_size = texel_size * settings_.resolution * 0.5f;
+  float step = texel_size * snap_texel_count;
+  glm::vec3 light_center = glm::vec3(light_view_ * glm::vec4(center, 1.0f));
+  light_center = glm::floor(light_center / step) * step;
+  // The light looks along -z, casters lie on the +z side.
+  float depth = -light_center.z;
+  cascade.projection = glm::orthoRH(
+      light_center.x - half_size, light_center.x + half_size,
+      light_center.y - half_size, light_center.y + half_size,
+      depth - half_size - settings_.caster_distance, depth + half_size);
+}
+
+int ShadowCascades::get_cascade_count() const {
+  return enabled_ ? settings_.cascade_count : 0;
+}
+
+const ShadowCascades::Cascade& ShadowCascades::get_cascade(
+    int cascade) const {
+  return cascades_[cascade];
+}
+
+const glm::mat4& ShadowCascades::get_light_view() const {
+  return light_view_;
+}
+
+const StaticMeshSet* ShadowCascades::get_static_casters() const {
+  return static_casters_;
+}
+
+glm::tvec2<int> ShadowCascades::get_viewport_position(int cascade) const {
+  return glm::tvec2<int>(cascade * settings_.resolution, 0);
+}
+
+glm::tvec2<GLsizei> ShadowCascades::get_viewport_size() const {
+  return glm::tvec2<GLsizei>(settings_.resolution, settings_.resolution);
+}
+
+ShadowBlock ShadowCascades::make_shadow_block(
+    const CameraNode& camera_node) const {
+  ShadowBlock block = {};
+  int cascade_count = get_cascade_count();
+  if (cascade_count == 0)
+    return block;
+  glm::mat4 inverse_view = glm::inverse(camera_node.view);
+  float count = static_cast<float>(cascade_count);
+  for (int i = 0; i < cascade_count; ++i) {
+    // Clip space to uv and depth, into the cascade's square of the atlas.
+    glm::mat4 to_atlas =
+        glm::translate(glm::mat4(1.0f),
+                       glm::vec3((0.5f + i) / count, 0.5f, 0.5f)) *
+        glm::scale(glm::mat4(1.0f), glm::vec3(0.5f / count, 0.5f, 0.5f));
+    block.cascade_matrices[i] =
+        to_atlas * cascades_[i].projection * light_view_ * inverse_view;
+    block.cascade_splits[i] = cascades_[i].split;
+  }
+  block.shadow_params =
+      glm::vec4(count, settings_.depth_bias,
+                1.0f / (static_cast<float>(settings_.resolution) * count),
+                settings_.filtered ? 1.0f : 0.0f);
+  return block;
+}
+
+const ShadowCascades::Statistics& ShadowCascades::get_statistics() const {
+  return statistics_;
+}
+
+glm::mat4 ShadowCascades::make_light_view(const glm::vec3& direction) {
+  glm::vec3 up(0.0f, 1.0f, 0.0f);
+  if (std::abs(direction.y) > 0.99f)
+    up = glm::vec3(1.0f, 0.0f, 0.0f);
+  return glm::lookAtRH(glm::vec3(0.0f), direction, up);
+}
+
+}  // namespace render
+}  // namespace donkey
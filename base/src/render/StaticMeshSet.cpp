@@ -0,0 +1,90 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "render/StaticMeshSet.hpp"
+
+#include <cassert>
+
+namespace donkey {
+namespace render {
+
+StaticMeshSet::StaticMeshSet() : culled_count_(0), change_count_(0) {}
+
+void StaticMeshSet::add(const MeshNode& mesh_node, const Aabb& box) {
+  assert(indices_.find(mesh_node.id) == indices_.end());
+  uint32_t index = static_cast<uint32_t>(mesh_nodes_.size());
+  indices_[mesh_node.id] = index;
+  mesh_nodes_.push_back(mesh_node);
+  boxes_.push_back(box);
+  bvh_.insert(index, box);
+  ++change_count_;
+}
+
+void StaticMeshSet::remove(uint32_t id) {
+  auto it = indices_.find(id);
+  assert(it != indices_.end());
+  std::size_t index = it->second;
+  indices_.erase(it);
+  bvh_.remove(static_cast<uint32_t>(index));
+  std::size_t last = mesh_nodes_.size() - 1;
+  if (index < last) {
+    mesh_nodes_[index] = mesh_nodes_[last];
+    boxes_[index] = boxes_[last];
+    indices_[mesh_nodes_[index].id] = index;
+    bvh_.remove(static_cast<uint32_t>(last));
+    bvh_.insert(static_cast<uint32_t>(index), boxes_[index]);
+  }
+  mesh_nodes_.pop_back();
+  boxes_.pop_back();
+  ++change_count_;
+}
+
+void StaticMeshSet::clear() {
+  mesh_nodes_.clear();
+  boxes_.clear();
+  indices_.clear();
+  bvh_.clear();
+  culled_count_ = 0;
+  ++change_count_;
+}
+
+const std::vector<MeshNode>& StaticMeshSet::get_mesh_nodes() const {
+  return mesh_nodes_;
+}
+
+bool StaticMeshSet::contains(uint32_t id) const {
+  return indices_.find(id) != indices_.end();
+}
+
+const Bvh& StaticMeshSet::get_bvh() const {
+  return bvh_;
+}
+
+std::size_t StaticMeshSet::size() const {
+  return mesh_nodes_.size();
+}
+
+std::size_t StaticMeshSet::get_culled_count() const {
+  return culled_count_;
+}
+
+uint64_t StaticMeshSet::get_change_count() const {
+  return change_count_;
+}
+
+}  // namespace render
+}  // namespace donkey
@@ -28,7 +28,7 @@ TextureMaterialSlot::TextureMaterialSlot(int location,
                                          int texture_unit)
     : location(location), texture_id(texture_id), texture_unit(texture_unit) {}
 
-void TextureMaterialSlot::bind(CommandBucket& render_commands) {
+void TextureMaterialSlot::bind(CommandBucket& render_commands) const {
   render_commands.bind_texture(location, texture_unit, texture_id);
 }
 
@@ -0,0 +1,75 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "render/ViewCulling.hpp"
+
+#include <glm/glm.hpp>
+#include <cassert>
+
+namespace donkey {
+namespace render {
+
+ViewCulling::ViewCulling() : statistics_() {}
+
+void ViewCulling::begin(const StackVector<CameraNode>& camera_nodes) {
+  assert(camera_nodes.size() <= kMaxViewCount);
+  frustums_.clear();
+  union_box_ = Aabb();
+  for (const CameraNode& camera_node : camera_nodes) {
+    glm::mat4 view_projection = camera_node.projection * camera_node.view;
+    frustums_.emplace_back(view_projection);
+    // The corners of clip space's cube, back in world space.
+    glm::mat4 inverse = glm::inverse(view_projection);
+    for (int corner = 0; corner < 8; ++corner) {
+      glm::vec4 position =
+          inverse * glm::vec4((corner & 1) ? 1.0f : -1.0f,
+                              (corner & 2) ? 1.0f : -1.0f,
+                              (corner & 4) ? 1.0f : -1.0f, 1.0f);
+      union_box_.extend(glm::vec3(position) / position.w);
+    }
+  }
+  statistics_ = Statistics();
+  statistics_.view_count = camera_nodes.size();
+}
+
+uint32_t ViewCulling::test(const Aabb& box) {
+  ++statistics_.tested_count;
+  if (!union_box_.intersects(box)) {
+    ++statistics_.union_culled_count;
+    return 0;
+  }
+  uint32_t view_mask = 0;
+  for (std::size_t view = 0; view < frustums_.size(); ++view) {
+    if (frustums_[view].intersects(box))
+      view_mask |= 1u << view;
+    else
+      ++statistics_.view_culled_count;
+  }
+  statistics_.view_tested_count += frustums_.size();
+  return view_mask;
+}
+
+uint32_t ViewCulling::get_view_mask(std::size_t node_index) const {
+  return view_masks_[node_index];
+}
+
+const ViewCulling::Statistics& ViewCulling::get_statistics() const {
+  return statistics_;
+}
+
+}  // namespace render
+}  // namespace donkey
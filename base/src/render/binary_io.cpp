@@ -0,0 +1,61 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "render/binary_io.hpp"
+
+namespace donkey {
+namespace render {
+namespace binary_io {
+
+void write_bytes(std::ostream& out, const void* data, std::size_t size) {
+  out.write(static_cast<const char*>(data),
+            static_cast<std::streamsize>(size));
+}
+
+bool read_bytes(std::istream& in, void* data, std::size_t size) {
+  in.read(static_cast<char*>(data), static_cast<std::streamsize>(size));
+  return static_cast<bool>(in);
+}
+
+bool has_bytes(std::istream& in, uint64_t size) {
+  std::istream::pos_type position = in.tellg();
+  if (position == std::istream::pos_type(-1))
+    return in && size <= kMaxUncheckedSize;
+  in.seekg(0, std::ios::end);
+  std::istream::pos_type end = in.tellg();
+  in.seekg(position);
+  if (end == std::istream::pos_type(-1) || !in)
+    return false;
+  return size <= static_cast<uint64_t>(end - position);
+}
+
+void write_string(std::ostream& out, const std::string& string) {
+  write(out, static_cast<uint32_t>(string.size()));
+  write_bytes(out, string.data(), string.size());
+}
+
+bool read_string(std::istream& in, std::string& string) {
+  uint32_t size;
+  if (!read(in, size) || !has_bytes(in, size))
+    return false;
+  string.resize(size);
+  return read_bytes(in, &string[0], size);
+}
+
+}  // namespace binary_io
+}  // namespace render
+}  // namespace donkey
@@ -17,6 +17,7 @@
 
 #include "render/gl/Driver.hpp"
 
+#include <algorithm>
 #include <array>
 #include <iostream>
 
@@ -30,7 +31,7 @@ namespace gl {
 
 using namespace std::placeholders;
 
-Driver::Driver()
+Driver::Driver(const std::string& program_cache_directory)
     : render_functions_({std::bind(&Driver::bind_mesh_, this, _1),
                          std::bind(&Driver::draw_elements_, this, _1),
                          std::bind(&Driver::bind_uniform_float_, this, _1),
@@ -48,10 +49,43 @@ Driver::Driver()
                          std::bind(&Driver::clear_framebuffer_, this, _1),
                          std::bind(&Driver::bind_gpu_program_, this, _1),
                          std::bind(&Driver::set_blending_, this, _1),
-                         std::bind(&Driver::set_state_, this, _1)}) {
+                         std::bind(&Driver::set_state_, this, _1),
+                         std::bind(&Driver::bind_uniform_block_, this, _1),
+                         std::bind(&Driver::bind_material_parameters_, this,
+                                   _1),
+                         std::bind(&Driver::update_texture_buffer_, this,
+                                   _1),
+                         std::bind(&Driver::count_samples_, this, _1),
+                         std::bind(&Driver::multi_draw_elements_, this, _1)}),
+      resource_manager_(program_cache_directory),
+      sample_query_index_(0),
+      samples_passed_(0),
+      timer_query_index_(0),
+      gpu_frame_time_(0.0f),
+      multi_draw_supported_(false),
+      window_framebuffer_(0),
+      viewport_{0, 0, 0, 0},
+      scissor_box_{0, 0, 0, 0},
+      scissor_test_enabled_(false),
+      program_(nullptr),
+      mesh_(nullptr),
+      draw_call_count_(0),
+      last_draw_call_count_(0) {
   assert(gl3wInit() == 0);
   assert(gl3wIsSupported(4, 1) != 0);
+  multi_draw_supported_ = (gl3wIsSupported(4, 3) != 0);
   output_debug_info_();
+  uniform_ring_ = new UniformRing(kUniformFrameSize);
+  glGenQueries(kSampleQueryCount, sample_queries_.data());
+  sample_queries_pending_.fill(false);
+  glGenQueries(kTimerQueryCount, timer_queries_.data());
+  timer_queries_pending_.fill(false);
+}
+
+Driver::~Driver() {
+  glDeleteQueries(kSampleQueryCount, sample_queries_.data());
+  glDeleteQueries(kTimerQueryCount, timer_queries_.data());
+  delete uniform_ring_;
 }
 
 void Driver::output_debug_info_() const {
@@ -62,56 +96,111 @@ void Driver::output_debug_info_() const {
             << glGetString(GL_SHADING_LANGUAGE_VERSION) << '\n';
 }
 
+uint64_t Driver::get_samples_passed() const {
+  return samples_passed_;
+}
+
+std::size_t Driver::get_draw_call_count() const {
+  return last_draw_call_count_;
+}
+
+float Driver::get_gpu_frame_time() const {
+  return gpu_frame_time_;
+}
+
+void Driver::set_window_framebuffer(GLuint framebuffer) {
+  window_framebuffer_ = framebuffer;
+}
+
+UniformStorage Driver::begin_frame() {
+  UniformStorage storage = uniform_ring_->begin_frame();
+  // The ring just waited for the oldest frame still in flight, so only the
+  // ones after it may still use what was destroyed.
+  resource_manager_.release_retired(UniformRing::kFrameCount - 1);
+  return storage;
+}
+
 void Driver::execute_commands(const CommandBucket& commands) {
+  uniform_ring_->flush();
+  const std::vector<uint8_t>& overflow = commands.get_uniform_overflow();
+  if (!overflow.empty()) {
+    uniform_ring_->grow(commands.get_uniform_storage_size(), overflow.data(),
+                        overflow.size());
+  }
+  // Programs and meshes may have been created since the last frame.
+  program_ = nullptr;
+  mesh_ = nullptr;
+  draw_call_count_ = 0;
+  begin_timer_query_();
   for (auto sorted_command : commands.get_commands()) {
     size_t command_type = sorted_command.sort_key & kCommandTypeMask;
     RenderFunction f = render_functions_[command_type];
     (f)(sorted_command.command);
   }
+  end_timer_query_();
+  last_draw_call_count_ = draw_call_count_;
+  uniform_ring_->end_frame();
+  resource_manager_.end_frame();
+}
+
+// Like sample counts, a result that isn't there yet is dropped rather than
+// waited for.
+void Driver::begin_timer_query_() {
+  GLuint query = timer_queries_[timer_query_index_];
+  if (timer_queries_pending_[timer_query_index_]) {
+    GLuint available = GL_FALSE;
+    glGetQueryObjectuiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (available == GL_TRUE) {
+      GLuint64 nanoseconds;
+      glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds);
+      gpu_frame_time_ = static_cast<float>(nanoseconds) * 1e-6f;
+    }
+    timer_queries_pending_[timer_query_index_] = false;
+  }
+  glBeginQuery(GL_TIME_ELAPSED, query);
+}
+
+void Driver::end_timer_query_() {
+  glEndQuery(GL_TIME_ELAPSED);
+  timer_queries_pending_[timer_query_index_] = true;
+  timer_query_index_ = (timer_query_index_ + 1) % kTimerQueryCount;
 }
 
 void Driver::bind_mesh_(const Command& command) {
   assert(command.type == Command::Type::kBindMesh);
   const BindMeshCommand& bind_command =
       static_cast<const BindMeshCommand&>(command);
-  const Mesh& mesh = resource_manager_.get_mesh(bind_command.mesh_id);
-  unsigned int position_location = bind_command.position_location;
-  unsigned int normal_location = bind_command.normal_location;
-  unsigned int uv_location = bind_command.uv_location;
-  unsigned int tangent_location = bind_command.tangent_location;
-
-  glBindVertexArray(mesh.vertex_array);
-  // vertex positions
-  glBindBuffer(GL_ARRAY_BUFFER, mesh.position_buffer);
-  glVertexAttribPointer(position_location, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
-  glEnableVertexAttribArray(position_location);
-  // vertex normals
-  glBindBuffer(GL_ARRAY_BUFFER, mesh.normal_buffer);
-  glVertexAttribPointer(normal_location, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
-  glEnableVertexAttribArray(normal_location);
-  // vertex UVs
-  glBindBuffer(GL_ARRAY_BUFFER, mesh.uv_buffer);
-  glVertexAttribPointer(uv_location, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
-  glEnableVertexAttribArray(uv_location);
-  // vertex tangents
-  glBindBuffer(GL_ARRAY_BUFFER, mesh.tangent_buffer);
-  glVertexAttribPointer(tangent_location, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
-  glEnableVertexAttribArray(tangent_location);
-  // vertex bitangents
-  // glBindBuffer(GL_ARRAY_BUFFER, mesh.bitangent_buffer);
-  // glVertexAttribPointer(bitangent_location, 3, GL_FLOAT, GL_FALSE, 0,
-  //    nullptr);
-  // glEnableVertexAttribArray(bitangent_location);
-  // indices
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.index_buffer);
+  mesh_ = &resource_manager_.get_mesh(bind_command.mesh_id);
+  // Every mesh lives in the same buffers, the vertex array only changes
+  // with the attribute locations of the program.
+  MeshBuffer::Locations locations;
+  locations[MeshBuffer::kPositionStream] =
+      static_cast<GLint>(bind_command.position_location);
+  locations[MeshBuffer::kNormalStream] =
+      static_cast<GLint>(bind_command.normal_location);
+  locations[MeshBuffer::kUvStream] =
+      static_cast<GLint>(bind_command.uv_location);
+  locations[MeshBuffer::kTangentStream] =
+      static_cast<GLint>(bind_command.tangent_location);
+  locations[MeshBuffer::kDrawIdSlot] = -1;
+  // Without multi-draws, the draw ID is a constant attribute set per draw.
+  if (multi_draw_supported_ && program_)
+    locations[MeshBuffer::kDrawIdSlot] =
+        program_->get_attribute_location(name_id::kDrawId);
+  resource_manager_.get_mesh_buffer().bind(locations);
 }
 
 void Driver::draw_elements_(const Command& command) {
   assert(command.type == Command::Type::kDrawElements);
   const DrawElementsCommand& draw_command =
       static_cast<const DrawElementsCommand&>(command);
-  glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(draw_command.count),
-                 GL_UNSIGNED_INT, nullptr);
+  assert(mesh_ != nullptr);
+  glDrawElementsBaseVertex(
+      GL_TRIANGLES, static_cast<GLsizei>(draw_command.count),
+      GL_UNSIGNED_INT,
+      reinterpret_cast<const void*>(mesh_->first_index * sizeof(uint32_t)),
+      mesh_->base_vertex);
+  ++draw_call_count_;
 }
 
 void Driver::bind_uniform_vec2_(const Command& command) {
@@ -182,7 +271,7 @@ void Driver::bind_texture_(const Command& command) {
       resource_manager_.get_texture(bind_command.texture_id);
   glUniform1i(bind_command.location, texture_unit);
   glActiveTexture(GL_TEXTURE0 + texture_unit);
-  glBindTexture(GL_TEXTURE_2D, texture.texture);
+  glBindTexture(texture.target, texture.texture);
 }
 
 void Driver::bind_framebuffer_(const Command& command) {
@@ -195,15 +284,20 @@ void Driver::bind_framebuffer_(const Command& command) {
 #undef max
 #endif
   if (framebuffer_id == std::numeric_limits<uint32_t>::max()) {
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    glDrawBuffer(GL_BACK);
+    glBindFramebuffer(GL_FRAMEBUFFER, window_framebuffer_);
+    glDrawBuffer(window_framebuffer_ == 0 ? GL_BACK : GL_COLOR_ATTACHMENT0);
   } else {
     const Framebuffer& framebuffer =
         resource_manager_.get_framebuffer(framebuffer_id);
     glBindFramebuffer(GL_FRAMEBUFFER, framebuffer.handle);
     check_gl_framebuffer(GL_FRAMEBUFFER);
-    glDrawBuffers(static_cast<GLsizei>(framebuffer.descriptor.size()),
-                  &framebuffer.descriptor[0]);
+    // depth-only framebuffers, like the depth pre-pass' one, draw nowhere
+    if (framebuffer.descriptor.empty()) {
+      glDrawBuffer(GL_NONE);
+    } else {
+      glDrawBuffers(static_cast<GLsizei>(framebuffer.descriptor.size()),
+                    framebuffer.descriptor.data());
+    }
   }
 }
 
@@ -235,6 +329,8 @@ void Driver::set_viewport_(const Command& command) {
       static_cast<const SetViewportCommand&>(command);
   auto position = set_command.position;
   auto size = set_command.size;
+  viewport_ = {position.x, position.y, static_cast<GLint>(size.x),
+               static_cast<GLint>(size.y)};
   glViewport(position.x, position.y, static_cast<GLsizei>(size.x),
              static_cast<GLsizei>(size.y));
 }
@@ -245,16 +341,27 @@ void Driver::clear_framebuffer_(const Command& command) {
       static_cast<const ClearFramebufferCommand&>(command);
   glClearColor(set_command.color.x, set_command.color.y, set_command.color.z,
                1.0f);
-  glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
+  if (viewport_[2] <= 0 || viewport_[3] <= 0) {
+    glClear(static_cast<GLbitfield>(set_command.buffers));
+    return;
+  }
+  glEnable(GL_SCISSOR_TEST);
+  glScissor(viewport_[0], viewport_[1], viewport_[2], viewport_[3]);
+  glClear(static_cast<GLbitfield>(set_command.buffers));
+  if (scissor_test_enabled_) {
+    glScissor(scissor_box_[0], scissor_box_[1], scissor_box_[2],
+              scissor_box_[3]);
+  } else {
+    glDisable(GL_SCISSOR_TEST);
+  }
 }
 
 void Driver::bind_gpu_program_(const Command& command) {
   assert(command.type == Command::Type::kBindGpuProgram);
   const BindGpuProgramCommand& bind_command =
       static_cast<const BindGpuProgramCommand&>(command);
-  const GpuProgram& program =
-      resource_manager_.get_gpu_program(bind_command.program_id);
-  glUseProgram(program.handle);
+  program_ = &resource_manager_.get_gpu_program(bind_command.program_id);
+  glUseProgram(program_->handle);
 }
 
 void Driver::set_state_(const Command& command) {
@@ -279,31 +386,146 @@ void Driver::set_state_(const Command& command) {
   } else
     glDisable(GL_CULL_FACE);
 
-  glViewport(state.viewport[0], state.viewport[1], state.viewport[2],
-             state.viewport[3]);
+  if (state.viewport[2] > 0 && state.viewport[3] > 0) {
+    viewport_ = {state.viewport[0], state.viewport[1], state.viewport[2],
+                 state.viewport[3]};
+    glViewport(state.viewport[0], state.viewport[1], state.viewport[2],
+               state.viewport[3]);
+  }
 
+  scissor_test_enabled_ = state.scissor_test_enabled;
   if (state.scissor_test_enabled) {
+    scissor_box_ = {state.scissor_box[0], state.scissor_box[1],
+                    state.scissor_box[2], state.scissor_box[3]};
     glEnable(GL_SCISSOR_TEST);
     glScissor(state.scissor_box[0], state.scissor_box[1], state.scissor_box[2],
               state.scissor_box[3]);
   } else
     glDisable(GL_SCISSOR_TEST);
 
-  if (state.depth_test_enabled)
+  if (state.depth_test_enabled) {
     glEnable(GL_DEPTH_TEST);
-  else
+    glDepthFunc(state.depth_function);
+  } else
     glDisable(GL_DEPTH_TEST);
 
-  if (state.stencil_test_enabled)
+  glDepthMask(state.depth_write_enabled);
+  GLboolean color_mask = state.color_write_enabled;
+  glColorMask(color_mask, color_mask, color_mask, color_mask);
+
+  if (state.stencil_test_enabled) {
     glEnable(GL_STENCIL_TEST);
-  else
+    const StencilFaceState& front = state.stencil_front;
+    const StencilFaceState& back = state.stencil_back;
+    glStencilFuncSeparate(GL_FRONT, front.function, front.reference,
+                          front.mask);
+    glStencilOpSeparate(GL_FRONT, front.stencil_fail, front.depth_fail,
+                        front.depth_pass);
+    glStencilFuncSeparate(GL_BACK, back.function, back.reference, back.mask);
+    glStencilOpSeparate(GL_BACK, back.stencil_fail, back.depth_fail,
+                        back.depth_pass);
+  } else
     glDisable(GL_STENCIL_TEST);
 }
 
+void Driver::bind_uniform_block_(const Command& command) {
+  assert(command.type == Command::Type::kBindUniformBlock);
+  const BindUniformBlockCommand& bind_command =
+      static_cast<const BindUniformBlockCommand&>(command);
+  GLintptr offset = static_cast<GLintptr>(uniform_ring_->get_frame_offset() +
+                                          bind_command.offset);
+  glBindBufferRange(GL_UNIFORM_BUFFER, bind_command.binding,
+                    uniform_ring_->get_buffer(), offset,
+                    static_cast<GLsizeiptr>(bind_command.size));
+}
+
+void Driver::bind_material_parameters_(const Command& command) {
+  assert(command.type == Command::Type::kBindMaterialParameters);
+  const BindMaterialParametersCommand& bind_command =
+      static_cast<const BindMaterialParametersCommand&>(command);
+  resource_manager_.bind_material_parameters(bind_command.material_id);
+}
+
+void Driver::update_texture_buffer_(const Command& command) {
+  assert(command.type == Command::Type::kUpdateTextureBuffer);
+  const UpdateTextureBufferCommand& update_command =
+      static_cast<const UpdateTextureBufferCommand&>(command);
+  resource_manager_.update_texture_buffer(
+      update_command.texture_id, uniform_ring_->get_buffer(),
+      uniform_ring_->get_frame_offset() + update_command.offset,
+      update_command.size, update_command.buffer_offset);
+}
+
 GpuResourceManager& Driver::get_resource_manager() {
   return resource_manager_;
 }
 
+void Driver::count_samples_(const Command& command) {
+  assert(command.type == Command::Type::kCountSamples);
+  const CountSamplesCommand& count_command =
+      static_cast<const CountSamplesCommand&>(command);
+  GLuint query = sample_queries_[sample_query_index_];
+  if (!count_command.begin) {
+    glEndQuery(GL_SAMPLES_PASSED);
+    sample_queries_pending_[sample_query_index_] = true;
+    sample_query_index_ = (sample_query_index_ + 1) % kSampleQueryCount;
+    return;
+  }
+  // A result that isn't there yet is dropped rather than waited for.
+  if (sample_queries_pending_[sample_query_index_]) {
+    GLuint available = GL_FALSE;
+    glGetQueryObjectuiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (available == GL_TRUE) {
+      GLuint64 samples;
+      glGetQueryObjectui64v(query, GL_QUERY_RESULT, &samples);
+      samples_passed_ = samples;
+    }
+    sample_queries_pending_[sample_query_index_] = false;
+  }
+  glBeginQuery(GL_SAMPLES_PASSED, query);
+}
+
+void Driver::multi_draw_elements_(const Command& command) {
+  assert(command.type == Command::Type::kMultiDrawElements);
+  const MultiDrawElementsCommand& draw_command =
+      static_cast<const MultiDrawElementsCommand&>(command);
+  assert(program_ != nullptr);
+  const std::vector<DrawElementsIndirect>& draws = draw_command.draws;
+  const Texture& draw_buffer =
+      resource_manager_.get_texture(draw_command.draw_buffer_id);
+  glActiveTexture(GL_TEXTURE0 + ResourceManager::kDrawBufferTextureUnit);
+  glBindTexture(draw_buffer.target, draw_buffer.texture);
+
+  if (multi_draw_supported_) {
+    uint32_t draw_count = 0;
+    for (const DrawElementsIndirect& draw : draws)
+      draw_count = std::max(draw_count, draw.base_instance + 1);
+    resource_manager_.get_mesh_buffer().reserve_draw_ids(draw_count);
+    std::size_t offset =
+        uniform_ring_->get_frame_offset() + draw_command.offset;
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, uniform_ring_->get_buffer());
+    glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+                                reinterpret_cast<const void*>(offset),
+                                static_cast<GLsizei>(draws.size()), 0);
+    ++draw_call_count_;
+    return;
+  }
+  // The vertex array has no draw ID stream here, the attribute keeps the
+  // value last given to it.
+  GLint draw_id_location = program_->get_attribute_location(name_id::kDrawId);
+  for (const DrawElementsIndirect& draw : draws) {
+    if (draw_id_location != -1) {
+      glVertexAttribI1ui(static_cast<GLuint>(draw_id_location),
+                         draw.base_instance);
+    }
+    glDrawElementsBaseVertex(
+        GL_TRIANGLES, static_cast<GLsizei>(draw.count), GL_UNSIGNED_INT,
+        reinterpret_cast<const void*>(draw.first_index * sizeof(uint32_t)),
+        draw.base_vertex);
+    ++draw_call_count_;
+  }
+}
+
 }  // namespace gl
 }  // namespace render
 }  // namespace donkey
@@ -0,0 +1,166 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "render/gl/FrameReader.hpp"
+
+#include <cassert>
+#include <cstring>
+#include <iostream>
+
+#include "common.hpp"
+
+namespace donkey {
+namespace render {
+namespace gl {
+
+FrameReader::FrameReader(int width, int height, std::size_t buffer_count)
+    : width_(width),
+      height_(height),
+      framebuffer_(0),
+      color_renderbuffer_(0),
+      depth_renderbuffer_(0),
+      slots_(buffer_count, {0, nullptr, 0}),
+      oldest_slot_(0),
+      pending_count_(0),
+      frame_count_(0),
+      pixels_(static_cast<std::size_t>(width) * height * 4),
+      callback_() {
+  assert(buffer_count > 0);
+  glGenRenderbuffers(1, &color_renderbuffer_);
+  glBindRenderbuffer(GL_RENDERBUFFER, color_renderbuffer_);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+  glGenRenderbuffers(1, &depth_renderbuffer_);
+  glBindRenderbuffer(GL_RENDERBUFFER, depth_renderbuffer_);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+  glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+  glGenFramebuffers(1, &framebuffer_);
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                            GL_RENDERBUFFER, color_renderbuffer_);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT,
+                            GL_RENDERBUFFER, depth_renderbuffer_);
+  check_gl_framebuffer(GL_FRAMEBUFFER);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+  for (Slot& slot : slots_) {
+    glGenBuffers(1, &slot.buffer);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    glBufferData(GL_PIXEL_PACK_BUFFER,
+                 static_cast<GLsizeiptr>(pixels_.size()), nullptr,
+                 GL_STREAM_READ);
+  }
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  CHECK_GL_ERROR;
+}
+
+FrameReader::~FrameReader() {
+  for (Slot& slot : slots_) {
+    if (slot.fence)
+      glDeleteSync(slot.fence);
+    glDeleteBuffers(1, &slot.buffer);
+  }
+  glDeleteFramebuffers(1, &framebuffer_);
+  glDeleteRenderbuffers(1, &color_renderbuffer_);
+  glDeleteRenderbuffers(1, &depth_renderbuffer_);
+}
+
+GLuint FrameReader::get_framebuffer() const {
+  return framebuffer_;
+}
+
+int FrameReader::get_width() const {
+  return width_;
+}
+
+int FrameReader::get_height() const {
+  return height_;
+}
+
+void FrameReader::set_callback(const Callback& callback) {
+  callback_ = callback;
+}
+
+void FrameReader::read_frame() {
+  // Every buffer in flight, the oldest frame has to be read first.
+  if (pending_count_ == slots_.size()) {
+    deliver_(slots_[oldest_slot_]);
+  }
+  Slot& slot = slots_[(oldest_slot_ + pending_count_) % slots_.size()];
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer_);
+  glReadBuffer(GL_COLOR_ATTACHMENT0);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+  glPixelStorei(GL_PACK_ALIGNMENT, 4);
+  // Into the buffer, glReadPixels returns right away.
+  glReadPixels(0, 0, width_, height_, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+  slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  slot.frame_index = frame_count_++;
+  pending_count_ += 1;
+  CHECK_GL_ERROR;
+  poll(false);
+}
+
+void FrameReader::poll(bool wait) {
+  while (pending_count_ > 0 && is_ready_(slots_[oldest_slot_], wait))
+    deliver_(slots_[oldest_slot_]);
+}
+
+bool FrameReader::is_ready_(const Slot& slot, bool wait) const {
+  const GLuint64 timeout = 1000000;  // 1ms
+  GLenum status;
+  do {
+    status = glClientWaitSync(slot.fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0,
+                              wait ? timeout : 0);
+  } while (wait && status == GL_TIMEOUT_EXPIRED);
+  if (status == GL_WAIT_FAILED) {
+    std::cerr << "Can't wait for a frame's read back.\n";
+    assert(false);
+  }
+  return status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED;
+}
+
+// Waits for the slot's copy if it isn't done yet, that's only when every
+// buffer is in flight.
+void FrameReader::deliver_(Slot& slot) {
+  is_ready_(slot, true);
+  glDeleteSync(slot.fence);
+  slot.fence = nullptr;
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+  const uint8_t* mapping = static_cast<const uint8_t*>(
+      glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0,
+                       static_cast<GLsizeiptr>(pixels_.size()),
+                       GL_MAP_READ_BIT));
+  assert(mapping != nullptr);
+  // GL rows go bottom-up.
+  std::size_t row_size = static_cast<std::size_t>(width_) * 4;
+  for (int y = 0; y < height_; ++y) {
+    std::memcpy(pixels_.data() + (height_ - 1 - y) * row_size,
+                mapping + y * row_size, row_size);
+  }
+  glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  oldest_slot_ = (oldest_slot_ + 1) % slots_.size();
+  pending_count_ -= 1;
+  if (callback_)
+    callback_(slot.frame_index, pixels_.data(), width_, height_);
+}
+
+}  // namespace gl
+}  // namespace render
+}  // namespace donkey
@@ -0,0 +1,160 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "render/gl/GpuProgram.hpp"
+
+#include <algorithm>
+#include <string_view>
+
+namespace donkey {
+namespace render {
+namespace gl {
+
+namespace {
+
+// Array uniforms are reported as "name[0]", materials refer to them as
+// "name".
+NameId make_variable_name_id(const char* name, GLsizei length) {
+  std::string_view view(name, static_cast<std::size_t>(length));
+  if (view.size() > 3 && view.substr(view.size() - 3) == "[0]")
+    view.remove_suffix(3);
+  return make_name_id(view);
+}
+
+template <typename Variable>
+void sort_variables(std::vector<Variable>& variables) {
+  std::sort(variables.begin(), variables.end(),
+            [](const Variable& lhs, const Variable& rhs) {
+              return lhs.name_id < rhs.name_id;
+            });
+}
+
+template <typename Variable>
+const Variable* find_variable(const std::vector<Variable>& variables,
+                              NameId name_id) {
+  auto it = std::lower_bound(variables.begin(), variables.end(), name_id,
+                             [](const Variable& variable, NameId name_id) {
+                               return variable.name_id < name_id;
+                             });
+  if (it == variables.end() || it->name_id != name_id)
+    return nullptr;
+  return &(*it);
+}
+
+}  // namespace
+
+GpuProgram::GpuProgram(GLuint handle) : handle(handle) {}
+
+void GpuProgram::reflect() {
+  GLint max_length = 0;
+  GLint length = 0;
+  glGetProgramiv(handle, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &length);
+  max_length = std::max(max_length, length);
+  glGetProgramiv(handle, GL_ACTIVE_UNIFORM_MAX_LENGTH, &length);
+  max_length = std::max(max_length, length);
+  glGetProgramiv(handle, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &length);
+  max_length = std::max(max_length, length);
+  std::vector<char> name(static_cast<std::size_t>(max_length) + 1);
+  GLsizei buffer_size = static_cast<GLsizei>(name.size());
+
+  GLint count = 0;
+  glGetProgramiv(handle, GL_ACTIVE_ATTRIBUTES, &count);
+  attributes.clear();
+  for (GLint i = 0; i < count; ++i) {
+    GLsizei name_length = 0;
+    GLint size;
+    GLenum type;
+    glGetActiveAttrib(handle, static_cast<GLuint>(i), buffer_size,
+                      &name_length, &size, &type, name.data());
+    GLint location = glGetAttribLocation(handle, name.data());
+    attributes.push_back({make_variable_name_id(name.data(), name_length),
+                          location, type, size});
+  }
+  sort_variables(attributes);
+
+  glGetProgramiv(handle, GL_ACTIVE_UNIFORMS, &count);
+  uniforms.clear();
+  block_members.clear();
+  for (GLint i = 0; i < count; ++i) {
+    GLuint index = static_cast<GLuint>(i);
+    GLsizei name_length = 0;
+    GLint size;
+    GLenum type;
+    glGetActiveUniform(handle, index, buffer_size, &name_length, &size, &type,
+                       name.data());
+    NameId name_id = make_variable_name_id(name.data(), name_length);
+    GLint block_index;
+    glGetActiveUniformsiv(handle, 1, &index, GL_UNIFORM_BLOCK_INDEX,
+                          &block_index);
+    if (block_index < 0) {
+      GLint location = glGetUniformLocation(handle, name.data());
+      uniforms.push_back({name_id, location, type, size});
+    } else {
+      GLint offset;
+      GLint matrix_stride;
+      glGetActiveUniformsiv(handle, 1, &index, GL_UNIFORM_OFFSET, &offset);
+      glGetActiveUniformsiv(handle, 1, &index, GL_UNIFORM_MATRIX_STRIDE,
+                            &matrix_stride);
+      block_members.push_back({name_id, static_cast<GLuint>(block_index),
+                               offset, matrix_stride, type});
+    }
+  }
+  sort_variables(uniforms);
+  sort_variables(block_members);
+
+  glGetProgramiv(handle, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+  uniform_blocks.clear();
+  for (GLint i = 0; i < count; ++i) {
+    GLsizei name_length = 0;
+    glGetActiveUniformBlockName(handle, static_cast<GLuint>(i), buffer_size,
+                                &name_length, name.data());
+    GLint data_size;
+    glGetActiveUniformBlockiv(handle, static_cast<GLuint>(i),
+                              GL_UNIFORM_BLOCK_DATA_SIZE, &data_size);
+    NameId name_id = make_variable_name_id(name.data(), name_length);
+    uniform_blocks.push_back({name_id, i, GL_NONE, data_size});
+  }
+  sort_variables(uniform_blocks);
+}
+
+GLint GpuProgram::get_attribute_location(NameId name_id) const {
+  const ShaderVariable* variable = find_variable(attributes, name_id);
+  return variable ? variable->location : -1;
+}
+
+GLint GpuProgram::get_uniform_location(NameId name_id) const {
+  const ShaderVariable* variable = find_variable(uniforms, name_id);
+  return variable ? variable->location : -1;
+}
+
+GLuint GpuProgram::get_uniform_block_index(NameId name_id) const {
+  const ShaderVariable* variable = find_variable(uniform_blocks, name_id);
+  return variable ? static_cast<GLuint>(variable->location) : GL_INVALID_INDEX;
+}
+
+const ShaderVariable* GpuProgram::find_uniform_block(NameId name_id) const {
+  return find_variable(uniform_blocks, name_id);
+}
+
+const BlockMember* GpuProgram::find_block_member(NameId name_id) const {
+  return find_variable(block_members, name_id);
+}
+
+}  // namespace gl
+}  // namespace render
+}  // namespace donkey
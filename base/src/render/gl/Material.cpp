@@ -19,6 +19,10 @@
 
 #include <GL/gl3w.h>
 
+#include <cassert>
+#include <cstring>
+#include <iostream>
+
 #include "render/gl/GpuProgram.hpp"
 
 namespace donkey {
@@ -26,58 +30,85 @@ namespace render {
 namespace gl {
 
 Material::Material(const ResourceManager& resource_manager, uint32_t program_id)
-    : AMaterial(program_id), resource_manager_(resource_manager) {
-  const GpuProgram& program = resource_manager_.get_gpu_program(program_id);
-  position_location = glGetAttribLocation(program.handle, "position");
-  normal_location = glGetAttribLocation(program.handle, "normal");
-  uv_location = glGetAttribLocation(program.handle, "uv");
-  tangent_location = glGetAttribLocation(program.handle, "tangent");
-  bitangent_location = glGetAttribLocation(program.handle, "bitangent");
-  model_location = glGetUniformLocation(program.handle, "model");
-  view_location = glGetUniformLocation(program.handle, "view");
-  projection_location = glGetUniformLocation(program.handle, "projection");
-  gbuffer_projection_inverse_location =
-      glGetUniformLocation(program.handle, "gbuffer_projection_inverse");
-  gbuffer_view_location = glGetUniformLocation(program.handle, "gbuffer_view");
-  gbuffer_projection_params_location =
-      glGetUniformLocation(program.handle, "gbuffer_projection_params");
-  light_dir_location = glGetUniformLocation(program.handle, "light_dir");
-  light_diffuse_location =
-      glGetUniformLocation(program.handle, "light_diffuse");
-  light_specular_location =
-      glGetUniformLocation(program.handle, "light_specular");
-  ambient_location = glGetUniformLocation(program.handle, "ambient");
-  camera_position_location =
-      glGetUniformLocation(program.handle, "camera_position");
+    : AMaterial(program_id),
+      resource_manager_(&resource_manager),
+      material_block_index_(GL_INVALID_INDEX),
+      parameters_offset(0) {
+  const GpuProgram& program = resource_manager_->get_gpu_program(program_id);
+  position_location = program.get_attribute_location(name_id::kPosition);
+  normal_location = program.get_attribute_location(name_id::kNormal);
+  uv_location = program.get_attribute_location(name_id::kUv);
+  tangent_location = program.get_attribute_location(name_id::kTangent);
+  bitangent_location = program.get_attribute_location(name_id::kBitangent);
+  draw_id_location = program.get_attribute_location(name_id::kDrawId);
+
+  const ShaderVariable* block =
+      program.find_uniform_block(name_id::kMaterialBlock);
+  if (block) {
+    material_block_index_ = static_cast<GLuint>(block->location);
+    parameters_.resize(static_cast<std::size_t>(block->size), 0);
+    parameters_dirty_ = true;
+  }
+}
+
+// Copies a value into the parameter block at the offset the program gave to
+// `name`. Matrices are copied column by column since std140 pads every
+// column to a vec4.
+void Material::write_parameter_(const std::string& name,
+                                GLenum type,
+                                const uint8_t* data,
+                                std::size_t columns,
+                                std::size_t column_size) {
+  const GpuProgram& program = resource_manager_->get_gpu_program(program_id);
+  const BlockMember* member = program.find_block_member(make_name_id(name));
+  if (!member || member->block_index != material_block_index_) {
+    std::cerr << "Material parameter " << name
+              << " isn't declared in the MaterialBlock of its program.\n";
+    assert(false);
+    return;
+  }
+  if (member->type != type) {
+    std::cerr << "Material parameter " << name
+              << " doesn't have the type declared in the MaterialBlock.\n";
+    assert(false);
+    return;
+  }
+  std::size_t stride = static_cast<std::size_t>(member->matrix_stride);
+  uint8_t* destination =
+      parameters_.data() + static_cast<std::size_t>(member->offset);
+  for (std::size_t column = 0; column < columns; ++column) {
+    std::memcpy(destination + column * stride, data + column * column_size,
+                column_size);
+  }
+  parameters_dirty_ = true;
 }
 
 // TODO: find a pure c++ (i.e. no preprocessor) implementation that is as
 // concise and doesn't use RTTIs.
 
-#define DEFINE_REGISTER_SLOT(x, y, z)                                          \
+#define DEFINE_REGISTER_SLOT(x, z, type, columns)                              \
   void Material::register_##z##_slot(const std::string& name,                  \
                                      const x& storage) {                       \
-    const GpuProgram& program = resource_manager_.get_gpu_program(program_id); \
-    int location = glGetUniformLocation(program.handle, name.c_str());         \
-    y##_slots_.push_back(ScalarMaterialSlot<x>(location, storage));            \
+    write_parameter_(name, type, reinterpret_cast<const uint8_t*>(&storage),   \
+                     columns, sizeof(x) / columns);                            \
   }
 
-DEFINE_REGISTER_SLOT(float, float, float)
-DEFINE_REGISTER_SLOT(glm::vec2, vec2, vector2)
-DEFINE_REGISTER_SLOT(glm::vec3, vec3, vector3)
-DEFINE_REGISTER_SLOT(glm::vec4, vec4, vector4)
-DEFINE_REGISTER_SLOT(glm::mat2, mat2, matrix2)
-DEFINE_REGISTER_SLOT(glm::mat3, mat3, matrix3)
-DEFINE_REGISTER_SLOT(glm::mat4, mat4, matrix4)
-DEFINE_REGISTER_SLOT(int, int, int)
+DEFINE_REGISTER_SLOT(float, float, GL_FLOAT, 1)
+DEFINE_REGISTER_SLOT(glm::vec2, vector2, GL_FLOAT_VEC2, 1)
+DEFINE_REGISTER_SLOT(glm::vec3, vector3, GL_FLOAT_VEC3, 1)
+DEFINE_REGISTER_SLOT(glm::vec4, vector4, GL_FLOAT_VEC4, 1)
+DEFINE_REGISTER_SLOT(glm::mat2, matrix2, GL_FLOAT_MAT2, 2)
+DEFINE_REGISTER_SLOT(glm::mat3, matrix3, GL_FLOAT_MAT3, 3)
+DEFINE_REGISTER_SLOT(glm::mat4, matrix4, GL_FLOAT_MAT4, 4)
+DEFINE_REGISTER_SLOT(int, int, GL_INT, 1)
 
 #undef DEFINE_REGISTER_SLOT
 
 void Material::register_texture_slot(const std::string& name,
                                      uint32_t texture_id,
                                      int texture_unit) {
-  const GpuProgram& program = resource_manager_.get_gpu_program(program_id);
-  int location = glGetUniformLocation(program.handle, name.c_str());
+  const GpuProgram& program = resource_manager_->get_gpu_program(program_id);
+  int location = program.get_uniform_location(make_name_id(name));
   texture_slots_.push_back(
       TextureMaterialSlot(location, texture_id, texture_unit));
 }
@@ -15,26 +15,21 @@
  * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
  */
 
+
 #include "render/gl/Mesh.hpp"
 
 namespace donkey {
 namespace render {
 namespace gl {
 
-Mesh::Mesh(GLuint position_buffer,
-           GLuint normal_buffer,
-           GLuint uv_buffer,
-           GLuint tangent_buffer,
-           GLuint bitangent_buffer,
-           GLuint index_buffer,
-           GLuint vertex_array)
-    : position_buffer(position_buffer),
-      normal_buffer(normal_buffer),
-      uv_buffer(uv_buffer),
-      tangent_buffer(tangent_buffer),
-      bitangent_buffer(bitangent_buffer),
-      index_buffer(index_buffer),
-      vertex_array(vertex_array) {}
+Mesh::Mesh(GLint base_vertex,
+           GLuint vertex_count,
+           GLuint first_index,
+           GLuint index_count)
+    : base_vertex(base_vertex),
+      vertex_count(vertex_count),
+      first_index(first_index),
+      index_count(index_count) {}
 
 }  // namespace gl
 }  // namespace render
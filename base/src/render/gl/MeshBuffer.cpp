@@ -0,0 +1,265 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "render/gl/MeshBuffer.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+
+#include "common.hpp"
+
+namespace donkey {
+namespace render {
+namespace gl {
+
+// Floats per vertex, indexed by stream.
+const std::array<GLint, MeshBuffer::kStreamCount> MeshBuffer::stream_sizes_ =
+    {3, 3, 2, 3};
+
+// GL objects are created on first use, the context may not exist yet.
+MeshBuffer::MeshBuffer()
+    : index_buffer_(0),
+      draw_id_buffer_(0),
+      vertex_capacity_(0),
+      index_capacity_(0),
+      draw_id_capacity_(0),
+      vertex_array_(),
+      position_vertex_array_(),
+      bound_vertex_array_(nullptr) {
+  vertex_buffers_.fill(0);
+  vertex_array_.locations.fill(-1);
+  position_vertex_array_.locations.fill(-1);
+}
+
+MeshBuffer::~MeshBuffer() {
+  cleanup();
+}
+
+void MeshBuffer::cleanup() {
+  for (GLuint& buffer : vertex_buffers_) {
+    if (buffer != 0)
+      glDeleteBuffers(1, &buffer);
+    buffer = 0;
+  }
+  for (GLuint* buffer : {&index_buffer_, &draw_id_buffer_}) {
+    if (*buffer != 0)
+      glDeleteBuffers(1, buffer);
+    *buffer = 0;
+  }
+  for (VertexArray* vertex_array : {&vertex_array_, &position_vertex_array_}) {
+    if (vertex_array->handle != 0)
+      glDeleteVertexArrays(1, &(vertex_array->handle));
+    *vertex_array = VertexArray();
+    vertex_array->locations.fill(-1);
+  }
+  vertex_ranges_.clear();
+  index_ranges_.clear();
+  vertex_capacity_ = index_capacity_ = 0;
+  draw_id_capacity_ = 0;
+  bound_vertex_array_ = nullptr;
+}
+
+GLuint MeshBuffer::grow_(GLenum target,
+                         GLuint buffer,
+                         std::size_t size,
+                         std::size_t capacity) {
+  GLuint new_buffer;
+  glGenBuffers(1, &new_buffer);
+  glBindBuffer(target, new_buffer);
+  glBufferData(target, static_cast<GLsizeiptr>(capacity), nullptr,
+               GL_STATIC_DRAW);
+  if (buffer != 0) {
+    glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, target, 0, 0,
+                        static_cast<GLsizeiptr>(size));
+    glDeleteBuffers(1, &buffer);
+  }
+  CHECK_GL_ERROR;
+  // Vertex arrays that weren't bound since keep using the deleted buffer, but
+  // its name is free again and could come back from the next grow, so they
+  // can't tell from names alone that they're out of date. Forgetting their
+  // buffers makes the next bind point every slot again while still disabling
+  // the locations they had enabled.
+  for (VertexArray* vertex_array : {&vertex_array_, &position_vertex_array_})
+    vertex_array->buffers.fill(0);
+  bound_vertex_array_ = nullptr;
+  return new_buffer;
+}
+
+void MeshBuffer::add(
+    const std::array<const std::vector<float>*, kStreamCount>& streams,
+    const std::vector<uint32_t>& indices,
+    GLint& base_vertex,
+    GLuint& first_index) {
+  base_vertex = 0;
+  first_index = 0;
+  std::size_t vertex_count = streams[kPositionStream]->size() / 3;
+  for (std::size_t i = 0; i < kStreamCount; ++i) {
+    std::size_t vertex_size = static_cast<std::size_t>(stream_sizes_[i]);
+    if (streams[i]->size() != vertex_count * vertex_size) {
+      std::cerr << "Mesh streams don't have the same vertex count.\n";
+      assert(false);
+      return;
+    }
+  }
+  std::size_t used_vertex_count = vertex_ranges_.get_size();
+  std::size_t used_index_count = index_ranges_.get_size();
+  std::size_t vertex_offset = vertex_ranges_.allocate(vertex_count);
+  std::size_t index_offset = index_ranges_.allocate(indices.size());
+  // Growing invalidates both vertex arrays, see grow_().
+  if (vertex_ranges_.get_size() > vertex_capacity_) {
+    std::size_t capacity =
+        std::max(vertex_ranges_.get_size(), vertex_capacity_ * 2);
+    for (std::size_t i = 0; i < kStreamCount; ++i) {
+      std::size_t vertex_size = sizeof(float) * stream_sizes_[i];
+      vertex_buffers_[i] =
+          grow_(GL_ARRAY_BUFFER, vertex_buffers_[i],
+                used_vertex_count * vertex_size, capacity * vertex_size);
+    }
+    vertex_capacity_ = capacity;
+  }
+  if (index_ranges_.get_size() > index_capacity_) {
+    std::size_t capacity =
+        std::max(index_ranges_.get_size(), index_capacity_ * 2);
+    // Not GL_ELEMENT_ARRAY_BUFFER, that one belongs to the bound vertex
+    // array.
+    index_buffer_ = grow_(GL_COPY_WRITE_BUFFER, index_buffer_,
+                          used_index_count * sizeof(uint32_t),
+                          capacity * sizeof(uint32_t));
+    index_capacity_ = capacity;
+  }
+
+  for (std::size_t i = 0; i < kStreamCount; ++i) {
+    std::size_t vertex_size = sizeof(float) * stream_sizes_[i];
+    glBindBuffer(GL_ARRAY_BUFFER, vertex_buffers_[i]);
+    glBufferSubData(GL_ARRAY_BUFFER,
+                    static_cast<GLintptr>(vertex_offset * vertex_size),
+                    static_cast<GLsizeiptr>(vertex_count * vertex_size),
+                    streams[i]->data());
+  }
+  glBindBuffer(GL_COPY_WRITE_BUFFER, index_buffer_);
+  glBufferSubData(GL_COPY_WRITE_BUFFER,
+                  static_cast<GLintptr>(index_offset * sizeof(uint32_t)),
+                  static_cast<GLsizeiptr>(indices.size() * sizeof(uint32_t)),
+                  indices.data());
+  CHECK_GL_ERROR;
+
+  base_vertex = static_cast<GLint>(vertex_offset);
+  first_index = static_cast<GLuint>(index_offset);
+}
+
+void MeshBuffer::remove(GLint base_vertex,
+                        std::size_t vertex_count,
+                        GLuint first_index,
+                        std::size_t index_count) {
+  vertex_ranges_.free(static_cast<std::size_t>(base_vertex), vertex_count);
+  index_ranges_.free(first_index, index_count);
+}
+
+std::size_t MeshBuffer::get_vertex_count() const {
+  return vertex_ranges_.get_size();
+}
+
+std::size_t MeshBuffer::get_index_count() const {
+  return index_ranges_.get_size();
+}
+
+void MeshBuffer::reserve_draw_ids(std::size_t count) {
+  if (count <= draw_id_capacity_)
+    return;
+  std::size_t capacity =
+      std::max({count, draw_id_capacity_ * 2,
+                static_cast<std::size_t>(kMinDrawIdCount)});
+  std::vector<uint32_t> draw_ids(capacity);
+  for (std::size_t i = 0; i < capacity; ++i)
+    draw_ids[i] = static_cast<uint32_t>(i);
+  if (draw_id_buffer_ == 0)
+    glGenBuffers(1, &draw_id_buffer_);
+  glBindBuffer(GL_ARRAY_BUFFER, draw_id_buffer_);
+  glBufferData(GL_ARRAY_BUFFER,
+               static_cast<GLsizeiptr>(capacity * sizeof(uint32_t)),
+               draw_ids.data(), GL_STATIC_DRAW);
+  draw_id_capacity_ = capacity;
+}
+
+void MeshBuffer::set_up_(VertexArray& vertex_array,
+                         const Locations& locations,
+                         const std::array<GLuint, kSlotCount>& buffers) {
+  // Every slot that moved is disabled first so that a slot taking over the
+  // location another one left doesn't get disabled afterwards.
+  for (std::size_t i = 0; i < kSlotCount; ++i) {
+    GLint location = vertex_array.locations[i];
+    if (location != -1 && (location != locations[i] ||
+                           vertex_array.buffers[i] != buffers[i])) {
+      glDisableVertexAttribArray(static_cast<GLuint>(location));
+    }
+  }
+  for (std::size_t i = 0; i < kSlotCount; ++i) {
+    GLint location = locations[i];
+    if (location == -1 || (location == vertex_array.locations[i] &&
+                           buffers[i] == vertex_array.buffers[i])) {
+      continue;
+    }
+    GLuint index = static_cast<GLuint>(location);
+    glBindBuffer(GL_ARRAY_BUFFER, buffers[i]);
+    if (i == kDrawIdSlot) {
+      glVertexAttribIPointer(index, 1, GL_UNSIGNED_INT, 0, nullptr);
+      glVertexAttribDivisor(index, 1);
+    } else {
+      glVertexAttribPointer(index, stream_sizes_[i], GL_FLOAT, GL_FALSE, 0,
+                            nullptr);
+      glVertexAttribDivisor(index, 0);
+    }
+    glEnableVertexAttribArray(index);
+  }
+  vertex_array.locations = locations;
+  vertex_array.buffers = buffers;
+}
+
+void MeshBuffer::bind(const Locations& locations) {
+  // Programs that only read positions, like depth-only ones, get a vertex
+  // array without the other streams so that they aren't fetched.
+  bool position_only = (locations[kNormalStream] == -1 &&
+                        locations[kUvStream] == -1 &&
+                        locations[kTangentStream] == -1);
+  VertexArray& vertex_array =
+      position_only ? position_vertex_array_ : vertex_array_;
+  if (vertex_array.handle == 0)
+    glGenVertexArrays(1, &(vertex_array.handle));
+  if (locations[kDrawIdSlot] != -1)
+    reserve_draw_ids(kMinDrawIdCount);
+
+  std::array<GLuint, kSlotCount> buffers;
+  for (std::size_t i = 0; i < kStreamCount; ++i)
+    buffers[i] = vertex_buffers_[i];
+  buffers[kDrawIdSlot] = draw_id_buffer_;
+  if (bound_vertex_array_ == &vertex_array &&
+      vertex_array.locations == locations && vertex_array.buffers == buffers) {
+    return;
+  }
+  glBindVertexArray(vertex_array.handle);
+  set_up_(vertex_array, locations, buffers);
+  // Index buffers are part of the vertex array's state.
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer_);
+  bound_vertex_array_ = &vertex_array;
+}
+
+}  // namespace gl
+}  // namespace render
+}  // namespace donkey
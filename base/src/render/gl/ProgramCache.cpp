@@ -0,0 +1,194 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "render/gl/ProgramCache.hpp"
+
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+#include "hash.hpp"
+#include "render/binary_io.hpp"
+
+namespace donkey {
+namespace render {
+namespace gl {
+
+namespace {
+
+const uint32_t kMagic = 0x50444e53;  // "SNDP"
+const uint32_t kVersion = 1;
+
+struct Header {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t key;
+  uint32_t format;
+  uint32_t size;
+};
+
+uint64_t hash_string(uint64_t hash, const std::string& string) {
+  // Hash the length too so that ("ab", "c") and ("a", "bc") differ.
+  uint64_t size = string.size();
+  hash = hash_fnv1a(
+      std::string_view(reinterpret_cast<const char*>(&size), sizeof(size)),
+      hash);
+  return hash_fnv1a(string, hash);
+}
+
+std::string get_gl_string(GLenum name) {
+  const GLubyte* string = glGetString(name);
+  return string ? reinterpret_cast<const char*>(string) : "";
+}
+
+}  // namespace
+
+ProgramCache::ProgramCache(const std::string& directory)
+    : directory_(directory), initialized_(false), supported_(false) {}
+
+std::string ProgramCache::get_default_directory() {
+  std::filesystem::path directory;
+  const char* cache_home = std::getenv("XDG_CACHE_HOME");
+  const char* home = std::getenv("HOME");
+  if (cache_home && *cache_home)
+    directory = cache_home;
+  else if (home && *home)
+    directory = std::filesystem::path(home) / ".cache";
+  else
+    return "";
+  return (directory / "sturdy-donkey").string();
+}
+
+bool ProgramCache::is_supported_() {
+  if (!initialized_) {
+    GLint format_count = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &format_count);
+    supported_ = format_count > 0;
+    driver_string_ = get_gl_string(GL_VENDOR) + '\n' +
+                     get_gl_string(GL_RENDERER) + '\n' +
+                     get_gl_string(GL_VERSION);
+    initialized_ = true;
+    if (!supported_)
+      std::cout << "Driver doesn't support program binaries, not caching.\n";
+  }
+  return supported_;
+}
+
+uint64_t ProgramCache::make_key_(const std::string& vs_sources,
+                                 const std::string& fs_sources) const {
+  uint64_t hash = hash_string(kFnv1aOffsetBasis, driver_string_);
+  hash = hash_string(hash, vs_sources);
+  return hash_string(hash, fs_sources);
+}
+
+std::string ProgramCache::get_path_(uint64_t key) const {
+  std::ostringstream stream;
+  stream << std::hex << std::setw(16) << std::setfill('0') << key << ".bin";
+  return (std::filesystem::path(directory_) / stream.str()).string();
+}
+
+GLuint ProgramCache::load(const std::string& vs_sources,
+                          const std::string& fs_sources) {
+  if (directory_.empty() || !is_supported_())
+    return 0;
+  uint64_t key = make_key_(vs_sources, fs_sources);
+  std::ifstream stream(get_path_(key), std::ios::binary);
+  if (!stream)
+    return 0;
+  Header header;
+  stream.read(reinterpret_cast<char*>(&header), sizeof(header));
+  if (!stream || header.magic != kMagic || header.version != kVersion ||
+      header.key != key)
+    return 0;
+  // A damaged entry could claim any size, check it before allocating.
+  if (header.size > static_cast<uint32_t>(INT32_MAX) ||
+      !binary_io::has_bytes(stream, header.size))
+    return 0;
+  std::vector<char> binary(header.size);
+  stream.read(binary.data(), header.size);
+  if (!stream)
+    return 0;
+
+  GLuint program = glCreateProgram();
+  glProgramBinary(program, header.format, binary.data(),
+                  static_cast<GLsizei>(header.size));
+  GLint status = GL_FALSE;
+  glGetProgramiv(program, GL_LINK_STATUS, &status);
+  if (status != GL_TRUE) {
+    // The driver rejected the binary (e.g. unsupported format), swallow the
+    // error it raised and let the caller compile from sources.
+    while (glGetError() != GL_NO_ERROR) {
+    }
+    glDeleteProgram(program);
+    std::cout << "Stale GPU program binary, rebuilding it.\n";
+    return 0;
+  }
+  std::cout << "GPU program loaded from cache.\n";
+  return program;
+}
+
+void ProgramCache::store(GLuint program,
+                         const std::string& vs_sources,
+                         const std::string& fs_sources) {
+  if (directory_.empty() || !is_supported_())
+    return;
+  GLint status = GL_FALSE;
+  glGetProgramiv(program, GL_LINK_STATUS, &status);
+  if (status != GL_TRUE)
+    return;
+  GLint size = 0;
+  glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &size);
+  if (size <= 0)
+    return;
+  std::vector<char> binary(static_cast<std::size_t>(size));
+  GLsizei length = 0;
+  GLenum format = 0;
+  glGetProgramBinary(program, size, &length, &format, binary.data());
+
+  std::error_code error;
+  std::filesystem::create_directories(directory_, error);
+  uint64_t key = make_key_(vs_sources, fs_sources);
+  std::string path = get_path_(key);
+  // Write to a temporary file first so that a crash can't leave a truncated
+  // entry behind.
+  std::string temporary_path = path + ".tmp";
+  {
+    std::ofstream stream(temporary_path, std::ios::binary | std::ios::trunc);
+    Header header = {kMagic, kVersion, key, format,
+                     static_cast<uint32_t>(length)};
+    stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    stream.write(binary.data(), length);
+    if (!stream) {
+      std::cerr << "Can't write GPU program binary: " << temporary_path
+                << '\n';
+      return;
+    }
+  }
+  std::filesystem::rename(temporary_path, path, error);
+  if (error)
+    std::cerr << "Can't write GPU program binary: " << path << '\n';
+}
+
+}  // namespace gl
+}  // namespace render
+}  // namespace donkey
@@ -15,6 +15,7 @@
  * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
 #include <iostream>
 
 #if defined(MSVC)
@@ -35,17 +36,32 @@ namespace donkey {
 namespace render {
 namespace gl {
 
-const std::array<GLenum, 4> ResourceManager::pixel_internal_formats_ = {
-    GL_RGB8, GL_RGB16F, GL_RGBA8, GL_DEPTH_COMPONENT24};
+const std::array<GLenum, 9> ResourceManager::pixel_internal_formats_ = {
+    GL_RGB8,    GL_RGB16F, GL_RGBA8,    GL_DEPTH_COMPONENT24,
+    GL_DEPTH24_STENCIL8, GL_RGBA16F, GL_RG16, GL_RGB10_A2,
+    GL_R11F_G11F_B10F};
 
-const std::array<GLenum, 3> ResourceManager::pixel_formats_ = {
-    GL_RGB, GL_RGBA, GL_DEPTH_COMPONENT};
+const std::array<GLenum, 5> ResourceManager::pixel_formats_ = {
+    GL_RGB, GL_RGBA, GL_DEPTH_COMPONENT, GL_DEPTH_STENCIL, GL_RG};
 
-const std::array<GLenum, 3> ResourceManager::pixel_component_types_ = {
-    GL_BYTE, GL_UNSIGNED_BYTE, GL_FLOAT};
+const std::array<GLenum, 4> ResourceManager::pixel_component_types_ = {
+    GL_BYTE, GL_UNSIGNED_BYTE, GL_FLOAT, GL_UNSIGNED_INT_24_8};
 
-ResourceManager::ResourceManager() {
-  textures_.push_back(Texture(0));
+const std::array<GLenum, 3> ResourceManager::buffer_formats_ = {
+    GL_RGBA32F, GL_RG32UI, GL_R16UI};
+
+// Indexed by UniformBlockBinding.
+const std::array<NameId, 5> ResourceManager::uniform_block_ids_ = {
+    name_id::kCameraBlock, name_id::kLightBlock, name_id::kObjectBlock,
+    name_id::kMaterialBlock, name_id::kShadowBlock};
+
+ResourceManager::ResourceManager(const std::string& program_cache_directory)
+    : frame_count_(0),
+      program_cache_(program_cache_directory),
+      material_buffer_(0),
+      material_buffer_capacity_(0),
+      material_buffer_alignment_(0) {
+  textures_.insert(Texture(0));
 }
 
 ResourceManager::~ResourceManager() {
@@ -59,15 +75,30 @@ void ResourceManager::cleanup() {
   for (const auto& program : gpu_programs_) {
     glDeleteProgram(program.handle);
   }
-  for (const auto& mesh : meshes_) {
-    glDeleteBuffers(1, &(mesh.position_buffer));
-    glDeleteBuffers(1, &(mesh.uv_buffer));
-    glDeleteBuffers(1, &(mesh.index_buffer));
-    glDeleteVertexArrays(1, &(mesh.vertex_array));
-  }
   for (const auto& texture : textures_) {
     glDeleteTextures(1, &(texture.texture));
+    if (texture.buffer != 0)
+      glDeleteBuffers(1, &(texture.buffer));
   }
+  if (material_buffer_ != 0)
+    glDeleteBuffers(1, &material_buffer_);
+  for (const RetiredObject& object : retired_objects_)
+    delete_(object);
+  retired_objects_.clear();
+  // After the retired ranges, which were given back to it.
+  mesh_buffer_.cleanup();
+  material_buffer_ranges_.clear();
+}
+
+std::string ResourceManager::load_shader_sources_(const std::string& path) {
+  std::cout << "Loading shader: " << path << "\n";
+  std::ifstream stream(path);
+  stream.seekg(0, std::ios_base::end);
+  size_t length = stream.tellg();
+  stream.seekg(0, std::ios_base::beg);
+  std::string sources(length, '\0');
+  stream.read(&sources[0], length);
+  return sources;
 }
 
 GLuint ResourceManager::build_shader_(GLenum type, const std::string& sources) {
@@ -105,8 +136,16 @@ GLuint ResourceManager::link_gpu_program_(GLuint vertex_shader,
   CHECK_GL_ERROR;
   glAttachShader(gpu_program, fragment_shader);
   CHECK_GL_ERROR;
+  glProgramParameteri(gpu_program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT,
+                      GL_TRUE);
   glLinkProgram(gpu_program);
   CHECK_GL_ERROR;
+  // The program keeps its own copy of the binaries, shaders aren't needed
+  // anymore.
+  glDetachShader(gpu_program, vertex_shader);
+  glDetachShader(gpu_program, fragment_shader);
+  glDeleteShader(vertex_shader);
+  glDeleteShader(fragment_shader);
   char info_log[1000];
   GLsizei log_length;
   glGetProgramInfoLog(gpu_program, sizeof(info_log), &log_length, info_log);
@@ -118,22 +157,52 @@ GLuint ResourceManager::link_gpu_program_(GLuint vertex_shader,
   return gpu_program;
 }
 
+void ResourceManager::bind_uniform_blocks_(const GpuProgram& program) {
+  for (std::size_t i = 0; i < uniform_block_ids_.size(); ++i) {
+    GLuint index = program.get_uniform_block_index(uniform_block_ids_[i]);
+    if (index != GL_INVALID_INDEX)
+      glUniformBlockBinding(program.handle, index, static_cast<GLuint>(i));
+  }
+  CHECK_GL_ERROR;
+}
+
+void ResourceManager::bind_samplers_(const GpuProgram& program) {
+  GLint location = program.get_uniform_location(name_id::kDrawBuffer);
+  if (location == -1)
+    return;
+  // Even when it isn't read, a sampler left on unit 0 next to one of
+  // another type makes draws fail validation.
+  glUseProgram(program.handle);
+  glUniform1i(location, kDrawBufferTextureUnit);
+  glUseProgram(0);
+  CHECK_GL_ERROR;
+}
+
 uint32_t ResourceManager::load_gpu_program_from_file(
     const std::string& vs_path,
     const std::string& fs_path) {
-  GLuint vertex_shader_id = load_shader_<GL_VERTEX_SHADER>(vs_path);
-  GLuint fragment_shader_id = load_shader_<GL_FRAGMENT_SHADER>(fs_path);
-  GLuint program_id = link_gpu_program_(vertex_shader_id, fragment_shader_id);
+  return load_gpu_program_from_sources(load_shader_sources_(vs_path),
+                                       load_shader_sources_(fs_path));
+}
 
-  GpuProgram program;
-  program.handle = program_id;
+uint32_t ResourceManager::load_gpu_program_from_sources(
+    const std::string& vs_sources,
+    const std::string& fs_sources) {
+  GLuint program_id = program_cache_.load(vs_sources, fs_sources);
+  if (program_id == 0) {
+    GLuint vertex_shader_id = build_vertex_shader_(vs_sources);
+    GLuint fragment_shader_id = build_fragment_shader_(fs_sources);
+    program_id = link_gpu_program_(vertex_shader_id, fragment_shader_id);
+    program_cache_.store(program_id, vs_sources, fs_sources);
+  }
 
-  program.position_location = glGetAttribLocation(program_id, "position");
-  program.uv_location = glGetAttribLocation(program_id, "uv");
+  GpuProgram program(program_id);
+  program.reflect();
+  // Block and sampler bindings aren't part of the program binary.
+  bind_uniform_blocks_(program);
+  bind_samplers_(program);
 
-  uint32_t id = static_cast<uint32_t>(gpu_programs_.size());
-  gpu_programs_.push_back(program);
-  return id;
+  return gpu_programs_.insert(std::move(program));
 }
 
 GLenum ResourceManager::sdl_to_gl_pixel_format_(SDL_PixelFormat* format) {
@@ -175,9 +244,10 @@ GLuint ResourceManager::load_texture_(uint8_t* pixels, int width, int height) {
 
   glGenTextures(1, &texture);
   glBindTexture(GL_TEXTURE_2D, texture);
+  // Pixels are tightly packed RGBA rows, upload them in one go.
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
   glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, type,
-               nullptr);
-  glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA, type, pixels);
+               pixels);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
@@ -199,9 +269,7 @@ uint32_t ResourceManager::load_texture_from_memory(uint8_t* pixels,
                                                    int height) {
   std::cout << "Loading texture from memory.\n";
   GLuint texture = load_texture_(pixels, width, height);
-  uint32_t id = static_cast<uint32_t>(textures_.size());
-  textures_.push_back(Texture(texture));
-  return id;
+  return textures_.insert(Texture(texture));
 }
 
 uint32_t ResourceManager::create_mesh(
@@ -209,61 +277,83 @@ uint32_t ResourceManager::create_mesh(
     const std::vector<float>& normals,
     const std::vector<float>& uvs,
     const std::vector<float>& tangents,
-    const std::vector<float>& bitangents,
+    const std::vector<float>& /*bitangents*/,
     const std::vector<unsigned int>& indices) {
-  GLuint vertex_array;
-  glGenVertexArrays(1, &vertex_array);
-  glBindVertexArray(vertex_array);
-
-  GLuint position_buffer;
-  glGenBuffers(1, &position_buffer);
-  glBindBuffer(GL_ARRAY_BUFFER, position_buffer);
-  glBufferData(GL_ARRAY_BUFFER, sizeof(float) * positions.size(), &positions[0],
-               GL_STATIC_DRAW);
-
-  GLuint normal_buffer;
-  glGenBuffers(1, &normal_buffer);
-  glBindBuffer(GL_ARRAY_BUFFER, normal_buffer);
-  glBufferData(GL_ARRAY_BUFFER, sizeof(float) * normals.size(), &normals[0],
-               GL_STATIC_DRAW);
-
-  GLuint uv_buffer;
-  glGenBuffers(1, &uv_buffer);
-  glBindBuffer(GL_ARRAY_BUFFER, uv_buffer);
-  glBufferData(GL_ARRAY_BUFFER, sizeof(float) * uvs.size(), &uvs[0],
-               GL_STATIC_DRAW);
-
-  GLuint tangent_buffer;
-  glGenBuffers(1, &tangent_buffer);
-  glBindBuffer(GL_ARRAY_BUFFER, tangent_buffer);
-  glBufferData(GL_ARRAY_BUFFER, sizeof(float) * tangents.size(), &tangents[0],
-               GL_STATIC_DRAW);
-
-  GLuint bitangent_buffer;
-  glGenBuffers(1, &bitangent_buffer);
-  glBindBuffer(GL_ARRAY_BUFFER, bitangent_buffer);
-  glBufferData(GL_ARRAY_BUFFER, sizeof(float) * bitangents.size(),
-               &bitangents[0], GL_STATIC_DRAW);
-
-  GLuint index_buffer;
-  glGenBuffers(1, &index_buffer);
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * indices.size(),
-               &indices[0], GL_STATIC_DRAW);
-
-  uint32_t id = static_cast<uint32_t>(meshes_.size());
-  meshes_.push_back(Mesh(position_buffer, normal_buffer, uv_buffer,
-                         tangent_buffer, bitangent_buffer, index_buffer,
-                         vertex_array));
-  return id;
+  // Bitangents aren't uploaded, shaders rebuild them from the normals and
+  // tangents.
+  GLint base_vertex;
+  GLuint first_index;
+  mesh_buffer_.add({&positions, &normals, &uvs, &tangents}, indices,
+                   base_vertex, first_index);
+  return meshes_.insert(Mesh(base_vertex,
+                             static_cast<GLuint>(positions.size() / 3),
+                             first_index,
+                             static_cast<GLuint>(indices.size())));
+}
+
+DrawElementsIndirect ResourceManager::get_mesh_draw(uint32_t id) const {
+  const Mesh& mesh = meshes_[id];
+  return {mesh.index_count, 1, mesh.first_index, mesh.base_vertex, 0};
 }
 
 uint32_t ResourceManager::create_material(uint32_t gpu_program) {
-  uint32_t id = static_cast<uint32_t>(materials_.size());
-  materials_.push_back(Material(*this, gpu_program));
+  uint32_t id = materials_.emplace(*this, gpu_program);
+  Material& material = materials_[id];
+  std::size_t size = material.get_parameters().size();
+  if (size > 0)
+    material.parameters_offset = allocate_material_parameters_(size);
   return id;
 }
 
+std::size_t ResourceManager::allocate_material_parameters_(std::size_t size) {
+  if (material_buffer_alignment_ == 0) {
+    GLint alignment;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    material_buffer_alignment_ = static_cast<std::size_t>(alignment);
+  }
+  return material_buffer_ranges_.allocate(size, material_buffer_alignment_);
+}
+
+void ResourceManager::grow_material_buffer_() {
+  // Materials are created while loading, growing happens a handful of times
+  // at most. The old contents are dropped and every material uploads itself
+  // again the next time it is bound.
+  if (material_buffer_ == 0)
+    glGenBuffers(1, &material_buffer_);
+  material_buffer_capacity_ =
+      std::max(material_buffer_ranges_.get_size(),
+               material_buffer_capacity_ * 2);
+  glBindBuffer(GL_UNIFORM_BUFFER, material_buffer_);
+  glBufferData(GL_UNIFORM_BUFFER,
+               static_cast<GLsizeiptr>(material_buffer_capacity_), nullptr,
+               GL_DYNAMIC_DRAW);
+  CHECK_GL_ERROR;
+  for (Material& material : materials_)
+    material.set_parameters_dirty(true);
+}
+
+void ResourceManager::bind_material_parameters(uint32_t id) {
+  Material& material = materials_[id];
+  const std::vector<uint8_t>& parameters = material.get_parameters();
+  if (parameters.empty())
+    return;
+  if (material_buffer_capacity_ < material_buffer_ranges_.get_size())
+    grow_material_buffer_();
+  if (material.are_parameters_dirty()) {
+    glBindBuffer(GL_UNIFORM_BUFFER, material_buffer_);
+    glBufferSubData(GL_UNIFORM_BUFFER,
+                    static_cast<GLintptr>(material.parameters_offset),
+                    static_cast<GLsizeiptr>(parameters.size()),
+                    parameters.data());
+    material.set_parameters_dirty(false);
+  }
+  glBindBufferRange(GL_UNIFORM_BUFFER,
+                    static_cast<GLuint>(UniformBlockBinding::kMaterial),
+                    material_buffer_,
+                    static_cast<GLintptr>(material.parameters_offset),
+                    static_cast<GLsizeiptr>(parameters.size()));
+}
+
 uint32_t ResourceManager::create_texture(std::size_t width,
                                          std::size_t height,
                                          pixel::Format format,
@@ -282,9 +372,46 @@ uint32_t ResourceManager::create_texture(std::size_t width,
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_NONE);
-  uint32_t id = static_cast<uint32_t>(textures_.size());
-  textures_.push_back(Texture(texture));
-  return id;
+  return textures_.insert(Texture(texture));
+}
+
+uint32_t ResourceManager::create_texture_buffer(pixel::BufferFormat format) {
+  GLuint buffer;
+  glGenBuffers(1, &buffer);
+  glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+  GLuint texture;
+  glGenTextures(1, &texture);
+  glBindTexture(GL_TEXTURE_BUFFER, texture);
+  glTexBuffer(GL_TEXTURE_BUFFER,
+              buffer_formats_[static_cast<std::size_t>(format)], buffer);
+  CHECK_GL_ERROR;
+  return textures_.insert(Texture(texture, buffer));
+}
+
+void ResourceManager::update_texture_buffer(uint32_t id,
+                                            GLuint source,
+                                            std::size_t source_offset,
+                                            std::size_t size,
+                                            std::size_t buffer_offset) {
+  Texture& texture = textures_[id];
+  assert(texture.target == GL_TEXTURE_BUFFER);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, texture.buffer);
+  if (texture.buffer_capacity < buffer_offset + size) {
+    // The texture keeps pointing at the buffer object, no need to call
+    // glTexBuffer again after reallocating its storage. The commands
+    // executed so far keep reading the old storage, the ones after only
+    // read what's updated from now on.
+    texture.buffer_capacity =
+        std::max(buffer_offset + size, texture.buffer_capacity * 2);
+    glBufferData(GL_COPY_WRITE_BUFFER,
+                 static_cast<GLsizeiptr>(texture.buffer_capacity), nullptr,
+                 GL_STREAM_DRAW);
+  }
+  glBindBuffer(GL_COPY_READ_BUFFER, source);
+  glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                      static_cast<GLintptr>(source_offset),
+                      static_cast<GLintptr>(buffer_offset),
+                      static_cast<GLsizeiptr>(size));
 }
 
 uint32_t ResourceManager::create_framebuffer(
@@ -302,10 +429,8 @@ uint32_t ResourceManager::create_framebuffer(
   glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D,
                          get_texture(depth_rt_id).texture, 0);
   check_gl_framebuffer(GL_FRAMEBUFFER);
-  uint32_t id = static_cast<uint32_t>(framebuffers_.size());
-  framebuffers_.push_back(
+  return framebuffers_.insert(
       Framebuffer(framebuffer, static_cast<GLenum>(color_rt_ids.size())));
-  return id;
 }
 
 uint32_t ResourceManager::create_framebuffer(
@@ -318,6 +443,10 @@ uint32_t ResourceManager::create_framebuffer(
     if (texture->format == pixel::Format::kDepthComponent) {
       glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D,
                              get_texture(texture->gpu_resource_id).texture, 0);
+    } else if (texture->format == pixel::Format::kDepthStencil) {
+      glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT,
+                             GL_TEXTURE_2D,
+                             get_texture(texture->gpu_resource_id).texture, 0);
     } else {
       glFramebufferTexture2D(
           GL_FRAMEBUFFER,
@@ -327,15 +456,12 @@ uint32_t ResourceManager::create_framebuffer(
     }
   }
   check_gl_framebuffer(GL_FRAMEBUFFER);
-  uint32_t id = static_cast<uint32_t>(framebuffers_.size());
-  framebuffers_.push_back(
+  return framebuffers_.insert(
       Framebuffer(framebuffer, static_cast<GLenum>(color_rt_id)));
-  return id;
 }
 
 uint32_t ResourceManager::create_state(const render::State& state) {
-  states_.push_back(State(state));
-  return static_cast<uint32_t>(states_.size()) - 1;
+  return states_.emplace(state);
 }
 
 const GpuProgram& ResourceManager::get_gpu_program(uint32_t id) const {
@@ -346,6 +472,10 @@ const Mesh& ResourceManager::get_mesh(uint32_t id) const {
   return meshes_[id];
 }
 
+MeshBuffer& ResourceManager::get_mesh_buffer() {
+  return mesh_buffer_;
+}
+
 const Texture& ResourceManager::get_texture(uint32_t id) const {
   return textures_[id];
 }
@@ -362,6 +492,90 @@ AMaterial& ResourceManager::get_material(std::uint32_t id) {
   return materials_[id];
 }
 
+void ResourceManager::retire_(RetiredObject::Type type, GLuint name) {
+  retired_objects_.push_back({type, name, 0, 0, frame_count_});
+}
+
+void ResourceManager::retire_range_(RetiredObject::Type type,
+                                    std::size_t offset,
+                                    std::size_t size) {
+  retired_objects_.push_back({type, 0, offset, size, frame_count_});
+}
+
+void ResourceManager::delete_(const RetiredObject& object) {
+  switch (object.type) {
+    case RetiredObject::Type::kTexture:
+      glDeleteTextures(1, &object.name);
+      break;
+    case RetiredObject::Type::kBuffer:
+      glDeleteBuffers(1, &object.name);
+      break;
+    case RetiredObject::Type::kProgram:
+      glDeleteProgram(object.name);
+      break;
+    case RetiredObject::Type::kVertices:
+      mesh_buffer_.remove(static_cast<GLint>(object.offset), object.size, 0,
+                          0);
+      break;
+    case RetiredObject::Type::kIndices:
+      mesh_buffer_.remove(0, 0, static_cast<GLuint>(object.offset),
+                          object.size);
+      break;
+    case RetiredObject::Type::kMaterialParameters:
+      material_buffer_ranges_.free(object.offset, object.size);
+      break;
+  }
+}
+
+void ResourceManager::destroy_texture(uint32_t id) {
+  const Texture& texture = textures_[id];
+  retire_(RetiredObject::Type::kTexture, texture.texture);
+  if (texture.buffer != 0)
+    retire_(RetiredObject::Type::kBuffer, texture.buffer);
+  textures_.erase(id);
+}
+
+void ResourceManager::destroy_gpu_program(uint32_t id) {
+  retire_(RetiredObject::Type::kProgram, gpu_programs_[id].handle);
+  gpu_programs_.erase(id);
+}
+
+void ResourceManager::destroy_mesh(uint32_t id) {
+  const Mesh& mesh = meshes_[id];
+  retire_range_(RetiredObject::Type::kVertices,
+                static_cast<std::size_t>(mesh.base_vertex), mesh.vertex_count);
+  retire_range_(RetiredObject::Type::kIndices, mesh.first_index,
+                mesh.index_count);
+  meshes_.erase(id);
+}
+
+void ResourceManager::destroy_material(uint32_t id) {
+  Material& material = materials_[id];
+  std::size_t size = material.get_parameters().size();
+  if (size > 0) {
+    retire_range_(RetiredObject::Type::kMaterialParameters,
+                  material.parameters_offset, size);
+  }
+  materials_.erase(id);
+}
+
+void ResourceManager::destroy_state(uint32_t id) {
+  states_.erase(id);
+}
+
+void ResourceManager::end_frame() {
+  ++frame_count_;
+}
+
+// Objects are retired in order, the oldest ones are at the front.
+void ResourceManager::release_retired(std::size_t frames_in_flight) {
+  while (!retired_objects_.empty() &&
+         retired_objects_.front().frame + frames_in_flight <= frame_count_) {
+    delete_(retired_objects_.front());
+    retired_objects_.pop_front();
+  }
+}
+
 }  // namespace gl
 }  // namespace render
 }  // namespace donkey
@@ -48,6 +48,24 @@ GLint State::blending_factor_map_[] = {GL_ZERO,
 GLint State::blending_function_map_[] = {
     GL_FUNC_ADD, GL_FUNC_SUBTRACT, GL_FUNC_REVERSE_SUBTRACT, GL_MIN, GL_MAX};
 
+GLenum State::comparison_function_map_[] = {
+    GL_NEVER,  GL_LESS,  GL_LEQUAL,   GL_GREATER,
+    GL_GEQUAL, GL_EQUAL, GL_NOTEQUAL, GL_ALWAYS};
+
+GLenum State::stencil_operation_map_[] = {
+    GL_KEEP,      GL_ZERO, GL_REPLACE,   GL_INCR,
+    GL_INCR_WRAP, GL_DECR, GL_DECR_WRAP, GL_INVERT};
+
+StencilFaceState State::make_stencil_face_state_(
+    const render::StencilFaceState& state) {
+  return {comparison_function_map_[static_cast<size_t>(state.function)],
+          static_cast<GLint>(state.reference),
+          static_cast<GLuint>(state.mask),
+          stencil_operation_map_[static_cast<size_t>(state.stencil_fail)],
+          stencil_operation_map_[static_cast<size_t>(state.depth_fail)],
+          stencil_operation_map_[static_cast<size_t>(state.depth_pass)]};
+}
+
 State::State(GLint viewport[4], GLint scissor_box[4])
     : blend_equation_rgb(GL_FUNC_ADD),
       blend_equation_alpha(GL_FUNC_ADD),
@@ -56,13 +74,19 @@ State::State(GLint viewport[4], GLint scissor_box[4])
       blend_destination_alpha(GL_ONE),
       blend_destination_rgb(GL_ONE),
       cull_mode(GL_BACK),
+      depth_function(GL_LESS),
+      stencil_front{GL_ALWAYS, 0, 0xff, GL_KEEP, GL_KEEP, GL_KEEP},
+      stencil_back{GL_ALWAYS, 0, 0xff, GL_KEEP, GL_KEEP, GL_KEEP},
       depth_test_enabled(GL_TRUE),
+      depth_write_enabled(GL_TRUE),
+      color_write_enabled(GL_TRUE),
       stencil_test_enabled(GL_FALSE),
       scissor_test_enabled(GL_FALSE),
       blending_enabled(GL_FALSE),
       face_culling_enabled(GL_FALSE) {
-  std::copy(&(viewport[0]), &(viewport[3]), &(this->viewport[0]));
-  std::copy(&(scissor_box[0]), &(scissor_box[3]), &(this->scissor_box[0]));
+  std::copy(&(viewport[0]), &(viewport[0]) + 4, &(this->viewport[0]));
+  std::copy(&(scissor_box[0]), &(scissor_box[0]) + 4,
+            &(this->scissor_box[0]));
 }
 
 State::State(const render::State& state)
@@ -79,13 +103,19 @@ State::State(const render::State& state)
       blend_destination_rgb(blending_factor_map_[static_cast<size_t>(
           state.blend_destination_rgb)]),
       cull_mode(cull_mode_map_[static_cast<size_t>(state.cull_mode)]),
+      depth_function(comparison_function_map_[static_cast<size_t>(
+          state.depth_function)]),
+      stencil_front(make_stencil_face_state_(state.stencil_front)),
+      stencil_back(make_stencil_face_state_(state.stencil_back)),
       depth_test_enabled(static_cast<GLboolean>(state.depth_test_enabled)),
+      depth_write_enabled(static_cast<GLboolean>(state.depth_write_enabled)),
+      color_write_enabled(static_cast<GLboolean>(state.color_write_enabled)),
       stencil_test_enabled(static_cast<GLboolean>(state.stencil_test_enabled)),
       scissor_test_enabled(static_cast<GLboolean>(state.scissor_test_enabled)),
       blending_enabled(static_cast<GLboolean>(state.blending_enabled)),
       face_culling_enabled(static_cast<GLboolean>(state.face_culling_enabled)) {
-  std::copy(&(state.viewport[0]), &(state.viewport[3]), &(viewport[0]));
-  std::copy(&(state.scissor_box[0]), &(state.scissor_box[3]),
+  std::copy(&(state.viewport[0]), &(state.viewport[0]) + 4, &(viewport[0]));
+  std::copy(&(state.scissor_box[0]), &(state.scissor_box[0]) + 4,
             &(scissor_box[0]));
 }
 
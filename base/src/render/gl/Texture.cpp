@@ -21,7 +21,14 @@ namespace donkey {
 namespace render {
 namespace gl {
 
-Texture::Texture(GLuint texture) : texture(texture) {}
+Texture::Texture(GLuint texture)
+    : texture(texture), target(GL_TEXTURE_2D), buffer(0), buffer_capacity(0) {}
+
+Texture::Texture(GLuint texture, GLuint buffer)
+    : texture(texture),
+      target(GL_TEXTURE_BUFFER),
+      buffer(buffer),
+      buffer_capacity(0) {}
 
 }  // namespace gl
 }  // namespace render
@@ -0,0 +1,184 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "render/gl/UniformRing.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#include "common.hpp"
+
+namespace donkey {
+namespace render {
+namespace gl {
+
+UniformRing::UniformRing(std::size_t frame_size)
+    : buffer_(0),
+      frame_size_(0),
+      alignment_(0),
+      frame_(0),
+      persistent_(has_buffer_storage_()),
+      mapping_(nullptr),
+      fences_({nullptr, nullptr, nullptr}) {
+  GLint alignment;
+  glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+  alignment_ = static_cast<std::size_t>(alignment);
+  // Each region has to start on a valid binding offset.
+  frame_size_ = (frame_size + alignment_ - 1) / alignment_ * alignment_;
+  allocate_();
+}
+
+void UniformRing::allocate_() {
+  GLsizeiptr size = static_cast<GLsizeiptr>(frame_size_ * kFrameCount);
+  glGenBuffers(1, &buffer_);
+  glBindBuffer(GL_UNIFORM_BUFFER, buffer_);
+  if (persistent_) {
+    GLbitfield flags =
+        GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glBufferStorage(GL_UNIFORM_BUFFER, size, nullptr, flags);
+    mapping_ = static_cast<uint8_t*>(
+        glMapBufferRange(GL_UNIFORM_BUFFER, 0, size, flags));
+  } else {
+    glBufferData(GL_UNIFORM_BUFFER, size, nullptr, GL_STREAM_DRAW);
+  }
+  CHECK_GL_ERROR;
+}
+
+UniformRing::~UniformRing() {
+  for (GLsync fence : fences_) {
+    if (fence)
+      glDeleteSync(fence);
+  }
+  if (mapping_) {
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer_);
+    glUnmapBuffer(GL_UNIFORM_BUFFER);
+  }
+  glDeleteBuffers(1, &buffer_);
+}
+
+bool UniformRing::has_buffer_storage_() {
+  if (gl3wIsSupported(4, 4))
+    return true;
+  GLint extension_count;
+  glGetIntegerv(GL_NUM_EXTENSIONS, &extension_count);
+  for (GLint i = 0; i < extension_count; ++i) {
+    const char* extension = reinterpret_cast<const char*>(
+        glGetStringi(GL_EXTENSIONS, static_cast<GLuint>(i)));
+    if (std::strcmp(extension, "GL_ARB_buffer_storage") == 0)
+      return true;
+  }
+  return false;
+}
+
+void UniformRing::wait_for_frame_() {
+  GLsync fence = fences_[frame_];
+  if (!fence)
+    return;
+  const GLuint64 timeout = 1000000;  // 1ms
+  GLenum status;
+  do {
+    status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+  } while (status == GL_TIMEOUT_EXPIRED);
+  assert(status != GL_WAIT_FAILED);
+  glDeleteSync(fence);
+  fences_[frame_] = nullptr;
+}
+
+UniformStorage UniformRing::begin_frame() {
+  wait_for_frame_();
+  uint8_t* data;
+  if (persistent_) {
+    data = mapping_ + get_frame_offset();
+  } else {
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer_);
+    mapping_ = static_cast<uint8_t*>(glMapBufferRange(
+        GL_UNIFORM_BUFFER, static_cast<GLintptr>(get_frame_offset()),
+        static_cast<GLsizeiptr>(frame_size_),
+        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT |
+            GL_MAP_UNSYNCHRONIZED_BIT));
+    data = mapping_;
+  }
+  assert(data != nullptr);
+  return {data, frame_size_, alignment_};
+}
+
+void UniformRing::flush() {
+  if (persistent_ || !mapping_)
+    return;
+  glBindBuffer(GL_UNIFORM_BUFFER, buffer_);
+  glUnmapBuffer(GL_UNIFORM_BUFFER);
+  mapping_ = nullptr;
+}
+
+void UniformRing::end_frame() {
+  fences_[frame_] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  frame_ = (frame_ + 1) % kFrameCount;
+}
+
+void UniformRing::grow(std::size_t frame_size,
+                       const uint8_t* overflow,
+                       std::size_t size) {
+  assert(persistent_ || !mapping_);
+  GLuint old_buffer = buffer_;
+  std::size_t old_frame_size = frame_size_;
+  std::size_t old_frame_offset = get_frame_offset();
+  if (mapping_) {
+    glBindBuffer(GL_UNIFORM_BUFFER, old_buffer);
+    glUnmapBuffer(GL_UNIFORM_BUFFER);
+    mapping_ = nullptr;
+  }
+  // Doubling at least, so that a scene growing a bit every frame doesn't
+  // reallocate every frame.
+  frame_size = std::max(frame_size, 2 * frame_size_);
+  frame_size_ = (frame_size + alignment_ - 1) / alignment_ * alignment_;
+  allocate_();
+
+  // The old buffer is deleted right away. The GL keeps its storage alive for
+  // the frames in flight reading it, and their fences still tell when the
+  // regions of the new buffer are free, so nothing waits here.
+  glBindBuffer(GL_COPY_READ_BUFFER, old_buffer);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, buffer_);
+  glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                      static_cast<GLintptr>(old_frame_offset),
+                      static_cast<GLintptr>(get_frame_offset()),
+                      static_cast<GLsizeiptr>(old_frame_size));
+  GLintptr overflow_offset =
+      static_cast<GLintptr>(get_frame_offset() + old_frame_size);
+  if (persistent_) {
+    // Storage without GL_DYNAMIC_STORAGE_BIT can't take glBufferSubData.
+    std::memcpy(mapping_ + overflow_offset, overflow, size);
+  } else {
+    glBufferSubData(GL_COPY_WRITE_BUFFER, overflow_offset,
+                    static_cast<GLsizeiptr>(size), overflow);
+  }
+  glDeleteBuffers(1, &old_buffer);
+  CHECK_GL_ERROR;
+}
+
+GLuint UniformRing::get_buffer() const {
+  return buffer_;
+}
+
+std::size_t UniformRing::get_frame_offset() const {
+  return frame_ * frame_size_;
+}
+
+}  // namespace gl
+}  // namespace render
+}  // namespace donkey
@@ -0,0 +1,338 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "render/headless/Driver.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+#include <limits>
+
+namespace donkey {
+namespace render {
+namespace headless {
+
+const std::array<const char*, Driver::kCommandTypeCount>
+    Driver::command_names_ = {{"bind_mesh",
+                               "draw_elements",
+                               "bind_uniform_float",
+                               "bind_uniform_int",
+                               "bind_uniform_vec2",
+                               "bind_uniform_vec3",
+                               "bind_uniform_vec4",
+                               "bind_uniform_mat2",
+                               "bind_uniform_mat3",
+                               "bind_uniform_mat4",
+                               "bind_texture",
+                               "bind_framebuffer",
+                               "set_viewport",
+                               "set_depth_test",
+                               "clear_framebuffer",
+                               "bind_gpu_program",
+                               "set_blending",
+                               "set_state",
+                               "bind_uniform_block",
+                               "bind_material_parameters",
+                               "update_texture_buffer",
+                               "count_samples",
+                               "multi_draw_elements"}};
+
+Driver::Driver()
+    : uniform_storage_(kUniformFrameSize),
+      log_(nullptr),
+      draw_call_count_(0),
+      program_id_(-1),
+      mesh_id_(-1),
+      framebuffer_id_(std::numeric_limits<uint32_t>::max()) {
+  reset_statistics();
+}
+
+Driver::~Driver() {}
+
+UniformStorage Driver::begin_frame() {
+  return {uniform_storage_.data(), uniform_storage_.size(), kUniformAlignment};
+}
+
+void Driver::execute_commands(const CommandBucket& commands) {
+  program_id_ = -1;
+  mesh_id_ = -1;
+  framebuffer_id_ = std::numeric_limits<uint32_t>::max();
+  texture_ids_.clear();
+  draw_call_count_ = 0;
+  // Grows like gl::UniformRing, keeping what the frame wrote so far.
+  const std::vector<uint8_t>& overflow = commands.get_uniform_overflow();
+  if (!overflow.empty()) {
+    std::size_t capacity = uniform_storage_.size();
+    std::size_t size = std::max(commands.get_uniform_storage_size(),
+                                2 * capacity);
+    uniform_storage_.resize((size + kUniformAlignment - 1) /
+                            kUniformAlignment * kUniformAlignment);
+    std::copy(overflow.begin(), overflow.end(),
+              uniform_storage_.begin() + static_cast<std::ptrdiff_t>(capacity));
+  }
+  if (log_)
+    *log_ << "frame " << statistics_.frame_count << '\n';
+  for (auto sorted_command : commands.get_commands()) {
+    const Command& command = sorted_command.command;
+    std::size_t command_type = sorted_command.sort_key & kCommandTypeMask;
+    assert(command_type == static_cast<std::size_t>(command.type));
+    check_command_(command);
+    ++statistics_.command_counts[command_type];
+    ++statistics_.command_count;
+    if (log_)
+      write_command_(command);
+  }
+  statistics_.draw_call_count += draw_call_count_;
+  ++statistics_.frame_count;
+}
+
+ResourceManager& Driver::get_resource_manager() {
+  return resource_manager_;
+}
+
+uint64_t Driver::get_samples_passed() const {
+  return 0;
+}
+
+std::size_t Driver::get_draw_call_count() const {
+  return draw_call_count_;
+}
+
+float Driver::get_gpu_frame_time() const {
+  return 0.0f;
+}
+
+void Driver::set_log(std::ostream* log) {
+  log_ = log;
+}
+
+const Driver::Statistics& Driver::get_statistics() const {
+  return statistics_;
+}
+
+void Driver::reset_statistics() {
+  statistics_ = Statistics();
+  statistics_.command_counts.fill(0);
+}
+
+const char* Driver::get_command_name(Command::Type type) {
+  return command_names_[static_cast<std::size_t>(type)];
+}
+
+void Driver::report_(const Command& command, const char* error) const {
+  std::cerr << get_command_name(command.type) << ": " << error << '\n';
+  assert(false);
+}
+
+bool Driver::check_storage_range_(const Command& command,
+                                  std::size_t offset,
+                                  std::size_t size) const {
+  if (offset + size <= uniform_storage_.size())
+    return true;
+  report_(command, "reads past the end of the uniform storage");
+  return false;
+}
+
+// Sampling a texture attached to the framebuffer drawn to is undefined, even
+// when the draw does not write to it (4.4.3 of the OpenGL 4.1 core profile).
+// Textures are forgotten when the framebuffer changes, the passes bind what
+// they sample after their framebuffer.
+void Driver::check_feedback_loop_(const Command& command) const {
+  if (framebuffer_id_ == std::numeric_limits<uint32_t>::max())
+    return;
+  for (uint32_t attachment : resource_manager_.get_framebuffer(framebuffer_id_))
+    for (uint32_t texture_id : texture_ids_)
+      if (texture_id == attachment)
+        report_(command, "samples a texture attached to the framebuffer");
+}
+
+// Does what the GL would complain about, or silently get wrong, and counts
+// the draws.
+void Driver::check_command_(const Command& command) {
+  const ResourceManager& resources = resource_manager_;
+  switch (command.type) {
+    case Command::Type::kBindMesh: {
+      const auto& bind = static_cast<const BindMeshCommand&>(command);
+      if (!resources.has_mesh(bind.mesh_id))
+        report_(command, "unknown or destroyed mesh");
+      mesh_id_ = bind.mesh_id;
+      break;
+    }
+    case Command::Type::kDrawElements: {
+      const auto& draw = static_cast<const DrawElementsCommand&>(command);
+      if (program_id_ < 0 || mesh_id_ < 0)
+        report_(command, "draws without a program or a mesh bound");
+      check_feedback_loop_(command);
+      ++draw_call_count_;
+      statistics_.index_count += draw.count;
+      break;
+    }
+    case Command::Type::kBindTexture: {
+      const auto& bind = static_cast<const BindTextureCommand&>(command);
+      if (!resources.has_texture(bind.texture_id))
+        report_(command, "unknown or destroyed texture");
+      if (bind.texture_unit >= texture_ids_.size())
+        texture_ids_.resize(bind.texture_unit + 1,
+                            std::numeric_limits<uint32_t>::max());
+      texture_ids_[bind.texture_unit] = bind.texture_id;
+      break;
+    }
+    case Command::Type::kBindFramebuffer: {
+      const auto& bind = static_cast<const BindFramebufferCommand&>(command);
+      if (bind.framebuffer_id != std::numeric_limits<uint32_t>::max() &&
+          !resources.has_framebuffer(bind.framebuffer_id))
+        report_(command, "unknown or destroyed framebuffer");
+      framebuffer_id_ = bind.framebuffer_id;
+      texture_ids_.clear();
+      break;
+    }
+    case Command::Type::kBindGpuProgram: {
+      const auto& bind = static_cast<const BindGpuProgramCommand&>(command);
+      if (!resources.has_gpu_program(bind.program_id))
+        report_(command, "unknown or destroyed program");
+      program_id_ = bind.program_id;
+      break;
+    }
+    case Command::Type::kSetState: {
+      const auto& set = static_cast<const SetStateCommand&>(command);
+      if (!resources.has_state(set.state_id))
+        report_(command, "unknown or destroyed state");
+      break;
+    }
+    case Command::Type::kBindUniformBlock: {
+      const auto& bind = static_cast<const BindUniformBlockCommand&>(command);
+      if (bind.offset % kUniformAlignment != 0)
+        report_(command, "misaligned block");
+      check_storage_range_(command, bind.offset, bind.size);
+      break;
+    }
+    case Command::Type::kBindMaterialParameters: {
+      const auto& bind =
+          static_cast<const BindMaterialParametersCommand&>(command);
+      if (!resources.has_material(bind.material_id))
+        report_(command, "unknown or destroyed material");
+      break;
+    }
+    case Command::Type::kUpdateTextureBuffer: {
+      const auto& update =
+          static_cast<const UpdateTextureBufferCommand&>(command);
+      if (!resources.has_texture(update.texture_id) ||
+          !resources.get_texture(update.texture_id).is_buffer) {
+        report_(command, "unknown texture buffer");
+        break;
+      }
+      if (!check_storage_range_(command, update.offset, update.size))
+        break;
+      resource_manager_.update_texture_buffer(
+          update.texture_id, uniform_storage_.data() + update.offset,
+          update.size, update.buffer_offset);
+      break;
+    }
+    case Command::Type::kMultiDrawElements: {
+      const auto& draw = static_cast<const MultiDrawElementsCommand&>(command);
+      if (program_id_ < 0 || mesh_id_ < 0)
+        report_(command, "draws without a program or a mesh bound");
+      check_storage_range_(command, draw.offset,
+                           draw.draws.size() * sizeof(DrawElementsIndirect));
+      check_feedback_loop_(command);
+      ++draw_call_count_;
+      for (const DrawElementsIndirect& indirect : draw.draws)
+        statistics_.index_count += indirect.count * indirect.instance_count;
+      break;
+    }
+    default:
+      break;
+  }
+}
+
+void Driver::write_command_(const Command& command) const {
+  std::ostream& log = *log_;
+  log << get_command_name(command.type);
+  switch (command.type) {
+    case Command::Type::kBindMesh:
+      log << ' ' << static_cast<const BindMeshCommand&>(command).mesh_id;
+      break;
+    case Command::Type::kDrawElements:
+      log << ' ' << static_cast<const DrawElementsCommand&>(command).count;
+      break;
+    case Command::Type::kBindTexture: {
+      const auto& bind = static_cast<const BindTextureCommand&>(command);
+      log << ' ' << bind.texture_unit << ' ' << bind.texture_id;
+      break;
+    }
+    case Command::Type::kBindFramebuffer:
+      log << ' '
+          << static_cast<const BindFramebufferCommand&>(command)
+                 .framebuffer_id;
+      break;
+    case Command::Type::kSetViewport: {
+      const auto& set = static_cast<const SetViewportCommand&>(command);
+      log << ' ' << set.position.x << ' ' << set.position.y << ' '
+          << set.size.x << ' ' << set.size.y;
+      break;
+    }
+    case Command::Type::kSetDepthTest:
+      log << ' ' << static_cast<const SetDepthTestCommand&>(command).enable;
+      break;
+    case Command::Type::kClearFramebuffer:
+      log << ' '
+          << static_cast<const ClearFramebufferCommand&>(command).buffers;
+      break;
+    case Command::Type::kBindGpuProgram:
+      log << ' '
+          << static_cast<const BindGpuProgramCommand&>(command).program_id;
+      break;
+    case Command::Type::kSetBlending:
+      log << ' ' << static_cast<const SetBlendingCommand&>(command).enable;
+      break;
+    case Command::Type::kSetState:
+      log << ' ' << static_cast<const SetStateCommand&>(command).state_id;
+      break;
+    case Command::Type::kBindUniformBlock: {
+      const auto& bind = static_cast<const BindUniformBlockCommand&>(command);
+      log << ' ' << bind.binding << ' ' << bind.offset << ' ' << bind.size;
+      break;
+    }
+    case Command::Type::kBindMaterialParameters:
+      log << ' '
+          << static_cast<const BindMaterialParametersCommand&>(command)
+                 .material_id;
+      break;
+    case Command::Type::kUpdateTextureBuffer: {
+      const auto& update =
+          static_cast<const UpdateTextureBufferCommand&>(command);
+      log << ' ' << update.texture_id << ' ' << update.buffer_offset << ' '
+          << update.size;
+      break;
+    }
+    case Command::Type::kCountSamples:
+      log << ' ' << static_cast<const CountSamplesCommand&>(command).begin;
+      break;
+    case Command::Type::kMultiDrawElements:
+      log << ' '
+          << static_cast<const MultiDrawElementsCommand&>(command)
+                 .draws.size();
+      break;
+    default:
+      break;
+  }
+  log << '\n';
+}
+
+}  // namespace headless
+}  // namespace render
+}  // namespace donkey
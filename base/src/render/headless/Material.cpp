@@ -0,0 +1,83 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "render/headless/Material.hpp"
+
+#include <cassert>
+#include <cstring>
+#include <iostream>
+
+namespace donkey {
+namespace render {
+namespace headless {
+
+Material::Material(uint32_t program_id) : AMaterial(program_id) {
+  position_location = kPositionLocation;
+  normal_location = kNormalLocation;
+  uv_location = kUvLocation;
+  tangent_location = kTangentLocation;
+  bitangent_location = kBitangentLocation;
+  draw_id_location = kDrawIdLocation;
+}
+
+// Appends the parameter the first time it's registered, overwrites it
+// afterwards.
+void Material::write_parameter_(const std::string& name,
+                                const void* data,
+                                std::size_t size) {
+  auto it = parameter_offsets_.find(name);
+  if (it == parameter_offsets_.end()) {
+    it = parameter_offsets_.emplace(name, parameters_.size()).first;
+    parameters_.resize(parameters_.size() + size, 0);
+  } else if (it->second + size > parameters_.size()) {
+    std::cerr << "Material parameter " << name
+              << " was registered again with a different type.\n";
+    assert(false);
+    return;
+  }
+  std::memcpy(parameters_.data() + it->second, data, size);
+  parameters_dirty_ = true;
+}
+
+#define DEFINE_REGISTER_SLOT(x, z)                                             \
+  void Material::register_##z##_slot(const std::string& name,                  \
+                                     const x& storage) {                       \
+    write_parameter_(name, &storage, sizeof(x));                               \
+  }
+
+DEFINE_REGISTER_SLOT(float, float)
+DEFINE_REGISTER_SLOT(glm::vec2, vector2)
+DEFINE_REGISTER_SLOT(glm::vec3, vector3)
+DEFINE_REGISTER_SLOT(glm::vec4, vector4)
+DEFINE_REGISTER_SLOT(glm::mat2, matrix2)
+DEFINE_REGISTER_SLOT(glm::mat3, matrix3)
+DEFINE_REGISTER_SLOT(glm::mat4, matrix4)
+DEFINE_REGISTER_SLOT(int, int)
+
+#undef DEFINE_REGISTER_SLOT
+
+// There's no program to look the sampler up in, the slot is bound to the
+// texture unit only.
+void Material::register_texture_slot(const std::string& /*name*/,
+                                     uint32_t texture_id,
+                                     int texture_unit) {
+  texture_slots_.push_back(TextureMaterialSlot(-1, texture_id, texture_unit));
+}
+
+}  // namespace headless
+}  // namespace render
+}  // namespace donkey
@@ -0,0 +1,263 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "render/headless/ResourceManager.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+
+namespace donkey {
+namespace render {
+namespace headless {
+
+// Bytes per texel of each pixel::InternalFormat, as a driver would most
+// likely store them.
+const std::array<std::size_t, 9> ResourceManager::texel_sizes_ = {
+    {3, 6, 4, 4, 4, 8, 4, 4, 4}};
+
+ResourceManager::ResourceManager() {
+  // Texture 0 stands for "no texture" on the GL too.
+  textures_.insert({0, 0, 0, false});
+}
+
+ResourceManager::~ResourceManager() {}
+
+void ResourceManager::cleanup() {
+  gpu_programs_.clear();
+  meshes_.clear();
+  textures_.clear();
+  textures_.insert({0, 0, 0, false});
+  framebuffers_.clear();
+  materials_.clear();
+  states_.clear();
+  vertex_ranges_.clear();
+  index_ranges_.clear();
+}
+
+uint32_t ResourceManager::load_texture_from_memory(uint8_t* /*pixels*/,
+                                                   int width,
+                                                   int height) {
+  return textures_.insert({static_cast<std::size_t>(width),
+                           static_cast<std::size_t>(height), 4, false});
+}
+
+uint32_t ResourceManager::load_gpu_program_from_file(
+    const std::string& vs_path,
+    const std::string& fs_path) {
+  return gpu_programs_.insert({vs_path, fs_path, "", ""});
+}
+
+uint32_t ResourceManager::load_gpu_program_from_sources(
+    const std::string& vs_sources,
+    const std::string& fs_sources) {
+  return gpu_programs_.insert({"", "", vs_sources, fs_sources});
+}
+
+// Lays meshes out like gl::MeshBuffer does, reusing the ranges of destroyed
+// ones, so that multi-draws get the same first indices and base vertices.
+uint32_t ResourceManager::create_mesh(
+    const std::vector<float>& positions,
+    const std::vector<float>& /*normals*/,
+    const std::vector<float>& /*uvs*/,
+    const std::vector<float>& /*tangents*/,
+    const std::vector<float>& /*bitangents*/,
+    const std::vector<uint32_t>& indices) {
+  uint32_t vertex_count = static_cast<uint32_t>(positions.size() / 3);
+  uint32_t index_count = static_cast<uint32_t>(indices.size());
+  std::size_t base_vertex = vertex_ranges_.allocate(vertex_count);
+  std::size_t first_index = index_ranges_.allocate(index_count);
+  return meshes_.insert({{index_count, 1, static_cast<uint32_t>(first_index),
+                          static_cast<int32_t>(base_vertex), 0},
+                         vertex_count});
+}
+
+DrawElementsIndirect ResourceManager::get_mesh_draw(uint32_t id) const {
+  return meshes_[id].draw;
+}
+
+uint32_t ResourceManager::create_material(uint32_t gpu_program) {
+  if (!gpu_programs_.contains(gpu_program)) {
+    std::cerr << "Material created with unknown program " << gpu_program
+              << ".\n";
+    assert(false);
+  }
+  return materials_.emplace(gpu_program);
+}
+
+uint32_t ResourceManager::create_texture(
+    std::size_t width,
+    std::size_t height,
+    pixel::Format /*format*/,
+    pixel::InternalFormat internal_format,
+    pixel::ComponentType /*component_type*/) {
+  return textures_.insert(
+      {width, height, texel_sizes_[static_cast<std::size_t>(internal_format)],
+       false});
+}
+
+uint32_t ResourceManager::create_texture_buffer(
+    pixel::BufferFormat /*format*/) {
+  return textures_.insert({0, 0, 0, true});
+}
+
+uint32_t ResourceManager::create_framebuffer(
+    uint32_t depth_rt_id,
+    const std::vector<uint32_t>& color_rt_ids) {
+  std::vector<uint32_t> attachments(color_rt_ids);
+  attachments.push_back(depth_rt_id);
+  return framebuffers_.insert(std::move(attachments));
+}
+
+uint32_t ResourceManager::create_framebuffer(
+    const std::list<const donkey::render::Texture*>& render_targets) {
+  std::vector<uint32_t> attachments;
+  for (auto texture : render_targets)
+    attachments.push_back(texture->gpu_resource_id);
+  return framebuffers_.insert(std::move(attachments));
+}
+
+uint32_t ResourceManager::create_state(const render::State& state) {
+  return states_.insert(state);
+}
+
+AMaterial& ResourceManager::get_material(std::uint32_t id) {
+  return materials_[id];
+}
+
+const ResourceManager::Program& ResourceManager::get_gpu_program(
+    uint32_t id) const {
+  return gpu_programs_[id];
+}
+
+const ResourceManager::Texture& ResourceManager::get_texture(
+    uint32_t id) const {
+  return textures_[id];
+}
+
+const std::vector<uint32_t>& ResourceManager::get_framebuffer(
+    uint32_t id) const {
+  return framebuffers_[id];
+}
+
+const render::State& ResourceManager::get_state(uint32_t id) const {
+  return states_[id];
+}
+
+void ResourceManager::update_texture_buffer(uint32_t id,
+                                            const void* data,
+                                            std::size_t size,
+                                            std::size_t buffer_offset) {
+  std::vector<uint8_t>& contents = textures_[id].contents;
+  if (contents.size() < buffer_offset + size)
+    contents.resize(buffer_offset + size);
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  std::copy(bytes, bytes + size,
+            contents.begin() + static_cast<std::ptrdiff_t>(buffer_offset));
+}
+
+void ResourceManager::destroy_texture(uint32_t id) {
+  textures_.erase(id);
+}
+
+void ResourceManager::destroy_gpu_program(uint32_t id) {
+  gpu_programs_.erase(id);
+}
+
+void ResourceManager::destroy_mesh(uint32_t id) {
+  const Mesh& mesh = meshes_[id];
+  vertex_ranges_.free(static_cast<std::size_t>(mesh.draw.base_vertex),
+                      mesh.vertex_count);
+  index_ranges_.free(mesh.draw.first_index, mesh.draw.count);
+  meshes_.erase(id);
+}
+
+void ResourceManager::destroy_material(uint32_t id) {
+  materials_.erase(id);
+}
+
+void ResourceManager::destroy_state(uint32_t id) {
+  states_.erase(id);
+}
+
+bool ResourceManager::has_gpu_program(uint32_t id) const {
+  return gpu_programs_.contains(id);
+}
+
+bool ResourceManager::has_mesh(uint32_t id) const {
+  return meshes_.contains(id);
+}
+
+bool ResourceManager::has_texture(uint32_t id) const {
+  return textures_.contains(id);
+}
+
+bool ResourceManager::has_framebuffer(uint32_t id) const {
+  return framebuffers_.contains(id);
+}
+
+bool ResourceManager::has_material(uint32_t id) const {
+  return materials_.contains(id);
+}
+
+bool ResourceManager::has_state(uint32_t id) const {
+  return states_.contains(id);
+}
+
+std::size_t ResourceManager::get_gpu_program_count() const {
+  return gpu_programs_.size();
+}
+
+std::size_t ResourceManager::get_mesh_count() const {
+  return meshes_.size();
+}
+
+std::size_t ResourceManager::get_texture_count() const {
+  return textures_.size();
+}
+
+std::size_t ResourceManager::get_framebuffer_count() const {
+  return framebuffers_.size();
+}
+
+std::size_t ResourceManager::get_material_count() const {
+  return materials_.size();
+}
+
+std::size_t ResourceManager::get_state_count() const {
+  return states_.size();
+}
+
+ResourceManager::Statistics ResourceManager::get_statistics() const {
+  Statistics statistics = {};
+  statistics.program_count = gpu_programs_.size();
+  statistics.mesh_count = meshes_.size();
+  statistics.vertex_count = vertex_ranges_.get_size();
+  statistics.index_count = index_ranges_.get_size();
+  statistics.material_count = materials_.size();
+  statistics.texture_count = textures_.size() - 1;
+  for (const Texture& texture : textures_)
+    statistics.texture_bytes += texture.width * texture.height *
+                                texture.texel_size;
+  statistics.framebuffer_count = framebuffers_.size();
+  statistics.state_count = states_.size();
+  return statistics;
+}
+
+}  // namespace headless
+}  // namespace render
+}  // namespace donkey
@@ -0,0 +1,339 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "render/image.hpp"
+
+#include <cassert>
+#include <cstring>
+#include <vector>
+
+#if defined(MSVC)
+# pragma warning(push)
+# pragma warning(disable : 26812 26819)
+#endif
+
+#include <SDL.h>
+
+#if defined(MSVC)
+# pragma warning(pop)
+#endif
+
+// Pick the widest kernels the CPU lets us use. SSSE3 isn't part of the
+// x86-64 baseline, so unless the build targets it the SSSE3 kernels are
+// compiled for it on their own and only called after checking the CPU has
+// it, with SSE2 and scalar code as the fallback. The 4-channel swap only
+// needs SSE2.
+#if defined(__SSSE3__) || defined(__AVX__)
+#define STURDY_DONKEY_SSSE3
+#define STURDY_DONKEY_SSSE3_TARGET
+#include <tmmintrin.h>
+#elif (defined(__GNUC__) || defined(__clang__)) && \
+    (defined(__x86_64__) || defined(__i386__))
+#define STURDY_DONKEY_SSSE3
+#define STURDY_DONKEY_SSSE3_RUNTIME
+#define STURDY_DONKEY_SSSE3_TARGET __attribute__((target("ssse3")))
+#include <tmmintrin.h>
+#elif defined(_MSC_VER) && defined(_M_X64)
+#define STURDY_DONKEY_SSSE3
+#define STURDY_DONKEY_SSSE3_RUNTIME
+#define STURDY_DONKEY_SSSE3_TARGET
+#include <intrin.h>
+#include <tmmintrin.h>
+#endif
+#if defined(__SSE2__) || defined(_M_X64)
+#define STURDY_DONKEY_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define STURDY_DONKEY_NEON
+#include <arm_neon.h>
+#endif
+
+namespace donkey {
+namespace render {
+namespace image {
+
+namespace {
+
+template <std::size_t r, std::size_t g, std::size_t b>
+void swizzle_3_to_4_scalar_(const uint8_t* src,
+                            uint8_t* dst,
+                            std::size_t count) {
+  for (std::size_t i = 0; i < count; ++i) {
+    dst[0] = src[r];
+    dst[1] = src[g];
+    dst[2] = src[b];
+    dst[3] = 0xff;
+    src += 3;
+    dst += 4;
+  }
+}
+
+void bgra_to_rgba_scalar_(const uint8_t* src, uint8_t* dst, std::size_t count) {
+  for (std::size_t i = 0; i < count; ++i) {
+    uint8_t b = src[0];
+    dst[0] = src[2];
+    dst[1] = src[1];
+    dst[2] = b;
+    dst[3] = src[3];
+    src += 4;
+    dst += 4;
+  }
+}
+
+#if defined(STURDY_DONKEY_SSSE3)
+
+bool has_ssse3_() {
+#if !defined(STURDY_DONKEY_SSSE3_RUNTIME)
+  return true;
+#elif defined(_MSC_VER)
+  static const bool supported = [] {
+    int info[4];
+    __cpuid(info, 1);
+    return (info[2] & (1 << 9)) != 0;
+  }();
+  return supported;
+#else
+  static const bool supported = __builtin_cpu_supports("ssse3");
+  return supported;
+#endif
+}
+
+// Expands 16 packed 3-byte pixels into 16 4-byte pixels per iteration. The
+// mask is made of 3-byte to 4-byte pixel offsets, see rgb_to_rgba.
+STURDY_DONKEY_SSSE3_TARGET
+std::size_t swizzle_3_to_4_ssse3_(const uint8_t* src,
+                                  uint8_t* dst,
+                                  std::size_t count,
+                                  const int8_t* mask_bytes) {
+  const __m128i mask =
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(mask_bytes));
+  const __m128i alpha = _mm_set1_epi32(static_cast<int>(0xff000000));
+  std::size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 16));
+    __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 32));
+    __m128i p0 = _mm_shuffle_epi8(a, mask);
+    __m128i p1 = _mm_shuffle_epi8(_mm_alignr_epi8(b, a, 12), mask);
+    __m128i p2 = _mm_shuffle_epi8(_mm_alignr_epi8(c, b, 8), mask);
+    __m128i p3 = _mm_shuffle_epi8(_mm_srli_si128(c, 4), mask);
+    __m128i* out = reinterpret_cast<__m128i*>(dst);
+    _mm_storeu_si128(out + 0, _mm_or_si128(p0, alpha));
+    _mm_storeu_si128(out + 1, _mm_or_si128(p1, alpha));
+    _mm_storeu_si128(out + 2, _mm_or_si128(p2, alpha));
+    _mm_storeu_si128(out + 3, _mm_or_si128(p3, alpha));
+    src += 48;
+    dst += 64;
+  }
+  return i;
+}
+
+STURDY_DONKEY_SSSE3_TARGET
+std::size_t bgra_to_rgba_ssse3_(const uint8_t* src,
+                                uint8_t* dst,
+                                std::size_t count) {
+  const __m128i mask =
+      _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+  std::size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 4),
+                     _mm_shuffle_epi8(v, mask));
+  }
+  return i;
+}
+
+const int8_t kRgbToRgbaMask[16] = {0, 1, 2, -1, 3, 4,  5,  -1,
+                                   6, 7, 8, -1, 9, 10, 11, -1};
+const int8_t kBgrToRgbaMask[16] = {2, 1, 0, -1, 5,  4,  3, -1,
+                                   8, 7, 6, -1, 11, 10, 9, -1};
+
+#endif
+
+}  // namespace
+
+std::size_t get_pixel_size(Layout layout) {
+  switch (layout) {
+    case Layout::kRGB:
+    case Layout::kBGR:
+      return 3;
+    case Layout::kRGBA:
+    case Layout::kBGRA:
+      return 4;
+  }
+  return 4;  // will never happen but makes MSVC happy
+}
+
+bool get_layout(uint32_t sdl_format, Layout& layout) {
+  switch (sdl_format) {
+    case SDL_PIXELFORMAT_RGB24:
+      layout = Layout::kRGB;
+      return true;
+    case SDL_PIXELFORMAT_BGR24:
+      layout = Layout::kBGR;
+      return true;
+    case SDL_PIXELFORMAT_RGBA32:
+      layout = Layout::kRGBA;
+      return true;
+    case SDL_PIXELFORMAT_BGRA32:
+      layout = Layout::kBGRA;
+      return true;
+    default:
+      return false;
+  }
+}
+
+void rgb_to_rgba(const uint8_t* src, uint8_t* dst, std::size_t count) {
+  std::size_t done = 0;
+#if defined(STURDY_DONKEY_SSSE3)
+  if (has_ssse3_())
+    done = swizzle_3_to_4_ssse3_(src, dst, count, kRgbToRgbaMask);
+#elif defined(STURDY_DONKEY_NEON)
+  const uint8x16_t alpha = vdupq_n_u8(0xff);
+  for (; done + 16 <= count; done += 16) {
+    uint8x16x3_t in = vld3q_u8(src + done * 3);
+    uint8x16x4_t out = {{in.val[0], in.val[1], in.val[2], alpha}};
+    vst4q_u8(dst + done * 4, out);
+  }
+#endif
+  swizzle_3_to_4_scalar_<0, 1, 2>(src + done * 3, dst + done * 4,
+                                  count - done);
+}
+
+void bgr_to_rgba(const uint8_t* src, uint8_t* dst, std::size_t count) {
+  std::size_t done = 0;
+#if defined(STURDY_DONKEY_SSSE3)
+  if (has_ssse3_())
+    done = swizzle_3_to_4_ssse3_(src, dst, count, kBgrToRgbaMask);
+#elif defined(STURDY_DONKEY_NEON)
+  const uint8x16_t alpha = vdupq_n_u8(0xff);
+  for (; done + 16 <= count; done += 16) {
+    uint8x16x3_t in = vld3q_u8(src + done * 3);
+    uint8x16x4_t out = {{in.val[2], in.val[1], in.val[0], alpha}};
+    vst4q_u8(dst + done * 4, out);
+  }
+#endif
+  swizzle_3_to_4_scalar_<2, 1, 0>(src + done * 3, dst + done * 4,
+                                  count - done);
+}
+
+void bgra_to_rgba(const uint8_t* src, uint8_t* dst, std::size_t count) {
+  std::size_t done = 0;
+#if defined(STURDY_DONKEY_SSSE3)
+  if (has_ssse3_())
+    done = bgra_to_rgba_ssse3_(src, dst, count);
+#endif
+#if defined(STURDY_DONKEY_SSE2)
+  // Keep G and A where they are, swap R and B with 32-bit lane shifts.
+  const __m128i ga_mask = _mm_set1_epi32(static_cast<int>(0xff00ff00));
+  const __m128i b_mask = _mm_set1_epi32(0x000000ff);
+  for (; done + 4 <= count; done += 4) {
+    __m128i v =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + done * 4));
+    __m128i ga = _mm_and_si128(v, ga_mask);
+    __m128i r = _mm_and_si128(_mm_srli_epi32(v, 16), b_mask);
+    __m128i b = _mm_slli_epi32(_mm_and_si128(v, b_mask), 16);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + done * 4),
+                     _mm_or_si128(ga, _mm_or_si128(r, b)));
+  }
+#elif defined(STURDY_DONKEY_NEON)
+  for (; done + 16 <= count; done += 16) {
+    uint8x16x4_t in = vld4q_u8(src + done * 4);
+    uint8x16_t b = in.val[0];
+    in.val[0] = in.val[2];
+    in.val[2] = b;
+    vst4q_u8(dst + done * 4, in);
+  }
+#endif
+  bgra_to_rgba_scalar_(src + done * 4, dst + done * 4, count - done);
+}
+
+void flip_vertically(uint8_t* pixels,
+                     std::size_t row_size,
+                     std::size_t pitch,
+                     std::size_t height) {
+  std::vector<uint8_t> row(row_size);
+  uint8_t* top = pixels;
+  uint8_t* bottom = pixels + (height - 1) * pitch;
+  for (std::size_t y = 0; y < height / 2; ++y) {
+    std::memcpy(row.data(), top, row_size);
+    std::memcpy(top, bottom, row_size);
+    std::memcpy(bottom, row.data(), row_size);
+    top += pitch;
+    bottom -= pitch;
+  }
+}
+
+void convert_to_rgba_in_place(uint8_t* pixels,
+                              std::size_t pitch,
+                              std::size_t width,
+                              std::size_t height,
+                              Layout layout) {
+  assert(get_pixel_size(layout) == 4);
+  std::size_t row_size = width * 4;
+  if (layout == Layout::kRGBA) {
+    flip_vertically(pixels, row_size, pitch, height);
+    return;
+  }
+
+  // Swizzle each pair of mirrored rows while swapping them so that every
+  // pixel is read and written exactly once.
+  std::vector<uint8_t> row(row_size);
+  uint8_t* top = pixels;
+  uint8_t* bottom = pixels + (height - 1) * pitch;
+  for (std::size_t y = 0; y < height / 2; ++y) {
+    bgra_to_rgba(top, row.data(), width);
+    bgra_to_rgba(bottom, top, width);
+    std::memcpy(bottom, row.data(), row_size);
+    top += pitch;
+    bottom -= pitch;
+  }
+  if (height % 2 == 1)
+    bgra_to_rgba(top, top, width);
+}
+
+void convert_to_rgba(const uint8_t* src,
+                     std::size_t src_pitch,
+                     Layout layout,
+                     uint8_t* dst,
+                     std::size_t width,
+                     std::size_t height) {
+  std::size_t dst_pitch = width * 4;
+  uint8_t* dst_row = dst + (height - 1) * dst_pitch;
+  for (std::size_t y = 0; y < height; ++y) {
+    switch (layout) {
+      case Layout::kRGB:
+        rgb_to_rgba(src, dst_row, width);
+        break;
+      case Layout::kBGR:
+        bgr_to_rgba(src, dst_row, width);
+        break;
+      case Layout::kRGBA:
+        std::memcpy(dst_row, src, dst_pitch);
+        break;
+      case Layout::kBGRA:
+        bgra_to_rgba(src, dst_row, width);
+        break;
+    }
+    src += src_pitch;
+    dst_row -= dst_pitch;
+  }
+}
+
+}  // namespace image
+}  // namespace render
+}  // namespace donkey
@@ -0,0 +1,233 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "render/shader_fusion.hpp"
+
+#include <cctype>
+#include <sstream>
+#include <vector>
+
+namespace donkey {
+namespace render {
+namespace shader_fusion {
+
+namespace {
+
+bool is_identifier_character_(char c) {
+  return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+}
+
+// Position of `name` as a whole identifier, npos if it isn't there.
+std::size_t find_identifier_(const std::string& source,
+                             const std::string& name,
+                             std::size_t position = 0) {
+  while ((position = source.find(name, position)) != std::string::npos) {
+    std::size_t end = position + name.size();
+    if ((position == 0 || !is_identifier_character_(source[position - 1])) &&
+        (end == source.size() || !is_identifier_character_(source[end])))
+      return position;
+    position = end;
+  }
+  return std::string::npos;
+}
+
+std::string replace_identifier_(std::string source,
+                                const std::string& name,
+                                const std::string& replacement) {
+  std::size_t position = 0;
+  while ((position = find_identifier_(source, name, position)) !=
+         std::string::npos) {
+    source.replace(position, name.size(), replacement);
+    position += replacement.size();
+  }
+  return source;
+}
+
+std::string trim_(const std::string& line) {
+  std::size_t first = line.find_first_not_of(" \t\r\n");
+  if (first == std::string::npos)
+    return "";
+  std::size_t last = line.find_last_not_of(" \t\r\n");
+  return line.substr(first, last - first + 1);
+}
+
+bool starts_with_(const std::string& line, const std::string& prefix) {
+  return line.compare(0, prefix.size(), prefix) == 0;
+}
+
+std::vector<std::string> split_lines_(const std::string& source) {
+  std::vector<std::string> lines;
+  std::istringstream stream(source);
+  std::string line;
+  while (std::getline(stream, line))
+    lines.push_back(line);
+  return lines;
+}
+
+// Name of the variable a declaration ending with ';' declares.
+std::string get_declared_name_(const std::string& line) {
+  std::size_t end = line.find_last_of(';');
+  std::size_t begin = end;
+  while (begin > 0 && is_identifier_character_(line[begin - 1]))
+    --begin;
+  return line.substr(begin, end - begin);
+}
+
+// Shader stage interface, e.g. `in vec2 fragment_uv;`, which a fused
+// function can't use.
+bool is_stage_variable_(const std::string& line) {
+  if (line.empty() || line.back() != ';' ||
+      line.find("uniform") != std::string::npos)
+    return false;
+  return starts_with_(line, "in ") || starts_with_(line, "out ") ||
+         (starts_with_(line, "layout") &&
+          (line.find(" in ") != std::string::npos ||
+           line.find(" out ") != std::string::npos));
+}
+
+// Type and name followed by a parenthesis at the start of a line.
+bool is_function_definition_(const std::string& line) {
+  std::size_t i = 0;
+  for (int word = 0; word < 2; ++word) {
+    std::size_t begin = i;
+    while (i < line.size() && is_identifier_character_(line[i]))
+      ++i;
+    if (i == begin)
+      return false;
+    if (word == 0) {
+      if (i == line.size() || line[i] != ' ')
+        return false;
+      while (i < line.size() && line[i] == ' ')
+        ++i;
+    }
+  }
+  return i < line.size() && line[i] == '(';
+}
+
+// What the producer brings to the fused shader: everything but its leading
+// comments, version, stage interface, main() and what the consumer already
+// declares.
+bool extract_producer_(const std::string& producer,
+                       const std::string& consumer,
+                       std::string& extracted) {
+  std::vector<std::string> stage_variables;
+  std::string kept;
+  bool main_found = false;
+  std::vector<std::string> lines = split_lines_(producer);
+  for (std::size_t i = 0; i < lines.size() && !main_found; ++i) {
+    std::string line = trim_(lines[i]);
+    if (starts_with_(line, "/*")) {
+      while (i < lines.size() && lines[i].find("*/") == std::string::npos)
+        ++i;
+      continue;
+    } else if (starts_with_(line, "#version")) {
+      continue;
+    } else if (is_stage_variable_(line)) {
+      stage_variables.push_back(get_declared_name_(line));
+      continue;
+    } else if (line.find("uniform") != std::string::npos &&
+               line.find(';') == std::string::npos) {
+      // uniform block, skipped up to its closing brace if already declared
+      std::string name = line.substr(line.find_last_of(' ') + 1);
+      if (find_identifier_(consumer, name) != std::string::npos) {
+        while (i < lines.size() && !starts_with_(trim_(lines[i]), "}"))
+          ++i;
+        continue;
+      }
+    } else if (starts_with_(line, "uniform") &&
+               consumer.find(line) != std::string::npos) {
+      continue;
+    } else if (starts_with_(line, "void main(")) {
+      main_found = true;
+      continue;
+    }
+    // one blank line between what's kept
+    if (!line.empty() || (!kept.empty() && kept.back() != '\n') ||
+        (kept.size() > 1 && kept[kept.size() - 2] != '\n'))
+      kept += lines[i] + '\n';
+  }
+  if (!main_found || kept.find("vec4 shade(ivec2 ") == std::string::npos ||
+      find_identifier_(kept, "gl_FragCoord") != std::string::npos)
+    return false;
+  for (auto& name : stage_variables) {
+    if (find_identifier_(kept, name) != std::string::npos)
+      return false;
+  }
+  extracted = trim_(kept);
+  return true;
+}
+
+}  // namespace
+
+bool fuse(const std::string& producer,
+          const std::string& consumer,
+          const std::string& texture,
+          std::string& fused) {
+  std::string extracted;
+  if (!extract_producer_(producer, consumer, extracted))
+    return false;
+  std::string shade_name = "shade_" + texture;
+  std::string fetch_name = "fetch_" + texture;
+  extracted = replace_identifier_(extracted, "shade", shade_name);
+
+  // The consumer's texel fetches call the producer instead.
+  std::string declaration = "uniform sampler2D " + texture + ";";
+  std::string fetch = "texelFetch(" + texture + ",";
+  std::vector<std::string> lines = split_lines_(consumer);
+  std::string body;
+  bool declared = false;
+  std::size_t insertion = std::string::npos;
+  for (auto& line : lines) {
+    if (trim_(line) == declaration) {
+      declared = true;
+      continue;
+    }
+    if (insertion == std::string::npos && is_function_definition_(line)) {
+      // before the comments leading to the definition
+      insertion = body.size();
+      while (insertion > 0) {
+        std::size_t previous = body.rfind('\n', insertion - 2);
+        previous = (previous == std::string::npos) ? 0 : previous + 1;
+        if (!starts_with_(trim_(body.substr(previous, insertion - previous)),
+                          "//"))
+          break;
+        insertion = previous;
+      }
+    }
+    std::size_t position = 0;
+    while ((position = line.find(fetch, position)) != std::string::npos) {
+      std::size_t end = line.find_first_not_of(' ', position + fetch.size());
+      if (end == std::string::npos)
+        end = line.size();
+      line.replace(position, end - position, fetch_name + "(");
+    }
+    body += line + '\n';
+  }
+  if (!declared || insertion == std::string::npos ||
+      find_identifier_(body, texture) != std::string::npos)
+    return false;
+
+  std::string inlined = extracted + "\n\n" +
+                        "vec4 " + fetch_name + "(ivec2 texel, int lod)\n" +
+                        "{\n  return " + shade_name + "(texel);\n}\n\n";
+  fused = body.insert(insertion, inlined);
+  return true;
+}
+
+}  // namespace shader_fusion
+}  // namespace render
+}  // namespace donkey
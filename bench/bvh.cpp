@@ -0,0 +1,250 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Compares the cost of Bvh queries with testing every box, on 10k, 100k and
+// 1M random boxes spread with the same density. Also reports how long the
+// tree takes to build, to insert the boxes one by one and to refit 1% of
+// them after they moved.
+// Doesn't need a GL context.
+//
+// Usage: bvh-bench [queries]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Bvh.hpp"
+#include "bounds.hpp"
+
+using Clock = std::chrono::high_resolution_clock;
+
+namespace {
+
+struct Scene {
+  float half_extent;
+  std::vector<donkey::Aabb> boxes;
+};
+
+struct Timings {
+  double bvh_us;
+  double brute_force_us;
+  double result_count;
+};
+
+double get_ms(Clock::time_point start, Clock::time_point end) {
+  return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+glm::vec3 get_random_point(std::mt19937& generator, float half_extent) {
+  std::uniform_real_distribution<float> coordinate(-half_extent, half_extent);
+  return glm::vec3(coordinate(generator), coordinate(generator),
+                   coordinate(generator));
+}
+
+donkey::Aabb get_random_box(std::mt19937& generator, float half_extent) {
+  std::uniform_real_distribution<float> size(0.5f, 4.0f);
+  glm::vec3 min = get_random_point(generator, half_extent);
+  return donkey::Aabb(min, min + glm::vec3(size(generator), size(generator),
+                                           size(generator)));
+}
+
+Scene create_scene(std::size_t box_count) {
+  std::mt19937 generator(42);
+  Scene scene;
+  // About one box per 1000 cubic units.
+  scene.half_extent = 5.0f * std::cbrt(static_cast<float>(box_count));
+  scene.boxes.reserve(box_count);
+  for (std::size_t i = 0; i < box_count; ++i)
+    scene.boxes.push_back(get_random_box(generator, scene.half_extent));
+  return scene;
+}
+
+// Runs `query(bvh)` then `brute_force(boxes)` on each volume, both return
+// how many boxes they found.
+template <typename Volume, typename Query, typename BruteForce>
+Timings time_queries(const std::vector<Volume>& volumes,
+                     Query query,
+                     BruteForce brute_force) {
+  Timings timings = {0.0, 0.0, 0.0};
+  for (const Volume& volume : volumes) {
+    auto start = Clock::now();
+    std::size_t count = query(volume);
+    auto queried = Clock::now();
+    std::size_t brute_force_count = brute_force(volume);
+    auto end = Clock::now();
+    if (count != brute_force_count)
+      std::cerr << "mismatch: " << count << " vs " << brute_force_count
+                << '\n';
+    timings.bvh_us += get_ms(start, queried) * 1000.0;
+    timings.brute_force_us += get_ms(queried, end) * 1000.0;
+    timings.result_count += static_cast<double>(count);
+  }
+  timings.bvh_us /= volumes.size();
+  timings.brute_force_us /= volumes.size();
+  timings.result_count /= volumes.size();
+  return timings;
+}
+
+void print(const char* name, const Timings& timings) {
+  std::cout << std::setw(10) << name << ": bvh " << timings.bvh_us
+            << " us, brute force " << timings.brute_force_us << " us, x"
+            << timings.brute_force_us / timings.bvh_us << ", "
+            << timings.result_count << " found\n";
+}
+
+void run(std::size_t box_count, int query_count) {
+  Scene scene = create_scene(box_count);
+  const std::vector<donkey::Aabb>& boxes = scene.boxes;
+  std::cout << box_count << " boxes\n";
+
+  donkey::Bvh bvh;
+  auto start = Clock::now();
+  for (uint32_t id = 0; id < boxes.size(); ++id)
+    bvh.insert(id, boxes[id]);
+  auto inserted = Clock::now();
+  float incremental_cost = bvh.get_cost();
+  std::size_t incremental_height = bvh.get_height();
+  bvh.build();
+  auto built = Clock::now();
+  std::cout << "  insertion " << get_ms(start, inserted)
+            << " ms (cost " << incremental_cost << ", height "
+            << incremental_height << "), build " << get_ms(inserted, built)
+            << " ms (cost " << bvh.get_cost() << ", height "
+            << bvh.get_height() << ")\n";
+
+  std::mt19937 generator(7);
+  std::vector<donkey::Aabb> moved_boxes = boxes;
+  start = Clock::now();
+  for (std::size_t i = 0; i < boxes.size(); i += 100) {
+    donkey::Aabb& box = moved_boxes[i];
+    glm::vec3 offset = get_random_point(generator, 2.0f);
+    box = donkey::Aabb(box.min + offset, box.max + offset);
+    bvh.update(static_cast<uint32_t>(i), box);
+  }
+  auto refitted = Clock::now();
+  std::cout << "  refit of 1% " << get_ms(start, refitted) << " ms (cost "
+            << bvh.get_cost() << ")\n";
+  bvh.build();
+
+  float query_size = scene.half_extent * 0.1f;
+  std::vector<donkey::Aabb> query_boxes;
+  std::vector<std::pair<glm::vec3, float>> spheres;
+  std::vector<donkey::Frustum> frustums;
+  std::vector<std::pair<glm::vec3, glm::vec3>> rays;
+  for (int i = 0; i < query_count; ++i) {
+    glm::vec3 point = get_random_point(generator, scene.half_extent);
+    query_boxes.push_back(donkey::Aabb(point, point + glm::vec3(query_size)));
+    spheres.push_back(std::make_pair(point, query_size));
+    glm::vec3 target = get_random_point(generator, scene.half_extent);
+    frustums.push_back(donkey::Frustum(
+        glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f,
+                         scene.half_extent * 0.5f) *
+        glm::lookAt(point, target, glm::vec3(0.0f, 1.0f, 0.0f))));
+    rays.push_back(std::make_pair(point, glm::normalize(target - point)));
+  }
+
+  print("aabb",
+        time_queries(
+            query_boxes,
+            [&bvh](const donkey::Aabb& box) {
+              std::size_t count = 0;
+              bvh.query(box, [&count](uint32_t) { ++count; });
+              return count;
+            },
+            [&moved_boxes](const donkey::Aabb& box) {
+              return static_cast<std::size_t>(
+                  std::count_if(moved_boxes.begin(), moved_boxes.end(),
+                                [&box](const donkey::Aabb& other) {
+                                  return box.intersects(other);
+                                }));
+            }));
+  print("sphere",
+        time_queries(
+            spheres,
+            [&bvh](const std::pair<glm::vec3, float>& sphere) {
+              std::size_t count = 0;
+              bvh.query(sphere.first, sphere.second,
+                        [&count](uint32_t) { ++count; });
+              return count;
+            },
+            [&moved_boxes](const std::pair<glm::vec3, float>& sphere) {
+              return static_cast<std::size_t>(std::count_if(
+                  moved_boxes.begin(), moved_boxes.end(),
+                  [&sphere](const donkey::Aabb& other) {
+                    return other.intersects(sphere.first, sphere.second);
+                  }));
+            }));
+  print("frustum",
+        time_queries(
+            frustums,
+            [&bvh](const donkey::Frustum& frustum) {
+              std::size_t count = 0;
+              bvh.query(frustum, [&count](uint32_t) { ++count; });
+              return count;
+            },
+            [&moved_boxes](const donkey::Frustum& frustum) {
+              return static_cast<std::size_t>(
+                  std::count_if(moved_boxes.begin(), moved_boxes.end(),
+                                [&frustum](const donkey::Aabb& other) {
+                                  return frustum.intersects(other);
+                                }));
+            }));
+  // Nearest box along the ray, counts as 1 when there's one.
+  const float max_distance = scene.half_extent * 4.0f;
+  print("ray",
+        time_queries(
+            rays,
+            [&bvh, max_distance](const std::pair<glm::vec3, glm::vec3>& ray) {
+              float nearest = max_distance;
+              bvh.raycast(ray.first, ray.second, max_distance,
+                          [&nearest](uint32_t, float distance) {
+                            nearest = std::min(nearest, distance);
+                            return nearest;
+                          });
+              return static_cast<std::size_t>(nearest < max_distance);
+            },
+            [&moved_boxes,
+             max_distance](const std::pair<glm::vec3, glm::vec3>& ray) {
+              glm::vec3 inverse_direction = 1.0f / ray.second;
+              float nearest = max_distance;
+              for (const donkey::Aabb& box : moved_boxes) {
+                float distance =
+                    box.intersect(ray.first, inverse_direction, nearest);
+                if (distance >= 0.0f)
+                  nearest = std::min(nearest, distance);
+              }
+              return static_cast<std::size_t>(nearest < max_distance);
+            }));
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int query_count = (argc > 1) ? std::atoi(argv[1]) : 100;
+  query_count = std::max(query_count, 1);
+  std::cout << std::fixed << std::setprecision(3);
+  for (std::size_t box_count : {10000, 100000, 1000000})
+    run(box_count, query_count);
+  return EXIT_SUCCESS;
+}
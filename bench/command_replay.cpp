@@ -0,0 +1,97 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Replays a frame saved with render::CaptureDriver (F12 in a running game)
+// in a loop, to profile command submission on a real frame reproducibly.
+// The frame's resources are created again from the capture: same programs,
+// render targets and states, placeholder meshes and textures of the same
+// sizes.
+//
+// Usage: command-replay <capture> [frames] [width] [height]
+// Run it from the directory the game ran from, programs are loaded from the
+// paths they were loaded from then.
+
+#include <GL/gl3w.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+
+#include "render/CaptureDriver.hpp"
+#include "render/CommandBucket.hpp"
+#include "render/CommandStream.hpp"
+#include "render/Window.hpp"
+#include "render/gl/Driver.hpp"
+
+namespace render = donkey::render;
+namespace gl = donkey::render::gl;
+using Clock = std::chrono::high_resolution_clock;
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    std::cerr << "Usage: " << argv[0]
+              << " <capture> [frames] [width] [height]\n";
+    return EXIT_FAILURE;
+  }
+  int frames = std::max((argc > 2) ? std::atoi(argv[2]) : 500, 1);
+  int width = (argc > 3) ? std::atoi(argv[3]) : 1600;
+  int height = (argc > 4) ? std::atoi(argv[4]) : 900;
+
+  if (SDL_Init(SDL_INIT_VIDEO) != 0) {
+    std::cerr << "Couldn't initialize SDL: " << SDL_GetError() << '\n';
+    return EXIT_FAILURE;
+  }
+  int status = EXIT_SUCCESS;
+  {
+    render::Window window("Command replay", width, height);
+    window.make_current(window.get_render_context());
+    gl::Driver driver;
+    render::CommandStream stream;
+    if (render::CaptureDriver::load_capture(
+            argv[1], driver.get_resource_manager(), stream)) {
+      double record_ms = 0.0;
+      double execute_ms = 0.0;
+      for (int frame = 0; frame < frames; ++frame) {
+        auto start = Clock::now();
+        render::CommandBucket commands(driver.begin_frame());
+        stream.record(commands);
+        auto recorded = Clock::now();
+        driver.execute_commands(commands);
+        glFinish();
+        auto end = Clock::now();
+        window.swap();
+        record_ms +=
+            std::chrono::duration<double, std::milli>(recorded - start)
+                .count();
+        execute_ms +=
+            std::chrono::duration<double, std::milli>(end - recorded).count();
+      }
+      std::cout << std::fixed << std::setprecision(3)
+                << stream.get_command_count() << " commands, "
+                << driver.get_draw_call_count() << " draw calls, " << frames
+                << " frames: record " << record_ms / frames
+                << " ms, execute " << execute_ms / frames << " ms\n";
+    } else {
+      status = EXIT_FAILURE;
+    }
+    driver.get_resource_manager().cleanup();
+  }
+  SDL_Quit();
+  return status;
+}
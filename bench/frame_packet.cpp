@@ -0,0 +1,215 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Measures how long the simulation takes to extract a frame packet from a
+// large, mostly static scene and how many bytes of nodes it writes, before
+// and after splitting the static nodes out of the packets. The legacy path
+// copied the scene's lists by value then again into the packet. The split
+// path copies the dynamic nodes and the static nodes' changes, a few of them
+// being recreated every frame, and the render thread then appends its own
+// copy of the static nodes in view, which is timed separately.
+// Doesn't need a GL context.
+//
+// Usage: frame-packet-bench [frames] [nodes] [dynamic percentage]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <list>
+#include <random>
+#include <vector>
+
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+
+#include "Buffer.hpp"
+#include "BufferPool.hpp"
+#include "Scene.hpp"
+#include "render/FramePacket.hpp"
+#include "render/Mesh.hpp"
+#include "render/StaticMeshSet.hpp"
+
+namespace render = donkey::render;
+using Clock = std::chrono::high_resolution_clock;
+
+namespace {
+
+const int kChurnCount = 16;  // static nodes recreated every frame
+
+struct Results {
+  double extract_ms;
+  double merge_ms;
+  double bytes;
+};
+
+glm::vec3 get_random_position(std::mt19937& generator) {
+  std::uniform_real_distribution<float> coordinate(-500.0f, 500.0f);
+  return glm::vec3(coordinate(generator), coordinate(generator),
+                   coordinate(generator));
+}
+
+void create_scene(donkey::Scene& scene, int node_count, int dynamic_count) {
+  std::mt19937 generator(42);
+  scene.create_perspective_camera_node(
+      0, 60.0f, 0.1f, 1000.0f, glm::vec3(0.0f), glm::vec3(0.0f),
+      glm::tvec2<int>(0, 0), glm::tvec2<GLsizei>(1600, 900));
+  scene.create_directional_light_node(0, glm::vec3(0.0f),
+                                      glm::vec3(-45.0f, 0.0f, 0.0f),
+                                      glm::vec4(1.0f), glm::vec4(1.0f));
+  for (int i = 0; i < node_count; ++i) {
+    glm::vec3 position = get_random_position(generator);
+    uint32_t mesh_id = static_cast<uint32_t>(i % 16);
+    uint32_t material_id = static_cast<uint32_t>(i % 8);
+    if (i < dynamic_count) {
+      scene.create_mesh_node(0, position, glm::vec3(0.0f), glm::vec3(1.0f),
+                             mesh_id, material_id);
+    } else {
+      scene.create_static_mesh_node(0, position, glm::vec3(0.0f),
+                                    glm::vec3(1.0f), mesh_id, material_id);
+    }
+  }
+}
+
+double get_ms(Clock::time_point start, Clock::time_point end) {
+  return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+template <typename T>
+double get_bytes(const T& nodes) {
+  return static_cast<double>(nodes.size() * sizeof(typename T::value_type));
+}
+
+double get_bytes(const render::StackFramePacket& packet) {
+  return get_bytes(packet.get_mesh_nodes()) +
+         get_bytes(packet.get_directional_light_nodes()) +
+         get_bytes(packet.get_point_light_nodes()) +
+         get_bytes(packet.get_spot_light_nodes()) +
+         get_bytes(packet.get_created_static_mesh_nodes()) +
+         get_bytes(packet.get_destroyed_static_mesh_node_ids());
+}
+
+Results run_legacy(const donkey::Scene& scene, int frames) {
+  // Every node was dynamic back then.
+  std::list<donkey::MeshNode> mesh_nodes = scene.get_mesh_nodes();
+  mesh_nodes.insert(mesh_nodes.end(), scene.get_static_mesh_nodes().begin(),
+                    scene.get_static_mesh_nodes().end());
+  Results results = {0.0, 0.0, 0.0};
+  for (int frame = 0; frame < frames; ++frame) {
+    render::StackAllocator<render::MeshNode> allocator(
+        donkey::Buffer::Tag::kFramePacket, 0);
+    auto start = Clock::now();
+    // The packet's constructor took these by value.
+    std::list<donkey::MeshNode> mesh_node_copies = mesh_nodes;
+    std::list<donkey::CameraNode> camera_node_copies =
+        scene.get_camera_nodes();
+    std::list<donkey::DirectionalLightNode> directional_light_node_copies =
+        scene.get_directional_light_nodes();
+    render::StackFramePacket packet(
+        mesh_node_copies, camera_node_copies, directional_light_node_copies,
+        scene.get_point_light_nodes(), scene.get_spot_light_nodes(),
+        allocator);
+    auto end = Clock::now();
+    results.extract_ms += get_ms(start, end);
+    results.bytes += get_bytes(packet);
+    donkey::BufferPool::get_instance()->free_tag(
+        donkey::Buffer::Tag::kFramePacket, 0);
+  }
+  results.extract_ms /= frames;
+  results.bytes /= frames;
+  return results;
+}
+
+Results run_split(donkey::Scene& scene, int frames) {
+  std::mt19937 generator(7);
+  render::Mesh mesh(0, 36, glm::vec3(-0.5f), glm::vec3(0.5f));
+  auto get_mesh = [&mesh](uint32_t) -> const render::Mesh& { return mesh; };
+  render::StaticMeshSet static_mesh_set;
+  Results results = {0.0, 0.0, 0.0};
+  // The first packets carry every static node and wait for their BVH to be
+  // rebuilt in the background, they aren't counted.
+  int frame = -1;
+  while (frame < frames) {
+    bool warm_up = (frame < 0);
+    if (!warm_up) {
+      for (int i = 0; i < kChurnCount; ++i) {
+        const donkey::MeshNode& mesh_node =
+            scene.get_static_mesh_nodes().back();
+        uint32_t mesh_id = mesh_node.mesh_id;
+        uint32_t material_id = mesh_node.material_id;
+        scene.destroy_static_mesh_node(mesh_node.id);
+        scene.create_static_mesh_node(0, get_random_position(generator),
+                                      glm::vec3(0.0f), glm::vec3(1.0f),
+                                      mesh_id, material_id);
+      }
+    }
+    render::StackAllocator<render::MeshNode> allocator(
+        donkey::Buffer::Tag::kFramePacket, 0);
+    auto start = Clock::now();
+    render::StackFramePacket packet(scene, allocator);
+    scene.clear_static_mesh_node_changes();
+    auto extracted = Clock::now();
+    double bytes = get_bytes(packet);
+    static_mesh_set.update(packet, get_mesh);
+    auto end = Clock::now();
+    if (!warm_up) {
+      results.extract_ms += get_ms(start, extracted);
+      results.merge_ms += get_ms(extracted, end);
+      results.bytes += bytes;
+    }
+    donkey::BufferPool::get_instance()->free_tag(
+        donkey::Buffer::Tag::kFramePacket, 0);
+    if (!warm_up || !static_mesh_set.get_bvh().is_rebuilding())
+      ++frame;
+  }
+  results.extract_ms /= frames;
+  results.merge_ms /= frames;
+  results.bytes /= frames;
+  return results;
+}
+
+void print(const char* name, const Results& results) {
+  std::cout << std::setw(7) << name << ": extraction " << results.extract_ms
+            << " ms, " << results.bytes / 1024.0
+            << " KiB per frame packet, render thread merge "
+            << results.merge_ms << " ms\n";
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int frames = (argc > 1) ? std::atoi(argv[1]) : 100;
+  int node_count = (argc > 2) ? std::atoi(argv[2]) : 100000;
+  int dynamic_percentage = (argc > 3) ? std::atoi(argv[3]) : 5;
+  frames = std::max(frames, 1);
+  node_count = std::max(node_count, kChurnCount * 2);
+  dynamic_percentage = std::clamp(dynamic_percentage, 0, 100);
+  int dynamic_count = node_count / 100 * dynamic_percentage;
+  if (node_count - dynamic_count < kChurnCount)
+    dynamic_count = node_count - kChurnCount;
+
+  donkey::Scene scene;
+  create_scene(scene, node_count, dynamic_count);
+  std::cout << std::fixed << std::setprecision(3) << node_count
+            << " mesh nodes, " << dynamic_count << " dynamic, "
+            << kChurnCount << " static recreated per frame, " << frames
+            << " frames\n";
+  print("legacy", run_legacy(scene, frames));
+  print("split", run_split(scene, frames));
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,241 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+// Shows how the cost of local lights scales with the pixels they cover
+// rather than with their count. A wall filling the screen is lit by point
+// lights scattered in front of it, in two sweeps:
+// - "count": more and more lights, shrunk so that they cover about the same
+//   number of pixels in total,
+// - "radius": a fixed number of lights growing bigger.
+// Both lighting modes of the deferred renderer are measured: clustered
+// lighting and stencil-bounded light volumes. Recording and execution
+// (including glFinish) are timed separately.
+//
+// Usage: light-stress-bench [frames]
+// Run it from the repository's root, the renderer loads its shaders from
+// shaders/.
+
+#include <GL/gl3w.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <list>
+#include <random>
+#include <vector>
+
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+#include "Buffer.hpp"
+#include "BufferPool.hpp"
+#include "Scene.hpp"
+#include "render/CommandBucket.hpp"
+#include "render/DeferredRenderer.hpp"
+#include "render/FramePacket.hpp"
+#include "render/ResourceManager.hpp"
+#include "render/Window.hpp"
+#include "render/gl/Driver.hpp"
+
+namespace render = donkey::render;
+namespace gl = donkey::render::gl;
+using Clock = std::chrono::high_resolution_clock;
+using LightingMode = render::DeferredRenderer::LightingMode;
+
+namespace {
+
+const int kWidth = 1280;
+const int kHeight = 720;
+const float kWallDistance = 20.0f;
+
+struct Timings {
+  double record_ms;
+  double execute_ms;
+};
+
+struct Wall {
+  uint32_t mesh_id;
+  uint32_t material_id;
+  float half_width;
+  float half_height;
+};
+
+// A quad facing the camera at kWallDistance, a bit larger than the view.
+Wall create_wall(render::ResourceManager& resource_manager, float fov) {
+  Wall wall;
+  wall.half_height =
+      kWallDistance * std::tan(glm::radians(fov) * 0.5f) * 1.1f;
+  wall.half_width = wall.half_height * kWidth / kHeight;
+  float w = wall.half_width;
+  float h = wall.half_height;
+  std::vector<float> positions = {-w, -h, 0.0f, w, -h, 0.0f,
+                                  w,  h,  0.0f, -w, h, 0.0f};
+  std::vector<float> normals = {0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f,
+                                0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f};
+  std::vector<float> tangents = {1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f,
+                                 1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f};
+  std::vector<float> bitangents = {0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f,
+                                   0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f};
+  std::vector<float> uvs = {0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 1.0f, 0.0f, 1.0f};
+  std::vector<uint32_t> indices = {0, 1, 2, 0, 2, 3};
+  wall.mesh_id = resource_manager.create_mesh(positions, normals, uvs,
+                                              tangents, bitangents, indices);
+
+  render::ResourceManager::Id program_id =
+      resource_manager.load_gpu_program_from_file(
+          "shaders/gbuffer-pass.vert.glsl", "shaders/gbuffer-pass.frag.glsl");
+  wall.material_id = resource_manager.create_material(program_id);
+  return wall;
+}
+
+// Gives the wall a white albedo and a flat normal map.
+void register_wall_textures(render::ResourceManager& resource_manager,
+                            render::GpuResourceManager& gpu_resource_manager,
+                            const Wall& wall,
+                            uint32_t albedo_id,
+                            uint32_t normal_id) {
+  const render::Material& material =
+      resource_manager.get_material(wall.material_id);
+  render::AMaterial& gpu_material =
+      gpu_resource_manager.get_material(material.gpu_resource_id);
+  gpu_material.register_texture_slot(
+      "diffuse_texture",
+      resource_manager.get_texture(albedo_id).gpu_resource_id, 0);
+  gpu_material.register_texture_slot(
+      "normal_map", resource_manager.get_texture(normal_id).gpu_resource_id, 1);
+}
+
+// Records and executes `frames` frames of a scene made of the wall and
+// `light_count` point lights of the given radius.
+Timings run(render::DeferredRenderer& renderer,
+            gl::Driver& driver,
+            const Wall& wall,
+            float fov,
+            int light_count,
+            float radius,
+            int frames) {
+  std::list<donkey::MeshNode> mesh_nodes;
+  mesh_nodes.push_back(donkey::MeshNode(
+      0, glm::vec3(0.0f, 0.0f, -kWallDistance), glm::vec3(0.0f),
+      glm::vec3(1.0f), wall.mesh_id, wall.material_id));
+  std::list<donkey::CameraNode> camera_nodes;
+  camera_nodes.push_back(donkey::CameraNode(
+      0, glm::vec3(0.0f), glm::vec3(0.0f), glm::tvec2<int>(0, 0),
+      glm::tvec2<GLsizei>(kWidth, kHeight), fov, 0.1f, 100.0f,
+      donkey::CameraNode::Type::kPerspective));
+  std::list<donkey::PointLightNode> point_light_nodes;
+  std::mt19937 generator(42);
+  std::uniform_real_distribution<float> x(-wall.half_width, wall.half_width);
+  std::uniform_real_distribution<float> y(-wall.half_height, wall.half_height);
+  std::uniform_real_distribution<float> color(0.0f, 1.0f);
+  for (int i = 0; i < light_count; ++i) {
+    glm::vec4 diffuse(color(generator), color(generator), color(generator),
+                      1.0f);
+    glm::vec3 position(x(generator), y(generator),
+                       -kWallDistance + radius * 0.5f);
+    point_light_nodes.push_back(donkey::PointLightNode(
+        0, position, radius, diffuse, diffuse * 0.5f));
+  }
+
+  render::StackAllocator<render::MeshNode> allocator(
+      donkey::Buffer::Tag::kFramePacket, 0);
+  render::StackFramePacket frame_packet(
+      mesh_nodes, camera_nodes, {}, point_light_nodes, {}, allocator);
+
+  Timings timings = {0.0, 0.0};
+  for (int frame = 0; frame < frames; ++frame) {
+    auto start = Clock::now();
+    render::CommandBucket commands(driver.begin_frame());
+    renderer.render(&frame_packet, commands);
+    auto recorded = Clock::now();
+    driver.execute_commands(commands);
+    glFinish();
+    auto end = Clock::now();
+    timings.record_ms +=
+        std::chrono::duration<double, std::milli>(recorded - start).count();
+    timings.execute_ms +=
+        std::chrono::duration<double, std::milli>(end - recorded).count();
+  }
+  timings.record_ms /= frames;
+  timings.execute_ms /= frames;
+  donkey::BufferPool::get_instance()->free_tag(
+      donkey::Buffer::Tag::kFramePacket, 0);
+  return timings;
+}
+
+void print(int light_count, float radius, const Timings& timings) {
+  std::cout << std::setw(6) << light_count << " lights, radius "
+            << std::setw(6) << radius << ": record " << timings.record_ms
+            << " ms, execute " << timings.execute_ms << " ms\n";
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int frames = (argc > 1) ? std::atoi(argv[1]) : 50;
+  if (frames <= 0)
+    frames = 1;
+
+  if (SDL_Init(SDL_INIT_VIDEO) != 0) {
+    std::cerr << "Couldn't initialize SDL: " << SDL_GetError() << '\n';
+    return EXIT_FAILURE;
+  }
+  {
+    render::Window window("Light stress benchmark", kWidth, kHeight);
+    window.make_current(window.get_render_context());
+    gl::Driver driver;
+    render::ResourceManager resource_manager(driver.get_resource_manager());
+    const float fov = 60.0f;
+    Wall wall = create_wall(resource_manager, fov);
+    uint8_t white[] = {0xff, 0xff, 0xff, 0xff};
+    uint8_t flat[] = {0x80, 0x80, 0xff, 0xff};
+    register_wall_textures(
+        resource_manager, driver.get_resource_manager(), wall,
+        resource_manager.load_texture_from_memory(white, 1, 1),
+        resource_manager.load_texture_from_memory(flat, 1, 1));
+
+    std::cout << std::fixed << std::setprecision(3);
+    for (LightingMode mode :
+         {LightingMode::kClustered, LightingMode::kLightVolumes}) {
+      render::DeferredRenderer renderer(&window, &driver, &resource_manager,
+                                        mode);
+      std::cout << (mode == LightingMode::kClustered ? "clustered"
+                                                     : "light volumes")
+                << ", " << frames << " frames\n";
+      // warm up, the first frames compile and upload everything
+      run(renderer, driver, wall, fov, 1, 1.0f, 2);
+      std::cout << "count (constant coverage):\n";
+      for (int count = 64; count <= 4096; count *= 4) {
+        float radius = 4.0f * std::sqrt(64.0f / count);
+        print(count, radius,
+              run(renderer, driver, wall, fov, count, radius, frames));
+      }
+      std::cout << "radius (constant count):\n";
+      for (float radius = 0.5f; radius <= 8.0f; radius *= 2.0f) {
+        print(256, radius,
+              run(renderer, driver, wall, fov, 256, radius, frames));
+      }
+    }
+    resource_manager.cleanup();
+  }
+  SDL_Quit();
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,217 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+// Measures the cost of switching materials. Every material of the scene gets
+// drawn once per frame (a single triangle, so that draws stay cheap) with:
+// - "uniforms": one glUniform* command per parameter, the way materials used
+//   to be bound,
+// - "blocks": the material's parameter block, bound with a single
+//   glBindBufferRange once it has been uploaded.
+// Recording and execution (including glFinish) are timed separately.
+//
+// Usage: material-switch-bench [materials] [frames]
+
+#include <GL/gl3w.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include <glm/vec2.hpp>
+#include <glm/vec4.hpp>
+
+#include "render/AMaterial.hpp"
+#include "render/CommandBucket.hpp"
+#include "render/NameId.hpp"
+#include "render/Window.hpp"
+#include "render/gl/Driver.hpp"
+#include "render/gl/ResourceManager.hpp"
+
+namespace render = donkey::render;
+namespace gl = donkey::render::gl;
+using Clock = std::chrono::high_resolution_clock;
+
+namespace {
+
+struct Parameters {
+  glm::vec4 albedo;
+  glm::vec4 emissive;
+  glm::vec2 uv_scale;
+  float roughness;
+  float metalness;
+};
+
+struct Locations {
+  int albedo;
+  int emissive;
+  int uv_scale;
+  int roughness;
+  int metalness;
+};
+
+struct Timings {
+  double record_ms;
+  double execute_ms;
+};
+
+// The programs only have a position attribute, so every 3-component stream
+// holds positions: bind commands point all the attributes at it.
+uint32_t create_triangle(render::GpuResourceManager& resource_manager) {
+  std::vector<float> positions = {-0.01f, -0.01f, 0.0f, 0.01f, -0.01f,
+                                  0.0f,   0.0f,   0.01f, 0.0f};
+  std::vector<float> uvs = {0.0f, 0.0f, 1.0f, 0.0f, 0.5f, 1.0f};
+  std::vector<uint32_t> indices = {0, 1, 2};
+  return resource_manager.create_mesh(positions, positions, uvs, positions,
+                                      positions, indices);
+}
+
+// Runs `record` into a fresh command bucket for each frame and executes it.
+template <typename Function>
+Timings run(gl::Driver& driver, int frames, Function record) {
+  Timings timings = {0.0, 0.0};
+  for (int frame = 0; frame < frames; ++frame) {
+    auto start = Clock::now();
+    render::CommandBucket commands(driver.begin_frame());
+    record(commands);
+    auto recorded = Clock::now();
+    driver.execute_commands(commands);
+    glFinish();
+    auto end = Clock::now();
+    timings.record_ms +=
+        std::chrono::duration<double, std::milli>(recorded - start).count();
+    timings.execute_ms +=
+        std::chrono::duration<double, std::milli>(end - recorded).count();
+  }
+  timings.record_ms /= frames;
+  timings.execute_ms /= frames;
+  return timings;
+}
+
+void print(const char* name, const Timings& timings) {
+  std::cout << name << ": record " << timings.record_ms << " ms, execute "
+            << timings.execute_ms << " ms, total "
+            << timings.record_ms + timings.execute_ms << " ms per frame\n";
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int material_count = (argc > 1) ? std::atoi(argv[1]) : 4096;
+  int frames = (argc > 2) ? std::atoi(argv[2]) : 100;
+  if (material_count <= 0)
+    material_count = 1;
+  if (frames <= 0)
+    frames = 1;
+
+  if (SDL_Init(SDL_INIT_VIDEO) != 0) {
+    std::cerr << "Couldn't initialize SDL: " << SDL_GetError() << '\n';
+    return EXIT_FAILURE;
+  }
+  {
+    render::Window window("Material switch benchmark", 640, 360);
+    window.make_current(window.get_render_context());
+    gl::Driver driver;
+    gl::ResourceManager& resource_manager =
+        static_cast<gl::ResourceManager&>(driver.get_resource_manager());
+
+    uint32_t block_program = resource_manager.load_gpu_program_from_file(
+        MATERIAL_SWITCH_SHADER_DIR "/material-switch.vert.glsl",
+        MATERIAL_SWITCH_SHADER_DIR "/material-switch-block.frag.glsl");
+    uint32_t uniform_program = resource_manager.load_gpu_program_from_file(
+        MATERIAL_SWITCH_SHADER_DIR "/material-switch.vert.glsl",
+        MATERIAL_SWITCH_SHADER_DIR "/material-switch-uniforms.frag.glsl");
+    uint32_t mesh = create_triangle(resource_manager);
+    std::size_t index_count = 3;
+
+    const gl::GpuProgram& program =
+        resource_manager.get_gpu_program(uniform_program);
+    Locations locations = {
+        program.get_uniform_location(render::make_name_id("albedo")),
+        program.get_uniform_location(render::make_name_id("emissive")),
+        program.get_uniform_location(render::make_name_id("uv_scale")),
+        program.get_uniform_location(render::make_name_id("roughness")),
+        program.get_uniform_location(render::make_name_id("metalness"))};
+    GLint position_location =
+        program.get_attribute_location(render::name_id::kPosition);
+    unsigned int position = static_cast<unsigned int>(position_location);
+
+    std::mt19937 generator(42);
+    std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
+    std::vector<Parameters> parameters(material_count);
+    std::vector<uint32_t> materials(material_count);
+    for (int i = 0; i < material_count; ++i) {
+      Parameters& p = parameters[i];
+      p.albedo = glm::vec4(distribution(generator), distribution(generator),
+                           distribution(generator), 1.0f);
+      p.emissive = glm::vec4(distribution(generator), 0.0f, 0.0f, 1.0f);
+      p.uv_scale = glm::vec2(distribution(generator), 1.0f);
+      p.roughness = distribution(generator);
+      p.metalness = distribution(generator);
+
+      materials[i] = resource_manager.create_material(block_program);
+      render::AMaterial& material = resource_manager.get_material(materials[i]);
+      material.register_vector4_slot("albedo", p.albedo);
+      material.register_vector4_slot("emissive", p.emissive);
+      material.register_vector2_slot("uv_scale", p.uv_scale);
+      material.register_float_slot("roughness", p.roughness);
+      material.register_float_slot("metalness", p.metalness);
+    }
+
+    auto record_uniforms = [&](render::CommandBucket& commands) {
+      for (const Parameters& p : parameters) {
+        commands.bind_gpu_program(uniform_program);
+        commands.bind_uniform(locations.albedo, p.albedo);
+        commands.bind_uniform(locations.emissive, p.emissive);
+        commands.bind_uniform(locations.uv_scale, p.uv_scale);
+        commands.bind_uniform(locations.roughness, p.roughness);
+        commands.bind_uniform(locations.metalness, p.metalness);
+        commands.bind_mesh(mesh, position, position, position, position,
+                           position);
+        commands.draw_elements(index_count);
+      }
+    };
+    auto record_blocks = [&](render::CommandBucket& commands) {
+      for (uint32_t id : materials) {
+        resource_manager.get_material(id).bind(id, commands);
+        commands.bind_mesh(mesh, position, position, position, position,
+                           position);
+        commands.draw_elements(index_count);
+      }
+    };
+
+    // The first frame uploads every parameter block, keep it out of the
+    // steady state numbers.
+    Timings upload = run(driver, 1, record_blocks);
+    Timings uniforms = run(driver, frames, record_uniforms);
+    Timings blocks = run(driver, frames, record_blocks);
+
+    std::cout << std::fixed << std::setprecision(3) << material_count
+              << " materials, " << frames << " frames\n";
+    print("uniforms", uniforms);
+    print("blocks (first frame)", upload);
+    print("blocks", blocks);
+    std::cout << "x" << (uniforms.record_ms + uniforms.execute_ms) /
+                            (blocks.record_ms + blocks.execute_ms)
+              << '\n';
+  }
+  SDL_Quit();
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,225 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+// Measures what drawing the gbuffer pass costs with one draw per mesh node
+// against one multi-draw per material (Pipeline::set_multi_draw), on a grid
+// of small meshes of a few shapes and materials. Draw calls are counted by
+// the driver, a multi-draw counting as one only when the GL has
+// glMultiDrawElementsIndirect.
+//
+// Usage: multi-draw-bench [frames] [nodes]
+// Run it from the repository's root, the renderer loads its shaders from
+// shaders/.
+
+#include <GL/gl3w.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <list>
+#include <vector>
+
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+
+#include "Buffer.hpp"
+#include "BufferPool.hpp"
+#include "Scene.hpp"
+#include "render/CommandBucket.hpp"
+#include "render/DeferredRenderer.hpp"
+#include "render/FramePacket.hpp"
+#include "render/ResourceManager.hpp"
+#include "render/Window.hpp"
+#include "render/gl/Driver.hpp"
+
+namespace render = donkey::render;
+namespace gl = donkey::render::gl;
+using Clock = std::chrono::high_resolution_clock;
+
+namespace {
+
+const int kWidth = 1280;
+const int kHeight = 720;
+const int kMaterialCount = 8;
+const int kShapeCount = 4;
+
+struct Timings {
+  double record_ms;
+  double execute_ms;
+  std::size_t draw_calls;
+};
+
+// Regular polygon facing +z, from a triangle to a hexagon.
+uint32_t create_polygon(render::ResourceManager& resource_manager,
+                        int side_count) {
+  std::vector<float> positions = {0.0f, 0.0f, 0.0f};
+  std::vector<float> uvs = {0.5f, 0.5f};
+  std::vector<uint32_t> indices;
+  for (int i = 0; i < side_count; ++i) {
+    float angle = 6.2831853f * i / side_count;
+    positions.insert(positions.end(),
+                     {std::cos(angle), std::sin(angle), 0.0f});
+    uvs.insert(uvs.end(),
+               {0.5f + 0.5f * std::cos(angle), 0.5f + 0.5f * std::sin(angle)});
+    indices.insert(indices.end(),
+                   {0u, static_cast<uint32_t>(i + 1),
+                    static_cast<uint32_t>((i + 1) % side_count + 1)});
+  }
+  std::size_t vertex_count = positions.size() / 3;
+  std::vector<float> normals, tangents, bitangents;
+  for (std::size_t i = 0; i < vertex_count; ++i) {
+    normals.insert(normals.end(), {0.0f, 0.0f, 1.0f});
+    tangents.insert(tangents.end(), {1.0f, 0.0f, 0.0f});
+    bitangents.insert(bitangents.end(), {0.0f, 1.0f, 0.0f});
+  }
+  return resource_manager.create_mesh(positions, normals, uvs, tangents,
+                                      bitangents, indices);
+}
+
+std::vector<uint32_t> create_materials(
+    render::ResourceManager& resource_manager,
+    render::GpuResourceManager& gpu_resource_manager) {
+  render::ResourceManager::Id program_id =
+      resource_manager.load_gpu_program_from_file(
+          "shaders/gbuffer-pass.vert.glsl", "shaders/gbuffer-pass.frag.glsl");
+  uint8_t flat[] = {0x80, 0x80, 0xff, 0xff};
+  uint32_t normal_id = resource_manager.load_texture_from_memory(flat, 1, 1);
+  std::vector<uint32_t> material_ids;
+  for (int i = 0; i < kMaterialCount; ++i) {
+    uint8_t color[] = {static_cast<uint8_t>(0x20 * (i + 1)), 0x80,
+                       static_cast<uint8_t>(0xff - 0x20 * i), 0xff};
+    uint32_t albedo_id =
+        resource_manager.load_texture_from_memory(color, 1, 1);
+    uint32_t material_id = resource_manager.create_material(program_id);
+    const render::Material& material =
+        resource_manager.get_material(material_id);
+    render::AMaterial& gpu_material =
+        gpu_resource_manager.get_material(material.gpu_resource_id);
+    gpu_material.register_texture_slot(
+        "diffuse_texture",
+        resource_manager.get_texture(albedo_id).gpu_resource_id, 0);
+    gpu_material.register_texture_slot(
+        "normal_map", resource_manager.get_texture(normal_id).gpu_resource_id,
+        1);
+    material_ids.push_back(material_id);
+  }
+  return material_ids;
+}
+
+// Square grid facing the camera, 20 units away.
+std::list<donkey::MeshNode> create_grid(
+    const std::vector<uint32_t>& mesh_ids,
+    const std::vector<uint32_t>& material_ids,
+    int node_count) {
+  int side = static_cast<int>(std::ceil(std::sqrt(node_count)));
+  float spacing = 20.0f / side;
+  std::list<donkey::MeshNode> mesh_nodes;
+  for (int i = 0; i < node_count; ++i) {
+    glm::vec3 position(((i % side) - side * 0.5f) * spacing,
+                       ((i / side) - side * 0.5f) * spacing, -20.0f);
+    mesh_nodes.push_back(donkey::MeshNode(
+        0, position, glm::vec3(0.0f), glm::vec3(spacing * 0.4f),
+        mesh_ids[i % mesh_ids.size()],
+        material_ids[(i / mesh_ids.size()) % material_ids.size()]));
+  }
+  return mesh_nodes;
+}
+
+Timings run(render::DeferredRenderer& renderer,
+            gl::Driver& driver,
+            const std::list<donkey::MeshNode>& mesh_nodes,
+            int frames) {
+  std::list<donkey::CameraNode> camera_nodes;
+  camera_nodes.push_back(donkey::CameraNode(
+      0, glm::vec3(0.0f), glm::vec3(0.0f), glm::tvec2<int>(0, 0),
+      glm::tvec2<GLsizei>(kWidth, kHeight), 60.0f, 0.1f, 100.0f,
+      donkey::CameraNode::Type::kPerspective));
+  render::StackAllocator<render::MeshNode> allocator(
+      donkey::Buffer::Tag::kFramePacket, 0);
+  render::StackFramePacket frame_packet(mesh_nodes, camera_nodes, {}, {}, {},
+                                        allocator);
+  frame_packet.sort_mesh_nodes();
+
+  Timings timings = {0.0, 0.0, 0};
+  for (int frame = 0; frame < frames; ++frame) {
+    auto start = Clock::now();
+    render::CommandBucket commands(driver.begin_frame());
+    renderer.render(&frame_packet, commands);
+    auto recorded = Clock::now();
+    driver.execute_commands(commands);
+    glFinish();
+    auto end = Clock::now();
+    timings.record_ms +=
+        std::chrono::duration<double, std::milli>(recorded - start).count();
+    timings.execute_ms +=
+        std::chrono::duration<double, std::milli>(end - recorded).count();
+  }
+  timings.record_ms /= frames;
+  timings.execute_ms /= frames;
+  timings.draw_calls = renderer.get_draw_call_count();
+  donkey::BufferPool::get_instance()->free_tag(
+      donkey::Buffer::Tag::kFramePacket, 0);
+  return timings;
+}
+
+void print(const char* name, const Timings& timings) {
+  std::cout << std::setw(10) << name << ": " << timings.draw_calls
+            << " draw calls, record " << timings.record_ms << " ms, execute "
+            << timings.execute_ms << " ms\n";
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int frames = (argc > 1) ? std::atoi(argv[1]) : 50;
+  int node_count = (argc > 2) ? std::atoi(argv[2]) : 10000;
+  frames = std::max(frames, 1);
+  node_count = std::max(node_count, 1);
+
+  if (SDL_Init(SDL_INIT_VIDEO) != 0) {
+    std::cerr << "Couldn't initialize SDL: " << SDL_GetError() << '\n';
+    return EXIT_FAILURE;
+  }
+  {
+    render::Window window("Multi-draw benchmark", kWidth, kHeight);
+    window.make_current(window.get_render_context());
+    gl::Driver driver;
+    render::ResourceManager resource_manager(driver.get_resource_manager());
+    std::vector<uint32_t> mesh_ids;
+    for (int i = 0; i < kShapeCount; ++i)
+      mesh_ids.push_back(create_polygon(resource_manager, i + 3));
+    std::vector<uint32_t> material_ids =
+        create_materials(resource_manager, driver.get_resource_manager());
+    std::list<donkey::MeshNode> mesh_nodes =
+        create_grid(mesh_ids, material_ids, node_count);
+
+    std::cout << std::fixed << std::setprecision(3) << node_count
+              << " nodes, " << kMaterialCount << " materials, " << frames
+              << " frames\n";
+    render::DeferredRenderer renderer(&window, &driver, &resource_manager);
+    print("per node", run(renderer, driver, mesh_nodes, frames));
+    renderer.set_multi_draw(true);
+    print("multi-draw", run(renderer, driver, mesh_nodes, frames));
+    resource_manager.cleanup();
+  }
+  SDL_Quit();
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,232 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+// Measures OcclusionCulling on a city: a grid of buildings, the occluders,
+// with props scattered in the streets between them, seen from street level
+// while the camera turns around. Every frame the culling runs on a fresh
+// frame packet, with and without the buildings' occluder geometry (which
+// leaves frustum culling only), and reports how many props get culled and
+// how long each step takes: queuing the occluders' triangles, rasterizing
+// them, and testing the bounding boxes.
+// Doesn't need a GL context.
+//
+// Usage: occlusion-culling-bench [frames] [props]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <list>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+
+#include "Buffer.hpp"
+#include "BufferPool.hpp"
+#include "Scene.hpp"
+#include "render/FramePacket.hpp"
+#include "render/Mesh.hpp"
+#include "render/OcclusionCulling.hpp"
+
+namespace render = donkey::render;
+using Clock = std::chrono::high_resolution_clock;
+
+namespace {
+
+const int kBlockCount = 20;  // along each axis
+const float kBlockSize = 30.0f;
+const float kStreetWidth = 10.0f;
+
+struct Results {
+  double tested_count;
+  double frustum_culled_count;
+  double occlusion_culled_count;
+  double triangle_count;
+  double setup_ms;
+  double rasterization_ms;
+  double test_ms;
+};
+
+// Unit cube with 4 vertices per face, counter-clockwise seen from outside.
+render::Mesh create_cube(bool occluder) {
+  render::Mesh mesh(0, 36, glm::vec3(-0.5f), glm::vec3(0.5f));
+  if (!occluder)
+    return mesh;
+  const glm::vec3 axes[] = {glm::vec3(1.0f, 0.0f, 0.0f),
+                            glm::vec3(0.0f, 1.0f, 0.0f),
+                            glm::vec3(0.0f, 0.0f, 1.0f)};
+  for (int axis = 0; axis < 3; ++axis) {
+    for (float sign : {1.0f, -1.0f}) {
+      // u x v is the face's normal
+      glm::vec3 normal = axes[axis] * sign;
+      glm::vec3 u = axes[(axis + 1) % 3];
+      glm::vec3 v = axes[(axis + 2) % 3];
+      if (sign < 0.0f)
+        std::swap(u, v);
+      uint32_t first = static_cast<uint32_t>(mesh.occluder_positions.size());
+      glm::vec3 center = normal * 0.5f;
+      mesh.occluder_positions.push_back(center - u * 0.5f - v * 0.5f);
+      mesh.occluder_positions.push_back(center + u * 0.5f - v * 0.5f);
+      mesh.occluder_positions.push_back(center + u * 0.5f + v * 0.5f);
+      mesh.occluder_positions.push_back(center - u * 0.5f + v * 0.5f);
+      for (uint32_t index : {0, 1, 2, 0, 2, 3})
+        mesh.occluder_indices.push_back(first + index);
+    }
+  }
+  return mesh;
+}
+
+// Mesh 0 is a building, mesh 1 a prop. Buildings fill the blocks between
+// streets running along both axes, props stand in the streets.
+std::list<donkey::MeshNode> create_city(int prop_count) {
+  std::mt19937 generator(42);
+  std::uniform_real_distribution<float> height(8.0f, 40.0f);
+  std::list<donkey::MeshNode> mesh_nodes;
+  float half_extent = kBlockCount * kBlockSize * 0.5f;
+  float building_size = kBlockSize - kStreetWidth;
+  for (int i = 0; i < kBlockCount; ++i) {
+    for (int j = 0; j < kBlockCount; ++j) {
+      float h = height(generator);
+      glm::vec3 position(-half_extent + (i + 0.5f) * kBlockSize, h * 0.5f,
+                         -half_extent + (j + 0.5f) * kBlockSize);
+      mesh_nodes.push_back(donkey::MeshNode(
+          0, position, glm::vec3(0.0f),
+          glm::vec3(building_size, h, building_size), 0, 0));
+    }
+  }
+  std::uniform_real_distribution<float> coordinate(-half_extent, half_extent);
+  std::uniform_real_distribution<float> size(0.5f, 2.0f);
+  while (prop_count > 0) {
+    glm::vec3 position(coordinate(generator), 0.0f, coordinate(generator));
+    // Streets run along the blocks' edges.
+    float x = std::fmod(position.x + half_extent, kBlockSize);
+    float z = std::fmod(position.z + half_extent, kBlockSize);
+    float margin = kStreetWidth * 0.5f;
+    if (x > margin && x < kBlockSize - margin && z > margin &&
+        z < kBlockSize - margin) {
+      continue;
+    }
+    float s = size(generator);
+    position.y = s * 0.5f;
+    mesh_nodes.push_back(donkey::MeshNode(0, position, glm::vec3(0.0f),
+                                          glm::vec3(s), 1, 1));
+    --prop_count;
+  }
+  return mesh_nodes;
+}
+
+double get_ms(Clock::time_point start, Clock::time_point end) {
+  return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+// Mirrors OcclusionCulling::cull to time its steps.
+Results run(const std::list<donkey::MeshNode>& mesh_nodes,
+            const std::vector<render::Mesh>& meshes,
+            int frames) {
+  render::OcclusionCulling occlusion_culling;
+  Results results = {0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
+  for (int frame = 0; frame < frames; ++frame) {
+    // Stand at a crossroads and turn around.
+    std::list<donkey::CameraNode> camera_nodes;
+    camera_nodes.push_back(donkey::CameraNode(
+        0, glm::vec3(0.0f, 1.7f, 0.0f),
+        glm::vec3(0.0f, 360.0f * frame / frames, 0.0f),
+        glm::tvec2<int>(0, 0), glm::tvec2<GLsizei>(1280, 720), 60.0f, 0.1f,
+        1000.0f, donkey::CameraNode::Type::kPerspective));
+    render::StackAllocator<render::MeshNode> allocator(
+        donkey::Buffer::Tag::kFramePacket, 0);
+    {
+      render::StackFramePacket frame_packet(mesh_nodes, camera_nodes, {}, {},
+                                            {}, allocator);
+      auto start = Clock::now();
+      occlusion_culling.begin(frame_packet.get_camera_node());
+      for (const render::MeshNode& mesh_node : frame_packet.get_mesh_nodes()) {
+        const render::Mesh& mesh = meshes[mesh_node.mesh_id];
+        if (!mesh.occluder_indices.empty())
+          occlusion_culling.add_occluder(mesh_node.get_model_matrix(), mesh);
+      }
+      auto set_up = Clock::now();
+      occlusion_culling.rasterize();
+      auto rasterized = Clock::now();
+      for (const render::MeshNode& mesh_node : frame_packet.get_mesh_nodes()) {
+        occlusion_culling.is_visible(mesh_node.get_model_matrix(),
+                                     meshes[mesh_node.mesh_id]);
+      }
+      auto end = Clock::now();
+
+      const render::OcclusionCulling::Statistics& statistics =
+          occlusion_culling.get_statistics();
+      results.tested_count += statistics.tested_count;
+      results.frustum_culled_count += statistics.frustum_culled_count;
+      results.occlusion_culled_count += statistics.occlusion_culled_count;
+      results.triangle_count += statistics.triangle_count;
+      results.setup_ms += get_ms(start, set_up);
+      results.rasterization_ms += get_ms(set_up, rasterized);
+      results.test_ms += get_ms(rasterized, end);
+    }
+    donkey::BufferPool::get_instance()->free_tag(
+        donkey::Buffer::Tag::kFramePacket, 0);
+  }
+  for (double* value :
+       {&results.tested_count, &results.frustum_culled_count,
+        &results.occlusion_culled_count, &results.triangle_count,
+        &results.setup_ms, &results.rasterization_ms, &results.test_ms}) {
+    *value /= frames;
+  }
+  return results;
+}
+
+void print(const char* name, const Results& results) {
+  double culled_count =
+      results.frustum_culled_count + results.occlusion_culled_count;
+  std::cout << std::setw(10) << name << ": " << results.tested_count
+            << " tested, " << results.frustum_culled_count
+            << " out of view, " << results.occlusion_culled_count
+            << " hidden, " << 100.0 * culled_count / results.tested_count
+            << "% culled, " << results.triangle_count
+            << " triangles\n            setup " << results.setup_ms
+            << " ms, rasterization " << results.rasterization_ms
+            << " ms, tests " << results.test_ms << " ms, total "
+            << results.setup_ms + results.rasterization_ms + results.test_ms
+            << " ms\n";
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int frames = (argc > 1) ? std::atoi(argv[1]) : 100;
+  int prop_count = (argc > 2) ? std::atoi(argv[2]) : 20000;
+  frames = std::max(frames, 1);
+  prop_count = std::max(prop_count, 0);
+
+  std::list<donkey::MeshNode> mesh_nodes = create_city(prop_count);
+  std::cout << std::fixed << std::setprecision(3) << kBlockCount * kBlockCount
+            << " buildings, " << prop_count << " props, " << frames
+            << " frames, " << render::OcclusionCulling::kWidth << 'x'
+            << render::OcclusionCulling::kHeight << " depth buffer\n";
+  print("frustum", run(mesh_nodes, {create_cube(false), create_cube(false)},
+                       frames));
+  print("occlusion", run(mesh_nodes, {create_cube(true), create_cube(false)},
+                         frames));
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,240 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+// Measures the overdraw of the gbuffer pass on a field of a few thousand
+// overlapping quads, and what it costs, in three configurations:
+// - "unsorted": meshes drawn back to front, the worst case for early depth
+//   testing,
+// - "sorted": FramePacket::sort_mesh_nodes, front to back within each
+//   material,
+// - "pre-pass": sorted, after a depth pre-pass, the gbuffer pass testing for
+//   equal depths.
+// Overdraw is the number of fragments the gbuffer pass shades per pixel, as
+// counted by DeferredRenderer's overdraw counter.
+//
+// Usage: overdraw-bench [frames] [quads]
+// Run it from the repository's root, the renderer loads its shaders from
+// shaders/.
+
+#include <GL/gl3w.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <list>
+#include <random>
+#include <vector>
+
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+#include "Buffer.hpp"
+#include "BufferPool.hpp"
+#include "Scene.hpp"
+#include "render/CommandBucket.hpp"
+#include "render/DeferredRenderer.hpp"
+#include "render/FramePacket.hpp"
+#include "render/ResourceManager.hpp"
+#include "render/Window.hpp"
+#include "render/gl/Driver.hpp"
+
+namespace render = donkey::render;
+namespace gl = donkey::render::gl;
+using Clock = std::chrono::high_resolution_clock;
+
+namespace {
+
+const int kWidth = 1280;
+const int kHeight = 720;
+const int kMaterialCount = 4;
+
+struct Timings {
+  double record_ms;
+  double execute_ms;
+  float overdraw;
+};
+
+uint32_t create_quad(render::ResourceManager& resource_manager) {
+  std::vector<float> positions = {-1.0f, -1.0f, 0.0f, 1.0f,  -1.0f, 0.0f,
+                                  1.0f,  1.0f,  0.0f, -1.0f, 1.0f,  0.0f};
+  std::vector<float> normals = {0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f,
+                                0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f};
+  std::vector<float> tangents = {1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f,
+                                 1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f};
+  std::vector<float> bitangents = {0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f,
+                                   0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f};
+  std::vector<float> uvs = {0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 1.0f, 0.0f, 1.0f};
+  std::vector<uint32_t> indices = {0, 1, 2, 0, 2, 3};
+  return resource_manager.create_mesh(positions, normals, uvs, tangents,
+                                      bitangents, indices);
+}
+
+// Materials only differ by their albedo, so that meshes get bucketed.
+std::vector<uint32_t> create_materials(
+    render::ResourceManager& resource_manager,
+    render::GpuResourceManager& gpu_resource_manager) {
+  render::ResourceManager::Id program_id =
+      resource_manager.load_gpu_program_from_file(
+          "shaders/gbuffer-pass.vert.glsl", "shaders/gbuffer-pass.frag.glsl");
+  uint8_t flat[] = {0x80, 0x80, 0xff, 0xff};
+  uint32_t normal_id = resource_manager.load_texture_from_memory(flat, 1, 1);
+  std::vector<uint32_t> material_ids;
+  for (int i = 0; i < kMaterialCount; ++i) {
+    uint8_t color[] = {static_cast<uint8_t>(0x40 * (i + 1)), 0x80,
+                       static_cast<uint8_t>(0xff - 0x40 * i), 0xff};
+    uint32_t albedo_id =
+        resource_manager.load_texture_from_memory(color, 1, 1);
+    uint32_t material_id = resource_manager.create_material(program_id);
+    const render::Material& material =
+        resource_manager.get_material(material_id);
+    render::AMaterial& gpu_material =
+        gpu_resource_manager.get_material(material.gpu_resource_id);
+    gpu_material.register_texture_slot(
+        "diffuse_texture",
+        resource_manager.get_texture(albedo_id).gpu_resource_id, 0);
+    gpu_material.register_texture_slot(
+        "normal_map", resource_manager.get_texture(normal_id).gpu_resource_id,
+        1);
+    material_ids.push_back(material_id);
+  }
+  return material_ids;
+}
+
+// Quads facing the camera, spread in its frustum between 5 and 50 units
+// away, listed from the farthest to the nearest.
+std::list<donkey::MeshNode> create_quads(
+    uint32_t mesh_id,
+    const std::vector<uint32_t>& material_ids,
+    int quad_count) {
+  std::mt19937 generator(42);
+  std::uniform_real_distribution<float> depth(5.0f, 50.0f);
+  std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+  std::vector<float> depths(quad_count);
+  for (float& d : depths)
+    d = depth(generator);
+  std::sort(depths.begin(), depths.end(), std::greater<float>());
+
+  std::list<donkey::MeshNode> mesh_nodes;
+  float aspect = static_cast<float>(kWidth) / kHeight;
+  for (int i = 0; i < quad_count; ++i) {
+    float d = depths[i];
+    // tan(30 degrees), half of the camera's field of view
+    float half_height = d * 0.577f;
+    glm::vec3 position(unit(generator) * half_height * aspect,
+                       unit(generator) * half_height, -d);
+    float size = d * 0.15f;
+    mesh_nodes.push_back(donkey::MeshNode(
+        0, position, glm::vec3(0.0f), glm::vec3(size), mesh_id,
+        material_ids[i % material_ids.size()]));
+  }
+  return mesh_nodes;
+}
+
+Timings run(render::DeferredRenderer& renderer,
+            gl::Driver& driver,
+            const std::list<donkey::MeshNode>& mesh_nodes,
+            bool sort,
+            int frames) {
+  std::list<donkey::CameraNode> camera_nodes;
+  camera_nodes.push_back(donkey::CameraNode(
+      0, glm::vec3(0.0f), glm::vec3(0.0f), glm::tvec2<int>(0, 0),
+      glm::tvec2<GLsizei>(kWidth, kHeight), 60.0f, 0.1f, 100.0f,
+      donkey::CameraNode::Type::kPerspective));
+  render::StackAllocator<render::MeshNode> allocator(
+      donkey::Buffer::Tag::kFramePacket, 0);
+  render::StackFramePacket frame_packet(mesh_nodes, camera_nodes, {}, {}, {},
+                                        allocator);
+
+  Timings timings = {0.0, 0.0, 0.0f};
+  for (int frame = 0; frame < frames; ++frame) {
+    auto start = Clock::now();
+    if (sort)
+      frame_packet.sort_mesh_nodes();
+    render::CommandBucket commands(driver.begin_frame());
+    renderer.render(&frame_packet, commands);
+    auto recorded = Clock::now();
+    driver.execute_commands(commands);
+    glFinish();
+    auto end = Clock::now();
+    timings.record_ms +=
+        std::chrono::duration<double, std::milli>(recorded - start).count();
+    timings.execute_ms +=
+        std::chrono::duration<double, std::milli>(end - recorded).count();
+  }
+  timings.record_ms /= frames;
+  timings.execute_ms /= frames;
+  timings.overdraw = renderer.get_overdraw();
+  donkey::BufferPool::get_instance()->free_tag(
+      donkey::Buffer::Tag::kFramePacket, 0);
+  return timings;
+}
+
+void print(const char* name, const Timings& timings) {
+  std::cout << std::setw(9) << name << ": overdraw " << timings.overdraw
+            << ", record " << timings.record_ms << " ms, execute "
+            << timings.execute_ms << " ms\n";
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int frames = (argc > 1) ? std::atoi(argv[1]) : 50;
+  int quad_count = (argc > 2) ? std::atoi(argv[2]) : 4000;
+  // the overdraw counter reads results a few frames late
+  frames = std::max(frames, 8);
+  quad_count = std::max(quad_count, 1);
+
+  if (SDL_Init(SDL_INIT_VIDEO) != 0) {
+    std::cerr << "Couldn't initialize SDL: " << SDL_GetError() << '\n';
+    return EXIT_FAILURE;
+  }
+  {
+    render::Window window("Overdraw benchmark", kWidth, kHeight);
+    window.make_current(window.get_render_context());
+    gl::Driver driver;
+    render::ResourceManager resource_manager(driver.get_resource_manager());
+    uint32_t mesh_id = create_quad(resource_manager);
+    std::vector<uint32_t> material_ids =
+        create_materials(resource_manager, driver.get_resource_manager());
+    std::list<donkey::MeshNode> mesh_nodes =
+        create_quads(mesh_id, material_ids, quad_count);
+
+    std::cout << std::fixed << std::setprecision(3) << quad_count
+              << " quads, " << frames << " frames\n";
+    {
+      render::DeferredRenderer renderer(&window, &driver, &resource_manager);
+      renderer.set_overdraw_counter(true);
+      print("unsorted", run(renderer, driver, mesh_nodes, false, frames));
+      print("sorted", run(renderer, driver, mesh_nodes, true, frames));
+    }
+    {
+      render::DeferredRenderer renderer(
+          &window, &driver, &resource_manager,
+          render::DeferredRenderer::LightingMode::kClustered,
+          render::DeferredRenderer::GBufferLayout::kPacked, true);
+      renderer.set_overdraw_counter(true);
+      print("pre-pass", run(renderer, driver, mesh_nodes, true, frames));
+    }
+    resource_manager.cleanup();
+  }
+  SDL_Quit();
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,17 @@
+#version 410 core
+
+layout (std140) uniform MaterialBlock
+{
+  vec4 albedo;
+  vec4 emissive;
+  vec2 uv_scale;
+  float roughness;
+  float metalness;
+};
+
+out vec4 color;
+
+void main()
+{
+  color = albedo * (roughness + metalness) + emissive * uv_scale.x;
+}
@@ -0,0 +1,14 @@
+#version 410 core
+
+uniform vec4 albedo;
+uniform vec4 emissive;
+uniform vec2 uv_scale;
+uniform float roughness;
+uniform float metalness;
+
+out vec4 color;
+
+void main()
+{
+  color = albedo * (roughness + metalness) + emissive * uv_scale.x;
+}
@@ -0,0 +1,167 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Compares the texture preparation path used by
+// ResourceManager::load_texture_from_file before and after the image:: kernels
+// on every image found in a directory (typically a set of 4K textures).
+// Decoding isn't timed, only what happens between IMG_Load and the upload.
+//
+// Usage: texture-loading-bench <directory> [iterations]
+
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#if defined(MSVC)
+# pragma warning(push)
+# pragma warning(disable : 26812 26819)
+#endif
+
+#include <SDL_image.h>
+
+#if defined(MSVC)
+# pragma warning(pop)
+#endif
+
+#include "render/image.hpp"
+
+namespace image = donkey::render::image;
+using Clock = std::chrono::high_resolution_clock;
+
+namespace {
+
+// What the engine used to do: generic SDL conversion followed by a
+// per-pixel copy into a freshly allocated mirror surface.
+void prepare_legacy(SDL_Surface* original_surface) {
+  SDL_Surface* surface =
+      SDL_ConvertSurfaceFormat(original_surface, SDL_PIXELFORMAT_RGBA32, 0);
+  int width = surface->w;
+  int height = surface->h;
+  SDL_Surface* new_surface = SDL_CreateRGBSurfaceWithFormat(
+      0, width, height, 32, SDL_PIXELFORMAT_RGBA32);
+  uint32_t* src_pixels = reinterpret_cast<uint32_t*>(surface->pixels);
+  uint32_t* dst_pixels = reinterpret_cast<uint32_t*>(new_surface->pixels);
+
+  SDL_LockSurface(new_surface);
+  SDL_LockSurface(surface);
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ++x) {
+      uint32_t* src_ptr = src_pixels + y * width + x;
+      uint32_t* dst_ptr = dst_pixels + ((height - y - 1) * width) + x;
+      *dst_ptr = *src_ptr;
+    }
+  }
+  SDL_UnlockSurface(surface);
+  SDL_UnlockSurface(new_surface);
+  SDL_FreeSurface(surface);
+  SDL_FreeSurface(new_surface);
+}
+
+// Mirrors ResourceManager::load_texture_from_file minus the upload.
+void prepare_simd(SDL_Surface* surface) {
+  image::Layout layout;
+  int width = surface->w;
+  int height = surface->h;
+  if (image::get_layout(surface->format->format, layout)) {
+    uint8_t* pixels = static_cast<uint8_t*>(surface->pixels);
+    std::size_t pitch = static_cast<std::size_t>(surface->pitch);
+    if (image::get_pixel_size(layout) == 4 &&
+        pitch == static_cast<std::size_t>(width) * 4) {
+      image::convert_to_rgba_in_place(pixels, pitch, width, height, layout);
+    } else {
+      std::vector<uint8_t> rgba_pixels(static_cast<std::size_t>(width) *
+                                       height * 4);
+      image::convert_to_rgba(pixels, pitch, layout, rgba_pixels.data(), width,
+                             height);
+    }
+  } else {
+    SDL_Surface* rgba_surface =
+        SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_RGBA32, 0);
+    image::flip_vertically(static_cast<uint8_t*>(rgba_surface->pixels),
+                           static_cast<std::size_t>(width) * 4,
+                           rgba_surface->pitch, height);
+    SDL_FreeSurface(rgba_surface);
+  }
+}
+
+// Runs `prepare` on a fresh copy of the decoded surface (the new path
+// modifies it in place) and returns the time spent in `prepare` only.
+template <typename Function>
+double time_ms(SDL_Surface* decoded, Function prepare) {
+  SDL_Surface* copy = SDL_ConvertSurface(decoded, decoded->format, 0);
+  auto start = Clock::now();
+  prepare(copy);
+  auto end = Clock::now();
+  SDL_FreeSurface(copy);
+  return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    std::cerr << "Usage: " << argv[0] << " <directory> [iterations]\n";
+    return EXIT_FAILURE;
+  }
+  int iterations = (argc > 2) ? std::atoi(argv[2]) : 10;
+  if (iterations <= 0)
+    iterations = 1;
+
+  IMG_Init(IMG_INIT_JPG | IMG_INIT_PNG);
+  double total_legacy = 0.0;
+  double total_simd = 0.0;
+  double total_megabytes = 0.0;
+  std::cout << std::fixed << std::setprecision(2);
+  for (const auto& entry : std::filesystem::directory_iterator(argv[1])) {
+    if (!entry.is_regular_file())
+      continue;
+    SDL_Surface* decoded = IMG_Load(entry.path().string().c_str());
+    if (!decoded)
+      continue;
+
+    double legacy = 0.0;
+    double simd = 0.0;
+    for (int i = 0; i < iterations; ++i) {
+      legacy += time_ms(decoded, prepare_legacy);
+      simd += time_ms(decoded, prepare_simd);
+    }
+    legacy /= iterations;
+    simd /= iterations;
+    double megabytes = decoded->w * decoded->h * 4 / (1024.0 * 1024.0);
+    std::cout << entry.path().filename().string() << " (" << decoded->w << 'x'
+              << decoded->h << ", "
+              << SDL_GetPixelFormatName(decoded->format->format)
+              << "): legacy " << legacy << " ms, simd " << simd << " ms, x"
+              << legacy / simd << '\n';
+    total_legacy += legacy;
+    total_simd += simd;
+    total_megabytes += megabytes;
+    SDL_FreeSurface(decoded);
+  }
+  if (total_simd > 0.0) {
+    std::cout << "total: legacy " << total_legacy << " ms ("
+              << total_megabytes * 1000.0 / total_legacy << " MiB/s), simd "
+              << total_simd << " ms ("
+              << total_megabytes * 1000.0 / total_simd << " MiB/s), x"
+              << total_legacy / total_simd << '\n';
+  }
+  IMG_Quit();
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,147 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Compares placing attached nodes by hand every frame, making every node's
+// matrix out of its Euler angles and multiplying it by its parent's, with
+// TransformHierarchy::update when all the roots, 10% of them or none moved.
+// The scene is a forest of small trees, 4 levels deep.
+// Doesn't need a GL context.
+//
+// Usage: transform-hierarchy-bench [frames] [nodes]
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "Scene.hpp"
+#include "TransformHierarchy.hpp"
+
+using Clock = std::chrono::high_resolution_clock;
+using donkey::TransformHierarchy;
+
+namespace {
+
+struct Node {
+  uint32_t parent;  // index, kNoTransform for roots
+  glm::vec3 position;
+  glm::vec3 angles;
+  glm::vec3 scale;
+};
+
+double get_ms(Clock::time_point start, Clock::time_point end) {
+  return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+// What simulation modules do without a hierarchy, parents come first.
+void place_by_hand(const std::vector<Node>& nodes,
+                   std::vector<glm::mat4>& world_matrices) {
+  for (std::size_t i = 0; i < nodes.size(); ++i) {
+    const Node& node = nodes[i];
+    glm::mat4 local = donkey::SceneNode::make_model_matrix(
+        node.position, node.angles, node.scale);
+    world_matrices[i] = (node.parent == TransformHierarchy::kNoTransform)
+                            ? local
+                            : world_matrices[node.parent] * local;
+  }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int frames = (argc > 1) ? std::atoi(argv[1]) : 100;
+  std::size_t node_count =
+      (argc > 2) ? static_cast<std::size_t>(std::atol(argv[2])) : 100000;
+  if (frames <= 0)
+    frames = 1;
+
+  // Roots with 4 children each, 3 grandchildren per child and 2 great
+  // grandchildren per grandchild: 41 nodes a tree.
+  std::mt19937 generator(42);
+  std::uniform_real_distribution<float> coordinate(-10.0f, 10.0f);
+  std::vector<Node> nodes;
+  std::vector<uint32_t> roots;
+  TransformHierarchy hierarchy;
+  std::vector<uint32_t> ids;
+  auto add_node = [&](uint32_t parent) {
+    Node node = {parent,
+                 glm::vec3(coordinate(generator), coordinate(generator),
+                           coordinate(generator)),
+                 glm::vec3(0.0f, coordinate(generator) * 18.0f, 0.0f),
+                 glm::vec3(1.0f)};
+    nodes.push_back(node);
+    uint32_t parent_id =
+        (parent == TransformHierarchy::kNoTransform) ? parent : ids[parent];
+    ids.push_back(hierarchy.create(
+        parent_id, node.position,
+        TransformHierarchy::make_rotation(node.angles), node.scale));
+    return static_cast<uint32_t>(nodes.size() - 1);
+  };
+  while (nodes.size() < node_count) {
+    uint32_t root = add_node(TransformHierarchy::kNoTransform);
+    roots.push_back(root);
+    for (int i = 0; i < 4; ++i) {
+      uint32_t child = add_node(root);
+      for (int j = 0; j < 3; ++j) {
+        uint32_t grandchild = add_node(child);
+        for (int k = 0; k < 2; ++k)
+          add_node(grandchild);
+      }
+    }
+  }
+  hierarchy.update();
+
+  std::vector<glm::mat4> world_matrices(nodes.size());
+  auto start = Clock::now();
+  for (int frame = 0; frame < frames; ++frame) {
+    for (uint32_t root : roots)
+      nodes[root].angles.y += 1.0f;
+    place_by_hand(nodes, world_matrices);
+  }
+  double by_hand_ms = get_ms(start, Clock::now()) / frames;
+
+  // Every root, one in ten of them and none moving.
+  double hierarchy_ms[3];
+  const std::size_t strides[3] = {1, 10, 0};
+  glm::quat step =
+      TransformHierarchy::make_rotation(glm::vec3(0.0f, 1.0f, 0.0f));
+  for (int run = 0; run < 3; ++run) {
+    std::size_t stride = strides[run];
+    start = Clock::now();
+    for (int frame = 0; frame < frames; ++frame) {
+      for (std::size_t i = 0; stride > 0 && i < roots.size(); i += stride) {
+        uint32_t id = ids[roots[i]];
+        hierarchy.set_rotation(id, hierarchy.get_rotation(id) * step);
+      }
+      hierarchy.update();
+    }
+    hierarchy_ms[run] = get_ms(start, Clock::now()) / frames;
+  }
+
+  std::cout << std::fixed << std::setprecision(3) << nodes.size()
+            << " nodes in " << roots.size() << " trees, "
+            << hierarchy.get_level_count() << " levels\n"
+            << "by hand:                " << by_hand_ms << " ms a frame\n"
+            << "hierarchy, all moving:  " << hierarchy_ms[0] << " ms, x"
+            << by_hand_ms / hierarchy_ms[0] << '\n'
+            << "hierarchy, 10% moving:  " << hierarchy_ms[1] << " ms, x"
+            << by_hand_ms / hierarchy_ms[1] << '\n'
+            << "hierarchy, none moving: " << hierarchy_ms[2] << " ms\n";
+  return EXIT_SUCCESS;
+}
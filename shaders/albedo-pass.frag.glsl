@@ -20,12 +20,17 @@
 uniform sampler2D albedo_texture;
 uniform sampler2D light_texture;
 
-in vec2 fragment_uv;
 out vec4 color;
 
+// The lit albedo at a texel of the render targets. PipelineGenerator inlines
+// it into the next pass when it can, see shader_fusion::fuse.
+vec4 shade(ivec2 texel)
+{
+  return texelFetch(albedo_texture, texel, 0) *
+      texelFetch(light_texture, texel, 0);
+}
+
 void main()
 {
-  vec4 albedo = texture(albedo_texture, fragment_uv);
-  vec4 light = texture(light_texture, fragment_uv);
-  color = albedo * light;
+  color = shade(ivec2(gl_FragCoord.xy));
 }
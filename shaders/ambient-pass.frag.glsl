@@ -19,14 +19,51 @@
 
 uniform sampler2D light_plus_albedo_texture;
 uniform sampler2D depth_texture;
-uniform vec4 ambient;
+
+layout (std140) uniform CameraBlock
+{
+  mat4 view;
+  mat4 projection;
+  mat4 gbuffer_view;
+  mat4 gbuffer_projection_inverse;
+  vec4 gbuffer_projection_params; // x: near, y: far plane, z: gbuffer layout
+  vec4 camera_position; // Eye's position in view space.
+  vec4 ambient;
+  vec4 viewport; // x, y: origin, z, w: size in pixels of the view drawn
+};
 
 in vec2 fragment_uv;
 out vec4 color;
 
+// Upscales the view when drawn at a lower resolution, render targets being
+// sampled with the nearest filter. A single texel at full resolution.
+vec4 sample_scene(vec2 uv)
+{
+  vec2 position = uv * vec2(textureSize(depth_texture, 0)) - 0.5;
+  vec2 weight = position - floor(position);
+  // the view's texels only
+  ivec2 first = ivec2(viewport.xy);
+  ivec2 last = ivec2(viewport.xy + viewport.zw) - 1;
+  if (all(lessThan(abs(weight - round(weight)), vec2(1e-3))))
+    return texelFetch(light_plus_albedo_texture,
+                      clamp(ivec2(round(position)), first, last), 0);
+  ivec2 texel = ivec2(floor(position));
+  vec4 a = texelFetch(light_plus_albedo_texture,
+                      clamp(texel, first, last), 0);
+  vec4 b = texelFetch(light_plus_albedo_texture,
+                      clamp(texel + ivec2(1, 0), first, last), 0);
+  vec4 c = texelFetch(light_plus_albedo_texture,
+                      clamp(texel + ivec2(0, 1), first, last), 0);
+  vec4 d = texelFetch(light_plus_albedo_texture,
+                      clamp(texel + ivec2(1, 1), first, last), 0);
+  return mix(mix(a, b, weight.x), mix(c, d, weight.x), weight.y);
+}
+
 void main()
 {
-  vec4 albedo = texture(light_plus_albedo_texture, fragment_uv);
-  float depth = 1 - trunc(texture(depth_texture, fragment_uv).x);
+  vec2 gbuffer_uv = (viewport.xy + fragment_uv * viewport.zw) /
+      vec2(textureSize(depth_texture, 0));
+  vec4 albedo = sample_scene(gbuffer_uv);
+  float depth = 1 - trunc(texture(depth_texture, gbuffer_uv).x);
   color = albedo + ambient * depth;
 }
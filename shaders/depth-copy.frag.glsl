@@ -15,19 +15,14 @@
  * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
  */
 
-#include "render/GpuResourceManager.hpp"
 
-namespace donkey {
+#version 410 core
 
-namespace render {
+// Copies the gbuffer's depth into the same texels of the light volumes'
+// depth and stencil texture, see Pipeline::add_light_volume_pass.
+uniform sampler2D depth_texture;
 
-template <class Storage>
-void AMaterial::bind_scalar(int location,
-                            const Storage& storage,
-                            CommandBucket& render_commands) const {
-  ScalarMaterialSlot<Storage> slot(location, storage);
-  slot.bind(render_commands);
+void main()
+{
+  gl_FragDepth = texelFetch(depth_texture, ivec2(gl_FragCoord.xy), 0).x;
 }
-
-}  // namespace render
-}  // namespace donkey
@@ -19,21 +19,67 @@
 
 uniform sampler2D diffuse_texture;
 uniform sampler2D normal_map;
-uniform mat4 model;
-uniform mat4 view;
+
+layout (std140) uniform CameraBlock
+{
+  mat4 view;
+  mat4 projection;
+  mat4 gbuffer_view;
+  mat4 gbuffer_projection_inverse;
+  vec4 gbuffer_projection_params; // x: near, y: far plane, z: gbuffer layout
+  vec4 camera_position; // Eye's position in view space.
+  vec4 ambient;
+  vec4 viewport; // x, y: origin, z, w: size in pixels of the view drawn
+};
+
+// Zero, the value of parameters a material doesn't set, keeps the defaults:
+// a shininess of 10 and full specular.
+layout (std140) uniform MaterialBlock
+{
+  float shininess; // 1 to 1024
+  float specular_attenuation; // 0 to 1
+};
 
 in vec2 fragment_uv;
 in mat3 tbn;
 
 layout (location = 0) out vec4 gbuffer_albedo;
-layout (location = 1) out vec3 gbuffer_normal;
+layout (location = 1) out vec4 gbuffer_normal;
+
+// See DeferredRenderer::GBufferLayout.
+const int kWide = 0;
+const int kCompact = 1;
+const int kPacked = 2;
+
+// Folds the octahedron's lower half over the upper one and maps the result
+// to [0, 1].
+vec2 encode_octahedral(vec3 normal)
+{
+  normal /= abs(normal.x) + abs(normal.y) + abs(normal.z);
+  vec2 encoded = normal.xy;
+  if (normal.z < 0.0) {
+    vec2 signs = vec2(normal.x >= 0.0 ? 1.0 : -1.0,
+        normal.y >= 0.0 ? 1.0 : -1.0);
+    encoded = (1.0 - abs(normal.yx)) * signs;
+  }
+  return encoded * 0.5 + 0.5;
+}
 
 void main()
 {
-  // just copy input color into the albedo render target
-  gbuffer_albedo = texture(diffuse_texture, fragment_uv);
   // write view-space normal into the normal render target
-  gbuffer_normal = texture(normal_map, fragment_uv).xyz;
-  gbuffer_normal = normalize(gbuffer_normal * 2.0 - 1.0);
-  gbuffer_normal = normalize(tbn * gbuffer_normal);
+  vec3 normal = texture(normal_map, fragment_uv).xyz;
+  normal = normalize(tbn * normalize(normal * 2.0 - 1.0));
+  float gloss = log2(shininess > 0.0 ? shininess : 10.0) / 10.0;
+  float specular = 1.0 - specular_attenuation;
+
+  // the material's glossiness rides in the albedo's unused alpha
+  gbuffer_albedo = vec4(texture(diffuse_texture, fragment_uv).rgb, gloss);
+  int gbuffer_layout = int(gbuffer_projection_params.z);
+  if (gbuffer_layout == kWide)
+    gbuffer_normal = vec4(normal, specular);
+  else if (gbuffer_layout == kCompact)  // no room for specular
+    gbuffer_normal = vec4(encode_octahedral(normal), 0.0, 0.0);
+  else
+    gbuffer_normal = vec4(encode_octahedral(normal), specular, 0.0);
 }
@@ -23,18 +23,51 @@ in vec2 uv;
 in vec3 tangent;
 in vec3 bitangent;
 
-uniform mat4 model;
-uniform mat4 projection;
-uniform mat4 view;
+layout (std140) uniform CameraBlock
+{
+  mat4 view;
+  mat4 projection;
+  mat4 gbuffer_view;
+  mat4 gbuffer_projection_inverse;
+  vec4 gbuffer_projection_params; // x: near, y: far plane, z: gbuffer layout
+  vec4 camera_position; // Eye's position in view space.
+  vec4 ambient;
+  vec4 viewport; // x, y: origin, z, w: size in pixels of the view drawn
+};
+
+layout (std140) uniform ObjectBlock
+{
+  mat4 model;
+  ivec4 draw_params; // x: 1 if the model comes from the draw buffer
+};
+
+// Model matrices of a multi-draw, 4 texels each, indexed by draw ID.
+uniform samplerBuffer draw_buffer;
+in uint draw_id;
+
+mat4 get_model()
+{
+  if (draw_params.x == 0)
+    return model;
+  int texel = int(draw_id) * 4;
+  return mat4(texelFetch(draw_buffer, texel),
+              texelFetch(draw_buffer, texel + 1),
+              texelFetch(draw_buffer, texel + 2),
+              texelFetch(draw_buffer, texel + 3));
+}
 
 out vec2 fragment_uv;
 out mat3 tbn;
 
+// see position-only.vert
+invariant gl_Position;
+
 void main()
 {
-  gl_Position = projection * view * model * vec4(position, 1.0);
+  mat4 model_matrix = get_model();
+  gl_Position = projection * view * model_matrix * vec4(position, 1.0);
   fragment_uv = uv;
-  mat3 normal_matrix = mat3(transpose(inverse(view * model)));
+  mat3 normal_matrix = mat3(transpose(inverse(view * model_matrix)));
   vec3 t = normalize(vec3(normal_matrix * tangent));
   vec3 n = normalize(vec3(normal_matrix * normal));
   t = normalize(t - dot(t, n) * n);
@@ -17,20 +17,50 @@
 
 #version 410 core
 
+uniform sampler2D albedo_texture; // glossiness in alpha
 uniform sampler2D normals_texture; // normals in gbuffer_view space
 uniform sampler2D depth_texture;
-uniform vec3 camera_position; // Eye's position in view space.
-uniform vec4 light_dir; // Light's direction in gbuffer_view space in xyz.
-                        // Material's shininess in w.
-uniform vec4 light_diffuse; // Light's diffuse color.
-uniform vec4 light_specular; // Light's specular color.
-uniform vec2 gbuffer_projection_params; // x: near plane, y: far plane
-uniform mat4 gbuffer_projection_inverse;
-uniform mat4 gbuffer_view;
+// Lights binned by ClusteredLighting, in gbuffer_view space.
+uniform samplerBuffer light_buffer; // 4 texels per light
+uniform usamplerBuffer cluster_buffer; // offset and count in light_index_buffer
+uniform usamplerBuffer light_index_buffer;
+// Cascades side by side, see ShadowCascades.
+uniform sampler2D shadow_texture;
+
+layout (std140) uniform CameraBlock
+{
+  mat4 view;
+  mat4 projection;
+  mat4 gbuffer_view;
+  mat4 gbuffer_projection_inverse;
+  vec4 gbuffer_projection_params; // x: near, y: far plane, z: gbuffer layout
+  vec4 camera_position; // Eye's position in view space.
+  vec4 ambient;
+  vec4 viewport; // x, y: origin, z, w: size in pixels of the view drawn
+};
+
+layout (std140) uniform LightBlock
+{
+  ivec4 cluster_grid; // x, y: tiles, z: depth slices, w: tile size in pixels
+  vec4 cluster_depth; // slice = log(view depth) * x + y
+  ivec4 light_counts; // x: directional lights, y: all lights
+};
+
+// Shadows of the first directional light.
+layout (std140) uniform ShadowBlock
+{
+  mat4 cascade_matrices[4]; // gbuffer_view space to shadow_texture uv, depth
+  vec4 cascade_splits; // view depth at which each cascade ends
+  vec4 shadow_params; // x: cascades, y: depth bias, z: texel width in uv,
+                      // w: 1 to filter
+};
 
 in vec2 fragment_uv;
 out vec4 color;
 
+// Where the fragment is in the gbuffer, which the views share.
+vec2 gbuffer_uv;
+
 struct Light
 {
   vec4 diffuse;
@@ -41,6 +71,7 @@ struct Light
 struct Material
 {
   float shininess;
+  float specular;
 };
 
 struct Fragment
@@ -56,7 +87,7 @@ vec4 compute_specular_term(Fragment fragment, Light light, Material material,
   vec3 highlight = reflect(light.direction, fragment.normal);
   float specular =  pow(max(dot(camera_direction, highlight), 0.0),
       material.shininess);
-  return specular * light.specular;
+  return specular * material.specular * light.specular;
 }
 
 vec4 compute_diffuse_term(Fragment fragment, Light light, Material material)
@@ -66,23 +97,128 @@ vec4 compute_diffuse_term(Fragment fragment, Light light, Material material)
   return intensity * light.diffuse;
 }
 
+// See DeferredRenderer::GBufferLayout.
+const int kWide = 0;
+const int kCompact = 1;
+const int kPacked = 2;
+
+vec3 decode_octahedral(vec2 encoded)
+{
+  encoded = encoded * 2.0 - 1.0;
+  vec3 normal = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+  float fold = max(-normal.z, 0.0);
+  normal.x += normal.x >= 0.0 ? -fold : fold;
+  normal.y += normal.y >= 0.0 ? -fold : fold;
+  return normalize(normal);
+}
+
+void unpack_gbuffer(out vec3 normal, out Material material)
+{
+  vec4 packed_normal = texture(normals_texture, gbuffer_uv);
+  float gloss = texture(albedo_texture, gbuffer_uv).a;
+  material = Material(exp2(gloss * 10.0), 1.0);
+  int gbuffer_layout = int(gbuffer_projection_params.z);
+  if (gbuffer_layout == kWide) {
+    normal = packed_normal.xyz;
+    material.specular = packed_normal.w;
+  } else {
+    normal = decode_octahedral(packed_normal.xy);
+    // kCompact has no specular, it's lit as full specular
+    if (gbuffer_layout == kPacked)
+      material.specular = packed_normal.z;
+  }
+}
+
 vec3 unpack_position()
 {
-  float depth = texture(depth_texture, fragment_uv).x;
-  vec4 clip_space_position = vec4(fragment_uv * 2 - 1, depth, 1);
+  float depth = texture(depth_texture, gbuffer_uv).x;
+  vec4 clip_space_position = vec4(fragment_uv * 2 - 1, depth * 2 - 1, 1);
   vec4 view_space_position = gbuffer_projection_inverse * clip_space_position;
   vec3 position = view_space_position.xyz / view_space_position.w;
   return position;
 }
 
-void main()
+// Directional lights have a radius of 0 and their direction in place of the
+// position.
+vec4 shade(int light_index, Fragment fragment, Material material)
 {
-  vec3 normal = texture(normals_texture, fragment_uv).xyz;
-  Material material = Material(light_dir.w);
-  Light light = Light(light_diffuse, light_specular, light_dir.xyz);
-  Fragment fragment = Fragment(unpack_position(), normal);
+  vec4 position = texelFetch(light_buffer, light_index * 4);
+  Light light = Light(texelFetch(light_buffer, light_index * 4 + 1),
+      texelFetch(light_buffer, light_index * 4 + 2), position.xyz);
+  float attenuation = 1.0;
+  if (position.w > 0.0) {
+    vec3 to_fragment = fragment.position - position.xyz;
+    float distance = length(to_fragment);
+    float falloff = clamp(1.0 - pow(distance / position.w, 4.0), 0.0, 1.0);
+    light.direction = to_fragment / max(distance, 1e-4);
+    // spot cone, always 1 for point lights
+    vec4 spot = texelFetch(light_buffer, light_index * 4 + 3);
+    float cone = clamp(dot(light.direction, spot.xyz) + spot.w, 0.0, 1.0);
+    attenuation = falloff * falloff * cone;
+  }
   vec4 diffuse_term = compute_diffuse_term(fragment, light, material);
   vec4 specular_term = compute_specular_term(fragment, light, material,
-      camera_position);
-  color = diffuse_term + specular_term;
+      camera_position.xyz);
+  return attenuation * (diffuse_term + specular_term);
+}
+
+// 1 when lit, 0 in shadow, 1 as well past the last cascade.
+float compute_shadow(vec3 position)
+{
+  int cascade_count = int(shadow_params.x);
+  int cascade = 0;
+  while (cascade < cascade_count && -position.z > cascade_splits[cascade])
+    ++cascade;
+  if (cascade == cascade_count)
+    return 1.0;
+  vec3 shadow_position =
+      (cascade_matrices[cascade] * vec4(position, 1.0)).xyz;
+  float reference = shadow_position.z - shadow_params.y;
+  if (shadow_params.w == 0.0)
+    return step(reference, texture(shadow_texture, shadow_position.xy).x);
+  // 2x2 taps around the fragment, kept in the cascade's square
+  vec2 texel = vec2(shadow_params.z, shadow_params.z * shadow_params.x);
+  float cascade_start = float(cascade) / shadow_params.x;
+  float cascade_end = float(cascade + 1) / shadow_params.x;
+  float lit = 0.0;
+  for (int i = 0; i < 4; ++i) {
+    vec2 offset = (vec2(i & 1, i >> 1) - 0.5) * texel;
+    vec2 uv = shadow_position.xy + offset;
+    uv.x = clamp(uv.x, cascade_start + texel.x * 0.5,
+        cascade_end - texel.x * 0.5);
+    lit += step(reference, texture(shadow_texture, uv).x);
+  }
+  return lit * 0.25;
+}
+
+int find_cluster(Fragment fragment)
+{
+  ivec2 tile = ivec2(gl_FragCoord.xy - viewport.xy) / cluster_grid.w;
+  int slice = int(log(-fragment.position.z) * cluster_depth.x +
+      cluster_depth.y);
+  slice = clamp(slice, 0, cluster_grid.z - 1);
+  return (slice * cluster_grid.y + tile.y) * cluster_grid.x + tile.x;
+}
+
+void main()
+{
+  gbuffer_uv = (viewport.xy + fragment_uv * viewport.zw) /
+      vec2(textureSize(depth_texture, 0));
+  vec3 normal;
+  Material material;
+  unpack_gbuffer(normal, material);
+  Fragment fragment = Fragment(unpack_position(), normal);
+  color = vec4(0.0);
+  for (int i = 0; i < light_counts.x; ++i) {
+    vec4 light = shade(i, fragment, material);
+    if (i == 0)
+      light *= compute_shadow(fragment.position);
+    color += light;
+  }
+  uvec2 lights = texelFetch(cluster_buffer, find_cluster(fragment)).xy;
+  for (uint i = 0u; i < lights.y; ++i) {
+    int light_index = int(texelFetch(light_index_buffer,
+        int(lights.x + i)).x);
+    color += shade(light_index, fragment, material);
+  }
 }
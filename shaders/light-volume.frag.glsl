@@ -0,0 +1,163 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#version 410 core
+
+uniform sampler2D albedo_texture; // glossiness in alpha
+uniform sampler2D normals_texture; // normals in gbuffer_view space
+uniform sampler2D depth_texture;
+uniform samplerBuffer light_buffer; // 4 texels per light, see light-pass
+
+layout (std140) uniform CameraBlock
+{
+  mat4 view;
+  mat4 projection;
+  mat4 gbuffer_view;
+  mat4 gbuffer_projection_inverse;
+  vec4 gbuffer_projection_params; // x: near, y: far plane, z: gbuffer layout
+  vec4 camera_position; // Eye's position in view space.
+  vec4 ambient;
+  vec4 viewport; // x, y: origin, z, w: size in pixels of the view drawn
+};
+
+layout (std140) uniform LightBlock
+{
+  ivec4 cluster_grid; // x, y: tiles, z: depth slices, w: tile size in pixels
+  vec4 cluster_depth; // slice = log(view depth) * x + y
+  ivec4 light_counts; // x: directional lights, y: all lights,
+                      // z: light of the volume being drawn
+};
+
+out vec4 color;
+
+// Computed from gl_FragCoord, light volumes have no UVs. fragment_uv spans
+// the view, gbuffer_uv the gbuffer the views share.
+vec2 fragment_uv;
+vec2 gbuffer_uv;
+
+struct Light
+{
+  vec4 diffuse;
+  vec4 specular;
+  vec3 direction;
+};
+
+struct Material
+{
+  float shininess;
+  float specular;
+};
+
+struct Fragment
+{
+  vec3 position;
+  vec3 normal;
+};
+
+vec4 compute_specular_term(Fragment fragment, Light light, Material material,
+    vec3 camera_position)
+{
+  vec3 camera_direction = normalize(-fragment.position);
+  vec3 highlight = reflect(light.direction, fragment.normal);
+  float specular =  pow(max(dot(camera_direction, highlight), 0.0),
+      material.shininess);
+  return specular * material.specular * light.specular;
+}
+
+vec4 compute_diffuse_term(Fragment fragment, Light light, Material material)
+{
+  vec3 light_dir = normalize(-light.direction);
+  float intensity = max(dot(fragment.normal, light_dir), 0);
+  return intensity * light.diffuse;
+}
+
+// See DeferredRenderer::GBufferLayout.
+const int kWide = 0;
+const int kCompact = 1;
+const int kPacked = 2;
+
+vec3 decode_octahedral(vec2 encoded)
+{
+  encoded = encoded * 2.0 - 1.0;
+  vec3 normal = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+  float fold = max(-normal.z, 0.0);
+  normal.x += normal.x >= 0.0 ? -fold : fold;
+  normal.y += normal.y >= 0.0 ? -fold : fold;
+  return normalize(normal);
+}
+
+void unpack_gbuffer(out vec3 normal, out Material material)
+{
+  vec4 packed_normal = texture(normals_texture, gbuffer_uv);
+  float gloss = texture(albedo_texture, gbuffer_uv).a;
+  material = Material(exp2(gloss * 10.0), 1.0);
+  int gbuffer_layout = int(gbuffer_projection_params.z);
+  if (gbuffer_layout == kWide) {
+    normal = packed_normal.xyz;
+    material.specular = packed_normal.w;
+  } else {
+    normal = decode_octahedral(packed_normal.xy);
+    // kCompact has no specular, it's lit as full specular
+    if (gbuffer_layout == kPacked)
+      material.specular = packed_normal.z;
+  }
+}
+
+vec3 unpack_position()
+{
+  float depth = texture(depth_texture, gbuffer_uv).x;
+  vec4 clip_space_position = vec4(fragment_uv * 2 - 1, depth * 2 - 1, 1);
+  vec4 view_space_position = gbuffer_projection_inverse * clip_space_position;
+  vec3 position = view_space_position.xyz / view_space_position.w;
+  return position;
+}
+
+// Directional lights have a radius of 0 and their direction in place of the
+// position.
+vec4 shade(int light_index, Fragment fragment, Material material)
+{
+  vec4 position = texelFetch(light_buffer, light_index * 4);
+  Light light = Light(texelFetch(light_buffer, light_index * 4 + 1),
+      texelFetch(light_buffer, light_index * 4 + 2), position.xyz);
+  float attenuation = 1.0;
+  if (position.w > 0.0) {
+    vec3 to_fragment = fragment.position - position.xyz;
+    float distance = length(to_fragment);
+    float falloff = clamp(1.0 - pow(distance / position.w, 4.0), 0.0, 1.0);
+    light.direction = to_fragment / max(distance, 1e-4);
+    // spot cone, always 1 for point lights
+    vec4 spot = texelFetch(light_buffer, light_index * 4 + 3);
+    float cone = clamp(dot(light.direction, spot.xyz) + spot.w, 0.0, 1.0);
+    attenuation = falloff * falloff * cone;
+  }
+  vec4 diffuse_term = compute_diffuse_term(fragment, light, material);
+  vec4 specular_term = compute_specular_term(fragment, light, material,
+      camera_position.xyz);
+  return attenuation * (diffuse_term + specular_term);
+}
+
+void main()
+{
+  fragment_uv = (gl_FragCoord.xy - viewport.xy) / viewport.zw;
+  gbuffer_uv = gl_FragCoord.xy / vec2(textureSize(depth_texture, 0));
+  vec3 normal;
+  Material material;
+  unpack_gbuffer(normal, material);
+  Fragment fragment = Fragment(unpack_position(), normal);
+  color = shade(light_counts.z, fragment, material);
+}
@@ -0,0 +1,64 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#version 410 core
+
+in vec3 position;
+
+// The depth pre-pass and the gbuffer pass, which tests for equal depths, must
+// compute the exact same positions.
+invariant gl_Position;
+
+layout (std140) uniform CameraBlock
+{
+  mat4 view;
+  mat4 projection;
+  mat4 gbuffer_view;
+  mat4 gbuffer_projection_inverse;
+  vec4 gbuffer_projection_params; // x: near, y: far plane, z: gbuffer layout
+  vec4 camera_position; // Eye's position in view space.
+  vec4 ambient;
+  vec4 viewport; // x, y: origin, z, w: size in pixels of the view drawn
+};
+
+layout (std140) uniform ObjectBlock
+{
+  mat4 model;
+  ivec4 draw_params; // x: 1 if the model comes from the draw buffer
+};
+
+// Model matrices of a multi-draw, 4 texels each, indexed by draw ID.
+uniform samplerBuffer draw_buffer;
+in uint draw_id;
+
+mat4 get_model()
+{
+  if (draw_params.x == 0)
+    return model;
+  int texel = int(draw_id) * 4;
+  return mat4(texelFetch(draw_buffer, texel),
+              texelFetch(draw_buffer, texel + 1),
+              texelFetch(draw_buffer, texel + 2),
+              texelFetch(draw_buffer, texel + 3));
+}
+
+void main()
+{
+  mat4 model_matrix = get_model();
+  gl_Position = projection * view * model_matrix * vec4(position, 1.0);
+}
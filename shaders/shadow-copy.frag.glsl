@@ -15,29 +15,15 @@
  * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
  */
 
-#pragma once
 
-#include "render/CommandBucket.hpp"
+#version 410 core
 
-namespace donkey {
+// Copies the cached depth of the static shadow casters into the same texels
+// of the shadow atlas.
+uniform sampler2D static_shadow_texture;
 
-namespace render {
-
-template <class Storage_>
-class ScalarMaterialSlot {
- public:
-  typedef Storage_ Storage;
-
- public:
-  int location;
-  Storage storage;
-
- public:
-  ScalarMaterialSlot(int location, const Storage& storage);
-  void bind(CommandBucket& render_commands);
-};
-
-}  // namespace render
-}  // namespace donkey
-
-#include "ScalarMaterialSlot.inl"
+void main()
+{
+  gl_FragDepth = texelFetch(static_shadow_texture, ivec2(gl_FragCoord.xy),
+      0).x;
+}
@@ -3,9 +3,22 @@
 in vec3 position;
 in vec2 uv;
 
-uniform mat4 model;
-uniform mat4 projection;
-uniform mat4 view;
+layout (std140) uniform CameraBlock
+{
+  mat4 view;
+  mat4 projection;
+  mat4 gbuffer_view;
+  mat4 gbuffer_projection_inverse;
+  vec4 gbuffer_projection_params; // x: near, y: far plane, z: gbuffer layout
+  vec4 camera_position; // Eye's position in view space.
+  vec4 ambient;
+  vec4 viewport; // x, y: origin, z, w: size in pixels of the view drawn
+};
+
+layout (std140) uniform ObjectBlock
+{
+  mat4 model;
+};
 
 out vec2 fragment_uv;
 
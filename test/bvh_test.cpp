@@ -0,0 +1,177 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Bvh.hpp"
+#include "bounds.hpp"
+
+namespace {
+
+class BvhTest : public testing::Test {
+ protected:
+  std::mt19937 generator_;
+  std::vector<donkey::Aabb> boxes_;  // by id, empty once removed
+  donkey::Bvh bvh_;
+
+  BvhTest() : generator_(42) {}
+
+  donkey::Aabb get_random_box() {
+    std::uniform_real_distribution<float> coordinate(-100.0f, 100.0f);
+    std::uniform_real_distribution<float> size(0.1f, 5.0f);
+    glm::vec3 min(coordinate(generator_), coordinate(generator_),
+                  coordinate(generator_));
+    return donkey::Aabb(min, min + glm::vec3(size(generator_)));
+  }
+
+  void insert_random_boxes(std::size_t count) {
+    for (std::size_t i = 0; i < count; ++i) {
+      uint32_t id = static_cast<uint32_t>(boxes_.size());
+      boxes_.push_back(get_random_box());
+      bvh_.insert(id, boxes_.back());
+    }
+  }
+
+  void move_and_remove_some() {
+    for (uint32_t id = 0; id < boxes_.size(); id += 3) {
+      if (boxes_[id].is_empty())
+        continue;
+      boxes_[id] = get_random_box();
+      bvh_.update(id, boxes_[id]);
+    }
+    for (uint32_t id = 1; id < boxes_.size(); id += 7) {
+      if (boxes_[id].is_empty())
+        continue;
+      boxes_[id] = donkey::Aabb();
+      bvh_.remove(id);
+    }
+  }
+
+  template <typename Predicate>
+  std::vector<uint32_t> find(Predicate predicate) const {
+    std::vector<uint32_t> ids;
+    for (uint32_t id = 0; id < boxes_.size(); ++id) {
+      if (!boxes_[id].is_empty() && predicate(boxes_[id]))
+        ids.push_back(id);
+    }
+    return ids;
+  }
+
+  template <typename... Volume>
+  std::vector<uint32_t> query(const Volume&... volume) const {
+    std::vector<uint32_t> ids;
+    bvh_.query(volume..., [&ids](uint32_t id) { ids.push_back(id); });
+    std::sort(ids.begin(), ids.end());
+    return ids;
+  }
+
+  // Queries every kind of volume and compares with testing every box.
+  void expect_same_as_brute_force() {
+    donkey::Aabb box(glm::vec3(-30.0f), glm::vec3(20.0f, 40.0f, 10.0f));
+    EXPECT_EQ(query(box), find([&box](const donkey::Aabb& other) {
+                return box.intersects(other);
+              }));
+
+    glm::vec3 center(10.0f, -20.0f, 5.0f);
+    float radius = 35.0f;
+    EXPECT_EQ(query(center, radius),
+              find([&center, radius](const donkey::Aabb& other) {
+                return other.intersects(center, radius);
+              }));
+
+    glm::mat4 view_projection =
+        glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 150.0f) *
+        glm::lookAt(glm::vec3(0.0f, 0.0f, 120.0f), glm::vec3(30.0f),
+                    glm::vec3(0.0f, 1.0f, 0.0f));
+    donkey::Frustum frustum(view_projection);
+    EXPECT_EQ(query(frustum), find([&frustum](const donkey::Aabb& other) {
+                return frustum.intersects(other);
+              }));
+
+    glm::vec3 origin(-120.0f, 3.0f, -2.0f);
+    glm::vec3 direction = glm::normalize(glm::vec3(1.0f, 0.05f, 0.02f));
+    glm::vec3 inverse_direction = 1.0f / direction;
+    const float max_distance = 1000.0f;
+    float nearest = max_distance;
+    for (const donkey::Aabb& other : boxes_) {
+      float distance = other.is_empty() ? -1.0f
+                                        : other.intersect(origin,
+                                                          inverse_direction,
+                                                          max_distance);
+      if (distance >= 0.0f)
+        nearest = std::min(nearest, distance);
+    }
+    float bvh_nearest = max_distance;
+    bvh_.raycast(origin, direction, max_distance,
+                 [&bvh_nearest](uint32_t, float distance) {
+                   bvh_nearest = std::min(bvh_nearest, distance);
+                   return bvh_nearest;
+                 });
+    EXPECT_FLOAT_EQ(bvh_nearest, nearest);
+  }
+};
+
+}  // namespace
+
+TEST_F(BvhTest, QueriesMatchBruteForce) {
+  insert_random_boxes(2000);
+  expect_same_as_brute_force();
+  move_and_remove_some();
+  expect_same_as_brute_force();
+  bvh_.build();
+  EXPECT_EQ(bvh_.size(), find([](const donkey::Aabb&) { return true; })
+                             .size());
+  expect_same_as_brute_force();
+}
+
+TEST_F(BvhTest, RebuildCatchesUpWithChanges) {
+  insert_random_boxes(2000);
+  float incremental_cost = bvh_.get_cost();
+  bvh_.start_rebuild();
+  move_and_remove_some();
+  insert_random_boxes(100);
+  // Queries see the changes while the tree is rebuilt, and after.
+  expect_same_as_brute_force();
+  EXPECT_TRUE(bvh_.finish_rebuild(true));
+  EXPECT_FALSE(bvh_.is_rebuilding());
+  expect_same_as_brute_force();
+
+  bvh_.build();
+  EXPECT_LT(bvh_.get_cost(), incremental_cost);
+}
+
+TEST_F(BvhTest, MaintainRebuildsAfterEnoughChanges) {
+  insert_random_boxes(1000);
+  std::size_t rebuild_count = bvh_.get_rebuild_count();
+  bvh_.maintain();
+  bvh_.finish_rebuild(true);
+  EXPECT_EQ(bvh_.get_rebuild_count(), rebuild_count + 1);
+  // Boxes which didn't move aren't changes.
+  for (uint32_t id = 0; id < boxes_.size(); ++id)
+    bvh_.update(id, boxes_[id]);
+  bvh_.maintain();
+  EXPECT_FALSE(bvh_.is_rebuilding());
+  expect_same_as_brute_force();
+}
@@ -0,0 +1,197 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <limits>
+#include <list>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "Buffer.hpp"
+#include "BufferPool.hpp"
+#include "Scene.hpp"
+#include "render/CaptureDriver.hpp"
+#include "render/CaptureResourceManager.hpp"
+#include "render/CommandBucket.hpp"
+#include "render/CommandStream.hpp"
+#include "render/DeferredRenderer.hpp"
+#include "render/FramePacket.hpp"
+#include "render/ResourceManager.hpp"
+#include "render/binary_io.hpp"
+#include "render/headless/Driver.hpp"
+
+namespace render = donkey::render;
+namespace headless = donkey::render::headless;
+
+TEST(CaptureDriver, ReplaysCapturedFrames) {
+  const int width = 320;
+  const int height = 180;
+  std::string path = testing::TempDir() + "capture_test.capture";
+
+  headless::Driver driver;
+  render::CaptureDriver capture_driver(driver);
+  render::ResourceManager resource_manager(
+      capture_driver.get_resource_manager());
+  uint32_t mesh_id = resource_manager.create_mesh(
+      {0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f},
+      {0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f},
+      {0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f},
+      {1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f},
+      {0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f}, {0, 1, 2});
+  render::ResourceManager::Id program_id =
+      resource_manager.load_gpu_program_from_file(
+          "shaders/gbuffer-pass.vert.glsl", "shaders/gbuffer-pass.frag.glsl");
+  uint32_t material_id = resource_manager.create_material(program_id);
+  render::DeferredRenderer renderer(width, height, &capture_driver,
+                                    &resource_manager);
+  renderer.set_multi_draw(true);
+
+  std::list<donkey::MeshNode> mesh_nodes;
+  for (int i = 0; i < 10; ++i) {
+    mesh_nodes.push_back(donkey::MeshNode(
+        0, glm::vec3(static_cast<float>(i) - 5.0f, 0.0f, -10.0f),
+        glm::vec3(0.0f), glm::vec3(1.0f), mesh_id, material_id));
+  }
+  std::list<donkey::CameraNode> camera_nodes;
+  camera_nodes.push_back(donkey::CameraNode(
+      0, glm::vec3(0.0f), glm::vec3(0.0f), glm::tvec2<int>(0, 0),
+      glm::tvec2<GLsizei>(width, height), 60.0f, 0.1f, 100.0f,
+      donkey::CameraNode::Type::kPerspective));
+  render::StackAllocator<render::MeshNode> allocator(
+      donkey::Buffer::Tag::kFramePacket, 0);
+  render::StackFramePacket frame_packet(mesh_nodes, camera_nodes, {}, {}, {},
+                                        allocator);
+  frame_packet.sort_mesh_nodes();
+
+  capture_driver.capture_next_frame(path);
+  render::CommandBucket commands(capture_driver.begin_frame());
+  renderer.render(&frame_packet, commands);
+  capture_driver.execute_commands(commands);
+  donkey::BufferPool::get_instance()->free_tag(
+      donkey::Buffer::Tag::kFramePacket, 0);
+
+  headless::Driver replay_driver;
+  render::CommandStream stream;
+  ASSERT_TRUE(render::CaptureDriver::load_capture(
+      path, replay_driver.get_resource_manager(), stream));
+  EXPECT_EQ(stream.get_command_count(), commands.get_commands().size());
+
+  headless::ResourceManager::Statistics captured =
+      driver.get_resource_manager().get_statistics();
+  headless::ResourceManager::Statistics replayed =
+      replay_driver.get_resource_manager().get_statistics();
+  EXPECT_EQ(replayed.program_count, captured.program_count);
+  EXPECT_EQ(replayed.mesh_count, captured.mesh_count);
+  EXPECT_EQ(replayed.index_count, captured.index_count);
+  EXPECT_EQ(replayed.texture_bytes, captured.texture_bytes);
+  EXPECT_EQ(replayed.framebuffer_count, captured.framebuffer_count);
+  EXPECT_EQ(replayed.state_count, captured.state_count);
+
+  render::CommandBucket replayed_commands(replay_driver.begin_frame());
+  stream.record(replayed_commands);
+  replay_driver.execute_commands(replayed_commands);
+  EXPECT_EQ(replay_driver.get_statistics().command_counts,
+            driver.get_statistics().command_counts);
+  EXPECT_EQ(replay_driver.get_statistics().index_count,
+            driver.get_statistics().index_count);
+  EXPECT_EQ(replayed_commands.get_uniform_storage_size(),
+            commands.get_uniform_storage_size());
+  std::remove(path.c_str());
+}
+
+TEST(CaptureResourceManager, ReplaysDestroyedResources) {
+  headless::ResourceManager resources;
+  render::CaptureResourceManager capture(resources);
+  uint32_t ids[3];
+  for (uint32_t& id : ids) {
+    id = capture.create_texture(4, 4, render::pixel::Format::kRGBA,
+                                render::pixel::InternalFormat::kRGBA8,
+                                render::pixel::ComponentType::kByte);
+  }
+  capture.destroy_texture(ids[1]);
+  uint32_t reused = capture.create_texture_buffer(
+      render::pixel::BufferFormat::kRGBA32F);
+
+  std::stringstream journal(std::ios::in | std::ios::out | std::ios::binary);
+  capture.write_journal(journal);
+  headless::ResourceManager replayed;
+  ASSERT_TRUE(render::CaptureResourceManager::replay_journal(journal,
+                                                             replayed));
+  EXPECT_EQ(replayed.get_texture_count(), resources.get_texture_count());
+  EXPECT_FALSE(replayed.has_texture(ids[1]));
+  EXPECT_TRUE(replayed.has_texture(ids[2]));
+  ASSERT_TRUE(replayed.has_texture(reused));
+  EXPECT_TRUE(replayed.get_texture(reused).is_buffer);
+}
+
+TEST(CommandStream, RejectsTruncatedStreams) {
+  headless::Driver driver;
+  render::CommandBucket commands(driver.begin_frame());
+  commands.bind_gpu_program(1);
+  render::ObjectBlock block = {};
+  commands.bind_uniform_block(render::UniformBlockBinding::kObject, &block,
+                              sizeof(block));
+  commands.multi_draw_elements(2, {{6, 1, 0, 0, 0}, {3, 1, 6, 4, 1}});
+  std::ostringstream out(std::ios::out | std::ios::binary);
+  render::CommandStream::write(out, commands);
+  const std::string bytes = out.str();
+
+  render::CommandStream stream;
+  for (std::size_t size = 0; size < bytes.size(); ++size) {
+    std::istringstream in(bytes.substr(0, size),
+                          std::ios::in | std::ios::binary);
+    EXPECT_FALSE(stream.read(in)) << size << " bytes";
+  }
+  std::istringstream in(bytes, std::ios::in | std::ios::binary);
+  ASSERT_TRUE(stream.read(in));
+  EXPECT_EQ(stream.get_command_count(), 3u);
+}
+
+// Sizes read from a corrupted file are checked against what's left of it
+// before anything is allocated for them.
+TEST(CommandStream, RejectsHugeLengthFields) {
+  namespace binary_io = render::binary_io;
+  render::CommandStream stream;
+  {
+    std::stringstream in(std::ios::in | std::ios::out | std::ios::binary);
+    binary_io::write(in, std::numeric_limits<uint64_t>::max());
+    binary_io::write(in, uint32_t(0));
+    EXPECT_FALSE(stream.read(in));
+  }
+  {
+    std::stringstream in(std::ios::in | std::ios::out | std::ios::binary);
+    binary_io::write(in, uint64_t(0));
+    binary_io::write(in, uint32_t(1));
+    binary_io::write(
+        in, static_cast<uint8_t>(render::Command::Type::kMultiDrawElements));
+    binary_io::write(in, uint32_t(2));
+    binary_io::write(in, std::numeric_limits<uint32_t>::max());
+    render::DrawElementsIndirect draw = {6, 1, 0, 0, 0};
+    binary_io::write(in, draw);
+    EXPECT_FALSE(stream.read(in));
+  }
+  {
+    std::stringstream in(std::ios::in | std::ios::out | std::ios::binary);
+    binary_io::write(in, std::numeric_limits<uint32_t>::max());
+    binary_io::write_bytes(in, "shader", 6);
+    std::string string;
+    EXPECT_FALSE(binary_io::read_string(in, string));
+  }
+}
@@ -0,0 +1,266 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <gtest/gtest.h>
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <list>
+#include <random>
+#include <vector>
+
+#include "Buffer.hpp"
+#include "BufferPool.hpp"
+#include "Scene.hpp"
+#include "render/ClusteredLighting.hpp"
+#include "render/CommandBucket.hpp"
+#include "render/FramePacket.hpp"
+#include "render/headless/Driver.hpp"
+
+namespace render = donkey::render;
+namespace headless = donkey::render::headless;
+
+namespace {
+
+using render::ClusteredLighting;
+
+const int kWidth = 640;
+const int kHeight = 360;
+const int kTileCountX =
+    (kWidth + ClusteredLighting::kTileSize - 1) / ClusteredLighting::kTileSize;
+const int kTileCountY = (kHeight + ClusteredLighting::kTileSize - 1) /
+                        ClusteredLighting::kTileSize;
+const std::size_t kClusterCount = static_cast<std::size_t>(kTileCountX) *
+                                  kTileCountY * ClusteredLighting::kSliceCount;
+
+struct Box {
+  glm::vec3 min;
+  glm::vec3 max;
+};
+
+// View space boxes of the clusters, built from the definition: tiles of
+// kTileSize pixels, exponential depth slices.
+std::vector<Box> get_cluster_boxes(const render::CameraNode& camera_node) {
+  glm::mat4 projection_inverse = glm::inverse(camera_node.projection);
+  auto get_direction = [&](int x, int y) {
+    float ndc_x = std::min(x * ClusteredLighting::kTileSize, kWidth) * 2.0f /
+                      kWidth -
+                  1.0f;
+    float ndc_y = std::min(y * ClusteredLighting::kTileSize, kHeight) *
+                      2.0f / kHeight -
+                  1.0f;
+    glm::vec4 point =
+        projection_inverse * glm::vec4(ndc_x, ndc_y, -1.0f, 1.0f);
+    glm::vec3 direction(point.x, point.y, point.z);
+    return direction / -direction.z;
+  };
+  float ratio = camera_node.far_plane / camera_node.near_plane;
+  std::vector<Box> boxes;
+  for (int slice = 0; slice < ClusteredLighting::kSliceCount; ++slice) {
+    float depths[] = {
+        camera_node.near_plane *
+            std::pow(ratio, slice / float(ClusteredLighting::kSliceCount)),
+        camera_node.near_plane *
+            std::pow(ratio,
+                     (slice + 1) / float(ClusteredLighting::kSliceCount))};
+    for (int y = 0; y < kTileCountY; ++y) {
+      for (int x = 0; x < kTileCountX; ++x) {
+        Box box = {glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX)};
+        for (int corner = 0; corner < 4; ++corner) {
+          glm::vec3 direction =
+              get_direction(x + corner % 2, y + corner / 2);
+          for (float depth : depths) {
+            box.min = glm::min(box.min, direction * depth);
+            box.max = glm::max(box.max, direction * depth);
+          }
+        }
+        boxes.push_back(box);
+      }
+    }
+  }
+  return boxes;
+}
+
+// Tiles the bounding box of the sphere projects to, every tile for spheres
+// crossing the near plane.
+void get_tiles(const render::CameraNode& camera_node,
+               const glm::vec4& sphere,
+               glm::ivec2& first_tile,
+               glm::ivec2& last_tile) {
+  first_tile = glm::ivec2(0, 0);
+  last_tile = glm::ivec2(kTileCountX - 1, kTileCountY - 1);
+  if (-sphere.z - sphere.w <= camera_node.near_plane)
+    return;
+  glm::vec2 min(FLT_MAX);
+  glm::vec2 max(-FLT_MAX);
+  for (int corner = 0; corner < 8; ++corner) {
+    glm::vec4 point(sphere.x + ((corner & 1) ? sphere.w : -sphere.w),
+                    sphere.y + ((corner & 2) ? sphere.w : -sphere.w),
+                    sphere.z + ((corner & 4) ? sphere.w : -sphere.w), 1.0f);
+    glm::vec4 clip = camera_node.projection * point;
+    min = glm::min(min, glm::vec2(clip.x / clip.w, clip.y / clip.w));
+    max = glm::max(max, glm::vec2(clip.x / clip.w, clip.y / clip.w));
+  }
+  auto to_tile = [](float ndc, int size, int tile_count) {
+    int tile = static_cast<int>((ndc * 0.5f + 0.5f) * size /
+                                ClusteredLighting::kTileSize);
+    return std::min(std::max(tile, 0), tile_count - 1);
+  };
+  first_tile = glm::ivec2(to_tile(min.x, kWidth, kTileCountX),
+                          to_tile(min.y, kHeight, kTileCountY));
+  last_tile = glm::ivec2(to_tile(max.x, kWidth, kTileCountX),
+                         to_tile(max.y, kHeight, kTileCountY));
+}
+
+template <typename T>
+std::vector<T> get_contents(const headless::ResourceManager& resources,
+                            uint32_t texture_buffer_id) {
+  const std::vector<uint8_t>& contents =
+      resources.get_texture(texture_buffer_id).contents;
+  std::vector<T> values(contents.size() / sizeof(T));
+  std::memcpy(values.data(), contents.data(), values.size() * sizeof(T));
+  return values;
+}
+
+class ClusteredLightingTest : public ::testing::Test {
+ protected:
+  headless::Driver driver_;
+  uint32_t light_buffer_id_;
+  uint32_t cluster_buffer_id_;
+  uint32_t light_index_buffer_id_;
+  ClusteredLighting lighting_;
+
+  void SetUp() {
+    headless::ResourceManager& resources = driver_.get_resource_manager();
+    light_buffer_id_ =
+        resources.create_texture_buffer(render::pixel::BufferFormat::kRGBA32F);
+    cluster_buffer_id_ =
+        resources.create_texture_buffer(render::pixel::BufferFormat::kRG32UI);
+    light_index_buffer_id_ =
+        resources.create_texture_buffer(render::pixel::BufferFormat::kR16UI);
+    lighting_.set_texture_buffers(light_buffer_id_, cluster_buffer_id_,
+                                  light_index_buffer_id_);
+  }
+
+  // Point lights in and around the view, the same ones for a given count.
+  static std::list<donkey::PointLightNode> create_lights(std::size_t count) {
+    std::mt19937 generator(42);
+    std::uniform_real_distribution<float> x(-30.0f, 30.0f);
+    std::uniform_real_distribution<float> y(-20.0f, 20.0f);
+    std::uniform_real_distribution<float> z(-80.0f, 2.0f);
+    std::uniform_real_distribution<float> radius(0.5f, 8.0f);
+    std::list<donkey::PointLightNode> light_nodes;
+    for (std::size_t i = 0; i < count; ++i) {
+      glm::vec3 position(x(generator), y(generator), z(generator));
+      light_nodes.push_back(donkey::PointLightNode(
+          0, position, radius(generator), glm::vec4(1.0f), glm::vec4(1.0f)));
+    }
+    return light_nodes;
+  }
+
+  // Bins the lights and checks every cluster lists, in order, the lights
+  // whose sphere touches its box, among the tiles the sphere covers.
+  void check_binning(const std::list<donkey::PointLightNode>& light_nodes) {
+    std::list<donkey::CameraNode> camera_nodes;
+    camera_nodes.push_back(donkey::CameraNode(
+        0, glm::vec3(0.0f), glm::vec3(0.0f), glm::tvec2<int>(0, 0),
+        glm::tvec2<GLsizei>(kWidth, kHeight), 60.0f, 0.1f, 100.0f,
+        donkey::CameraNode::Type::kPerspective));
+    render::StackAllocator<render::MeshNode> allocator(
+        donkey::Buffer::Tag::kFramePacket, 0);
+    render::StackFramePacket frame_packet({}, camera_nodes, {}, light_nodes,
+                                          {}, allocator);
+    const render::CameraNode& camera_node = frame_packet.get_camera_node();
+    render::CommandBucket commands(driver_.begin_frame());
+    lighting_.render(camera_node, frame_packet.get_directional_light_nodes(),
+                     frame_packet.get_point_light_nodes(),
+                     frame_packet.get_spot_light_nodes(), commands);
+    driver_.execute_commands(commands);
+
+    const headless::ResourceManager& resources =
+        driver_.get_resource_manager();
+    std::vector<ClusteredLighting::Light> lights =
+        get_contents<ClusteredLighting::Light>(resources, light_buffer_id_);
+    std::vector<uint32_t> clusters =
+        get_contents<uint32_t>(resources, cluster_buffer_id_);
+    std::vector<uint16_t> light_indices =
+        get_contents<uint16_t>(resources, light_index_buffer_id_);
+    // Buffers keep the size of their largest update, only the lights in
+    // view this frame count.
+    lights.resize(lighting_.get_light_volumes().size());
+    ASSERT_FALSE(lights.empty());
+    ASSERT_EQ(clusters.size(), kClusterCount * 2);
+
+    std::vector<Box> boxes = get_cluster_boxes(camera_node);
+    std::vector<std::vector<uint16_t>> expected(kClusterCount);
+    for (std::size_t i = 0; i < lights.size(); ++i) {
+      const glm::vec4& sphere = lights[i].position;
+      glm::ivec2 first_tile;
+      glm::ivec2 last_tile;
+      get_tiles(camera_node, sphere, first_tile, last_tile);
+      for (std::size_t cluster = 0; cluster < kClusterCount; ++cluster) {
+        int x = static_cast<int>(cluster % kTileCountX);
+        int y = static_cast<int>(cluster / kTileCountX % kTileCountY);
+        if (x < first_tile.x || x > last_tile.x || y < first_tile.y ||
+            y > last_tile.y) {
+          continue;
+        }
+        float distance = 0.0f;
+        for (int axis = 0; axis < 3; ++axis) {
+          float delta = std::max({boxes[cluster].min[axis] - sphere[axis],
+                                  sphere[axis] - boxes[cluster].max[axis],
+                                  0.0f});
+          distance += delta * delta;
+        }
+        if (distance <= sphere.w * sphere.w)
+          expected[cluster].push_back(static_cast<uint16_t>(i));
+      }
+    }
+
+    // Lists follow each other in cluster order.
+    uint32_t offset = 0;
+    for (std::size_t cluster = 0; cluster < kClusterCount; ++cluster) {
+      ASSERT_EQ(clusters[cluster * 2], offset);
+      uint32_t count = clusters[cluster * 2 + 1];
+      ASSERT_LE(offset + count, light_indices.size());
+      std::vector<uint16_t> binned(light_indices.begin() + offset,
+                                   light_indices.begin() + offset + count);
+      EXPECT_EQ(binned, expected[cluster]) << "cluster " << cluster;
+      offset += count;
+    }
+    donkey::BufferPool::get_instance()->free_tag(
+        donkey::Buffer::Tag::kFramePacket, 0);
+  }
+};
+
+TEST_F(ClusteredLightingTest, BinsFewLightsOnTheCallingThread) {
+  check_binning(create_lights(ClusteredLighting::kParallelLightCount / 2));
+}
+
+TEST_F(ClusteredLightingTest, BinsManyLightsOnTheWorkers) {
+  check_binning(create_lights(ClusteredLighting::kParallelLightCount * 4));
+  // The first of them again, below the threshold, on the calling thread.
+  check_binning(create_lights(ClusteredLighting::kParallelLightCount - 1));
+}
+
+}  // namespace
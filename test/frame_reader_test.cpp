@@ -0,0 +1,116 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <gtest/gtest.h>
+
+#if defined(STURDY_DONKEY_EGL)
+
+#include <GL/gl3w.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "render/OffscreenContext.hpp"
+#include "render/gl/FrameReader.hpp"
+
+namespace render = donkey::render;
+
+namespace {
+
+const int kWidth = 8;
+const int kHeight = 4;
+
+struct Frame {
+  std::size_t index;
+  std::vector<uint8_t> pixels;
+  int width;
+  int height;
+};
+
+uint8_t frame_red(std::size_t frame_index) {
+  return static_cast<uint8_t>(40 * (frame_index + 1));
+}
+
+// The pixel at (x, y), counting rows from the top.
+const uint8_t* get_pixel(const Frame& frame, int x, int y) {
+  return frame.pixels.data() + (y * frame.width + x) * 4;
+}
+
+}  // namespace
+
+// Each frame is cleared to its own red, except for its bottom row, cleared
+// to green. More frames are read than the ring has buffers, so that slots
+// are reused.
+TEST(FrameReader, ReadsFramesBackInOrderTopRowFirst) {
+  if (!render::OffscreenContext::is_available())
+    GTEST_SKIP() << "no EGL display to render offscreen with";
+  render::OffscreenContext context(kWidth, kHeight);
+  context.make_current(context.get_render_context());
+  ASSERT_EQ(gl3wInit(), 0);
+
+  const std::size_t frame_count = 5;
+  std::vector<Frame> frames;
+  {
+    render::gl::FrameReader frame_reader(kWidth, kHeight, 2);
+    frame_reader.set_callback([&frames](std::size_t frame_index,
+                                        const uint8_t* pixels, int width,
+                                        int height) {
+      frames.push_back(
+          {frame_index,
+           std::vector<uint8_t>(pixels, pixels + width * height * 4), width,
+           height});
+    });
+    glBindFramebuffer(GL_FRAMEBUFFER, frame_reader.get_framebuffer());
+    glViewport(0, 0, kWidth, kHeight);
+    for (std::size_t i = 0; i < frame_count; ++i) {
+      glDisable(GL_SCISSOR_TEST);
+      glClearColor(frame_red(i) / 255.0f, 0.0f, 0.0f, 1.0f);
+      glClear(GL_COLOR_BUFFER_BIT);
+      // GL's first row is the bottom one.
+      glEnable(GL_SCISSOR_TEST);
+      glScissor(0, 0, kWidth, 1);
+      glClearColor(0.0f, 1.0f, 0.0f, 1.0f);
+      glClear(GL_COLOR_BUFFER_BIT);
+      frame_reader.read_frame();
+      // Never more frames in flight than buffers.
+      EXPECT_GE(frames.size() + 2, i + 1);
+    }
+    glDisable(GL_SCISSOR_TEST);
+    frame_reader.poll(true);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  }
+  context.free_context();
+
+  ASSERT_EQ(frames.size(), frame_count);
+  for (std::size_t i = 0; i < frame_count; ++i) {
+    const Frame& frame = frames[i];
+    EXPECT_EQ(frame.index, i);
+    ASSERT_EQ(frame.width, kWidth);
+    ASSERT_EQ(frame.height, kHeight);
+    for (int y = 0; y < kHeight; ++y) {
+      const uint8_t* pixel = get_pixel(frame, kWidth / 2, y);
+      bool bottom = (y == kHeight - 1);
+      EXPECT_EQ(pixel[0], bottom ? 0 : frame_red(i)) << "frame " << i;
+      EXPECT_EQ(pixel[1], bottom ? 255 : 0) << "frame " << i;
+      EXPECT_EQ(pixel[2], 0);
+      EXPECT_EQ(pixel[3], 255);
+    }
+  }
+}
+
+#endif
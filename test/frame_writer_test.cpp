@@ -0,0 +1,61 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "render/FrameWriter.hpp"
+
+namespace {
+
+bool exists(const std::string& path) {
+  return std::ifstream(path).good();
+}
+
+}  // namespace
+
+// More frames than can be pending at once, so that write has to wait for
+// the writer thread.
+TEST(FrameWriter, SavesEveryFrameWritten) {
+  typedef donkey::render::FrameWriter FrameWriter;
+  const std::string path_prefix = testing::TempDir() + "frame_writer_test_";
+  const std::size_t frame_count = 2 * FrameWriter::kMaxPendingFrames;
+  std::vector<uint8_t> pixels(4 * 2 * 4, 255);
+  std::vector<std::string> paths;
+  for (std::size_t i = 0; i <= frame_count; ++i) {
+    paths.push_back(path_prefix + std::to_string(i) + ".png");
+    std::remove(paths.back().c_str());
+  }
+  {
+    FrameWriter frame_writer(path_prefix);
+    for (std::size_t i = 0; i < frame_count; ++i)
+      frame_writer.write(i, pixels.data(), 4, 2);
+    frame_writer.flush();
+    for (std::size_t i = 0; i < frame_count; ++i)
+      EXPECT_TRUE(exists(paths[i])) << paths[i];
+    // This one is saved by the destructor.
+    frame_writer.write(frame_count, pixels.data(), 4, 2);
+  }
+  EXPECT_TRUE(exists(paths[frame_count])) << paths[frame_count];
+  for (const std::string& path : paths)
+    std::remove(path.c_str());
+}
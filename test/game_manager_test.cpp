@@ -0,0 +1,88 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <gtest/gtest.h>
+
+#include <cstddef>
+
+#include "GameManager.hpp"
+#include "render/headless/Driver.hpp"
+
+#if defined(STURDY_DONKEY_EGL)
+#include "render/OffscreenContext.hpp"
+#endif
+
+namespace render = donkey::render;
+
+namespace {
+
+// A camera and nothing to see, only the renderer's own resources are
+// created.
+class EmptyResourceLoader : public donkey::IResourceLoaderDelegate {
+ public:
+  virtual void load_game_objects(donkey::Scene& scene) {
+    scene.create_perspective_camera_node(
+        0, 45.0f, 0.1f, 1000.0f, glm::vec3(0.0f, 0.0f, 90.0f),
+        glm::vec3(0.0f), glm::tvec2<int>(0, 0),
+        glm::tvec2<GLsizei>(1600, 900));
+  }
+  virtual void load_render_resources(
+      render::Window* /*window*/,
+      render::ResourceManager* /*resource_manager*/,
+      render::GpuResourceManager* /*gpu_resource_manager*/) {}
+};
+
+}  // namespace
+
+TEST(GameManager, RunsAndShutsDownHeadless) {
+  EmptyResourceLoader resource_loader;
+  donkey::GameManager game_manager(resource_loader,
+                                   donkey::GameManager::Backend::kHeadless);
+  game_manager.set_frame_limit(3);
+  game_manager.run();
+  const auto& driver =
+      static_cast<const render::headless::Driver&>(game_manager.get_driver());
+  EXPECT_EQ(driver.get_statistics().frame_count, 3u);
+}
+
+#if defined(STURDY_DONKEY_EGL)
+
+// The render thread has to let go of the context for the destructor to
+// release the GL resources, see GameManager::render_loop.
+TEST(GameManager, RunsAndShutsDownOffscreen) {
+  if (!render::OffscreenContext::is_available())
+    GTEST_SKIP() << "no EGL display to render offscreen with";
+  EmptyResourceLoader resource_loader;
+  std::size_t frame_count = 0;
+  {
+    // Not caching programs, so that the test leaves no files behind.
+    donkey::GameManager game_manager(
+        resource_loader, donkey::GameManager::Backend::kOffscreen, "");
+    game_manager.set_frame_limit(3);
+    game_manager.set_frame_callback(
+        [&frame_count](std::size_t frame_index, const uint8_t* /*pixels*/,
+                       int /*width*/, int /*height*/) {
+          EXPECT_EQ(frame_index, frame_count);
+          ++frame_count;
+        });
+    game_manager.run();
+  }
+  // Frames still in flight when the loop ends are read back too.
+  EXPECT_EQ(frame_count, 3u);
+}
+
+#endif
@@ -0,0 +1,767 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <list>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "Buffer.hpp"
+#include "BufferPool.hpp"
+#include "Scene.hpp"
+#include "render/CommandBucket.hpp"
+#include "render/DeferredRenderer.hpp"
+#include "render/FramePacket.hpp"
+#include "render/Pipeline.hpp"
+#include "render/PipelineGenerator.hpp"
+#include "render/ResourceManager.hpp"
+#include "render/headless/Driver.hpp"
+
+namespace render = donkey::render;
+namespace headless = donkey::render::headless;
+
+namespace {
+
+const int kWidth = 640;
+const int kHeight = 360;
+
+std::size_t get_command_count(const headless::Driver& driver,
+                              render::Command::Type type) {
+  return driver.get_statistics()
+      .command_counts[static_cast<std::size_t>(type)];
+}
+
+uint32_t create_triangle(render::ResourceManager& resource_manager) {
+  std::vector<float> positions = {0.0f, 0.0f, 0.0f, 1.0f, 0.0f,
+                                  0.0f, 0.0f, 1.0f, 0.0f};
+  std::vector<float> normals = {0.0f, 0.0f, 1.0f, 0.0f, 0.0f,
+                                1.0f, 0.0f, 0.0f, 1.0f};
+  std::vector<float> uvs = {0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f};
+  std::vector<float> tangents = {1.0f, 0.0f, 0.0f, 1.0f, 0.0f,
+                                 0.0f, 1.0f, 0.0f, 0.0f};
+  std::vector<float> bitangents = {0.0f, 1.0f, 0.0f, 0.0f, 1.0f,
+                                   0.0f, 0.0f, 1.0f, 0.0f};
+  return resource_manager.create_mesh(positions, normals, uvs, tangents,
+                                      bitangents, {0, 1, 2});
+}
+
+std::list<donkey::MeshNode> create_nodes(uint32_t mesh_id,
+                                         const std::vector<uint32_t>& materials,
+                                         int count) {
+  std::list<donkey::MeshNode> mesh_nodes;
+  for (int i = 0; i < count; ++i) {
+    glm::vec3 position(static_cast<float>(i % 10) - 5.0f,
+                       static_cast<float>(i / 10) - 5.0f, -20.0f);
+    mesh_nodes.push_back(donkey::MeshNode(
+        0, position, glm::vec3(0.0f), glm::vec3(0.5f), mesh_id,
+        materials[static_cast<std::size_t>(i) % materials.size()]));
+  }
+  return mesh_nodes;
+}
+
+std::size_t render_frame(render::DeferredRenderer& renderer,
+                         headless::Driver& driver,
+                         const std::list<donkey::MeshNode>& mesh_nodes) {
+  std::list<donkey::CameraNode> camera_nodes;
+  camera_nodes.push_back(donkey::CameraNode(
+      0, glm::vec3(0.0f), glm::vec3(0.0f), glm::tvec2<int>(0, 0),
+      glm::tvec2<GLsizei>(kWidth, kHeight), 60.0f, 0.1f, 100.0f,
+      donkey::CameraNode::Type::kPerspective));
+  render::StackAllocator<render::MeshNode> allocator(
+      donkey::Buffer::Tag::kFramePacket, 0);
+  render::StackFramePacket frame_packet(mesh_nodes, camera_nodes, {}, {}, {},
+                                        allocator);
+  frame_packet.sort_mesh_nodes();
+  render::CommandBucket commands(driver.begin_frame());
+  renderer.render(&frame_packet, commands);
+  driver.execute_commands(commands);
+  donkey::BufferPool::get_instance()->free_tag(
+      donkey::Buffer::Tag::kFramePacket, 0);
+  return driver.get_draw_call_count();
+}
+
+}  // namespace
+
+TEST(HeadlessDriver, CountsAndLogsCommands) {
+  headless::Driver driver;
+  render::GpuResourceManager& resources = driver.get_resource_manager();
+  uint32_t program_id = resources.load_gpu_program_from_file("a.vert.glsl",
+                                                             "a.frag.glsl");
+  uint32_t mesh_id = resources.create_mesh({0.0f, 0.0f, 0.0f}, {}, {}, {}, {},
+                                           {0, 0, 0, 0, 0, 0});
+  std::ostringstream log;
+  driver.set_log(&log);
+
+  render::CommandBucket commands(driver.begin_frame());
+  commands.bind_gpu_program(program_id);
+  commands.bind_mesh(mesh_id, 0, 1, 2, 3, 4);
+  commands.draw_elements(6);
+  render::ObjectBlock block = {};
+  commands.bind_uniform_block(render::UniformBlockBinding::kObject, &block,
+                              sizeof(block));
+  driver.execute_commands(commands);
+
+  const headless::Driver::Statistics& statistics = driver.get_statistics();
+  EXPECT_EQ(statistics.frame_count, 1u);
+  EXPECT_EQ(statistics.command_count, 4u);
+  EXPECT_EQ(statistics.draw_call_count, 1u);
+  EXPECT_EQ(statistics.index_count, 6u);
+  EXPECT_EQ(driver.get_draw_call_count(), 1u);
+  EXPECT_EQ(get_command_count(driver, render::Command::Type::kBindMesh), 1u);
+  EXPECT_NE(log.str().find("draw_elements 6"), std::string::npos);
+
+  driver.reset_statistics();
+  EXPECT_EQ(driver.get_statistics().command_count, 0u);
+}
+
+TEST(HeadlessDriver, GrowsTheUniformStorageOfFramesThatOverflow) {
+  headless::Driver driver;
+  render::GpuResourceManager& resources = driver.get_resource_manager();
+  uint32_t program_id = resources.load_gpu_program_from_file("a.vert.glsl",
+                                                             "a.frag.glsl");
+  uint32_t mesh_id = resources.create_mesh({0.0f, 0.0f, 0.0f}, {}, {}, {}, {},
+                                           {0, 0, 0});
+  // More object blocks than the storage the driver starts with holds.
+  const std::size_t draw_count = 20000;
+  auto record_frame = [&](render::CommandBucket& commands) {
+    commands.bind_gpu_program(program_id);
+    commands.bind_mesh(mesh_id, 0, 1, 2, 3, 4);
+    for (std::size_t i = 0; i < draw_count; ++i) {
+      render::ObjectBlock block = {};
+      block.model[3][0] = static_cast<float>(i);
+      commands.bind_uniform_block(render::UniformBlockBinding::kObject,
+                                  &block, sizeof(block));
+      commands.draw_elements(3);
+    }
+  };
+
+  render::UniformStorage storage = driver.begin_frame();
+  render::CommandBucket commands(storage);
+  record_frame(commands);
+  ASSERT_GT(commands.get_uniform_storage_size(), storage.capacity);
+  EXPECT_EQ(commands.get_uniform_storage_size(),
+            storage.capacity + commands.get_uniform_overflow().size());
+  // The last block went past the storage, nothing was dropped.
+  render::ObjectBlock last;
+  std::memcpy(&last,
+              commands.get_uniform_overflow().data() +
+                  commands.get_uniform_overflow().size() - sizeof(last),
+              sizeof(last));
+  EXPECT_EQ(last.model[3][0], static_cast<float>(draw_count - 1));
+  driver.execute_commands(commands);
+  EXPECT_EQ(driver.get_draw_call_count(), draw_count);
+
+  // The next frames get storage enough for it.
+  render::UniformStorage grown_storage = driver.begin_frame();
+  EXPECT_GE(grown_storage.capacity, commands.get_uniform_storage_size());
+  render::CommandBucket grown_commands(grown_storage);
+  record_frame(grown_commands);
+  EXPECT_TRUE(grown_commands.get_uniform_overflow().empty());
+  driver.execute_commands(grown_commands);
+  EXPECT_EQ(driver.get_draw_call_count(), draw_count);
+}
+
+TEST(HeadlessResourceManager, LaysMeshesOutBackToBack) {
+  headless::ResourceManager resources;
+  resources.create_mesh(std::vector<float>(3 * 4), {}, {}, {}, {},
+                        std::vector<uint32_t>(6));
+  uint32_t second = resources.create_mesh(std::vector<float>(3 * 3), {}, {},
+                                          {}, {}, std::vector<uint32_t>(3));
+  render::DrawElementsIndirect draw = resources.get_mesh_draw(second);
+  EXPECT_EQ(draw.count, 3u);
+  EXPECT_EQ(draw.first_index, 6u);
+  EXPECT_EQ(draw.base_vertex, 4);
+
+  resources.create_texture(16, 16, render::pixel::Format::kRGBA,
+                           render::pixel::InternalFormat::kRGBA16F,
+                           render::pixel::ComponentType::kFloat);
+  headless::ResourceManager::Statistics statistics =
+      resources.get_statistics();
+  EXPECT_EQ(statistics.mesh_count, 2u);
+  EXPECT_EQ(statistics.vertex_count, 7u);
+  EXPECT_EQ(statistics.index_count, 9u);
+  EXPECT_EQ(statistics.texture_count, 1u);
+  EXPECT_EQ(statistics.texture_bytes, 16u * 16u * 8u);
+}
+
+TEST(HeadlessResourceManager, ReusesTheRangesOfDestroyedMeshes) {
+  headless::ResourceManager resources;
+  uint32_t first = resources.create_mesh(std::vector<float>(3 * 4), {}, {},
+                                         {}, {}, std::vector<uint32_t>(6));
+  resources.create_mesh(std::vector<float>(3 * 3), {}, {}, {}, {},
+                        std::vector<uint32_t>(3));
+  render::DrawElementsIndirect first_draw = resources.get_mesh_draw(first);
+  headless::ResourceManager::Statistics loaded = resources.get_statistics();
+
+  // Reloading the mesh takes its range back, the buffers don't grow.
+  resources.destroy_mesh(first);
+  uint32_t reloaded = resources.create_mesh(std::vector<float>(3 * 4), {}, {},
+                                            {}, {}, std::vector<uint32_t>(6));
+  render::DrawElementsIndirect draw = resources.get_mesh_draw(reloaded);
+  EXPECT_EQ(draw.first_index, first_draw.first_index);
+  EXPECT_EQ(draw.base_vertex, first_draw.base_vertex);
+  headless::ResourceManager::Statistics reloaded_statistics =
+      resources.get_statistics();
+  EXPECT_EQ(reloaded_statistics.vertex_count, loaded.vertex_count);
+  EXPECT_EQ(reloaded_statistics.index_count, loaded.index_count);
+
+  // Smaller meshes fit in there too.
+  resources.destroy_mesh(reloaded);
+  resources.create_mesh(std::vector<float>(3 * 2), {}, {}, {}, {},
+                        std::vector<uint32_t>(3));
+  resources.create_mesh(std::vector<float>(3 * 2), {}, {}, {}, {},
+                        std::vector<uint32_t>(3));
+  EXPECT_EQ(resources.get_statistics().vertex_count, loaded.vertex_count);
+  EXPECT_EQ(resources.get_statistics().index_count, loaded.index_count);
+}
+
+TEST(HeadlessResourceManager, DestroysResourcesThroughTheirHandles) {
+  headless::Driver driver;
+  const headless::ResourceManager& resources = driver.get_resource_manager();
+  render::ResourceManager resource_manager(driver.get_resource_manager());
+  render::ResourceManager::Id program =
+      resource_manager.load_gpu_program_from_file("a.vert.glsl", "a.frag.glsl");
+  EXPECT_EQ(resource_manager.load_gpu_program_from_file("a.vert.glsl",
+                                                        "a.frag.glsl"),
+            program);
+  EXPECT_NE(resource_manager.load_gpu_program_from_sources("a.vert.glsl",
+                                                           "a.frag.glsl"),
+            program);
+  EXPECT_EQ(resources.get_gpu_program_count(), 2u);
+
+  uint32_t material = resource_manager.create_material(program);
+  uint32_t first = create_triangle(resource_manager);
+  uint32_t second = create_triangle(resource_manager);
+  uint32_t first_gpu_id = resource_manager.get_mesh(first).gpu_resource_id;
+  resource_manager.destroy_mesh(first);
+  EXPECT_FALSE(resources.has_mesh(first_gpu_id));
+  EXPECT_EQ(resources.get_mesh_count(), 1u);
+  EXPECT_EQ(resource_manager.get_mesh(second).index_count, 3u);
+
+  // The slot comes back, the handle doesn't.
+  uint32_t third = create_triangle(resource_manager);
+  uint32_t third_gpu_id = resource_manager.get_mesh(third).gpu_resource_id;
+  EXPECT_NE(third, first);
+  EXPECT_NE(third_gpu_id, first_gpu_id);
+  EXPECT_TRUE(resources.has_mesh(third_gpu_id));
+  // Meshes are never moved around, the new one takes the range the first
+  // one left.
+  EXPECT_EQ(resources.get_mesh_draw(third_gpu_id).first_index, 0u);
+
+  uint32_t gpu_material =
+      resource_manager.get_material(material).gpu_resource_id;
+  resource_manager.destroy_material(material);
+  resource_manager.destroy_gpu_program(program);
+  EXPECT_FALSE(resources.has_material(gpu_material));
+  EXPECT_EQ(resources.get_gpu_program_count(), 1u);
+  // Loading it again builds a new program.
+  EXPECT_NE(resource_manager.load_gpu_program_from_file("a.vert.glsl",
+                                                        "a.frag.glsl"),
+            program);
+  EXPECT_EQ(resources.get_gpu_program_count(), 2u);
+}
+
+TEST(HeadlessDriver, RendersDeferredFrames) {
+  headless::Driver driver;
+  render::ResourceManager resource_manager(driver.get_resource_manager());
+  uint32_t mesh_id = create_triangle(resource_manager);
+  render::ResourceManager::Id program_id =
+      resource_manager.load_gpu_program_from_file(
+          "shaders/gbuffer-pass.vert.glsl", "shaders/gbuffer-pass.frag.glsl");
+  std::vector<uint32_t> materials = {
+      resource_manager.create_material(program_id),
+      resource_manager.create_material(program_id)};
+  std::list<donkey::MeshNode> mesh_nodes =
+      create_nodes(mesh_id, materials, 100);
+
+  render::DeferredRenderer renderer(kWidth, kHeight, &driver,
+                                    &resource_manager);
+  std::size_t per_node = render_frame(renderer, driver, mesh_nodes);
+  EXPECT_GE(per_node, mesh_nodes.size());
+
+  renderer.set_multi_draw(true);
+  std::size_t multi_draw = render_frame(renderer, driver, mesh_nodes);
+  EXPECT_LT(multi_draw, per_node);
+  EXPECT_EQ(get_command_count(driver,
+                              render::Command::Type::kMultiDrawElements),
+            materials.size());
+  EXPECT_EQ(driver.get_statistics().frame_count, 2u);
+  resource_manager.cleanup();
+}
+
+TEST(HeadlessDriver, UploadsTheModelsOfAViewOnceForAllItsPasses) {
+  headless::Driver driver;
+  render::ResourceManager resource_manager(driver.get_resource_manager());
+  uint32_t mesh_id = create_triangle(resource_manager);
+  render::ResourceManager::Id program_id =
+      resource_manager.load_gpu_program_from_file(
+          "shaders/gbuffer-pass.vert.glsl", "shaders/gbuffer-pass.frag.glsl");
+  std::vector<uint32_t> materials = {
+      resource_manager.create_material(program_id)};
+  std::list<donkey::MeshNode> mesh_nodes =
+      create_nodes(mesh_id, materials, 40);
+
+  // The depth pre-pass and the gbuffer pass both multi-draw the nodes.
+  render::DeferredRenderer renderer(
+      kWidth, kHeight, &driver, &resource_manager,
+      render::DeferredRenderer::LightingMode::kClustered,
+      render::DeferredRenderer::GBufferLayout::kPacked, true);
+  renderer.set_multi_draw(true);
+  // A stereo pair side by side.
+  const int half_width = kWidth / 2;
+  std::list<donkey::CameraNode> camera_nodes;
+  for (int view = 0; view < 2; ++view) {
+    camera_nodes.push_back(donkey::CameraNode(
+        0, glm::vec3(view == 1 ? 0.1f : 0.0f, 0.0f, 0.0f), glm::vec3(0.0f),
+        glm::tvec2<int>(view == 1 ? half_width : 0, 0),
+        glm::tvec2<GLsizei>(half_width, kHeight), 60.0f, 0.1f, 100.0f,
+        donkey::CameraNode::Type::kPerspective));
+  }
+  render::StackAllocator<render::MeshNode> allocator(
+      donkey::Buffer::Tag::kFramePacket, 0);
+  render::StackFramePacket frame_packet(mesh_nodes, camera_nodes, {}, {}, {},
+                                        allocator);
+  frame_packet.sort_mesh_nodes();
+  std::ostringstream log;
+  driver.set_log(&log);
+  render::CommandBucket commands(driver.begin_frame());
+  renderer.render(&frame_packet, commands);
+  driver.execute_commands(commands);
+  driver.set_log(nullptr);
+  donkey::BufferPool::get_instance()->free_tag(
+      donkey::Buffer::Tag::kFramePacket, 0);
+  EXPECT_EQ(get_command_count(driver,
+                              render::Command::Type::kMultiDrawElements),
+            4u);
+
+  // Texture buffer updates of the size of every node's model matrix: one
+  // per view, the second one after the first.
+  std::istringstream lines(log.str());
+  std::string line;
+  std::vector<std::size_t> model_offsets;
+  while (std::getline(lines, line)) {
+    std::istringstream tokens(line);
+    std::string name;
+    uint32_t texture_id;
+    std::size_t buffer_offset;
+    std::size_t size;
+    tokens >> name >> texture_id >> buffer_offset >> size;
+    if (name == "update_texture_buffer" &&
+        size == mesh_nodes.size() * sizeof(glm::mat4))
+      model_offsets.push_back(buffer_offset);
+  }
+  ASSERT_EQ(model_offsets.size(), 2u);
+  EXPECT_EQ(model_offsets[0], 0u);
+  EXPECT_EQ(model_offsets[1], mesh_nodes.size() * sizeof(glm::mat4));
+  resource_manager.cleanup();
+}
+
+TEST(HeadlessDriver, PassesOnlyDrawTheirLayers) {
+  headless::Driver driver;
+  render::ResourceManager resource_manager(driver.get_resource_manager());
+  uint32_t mesh_id = create_triangle(resource_manager);
+  render::ResourceManager::Id program_id =
+      resource_manager.load_gpu_program_from_file(
+          "shaders/gbuffer-pass.vert.glsl", "shaders/gbuffer-pass.frag.glsl");
+  std::vector<uint32_t> materials = {
+      resource_manager.create_material(program_id)};
+  // 30 nodes in layer 0, 20 in layer 1 and 10 in both.
+  std::list<donkey::MeshNode> mesh_nodes =
+      create_nodes(mesh_id, materials, 60);
+  int i = 0;
+  for (donkey::MeshNode& mesh_node : mesh_nodes) {
+    if (i >= 50)
+      mesh_node.layers = donkey::SceneNode::get_layer(0) |
+                         donkey::SceneNode::get_layer(1);
+    else if (i >= 30)
+      mesh_node.layers = donkey::SceneNode::get_layer(1);
+    ++i;
+  }
+
+  render::Pipeline pipeline(&driver, &resource_manager);
+  render::GpuResourceManager& resources = driver.get_resource_manager();
+  pipeline.set_light_buffers(
+      resources.create_texture_buffer(render::pixel::BufferFormat::kRGBA32F),
+      resources.create_texture_buffer(render::pixel::BufferFormat::kRG32UI),
+      resources.create_texture_buffer(render::pixel::BufferFormat::kR16UI));
+  const uint32_t screen = std::numeric_limits<uint32_t>::max();
+  pipeline.add_render_pass(screen, 0, true, false, false, false,
+                           donkey::SceneNode::get_layer(0));
+  pipeline.add_render_pass(screen, 0, true, false, false, false,
+                           donkey::SceneNode::get_layer(1));
+  pipeline.add_render_pass(screen, 0, true, false, false, false,
+                           donkey::SceneNode::get_layer(2));
+  pipeline.add_render_pass(screen, 0, true, false, false, false);
+
+  std::list<donkey::CameraNode> camera_nodes;
+  camera_nodes.push_back(donkey::CameraNode(
+      0, glm::vec3(0.0f), glm::vec3(0.0f), glm::tvec2<int>(0, 0),
+      glm::tvec2<GLsizei>(kWidth, kHeight), 60.0f, 0.1f, 100.0f,
+      donkey::CameraNode::Type::kPerspective));
+  render::StackAllocator<render::MeshNode> allocator(
+      donkey::Buffer::Tag::kFramePacket, 0);
+  render::StackFramePacket frame_packet(mesh_nodes, camera_nodes, {}, {}, {},
+                                        allocator);
+  frame_packet.sort_mesh_nodes();
+  render::CommandBucket commands(driver.begin_frame());
+  pipeline.render(&frame_packet, commands);
+  driver.execute_commands(commands);
+  donkey::BufferPool::get_instance()->free_tag(
+      donkey::Buffer::Tag::kFramePacket, 0);
+
+  EXPECT_EQ(driver.get_draw_call_count(), 40u + 30u + 0u + 60u);
+  resource_manager.cleanup();
+}
+
+TEST(HeadlessDriver, DrawsEachViewIntoItsViewport) {
+  headless::Driver driver;
+  render::ResourceManager resource_manager(driver.get_resource_manager());
+  uint32_t mesh_id = create_triangle(resource_manager);
+  render::ResourceManager::Id program_id =
+      resource_manager.load_gpu_program_from_file(
+          "shaders/gbuffer-pass.vert.glsl", "shaders/gbuffer-pass.frag.glsl");
+  std::vector<uint32_t> materials = {
+      resource_manager.create_material(program_id)};
+  // 40 nodes in layer 0 and 20 in layer 1.
+  std::list<donkey::MeshNode> mesh_nodes =
+      create_nodes(mesh_id, materials, 60);
+  int i = 0;
+  for (donkey::MeshNode& mesh_node : mesh_nodes) {
+    if (i++ >= 40)
+      mesh_node.layers = donkey::SceneNode::get_layer(1);
+  }
+
+  render::Pipeline pipeline(&driver, &resource_manager);
+  render::GpuResourceManager& resources = driver.get_resource_manager();
+  pipeline.set_light_buffers(
+      resources.create_texture_buffer(render::pixel::BufferFormat::kRGBA32F),
+      resources.create_texture_buffer(render::pixel::BufferFormat::kRG32UI),
+      resources.create_texture_buffer(render::pixel::BufferFormat::kR16UI));
+  const uint32_t screen = std::numeric_limits<uint32_t>::max();
+  pipeline.add_render_pass(screen, 0, true, false, false, false);
+
+  // A stereo pair side by side, the right eye seeing layer 1 only, and a
+  // view looking away from every node.
+  const int half_width = kWidth / 2;
+  std::list<donkey::CameraNode> camera_nodes;
+  for (int view = 0; view < 3; ++view) {
+    camera_nodes.push_back(donkey::CameraNode(
+        0, glm::vec3(view == 1 ? 0.1f : 0.0f, 0.0f, 0.0f),
+        glm::vec3(0.0f, view == 2 ? 180.0f : 0.0f, 0.0f),
+        glm::tvec2<int>(view == 1 ? half_width : 0, 0),
+        glm::tvec2<GLsizei>(half_width, kHeight), 60.0f, 0.1f, 100.0f,
+        donkey::CameraNode::Type::kPerspective));
+  }
+  camera_nodes.back().viewport_size = glm::tvec2<GLsizei>(kWidth, kHeight);
+  (++camera_nodes.begin())->layers = donkey::SceneNode::get_layer(1);
+  render::StackAllocator<render::MeshNode> allocator(
+      donkey::Buffer::Tag::kFramePacket, 0);
+  render::StackFramePacket frame_packet(mesh_nodes, camera_nodes, {}, {}, {},
+                                        allocator);
+  ASSERT_EQ(frame_packet.get_camera_nodes().size(), 3u);
+  frame_packet.sort_mesh_nodes();
+  std::ostringstream log;
+  driver.set_log(&log);
+  render::CommandBucket commands(driver.begin_frame());
+  pipeline.render(&frame_packet, commands);
+  driver.execute_commands(commands);
+  donkey::BufferPool::get_instance()->free_tag(
+      donkey::Buffer::Tag::kFramePacket, 0);
+
+  EXPECT_EQ(driver.get_draw_call_count(), 60u + 20u + 0u);
+  EXPECT_EQ(get_command_count(driver, render::Command::Type::kSetViewport),
+            3u);
+  EXPECT_NE(log.str().find("set_viewport 0 0 320 360"), std::string::npos);
+  EXPECT_NE(log.str().find("set_viewport 320 0 320 360"), std::string::npos);
+  EXPECT_NE(log.str().find("set_viewport 0 0 640 360"), std::string::npos);
+  const render::ViewCulling::Statistics& statistics =
+      pipeline.get_view_culling_statistics();
+  EXPECT_EQ(statistics.view_count, 3u);
+  EXPECT_EQ(statistics.tested_count, 60u);
+  EXPECT_EQ(statistics.view_culled_count, 60u);
+  resource_manager.cleanup();
+}
+
+TEST(HeadlessDriver, DrawsShadowCastersOnlyWhenTheyMove) {
+  headless::Driver driver;
+  render::ResourceManager resource_manager(driver.get_resource_manager());
+  uint32_t mesh_id = create_triangle(resource_manager);
+  render::ResourceManager::Id program_id =
+      resource_manager.load_gpu_program_from_file(
+          "shaders/gbuffer-pass.vert.glsl", "shaders/gbuffer-pass.frag.glsl");
+  std::vector<uint32_t> materials = {
+      resource_manager.create_material(program_id)};
+  std::list<donkey::MeshNode> mesh_nodes =
+      create_nodes(mesh_id, materials, 20);
+
+  render::DeferredRenderer renderer(
+      kWidth, kHeight, &driver, &resource_manager,
+      render::DeferredRenderer::LightingMode::kClustered,
+      render::DeferredRenderer::GBufferLayout::kPacked, false,
+      render::ShadowCascades::Quality::kLow);
+  std::list<donkey::CameraNode> camera_nodes;
+  camera_nodes.push_back(donkey::CameraNode(
+      0, glm::vec3(0.0f), glm::vec3(0.0f), glm::tvec2<int>(0, 0),
+      glm::tvec2<GLsizei>(kWidth, kHeight), 60.0f, 0.1f, 100.0f,
+      donkey::CameraNode::Type::kPerspective));
+  std::list<donkey::DirectionalLightNode> light_nodes;
+  light_nodes.push_back(donkey::DirectionalLightNode(
+      0, glm::vec3(0.0f), glm::vec3(-30.0f, 0.0f, 0.0f), glm::vec4(1.0f),
+      glm::vec4(1.0f)));
+  render::StackAllocator<render::MeshNode> allocator(
+      donkey::Buffer::Tag::kFramePacket, 0);
+  auto render_shadowed_frame =
+      [&](const std::list<donkey::MeshNode>& frame_mesh_nodes) {
+        render::StackFramePacket frame_packet(frame_mesh_nodes, camera_nodes,
+                                              light_nodes, {}, {}, allocator);
+        frame_packet.sort_mesh_nodes();
+        render::CommandBucket commands(driver.begin_frame());
+        renderer.render(&frame_packet, commands);
+        driver.execute_commands(commands);
+        donkey::BufferPool::get_instance()->free_tag(
+            donkey::Buffer::Tag::kFramePacket, 0);
+        return driver.get_draw_call_count();
+      };
+
+  // Each cascade drawn gets its cached static depth copied by a quad, then
+  // its casters drawn.
+  std::size_t shadowed = render_shadowed_frame(mesh_nodes);
+  const render::ShadowCascades::Statistics& statistics =
+      renderer.get_shadow_statistics();
+  EXPECT_EQ(statistics.drawn_cascade_count, 2u);
+  EXPECT_EQ(statistics.static_caster_count, 0u);
+  EXPECT_GE(statistics.dynamic_caster_count, mesh_nodes.size());
+  std::size_t shadow_draws =
+      statistics.drawn_cascade_count + statistics.dynamic_caster_count;
+
+  // The cascades holding casters last frame are drawn once more without
+  // them, then left alone.
+  std::size_t unshadowed = render_shadowed_frame({});
+  EXPECT_GE(statistics.drawn_cascade_count, 1u);
+  EXPECT_EQ(statistics.dynamic_caster_count, 0u);
+  std::size_t cleared = statistics.drawn_cascade_count;
+  EXPECT_EQ(render_shadowed_frame({}), unshadowed - cleared);
+  EXPECT_EQ(statistics.drawn_cascade_count, 0u);
+  EXPECT_EQ(shadowed - shadow_draws, unshadowed - cleared + mesh_nodes.size());
+  resource_manager.cleanup();
+}
+
+TEST(HeadlessDriver, DrawsScaledScenesIntoTheWholeWindow) {
+  headless::Driver driver;
+  render::ResourceManager resource_manager(driver.get_resource_manager());
+  uint32_t mesh_id = create_triangle(resource_manager);
+  render::ResourceManager::Id program_id =
+      resource_manager.load_gpu_program_from_file(
+          "shaders/gbuffer-pass.vert.glsl", "shaders/gbuffer-pass.frag.glsl");
+  std::vector<uint32_t> materials = {
+      resource_manager.create_material(program_id)};
+  std::list<donkey::MeshNode> mesh_nodes =
+      create_nodes(mesh_id, materials, 20);
+
+  render::DeferredRenderer renderer(kWidth, kHeight, &driver,
+                                    &resource_manager);
+  std::size_t full = render_frame(renderer, driver, mesh_nodes);
+  // clamped to the size of the render targets
+  renderer.set_resolution_scale(2.0f);
+  EXPECT_FLOAT_EQ(renderer.get_resolution_scale(), 1.0f);
+
+  renderer.set_resolution_scale(0.5f);
+  std::ostringstream log;
+  driver.set_log(&log);
+  EXPECT_EQ(render_frame(renderer, driver, mesh_nodes), full);
+  driver.set_log(nullptr);
+  EXPECT_NE(log.str().find("set_viewport 0 0 320 180"), std::string::npos);
+  EXPECT_NE(log.str().find("set_viewport 0 0 640 360"), std::string::npos);
+  resource_manager.cleanup();
+}
+
+TEST(HeadlessDriver, FusesTheAlbedoPassIntoTheAmbientPass) {
+  // The shaders are read from the working directory, without them nothing
+  // gets fused. See add_test in test/CMakeLists.txt.
+  ASSERT_TRUE(std::ifstream("shaders/albedo-pass.frag.glsl").good())
+      << "run the tests from the root of the source tree";
+  headless::Driver driver;
+  render::ResourceManager resource_manager(driver.get_resource_manager());
+  render::DeferredRenderer renderer(kWidth, kHeight, &driver,
+                                    &resource_manager);
+  const headless::ResourceManager& resources = driver.get_resource_manager();
+  std::size_t fused_count = 0;
+  for (uint32_t i = 0; i < resources.get_gpu_program_count(); ++i) {
+    const headless::ResourceManager::Program& program =
+        resources.get_gpu_program(i);
+    EXPECT_NE(program.fs_path, "shaders/albedo-pass.frag.glsl");
+    if (program.fs_sources.find("fetch_light_plus_albedo_texture(") !=
+        std::string::npos) {
+      EXPECT_FALSE(program.vs_sources.empty());
+      ++fused_count;
+    }
+  }
+  EXPECT_EQ(fused_count, 1u);
+  resource_manager.cleanup();
+}
+
+TEST(HeadlessDriver, StencilsLightVolumesAgainstACopyOfTheDepth) {
+  headless::Driver driver;
+  render::ResourceManager resource_manager(driver.get_resource_manager());
+  uint32_t mesh_id = create_triangle(resource_manager);
+  render::ResourceManager::Id program_id =
+      resource_manager.load_gpu_program_from_file(
+          "shaders/gbuffer-pass.vert.glsl", "shaders/gbuffer-pass.frag.glsl");
+  std::vector<uint32_t> materials = {
+      resource_manager.create_material(program_id)};
+  std::list<donkey::MeshNode> mesh_nodes =
+      create_nodes(mesh_id, materials, 20);
+
+  render::DeferredRenderer renderer(
+      kWidth, kHeight, &driver, &resource_manager,
+      render::DeferredRenderer::LightingMode::kLightVolumes);
+  std::list<donkey::CameraNode> camera_nodes;
+  camera_nodes.push_back(donkey::CameraNode(
+      0, glm::vec3(0.0f), glm::vec3(0.0f), glm::tvec2<int>(0, 0),
+      glm::tvec2<GLsizei>(kWidth, kHeight), 60.0f, 0.1f, 100.0f,
+      donkey::CameraNode::Type::kPerspective));
+  render::StackAllocator<render::MeshNode> allocator(
+      donkey::Buffer::Tag::kFramePacket, 0);
+  // The driver reports the light volumes sampling the depth they are
+  // stencil tested against.
+  auto render_lit_frame =
+      [&](const std::list<donkey::PointLightNode>& light_nodes) {
+        render::StackFramePacket frame_packet(mesh_nodes, camera_nodes, {},
+                                              light_nodes, {}, allocator);
+        frame_packet.sort_mesh_nodes();
+        render::CommandBucket commands(driver.begin_frame());
+        renderer.render(&frame_packet, commands);
+        driver.execute_commands(commands);
+        donkey::BufferPool::get_instance()->free_tag(
+            donkey::Buffer::Tag::kFramePacket, 0);
+        return driver.get_draw_call_count();
+      };
+
+  std::list<donkey::PointLightNode> light_nodes;
+  for (int i = 0; i < 4; ++i)
+    light_nodes.push_back(donkey::PointLightNode(
+        0, glm::vec3(static_cast<float>(i) * 2.0f, 0.0f, -18.0f), 5.0f,
+        glm::vec4(1.0f), glm::vec4(1.0f)));
+  std::size_t unlit = render_lit_frame({});
+  // The depth is copied once, then each volume is drawn twice.
+  EXPECT_EQ(render_lit_frame(light_nodes), unlit + 1 + 2 * light_nodes.size());
+  resource_manager.cleanup();
+}
+
+TEST(HeadlessDriver, AliasesTheTexturesOfARenderGraph) {
+  headless::Driver driver;
+  const headless::ResourceManager& resources = driver.get_resource_manager();
+  render::ResourceManager resource_manager(driver.get_resource_manager());
+  render::Pipeline pipeline(&driver, &resource_manager);
+  pipeline.set_light_buffers(
+      driver.get_resource_manager().create_texture_buffer(
+          render::pixel::BufferFormat::kRGBA32F),
+      driver.get_resource_manager().create_texture_buffer(
+          render::pixel::BufferFormat::kRG32UI),
+      driver.get_resource_manager().create_texture_buffer(
+          render::pixel::BufferFormat::kR16UI));
+  render::PipelineGenerator generator(resource_manager,
+                                      driver.get_resource_manager(), pipeline,
+                                      kWidth, kHeight);
+  for (const char* name :
+       {"albedo_texture", "light_texture", "light_plus_albedo_texture",
+        "history_texture", "tone_texture", "bloom_texture", "debug_texture"}) {
+    generator.register_texture(name, kWidth, kHeight,
+                               render::pixel::Format::kRGBA,
+                               render::pixel::InternalFormat::kRGBA8,
+                               render::pixel::ComponentType::kUnsignedByte,
+                               std::string(name) == "history_texture");
+  }
+  generator.register_texture("depth_texture", kWidth, kHeight,
+                             render::pixel::Format::kDepthStencil,
+                             render::pixel::InternalFormat::kDepth24Stencil8,
+                             render::pixel::ComponentType::kUnsignedInt248);
+  // Shaders that don't exist, nothing gets fused.
+  auto register_pass = [&](const std::list<std::string>& input_textures,
+                           const std::list<std::string>& render_targets,
+                           const std::string& name) {
+    generator.register_pass(input_textures, render_targets, "graph.vert.glsl",
+                            name + ".frag.glsl", GL_COLOR_BUFFER_BIT, false,
+                            false, false);
+  };
+  generator.register_pass({"albedo_texture", "depth_texture"},
+                          GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT, true,
+                          false, false);
+  register_pass({"depth_texture"}, {"light_texture"}, "light");
+  register_pass({"albedo_texture", "light_texture"},
+                {"light_plus_albedo_texture"}, "albedo");
+  register_pass({"light_plus_albedo_texture"}, {"history_texture"},
+                "history");
+  register_pass({"light_plus_albedo_texture", "history_texture"},
+                {"tone_texture"}, "tone");
+  register_pass({"tone_texture"}, {"bloom_texture"}, "bloom");
+  // Nothing reads what it draws.
+  register_pass({"bloom_texture"}, {"debug_texture"}, "debug");
+  register_pass({"tone_texture", "bloom_texture", "depth_texture"}, {},
+                "screen");
+  std::size_t texture_count = resources.get_statistics().texture_count;
+  generator.build();
+
+  auto id = [&generator](const std::string& name) {
+    return generator.get_texture_id(name);
+  };
+  // Textures in use at the same time never share a texture.
+  EXPECT_NE(id("light_texture"), id("albedo_texture"));
+  EXPECT_NE(id("light_plus_albedo_texture"), id("albedo_texture"));
+  EXPECT_NE(id("light_plus_albedo_texture"), id("light_texture"));
+  EXPECT_NE(id("tone_texture"), id("light_plus_albedo_texture"));
+  EXPECT_NE(id("bloom_texture"), id("tone_texture"));
+  // The gbuffer's and the light pass' textures are free after the albedo
+  // pass.
+  EXPECT_EQ(id("tone_texture"), id("albedo_texture"));
+  EXPECT_EQ(id("bloom_texture"), id("light_texture"));
+  // Persistent textures are never aliased, even when others are free.
+  for (const char* name :
+       {"albedo_texture", "light_texture", "light_plus_albedo_texture",
+        "tone_texture", "bloom_texture", "depth_texture"}) {
+    EXPECT_NE(id("history_texture"), id(name)) << name;
+  }
+  EXPECT_EQ(id("debug_texture"), std::numeric_limits<uint32_t>::max());
+  EXPECT_EQ(resources.get_statistics().texture_count, texture_count + 5);
+
+  // The culled pass records nothing: one full-screen draw per kept pass,
+  // the geometry pass has no meshes to draw.
+  std::list<donkey::CameraNode> camera_nodes;
+  camera_nodes.push_back(donkey::CameraNode(
+      0, glm::vec3(0.0f), glm::vec3(0.0f), glm::tvec2<int>(0, 0),
+      glm::tvec2<GLsizei>(kWidth, kHeight), 60.0f, 0.1f, 100.0f,
+      donkey::CameraNode::Type::kPerspective));
+  render::StackAllocator<render::MeshNode> allocator(
+      donkey::Buffer::Tag::kFramePacket, 0);
+  render::StackFramePacket frame_packet({}, camera_nodes, {}, {}, {},
+                                        allocator);
+  render::CommandBucket commands(driver.begin_frame());
+  pipeline.render(&frame_packet, commands);
+  driver.execute_commands(commands);
+  donkey::BufferPool::get_instance()->free_tag(
+      donkey::Buffer::Tag::kFramePacket, 0);
+  EXPECT_EQ(driver.get_draw_call_count(), 6u);
+  for (uint32_t i = 0; i < resources.get_gpu_program_count(); ++i)
+    EXPECT_NE(resources.get_gpu_program(i).fs_path, "debug.frag.glsl");
+  resource_manager.cleanup();
+}
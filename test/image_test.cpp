@@ -0,0 +1,160 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "render/image.hpp"
+
+namespace image = donkey::render::image;
+
+namespace {
+
+const std::size_t kPixelCounts[] = {1, 15, 17, 33};
+
+// Bytes that differ from a pixel to the next and from a channel to the
+// next, so that any misplaced byte shows.
+std::vector<uint8_t> make_pixels(std::size_t size) {
+  std::vector<uint8_t> pixels(size);
+  for (std::size_t i = 0; i < size; ++i)
+    pixels[i] = static_cast<uint8_t>(i * 7 + 3);
+  return pixels;
+}
+
+// One pixel converted to RGBA, the scalar way.
+void to_rgba(const uint8_t* src, image::Layout layout, uint8_t* dst) {
+  bool bgr = (layout == image::Layout::kBGR || layout == image::Layout::kBGRA);
+  dst[0] = src[bgr ? 2 : 0];
+  dst[1] = src[1];
+  dst[2] = src[bgr ? 0 : 2];
+  dst[3] = (image::get_pixel_size(layout) == 4) ? src[3] : 0xff;
+}
+
+// Rows of `pitch` bytes converted to tightly packed RGBA, bottom row first.
+std::vector<uint8_t> convert_reference(const std::vector<uint8_t>& src,
+                                       std::size_t pitch,
+                                       image::Layout layout,
+                                       std::size_t width,
+                                       std::size_t height) {
+  std::size_t pixel_size = image::get_pixel_size(layout);
+  std::vector<uint8_t> dst(width * height * 4);
+  for (std::size_t y = 0; y < height; ++y) {
+    for (std::size_t x = 0; x < width; ++x) {
+      to_rgba(&src[y * pitch + x * pixel_size], layout,
+              &dst[((height - 1 - y) * width + x) * 4]);
+    }
+  }
+  return dst;
+}
+
+void check_swizzle(void (*swizzle)(const uint8_t*, uint8_t*, std::size_t),
+                   image::Layout layout) {
+  std::size_t pixel_size = image::get_pixel_size(layout);
+  for (std::size_t count : kPixelCounts) {
+    std::vector<uint8_t> src = make_pixels(count * pixel_size);
+    // One pixel more than converted, which must be left alone.
+    std::vector<uint8_t> dst((count + 1) * 4, 0xcd);
+    swizzle(src.data(), dst.data(), count);
+    std::vector<uint8_t> expected =
+        convert_reference(src, count * pixel_size, layout, count, 1);
+    expected.resize(dst.size(), 0xcd);
+    EXPECT_EQ(dst, expected) << count << " pixels";
+  }
+}
+
+TEST(Image, SwizzlesRgbLikeTheScalarReference) {
+  check_swizzle(&image::rgb_to_rgba, image::Layout::kRGB);
+}
+
+TEST(Image, SwizzlesBgrLikeTheScalarReference) {
+  check_swizzle(&image::bgr_to_rgba, image::Layout::kBGR);
+}
+
+TEST(Image, SwizzlesBgraLikeTheScalarReference) {
+  check_swizzle(&image::bgra_to_rgba, image::Layout::kBGRA);
+  for (std::size_t count : kPixelCounts) {
+    std::vector<uint8_t> pixels = make_pixels(count * 4);
+    std::vector<uint8_t> expected =
+        convert_reference(pixels, count * 4, image::Layout::kBGRA, count, 1);
+    image::bgra_to_rgba(pixels.data(), pixels.data(), count);
+    EXPECT_EQ(pixels, expected) << count << " pixels in place";
+  }
+}
+
+TEST(Image, FlipsRowsInPlace) {
+  const std::size_t row_size = 17 * 4;
+  const std::size_t pitch = row_size + 12;
+  for (std::size_t height : {1u, 2u, 5u, 6u}) {
+    std::vector<uint8_t> pixels = make_pixels(pitch * height);
+    std::vector<uint8_t> expected = pixels;
+    for (std::size_t y = 0; y < height; ++y) {
+      std::copy(pixels.begin() + y * pitch,
+                pixels.begin() + y * pitch + row_size,
+                expected.begin() + (height - 1 - y) * pitch);
+    }
+    image::flip_vertically(pixels.data(), row_size, pitch, height);
+    // The padding at the end of each row isn't touched.
+    EXPECT_EQ(pixels, expected) << height << " rows";
+  }
+}
+
+TEST(Image, ConvertsInPlaceLikeTheScalarReference) {
+  for (image::Layout layout : {image::Layout::kRGBA, image::Layout::kBGRA}) {
+    for (std::size_t width : kPixelCounts) {
+      for (std::size_t height : {1u, 4u, 7u}) {
+        const std::size_t pitch = width * 4 + 8;
+        std::vector<uint8_t> pixels = make_pixels(pitch * height);
+        std::vector<uint8_t> expected = pixels;
+        std::vector<uint8_t> converted =
+            convert_reference(pixels, pitch, layout, width, height);
+        for (std::size_t y = 0; y < height; ++y) {
+          std::copy(converted.begin() + y * width * 4,
+                    converted.begin() + (y + 1) * width * 4,
+                    expected.begin() + y * pitch);
+        }
+        image::convert_to_rgba_in_place(pixels.data(), pitch, width, height,
+                                        layout);
+        EXPECT_EQ(pixels, expected)
+            << width << "x" << height << " layout "
+            << static_cast<int>(layout);
+      }
+    }
+  }
+}
+
+TEST(Image, ConvertsEveryLayoutLikeTheScalarReference) {
+  for (image::Layout layout : {image::Layout::kRGB, image::Layout::kBGR,
+                               image::Layout::kRGBA, image::Layout::kBGRA}) {
+    for (std::size_t width : kPixelCounts) {
+      const std::size_t height = 3;
+      // Rows padded past their size, like SDL surfaces.
+      const std::size_t pitch = width * image::get_pixel_size(layout) + 5;
+      std::vector<uint8_t> src = make_pixels(pitch * height);
+      std::vector<uint8_t> dst(width * height * 4);
+      image::convert_to_rgba(src.data(), pitch, layout, dst.data(), width,
+                             height);
+      EXPECT_EQ(dst, convert_reference(src, pitch, layout, width, height))
+          << width << " pixels wide, layout " << static_cast<int>(layout);
+    }
+  }
+}
+
+}  // namespace
@@ -0,0 +1,70 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <gtest/gtest.h>
+
+#include <glm/vec3.hpp>
+
+#include <cstdint>
+
+#include "render/LodSelector.hpp"
+#include "render/Mesh.hpp"
+
+namespace render = donkey::render;
+
+namespace {
+
+// Level 1 is good enough up to 100 pixels per unit at the default 1 pixel
+// error, level 2 up to 25.
+render::Mesh make_mesh() {
+  render::Mesh mesh(0, 300, glm::vec3(-1.0f), glm::vec3(1.0f));
+  mesh.lods.push_back({1, 100, 0.01f});
+  mesh.lods.push_back({2, 30, 0.04f});
+  return mesh;
+}
+
+}  // namespace
+
+TEST(LodSelector, PicksTheCoarsestLevelUnderThePixelError) {
+  render::LodSelector selector;
+  render::Mesh mesh = make_mesh();
+  EXPECT_EQ(selector.select(mesh, 200.0f, render::LodSelector::kNoLod), 0u);
+  EXPECT_EQ(selector.select(mesh, 50.0f, render::LodSelector::kNoLod), 1u);
+  EXPECT_EQ(selector.select(mesh, 10.0f, render::LodSelector::kNoLod), 2u);
+  selector.set_pixel_error(4.0f);
+  EXPECT_EQ(selector.select(mesh, 200.0f, render::LodSelector::kNoLod), 1u);
+}
+
+// Hovering around the threshold between levels 0 and 1 by less than the
+// hysteresis, 25%, keeps the level a node had. Crossing it by more
+// switches.
+TEST(LodSelector, DoesNotOscillateAroundAThreshold) {
+  render::LodSelector selector;
+  render::Mesh mesh = make_mesh();
+  const float threshold = 100.0f;
+  for (uint32_t lod : {0u, 1u}) {
+    uint32_t previous_lod = lod;
+    for (int frame = 0; frame < 20; ++frame) {
+      float offset = (frame % 2) ? 0.2f : -0.2f;
+      previous_lod =
+          selector.select(mesh, threshold * (1.0f + offset), previous_lod);
+      EXPECT_EQ(previous_lod, lod) << "frame " << frame;
+    }
+  }
+  EXPECT_EQ(selector.select(mesh, threshold * 0.7f, 0), 1u);
+  EXPECT_EQ(selector.select(mesh, threshold * 1.3f, 1), 0u);
+}
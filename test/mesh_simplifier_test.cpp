@@ -0,0 +1,172 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <gtest/gtest.h>
+
+#include <glm/glm.hpp>
+
+#include <cmath>
+#include <cstdint>
+#include <set>
+#include <vector>
+
+#include "MeshSimplifier.hpp"
+
+namespace {
+
+const int kCellCount = 8;  // per side
+
+// Unit square in the z = 0 plane split in kCellCount x kCellCount cells of
+// two counter-clockwise triangles, facing +z. With a `seam`, the middle
+// column of vertices is doubled, as where two UV charts meet: the cells on
+// its right use the copies.
+struct Grid {
+  std::vector<float> positions;
+  std::vector<uint32_t> indices;
+  std::vector<uint32_t> border_vertices;
+  std::vector<uint32_t> seam_vertices;
+
+  explicit Grid(bool seam, float bump = 0.0f) {
+    const int side = kCellCount + 1;
+    for (int j = 0; j < side; ++j) {
+      for (int i = 0; i < side; ++i)
+        add_vertex(i, j, bump);
+    }
+    std::vector<uint32_t> copies(side, 0);
+    if (seam) {
+      for (int j = 0; j < side; ++j) {
+        copies[j] = add_vertex(kCellCount / 2, j, bump);
+        seam_vertices.push_back(get_vertex(kCellCount / 2, j));
+        seam_vertices.push_back(copies[j]);
+      }
+    }
+    for (int j = 0; j < side; ++j) {
+      for (int i = 0; i < side; ++i) {
+        if (i == 0 || j == 0 || i == kCellCount || j == kCellCount)
+          border_vertices.push_back(get_vertex(i, j));
+      }
+    }
+    for (int j = 0; j < kCellCount; ++j) {
+      for (int i = 0; i < kCellCount; ++i) {
+        uint32_t corners[4] = {get_vertex(i, j), get_vertex(i + 1, j),
+                               get_vertex(i + 1, j + 1),
+                               get_vertex(i, j + 1)};
+        if (seam && i == kCellCount / 2) {
+          corners[0] = copies[j];
+          corners[3] = copies[j + 1];
+        }
+        indices.insert(indices.end(), {corners[0], corners[1], corners[2],
+                                       corners[0], corners[2], corners[3]});
+      }
+    }
+  }
+
+  uint32_t get_vertex(int i, int j) const {
+    return static_cast<uint32_t>(j * (kCellCount + 1) + i);
+  }
+
+  uint32_t add_vertex(int i, int j, float bump) {
+    float x = static_cast<float>(i) / kCellCount;
+    float y = static_cast<float>(j) / kCellCount;
+    positions.insert(positions.end(),
+                     {x, y, bump * std::sin(7.0f * x) * std::cos(5.0f * y)});
+    return static_cast<uint32_t>(positions.size() / 3 - 1);
+  }
+
+  glm::vec3 get_position(uint32_t vertex) const {
+    return glm::vec3(positions[vertex * 3], positions[vertex * 3 + 1],
+                     positions[vertex * 3 + 2]);
+  }
+
+  // Twice the area of each triangle, along its normal.
+  std::vector<glm::vec3> get_normals(
+      const std::vector<uint32_t>& triangles) const {
+    std::vector<glm::vec3> normals;
+    for (std::size_t i = 0; i + 2 < triangles.size(); i += 3) {
+      glm::vec3 a = get_position(triangles[i]);
+      glm::vec3 b = get_position(triangles[i + 1]);
+      glm::vec3 c = get_position(triangles[i + 2]);
+      normals.push_back(glm::cross(b - a, c - a));
+    }
+    return normals;
+  }
+};
+
+}  // namespace
+
+TEST(MeshSimplifier, ReachesTheTargetIndexCount) {
+  Grid grid(false);
+  const std::size_t target_index_count = grid.indices.size() / 3;
+  float error = -1.0f;
+  std::vector<uint32_t> indices = donkey::MeshSimplifier().simplify(
+      grid.positions, grid.indices, target_index_count, 1.0f, error);
+  EXPECT_LE(indices.size(), target_index_count);
+  EXPECT_GT(indices.size(), 0u);
+  EXPECT_EQ(indices.size() % 3, 0u);
+  // A plane stays where it is.
+  EXPECT_GE(error, 0.0f);
+  EXPECT_LT(error, 1e-4f);
+}
+
+TEST(MeshSimplifier, StopsAtTheMaxError) {
+  Grid grid(false, 0.1f);
+  float error = -1.0f;
+  std::vector<uint32_t> indices = donkey::MeshSimplifier().simplify(
+      grid.positions, grid.indices, 0, 0.01f, error);
+  EXPECT_LE(error, 0.01f);
+  EXPECT_LT(indices.size(), grid.indices.size());
+}
+
+// With nothing to stop the simplification but locked vertices, every
+// border and seam vertex is still used, where it was, and the square is
+// still covered once.
+TEST(MeshSimplifier, KeepsBorderAndSeamVertices) {
+  Grid grid(true);
+  float error;
+  std::vector<uint32_t> indices = donkey::MeshSimplifier().simplify(
+      grid.positions, grid.indices, 0, 1.0f, error);
+  std::set<uint32_t> used(indices.begin(), indices.end());
+  for (uint32_t vertex : grid.border_vertices)
+    EXPECT_EQ(used.count(vertex), 1u) << "border vertex " << vertex;
+  for (uint32_t vertex : grid.seam_vertices)
+    EXPECT_EQ(used.count(vertex), 1u) << "seam vertex " << vertex;
+  EXPECT_LT(used.size(), grid.positions.size() / 3);
+
+  float area = 0.0f;
+  for (const glm::vec3& normal : grid.get_normals(indices))
+    area += normal.z / 2.0f;
+  EXPECT_NEAR(area, 1.0f, 1e-4f);
+}
+
+// Collapses are rejected when one of the triangles around them would turn
+// over. On a flat grid, none of them even stands on its edge.
+TEST(MeshSimplifier, DoesNotFlipTriangles) {
+  for (float bump : {0.0f, 0.05f}) {
+    Grid grid(true, bump);
+    float error;
+    std::vector<uint32_t> indices = donkey::MeshSimplifier().simplify(
+        grid.positions, grid.indices, 0, 0.02f, error);
+    ASSERT_GT(indices.size(), 0u);
+    EXPECT_LT(indices.size(), grid.indices.size()) << "bump " << bump;
+    for (const glm::vec3& normal : grid.get_normals(indices)) {
+      if (bump == 0.0f)
+        EXPECT_GT(normal.z, 0.0f);
+      else
+        EXPECT_GE(normal.z, 0.0f) << "bump " << bump;
+    }
+  }
+}
@@ -0,0 +1,159 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <gtest/gtest.h>
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+
+#include "Scene.hpp"
+#include "render/FramePacket.hpp"
+#include "render/Mesh.hpp"
+#include "render/OcclusionCulling.hpp"
+
+namespace render = donkey::render;
+
+namespace {
+
+// Camera at the origin looking down -z, with the culling buffer's aspect
+// ratio.
+render::CameraNode make_camera_node() {
+  donkey::CameraNode camera_node(
+      0, glm::vec3(0.0f), glm::vec3(0.0f), glm::tvec2<int>(0, 0),
+      glm::tvec2<GLsizei>(render::OcclusionCulling::kWidth,
+                          render::OcclusionCulling::kHeight),
+      60.0f, 0.1f, 100.0f, donkey::CameraNode::Type::kPerspective);
+  return render::CameraNode(camera_node);
+}
+
+// Quad whose front face is counter-clockwise from `a` to `d`.
+render::Mesh make_occluder(const glm::vec3& a,
+                           const glm::vec3& b,
+                           const glm::vec3& c,
+                           const glm::vec3& d) {
+  render::Mesh mesh(0, 6, glm::min(glm::min(a, b), glm::min(c, d)),
+                    glm::max(glm::max(a, b), glm::max(c, d)));
+  mesh.occluder_positions = {a, b, c, d};
+  mesh.occluder_indices = {0, 1, 2, 0, 2, 3};
+  return mesh;
+}
+
+// Wall facing the camera at z = -5, covering the whole view when `size` is
+// large enough.
+render::Mesh make_wall(float size) {
+  return make_occluder(glm::vec3(-size, -size, -5.0f),
+                       glm::vec3(size, -size, -5.0f),
+                       glm::vec3(size, size, -5.0f),
+                       glm::vec3(-size, size, -5.0f));
+}
+
+glm::mat4 at(const glm::vec3& position) {
+  return glm::translate(glm::mat4(1.0f), position);
+}
+
+const render::Mesh box(1, 36, glm::vec3(-1.0f), glm::vec3(1.0f));
+
+}  // namespace
+
+TEST(OcclusionCulling, HidesBoxesBehindAFullScreenOccluder) {
+  render::OcclusionCulling culling;
+  ASSERT_TRUE(culling.begin(make_camera_node()));
+  culling.add_occluder(glm::mat4(1.0f), make_wall(100.0f));
+  culling.rasterize();
+  EXPECT_FALSE(culling.is_visible(at(glm::vec3(0.0f, 0.0f, -20.0f)), box));
+  EXPECT_FALSE(culling.is_visible(at(glm::vec3(4.0f, -3.0f, -30.0f)), box));
+  // In front of the wall, or through it.
+  EXPECT_TRUE(culling.is_visible(at(glm::vec3(0.0f, 0.0f, -3.0f)), box));
+  EXPECT_TRUE(culling.is_visible(at(glm::vec3(0.0f, 0.0f, -5.5f)), box));
+  for (int y = 0; y < render::OcclusionCulling::kHeight; y += 16) {
+    for (int x = 0; x < render::OcclusionCulling::kWidth; x += 16)
+      EXPECT_LE(culling.get_depth(x, y), 5.0f + 1e-3f) << x << ", " << y;
+  }
+}
+
+TEST(OcclusionCulling, KeepsBoxesBesideAnOccluder) {
+  render::OcclusionCulling culling;
+  ASSERT_TRUE(culling.begin(make_camera_node()));
+  culling.add_occluder(glm::mat4(1.0f), make_wall(1.0f));
+  culling.rasterize();
+  EXPECT_FALSE(culling.is_visible(
+      glm::scale(at(glm::vec3(0.0f, 0.0f, -20.0f)), glm::vec3(0.5f)), box));
+  EXPECT_TRUE(culling.is_visible(at(glm::vec3(10.0f, 0.0f, -20.0f)), box));
+  EXPECT_TRUE(culling.is_visible(at(glm::vec3(-10.0f, 5.0f, -20.0f)), box));
+  // Partly behind it.
+  EXPECT_TRUE(culling.is_visible(at(glm::vec3(5.0f, 0.0f, -20.0f)), box));
+}
+
+// A floor running from behind the camera to far in front of it: what the
+// camera can't see has to be clipped away, rather than drop the triangles
+// or project them upside down.
+TEST(OcclusionCulling, ClipsOccludersAgainstTheNearPlane) {
+  render::OcclusionCulling culling;
+  ASSERT_TRUE(culling.begin(make_camera_node()));
+  culling.add_occluder(glm::mat4(1.0f),
+                       make_occluder(glm::vec3(-50.0f, -1.0f, 10.0f),
+                                     glm::vec3(50.0f, -1.0f, 10.0f),
+                                     glm::vec3(50.0f, -1.0f, -50.0f),
+                                     glm::vec3(-50.0f, -1.0f, -50.0f)));
+  culling.rasterize();
+  EXPECT_GT(culling.get_statistics().triangle_count, 0u);
+  EXPECT_FALSE(culling.is_visible(at(glm::vec3(0.0f, -5.0f, -20.0f)), box));
+  EXPECT_FALSE(culling.is_visible(at(glm::vec3(-6.0f, -4.0f, -10.0f)), box));
+  EXPECT_TRUE(culling.is_visible(at(glm::vec3(0.0f, 3.0f, -20.0f)), box));
+  EXPECT_TRUE(culling.is_visible(at(glm::vec3(5.0f, 1.0f, -10.0f)), box));
+  // The bottom row sees the floor about 1 / tan(30) away, the top one is
+  // above the horizon.
+  EXPECT_LT(culling.get_depth(render::OcclusionCulling::kWidth / 2, 0), 2.0f);
+  EXPECT_GT(culling.get_depth(render::OcclusionCulling::kWidth / 2,
+                              render::OcclusionCulling::kHeight - 1),
+            100.0f);
+}
+
+TEST(OcclusionCulling, CountsTestedAndCulledBoxes) {
+  render::OcclusionCulling culling;
+  ASSERT_TRUE(culling.begin(make_camera_node()));
+  culling.add_occluder(glm::mat4(1.0f), make_wall(100.0f));
+  culling.rasterize();
+  const glm::vec3 positions[] = {
+      glm::vec3(0.0f, 0.0f, -20.0f),  // hidden
+      glm::vec3(3.0f, 1.0f, -40.0f),  // hidden
+      glm::vec3(0.0f, 0.0f, -3.0f),   // in front of the wall
+      glm::vec3(0.0f, 0.0f, 20.0f),   // behind the camera
+      glm::vec3(200.0f, 0.0f, -20.0f)  // off to the side
+  };
+  std::size_t visible_count = 0;
+  for (const glm::vec3& position : positions)
+    visible_count += culling.is_visible(at(position), box);
+
+  const render::OcclusionCulling::Statistics& statistics =
+      culling.get_statistics();
+  EXPECT_EQ(visible_count, 1u);
+  EXPECT_EQ(statistics.occluder_count, 1u);
+  EXPECT_EQ(statistics.triangle_count, 2u);
+  EXPECT_EQ(statistics.tested_count, 5u);
+  EXPECT_EQ(statistics.frustum_culled_count, 2u);
+  EXPECT_EQ(statistics.occlusion_culled_count, 2u);
+  EXPECT_EQ(statistics.tested_count - statistics.frustum_culled_count -
+                statistics.occlusion_culled_count,
+            visible_count);
+
+  // begin starts counting again.
+  ASSERT_TRUE(culling.begin(make_camera_node()));
+  EXPECT_EQ(culling.get_statistics().tested_count, 0u);
+  EXPECT_EQ(culling.get_statistics().occluder_count, 0u);
+}
@@ -0,0 +1,78 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <gtest/gtest.h>
+
+#include "render/RangeAllocator.hpp"
+
+namespace {
+
+using donkey::render::RangeAllocator;
+
+TEST(RangeAllocator, AppendsUntilSomethingIsFreed) {
+  RangeAllocator ranges;
+  EXPECT_EQ(ranges.allocate(4), 0u);
+  EXPECT_EQ(ranges.allocate(3), 4u);
+  EXPECT_EQ(ranges.allocate(0), 7u);
+  EXPECT_EQ(ranges.get_size(), 7u);
+}
+
+TEST(RangeAllocator, ReusesFreedRangesFirstFit) {
+  RangeAllocator ranges;
+  std::size_t a = ranges.allocate(4);
+  std::size_t b = ranges.allocate(8);
+  ranges.allocate(2);
+  ranges.free(b, 8);
+  EXPECT_EQ(ranges.get_free_range_count(), 1u);
+
+  // Too big for the hole of `b`, appended.
+  EXPECT_EQ(ranges.allocate(9), 14u);
+  // Split, what is left stays free.
+  EXPECT_EQ(ranges.allocate(5), b);
+  EXPECT_EQ(ranges.allocate(3), b + 5);
+  EXPECT_EQ(ranges.get_free_range_count(), 0u);
+  EXPECT_EQ(ranges.get_size(), 23u);
+
+  // Neighbours merge back into a range big enough for both.
+  ranges.free(a, 4);
+  ranges.free(b, 5);
+  EXPECT_EQ(ranges.get_free_range_count(), 1u);
+  EXPECT_EQ(ranges.allocate(9), a);
+}
+
+TEST(RangeAllocator, ShrinksWhenTheLastRangeIsFreed) {
+  RangeAllocator ranges;
+  std::size_t a = ranges.allocate(4);
+  std::size_t b = ranges.allocate(4);
+  ranges.free(a, 4);
+  ranges.free(b, 4);
+  EXPECT_EQ(ranges.get_size(), 0u);
+  EXPECT_EQ(ranges.get_free_range_count(), 0u);
+}
+
+TEST(RangeAllocator, AlignsOffsets) {
+  RangeAllocator ranges;
+  EXPECT_EQ(ranges.allocate(20, 256), 0u);
+  // The padding is free for smaller ranges.
+  EXPECT_EQ(ranges.allocate(40, 256), 256u);
+  EXPECT_EQ(ranges.allocate(16, 4), 20u);
+  ranges.free(0, 20);
+  EXPECT_EQ(ranges.allocate(24, 256), 512u);
+  EXPECT_EQ(ranges.allocate(20, 256), 0u);
+}
+
+}  // namespace
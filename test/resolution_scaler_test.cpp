@@ -0,0 +1,91 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <gtest/gtest.h>
+
+#include "render/ResolutionScaler.hpp"
+
+namespace render = donkey::render;
+
+namespace {
+
+// GPU time of a scene taking `full_frame_time` at full resolution, time
+// going with the pixel count.
+float run(render::ResolutionScaler& scaler,
+          float full_frame_time,
+          int frame_count) {
+  for (int i = 0; i < frame_count; ++i) {
+    float scale = scaler.get_scale();
+    scaler.update(full_frame_time * scale * scale, 0.0f);
+  }
+  return scaler.get_scale();
+}
+
+}  // namespace
+
+TEST(ResolutionScalerTest, StaysAtFullResolutionWithinBudget) {
+  render::ResolutionScaler scaler(
+      render::ResolutionScaler::make_default_settings());
+  EXPECT_FLOAT_EQ(run(scaler, 10.0f, 200), 1.0f);
+}
+
+TEST(ResolutionScalerTest, DropsUnderLoadAndRecovers) {
+  render::ResolutionScaler scaler(
+      render::ResolutionScaler::make_default_settings());
+  float target = scaler.get_settings().target_frame_time;
+  // 1.5 times over budget at full resolution
+  float scale = run(scaler, target * 1.5f, 200);
+  EXPECT_LT(scale, 1.0f);
+  EXPECT_LE(target * 1.5f * scale * scale, target * 1.01f);
+  // close to the largest scale fitting the budget
+  float step = scaler.get_settings().step;
+  float next_scale = scale + step;
+  EXPECT_GT(target * 1.5f * next_scale * next_scale, target * 0.99f);
+
+  EXPECT_FLOAT_EQ(run(scaler, target * 0.5f, 400), 1.0f);
+}
+
+TEST(ResolutionScalerTest, RespectsBounds) {
+  render::ResolutionScaler::Settings settings =
+      render::ResolutionScaler::make_default_settings();
+  settings.min_scale = 0.6f;
+  settings.max_scale = 0.9f;
+  render::ResolutionScaler scaler(settings);
+  EXPECT_FLOAT_EQ(scaler.get_scale(), 0.9f);
+  EXPECT_FLOAT_EQ(run(scaler, settings.target_frame_time * 10.0f, 200), 0.6f);
+  EXPECT_FLOAT_EQ(run(scaler, 1.0f, 400), 0.9f);
+}
+
+TEST(ResolutionScalerTest, SettlesAfterAChange) {
+  render::ResolutionScaler::Settings settings =
+      render::ResolutionScaler::make_default_settings();
+  render::ResolutionScaler scaler(settings);
+  float scale = scaler.update(settings.target_frame_time * 2.0f, 0.0f);
+  EXPECT_LT(scale, 1.0f);
+  // late frames drawn at full resolution don't push it further down
+  for (std::size_t i = 0; i < settings.settle_frame_count; ++i) {
+    EXPECT_FLOAT_EQ(scaler.update(settings.target_frame_time * 2.0f, 0.0f),
+                    scale);
+  }
+}
+
+TEST(ResolutionScalerTest, FallsBackToTheFrameInterval) {
+  render::ResolutionScaler scaler(
+      render::ResolutionScaler::make_default_settings());
+  float target = scaler.get_settings().target_frame_time;
+  EXPECT_LT(scaler.update(0.0f, target * 2.0f), 1.0f);
+}
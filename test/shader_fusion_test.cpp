@@ -0,0 +1,125 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "render/shader_fusion.hpp"
+
+namespace shader_fusion = donkey::render::shader_fusion;
+
+namespace {
+
+const std::string kProducer =
+    "/* header */\n"
+    "#version 410 core\n"
+    "\n"
+    "uniform sampler2D a_texture;\n"
+    "uniform sampler2D shared_texture;\n"
+    "\n"
+    "layout (std140) uniform CameraBlock\n"
+    "{\n"
+    "  vec4 viewport;\n"
+    "};\n"
+    "\n"
+    "in vec2 fragment_uv;\n"
+    "out vec4 color;\n"
+    "\n"
+    "vec4 shade(ivec2 texel)\n"
+    "{\n"
+    "  return texelFetch(a_texture, texel, 0) * viewport.x;\n"
+    "}\n"
+    "\n"
+    "void main()\n"
+    "{\n"
+    "  color = shade(ivec2(gl_FragCoord.xy));\n"
+    "}\n";
+
+const std::string kConsumer =
+    "#version 410 core\n"
+    "\n"
+    "uniform sampler2D b_texture;\n"
+    "uniform sampler2D shared_texture;\n"
+    "\n"
+    "layout (std140) uniform CameraBlock\n"
+    "{\n"
+    "  vec4 viewport;\n"
+    "};\n"
+    "\n"
+    "out vec4 color;\n"
+    "\n"
+    "// comment\n"
+    "void main()\n"
+    "{\n"
+    "  color = texelFetch(b_texture, ivec2(gl_FragCoord.xy), 0) +\n"
+    "      texelFetch(shared_texture, ivec2(0), 0);\n"
+    "}\n";
+
+std::size_t count(const std::string& string, const std::string& pattern) {
+  std::size_t result = 0;
+  for (std::size_t i = string.find(pattern); i != std::string::npos;
+       i = string.find(pattern, i + 1))
+    ++result;
+  return result;
+}
+
+}  // namespace
+
+TEST(ShaderFusion, InlinesTheProducerWhereItsOutputIsFetched) {
+  std::string fused;
+  ASSERT_TRUE(shader_fusion::fuse(kProducer, kConsumer, "b_texture", fused));
+  EXPECT_EQ(count(fused, "#version"), 1u);
+  EXPECT_EQ(count(fused, "uniform CameraBlock"), 1u);
+  EXPECT_EQ(count(fused, "uniform sampler2D shared_texture;"), 1u);
+  EXPECT_EQ(count(fused, "uniform sampler2D a_texture;"), 1u);
+  EXPECT_EQ(count(fused, "b_texture;"), 0u);
+  EXPECT_EQ(count(fused, "in vec2 fragment_uv;"), 0u);
+  EXPECT_EQ(count(fused, "out vec4 color;"), 1u);
+  EXPECT_EQ(count(fused, "void main()"), 1u);
+  EXPECT_EQ(count(fused, "header"), 0u);
+  EXPECT_EQ(count(fused, "vec4 shade_b_texture(ivec2 texel)"), 1u);
+  EXPECT_EQ(count(fused, "fetch_b_texture(ivec2(gl_FragCoord.xy), 0)"), 1u);
+  // defined before the consumer's first function and its comment
+  EXPECT_LT(fused.find("shade_b_texture"), fused.find("// comment"));
+}
+
+TEST(ShaderFusion, OnlyFusesTexelFetches) {
+  std::string consumer = kConsumer;
+  consumer.replace(consumer.find("texelFetch(b_texture, ivec2"),
+                   std::string("texelFetch(b_texture, ivec2").size(),
+                   "texture(b_texture, vec2");
+  std::string fused = "untouched";
+  EXPECT_FALSE(shader_fusion::fuse(kProducer, consumer, "b_texture", fused));
+  EXPECT_EQ(fused, "untouched");
+}
+
+TEST(ShaderFusion, NeedsAProducerShadingAnyTexel) {
+  std::string fused;
+  std::string producer = kProducer;
+  producer.replace(producer.find("shade(ivec2 texel)"), 5, "color");
+  EXPECT_FALSE(shader_fusion::fuse(producer, kConsumer, "b_texture", fused));
+
+  producer = kProducer;
+  producer.replace(producer.find("texel, 0) * viewport.x"), 5,
+                   "ivec2(gl_FragCoord.xy)");
+  EXPECT_FALSE(shader_fusion::fuse(producer, kConsumer, "b_texture", fused));
+
+  producer = kProducer;
+  producer.replace(producer.find("* viewport.x"), 12, "* fragment_uv.x");
+  EXPECT_FALSE(shader_fusion::fuse(producer, kConsumer, "b_texture", fused));
+}
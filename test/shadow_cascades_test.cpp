@@ -0,0 +1,178 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <gtest/gtest.h>
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/vec4.hpp>
+
+#include "Buffer.hpp"
+#include "BufferPool.hpp"
+#include "Scene.hpp"
+#include "render/FramePacket.hpp"
+#include "render/Mesh.hpp"
+#include "render/ShadowCascades.hpp"
+#include "render/StaticMeshSet.hpp"
+
+namespace render = donkey::render;
+
+namespace {
+
+const render::Mesh& get_mesh(uint32_t) {
+  static render::Mesh mesh(0, 36, glm::vec3(-0.5f), glm::vec3(0.5f));
+  return mesh;
+}
+
+// Camera looking down -z from (0, 2, 10), sun right above and a row of
+// static boxes on the ground.
+void fill_scene(donkey::Scene& scene) {
+  scene.create_perspective_camera_node(
+      0, 60.0f, 0.1f, 100.0f, glm::vec3(0.0f, 2.0f, 10.0f), glm::vec3(0.0f),
+      glm::tvec2<int>(0, 0), glm::tvec2<GLsizei>(320, 180));
+  scene.create_directional_light_node(
+      0, glm::vec3(0.0f), glm::vec3(-30.0f, 0.0f, 0.0f), glm::vec4(1.0f),
+      glm::vec4(1.0f));
+  for (int i = 0; i < 8; ++i) {
+    scene.create_static_mesh_node(
+        0, glm::vec3(0.0f, 0.0f, -4.0f * i), glm::vec3(0.0f),
+        glm::vec3(1.0f), 0, 0);
+  }
+}
+
+// Keeps `static_mesh_set` up to date the way GameManager does, before the
+// cascades look at it.
+render::ShadowCascades::Statistics update(
+    render::ShadowCascades& cascades,
+    render::StaticMeshSet& static_mesh_set,
+    donkey::Scene& scene) {
+  render::StackAllocator<render::MeshNode> allocator(
+      donkey::Buffer::Tag::kFramePacket, 0);
+  render::StackFramePacket packet(scene, allocator);
+  scene.clear_static_mesh_node_changes();
+  static_mesh_set.update(packet, get_mesh);
+  EXPECT_TRUE(cascades.update(packet, get_mesh));
+  render::ShadowCascades::Statistics statistics = cascades.get_statistics();
+  donkey::BufferPool::get_instance()->free_tag(
+      donkey::Buffer::Tag::kFramePacket, 0);
+  return statistics;
+}
+
+}  // namespace
+
+TEST(ShadowCascades, OnlyDrawsCascadesWhenSomethingMoves) {
+  donkey::Scene scene;
+  fill_scene(scene);
+  render::StaticMeshSet static_mesh_set;
+  render::ShadowCascades cascades(render::ShadowCascades::make_settings(
+      render::ShadowCascades::Quality::kMedium));
+  cascades.set_static_casters(&static_mesh_set);
+
+  render::ShadowCascades::Statistics statistics =
+      update(cascades, static_mesh_set, scene);
+  EXPECT_EQ(statistics.drawn_cascade_count, 3u);
+  EXPECT_EQ(statistics.static_drawn_cascade_count, 3u);
+  EXPECT_GT(statistics.static_caster_count, 0u);
+  EXPECT_EQ(statistics.dynamic_caster_count, 0u);
+
+  // Nothing moved.
+  statistics = update(cascades, static_mesh_set, scene);
+  EXPECT_EQ(statistics.drawn_cascade_count, 0u);
+
+  // A dynamic caster only has the cascades it's in redrawn, on top of the
+  // cached static casters, and those once more after it leaves.
+  donkey::MeshNode& mesh_node = scene.create_mesh_node(
+      0, glm::vec3(0.0f, 0.0f, -60.0f), glm::vec3(0.0f), glm::vec3(1.0f), 0,
+      0);
+  statistics = update(cascades, static_mesh_set, scene);
+  EXPECT_GE(statistics.drawn_cascade_count, 1u);
+  EXPECT_LT(statistics.drawn_cascade_count, 3u);
+  EXPECT_EQ(statistics.static_drawn_cascade_count, 0u);
+  EXPECT_EQ(statistics.dynamic_caster_count,
+            statistics.drawn_cascade_count);
+  std::size_t drawn_cascade_count = statistics.drawn_cascade_count;
+  mesh_node.position = glm::vec3(0.0f, -1000.0f, -60.0f);
+  statistics = update(cascades, static_mesh_set, scene);
+  EXPECT_EQ(statistics.drawn_cascade_count, drawn_cascade_count);
+  EXPECT_EQ(statistics.dynamic_caster_count, 0u);
+  statistics = update(cascades, static_mesh_set, scene);
+  EXPECT_EQ(statistics.drawn_cascade_count, 0u);
+
+  // New static casters and a turning light redraw every cache.
+  scene.create_static_mesh_node(0, glm::vec3(2.0f, 0.0f, 0.0f),
+                                glm::vec3(0.0f), glm::vec3(1.0f), 0, 0);
+  statistics = update(cascades, static_mesh_set, scene);
+  EXPECT_EQ(statistics.static_drawn_cascade_count, 3u);
+  scene.get_directional_light_nodes().front().angles.y = 5.0f;
+  statistics = update(cascades, static_mesh_set, scene);
+  EXPECT_EQ(statistics.static_drawn_cascade_count, 3u);
+  statistics = update(cascades, static_mesh_set, scene);
+  EXPECT_EQ(statistics.drawn_cascade_count, 0u);
+}
+
+TEST(ShadowCascades, SnapsCascadesToWholeTexels) {
+  donkey::Scene scene;
+  fill_scene(scene);
+  render::ShadowCascades::Settings settings =
+      render::ShadowCascades::make_settings(
+          render::ShadowCascades::Quality::kHigh);
+  settings.cache_static_casters = false;
+  render::StaticMeshSet static_mesh_set;
+  render::ShadowCascades cascades(settings);
+  cascades.set_static_casters(&static_mesh_set);
+  update(cascades, static_mesh_set, scene);
+  std::vector<glm::mat4> projections;
+  for (int i = 0; i < cascades.get_cascade_count(); ++i)
+    projections.push_back(cascades.get_cascade(i).projection);
+
+  // Sliding the camera moves the cascades by whole texels, turning it
+  // doesn't change their size.
+  donkey::CameraNode& camera_node = scene.get_camera_nodes().front();
+  camera_node.position.x += 3.7f;
+  camera_node.angles.y += 20.0f;
+  update(cascades, static_mesh_set, scene);
+  for (int i = 0; i < cascades.get_cascade_count(); ++i) {
+    const glm::mat4& projection = cascades.get_cascade(i).projection;
+    float texel_size = 2.0f / projection[0][0] / settings.resolution;
+    EXPECT_FLOAT_EQ(projection[0][0], projections[i][0][0]);
+    EXPECT_FLOAT_EQ(projection[1][1], projections[i][1][1]);
+    for (int axis = 0; axis < 2; ++axis) {
+      // Center of the cascade in light space, in texels.
+      float shift =
+          (projections[i][3][axis] / projections[i][axis][axis] -
+           projection[3][axis] / projection[axis][axis]) /
+          texel_size;
+      EXPECT_NEAR(shift, std::round(shift), 1e-2f);
+    }
+  }
+
+  // The shadow block maps a point of a cascade into its square of the atlas.
+  render::StackAllocator<render::MeshNode> allocator(
+      donkey::Buffer::Tag::kFramePacket, 0);
+  render::StackFramePacket packet(scene, allocator);
+  const render::CameraNode& render_camera_node = packet.get_camera_node();
+  render::ShadowBlock block = cascades.make_shadow_block(render_camera_node);
+  EXPECT_EQ(block.shadow_params.x, 4.0f);
+  glm::vec4 position = block.cascade_matrices[0] *
+                       render_camera_node.view *
+                       glm::vec4(camera_node.position, 1.0f);
+  EXPECT_GE(position.x, 0.0f);
+  EXPECT_LE(position.x, 0.25f);
+  EXPECT_GE(position.y, 0.0f);
+  EXPECT_LE(position.y, 1.0f);
+  donkey::BufferPool::get_instance()->free_tag(
+      donkey::Buffer::Tag::kFramePacket, 0);
+}
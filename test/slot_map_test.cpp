@@ -0,0 +1,111 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "SlotMap.hpp"
+
+namespace {
+
+using donkey::SlotMap;
+
+TEST(SlotMap, HandsOutIndicesUntilSomethingIsErased) {
+  SlotMap<std::string> map;
+  for (uint32_t i = 0; i < 10; ++i)
+    EXPECT_EQ(map.insert(std::to_string(i)), i);
+  EXPECT_EQ(map.size(), 10u);
+  EXPECT_EQ(map[7], "7");
+}
+
+TEST(SlotMap, DetectsStaleHandles) {
+  SlotMap<std::string> map;
+  uint32_t a = map.insert("a");
+  uint32_t b = map.insert("b");
+  EXPECT_TRUE(map.erase(a));
+  EXPECT_FALSE(map.contains(a));
+  EXPECT_EQ(map.find(a), nullptr);
+  EXPECT_FALSE(map.erase(a));
+
+  // The slot of `a` comes back with another generation.
+  uint32_t c = map.insert("c");
+  EXPECT_EQ(c & SlotMap<std::string>::kIndexMask,
+            a & SlotMap<std::string>::kIndexMask);
+  EXPECT_NE(c, a);
+  EXPECT_FALSE(map.contains(a));
+  EXPECT_EQ(map[b], "b");
+  EXPECT_EQ(map[c], "c");
+  EXPECT_FALSE(map.contains(SlotMap<std::string>::kInvalidHandle));
+  EXPECT_FALSE(map.contains(42));
+}
+
+TEST(SlotMap, ReusesTheOldestFreeSlotFirst) {
+  SlotMap<int> map;
+  uint32_t handles[3];
+  for (int i = 0; i < 3; ++i)
+    handles[i] = map.insert(i);
+  map.erase(handles[2]);
+  map.erase(handles[0]);
+  EXPECT_EQ(map.insert(3) & SlotMap<int>::kIndexMask, 2u);
+  EXPECT_EQ(map.insert(4) & SlotMap<int>::kIndexMask, 0u);
+  EXPECT_EQ(map.insert(5) & SlotMap<int>::kIndexMask, 3u);
+}
+
+TEST(SlotMap, KeepsValuesPacked) {
+  std::mt19937 generator(42);
+  SlotMap<int> map;
+  std::vector<uint32_t> handles;
+  std::vector<int> expected;
+  for (int round = 0; round < 20; ++round) {
+    for (int i = 0; i < 50; ++i) {
+      int value = round * 100 + i;
+      handles.push_back(map.insert(value));
+      expected.push_back(value);
+    }
+    std::shuffle(handles.begin(), handles.end(), generator);
+    for (int i = 0; i < 30; ++i) {
+      int value = map[handles.back()];
+      EXPECT_TRUE(map.erase(handles.back()));
+      handles.pop_back();
+      expected.erase(std::find(expected.begin(), expected.end(), value));
+    }
+  }
+
+  ASSERT_EQ(map.size(), expected.size());
+  std::vector<int> values(map.begin(), map.end());
+  for (std::size_t i = 0; i < values.size(); ++i)
+    EXPECT_EQ(map[map.get_handle(i)], values[i]);
+  std::sort(values.begin(), values.end());
+  std::sort(expected.begin(), expected.end());
+  EXPECT_EQ(values, expected);
+}
+
+TEST(SlotMap, ClearStartsOver) {
+  SlotMap<int> map;
+  uint32_t handle = map.insert(1);
+  map.erase(handle);
+  map.insert(2);
+  map.clear();
+  EXPECT_TRUE(map.empty());
+  EXPECT_EQ(map.insert(3), 0u);
+}
+
+}  // namespace
@@ -0,0 +1,117 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "Buffer.hpp"
+#include "BufferPool.hpp"
+#include "Scene.hpp"
+#include "render/FramePacket.hpp"
+#include "render/Mesh.hpp"
+#include "render/StaticMeshSet.hpp"
+
+namespace render = donkey::render;
+
+namespace {
+
+std::vector<uint32_t> get_mesh_ids(const render::StackFramePacket& packet) {
+  std::vector<uint32_t> mesh_ids;
+  for (const render::MeshNode& mesh_node : packet.get_mesh_nodes())
+    mesh_ids.push_back(mesh_node.mesh_id);
+  std::sort(mesh_ids.begin(), mesh_ids.end());
+  return mesh_ids;
+}
+
+const render::Mesh& get_mesh(uint32_t) {
+  static render::Mesh mesh(0, 36, glm::vec3(-0.5f), glm::vec3(0.5f));
+  return mesh;
+}
+
+}  // namespace
+
+TEST(StaticMeshSet, FollowsTheSceneThroughFramePackets) {
+  donkey::Scene scene;
+  scene.create_perspective_camera_node(
+      0, 60.0f, 0.1f, 100.0f, glm::vec3(0.0f, 0.0f, 20.0f), glm::vec3(0.0f),
+      glm::tvec2<int>(0, 0), glm::tvec2<GLsizei>(320, 180));
+  scene.create_mesh_node(0, glm::vec3(0.0f), glm::vec3(0.0f), glm::vec3(1.0f),
+                         0, 0);
+  uint32_t first_id = scene
+                          .create_static_mesh_node(0, glm::vec3(1.0f),
+                                                   glm::vec3(0.0f),
+                                                   glm::vec3(1.0f), 1, 0)
+                          .id;
+  scene.create_static_mesh_node(0, glm::vec3(2.0f), glm::vec3(0.0f),
+                                glm::vec3(1.0f), 2, 0);
+
+  render::StaticMeshSet static_mesh_set;
+  render::StackAllocator<render::MeshNode> allocator(
+      donkey::Buffer::Tag::kFramePacket, 0);
+  {
+    render::StackFramePacket packet(scene, allocator);
+    scene.clear_static_mesh_node_changes();
+    EXPECT_EQ(packet.get_mesh_nodes().size(), 1u);
+    EXPECT_EQ(packet.get_created_static_mesh_nodes().size(), 2u);
+    static_mesh_set.update(packet, get_mesh);
+    EXPECT_EQ(get_mesh_ids(packet), std::vector<uint32_t>({0, 1, 2}));
+  }
+
+  // Unchanged static nodes aren't part of the packet anymore.
+  {
+    render::StackFramePacket packet(scene, allocator);
+    EXPECT_TRUE(packet.get_created_static_mesh_nodes().empty());
+    static_mesh_set.update(packet, get_mesh);
+    EXPECT_EQ(get_mesh_ids(packet), std::vector<uint32_t>({0, 1, 2}));
+  }
+
+  // A node created and destroyed between two packets never shows up.
+  scene.destroy_static_mesh_node(first_id);
+  uint32_t transient_id = scene
+                              .create_static_mesh_node(0, glm::vec3(3.0f),
+                                                       glm::vec3(0.0f),
+                                                       glm::vec3(1.0f), 3, 0)
+                              .id;
+  scene.create_static_mesh_node(0, glm::vec3(4.0f), glm::vec3(0.0f),
+                                glm::vec3(1.0f), 4, 0);
+  scene.destroy_static_mesh_node(transient_id);
+  {
+    render::StackFramePacket packet(scene, allocator);
+    scene.clear_static_mesh_node_changes();
+    EXPECT_EQ(packet.get_destroyed_static_mesh_node_ids(),
+              render::StackVector<uint32_t>(1, first_id, allocator));
+    EXPECT_EQ(packet.get_created_static_mesh_nodes().size(), 1u);
+    static_mesh_set.update(packet, get_mesh);
+    EXPECT_EQ(get_mesh_ids(packet), std::vector<uint32_t>({0, 2, 4}));
+  }
+  EXPECT_EQ(static_mesh_set.size(), 2u);
+
+  // Nodes behind the camera stay out of the packets.
+  scene.create_static_mesh_node(0, glm::vec3(0.0f, 0.0f, 30.0f),
+                                glm::vec3(0.0f), glm::vec3(1.0f), 5, 0);
+  {
+    render::StackFramePacket packet(scene, allocator);
+    scene.clear_static_mesh_node_changes();
+    static_mesh_set.update(packet, get_mesh);
+    EXPECT_EQ(get_mesh_ids(packet), std::vector<uint32_t>({0, 2, 4}));
+    EXPECT_EQ(static_mesh_set.get_culled_count(), 1u);
+  }
+  donkey::BufferPool::get_instance()->free_tag(
+      donkey::Buffer::Tag::kFramePacket, 0);
+}
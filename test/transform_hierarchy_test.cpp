@@ -0,0 +1,190 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Scene.hpp"
+#include "TransformHierarchy.hpp"
+
+namespace {
+
+using donkey::TransformHierarchy;
+
+// Relative to the magnitude of the values, deep chains add up.
+void expect_near(const glm::mat4& lhs, const glm::mat4& rhs) {
+  for (int column = 0; column < 4; ++column) {
+    for (int row = 0; row < 4; ++row) {
+      float tolerance = 1e-4f * std::max(std::abs(rhs[column][row]), 1.0f);
+      EXPECT_NEAR(lhs[column][row], rhs[column][row], tolerance);
+    }
+  }
+}
+
+class TransformHierarchyTest : public testing::Test {
+ protected:
+  struct Transform {
+    uint32_t parent;
+    glm::vec3 position;
+    glm::vec3 angles;
+    glm::vec3 scale;
+    bool alive;
+  };
+
+  std::mt19937 generator_;
+  std::vector<Transform> transforms_;  // by id, what the hierarchy should be
+  TransformHierarchy hierarchy_;
+
+  TransformHierarchyTest() : generator_(42) {}
+
+  glm::vec3 get_random_vector(float min, float max) {
+    std::uniform_real_distribution<float> coordinate(min, max);
+    return glm::vec3(coordinate(generator_), coordinate(generator_),
+                     coordinate(generator_));
+  }
+
+  uint32_t create(uint32_t parent) {
+    Transform transform = {parent, get_random_vector(-10.0f, 10.0f),
+                           get_random_vector(-180.0f, 180.0f),
+                           get_random_vector(0.5f, 2.0f), true};
+    uint32_t id = hierarchy_.create(
+        parent, transform.position,
+        TransformHierarchy::make_rotation(transform.angles), transform.scale);
+    if (id >= transforms_.size())
+      transforms_.resize(id + 1);
+    transforms_[id] = transform;
+    return id;
+  }
+
+  bool is_ancestor(uint32_t ancestor, uint32_t id) const {
+    for (; id != TransformHierarchy::kNoTransform;
+         id = transforms_[id].parent) {
+      if (id == ancestor)
+        return true;
+    }
+    return false;
+  }
+
+  glm::mat4 get_expected_world_matrix(uint32_t id) const {
+    const Transform& transform = transforms_[id];
+    glm::mat4 local = donkey::SceneNode::make_model_matrix(
+        transform.position, transform.angles, transform.scale);
+    if (transform.parent == TransformHierarchy::kNoTransform)
+      return local;
+    return get_expected_world_matrix(transform.parent) * local;
+  }
+
+  void expect_world_matrices() {
+    for (uint32_t id = 0; id < transforms_.size(); ++id) {
+      if (!transforms_[id].alive)
+        continue;
+      ASSERT_TRUE(hierarchy_.contains(id));
+      EXPECT_EQ(hierarchy_.get_parent(id), transforms_[id].parent);
+      expect_near(hierarchy_.get_world_matrix(id),
+                  get_expected_world_matrix(id));
+    }
+  }
+};
+
+TEST_F(TransformHierarchyTest, WorldMatricesComposeLikeSceneNodes) {
+  uint32_t root = create(TransformHierarchy::kNoTransform);
+  uint32_t child = create(root);
+  uint32_t grandchild = create(child);
+  create(grandchild);
+  create(root);
+  hierarchy_.update();
+  EXPECT_EQ(hierarchy_.get_level_count(), 4u);
+  expect_world_matrices();
+}
+
+TEST_F(TransformHierarchyTest, OnlyDirtySubtreesAreRecomputed) {
+  uint32_t root = create(TransformHierarchy::kNoTransform);
+  uint32_t child = create(root);
+  uint32_t grandchild = create(child);
+  uint32_t other_root = create(TransformHierarchy::kNoTransform);
+  hierarchy_.update();
+  EXPECT_TRUE(hierarchy_.has_changed(grandchild));
+
+  transforms_[child].position = glm::vec3(1.0f, 2.0f, 3.0f);
+  hierarchy_.set_position(child, transforms_[child].position);
+  hierarchy_.update();
+  EXPECT_FALSE(hierarchy_.has_changed(root));
+  EXPECT_TRUE(hierarchy_.has_changed(child));
+  EXPECT_TRUE(hierarchy_.has_changed(grandchild));
+  EXPECT_FALSE(hierarchy_.has_changed(other_root));
+  expect_world_matrices();
+
+  hierarchy_.update();
+  EXPECT_FALSE(hierarchy_.has_changed(child));
+  EXPECT_FALSE(hierarchy_.has_changed(grandchild));
+}
+
+TEST_F(TransformHierarchyTest, ReparentingAndDestroyingReorders) {
+  std::uniform_int_distribution<uint32_t> coin(0, 3);
+  for (int i = 0; i < 2000; ++i) {
+    uint32_t parent = TransformHierarchy::kNoTransform;
+    if (!transforms_.empty() && coin(generator_) != 0) {
+      parent = std::uniform_int_distribution<uint32_t>(
+          0, static_cast<uint32_t>(transforms_.size() - 1))(generator_);
+    }
+    create(parent);
+  }
+  hierarchy_.update();
+  expect_world_matrices();
+
+  // Move whole subtrees around, children created before their new parent
+  // included.
+  std::uniform_int_distribution<uint32_t> any_id(
+      0, static_cast<uint32_t>(transforms_.size() - 1));
+  for (int i = 0; i < 500; ++i) {
+    uint32_t id = any_id(generator_);
+    uint32_t parent = any_id(generator_);
+    if (is_ancestor(id, parent))
+      continue;
+    transforms_[id].parent = parent;
+    hierarchy_.set_parent(id, parent);
+  }
+  hierarchy_.update();
+  expect_world_matrices();
+
+  // The children of destroyed transforms become roots.
+  for (uint32_t id = 0; id < transforms_.size(); id += 7) {
+    hierarchy_.destroy(id);
+    transforms_[id].alive = false;
+    for (Transform& transform : transforms_) {
+      if (transform.parent == id)
+        transform.parent = TransformHierarchy::kNoTransform;
+    }
+  }
+  for (uint32_t id = 3; id < transforms_.size(); id += 7) {
+    transforms_[id].angles.y += 90.0f;
+    hierarchy_.set_rotation(id,
+                            TransformHierarchy::make_rotation(
+                                transforms_[id].angles));
+  }
+  hierarchy_.update();
+  expect_world_matrices();
+  EXPECT_EQ(hierarchy_.size(), 2000u - (2000u + 6u) / 7u);
+}
+
+}  // namespace
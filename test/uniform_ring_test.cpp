@@ -0,0 +1,84 @@
+/* Copyright (C) 2018 Antoine Luciani
+ *
+ * This file is part of Sturdy Donkey.
+ *
+ * Sturdy Donkey is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * Sturdy Donkey is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Sturdy Donkey. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <gtest/gtest.h>
+
+#if defined(STURDY_DONKEY_EGL)
+
+#include <GL/gl3w.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "render/OffscreenContext.hpp"
+#include "render/gl/UniformRing.hpp"
+
+namespace render = donkey::render;
+
+namespace {
+
+uint8_t pattern(std::size_t i) {
+  return static_cast<uint8_t>(i * 7 + 3);
+}
+
+}  // namespace
+
+// A frame writes its whole region, then more than that again, which the
+// ring gets after the region once grown.
+TEST(UniformRing, GrowsKeepingWhatTheFrameWrote) {
+  if (!render::OffscreenContext::is_available())
+    GTEST_SKIP() << "no EGL display to render offscreen with";
+  render::OffscreenContext context(8, 8);
+  context.make_current(context.get_render_context());
+  ASSERT_EQ(gl3wInit(), 0);
+
+  {
+    render::gl::UniformRing ring(4096);
+    render::UniformStorage storage = ring.begin_frame();
+    ASSERT_GE(storage.capacity, 4096u);
+    for (std::size_t i = 0; i < storage.capacity; ++i)
+      storage.data[i] = pattern(i);
+    std::vector<uint8_t> overflow(storage.capacity + 100);
+    for (std::size_t i = 0; i < overflow.size(); ++i)
+      overflow[i] = pattern(storage.capacity + i);
+    ring.flush();
+    std::size_t size = storage.capacity + overflow.size();
+    ring.grow(size, overflow.data(), overflow.size());
+
+    std::vector<uint8_t> contents(size);
+    glBindBuffer(GL_UNIFORM_BUFFER, ring.get_buffer());
+    glGetBufferSubData(GL_UNIFORM_BUFFER,
+                       static_cast<GLintptr>(ring.get_frame_offset()),
+                       static_cast<GLsizeiptr>(size), contents.data());
+    std::size_t mismatch_count = 0;
+    for (std::size_t i = 0; i < size; ++i)
+      mismatch_count += (contents[i] != pattern(i));
+    EXPECT_EQ(mismatch_count, 0u);
+    EXPECT_EQ(glGetError(), static_cast<GLenum>(GL_NO_ERROR));
+    ring.end_frame();
+
+    for (int i = 0; i < 4; ++i) {
+      EXPECT_GE(ring.begin_frame().capacity, size);
+      ring.flush();
+      ring.end_frame();
+    }
+  }
+  context.free_context();
+}
+
+#endif